@@ -0,0 +1,453 @@
+/*
+** spt_bench.c — SPT 基准测试 harness。
+**
+** 按注册表（默认 bench/suite/suite.txt）逐个运行基准脚本：每个基准、每种模式
+** （解释器 / JIT）先预热若干次，再计时 N 次；每次运行都在全新的 lua_State 中
+** 进行（JIT 的录制/编译开销计入），编译在计时区外完成。
+**
+** 每个 (基准, 模式) 输出一条 JSON 记录：中位数 / p95 / 最小 / 最大耗时（毫秒），
+** 以及单次运行的平均分配次数、分配字节数和 GC 周期数。给定 --baseline 时与
+** 基线 JSON（本程序先前的输出）按 (name, mode) 对比，中位数变慢超过阈值即判为
+** 回归，进程返回 1，可直接用于升级前的性能门禁；基线文件不存在时返回 2。结果格式与
+** 基线对比见 spt_bench_report.h。
+**
+**   分配：计数分配器（lua_newstate 的 lua_Alloc），新块计一次分配，字节数为
+**         新块大小与扩容增量之和。
+**   GC 周期：带 __gc 的哨兵 userdata，每被回收一次计一个周期并重建自身。
+**
+** 用法见 spt_bench --help；CMake 目标 bench / bench_baseline / bench_check。
+*/
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lauxlib.h"
+#include "lua.h"
+#include "lualib.h"
+#include "spt_jit.h"
+#include "spt_module.h"
+
+#include "spt_bench_report.h"
+
+#define BENCH_MAX 256
+#define BENCH_NAME_MAX 64
+#define BENCH_PATH_MAX 1024
+
+enum { MODE_INTERP = 0, MODE_JIT = 1 };
+static const char *const mode_names[] = {"interp", "jit"};
+
+typedef struct {
+  char name[BENCH_NAME_MAX];
+  char path[BENCH_PATH_MAX];
+} Bench;
+
+typedef struct {
+  int reps, warmup;
+  int modes[2]; /* 是否运行 interp / jit */
+  const char *filter;
+  const char *out;
+  const char *baseline;
+  double threshold; /* 百分比 */
+  int list;
+} Options;
+
+/* 一个 (基准, 模式) 的汇总结果。 */
+typedef struct {
+  const char *name;
+  int mode;
+  double median, p95, min, max; /* 毫秒 */
+  unsigned long long allocs, alloc_bytes, gc_cycles;
+} Result;
+
+/* ---- 计数分配器 ---- */
+
+typedef struct {
+  unsigned long long allocs, bytes;
+} AllocStats;
+
+static void *bench_alloc(void *ud, void *ptr, size_t osize, size_t nsize) {
+  AllocStats *st = (AllocStats *)ud;
+  if (nsize == 0) {
+    free(ptr);
+    return NULL;
+  }
+  if (ptr == NULL) { /* 新块：osize 是对象类型，不是大小 */
+    st->allocs++;
+    st->bytes += nsize;
+  } else if (nsize > osize)
+    st->bytes += nsize - osize;
+  return realloc(ptr, nsize);
+}
+
+/* ---- GC 周期哨兵 ---- */
+
+typedef struct {
+  unsigned long long cycles;
+  int active;
+} GcCounter;
+
+static void new_sentinel(lua_State *L);
+
+static int sentinel_gc(lua_State *L) {
+  GcCounter *gc = (GcCounter *)lua_touserdata(L, lua_upvalueindex(1));
+  if (gc->active) {
+    gc->cycles++;
+    new_sentinel(L);
+  }
+  return 0;
+}
+
+/* 创建一个不可达、带 __gc 的 userdata；它在下一次回收时被终结。 */
+static void new_sentinel(lua_State *L) {
+  lua_newuserdatauv(L, 1, 0);
+  luaL_getmetatable(L, "spt_bench.sentinel");
+  lua_setmetatable(L, -2);
+  lua_pop(L, 1);
+}
+
+static void install_sentinel(lua_State *L, GcCounter *gc) {
+  luaL_newmetatable(L, "spt_bench.sentinel");
+  lua_pushlightuserdata(L, gc);
+  lua_pushcclosure(L, sentinel_gc, 1);
+  lua_setfield(L, -2, "__gc");
+  lua_pop(L, 1);
+  new_sentinel(L);
+}
+
+/* ---- 运行 ---- */
+
+static char *read_file_all(const char *path, size_t *len) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return NULL;
+  fseek(f, 0, SEEK_END);
+  long n = ftell(f);
+  rewind(f);
+  char *buf = (char *)malloc((size_t)(n > 0 ? n : 0) + 1);
+  size_t rd = buf ? fread(buf, 1, (size_t)(n > 0 ? n : 0), f) : 0;
+  fclose(f);
+  if (!buf)
+    return NULL;
+  buf[rd] = '\0';
+  *len = rd;
+  return buf;
+}
+
+static void path_dirname(const char *path, char *out, size_t outsz) {
+  const char *slash = strrchr(path, '/');
+#ifdef _WIN32
+  const char *bs = strrchr(path, '\\');
+  if (bs && (!slash || bs > slash))
+    slash = bs;
+#endif
+  if (!slash) {
+    snprintf(out, outsz, ".");
+    return;
+  }
+  size_t n = (size_t)(slash - path);
+  if (n >= outsz)
+    n = outsz - 1;
+  memcpy(out, path, n);
+  out[n] = '\0';
+}
+
+/* 运行一次：返回耗时（毫秒），失败返回 -1 并打印错误。 */
+static double run_once(const Bench *b, const char *src, size_t len, int mode, AllocStats *as,
+                       GcCounter *gc, int *jit_missing) {
+  AllocStats st = {0, 0};
+  GcCounter gcc = {0, 0};
+  char dir[BENCH_PATH_MAX], chunk[BENCH_PATH_MAX + 1];
+  lua_State *L = lua_newstate(bench_alloc, &st, luaL_makeseed(NULL));
+  if (!L) {
+    fprintf(stderr, "%s: cannot create state\n", b->name);
+    return -1;
+  }
+  luaL_openlibs(L);
+  path_dirname(b->path, dir, sizeof(dir));
+  spt_register_module_loader(L, dir);
+
+  SPTJitState *js = sptjit_get_state(L);
+  if (mode == MODE_JIT && !js) {
+    *jit_missing = 1;
+    lua_close(L);
+    return -1;
+  }
+  if (js) {
+    if (mode == MODE_JIT)
+      sptjit_enable(js);
+    else
+      sptjit_disable(js);
+  }
+
+  snprintf(chunk, sizeof(chunk), "@%s", b->path);
+  if (luaL_loadbufferx(L, src, len, chunk, "t") != LUA_OK) {
+    fprintf(stderr, "%s: %s\n", b->name, lua_tostring(L, -1));
+    lua_close(L);
+    return -1;
+  }
+  lua_gc(L, LUA_GCCOLLECT);
+  install_sentinel(L, &gcc);
+  st.allocs = st.bytes = 0;
+  gcc.active = 1;
+
+  double t0 = bench_now_ms();
+  int status = lua_pcall(L, 0, 0, 0);
+  double t1 = bench_now_ms();
+
+  gcc.active = 0;
+  *as = st;
+  *gc = gcc;
+  if (status != LUA_OK) {
+    const char *err = lua_tostring(L, -1);
+    fprintf(stderr, "%s [%s]: %s\n", b->name, mode_names[mode], err ? err : "error");
+    lua_close(L);
+    return -1;
+  }
+  lua_close(L);
+  return t1 - t0;
+}
+
+/* 运行一个 (基准, 模式)。返回 1 成功，0 失败，-1 JIT 不可用（跳过）。 */
+static int run_bench(const Bench *b, int mode, const Options *o, Result *r) {
+  size_t len = 0;
+  char *src = read_file_all(b->path, &len);
+  if (!src) {
+    fprintf(stderr, "%s: cannot read %s\n", b->name, b->path);
+    return 0;
+  }
+  double *times = (double *)malloc(sizeof(double) * (size_t)o->reps);
+  unsigned long long allocs = 0, bytes = 0, cycles = 0;
+  int ok = 1, jit_missing = 0;
+  for (int i = 0; ok && i < o->warmup + o->reps; i++) {
+    AllocStats as;
+    GcCounter gc;
+    double t = run_once(b, src, len, mode, &as, &gc, &jit_missing);
+    if (t < 0) {
+      ok = jit_missing ? -1 : 0;
+      break;
+    }
+    if (i < o->warmup)
+      continue;
+    times[i - o->warmup] = t;
+    allocs += as.allocs;
+    bytes += as.bytes;
+    cycles += gc.cycles;
+  }
+  if (ok == 1) {
+    int n = o->reps;
+    bench_sort(times, n);
+    r->name = b->name;
+    r->mode = mode;
+    r->median = bench_median(times, n);
+    r->p95 = bench_percentile(times, n, 0.95);
+    r->min = times[0];
+    r->max = times[n - 1];
+    r->allocs = allocs / (unsigned long long)n;
+    r->alloc_bytes = bytes / (unsigned long long)n;
+    r->gc_cycles = cycles / (unsigned long long)n;
+  }
+  free(times);
+  free(src);
+  return ok;
+}
+
+/* ---- 注册表 ---- */
+
+/* 解析 suite.txt：`名称 路径`，# 开头为注释；路径相对注册表所在目录。 */
+static int load_suite(const char *suite, Bench *out, int max) {
+  FILE *f = fopen(suite, "r");
+  if (!f) {
+    fprintf(stderr, "cannot open suite %s\n", suite);
+    return -1;
+  }
+  char dir[BENCH_PATH_MAX], line[2048];
+  path_dirname(suite, dir, sizeof(dir));
+  int n = 0;
+  while (fgets(line, sizeof(line), f)) {
+    char name[BENCH_NAME_MAX], rel[BENCH_PATH_MAX];
+    char *p = line;
+    while (*p == ' ' || *p == '\t')
+      p++;
+    if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0')
+      continue;
+    if (sscanf(p, "%63s %1023s", name, rel) != 2) {
+      fprintf(stderr, "%s: bad line: %s", suite, line);
+      continue;
+    }
+    if (n >= max) {
+      fprintf(stderr, "%s: more than %d benchmarks, rest ignored\n", suite, max);
+      break;
+    }
+    snprintf(out[n].name, sizeof(out[n].name), "%s", name);
+    int w = (rel[0] == '/') ? snprintf(out[n].path, sizeof(out[n].path), "%s", rel)
+                            : snprintf(out[n].path, sizeof(out[n].path), "%s/%s", dir, rel);
+    if (w < 0 || (size_t)w >= sizeof(out[n].path)) {
+      fprintf(stderr, "%s: path too long for %s\n", suite, name);
+      continue;
+    }
+    n++;
+  }
+  fclose(f);
+  return n;
+}
+
+/* ---- JSON 输出 / 基线 ---- */
+
+#define RESULT_FIELDS 9
+
+static void write_json(FILE *f, const char *suite, const Options *o, const Result *r, int n) {
+  BenchField head[] = {{"suite", suite, 0, 0}, {"reps", NULL, o->reps, 0},
+                       {"warmup", NULL, o->warmup, 0}};
+  BenchField *rows = (BenchField *)malloc(sizeof(BenchField) * RESULT_FIELDS * (size_t)(n ? n : 1));
+  if (!rows)
+    return;
+  for (int i = 0; i < n; i++) {
+    BenchField *fd = &rows[i * RESULT_FIELDS];
+    fd[0] = (BenchField){"name", r[i].name, 0, 0};
+    fd[1] = (BenchField){"mode", mode_names[r[i].mode], 0, 0};
+    fd[2] = (BenchField){"median_ms", NULL, r[i].median, 3};
+    fd[3] = (BenchField){"p95_ms", NULL, r[i].p95, 3};
+    fd[4] = (BenchField){"min_ms", NULL, r[i].min, 3};
+    fd[5] = (BenchField){"max_ms", NULL, r[i].max, 3};
+    fd[6] = (BenchField){"allocs", NULL, (double)r[i].allocs, 0};
+    fd[7] = (BenchField){"alloc_bytes", NULL, (double)r[i].alloc_bytes, 0};
+    fd[8] = (BenchField){"gc_cycles", NULL, (double)r[i].gc_cycles, 0};
+  }
+  bench_write_json(f, head, 3, "results", rows, n, RESULT_FIELDS);
+  free(rows);
+}
+
+/* 按 (name, mode) 对比中位数，返回回归条数。 */
+static int compare_baseline(const BenchBaseline *b, const Result *r, int n, double threshold) {
+  BenchCompare c;
+  bench_compare_begin(&c, "benchmark/mode (median ms)", threshold, 0);
+  for (int i = 0; i < n; i++) {
+    BenchField key[] = {{"name", r[i].name, 0, 0}, {"mode", mode_names[r[i].mode], 0, 0}};
+    char label[BENCH_NAME_MAX + 16];
+    double base = -1;
+    if (!bench_baseline_num(bench_baseline_find(b, key, 2), "median_ms", &base) || base <= 0)
+      base = -1;
+    snprintf(label, sizeof(label), "%s/%s", r[i].name, mode_names[r[i].mode]);
+    bench_compare_row(&c, label, base, r[i].median);
+  }
+  return bench_compare_end(&c);
+}
+
+/* ---- 命令行 ---- */
+
+static void print_help(const char *prog) {
+  printf("Usage: %s [options] [suite.txt]\n", prog);
+  printf("Options:\n");
+  printf("  --reps N          timed runs per benchmark and mode (default 10)\n");
+  printf("  --warmup N        untimed runs before timing (default 2)\n");
+  printf("  --mode M          interp | jit | both (default both)\n");
+  printf("  --filter S        only benchmarks whose name contains S\n");
+  printf("  --out FILE        write JSON results to FILE (default stdout)\n");
+  printf("  --baseline FILE   compare medians against a previous JSON result\n");
+  printf("  --threshold P     regression threshold in percent (default 10)\n");
+  printf("  --list            list registered benchmarks and exit\n");
+  printf("Exit status: 0 ok, 1 regression against the baseline,\n");
+  printf("             2 error (including a missing or unreadable baseline).\n");
+}
+
+int main(int argc, char *argv[]) {
+  Options o = {10, 2, {1, 1}, NULL, NULL, NULL, 10.0, 0};
+  const char *suite = "bench/suite/suite.txt";
+  for (int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+    if (strcmp(a, "--help") == 0 || strcmp(a, "-h") == 0) {
+      print_help(argv[0]);
+      return 0;
+    } else if (strcmp(a, "--list") == 0)
+      o.list = 1;
+    else if (v && strcmp(a, "--reps") == 0)
+      o.reps = atoi(argv[++i]);
+    else if (v && strcmp(a, "--warmup") == 0)
+      o.warmup = atoi(argv[++i]);
+    else if (v && strcmp(a, "--filter") == 0)
+      o.filter = argv[++i];
+    else if (v && strcmp(a, "--out") == 0)
+      o.out = argv[++i];
+    else if (v && strcmp(a, "--baseline") == 0)
+      o.baseline = argv[++i];
+    else if (v && strcmp(a, "--threshold") == 0)
+      o.threshold = atof(argv[++i]);
+    else if (v && strcmp(a, "--mode") == 0) {
+      v = argv[++i];
+      o.modes[MODE_INTERP] = strcmp(v, "interp") == 0 || strcmp(v, "both") == 0;
+      o.modes[MODE_JIT] = strcmp(v, "jit") == 0 || strcmp(v, "both") == 0;
+      if (!o.modes[MODE_INTERP] && !o.modes[MODE_JIT]) {
+        fprintf(stderr, "unknown mode '%s'\n", v);
+        return 2;
+      }
+    } else if (a[0] == '-') {
+      fprintf(stderr, "unknown option '%s' (see --help)\n", a);
+      return 2;
+    } else
+      suite = a;
+  }
+  if (o.reps < 1 || o.warmup < 0) {
+    fprintf(stderr, "--reps must be >= 1 and --warmup >= 0\n");
+    return 2;
+  }
+
+  static Bench benches[BENCH_MAX];
+  int nb = load_suite(suite, benches, BENCH_MAX);
+  if (nb < 0)
+    return 2;
+  if (o.list) {
+    for (int i = 0; i < nb; i++)
+      printf("%-16s %s\n", benches[i].name, benches[i].path);
+    return 0;
+  }
+  /* 基线先读：缺失时不必跑完全套才失败。 */
+  BenchBaseline base;
+  if (o.baseline && bench_baseline_load(&base, o.baseline, "bench_baseline") != 0)
+    return 2;
+
+  static Result results[BENCH_MAX * 2];
+  int nr = 0, failed = 0;
+  for (int i = 0; i < nb; i++) {
+    if (o.filter && !strstr(benches[i].name, o.filter))
+      continue;
+    for (int m = MODE_INTERP; m <= MODE_JIT; m++) {
+      if (!o.modes[m])
+        continue;
+      int rc = run_bench(&benches[i], m, &o, &results[nr]);
+      if (rc == 1) {
+        fprintf(stderr, "%-16s %-7s median %9.3f ms  p95 %9.3f ms\n", benches[i].name,
+                mode_names[m], results[nr].median, results[nr].p95);
+        nr++;
+      } else if (rc < 0)
+        fprintf(stderr, "%-16s %-7s skipped (JIT unavailable)\n", benches[i].name, mode_names[m]);
+      else
+        failed++;
+    }
+  }
+
+  int rc = 0;
+  FILE *out = stdout;
+  if (o.out && !(out = fopen(o.out, "w"))) {
+    fprintf(stderr, "cannot write %s\n", o.out);
+    rc = 2;
+  } else {
+    write_json(out, suite, &o, results, nr);
+    if (out != stdout)
+      fclose(out);
+  }
+
+  int regressions = 0;
+  if (o.baseline) {
+    regressions = compare_baseline(&base, results, nr, o.threshold);
+    bench_baseline_free(&base);
+  }
+  if (failed) {
+    fprintf(stderr, "%d benchmark run(s) failed\n", failed);
+    rc = 2;
+  }
+  return rc ? rc : regressions > 0;
+}
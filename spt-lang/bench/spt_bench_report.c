@@ -0,0 +1,244 @@
+/*
+** spt_bench_report.c — 基准 harness 共用部分（见 spt_bench_report.h）。
+*/
+#include "spt_bench_report.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* ---- 计时 / 统计 ---- */
+
+double bench_now_ms(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+static int cmp_double(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+void bench_sort(double *v, int n) {
+  if (n > 1)
+    qsort(v, (size_t)n, sizeof(double), cmp_double);
+}
+
+double bench_percentile(const double *v, int n, double p) {
+  int k = (int)(p * n + 0.999999) - 1;
+  if (k < 0)
+    k = 0;
+  if (k >= n)
+    k = n - 1;
+  return v[k];
+}
+
+double bench_median(const double *v, int n) {
+  return (n % 2) ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+/* ---- JSON 结果 ---- */
+
+static void json_str(FILE *f, const char *s) {
+  fputc('"', f);
+  for (; *s; s++) {
+    unsigned char c = (unsigned char)*s;
+    if (c == '"' || c == '\\')
+      fprintf(f, "\\%c", c);
+    else if (c < 0x20)
+      fprintf(f, "\\u%04x", c);
+    else
+      fputc(c, f);
+  }
+  fputc('"', f);
+}
+
+static void json_field(FILE *f, const BenchField *fd) {
+  json_str(f, fd->key);
+  fputs(": ", f);
+  if (fd->str)
+    json_str(f, fd->str);
+  else
+    fprintf(f, "%.*f", fd->prec, fd->num);
+}
+
+void bench_write_json(FILE *f, const BenchField *head, int nhead, const char *records,
+                      const BenchField *rows, int nrows, int nfields) {
+  fputs("{\n", f);
+  for (int i = 0; i < nhead; i++) {
+    fputs("  ", f);
+    json_field(f, &head[i]);
+    fputs(",\n", f);
+  }
+  fputs("  ", f);
+  json_str(f, records);
+  fputs(": [\n", f);
+  for (int r = 0; r < nrows; r++) {
+    fputs("    {", f);
+    for (int i = 0; i < nfields; i++) {
+      if (i)
+        fputs(", ", f);
+      json_field(f, &rows[r * nfields + i]);
+    }
+    fprintf(f, "}%s\n", r + 1 < nrows ? "," : "");
+  }
+  fputs("  ]\n}\n", f);
+}
+
+/* ---- 基线 ---- */
+
+int bench_baseline_load(BenchBaseline *b, const char *path, const char *record_target) {
+  memset(b, 0, sizeof(*b));
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    if (errno == ENOENT)
+      fprintf(stderr, "no baseline at %s (record one with the %s target)\n", path, record_target);
+    else
+      fprintf(stderr, "cannot open baseline %s\n", path);
+    return -1;
+  }
+  size_t cap = 1 << 14, len = 0, rd;
+  b->text = (char *)malloc(cap);
+  while (b->text && (rd = fread(b->text + len, 1, cap - len - 1, f)) > 0) {
+    len += rd;
+    if (len + 1 == cap) {
+      char *nt = (char *)realloc(b->text, cap *= 2);
+      if (!nt)
+        free(b->text);
+      b->text = nt;
+    }
+  }
+  fclose(f);
+  if (!b->text) {
+    fprintf(stderr, "out of memory reading baseline %s\n", path);
+    return -1;
+  }
+  b->text[len] = '\0';
+  int nlines = 1;
+  for (size_t i = 0; i < len; i++)
+    nlines += b->text[i] == '\n';
+  b->lines = (char **)malloc(sizeof(char *) * (size_t)nlines);
+  if (!b->lines) {
+    bench_baseline_free(b);
+    fprintf(stderr, "out of memory reading baseline %s\n", path);
+    return -1;
+  }
+  for (char *p = b->text; p;) {
+    b->lines[b->n++] = p;
+    if ((p = strchr(p, '\n')) != NULL)
+      *p++ = '\0';
+  }
+  return 0;
+}
+
+void bench_baseline_free(BenchBaseline *b) {
+  free(b->lines);
+  free(b->text);
+  memset(b, 0, sizeof(*b));
+}
+
+/* 行内字段 key 的值（冒号后的第一个字符）。字符串按转义跳过；后跟冒号的字符串是键。 */
+static const char *field_value(const char *line, const char *key) {
+  size_t klen = strlen(key);
+  const char *p = line;
+  while ((p = strchr(p, '"')) != NULL) {
+    const char *s = ++p;
+    while (*p && *p != '"')
+      p += (*p == '\\' && p[1]) ? 2 : 1;
+    if (!*p)
+      return NULL;
+    size_t n = (size_t)(p++ - s);
+    const char *q = p;
+    while (*q == ' ')
+      q++;
+    if (*q != ':')
+      continue;
+    for (q++; *q == ' ';)
+      q++;
+    if (n == klen && memcmp(s, key, n) == 0)
+      return q;
+  }
+  return NULL;
+}
+
+/* 字符串值 v（指向开引号）是否等于 want。 */
+static int str_equals(const char *v, const char *want) {
+  if (*v++ != '"')
+    return 0;
+  while (*v != '"') {
+    int c = (unsigned char)*v++;
+    if (c == '\0')
+      return 0;
+    if (c == '\\') {
+      c = (unsigned char)*v++;
+      if (c == 'u') {
+        unsigned int u;
+        if (sscanf(v, "%4x", &u) != 1)
+          return 0;
+        c = (int)u;
+        v += 4;
+      } else if (c == '\0')
+        return 0;
+    }
+    if ((unsigned char)*want++ != c)
+      return 0;
+  }
+  return *want == '\0';
+}
+
+const char *bench_baseline_find(const BenchBaseline *b, const BenchField *match, int nmatch) {
+  for (int i = 0; i < b->n; i++) {
+    int ok = 1;
+    for (int k = 0; ok && k < nmatch; k++) {
+      const char *v = field_value(b->lines[i], match[k].key);
+      ok = v && str_equals(v, match[k].str);
+    }
+    if (ok)
+      return b->lines[i];
+  }
+  return NULL;
+}
+
+int bench_baseline_num(const char *line, const char *key, double *out) {
+  const char *v = line ? field_value(line, key) : NULL;
+  return v && sscanf(v, "%lf", out) == 1;
+}
+
+int bench_baseline_head(const BenchBaseline *b, const char *key, double *out) {
+  for (int i = 0; i < b->n; i++)
+    if (bench_baseline_num(b->lines[i], key, out))
+      return 1;
+  return 0;
+}
+
+/* ---- 对比表 ---- */
+
+void bench_compare_begin(BenchCompare *c, const char *key_title, double threshold, double floor) {
+  c->threshold = threshold;
+  c->floor = floor;
+  c->regressions = 0;
+  fprintf(stderr, "\n%-44s %12s %12s %9s\n", key_title, "base", "now", "delta");
+}
+
+int bench_compare_row(BenchCompare *c, const char *key, double base, double now) {
+  if (base < 0) {
+    fprintf(stderr, "%-44s %12s %12.4f %9s  (not in baseline)\n", key, "-", now, "-");
+    return 0;
+  }
+  double delta = base > 0 ? (now / base - 1.0) * 100.0 : 0.0;
+  int bad = base > 0 && delta > c->threshold && now - base > c->floor;
+  c->regressions += bad;
+  fprintf(stderr, "%-44s %12.4f %12.4f %+8.1f%%%s\n", key, base, now, delta,
+          bad ? "  REGRESSION" : "");
+  return bad;
+}
+
+int bench_compare_end(const BenchCompare *c) {
+  if (c->regressions)
+    fprintf(stderr, "\n%d regression(s) above %.1f%%\n", c->regressions, c->threshold);
+  else
+    fprintf(stderr, "\nno regression above %.1f%%\n", c->threshold);
+  return c->regressions;
+}
@@ -0,0 +1,92 @@
+/*
+** spt_bench_report.h — 基准 harness 共用的统计、JSON 结果与基线对比。
+**
+** spt_bench、spt-lsp-bench、sptxx_bench 的结果文件格式相同：一个 JSON 对象，若干头部
+** 字段，外加一个记录数组，每条记录独占一行。基线就是某次先前的输出，按行解析，按记录
+** 的字符串字段（基准名、模式、方法名）匹配到本次结果，再逐项对比数值。
+**
+** 基线门禁的约定：给定的基线文件不存在或不可读时报错（返回 -1，调用方以退出码 2
+** 结束），不会静默通过；对比表与所有诊断只写 stderr，stdout 留给 JSON 结果。
+*/
+#ifndef SPT_BENCH_REPORT_H
+#define SPT_BENCH_REPORT_H
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ---- 计时 / 统计 ---- */
+
+/* 墙钟毫秒数，只用于求差。 */
+double bench_now_ms(void);
+
+/* 升序排序。 */
+void bench_sort(double *v, int n);
+
+/* 最近秩百分位；v 已排序且 n >= 1。 */
+double bench_percentile(const double *v, int n, double p);
+
+/* 中位数（偶数个时取中间两个的平均）；v 已排序且 n >= 1。 */
+double bench_median(const double *v, int n);
+
+/* ---- JSON 结果 ---- */
+
+/* 一个字段：str 非 NULL 时为字符串，否则为数值，按 prec 位小数输出。 */
+typedef struct BenchField {
+  const char *key;
+  const char *str;
+  double num;
+  int prec;
+} BenchField;
+
+/* 写出结果文件：头部字段 head[0..nhead)，再是名为 records 的数组，
+   共 nrows 条记录，每条 nfields 个字段，rows 按行连续存放。 */
+void bench_write_json(FILE *f, const BenchField *head, int nhead, const char *records,
+                      const BenchField *rows, int nrows, int nfields);
+
+/* ---- 基线 ---- */
+
+typedef struct BenchBaseline {
+  char *text;
+  char **lines;
+  int n;
+} BenchBaseline;
+
+/* 读入基线。文件不存在时提示用 record_target 录制；失败返回 -1，成功返回 0。 */
+int bench_baseline_load(BenchBaseline *b, const char *path, const char *record_target);
+
+void bench_baseline_free(BenchBaseline *b);
+
+/* 第一条字符串字段全部与 match[0..nmatch) 相等的记录行；nmatch 为 0 时匹配任意行。 */
+const char *bench_baseline_find(const BenchBaseline *b, const BenchField *match, int nmatch);
+
+/* 记录行（或任一行）中的数值字段。 */
+int bench_baseline_num(const char *line, const char *key, double *out);
+
+/* 在整个基线中取第一个出现的数值字段（用于头部字段）。 */
+int bench_baseline_head(const BenchBaseline *b, const char *key, double *out);
+
+/* ---- 对比表 ---- */
+
+typedef struct BenchCompare {
+  double threshold; /* 百分比 */
+  double floor;     /* 绝对差不超过它时不算回归，滤掉抖动 */
+  int regressions;
+} BenchCompare;
+
+/* 打印表头；key_title 为第一列标题。 */
+void bench_compare_begin(BenchCompare *c, const char *key_title, double threshold, double floor);
+
+/* 一行对比；base < 0 表示基线中没有这一项。返回是否回归。 */
+int bench_compare_row(BenchCompare *c, const char *key, double base, double now);
+
+/* 打印汇总，返回回归条数。 */
+int bench_compare_end(const BenchCompare *c);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
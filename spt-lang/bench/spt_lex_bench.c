@@ -0,0 +1,129 @@
+/*
+** spt_lex_bench.c — 词法器微基准。
+**
+** 生成一份大型合成源码（缩进的类与函数、行/块文档注释、长字符串、长标识符、数值），
+** 分别以标量路径（spt_lex_set_scalar(1)）与默认批量扫描路径各跑 N 次 spt_lex，
+** 取最快一次换算 MB/s 并给出加速比。两条路径的 token 数不一致时返回 1。
+**
+**   spt_lex_bench [--mb N] [--reps N]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "spt_arena.h"
+#include "spt_diag.h"
+#include "spt_lexer.h"
+
+static double now_ms(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+/* 追加一段格式化文本；缓冲不足时返回 0。 */
+static int put(char *buf, size_t cap, size_t *len, const char *fmt, int a, int b) {
+  int n = snprintf(buf + *len, cap - *len, fmt, a, b);
+  if (n < 0 || (size_t)n >= cap - *len)
+    return 0;
+  *len += (size_t)n;
+  return 1;
+}
+
+/* 生成约 target 字节的合成源码（以一个完整的类为单位）。 */
+static char *gen_source(size_t target, size_t *out_len) {
+  static const char *const unit[] = {
+      "/**\n * Module-level documentation for component %d.\n"
+      " * It spans several lines, as real API docs do. (%d)\n */\n",
+      "class Component%d {\n    /// The identifier of this component instance (%d).\n"
+      "    int identifier_of_component = 0;\n",
+      "    str description_text = \"component %d: a fairly long description string that the "
+      "renderer shows in tooltips and logs, value %d\";\n",
+      "    fn compute_weighted_total(list values, float scale_factor) -> float {\n"
+      "        float accumulated_total = 0.0;   // running sum (%d)\n"
+      "        for (int index = 0; index < #values; index += 1) {\n"
+      "            accumulated_total += values[index] * scale_factor * %d.5e-3;\n"
+      "        }\n",
+      "        /* Clamp to the configured range before returning; the range comes\n"
+      "           from the settings map and defaults to [0, %d] for component %d. */\n"
+      "        if (accumulated_total > 1000000.0) { return 1000000.0; }\n"
+      "        return accumulated_total;\n    }\n",
+      "    fn label_for(int code) -> str {\n"
+      "        if (code == %d) { return \"primary\\tlabel\\n\"; }\n"
+      "        return 'secondary label for code ' .. code .. \" (\\\"%d\\\")\";\n    }\n}\n\n",
+  };
+  size_t cap = target + 4096;
+  char *buf = (char *)malloc(cap);
+  if (!buf)
+    return NULL;
+  size_t len = 0;
+  for (int i = 0; len < target; i++)
+    for (size_t k = 0; k < sizeof unit / sizeof *unit; k++)
+      if (!put(buf, cap, &len, unit[k], i, i * 7 + (int)k))
+        goto done;
+done:
+  buf[len] = '\0';
+  *out_len = len;
+  return buf;
+}
+
+/* 以指定路径跑 reps 次，返回最快一次的毫秒数；*tokens 为 token 数（-1 = 词法失败）。 */
+static double run(const char *src, size_t len, int scalar, int reps, int *tokens) {
+  double best = 0;
+  spt_lex_set_scalar(scalar);
+  for (int r = 0; r < reps; r++) {
+    SptArena *arena = spt_arena_create(0);
+    SptDiag diag;
+    spt_diag_init(&diag, "<bench>", src, len);
+    SptTokenArray toks;
+    double t0 = now_ms();
+    int ok = spt_lex(src, len, arena, &diag, &toks);
+    double dt = now_ms() - t0;
+    *tokens = ok ? toks.count : -1;
+    spt_arena_destroy(arena);
+    if (r == 0 || dt < best)
+      best = dt;
+  }
+  spt_lex_set_scalar(0);
+  return best;
+}
+
+int main(int argc, char *argv[]) {
+  double mb = 8;
+  int reps = 5;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--mb") == 0 && i + 1 < argc)
+      mb = atof(argv[++i]);
+    else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc)
+      reps = atoi(argv[++i]);
+    else {
+      printf("usage: %s [--mb N] [--reps N]\n", argv[0]);
+      return strcmp(argv[i], "--help") == 0 ? 0 : 2;
+    }
+  }
+  if (mb <= 0 || reps < 1) {
+    fprintf(stderr, "--mb and --reps must be positive\n");
+    return 2;
+  }
+  size_t len;
+  char *src = gen_source((size_t)(mb * 1024 * 1024), &len);
+  if (!src) {
+    fprintf(stderr, "out of memory\n");
+    return 2;
+  }
+  int tok_scalar = 0, tok_vector = 0;
+  double ms_scalar = run(src, len, 1, reps, &tok_scalar);
+  double ms_vector = run(src, len, 0, reps, &tok_vector);
+  double mib = (double)len / (1024.0 * 1024.0);
+  printf("source: %.2f MiB, %d tokens, best of %d\n", mib, tok_vector, reps);
+  printf("  scalar  %8.2f ms  %8.1f MiB/s\n", ms_scalar, mib / (ms_scalar / 1e3));
+  printf("  vector  %8.2f ms  %8.1f MiB/s\n", ms_vector, mib / (ms_vector / 1e3));
+  printf("  speedup %.2fx\n", ms_vector > 0 ? ms_scalar / ms_vector : 0.0);
+  free(src);
+  if (tok_scalar != tok_vector || tok_vector < 0) {
+    fprintf(stderr, "token count mismatch: scalar %d vs vector %d\n", tok_scalar, tok_vector);
+    return 1;
+  }
+  return 0;
+}
@@ -1072,6 +1072,196 @@ LUA_API int lua_nextarray(lua_State *L, int idx, lua_Integer *cursor) {
   return 1;
 }
 
+/*
+** Bulk typed transfer between an array and a C buffer.
+*/
+
+/*
+** Write n elements of the given kind from 'buf' into array slots
+** [start, start + n). start must not exceed the logical length; capacity
+** grows as needed and the logical length is extended to cover the range.
+** Numbers and booleans are not collectable, so no write barrier is needed.
+*/
+LUA_API void lua_arraywrite(lua_State *L, int idx, lua_Integer start, int kind, const void *buf,
+                            lua_Integer n) {
+  Table *t;
+  const TValue *o;
+  unsigned i, s, e;
+  lua_lock(L);
+  o = index2value(L, idx);
+  api_check(L, ttisarray(o), "array expected");
+  t = avalue(o);
+  api_check(L, start >= 0 && cast_uint(start) <= t->loglen, "invalid start index");
+  api_check(L, n >= 0 && start + n <= INT_MAX, "invalid count");
+  s = cast_uint(start);
+  e = cast_uint(start + n);
+  if (e > t->asize)
+    luaH_resizearray(L, t, e);
+  switch (kind) {
+  case LUA_BULK_INTEGER: {
+    const lua_Integer *p = cast(const lua_Integer *, buf);
+    for (i = s; i < e; i++) {
+      getArrVal(t, i)->i = p[i - s];
+      *getArrTag(t, i) = LUA_VNUMINT;
+    }
+    break;
+  }
+  case LUA_BULK_INT: {
+    const int *p = cast(const int *, buf);
+    for (i = s; i < e; i++) {
+      getArrVal(t, i)->i = p[i - s];
+      *getArrTag(t, i) = LUA_VNUMINT;
+    }
+    break;
+  }
+  case LUA_BULK_NUMBER: {
+    const lua_Number *p = cast(const lua_Number *, buf);
+    for (i = s; i < e; i++) {
+      getArrVal(t, i)->n = p[i - s];
+      *getArrTag(t, i) = LUA_VNUMFLT;
+    }
+    break;
+  }
+  case LUA_BULK_FLOAT: {
+    const float *p = cast(const float *, buf);
+    for (i = s; i < e; i++) {
+      getArrVal(t, i)->n = cast_num(p[i - s]);
+      *getArrTag(t, i) = LUA_VNUMFLT;
+    }
+    break;
+  }
+  case LUA_BULK_BOOLEAN: {
+    const unsigned char *p = cast(const unsigned char *, buf);
+    for (i = s; i < e; i++)
+      *getArrTag(t, i) = p[i - s] ? LUA_VTRUE : LUA_VFALSE;
+    break;
+  }
+  default:
+    api_check(L, 0, "invalid bulk kind");
+  }
+  if (e > t->loglen)
+    t->loglen = e;
+  lua_unlock(L);
+}
+
+/* Does 'tag' convert to the given bulk kind without loss of meaning? */
+static int bulktag(int kind, lu_byte tag) {
+  switch (kind) {
+  case LUA_BULK_INTEGER:
+  case LUA_BULK_INT:
+    return tag == LUA_VNUMINT;
+  case LUA_BULK_NUMBER:
+  case LUA_BULK_FLOAT:
+    return tag == LUA_VNUMINT || tag == LUA_VNUMFLT;
+  case LUA_BULK_BOOLEAN:
+    return tag == LUA_VTRUE || tag == LUA_VFALSE;
+  default:
+    return 0;
+  }
+}
+
+/*
+** Read array slots [start, start + n) into 'buf' as the given kind.
+** The range is scanned once first: if any element is not of a matching
+** type (integers for the integer kinds; integers or floats for the float
+** kinds; booleans for LUA_BULK_BOOLEAN), nothing is written and 0 is
+** returned so the caller can fall back to per-element conversion.
+*/
+LUA_API int lua_arrayread(lua_State *L, int idx, lua_Integer start, int kind, void *buf,
+                          lua_Integer n) {
+  Table *t;
+  const TValue *o;
+  unsigned i, s, e;
+  lua_lock(L);
+  o = index2value(L, idx);
+  api_check(L, ttisarray(o), "array expected");
+  t = avalue(o);
+  api_check(L, start >= 0 && n >= 0 && start + n <= (lua_Integer)t->loglen, "invalid range");
+  s = cast_uint(start);
+  e = cast_uint(start + n);
+  for (i = s; i < e; i++) {
+    if (!bulktag(kind, *getArrTag(t, i))) {
+      lua_unlock(L);
+      return 0;
+    }
+  }
+  switch (kind) {
+  case LUA_BULK_INTEGER: {
+    lua_Integer *p = cast(lua_Integer *, buf);
+    for (i = s; i < e; i++)
+      p[i - s] = getArrVal(t, i)->i;
+    break;
+  }
+  case LUA_BULK_INT: {
+    int *p = cast(int *, buf);
+    for (i = s; i < e; i++)
+      p[i - s] = cast_int(getArrVal(t, i)->i);
+    break;
+  }
+  case LUA_BULK_NUMBER: {
+    lua_Number *p = cast(lua_Number *, buf);
+    for (i = s; i < e; i++) {
+      const Value *v = getArrVal(t, i);
+      p[i - s] = *getArrTag(t, i) == LUA_VNUMFLT ? v->n : cast_num(v->i);
+    }
+    break;
+  }
+  case LUA_BULK_FLOAT: {
+    float *p = cast(float *, buf);
+    for (i = s; i < e; i++) {
+      const Value *v = getArrVal(t, i);
+      p[i - s] = cast(float, *getArrTag(t, i) == LUA_VNUMFLT ? v->n : cast_num(v->i));
+    }
+    break;
+  }
+  case LUA_BULK_BOOLEAN: {
+    unsigned char *p = cast(unsigned char *, buf);
+    for (i = s; i < e; i++)
+      p[i - s] = *getArrTag(t, i) == LUA_VTRUE;
+    break;
+  }
+  }
+  lua_unlock(L);
+  return 1;
+}
+
+/*
+** Zero-copy read access to an array of integers (LUA_BULK_INTEGER) or
+** floats (LUA_BULK_NUMBER). If every element has exactly that type,
+** returns 1 and sets '*data' to element 0, '*stride' to the byte distance
+** between consecutive elements (element k is at *data + k * *stride) and
+** '*len' to the logical length. The view is valid until the array is
+** resized or written, or becomes garbage. Returns 0 otherwise.
+*/
+LUA_API int lua_arrayview(lua_State *L, int idx, int kind, const void **data, ptrdiff_t *stride,
+                          lua_Integer *len) {
+  Table *t;
+  const TValue *o;
+  lu_byte want;
+  unsigned i;
+  lua_lock(L);
+  o = index2value(L, idx);
+  api_check(L, ttisarray(o), "array expected");
+  t = avalue(o);
+  if (kind != LUA_BULK_INTEGER && kind != LUA_BULK_NUMBER) {
+    lua_unlock(L);
+    return 0;
+  }
+  want = kind == LUA_BULK_INTEGER ? LUA_VNUMINT : LUA_VNUMFLT;
+  for (i = 0; i < t->loglen; i++) {
+    if (*getArrTag(t, i) != want) {
+      lua_unlock(L);
+      return 0;
+    }
+  }
+  /* values are laid out downwards from t->array (see ltable.h) */
+  *data = t->loglen > 0 ? cast(const void *, getArrVal(t, 0)) : NULL;
+  *stride = -cast(ptrdiff_t, sizeof(Value));
+  *len = cast(lua_Integer, t->loglen);
+  lua_unlock(L);
+  return 1;
+}
+
 /*
 ** Table mode query operations
 */
@@ -21,6 +21,7 @@
 #include "lauxlib.h"
 #include "llimits.h"
 #include "lualib.h"
+#include "spt_heapprof.h"
 
 /* luaB_print - receiver is arg1, values start from arg2 */
 static int luaB_print(lua_State *L) {
@@ -227,15 +228,38 @@ static int pushmode(lua_State *L, int oldmode) {
       break;                                                                                       \
   }
 
+/* collectgarbage 的 SPT 扩展选项（不经过 lua_gc） */
+#define SPT_GCHEAPPROFILE 100
+#define SPT_GCHEAPSNAPSHOT 101
+
 /* luaB_collectgarbage - receiver is arg1, option is arg2, etc */
 static int luaB_collectgarbage(lua_State *L) {
-  static const char *const opts[] = {"stop",      "restart",      "collect",     "count", "step",
-                                     "isrunning", "generational", "incremental", "param", NULL};
-  static const char optsnum[] = {LUA_GCSTOP,  LUA_GCRESTART, LUA_GCCOLLECT,
-                                 LUA_GCCOUNT, LUA_GCSTEP,    LUA_GCISRUNNING,
-                                 LUA_GCGEN,   LUA_GCINC,     LUA_GCPARAM};
+  static const char *const opts[] = {"stop",        "restart",      "collect",      "count",
+                                     "step",        "isrunning",    "generational", "incremental",
+                                     "param",       "heapprofile",  "heapsnapshot", NULL};
+  static const char optsnum[] = {LUA_GCSTOP,        LUA_GCRESTART,     LUA_GCCOLLECT,
+                                 LUA_GCCOUNT,       LUA_GCSTEP,        LUA_GCISRUNNING,
+                                 LUA_GCGEN,         LUA_GCINC,         LUA_GCPARAM,
+                                 SPT_GCHEAPPROFILE, SPT_GCHEAPSNAPSHOT};
   int o = optsnum[luaL_checkoption(L, 2, "collect", opts)];
   switch (o) {
+  case SPT_GCHEAPPROFILE: {
+    /* collectgarbage("heapprofile", interval): interval > 0 启动/调整采样间隔，
+       0 停止并丢弃数据；省略则用默认间隔。返回之前是否处于开启状态。 */
+    lua_Integer n = luaL_optinteger(L, 3, SPT_HEAPPROF_DEFAULT_INTERVAL);
+    int was = spt_heapprof_active(L);
+    if (n <= 0)
+      spt_heapprof_stop(L);
+    else if (!spt_heapprof_start(L, (size_t)n))
+      return luaL_error(L, "heapprofile: out of memory");
+    lua_pushboolean(L, was);
+    return 1;
+  }
+  case SPT_GCHEAPSNAPSHOT: {
+    if (!spt_heapprof_pushsnapshot(L))
+      luaL_pushfail(L); /* profiler not active, or out of memory */
+    return 1;
+  }
   case LUA_GCCOUNT: {
     int k = lua_gc(L, o);
     int b = lua_gc(L, LUA_GCCOUNTB);
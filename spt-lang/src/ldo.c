@@ -34,6 +34,7 @@
 
 /* SPT 前端：源码 -> AST -> 字节码 */
 #include "spt_codegen.h"
+#include "spt_jit.h"
 #include "spt_frontend.h"
 
 #define errorstatus(s) ((s) > LUA_YIELD)
@@ -151,6 +152,7 @@ l_noret luaD_throwbaselevel(lua_State *L, TStatus errcode) {
 
 TStatus luaD_rawrunprotected(lua_State *L, Pfunc f, void *ud) {
   l_uint32 oldnCcalls = L->nCcalls;
+  SPTTrace *oldtrace = sptjit_executing(G(L)->jit_state);
   lua_longjmp lj;
   lj.status = LUA_OK;
   lj.previous = L->errorJmp; /* chain new error handler */
@@ -158,6 +160,8 @@ TStatus luaD_rawrunprotected(lua_State *L, Pfunc f, void *ud) {
   LUAI_TRY(L, &lj, f, ud);   /* call 'f' catching errors */
   L->errorJmp = lj.previous; /* restore old error handler */
   L->nCcalls = oldnCcalls;
+  if (l_unlikely(lj.status != LUA_OK)) /* the error may have left a trace */
+    sptjit_set_executing(G(L)->jit_state, oldtrace);
   return lj.status;
 }
 
@@ -905,6 +909,7 @@ static TStatus precover(lua_State *L, TStatus status) {
 
 LUA_API int lua_resume(lua_State *L, lua_State *from, int nargs, int *nresults) {
   TStatus status;
+  lua_State *running;
   lua_lock(L);
   if (L->status == LUA_OK) {  /* may be starting a coroutine */
     if (L->ci != &L->base_ci) /* not in base level? */
@@ -919,7 +924,10 @@ LUA_API int lua_resume(lua_State *L, lua_State *from, int nargs, int *nresults)
   L->nCcalls++;
   luai_userstateresume(L, nargs);
   api_checkpop(L, (L->status == LUA_OK) ? nargs + 1 : nargs);
+  running = G(L)->running;
+  G(L)->running = L;
   status = luaD_rawrunprotected(L, resume, &nargs);
+  G(L)->running = running;
   /* continue running after recoverable errors */
   status = precover(L, status);
   if (l_likely(!errorstatus(status)))
@@ -21,6 +21,8 @@
 #include "lobject.h"
 #include "lstate.h"
 
+#include "spt_opstats.h"
+
 CClosure *luaF_newCclosure(lua_State *L, int nupvals) {
   GCObject *o = luaC_newobj(L, LUA_VCCL, sizeCclosure(nupvals));
   CClosure *c = gco2ccl(o);
@@ -263,6 +265,8 @@ lu_mem luaF_protosize(Proto *p) {
 }
 
 void luaF_freeproto(lua_State *L, Proto *f) {
+  if (l_unlikely(G(L)->opstats != NULL))
+    spt_opstats_freeproto(G(L)->opstats, f);
   if (!(f->flag & PF_FIXED)) {
     luaM_freearray(L, f->code, cast_sizet(f->sizecode));
     luaM_freearray(L, f->lineinfo, cast_sizet(f->sizelineinfo));
@@ -24,6 +24,8 @@
 #include "ltable.h"
 #include "ltm.h"
 
+#include "spt_heapprof.h"
+
 /*
 ** Maximum number of elements to sweep in each single step.
 ** (Large enough to dissipate fixed overheads but small enough
@@ -161,6 +163,8 @@ static l_mem objsize(GCObject *o) {
   return cast(l_mem, res);
 }
 
+l_mem luaC_objsize(GCObject *o) { return objsize(o); }
+
 static GCObject **getgclist(GCObject *o) {
   switch (o->tt) {
   case LUA_VTABLE:
@@ -315,6 +319,8 @@ GCObject *luaC_newobjdt(lua_State *L, lu_byte tt, size_t sz, size_t offset) {
   o->tt = tt;
   o->next = g->allgc;
   g->allgc = o;
+  if (l_unlikely(g->heapprof != NULL))
+    spt_heapprof_alloc(L, o, sz);
   return o;
 }
 
@@ -835,6 +841,8 @@ static void freeupval(lua_State *L, UpVal *uv) {
 
 static void freeobj(lua_State *L, GCObject *o) {
   assert_code(l_mem newmem = gettotalbytes(G(L)) - objsize(o));
+  if (l_unlikely(G(L)->heapprof != NULL))
+    spt_heapprof_free(L, o);
   switch (o->tt) {
   case LUA_VPROTO:
     luaF_freeproto(L, gco2p(o));
@@ -242,6 +242,7 @@
   (iscollectable(v) ? luaC_objbarrierback(L, p, gcvalue(v)) : cast_void(0))
 
 LUAI_FUNC void luaC_fix(lua_State *L, GCObject *o);
+LUAI_FUNC l_mem luaC_objsize(GCObject *o);
 LUAI_FUNC void luaC_freeallobjects(lua_State *L);
 LUAI_FUNC void luaC_step(lua_State *L);
 LUAI_FUNC void luaC_runtilstate(lua_State *L, int state, int fast);
@@ -736,6 +736,19 @@ static const luaL_Reg meth[] = {{"read", f_read},       {"write", f_write}, {"li
                                 {"flush", f_flush},     {"seek", f_seek},   {"close", f_close},
                                 {"setvbuf", f_setvbuf}, {NULL, NULL}};
 
+static int io_noclose(lua_State *L);
+
+/*
+** spt_clonestate hook: the byte copy of a standard or closed file is fine
+** (neither is closed by '__gc'); any other open file cannot be shared.
+*/
+static int f_clone(lua_State *L) {
+  LStream *p = (LStream *)lua_touserdata(L, 2);
+  if (!isclosed(p) && p->closef != &io_noclose)
+    return luaL_error(L, "cannot clone a state with open files");
+  return 0;
+}
+
 /*
 ** metamethods for file handles
 */
@@ -743,6 +756,7 @@ static const luaL_Reg metameth[] = {{"__index", NULL}, /* placeholder */
                                     {"__gc", f_gc},
                                     {"__close", f_gc},
                                     {"__tostring", f_tostring},
+                                    {"__clone", f_clone},
                                     {NULL, NULL}};
 
 static void createmeta(lua_State *L) {
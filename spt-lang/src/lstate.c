@@ -28,6 +28,10 @@
 
 /* SPT Trace JIT */
 #include "spt_jit.h"
+#include "spt_heapprof.h"
+#include "spt_opstats.h"
+#include "spt_frozen.h"
+#include "spt_profile.h"
 
 #define fromstate(L) (cast(LX *, cast(lu_byte *, (L)) - offsetof(LX, l)))
 
@@ -259,6 +263,14 @@ lu_mem luaE_threadsize(lua_State *L) {
 
 static void close_state(lua_State *L) {
   global_State *g = G(L);
+  /* Stop the sampling profiler before anything it may look at goes away. */
+  if (g->profiler)
+    spt_profile_close(L);
+  /* Drop the allocation profiler so freeing every object stays cheap. */
+  if (g->heapprof)
+    spt_heapprof_close(L);
+  if (g->opstats)
+    spt_opstats_close(L);
   /* Destroy JIT state first (frees executable memory and traces). */
   if (g->jit_state) {
     sptjit_destroy(g->jit_state);
@@ -273,6 +285,7 @@ static void close_state(lua_State *L) {
     luaC_freeallobjects(L);            /* collect all objects */
     luai_userstateclose(L);
   }
+  spt_frozen_close(L);
   luaM_freearray(L, G(L)->strt.hash, cast_sizet(G(L)->strt.size));
   /* Free registry_array */
   if (g->registry_array.arr != NULL) {
@@ -394,6 +407,11 @@ LUA_API lua_State *lua_newstate(lua_Alloc f, void *ud, unsigned seed) {
     g->mt[i] = NULL;
   /* Initialize SPT Trace JIT state. */
   g->jit_state = sptjit_create();
+  g->running = L;
+  g->profiler = NULL;
+  g->heapprof = NULL;
+  g->opstats = NULL;
+  g->frozen = NULL;
   if (luaD_rawrunprotected(L, f_luaopen, NULL) != LUA_OK) {
     /* memory allocation error: free partial state */
     close_state(L);
@@ -19,6 +19,18 @@ typedef struct CallInfo CallInfo;
 /* SPT Trace JIT state (opaque pointer; defined in src/jit/spt_jit.h) */
 typedef struct SPTJitState SPTJitState;
 
+/* SPT sampling profiler state (opaque pointer; defined in spt_profile.c) */
+typedef struct SPTProfiler SPTProfiler;
+
+/* SPT allocation profiler state (opaque pointer; defined in spt_heapprof.c) */
+typedef struct SPTHeapProf SPTHeapProf;
+
+/* Interpreter dispatch statistics (opaque pointer; defined in spt_opstats.c) */
+typedef struct SPTOpStats SPTOpStats;
+
+/* Frozen chunks loaded by a state (opaque pointer; defined in spt_frozen.c) */
+typedef struct SPTFrozenRefs SPTFrozenRefs;
+
 /*
 ** Some notes about garbage-collected objects: All objects in Lua must
 ** be kept somehow accessible until being freed, so all objects always
@@ -362,6 +374,25 @@ typedef struct global_State {
 
   /* SPT Trace JIT state. NULL if JIT is disabled or not yet initialized. */
   SPTJitState *jit_state;
+
+  /* Thread currently running (main thread, or the coroutine being resumed).
+     Maintained by 'lua_resume' so that asynchronous samplers know which
+     thread to interrupt. */
+  struct lua_State *running;
+
+  /* SPT sampling profiler. NULL unless spt_profile_start was called. */
+  SPTProfiler *profiler;
+
+  /* SPT allocation profiler. NULL unless spt_heapprof_start was called;
+     the GC allocation/free paths test this pointer before anything else. */
+  SPTHeapProf *heapprof;
+
+  /* Opcode/slow-path counters. Only ever set in SPT_OPSTATS builds. */
+  SPTOpStats *opstats;
+
+  /* Frozen chunks this state loaded; released by lua_close once every
+     object (whose prototypes may point into them) has been freed. */
+  SPTFrozenRefs *frozen;
 } global_State;
 
 #define G(L) (L->l_G)
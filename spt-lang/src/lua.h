@@ -279,6 +279,22 @@ LUA_API void(lua_movearray)(lua_State *L, int fromidx, int toidx, lua_Integer fr
                             lua_Integer count);
 LUA_API int(lua_nextarray)(lua_State *L, int idx, lua_Integer *cursor);
 
+/*
+** bulk typed array transfer (no per-element stack traffic)
+*/
+#define LUA_BULK_INTEGER 0 /* lua_Integer */
+#define LUA_BULK_INT 1     /* int */
+#define LUA_BULK_NUMBER 2  /* lua_Number */
+#define LUA_BULK_FLOAT 3   /* float */
+#define LUA_BULK_BOOLEAN 4 /* unsigned char, 0 or 1 */
+
+LUA_API void(lua_arraywrite)(lua_State *L, int idx, lua_Integer start, int kind, const void *buf,
+                             lua_Integer n);
+LUA_API int(lua_arrayread)(lua_State *L, int idx, lua_Integer start, int kind, void *buf,
+                           lua_Integer n);
+LUA_API int(lua_arrayview)(lua_State *L, int idx, int kind, const void **data, ptrdiff_t *stride,
+                           lua_Integer *len);
+
 /*
 ** table mode query
 */
@@ -33,6 +33,7 @@
 
 /* SPT Trace JIT */
 #include "spt_jit.h"
+#include "spt_opstats.h"
 
 #define gettabvalue(o) (gco2t(val_(o).gc))
 /*
@@ -271,12 +272,24 @@ static int floatforloop(StkId ra) {
     return 0; /* finish the loop */
 }
 
+/* count a table access that missed the fast path (SPT_OPSTATS builds) */
+#if defined(SPT_OPSTATS)
+#define opstats_slow(L, kind)                                                                      \
+  {                                                                                                \
+    if (l_unlikely(G(L)->opstats != NULL))                                                         \
+      spt_opstats_slowpath(G(L)->opstats, kind);                                                   \
+  }
+#else
+#define opstats_slow(L, kind) ((void)0)
+#endif
+
 /*
 ** Finish the table access 'val = t[key]' and return the tag of the result.
 */
 lu_byte luaV_finishget(lua_State *L, const TValue *t, TValue *key, StkId val, lu_byte tag) {
   int loop;         /* counter to avoid infinite loops */
   const TValue *tm; /* metamethod */
+  opstats_slow(L, SPT_OPSLOW_FINISHGET);
   for (loop = 0; loop < MAXTAGLOOP; loop++) {
     if (tag == LUA_VNOTABLE) { /* 't' is not a table? */
       lua_assert(!ttistable(t) && !ttisarray(t));
@@ -316,6 +329,7 @@ lu_byte luaV_finishget(lua_State *L, const TValue *t, TValue *key, StkId val, lu
 */
 void luaV_finishset(lua_State *L, const TValue *t, TValue *key, TValue *val, int hres) {
   int loop; /* counter to avoid infinite loops */
+  opstats_slow(L, SPT_OPSLOW_FINISHSET);
   for (loop = 0; loop < MAXTAGLOOP; loop++) {
     const TValue *tm;                            /* '__newindex' metamethod */
     if (hres != HNOTATABLE) {                    /* is 't' a table? */
@@ -1216,6 +1230,20 @@ void luaV_finishOp(lua_State *L) {
    sptjit_trace_hot(L, ci, (target_pc)) && (ci = L->ci, pc = ci->u.l.savedpc, cl = ci_func(ci),    \
                                             k = cl->p->k, updatebase(ci), updatetrap(ci), 1))
 
+/*
+** Dispatch statistics (SPT_OPSTATS builds only): count the instruction just
+** fetched, per opcode and per (Proto, pc). See spt_opstats.h.
+*/
+#if defined(SPT_OPSTATS)
+#define opstats_inst(L, cl, pc, i)                                                                 \
+  {                                                                                                \
+    if (l_unlikely(G(L)->opstats != NULL))                                                         \
+      spt_opstats_inst(G(L)->opstats, cl->p, pcRel(pc, cl->p), GET_OPCODE(i));                     \
+  }
+#else
+#define opstats_inst(L, cl, pc, i) ((void)0)
+#endif
+
 /* fetch an instruction and prepare its execution */
 #define vmfetch()                                                                                  \
   {                                                                                                \
@@ -1224,6 +1252,7 @@ void luaV_finishOp(lua_State *L) {
       updatebase(ci);               /* correct stack */                                            \
     }                                                                                              \
     i = *(pc++);                                                                                   \
+    opstats_inst(L, cl, pc, i);                                                                    \
   }
 
 #define vmdispatch(o) switch (o)
@@ -1533,6 +1562,7 @@ returning: /* trap already set */
           c += cast_uint(GETARG_Ax(*pc)) * (MAXARG_vC + 1);
         }
         pc++;              /* skip extra argument */
+        savepc(ci);        /* allocation site for the heap profiler */
         L->top.p = ra + 1; /* correct top in case of emergency GC */
         t = luaH_new(L);   /* memory allocation */
         t->mode = TABLE_MAP;
@@ -1552,6 +1582,7 @@ returning: /* trap already set */
           c += cast_uint(GETARG_Ax(*pc)) * (MAXARG_vC + 1);
         }
         pc++;                 /* skip extra argument */
+        savepc(ci);           /* allocation site for the heap profiler */
         L->top.p = ra + 1;    /* correct top in case of emergency GC */
         t = luaH_newarray(L); /* create array */
         setavalue2s(L, ra, t);
@@ -33,6 +33,11 @@
 **   spt_frontend.h                 — 源码 -> AST（词法 + 语法）
 **   spt_codegen.h                  — AST -> 字节码
 **   spt_module.h                   — import "xxx.spt" 模块加载器
+**   spt_clone.h                    — 从已初始化的模板状态克隆新状态（每请求一个状态）
+**   spt_frozen.h                   — 编译一次、多个状态共享字节码的冻结代码块
+**   spt_profile.h                  — 采样 profiler（folded 火焰图输出）
+**   spt_heapprof.h                 — 分配 profiler（按分配点统计存活字节、堆快照）
+**   spt_opstats.h                  — 解释器指令分发统计（需 -DSPT_OPSTATS=ON）
 **
 ** 与官方 Lua 一样，本头不内嵌 extern "C"；C++ 用户请自行包裹（见上方示例）。
 */
@@ -55,4 +60,15 @@
 /* ---- 模块加载：import "xxx.spt" ---- */
 #include "spt_module.h"
 
+/* ---- 状态克隆：模板状态 -> 独立副本 ---- */
+#include "spt_clone.h"
+
+/* ---- 冻结代码块：跨状态共享字节码 ---- */
+#include "spt_frozen.h"
+
+/* ---- profiler：采样 + 分配 ---- */
+#include "spt_heapprof.h"
+#include "spt_opstats.h"
+#include "spt_profile.h"
+
 #endif /* SPT_H */
@@ -35,6 +35,148 @@ AstList spt_ast_list_from(SptArena *a, AstNode **items, int count) {
   return l;
 }
 
+static void visit_list(const AstList *l, SptAstVisitFn fn, void *ctx) {
+  for (int i = 0; i < l->count; i++)
+    if (l->items[i])
+      fn(l->items[i], ctx);
+}
+
+#define VISIT(c)                                                                                   \
+  do {                                                                                             \
+    if (c)                                                                                         \
+      fn((c), ctx);                                                                                \
+  } while (0)
+
+void spt_ast_for_each_child(AstNode *n, SptAstVisitFn fn, void *ctx) {
+  if (!n)
+    return;
+  switch (n->type) {
+  case NODE_LITERAL_LIST:
+    visit_list(&n->u.lit_list.elements, fn, ctx);
+    break;
+  case NODE_LITERAL_MAP:
+    visit_list(&n->u.lit_map.entries, fn, ctx);
+    break;
+  case NODE_MAP_ENTRY:
+    VISIT(n->u.map_entry.key);
+    VISIT(n->u.map_entry.value);
+    break;
+  case NODE_UNARY_OP:
+    VISIT(n->u.unary.operand);
+    break;
+  case NODE_BINARY_OP:
+    VISIT(n->u.binary.left);
+    VISIT(n->u.binary.right);
+    break;
+  case NODE_FUNCTION_CALL:
+    VISIT(n->u.call.func);
+    visit_list(&n->u.call.args, fn, ctx);
+    break;
+  case NODE_MEMBER_ACCESS:
+  case NODE_MEMBER_LOOKUP:
+    VISIT(n->u.member.object);
+    break;
+  case NODE_INDEX_ACCESS:
+    VISIT(n->u.index.array);
+    VISIT(n->u.index.index);
+    break;
+  case NODE_LAMBDA:
+    visit_list(&n->u.lambda.params, fn, ctx);
+    VISIT(n->u.lambda.return_type);
+    VISIT(n->u.lambda.body);
+    break;
+  case NODE_BLOCK:
+    visit_list(&n->u.block.statements, fn, ctx);
+    break;
+  case NODE_EXPRESSION_STATEMENT:
+    VISIT(n->u.expr_stmt.expr);
+    break;
+  case NODE_ASSIGNMENT:
+    visit_list(&n->u.assign.lvalues, fn, ctx);
+    visit_list(&n->u.assign.rvalues, fn, ctx);
+    break;
+  case NODE_UPDATE_ASSIGNMENT:
+    VISIT(n->u.update.lvalue);
+    VISIT(n->u.update.rvalue);
+    break;
+  case NODE_IF_STATEMENT:
+    VISIT(n->u.if_stmt.condition);
+    VISIT(n->u.if_stmt.then_block);
+    visit_list(&n->u.if_stmt.else_if_clauses, fn, ctx);
+    VISIT(n->u.if_stmt.else_block);
+    break;
+  case NODE_IF_CLAUSE:
+    VISIT(n->u.if_clause.condition);
+    VISIT(n->u.if_clause.body);
+    break;
+  case NODE_WHILE_STATEMENT:
+    VISIT(n->u.while_stmt.condition);
+    VISIT(n->u.while_stmt.body);
+    break;
+  case NODE_FOR_NUMERIC_STATEMENT:
+    VISIT(n->u.for_num.type_annotation);
+    VISIT(n->u.for_num.start);
+    VISIT(n->u.for_num.end);
+    VISIT(n->u.for_num.step);
+    VISIT(n->u.for_num.body);
+    break;
+  case NODE_FOR_EACH_STATEMENT:
+    visit_list(&n->u.for_each.loop_variables, fn, ctx);
+    visit_list(&n->u.for_each.iterable_exprs, fn, ctx);
+    VISIT(n->u.for_each.body);
+    break;
+  case NODE_RETURN_STATEMENT:
+    visit_list(&n->u.return_stmt.values, fn, ctx);
+    break;
+  case NODE_IMPORT_NAMED:
+    visit_list(&n->u.import_named.specifiers, fn, ctx);
+    break;
+  case NODE_DEFER_STATEMENT:
+    VISIT(n->u.defer_stmt.body);
+    break;
+  case NODE_VARIABLE_DECL:
+    VISIT(n->u.var_decl.type_annotation);
+    VISIT(n->u.var_decl.initializer);
+    break;
+  case NODE_MUTI_VARIABLE_DECL:
+    for (int i = 0; i < n->u.muti_var.count; i++)
+      VISIT(n->u.muti_var.vars[i].type_annotation);
+    VISIT(n->u.muti_var.initializer);
+    break;
+  case NODE_PARAMETER_DECL:
+    VISIT(n->u.param.type_annotation);
+    break;
+  case NODE_FUNCTION_DECL:
+    visit_list(&n->u.func_decl.params, fn, ctx);
+    VISIT(n->u.func_decl.return_type);
+    VISIT(n->u.func_decl.body);
+    break;
+  case NODE_CLASS_MEMBER:
+    VISIT(n->u.class_member.member_declaration);
+    break;
+  case NODE_CLASS_DECL:
+    visit_list(&n->u.class_decl.members, fn, ctx);
+    break;
+  case NODE_DECLARE_MODULE:
+    visit_list(&n->u.declare_module.members, fn, ctx);
+    break;
+  case NODE_TYPE_MULTIRETURN:
+    visit_list(&n->u.type_multi.types, fn, ctx);
+    break;
+  case NODE_TYPE_LIST:
+    VISIT(n->u.type_list.element);
+    break;
+  case NODE_TYPE_MAP:
+    VISIT(n->u.type_map.key);
+    VISIT(n->u.type_map.value);
+    break;
+  default:
+    break; /* 叶子：字面量/标识符/this/.../import_ns/import_spec/break/continue/简单类型 */
+  }
+}
+
+#undef VISIT
+
 const char *spt_op_name(OperatorKind op) {
   switch (op) {
   case OPK_NEGATE:
@@ -419,6 +419,11 @@ static inline AstList spt_ast_list_empty(void) {
   return l;
 }
 
+/* 子节点遍历：对 n 的每个非空直接子节点（含类型注解节点）按源码顺序调用 fn 一次。
+** 不递归；需要整树遍历时由 fn 自行再调用本函数。 */
+typedef void (*SptAstVisitFn)(AstNode *child, void *ctx);
+void spt_ast_for_each_child(AstNode *n, SptAstVisitFn fn, void *ctx);
+
 /* 是否为类型注解节点。 */
 static inline bool spt_ast_is_type(NodeType t) {
   return t >= NODE_TYPE_PRIMITIVE && t <= NODE_TYPE_MULTIRETURN;
@@ -0,0 +1,454 @@
+/*
+** spt_clone.c — clone a lua_State from a template (see spt_clone.h).
+**
+** The copy runs on the new state, protected, with its collector stopped:
+** objects in flight are only referenced from the object map below. Every
+** template object gets its clone allocated ("shell", with the final sizes)
+** the first time it is reached and is queued; queued objects are filled in
+** order, which reaches and queues their children. The template is only
+** read: no strings are created in it and no table caches are touched.
+** Once everything is filled, '__clone' hooks run and finalizers are set.
+*/
+#define spt_clone_c
+#define LUA_CORE
+
+#include "lprefix.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lua.h"
+
+#include "ldebug.h"
+#include "ldo.h"
+#include "lfunc.h"
+#include "lgc.h"
+#include "lmem.h"
+#include "lobject.h"
+#include "lstate.h"
+#include "lstring.h"
+#include "ltable.h"
+
+#include "spt_clone.h"
+
+typedef struct CloneState {
+  lua_State *L;       /* the clone */
+  global_State *from; /* the template */
+  GCObject **src;     /* template objects, in discovery order */
+  GCObject **dst;     /* their clones */
+  int n, size;        /* entries used / allocated */
+  int filled;         /* entries before this one are filled */
+  int *slots;         /* open addressing: entry index + 1, 0 = free */
+  unsigned nslots;    /* power of 2 */
+} CloneState;
+
+static GCObject *cloneobj(CloneState *cs, GCObject *o);
+
+/* Map memory comes from the allocator directly: it is not a Lua object. */
+static void *cs_realloc(CloneState *cs, void *block, size_t osize, size_t nsize) {
+  global_State *g = G(cs->L);
+  void *b = (*g->frealloc)(g->ud, block, osize, nsize);
+  if (b == NULL && nsize > 0)
+    luaD_throw(cs->L, LUA_ERRMEM);
+  return b;
+}
+
+static void freemap(CloneState *cs) {
+  global_State *g = G(cs->L);
+  (*g->frealloc)(g->ud, cs->src, cast_sizet(cs->size) * sizeof(GCObject *), 0);
+  (*g->frealloc)(g->ud, cs->dst, cast_sizet(cs->size) * sizeof(GCObject *), 0);
+  (*g->frealloc)(g->ud, cs->slots, cs->nslots * sizeof(int), 0);
+}
+
+static unsigned hashptr(const GCObject *o) {
+  size_t p = (size_t)o >> 3;
+  return cast_uint(p ^ (p >> 16)) * 2654435761u;
+}
+
+static GCObject *lookup(CloneState *cs, GCObject *o) {
+  unsigned mask = cs->nslots - 1;
+  unsigned h = hashptr(o) & mask;
+  int e;
+  while ((e = cs->slots[h]) != 0) {
+    if (cs->src[e - 1] == o)
+      return cs->dst[e - 1];
+    h = (h + 1) & mask;
+  }
+  return NULL;
+}
+
+static void putslot(CloneState *cs, int e) {
+  unsigned mask = cs->nslots - 1;
+  unsigned h = hashptr(cs->src[e]) & mask;
+  while (cs->slots[h] != 0)
+    h = (h + 1) & mask;
+  cs->slots[h] = e + 1;
+}
+
+/* Record that 'o' is cloned as 'c'; 'c' still has to be filled. */
+static void insert(CloneState *cs, GCObject *o, GCObject *c) {
+  if (cs->n == cs->size) {
+    int nsize = cs->size * 2;
+    cs->src = (GCObject **)cs_realloc(cs, cs->src, cast_sizet(cs->size) * sizeof(GCObject *),
+                                      cast_sizet(nsize) * sizeof(GCObject *));
+    cs->dst = (GCObject **)cs_realloc(cs, cs->dst, cast_sizet(cs->size) * sizeof(GCObject *),
+                                      cast_sizet(nsize) * sizeof(GCObject *));
+    cs->size = nsize;
+  }
+  if (cast_uint(cs->n + 1) * 2 > cs->nslots) { /* keep load factor <= 1/2 */
+    unsigned oslots = cs->nslots;
+    int i;
+    cs->slots = (int *)cs_realloc(cs, cs->slots, oslots * sizeof(int), 2 * oslots * sizeof(int));
+    cs->nslots = 2 * oslots;
+    memset(cs->slots, 0, cs->nslots * sizeof(int));
+    for (i = 0; i < cs->n; i++)
+      putslot(cs, i);
+  }
+  cs->src[cs->n] = o;
+  cs->dst[cs->n] = c;
+  putslot(cs, cs->n++);
+}
+
+/* Field 'name' of template table 'mt', found without creating a string. */
+static const TValue *rawfield(const Table *mt, const char *name) {
+  size_t len = strlen(name);
+  unsigned i;
+  if (isdummy(mt))
+    return NULL;
+  for (i = 0; i < sizenode(mt); i++) {
+    const Node *n = gnode(mt, i);
+    if (keyisshrstr(n) && !isempty(gval(n)) && tsslen(keystrval(n)) == len &&
+        memcmp(getshrstr(keystrval(n)), name, len) == 0)
+      return gval(n);
+  }
+  return NULL;
+}
+
+static void clonevalue(CloneState *cs, TValue *dst, const TValue *src) {
+  if (iscollectable(src)) {
+    GCObject *c = cloneobj(cs, gcvalue(src));
+    setgcovalue(cs->L, dst, c);
+  } else
+    setobj(cs->L, dst, src);
+}
+
+/*
+** Clone of 'o', allocated with its final sizes but not filled yet.
+** Strings are complete right away.
+*/
+static GCObject *cloneobj(CloneState *cs, GCObject *o) {
+  lua_State *L = cs->L;
+  GCObject *c = lookup(cs, o);
+  if (c != NULL)
+    return c;
+  switch (o->tt) {
+  case LUA_VSHRSTR:
+  case LUA_VLNGSTR: {
+    TString *ts = gco2ts(o);
+    c = obj2gco(luaS_newlstr(L, getstr(ts), tsslen(ts)));
+    break;
+  }
+  case LUA_VTABLE:
+  case LUA_VARRAY: {
+    Table *t = gco2t(o);
+    Table *nt = (o->tt == LUA_VARRAY) ? luaH_newarray(L) : luaH_new(L);
+    nt->mode = t->mode;
+    c = obj2gco(nt);
+    insert(cs, o, c); /* before resizing, which may allocate */
+    luaH_resize(L, nt, t->asize, allocsizenode(t));
+    return c;
+  }
+  case LUA_VUSERDATA: {
+    Udata *u = gco2u(o);
+    c = obj2gco(luaS_newudata(L, u->len, u->nuvalue));
+    break;
+  }
+  case LUA_VLCL: {
+    LClosure *cl = luaF_newLclosure(L, gco2lcl(o)->nupvalues);
+    c = obj2gco(cl);
+    break;
+  }
+  case LUA_VCCL: {
+    CClosure *src = gco2ccl(o);
+    CClosure *cl = luaF_newCclosure(L, src->nupvalues);
+    int i;
+    cl->f = src->f;
+    for (i = 0; i < src->nupvalues; i++)
+      setnilvalue(&cl->upvalue[i]);
+    c = obj2gco(cl);
+    break;
+  }
+  case LUA_VPROTO:
+    c = obj2gco(luaF_newproto(L));
+    break;
+  case LUA_VUPVAL: {
+    UpVal *uv;
+    if (upisopen(gco2upv(o)))
+      luaG_runerror(L, "cannot clone a state while it runs a function with open upvalues");
+    uv = gco2upv(luaC_newobj(L, LUA_VUPVAL, sizeof(UpVal)));
+    uv->v.p = &uv->u.value; /* closed */
+    setnilvalue(uv->v.p);
+    c = obj2gco(uv);
+    break;
+  }
+  case LUA_VTHREAD: /* the main thread is mapped in advance */
+    luaG_runerror(L, "cannot clone a state that holds coroutines");
+    break;
+  default:
+    luaG_runerror(L, "cannot clone object of type %d", o->tt);
+  }
+  insert(cs, o, c);
+  return c;
+}
+
+static void filltable(CloneState *cs, Table *t, Table *src) {
+  lua_State *L = cs->L;
+  unsigned i;
+  lua_assert(t->asize == src->asize);
+  for (i = 0; i < src->asize; i++) {
+    lu_byte tag = *getArrTag(src, i);
+    if (tagisempty(tag))
+      *getArrTag(t, i) = tag;
+    else {
+      TValue v, nv;
+      farr2val(src, i, tag, &v);
+      clonevalue(cs, &nv, &v);
+      obj2arr(t, i, &nv);
+    }
+  }
+  if (t->array != NULL)
+    *lenhint(t) = *lenhint(src);
+  t->loglen = src->loglen;
+  if (!isdummy(src)) {
+    for (i = 0; i < sizenode(src); i++) {
+      Node *n = gnode(src, i);
+      if (!isempty(gval(n))) {
+        TValue k, nk, nv;
+        getnodekey(L, &k, n);
+        clonevalue(cs, &nk, &k);
+        clonevalue(cs, &nv, gval(n));
+        luaH_set(L, t, &nk, &nv);
+      }
+    }
+  }
+  if (src->metatable != NULL)
+    t->metatable = gco2t(cloneobj(cs, obj2gco(src->metatable)));
+  invalidateTMcache(t);
+}
+
+static void filludata(CloneState *cs, Udata *u, Udata *src) {
+  int i;
+  memcpy(getudatamem(u), getudatamem(src), src->len);
+  for (i = 0; i < src->nuvalue; i++)
+    clonevalue(cs, &u->uv[i].uv, &src->uv[i].uv);
+  if (src->metatable != NULL) {
+    if (rawfield(src->metatable, "__gc") != NULL && rawfield(src->metatable, "__clone") == NULL) {
+      const TValue *name = rawfield(src->metatable, "__name");
+      luaG_runerror(cs->L, "cannot clone userdata '%s': it has '__gc' but no '__clone'",
+                    (name != NULL && ttisstring(name)) ? getstr(tsvalue(name)) : "?");
+    }
+    u->metatable = gco2t(cloneobj(cs, obj2gco(src->metatable)));
+  }
+}
+
+static void fillproto(CloneState *cs, Proto *f, const Proto *src) {
+  lua_State *L = cs->L;
+  int i;
+  f->numparams = src->numparams;
+  f->flag = src->flag | PF_FIXED; /* code and line info belong to the template */
+  f->maxstacksize = src->maxstacksize;
+  f->linedefined = src->linedefined;
+  f->lastlinedefined = src->lastlinedefined;
+  f->code = src->code;
+  f->sizecode = src->sizecode;
+  f->lineinfo = src->lineinfo;
+  f->sizelineinfo = src->sizelineinfo;
+  f->abslineinfo = src->abslineinfo;
+  f->sizeabslineinfo = src->sizeabslineinfo;
+  if (src->source != NULL)
+    f->source = gco2ts(cloneobj(cs, obj2gco(src->source)));
+  if (src->sizek > 0) {
+    f->k = luaM_newvector(L, src->sizek, TValue);
+    f->sizek = src->sizek;
+    for (i = 0; i < src->sizek; i++)
+      setnilvalue(&f->k[i]);
+    for (i = 0; i < src->sizek; i++)
+      clonevalue(cs, &f->k[i], &src->k[i]);
+  }
+  if (src->sizep > 0) {
+    f->p = luaM_newvector(L, src->sizep, Proto *);
+    f->sizep = src->sizep;
+    for (i = 0; i < src->sizep; i++)
+      f->p[i] = NULL;
+    for (i = 0; i < src->sizep; i++)
+      f->p[i] = gco2p(cloneobj(cs, obj2gco(src->p[i])));
+  }
+  if (src->sizeupvalues > 0) {
+    f->upvalues = luaM_newvector(L, src->sizeupvalues, Upvaldesc);
+    f->sizeupvalues = src->sizeupvalues;
+    memcpy(f->upvalues, src->upvalues, cast_sizet(src->sizeupvalues) * sizeof(Upvaldesc));
+    for (i = 0; i < src->sizeupvalues; i++)
+      f->upvalues[i].name = NULL;
+    for (i = 0; i < src->sizeupvalues; i++)
+      if (src->upvalues[i].name != NULL)
+        f->upvalues[i].name = gco2ts(cloneobj(cs, obj2gco(src->upvalues[i].name)));
+  }
+  if (src->sizelocvars > 0) {
+    f->locvars = luaM_newvector(L, src->sizelocvars, LocVar);
+    f->sizelocvars = src->sizelocvars;
+    memcpy(f->locvars, src->locvars, cast_sizet(src->sizelocvars) * sizeof(LocVar));
+    for (i = 0; i < src->sizelocvars; i++)
+      f->locvars[i].varname = NULL;
+    for (i = 0; i < src->sizelocvars; i++)
+      if (src->locvars[i].varname != NULL)
+        f->locvars[i].varname = gco2ts(cloneobj(cs, obj2gco(src->locvars[i].varname)));
+  }
+}
+
+static void fillobj(CloneState *cs, GCObject *o, GCObject *c) {
+  int i;
+  switch (o->tt) {
+  case LUA_VTABLE:
+  case LUA_VARRAY:
+    filltable(cs, gco2t(c), gco2t(o));
+    break;
+  case LUA_VUSERDATA:
+    filludata(cs, gco2u(c), gco2u(o));
+    break;
+  case LUA_VLCL: {
+    LClosure *cl = gco2lcl(c), *src = gco2lcl(o);
+    cl->p = gco2p(cloneobj(cs, obj2gco(src->p)));
+    for (i = 0; i < src->nupvalues; i++)
+      if (src->upvals[i] != NULL)
+        cl->upvals[i] = gco2upv(cloneobj(cs, obj2gco(src->upvals[i])));
+    break;
+  }
+  case LUA_VCCL: {
+    CClosure *cl = gco2ccl(c), *src = gco2ccl(o);
+    for (i = 0; i < src->nupvalues; i++)
+      clonevalue(cs, &cl->upvalue[i], &src->upvalue[i]);
+    break;
+  }
+  case LUA_VPROTO:
+    fillproto(cs, gco2p(c), gco2p(o));
+    break;
+  case LUA_VUPVAL:
+    clonevalue(cs, gco2upv(c)->v.p, gco2upv(o)->v.p);
+    break;
+  default: /* strings and the main thread are complete */
+    break;
+  }
+}
+
+/* Run the '__clone' hook of 'c' (if any), then register its finalizer. */
+static void finishobj(CloneState *cs, GCObject *o, GCObject *c) {
+  lua_State *L = cs->L;
+  Table *srcmt, *mt;
+  void *srcmem;
+  const TValue *hook;
+  if (o->tt == LUA_VUSERDATA) {
+    srcmt = gco2u(o)->metatable;
+    mt = gco2u(c)->metatable;
+    srcmem = getudatamem(gco2u(o));
+  } else if (o->tt == LUA_VTABLE || o->tt == LUA_VARRAY) {
+    srcmt = gco2t(o)->metatable;
+    mt = gco2t(c)->metatable;
+    srcmem = NULL;
+  } else
+    return;
+  if (srcmt == NULL)
+    return;
+  hook = rawfield(srcmt, "__clone");
+  if (hook != NULL) {
+    if (!ttislcf(hook))
+      luaG_runerror(L, "'__clone' must be a light C function");
+    luaD_checkstack(L, 4);
+    setfvalue(s2v(L->top.p), fvalue(hook));
+    setnilvalue(s2v(L->top.p + 1)); /* Slot 0 receiver */
+    setgcovalue(L, s2v(L->top.p + 2), c);
+    setpvalue(s2v(L->top.p + 3), srcmem);
+    L->top.p += 4;
+    luaD_callnoyield(L, L->top.p - 4, 0);
+  }
+  luaC_checkfinalizer(L, c, mt);
+}
+
+static void f_clone(lua_State *L, void *ud) {
+  CloneState *cs = (CloneState *)ud;
+  global_State *g = G(L), *from = cs->from;
+  Table *reg = hvalue(&g->l_registry), *freg = hvalue(&from->l_registry);
+  int i;
+  cs->size = 256;
+  cs->src = (GCObject **)cs_realloc(cs, NULL, 0, cast_sizet(cs->size) * sizeof(GCObject *));
+  cs->dst = (GCObject **)cs_realloc(cs, NULL, 0, cast_sizet(cs->size) * sizeof(GCObject *));
+  cs->nslots = 512;
+  cs->slots = (int *)cs_realloc(cs, NULL, 0, cs->nslots * sizeof(int));
+  memset(cs->slots, 0, cs->nslots * sizeof(int));
+  /* the main thread and the registry map onto the clone's own */
+  insert(cs, obj2gco(mainthread(from)), obj2gco(L));
+  insert(cs, obj2gco(freg), obj2gco(reg));
+  luaH_resize(L, reg, freg->asize, allocsizenode(freg));
+  for (i = 0; i < LUA_NUMTYPES; i++)
+    if (from->mt[i] != NULL)
+      g->mt[i] = gco2t(cloneobj(cs, obj2gco(from->mt[i])));
+  /* luaL_ref slots, including the free list (plain integers) */
+  if (from->registry_array.size > g->registry_array.size) {
+    int osize = g->registry_array.size;
+    g->registry_array.arr =
+        (TValue *)cs_realloc(cs, g->registry_array.arr, cast_sizet(osize) * sizeof(TValue),
+                             cast_sizet(from->registry_array.size) * sizeof(TValue));
+    g->registry_array.size = from->registry_array.size;
+    for (i = osize; i < g->registry_array.size; i++)
+      setnilvalue(&g->registry_array.arr[i]);
+  }
+  for (i = 0; i < from->registry_array.size; i++)
+    clonevalue(cs, &g->registry_array.arr[i], &from->registry_array.arr[i]);
+  g->registry_array.freelist = from->registry_array.freelist;
+  g->registry_array.firstfree = from->registry_array.firstfree;
+  cs->filled = 0;
+  while (cs->filled < cs->n) {
+    int e = cs->filled++;
+    fillobj(cs, cs->src[e], cs->dst[e]);
+  }
+  for (i = 0; i < cs->n; i++)
+    finishobj(cs, cs->src[i], cs->dst[i]);
+}
+
+LUA_API lua_State *spt_clonestate(lua_State *from, char *err, size_t errsize) {
+  global_State *fg = G(from);
+  CloneState cs;
+  lua_State *L;
+  lu_byte gcstp;
+  TStatus status;
+  L = lua_newstate(fg->frealloc, fg->ud, fg->seed);
+  if (L == NULL) {
+    if (err != NULL && errsize > 0)
+      snprintf(err, errsize, "not enough memory");
+    return NULL;
+  }
+  G(L)->panic = fg->panic;
+  G(L)->warnf = fg->warnf;
+  /* lauxlib's warning functions keep the state itself as their data */
+  G(L)->ud_warn = (fg->ud_warn == (void *)mainthread(fg)) ? (void *)L : fg->ud_warn;
+  memcpy(G(L)->gcparams, fg->gcparams, sizeof(fg->gcparams));
+  memset(&cs, 0, sizeof(cs));
+  cs.L = L;
+  cs.from = fg;
+  gcstp = G(L)->gcstp;
+  G(L)->gcstp |= GCSTPGC; /* objects in flight are only in the map */
+  status = luaD_rawrunprotected(L, f_clone, &cs);
+  G(L)->gcstp = gcstp;
+  freemap(&cs);
+  if (status != LUA_OK) {
+    if (err != NULL && errsize > 0) {
+      const char *msg = (status == LUA_ERRMEM) ? "not enough memory"
+                        : ttisstring(s2v(L->top.p - 1)) ? getstr(tsvalue(s2v(L->top.p - 1)))
+                                                       : "clone failed";
+      snprintf(err, errsize, "%s", msg);
+    }
+    lua_close(L);
+    return NULL;
+  }
+  lua_assert(L->top.p == L->ci->func.p + 1);
+  return L;
+}
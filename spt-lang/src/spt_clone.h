@@ -0,0 +1,67 @@
+/*
+** spt_clone.h — clone a fully initialized lua_State.
+**
+** Setting up a state (opening libraries, registering C/C++ bindings,
+** compiling and running module code) can cost milliseconds. When every
+** request needs its own isolated state, do that work once in a *template*
+** state and then clone it:
+**
+**   lua_State *tpl = luaL_newstate();
+**   luaL_openlibs(tpl);
+**   ... register bindings, load modules ...
+**   lua_gc(tpl, LUA_GCCOLLECT);            // drop garbage before cloning
+**
+**   char err[256];
+**   lua_State *L = spt_clonestate(tpl, err, sizeof(err));
+**   ...                                     // independent of tpl and other clones
+**   lua_close(L);
+**   ...
+**   lua_close(tpl);                         // after all its clones
+**
+** The clone gets a deep copy of everything reachable from the template's
+** registry (globals, package.loaded, named metatables, luaL_ref slots) and
+** from the per-type metatables: tables and lists keep their sizes, cycles
+** and shared references are preserved, closures keep sharing upvalues.
+** Prototypes are copied without their bytecode and line information, which
+** the clone shares with the template (immutable, never written by the VM).
+**
+** Userdata blocks are copied byte by byte. When the metatable of a userdata
+** (or of a table) has a '__clone' field, it must be a light C function; it
+** is called on the clone as __clone(nil, obj, src), after every object has
+** been copied, where 'src' is a light userdata pointing at the template's
+** block (NULL for tables). It may fix up or rebuild the copied block, or
+** raise an error to make the clone fail. A userdata whose metatable has
+** '__gc' but no '__clone' cannot be cloned (a byte copy would be released
+** twice). The clone's finalizers are registered after the hooks ran.
+**
+** Rules for the template:
+**   - it must not be running a Lua function that has open upvalues, and it
+**     cannot hold coroutines (only the main thread is cloned);
+**   - it must not be modified or closed while any of its clones is alive,
+**     since their prototypes point into its bytecode;
+**   - cloning only reads it, so several threads may clone the same template
+**     at once (the allocator must then be thread-safe, as the default one is).
+*/
+#ifndef spt_clone_h
+#define spt_clone_h
+
+#include <stddef.h>
+
+#include "lua.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+** Create a new state with the same allocator, panic and warning functions
+** as 'from' and copy its contents into it. Returns NULL on failure and, if
+** 'err' is not NULL, writes the reason into it (truncated to 'errsize').
+*/
+LUA_API lua_State *spt_clonestate(lua_State *from, char *err, size_t errsize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* spt_clone_h */
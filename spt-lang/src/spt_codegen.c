@@ -76,8 +76,10 @@ struct CompileCtx {
  * Helpers — line tracking
  *---------------------------------------------------------------------*/
 static void setline(CompileCtx *C, SourceLocation loc) {
-  if (loc.line > 0)
+  if (loc.line > 0) {
     C->linenumber = loc.line;
+    C->ls.lastline = loc.line; /* luaK_code 以 ls->lastline 记录行号信息 */
+  }
 }
 
 static void setline_node(CompileCtx *C, AstNode *n) {
@@ -4,8 +4,9 @@
 ** 生命周期策略：
 **   - 每次 spt_frontend_parse 创建一个独立 arena，并把源码**复制进 arena**后再做词法/语法，
 **     因此 token 词素与 AST 内所有字符串都指向 arena 内存，杜绝悬垂指针。
-**   - 返回的根节点登记到全局注册表（根指针 -> arena）；spt_frontend_destroy 据此销毁 arena。
-**     模型为单线程（与原 C++ 实现一致：import 期间嵌套 parse/destroy 也按栈式配对）。
+**   - 返回的根节点登记到线程局部注册表（根指针 -> arena）；spt_frontend_destroy 据此销毁
+**     arena。parse/destroy 总在同一线程内栈式配对（import 期间嵌套亦然），因此各线程上的
+**     lua_State 可同时编译。
 */
 #include "spt_frontend.h"
 
@@ -19,14 +20,14 @@
 #include <stdlib.h>
 #include <string.h>
 
-/* ---- 根节点 -> arena 注册表（单线程） ---- */
+/* ---- 根节点 -> arena 注册表（每线程一份） ---- */
 typedef struct ArenaReg {
   struct AstNode *root;
   SptArena *arena;
   struct ArenaReg *next;
 } ArenaReg;
 
-static ArenaReg *g_reg = NULL;
+static SPT_THREAD_LOCAL ArenaReg *g_reg = NULL;
 
 static void reg_add(struct AstNode *root, SptArena *a) {
   ArenaReg *r = (ArenaReg *)malloc(sizeof(ArenaReg));
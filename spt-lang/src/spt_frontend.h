@@ -13,6 +13,15 @@
 
 #include "luaconf.h" /* for LUALIB_API */
 
+/* 线程局部存储说明符：MSVC 的 C 模式不认 _Thread_local。 */
+#ifndef SPT_THREAD_LOCAL
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SPT_THREAD_LOCAL __declspec(thread)
+#else
+#define SPT_THREAD_LOCAL _Thread_local
+#endif
+#endif
+
 struct AstNode;
 
 LUALIB_API struct AstNode *spt_frontend_parse(const char *sourceCode_, const char *filename_);
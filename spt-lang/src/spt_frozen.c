@@ -0,0 +1,177 @@
+/*
+** spt_frozen.c — compiled chunks shared by many lua_States (see spt_frozen.h).
+**
+** A frozen chunk is a binary dump in a malloc'd block plus a reference count.
+** States load it with lua_load in fixed mode ("B"), so their prototypes point
+** into the block; each state records the chunks it loaded in g->frozen and
+** releases them in lua_close, after its last object is gone.
+*/
+#define spt_frozen_c
+#define LUA_CORE
+
+#include "lprefix.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "lua.h"
+
+#include "lapi.h"
+#include "lstate.h"
+
+#include "spt_frozen.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+typedef volatile long RefCount;
+#define refinc(r) _InterlockedIncrement(r)
+#define refdec(r) _InterlockedDecrement(r)
+#else
+typedef long RefCount;
+#define refinc(r) __atomic_add_fetch(r, 1, __ATOMIC_RELAXED)
+#define refdec(r) __atomic_sub_fetch(r, 1, __ATOMIC_ACQ_REL)
+#endif
+
+struct SPTFrozen {
+  RefCount refs;
+  size_t size; /* bytes in 'data' */
+  char *data;  /* the dump; malloc'd, so aligned for fixed loading */
+};
+
+/* Chunks loaded by one state (g->frozen). */
+struct SPTFrozenRefs {
+  SPTFrozen **v;
+  int n, size;
+};
+
+typedef struct DumpBuf {
+  char *p;
+  size_t n, size;
+} DumpBuf;
+
+static int writer(lua_State *L, const void *p, size_t sz, void *ud) {
+  DumpBuf *b = (DumpBuf *)ud;
+  (void)L;
+  if (b->n + sz > b->size) {
+    size_t nsize = b->size ? b->size : 1024;
+    char *np;
+    while (nsize < b->n + sz)
+      nsize *= 2;
+    np = (char *)realloc(b->p, nsize);
+    if (np == NULL)
+      return 1;
+    b->p = np;
+    b->size = nsize;
+  }
+  if (sz > 0)
+    memcpy(b->p + b->n, p, sz);
+  b->n += sz;
+  return 0;
+}
+
+LUA_API SPTFrozen *spt_freeze(lua_State *L, int idx, int strip) {
+  DumpBuf b = {NULL, 0, 0};
+  SPTFrozen *f;
+  int status;
+  if (!lua_isfunction(L, idx) || lua_iscfunction(L, idx))
+    return NULL;
+  lua_pushvalue(L, idx);
+  status = lua_dump(L, writer, &b, strip);
+  lua_pop(L, 1);
+  f = (SPTFrozen *)malloc(sizeof(SPTFrozen));
+  if (status != 0 || f == NULL) {
+    free(b.p);
+    free(f);
+    return NULL;
+  }
+  f->refs = 1;
+  f->size = b.n;
+  f->data = b.p;
+  return f;
+}
+
+LUA_API void spt_frozen_retain(SPTFrozen *f) { refinc(&f->refs); }
+
+LUA_API void spt_frozen_release(SPTFrozen *f) {
+  if (f != NULL && refdec(&f->refs) == 0) {
+    free(f->data);
+    free(f);
+  }
+}
+
+LUA_API size_t spt_frozen_size(const SPTFrozen *f) { return f->size; }
+
+/*
+** Record that L uses 'f' (once per state). The list is allocated directly
+** (not counted as Lua memory): lua_close frees it after all objects.
+*/
+static int addref(lua_State *L, SPTFrozen *f) {
+  global_State *g = G(L);
+  SPTFrozenRefs *r = g->frozen;
+  int i;
+  if (r == NULL) {
+    r = (SPTFrozenRefs *)(*g->frealloc)(g->ud, NULL, 0, sizeof(SPTFrozenRefs));
+    if (r == NULL)
+      return 0;
+    r->v = NULL;
+    r->n = r->size = 0;
+    g->frozen = r;
+  }
+  for (i = 0; i < r->n; i++)
+    if (r->v[i] == f)
+      return 1;
+  if (r->n == r->size) {
+    int nsize = r->size ? 2 * r->size : 4;
+    SPTFrozen **nv = (SPTFrozen **)(*g->frealloc)(g->ud, r->v, r->size * sizeof(SPTFrozen *),
+                                                  nsize * sizeof(SPTFrozen *));
+    if (nv == NULL)
+      return 0;
+    r->v = nv;
+    r->size = nsize;
+  }
+  r->v[r->n++] = f;
+  spt_frozen_retain(f);
+  return 1;
+}
+
+typedef struct Reader {
+  const char *p;
+  size_t n;
+} Reader;
+
+static const char *reader(lua_State *L, void *ud, size_t *size) {
+  Reader *r = (Reader *)ud;
+  const char *p = r->p;
+  (void)L;
+  *size = r->n;
+  r->p = NULL;
+  r->n = 0;
+  return p;
+}
+
+LUA_API int spt_frozen_push(lua_State *L, SPTFrozen *f) {
+  Reader r;
+  if (!addref(L, f)) { /* before loading: the prototypes will point into 'f' */
+    lua_lock(L);
+    setsvalue2s(L, L->top.p, G(L)->memerrmsg); /* preallocated */
+    api_incr_top(L);
+    lua_unlock(L);
+    return LUA_ERRMEM;
+  }
+  r.p = f->data;
+  r.n = f->size;
+  return lua_load(L, reader, &r, "=(frozen)", "B");
+}
+
+void spt_frozen_close(lua_State *L) {
+  global_State *g = G(L);
+  SPTFrozenRefs *r = g->frozen;
+  int i;
+  if (r == NULL)
+    return;
+  g->frozen = NULL;
+  for (i = 0; i < r->n; i++)
+    spt_frozen_release(r->v[i]);
+  (*g->frealloc)(g->ud, r->v, r->size * sizeof(SPTFrozen *), 0);
+  (*g->frealloc)(g->ud, r, sizeof(SPTFrozenRefs), 0);
+}
@@ -0,0 +1,72 @@
+/*
+** spt_frozen.h — compiled chunks shared by many lua_States.
+**
+** Loading the same module into N states normally keeps N copies of its
+** bytecode, line information and string constants. A frozen chunk is a
+** compiled function kept once, outside any state, and loaded into as many
+** states as needed (on any threads):
+**
+**   SPTFrozen *fz;
+**   luaL_loadbuffer(L0, src, len, "=app");     // compile once, anywhere
+**   fz = spt_freeze(L0, -1, 0);
+**   lua_pop(L0, 1);
+**
+**   // per state, e.g. per tenant
+**   if (spt_frozen_push(L, fz) == LUA_OK)       // like lua_load
+**     lua_call(L, 0, 0);
+**
+**   spt_frozen_release(fz);                     // states keep their own refs
+**
+** The chunk is stored as a binary dump and loaded in fixed mode (lua_load
+** mode "B"): each state builds its own prototypes, constant arrays and
+** short strings, while bytecode, line information and the bytes of long
+** strings point into the shared block. Loading is cheap (no parsing or code
+** generation) and the state's heap only grows by the small per-state parts.
+**
+** A frozen chunk is reference counted (atomically): spt_freeze returns it
+** with one reference, and every state that loaded it holds one more until
+** lua_close, which drops it after all objects and finalizers are gone.
+** The pushed function gets fresh upvalues, the first one being the global
+** table, exactly as with lua_load; only prototypes are shared, never values.
+*/
+#ifndef spt_frozen_h
+#define spt_frozen_h
+
+#include <stddef.h>
+
+#include "lua.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct SPTFrozen SPTFrozen;
+
+/*
+** Freeze the Lua function at 'idx' (normally a chunk returned by lua_load).
+** With 'strip' set, debug information is left out. Returns NULL if the
+** value is not a Lua function or memory runs out. The result does not
+** depend on L, which may be closed afterwards.
+*/
+LUA_API SPTFrozen *spt_freeze(lua_State *L, int idx, int strip);
+
+/*
+** Push a new closure of the frozen chunk, as lua_load does. Returns LUA_OK,
+** or an error status with the message pushed instead.
+*/
+LUA_API int spt_frozen_push(lua_State *L, SPTFrozen *f);
+
+LUA_API void spt_frozen_retain(SPTFrozen *f);
+LUA_API void spt_frozen_release(SPTFrozen *f);
+
+/* Bytes held by the shared block (not counted by any state). */
+LUA_API size_t spt_frozen_size(const SPTFrozen *f);
+
+/* Internal: drop the state's references (called by lua_close). */
+void spt_frozen_close(lua_State *L);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* spt_frozen_h */
@@ -0,0 +1,571 @@
+/*
+** spt_heapprof.c — SPT allocation profiler (see spt_heapprof.h).
+**
+** Two hooks from lgc.c, both behind a single `g->heapprof != NULL` test:
+**   - spt_heapprof_alloc (luaC_newobjdt): byte countdown; when it expires the
+**     new object is charged to its site and remembered in `objs`.
+**   - spt_heapprof_free (freeobj): forgets a remembered object and updates
+**     its site's live counters.
+** Everything here uses the C heap, never the Lua allocator, so recording a
+** sample can neither trigger a collection nor be recorded itself.
+*/
+#define spt_heapprof_c
+#define LUA_CORE
+
+#include "lprefix.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lua.h"
+
+#include "ldebug.h"
+#include "lgc.h"
+#include "lobject.h"
+#include "lstate.h"
+
+#include "spt_heapprof.h"
+
+#define HP_LABELBUF 256
+
+typedef struct HeapSite {
+  const void *key; /* Proto of the site; &c_site_key for C-only; NULL = Proto freed */
+  int line;
+  lu_byte tt;
+  char *label; /* "<src>:<line> <type>" */
+  char *func;  /* "function <src:ld>", "main chunk" or "[C]" */
+  unsigned long long allocs, alloc_bytes; /* sampled allocations, estimated bytes */
+  unsigned long long live;                /* sampled objects not freed yet */
+  unsigned int nextsame; /* next site of the same Proto + 1, 0 = last */
+} HeapSite;
+
+typedef struct HeapObj {
+  GCObject *o; /* NULL = empty slot */
+  unsigned int site;
+  size_t size;   /* size at allocation */
+  size_t weight; /* bytes this sample stands for: max(size, interval) */
+} HeapObj;
+
+struct SPTHeapProf {
+  size_t interval;
+  l_mem countdown; /* bytes until the next sample */
+  unsigned int rng;
+  int busy; /* building a snapshot: do not sample our own objects */
+
+  HeapSite *sites;
+  unsigned int nsites, sizesites;
+  unsigned int *sitemap; /* open addressing: site index + 1, 0 = empty */
+  unsigned int sizesitemap;
+  unsigned int *protomap; /* open addressing by Proto: its newest site + 1 */
+  unsigned int sizeprotomap, nprotos;
+
+  HeapObj *objs; /* open addressing keyed by object address */
+  size_t sizeobjs, nobjs;
+  unsigned long long samples;
+};
+
+static const char c_site_key = 0;
+
+/* =====================================================================
+** Sampling
+** ===================================================================== */
+
+/* Next countdown: uniform in [1, 2*interval], mean = interval. */
+static l_mem next_countdown(SPTHeapProf *H) {
+  if (H->interval <= 1)
+    return 1;
+  H->rng ^= H->rng << 13; /* xorshift32 */
+  H->rng ^= H->rng >> 17;
+  H->rng ^= H->rng << 5;
+  return (l_mem)(H->rng % (2 * H->interval)) + 1;
+}
+
+static unsigned int ptr_hash(const void *p) {
+  size_t h = (size_t)p;
+  h ^= h >> 17;
+  h *= 0x9E3779B1u;
+  return (unsigned int)(h ^ (h >> 15));
+}
+
+static unsigned int site_hash(const void *key, int line, lu_byte tt) {
+  return ptr_hash(key) ^ ((unsigned int)line * 31u) ^ tt;
+}
+
+static int sitemap_grow(SPTHeapProf *H) {
+  unsigned int nsize = H->sizesitemap ? H->sizesitemap * 2 : 64;
+  unsigned int *nm = (unsigned int *)calloc(nsize, sizeof(unsigned int));
+  if (!nm)
+    return 0;
+  for (unsigned int i = 0; i < H->nsites; i++) {
+    HeapSite *s = &H->sites[i];
+    if (!s->key)
+      continue; /* dead Proto: never looked up again */
+    unsigned int j = site_hash(s->key, s->line, s->tt) & (nsize - 1);
+    while (nm[j])
+      j = (j + 1) & (nsize - 1);
+    nm[j] = i + 1;
+  }
+  free(H->sitemap);
+  H->sitemap = nm;
+  H->sizesitemap = nsize;
+  return 1;
+}
+
+static int protomap_grow(SPTHeapProf *H) {
+  unsigned int nsize = H->sizeprotomap ? H->sizeprotomap * 2 : 64;
+  unsigned int *nm = (unsigned int *)calloc(nsize, sizeof(unsigned int));
+  if (!nm)
+    return 0;
+  for (unsigned int i = 0; i < H->sizeprotomap; i++) {
+    unsigned int h = H->protomap[i];
+    if (!h)
+      continue;
+    unsigned int j = ptr_hash(H->sites[h - 1].key) & (nsize - 1);
+    while (nm[j])
+      j = (j + 1) & (nsize - 1);
+    nm[j] = h;
+  }
+  free(H->protomap);
+  H->protomap = nm;
+  H->sizeprotomap = nsize;
+  return 1;
+}
+
+/* Chain site `si` in front of the other sites of its Proto. */
+static int protomap_add(SPTHeapProf *H, unsigned int si) {
+  const void *key = H->sites[si].key;
+  if ((H->nprotos + 1) * 4 > H->sizeprotomap * 3 && !protomap_grow(H))
+    return 0;
+  unsigned int mask = H->sizeprotomap - 1;
+  unsigned int j = ptr_hash(key) & mask;
+  while (H->protomap[j] && H->sites[H->protomap[j] - 1].key != key)
+    j = (j + 1) & mask;
+  if (H->protomap[j])
+    H->sites[si].nextsame = H->protomap[j];
+  else
+    H->nprotos++;
+  H->protomap[j] = si + 1;
+  return 1;
+}
+
+/* A freed Proto: mark its sites dead so a new Proto at the same address
+   gets sites of its own. Only that Proto's chain is visited. */
+static void protomap_drop(SPTHeapProf *H, const void *key) {
+  unsigned int mask = H->sizeprotomap - 1;
+  unsigned int j = ptr_hash(key) & mask;
+  while (H->protomap[j] && H->sites[H->protomap[j] - 1].key != key)
+    j = (j + 1) & mask;
+  unsigned int h = H->protomap[j];
+  if (!h)
+    return; /* never sampled */
+  H->nprotos--;
+  /* Backward-shift deletion, as for the object table. */
+  for (unsigned int k = (j + 1) & mask; H->protomap[k]; k = (k + 1) & mask) {
+    unsigned int home = ptr_hash(H->sites[H->protomap[k] - 1].key) & mask;
+    if (((k - home) & mask) >= ((k - j) & mask)) {
+      H->protomap[j] = H->protomap[k];
+      j = k;
+    }
+  }
+  H->protomap[j] = 0;
+  for (; h; h = H->sites[h - 1].nextsame)
+    H->sites[h - 1].key = NULL;
+}
+
+static char *hp_strdup(const char *s) {
+  size_t n = strlen(s) + 1;
+  char *d = (char *)malloc(n);
+  if (d)
+    memcpy(d, s, n);
+  return d;
+}
+
+/* SPT type names (as returned by typeof) of the sampled object kinds. */
+static const char *obj_typename(lu_byte tt) {
+  switch (tt) {
+  case LUA_VTABLE:
+    return "map";
+  case LUA_VARRAY:
+    return "list";
+  case LUA_VSHRSTR:
+  case LUA_VLNGSTR:
+    return "str";
+  case LUA_VLCL:
+  case LUA_VCCL:
+    return "fn";
+  case LUA_VTHREAD:
+    return "coro";
+  default:
+    return "userdata";
+  }
+}
+
+/* Fill the labels of a new site. Returns 0 on out of memory. */
+static int site_describe(HeapSite *s, const Proto *p, int line) {
+  char src[LUA_IDSIZE], buf[HP_LABELBUF];
+  const char *tname = obj_typename(s->tt);
+  if (p && p->source)
+    luaO_chunkid(src, getstr(p->source), tsslen(p->source));
+  else
+    memcpy(src, p ? "?" : "[C]", p ? 2 : 4);
+  if (p)
+    snprintf(buf, sizeof(buf), "%s:%d %s", src, line, tname);
+  else
+    snprintf(buf, sizeof(buf), "%s %s", src, tname);
+  s->label = hp_strdup(buf);
+  if (!p)
+    snprintf(buf, sizeof(buf), "[C]");
+  else if (p->linedefined == 0)
+    snprintf(buf, sizeof(buf), "main chunk");
+  else
+    snprintf(buf, sizeof(buf), "function <%s:%d>", src, p->linedefined);
+  s->func = hp_strdup(buf);
+  if (!s->label || !s->func) {
+    free(s->label);
+    free(s->func);
+    return 0;
+  }
+  return 1;
+}
+
+/* Find or create the site (key, line, tt). Returns its index, or -1. */
+static int site_get(SPTHeapProf *H, const Proto *p, int line, lu_byte tt) {
+  const void *key = p ? (const void *)p : (const void *)&c_site_key;
+  if ((H->nsites + 1) * 4 > H->sizesitemap * 3 && !sitemap_grow(H))
+    return -1;
+  unsigned int j = site_hash(key, line, tt) & (H->sizesitemap - 1);
+  while (H->sitemap[j]) {
+    HeapSite *s = &H->sites[H->sitemap[j] - 1];
+    if (s->key == key && s->line == line && s->tt == tt)
+      return (int)(H->sitemap[j] - 1);
+    j = (j + 1) & (H->sizesitemap - 1);
+  }
+  if (H->nsites == H->sizesites) {
+    unsigned int nsize = H->sizesites ? H->sizesites * 2 : 32;
+    HeapSite *ns = (HeapSite *)realloc(H->sites, nsize * sizeof(HeapSite));
+    if (!ns)
+      return -1;
+    H->sites = ns;
+    H->sizesites = nsize;
+  }
+  HeapSite *s = &H->sites[H->nsites];
+  memset(s, 0, sizeof(*s));
+  s->key = key;
+  s->line = line;
+  s->tt = tt;
+  if (!site_describe(s, p, line))
+    return -1;
+  if (p && !protomap_add(H, H->nsites)) {
+    free(s->label);
+    free(s->func);
+    return -1;
+  }
+  H->sitemap[j] = H->nsites + 1;
+  return (int)H->nsites++;
+}
+
+static int objs_grow(SPTHeapProf *H) {
+  size_t nsize = H->sizeobjs ? H->sizeobjs * 2 : 1024;
+  HeapObj *nt = (HeapObj *)calloc(nsize, sizeof(HeapObj));
+  if (!nt)
+    return 0;
+  for (size_t i = 0; i < H->sizeobjs; i++) {
+    HeapObj *e = &H->objs[i];
+    if (!e->o)
+      continue;
+    size_t j = ptr_hash(e->o) & (nsize - 1);
+    while (nt[j].o)
+      j = (j + 1) & (nsize - 1);
+    nt[j] = *e;
+  }
+  free(H->objs);
+  H->objs = nt;
+  H->sizeobjs = nsize;
+  return 1;
+}
+
+/* Nearest Lua frame of `L` (allocations from C are charged to its caller). */
+static const Proto *alloc_site(lua_State *L, int *line) {
+  for (CallInfo *ci = L->ci; ci != &L->base_ci; ci = ci->previous) {
+    if (isLua(ci)) {
+      const Proto *p = ci_func(ci)->p;
+      int pc = pcRel(ci->u.l.savedpc, p);
+      *line = (pc >= 0 && pc < p->sizecode) ? luaG_getfuncline(p, pc) : p->linedefined;
+      return p;
+    }
+  }
+  *line = 0;
+  return NULL;
+}
+
+void spt_heapprof_alloc(lua_State *L, GCObject *o, size_t sz) {
+  SPTHeapProf *H = G(L)->heapprof;
+  if (o->tt == LUA_VPROTO || o->tt == LUA_VUPVAL || H->busy)
+    return;
+  H->countdown -= (l_mem)sz;
+  if (H->countdown > 0)
+    return;
+  H->countdown = next_countdown(H);
+  if ((H->nobjs + 1) * 4 > H->sizeobjs * 3 && !objs_grow(H))
+    return;
+  int line;
+  const Proto *p = alloc_site(L, &line);
+  int si = site_get(H, p, line, o->tt);
+  if (si < 0)
+    return;
+  size_t j = ptr_hash(o) & (H->sizeobjs - 1);
+  while (H->objs[j].o) /* a freed object's slot is always cleared */
+    j = (j + 1) & (H->sizeobjs - 1);
+  HeapObj *e = &H->objs[j];
+  e->o = o;
+  e->site = (unsigned int)si;
+  e->size = sz;
+  e->weight = sz > H->interval ? sz : H->interval;
+  HeapSite *s = &H->sites[si];
+  s->allocs++;
+  s->alloc_bytes += e->weight;
+  s->live++;
+  H->nobjs++;
+  H->samples++;
+}
+
+void spt_heapprof_free(lua_State *L, GCObject *o) {
+  SPTHeapProf *H = G(L)->heapprof;
+  if (o->tt == LUA_VPROTO) { /* its sites can no longer be hit */
+    protomap_drop(H, o);
+    return;
+  }
+  if (H->nobjs == 0)
+    return;
+  size_t mask = H->sizeobjs - 1;
+  size_t j = ptr_hash(o) & mask;
+  while (H->objs[j].o != o) {
+    if (!H->objs[j].o)
+      return; /* not sampled */
+    j = (j + 1) & mask;
+  }
+  H->sites[H->objs[j].site].live--;
+  H->nobjs--;
+  /* Backward-shift deletion keeps probe chains intact without tombstones. */
+  for (size_t k = (j + 1) & mask; H->objs[k].o; k = (k + 1) & mask) {
+    size_t home = ptr_hash(H->objs[k].o) & mask;
+    if (((k - home) & mask) >= ((k - j) & mask)) {
+      H->objs[j] = H->objs[k];
+      j = k;
+    }
+  }
+  H->objs[j].o = NULL;
+}
+
+/* =====================================================================
+** Reports
+** ===================================================================== */
+
+/* Estimated bytes currently held by each site's live objects: objects are
+   measured now (tables and arrays grow after allocation) and scaled by the
+   sample weight. `bytes` has one entry per site. */
+static void live_bytes(SPTHeapProf *H, unsigned long long *bytes) {
+  memset(bytes, 0, (H->nsites ? H->nsites : 1) * sizeof(*bytes));
+  for (size_t i = 0; i < H->sizeobjs; i++) {
+    HeapObj *e = &H->objs[i];
+    if (!e->o)
+      continue;
+    size_t now = (size_t)luaC_objsize(e->o);
+    bytes[e->site] += (e->size > 0) ? (unsigned long long)((double)e->weight * now / e->size) : now;
+  }
+}
+
+typedef struct SiteRow {
+  unsigned int site;
+  unsigned long long bytes;
+} SiteRow;
+
+static int row_cmp(const void *a, const void *b) {
+  const SiteRow *x = (const SiteRow *)a, *y = (const SiteRow *)b;
+  if (x->bytes != y->bytes)
+    return x->bytes < y->bytes ? 1 : -1;
+  return x->site < y->site ? -1 : (x->site > y->site);
+}
+
+LUA_API int spt_heapprof_dump(lua_State *L, const char *path, int topn) {
+  SPTHeapProf *H = G(L)->heapprof;
+  if (!H)
+    return -1;
+  unsigned int n = H->nsites;
+  unsigned long long *bytes = (unsigned long long *)malloc((n ? n : 1) * sizeof(*bytes));
+  SiteRow *rows = (SiteRow *)malloc((n ? n : 1) * sizeof(SiteRow));
+  if (!bytes || !rows) {
+    free(bytes);
+    free(rows);
+    return -1;
+  }
+  live_bytes(H, bytes);
+  unsigned long long total = 0;
+  for (unsigned int i = 0; i < n; i++) {
+    rows[i].site = i;
+    rows[i].bytes = bytes[i];
+    total += bytes[i];
+  }
+  qsort(rows, n, sizeof(SiteRow), row_cmp);
+  FILE *f = path ? fopen(path, "w") : stderr;
+  if (!f) {
+    free(bytes);
+    free(rows);
+    return -1;
+  }
+  fprintf(f, "# heap profile: interval %zu bytes, %llu samples, %zu live, ~%llu live bytes\n",
+          H->interval, H->samples, H->nobjs, total);
+  fprintf(f, "%12s %8s %14s %8s  %s\n", "live_bytes", "live", "alloc_bytes", "allocs", "site");
+  if (topn <= 0 || (unsigned int)topn > n)
+    topn = (int)n;
+  for (int i = 0; i < topn; i++) {
+    HeapSite *s = &H->sites[rows[i].site];
+    fprintf(f, "%12llu %8llu %14llu %8llu  %s  [%s]\n", rows[i].bytes, s->live, s->alloc_bytes,
+            s->allocs, s->label, s->func);
+  }
+  free(bytes);
+  free(rows);
+  if (!path)
+    return fflush(f) == 0 ? 0 : -1;
+  return fclose(f) == 0 ? 0 : -1;
+}
+
+static void set_int(lua_State *L, const char *k, unsigned long long v) {
+  lua_pushinteger(L, (lua_Integer)v);
+  lua_setfield(L, -2, k);
+}
+
+static unsigned long long get_int(lua_State *L, const char *k) {
+  lua_getfield(L, -1, k);
+  unsigned long long v = (unsigned long long)lua_tointeger(L, -1);
+  lua_pop(L, 1);
+  return v;
+}
+
+typedef struct SnapshotCtx {
+  SPTHeapProf *H;
+  const unsigned long long *bytes;
+} SnapshotCtx;
+
+/* Runs under lua_pcall: allocation errors must not leave H->busy set. */
+static int build_snapshot(lua_State *L) {
+  const SnapshotCtx *ctx = (const SnapshotCtx *)lua_touserdata(L, 2);
+  SPTHeapProf *H = ctx->H;
+  lua_createtable(L, 0, (int)H->nsites);
+  for (unsigned int i = 0; i < H->nsites; i++) {
+    HeapSite *s = &H->sites[i];
+    unsigned long long live = s->live, b = ctx->bytes[i];
+    unsigned long long allocs = s->allocs, ab = s->alloc_bytes;
+    /* A chunk loaded again gets new Protos: merge its sites by label. */
+    if (lua_getfield(L, -1, s->label) == LUA_TTABLE) {
+      live += get_int(L, "live");
+      b += get_int(L, "bytes");
+      allocs += get_int(L, "allocs");
+      ab += get_int(L, "alloc_bytes");
+    } else {
+      lua_pop(L, 1);
+      lua_createtable(L, 0, 5);
+      lua_pushstring(L, s->func);
+      lua_setfield(L, -2, "func");
+      lua_pushvalue(L, -1);
+      lua_setfield(L, -3, s->label);
+    }
+    set_int(L, "live", live);
+    set_int(L, "bytes", b);
+    set_int(L, "allocs", allocs);
+    set_int(L, "alloc_bytes", ab);
+    lua_pop(L, 1);
+  }
+  return 1;
+}
+
+LUA_API int spt_heapprof_pushsnapshot(lua_State *L) {
+  SPTHeapProf *H = G(L)->heapprof;
+  if (!H)
+    return 0;
+  unsigned long long *bytes =
+      (unsigned long long *)malloc((H->nsites ? H->nsites : 1) * sizeof(*bytes));
+  if (!bytes)
+    return 0;
+  live_bytes(H, bytes);
+  SnapshotCtx ctx = {H, bytes};
+  H->busy = 1;
+  lua_pushcfunction(L, build_snapshot);
+  lua_pushnil(L); /* Slot 0 receiver */
+  lua_pushlightuserdata(L, &ctx);
+  int status = lua_pcall(L, 2, 1, 0);
+  H->busy = 0;
+  free(bytes);
+  if (status != LUA_OK) {
+    lua_pop(L, 1); /* error object */
+    return 0;
+  }
+  return 1;
+}
+
+LUA_API void spt_heapprof_getstats(lua_State *L, SPTHeapProfStats *st) {
+  SPTHeapProf *H = G(L)->heapprof;
+  if (!st)
+    return;
+  memset(st, 0, sizeof(*st));
+  if (!H)
+    return;
+  st->samples = H->samples;
+  st->live = H->nobjs;
+  st->sites = H->nsites;
+  unsigned long long *bytes =
+      (unsigned long long *)malloc((H->nsites ? H->nsites : 1) * sizeof(*bytes));
+  if (!bytes)
+    return;
+  live_bytes(H, bytes);
+  for (unsigned int i = 0; i < H->nsites; i++)
+    st->live_bytes += bytes[i];
+  free(bytes);
+}
+
+/* =====================================================================
+** Lifecycle
+** ===================================================================== */
+
+LUA_API int spt_heapprof_start(lua_State *L, size_t interval) {
+  global_State *g = G(L);
+  SPTHeapProf *H = g->heapprof;
+  if (!H) {
+    H = (SPTHeapProf *)calloc(1, sizeof(SPTHeapProf));
+    if (!H || !objs_grow(H) || !sitemap_grow(H) || !protomap_grow(H)) {
+      if (H) {
+        free(H->sitemap);
+        free(H->objs);
+        free(H);
+      }
+      return 0;
+    }
+    H->rng = (unsigned int)(size_t)H | 1u;
+  }
+  H->interval = interval > 0 ? interval : SPT_HEAPPROF_DEFAULT_INTERVAL;
+  H->countdown = next_countdown(H);
+  g->heapprof = H;
+  return 1;
+}
+
+LUA_API int spt_heapprof_active(lua_State *L) { return G(L)->heapprof != NULL; }
+
+LUA_API void spt_heapprof_stop(lua_State *L) {
+  global_State *g = G(L);
+  SPTHeapProf *H = g->heapprof;
+  if (!H)
+    return;
+  g->heapprof = NULL;
+  for (unsigned int i = 0; i < H->nsites; i++) {
+    free(H->sites[i].label);
+    free(H->sites[i].func);
+  }
+  free(H->sites);
+  free(H->sitemap);
+  free(H->protomap);
+  free(H->objs);
+  free(H);
+}
+
+void spt_heapprof_close(lua_State *L) { spt_heapprof_stop(L); }
@@ -0,0 +1,97 @@
+/*
+** spt_heapprof.h — SPT allocation (heap) profiler.
+**
+** Attributes GC allocations (tables, arrays, strings, closures, userdata,
+** threads) to the allocation site: the Proto + source line of the nearest
+** Lua frame, plus the object type. An allocation made by a C function (e.g.
+** string.rep) is charged to the Lua line that called it.
+**
+** To keep the overhead low only a sample of the allocations is recorded:
+** on average one every `interval` bytes (randomized countdown, so periodic
+** allocation patterns do not alias). A sampled object stands for
+** max(size, interval) bytes, which makes the byte estimates unbiased; with
+** interval 1 every allocation is recorded exactly. Sampled objects are
+** remembered until the collector frees them, so each site also knows how
+** much of what it allocated is still live.
+**
+** Usage:
+**
+**   spt_heapprof_start(L, 0);        // 0 = SPT_HEAPPROF_DEFAULT_INTERVAL
+**   lua_pcall(L, 0, 0, 0);
+**   spt_heapprof_dump(L, "heap.txt", 20);
+**   spt_heapprof_stop(L);
+**
+** or from a script:
+**
+**   collectgarbage("heapprofile", 4096);
+**   auto before = collectgarbage("heapsnapshot");
+**   ...
+**   auto after = collectgarbage("heapsnapshot");  // diff before/after by key
+**
+** Snapshots are maps keyed by "<src>:<line> <type>" whose values are maps
+** {func, live, bytes, allocs, alloc_bytes}; see spt_heapprof_pushsnapshot.
+*/
+#ifndef spt_heapprof_h
+#define spt_heapprof_h
+
+#include <stddef.h>
+
+#include "lua.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Default sampling interval: one sample per 4 KiB allocated on average. */
+#define SPT_HEAPPROF_DEFAULT_INTERVAL 4096
+
+typedef struct SPTHeapProfStats {
+  unsigned long long samples;    /* allocations recorded */
+  unsigned long long live;       /* ... of which are not freed yet */
+  unsigned long long sites;      /* distinct allocation sites */
+  unsigned long long live_bytes; /* estimated bytes held by live objects */
+} SPTHeapProfStats;
+
+/*
+** Start recording allocations of `L`'s state. Calling it again while active
+** only changes the interval. Returns 1 on success, 0 on out of memory.
+*/
+LUA_API int spt_heapprof_start(lua_State *L, size_t interval);
+
+/* Stop recording and drop every collected site. */
+LUA_API void spt_heapprof_stop(lua_State *L);
+
+/* Non-zero while the heap profiler is active. */
+LUA_API int spt_heapprof_active(lua_State *L);
+
+/*
+** Write the `topn` sites holding the most live bytes (topn <= 0: all) as a
+** text table to `path` (NULL = stderr). Returns 0 on success, -1 if the
+** profiler is not active or the file could not be written.
+*/
+LUA_API int spt_heapprof_dump(lua_State *L, const char *path, int topn);
+
+/*
+** Push a snapshot map of every site (see the header comment). Returns 1, or
+** pushes nothing and returns 0 if the profiler is not active or building the
+** map ran out of memory (tracking continues either way).
+*/
+LUA_API int spt_heapprof_pushsnapshot(lua_State *L);
+
+/* Fill `st` with the current counters (zeros if not active). */
+LUA_API void spt_heapprof_getstats(lua_State *L, SPTHeapProfStats *st);
+
+struct GCObject;
+
+/* Internal: GC hooks (only called while g->heapprof is set). */
+void spt_heapprof_alloc(lua_State *L, struct GCObject *o, size_t sz);
+void spt_heapprof_free(lua_State *L, struct GCObject *o);
+
+/* Internal: free the profiler (called by lua_close). */
+void spt_heapprof_close(lua_State *L);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* spt_heapprof_h */
@@ -185,7 +185,9 @@ SPTJitState *sptjit_create(void) {
      SPT_JIT=1 / on / true  -> enable JIT
      SPT_JIT=0 / off / false -> keep disabled (default)
      SPT_JIT_HOT=<n>        -> override hot-loop trip threshold
-     SPT_JIT_DEBUG=1        -> emit recording/compile diagnostics to stderr */
+     SPT_JIT_DEBUG=1        -> emit recording/compile diagnostics to stderr
+     SPT_JIT_LOG=<path>     -> append the trace event stream as JSON lines
+                               ("-" = stderr; see sptjit_set_event_log) */
   {
     const char *e = getenv("SPT_JIT");
     if (e && *e) {
@@ -224,6 +226,9 @@ SPTJitState *sptjit_create(void) {
     }
     const char *d = getenv("SPT_JIT_DEBUG");
     js->debug = (d && *d) ? atoi(d) : 0;
+    const char *lg = getenv("SPT_JIT_LOG");
+    if (lg && *lg && sptjit_set_event_log(js, lg) != 0)
+      fprintf(stderr, "[JIT] cannot open SPT_JIT_LOG file '%s'\n", lg);
   }
   return js;
 }
@@ -250,6 +255,16 @@ void sptjit_destroy(SPTJitState *js) {
             (unsigned long long)js->stats.traces_aborted,
             (unsigned long long)js->stats.trace_entries, (unsigned long long)js->stats.trace_exits,
             (unsigned long long)js->stats.trace_guard_fail);
+    if (js->stats.traces_aborted) {
+      fprintf(stderr, "[JIT] aborts:");
+      for (int r = 1; r < SPT_JIT_ABORT__COUNT; r++)
+        if (js->stats.aborts_by_reason[r])
+          fprintf(stderr, " %s=%llu", sptjit_abort_reason_name(r),
+                  (unsigned long long)js->stats.aborts_by_reason[r]);
+      fprintf(stderr, " (blacklisted=%llu evicted=%llu)\n",
+              (unsigned long long)js->stats.blacklisted,
+              (unsigned long long)js->stats.traces_evicted);
+    }
     /* Per-exit breakdown: which exit points are hot. A trace that loops well
        concentrates its exits on the loop-end snapshot; a hot *side* exit marks
        a spot a side-trace would pay off. */
@@ -285,6 +300,7 @@ void sptjit_destroy(SPTJitState *js) {
       free(t);
     }
   }
+  sptjit_set_event_log(js, NULL);
   if (js->code_buf)
     sptjit_free_exec(js->code_buf, js->code_buf_size);
   free(js->hot_table);
@@ -308,12 +324,288 @@ void sptjit_get_stats(const SPTJitState *js, SPTJitStats *stats) {
     *stats = js->stats;
 }
 
+SPTTrace *sptjit_executing(const SPTJitState *js) { return js ? js->exec_trace : NULL; }
+
+void sptjit_set_executing(SPTJitState *js, SPTTrace *t) {
+  if (js)
+    js->exec_trace = t;
+}
+
+int sptjit_trace_locate(const SPTJitState *js, const SPTTrace *t, const void *mcode,
+                        SPTTraceLoc *loc) {
+  if (!js || !t || !loc)
+    return 0;
+  int live = 0;
+  for (int i = 0; i < js->hot_size; i++) {
+    if (js->hot_table[i].trace == t) {
+      live = 1;
+      break;
+    }
+  }
+  if (!live || !t->proto)
+    return 0;
+  loc->proto = t->proto;
+  loc->pc = t->pc_offset;
+  loc->snap_proto = NULL;
+  loc->snap_pc = -1;
+
+  /* The sampled PC belongs to the body leading up to the nearest guard at or
+     after it; that guard's snapshot holds the bytecode PC being executed. */
+  const uint8_t *code = (const uint8_t *)t->code;
+  const uint8_t *at = (const uint8_t *)mcode;
+  if (!code || !at || at < code || at >= code + t->code_size)
+    return 1;
+  uint32_t off = (uint32_t)(at - code);
+  int best = -1;
+  int nsnaps = t->ir.nsnaps < SPT_JIT_MAX_SNAPSHOTS ? t->ir.nsnaps : SPT_JIT_MAX_SNAPSHOTS;
+  for (int s = 0; s < nsnaps; s++) {
+    uint32_t m = t->snap_mcode[s];
+    if (m == 0 || m < off || !t->exit_pcs[s])
+      continue;
+    if (best < 0 || m < t->snap_mcode[best])
+      best = s;
+  }
+  if (best < 0)
+    return 1;
+  Proto *sp = t->exit_resume[best].callee_proto ? t->exit_resume[best].callee_proto : t->proto;
+  int spc = (int)(t->exit_pcs[best] - sp->code);
+  if (spc >= 0 && spc < sp->sizecode) {
+    loc->snap_proto = sp;
+    loc->snap_pc = spc;
+  }
+  return 1;
+}
+
+/* =====================================================================
+** Trace event stream and trace dump
+** ===================================================================== */
+
+static const char *const abort_reason_names[SPT_JIT_ABORT__COUNT] = {
+    "none",         "nyi",          "unsupported",    "too_long", "inner_loop",
+    "inline_depth", "callee_guard", "side_too_small", "codegen",  "nomem"};
+
+static const char *const event_names[SPT_JIT_EV__COUNT] = {"record",    "abort", "compile",
+                                                           "blacklist", "link",  "evict"};
+
+static const char *const evict_names[] = {"guard_fails", "invalidate", "flush"};
+
+const char *sptjit_abort_reason_name(int reason) {
+  return (reason >= 0 && reason < SPT_JIT_ABORT__COUNT) ? abort_reason_names[reason] : "?";
+}
+
+const char *sptjit_event_name(int kind) {
+  return (kind >= 0 && kind < SPT_JIT_EV__COUNT) ? event_names[kind] : "?";
+}
+
+SPTJitState *sptjit_get_state(lua_State *L) { return L ? G(L)->jit_state : NULL; }
+
+void sptjit_set_event_handler(SPTJitState *js, SPTJitEventFn fn, void *ud) {
+  if (!js)
+    return;
+  js->event_fn = fn;
+  js->event_ud = fn ? ud : NULL;
+}
+
+int sptjit_set_event_log(SPTJitState *js, const char *path) {
+  if (!js)
+    return -1;
+  if (js->event_log && js->event_log != stderr)
+    fclose(js->event_log);
+  js->event_log = NULL;
+  if (!path)
+    return 0;
+  js->event_log = (strcmp(path, "-") == 0) ? stderr : fopen(path, "a");
+  return js->event_log ? 0 : -1;
+}
+
+/* Printable chunk name of `p` into `buf` (LUA_IDSIZE bytes), as in debug info:
+   "file.spt" for files, [string "..."] for strings, "?" if stripped. */
+static const char *proto_source(const Proto *p, char *buf) {
+  if (!p || !p->source)
+    return "?";
+  luaO_chunkid(buf, getstr(p->source), tsslen(p->source));
+  return buf;
+}
+
+static int proto_line(const Proto *p, int pc) {
+  if (!p || !p->lineinfo || pc < 0 || pc >= p->sizecode)
+    return -1;
+  return luaG_getfuncline(p, pc);
+}
+
+static void json_str(FILE *f, const char *s) {
+  fputc('"', f);
+  for (; *s; s++) {
+    unsigned char c = (unsigned char)*s;
+    if (c == '"' || c == '\\')
+      fprintf(f, "\\%c", c);
+    else if (c < 0x20)
+      fprintf(f, "\\u%04x", c);
+    else
+      fputc(c, f);
+  }
+  fputc('"', f);
+}
+
+/* One event as one JSON line. Common fields first, then the kind's own. */
+static void jit_event_log(FILE *f, const SPTJitEvent *ev) {
+  char buf[LUA_IDSIZE];
+  fprintf(f, "{\"ev\":\"%s\",\"trace\":%u,\"parent\":%u,\"exit\":%d,\"src\":",
+          sptjit_event_name(ev->kind), ev->trace, ev->parent_trace, ev->parent_exit);
+  json_str(f, ev->source);
+  fprintf(f, ",\"pc\":%d,\"line\":%d", ev->pc, ev->line);
+  switch (ev->kind) {
+  case SPT_JIT_EV_ABORT:
+    fprintf(f, ",\"reason\":\"%s\",\"insts\":%d", sptjit_abort_reason_name(ev->reason), ev->insts);
+    if (ev->abort_proto && ev->abort_pc >= 0) {
+      fprintf(f, ",\"at_src\":");
+      json_str(f, proto_source(ev->abort_proto, buf));
+      fprintf(f, ",\"at_pc\":%d,\"at_line\":%d,\"op\":\"%s\"", ev->abort_pc, ev->abort_line,
+              ev->abort_op ? ev->abort_op : "?");
+    }
+    break;
+  case SPT_JIT_EV_BLACKLIST:
+    fprintf(f, ",\"reason\":\"%s\"", sptjit_abort_reason_name(ev->reason));
+    break;
+  case SPT_JIT_EV_COMPILE:
+    fprintf(f, ",\"ir\":%d,\"code\":%zu,\"snaps\":%d", ev->ir_size, ev->code_size, ev->nsnaps);
+    break;
+  case SPT_JIT_EV_EVICT:
+    fprintf(f, ",\"evict\":\"%s\"", evict_names[ev->evict]);
+    break;
+  default:
+    break;
+  }
+  fputs("}\n", f);
+  fflush(f);
+}
+
+static int jit_listening(const SPTJitState *js) { return js->event_fn || js->event_log; }
+
+static void jit_event_init(SPTJitEvent *ev, SPTJitEventKind kind, const Proto *p, int pc) {
+  memset(ev, 0, sizeof(*ev));
+  ev->kind = kind;
+  ev->proto = p;
+  ev->pc = pc;
+  ev->parent_exit = -1;
+  ev->abort_pc = -1;
+  ev->abort_line = -1;
+}
+
+static void jit_event_trace(SPTJitEvent *ev, SPTJitEventKind kind, const SPTTrace *t) {
+  jit_event_init(ev, kind, t->proto, t->pc_offset);
+  ev->trace = t->id;
+  ev->parent_trace = t->parent_id;
+  ev->parent_exit = t->parent_id ? t->parent_exit : -1;
+}
+
+/* Resolve source lines (only now that someone is listening) and deliver. */
+static void jit_emit(SPTJitState *js, SPTJitEvent *ev) {
+  char buf[LUA_IDSIZE];
+  ev->source = proto_source(ev->proto, buf);
+  ev->line = proto_line(ev->proto, ev->pc);
+  if (ev->abort_proto)
+    ev->abort_line = proto_line(ev->abort_proto, ev->abort_pc);
+  if (js->event_log)
+    jit_event_log(js->event_log, ev);
+  if (js->event_fn)
+    js->event_fn(js->event_ud, ev);
+}
+
+/* A compiled trace is being discarded (the caller frees it). */
+static void jit_evict(SPTJitState *js, const SPTTrace *t, SPTJitEvictReason why) {
+  js->stats.traces_evicted++;
+  if (jit_listening(js)) {
+    SPTJitEvent ev;
+    jit_event_trace(&ev, SPT_JIT_EV_EVICT, t);
+    ev.evict = why;
+    jit_emit(js, &ev);
+  }
+}
+
+/* (p, pc) will not be recorded again; `reason` is the last abort reason, or
+   NONE when the trace kept failing guards at runtime. */
+static void jit_blacklist(SPTJitState *js, const Proto *p, int pc, SPTJitAbortReason reason) {
+  js->stats.blacklisted++;
+  if (js->debug)
+    fprintf(stderr, "[JIT] blacklisted: proto=%p pc_offset=%d (last abort: %s)\n", (void *)p, pc,
+            sptjit_abort_reason_name(reason));
+  if (jit_listening(js)) {
+    SPTJitEvent ev;
+    jit_event_init(&ev, SPT_JIT_EV_BLACKLIST, p, pc);
+    ev.reason = reason;
+    jit_emit(js, &ev);
+  }
+}
+
+static SPTTrace *trace_by_id(const SPTJitState *js, uint32_t id) {
+  if (!js || id == 0)
+    return NULL;
+  for (int i = 0; i < js->hot_size; i++) {
+    SPTTrace *t = js->hot_table[i].trace;
+    if (t && t->id == id)
+      return t;
+  }
+  return NULL;
+}
+
+const void *sptjit_trace_code(const SPTJitState *js, uint32_t id, size_t *size) {
+  SPTTrace *t = trace_by_id(js, id);
+  if (size)
+    *size = t ? t->code_size : 0;
+  return t ? t->code : NULL;
+}
+
+int sptjit_dump_trace(const SPTJitState *js, uint32_t id, FILE *out) {
+  SPTTrace *t = trace_by_id(js, id);
+  char buf[LUA_IDSIZE];
+  if (!t || !out)
+    return -1;
+  fprintf(out, "==== trace %u (%s) %s pc %d line %d ====\n", t->id, t->parent_id ? "side" : "root",
+          proto_source(t->proto, buf), t->pc_offset, proto_line(t->proto, t->pc_offset));
+  if (t->parent_id)
+    fprintf(out, "parent: trace %u exit %d\n", t->parent_id, t->parent_exit);
+  fprintf(out, "entries: %u  livein checks: %d  inlined methods: %d\n", t->entry_count,
+          t->n_livein, t->n_methods);
+  sptir_dump_to(&t->ir, "optimized", out);
+
+  /* Snapshot map: where each exit resumes, where its guard ends in the machine
+     code (0 = no guard in the body) and the slot -> IR ref restore map. */
+  int nsnaps = t->ir.nsnaps < SPT_JIT_MAX_SNAPSHOTS ? t->ir.nsnaps : SPT_JIT_MAX_SNAPSHOTS;
+  fprintf(out, "---- snapshots (%d) ----\n", nsnaps);
+  for (int s = 0; s < nsnaps; s++) {
+    const Proto *sp = t->exit_resume[s].callee_proto ? t->exit_resume[s].callee_proto : t->proto;
+    int epc = (t->exit_pcs[s] && sp) ? (int)(t->exit_pcs[s] - sp->code) : -1;
+    fprintf(out, "  snap %-3d pc %-4d line %-4d mcode +0x%04x taken %-8llu%s%s slots:", s, epc,
+            proto_line(sp, epc), (unsigned)t->snap_mcode[s], (unsigned long long)t->exit_count[s],
+            s == t->loop_end_snap ? " loop-end" : "", sp != t->proto ? " in-callee" : "");
+    const SPTSnapshot *sn = t->ir.snaps ? t->ir.snaps[s] : NULL;
+    for (int k = 0; sn && k < sn->nslots; k++)
+      if (sn->slot_map[k] >= 0)
+        fprintf(out, " [%d]=%d", k, (int)sn->slot_map[k]);
+    fputc('\n', out);
+  }
+
+  /* Raw machine code, 16 bytes per row, offsets relative to the entry. */
+  fprintf(out, "---- mcode (%zu bytes at %p) ----\n", t->code_size, t->code);
+  const uint8_t *code = (const uint8_t *)t->code;
+  for (size_t off = 0; code && off < t->code_size; off += 16) {
+    fprintf(out, "  %04zx:", off);
+    for (size_t b = off; b < off + 16 && b < t->code_size; b++)
+      fprintf(out, " %02x", code[b]);
+    fputc('\n', out);
+  }
+  fprintf(out, "----\n");
+  return 0;
+}
+
 void sptjit_flush_all(SPTJitState *js) {
   if (!js)
     return;
   for (int i = 0; i < js->hot_size; i++) {
     SPTTrace *t = js->hot_table[i].trace;
     if (t) {
+      jit_evict(js, t, SPT_JIT_EVICT_FLUSH);
       sptir_free(&t->ir);
       free(t);
       js->hot_table[i].trace = NULL;
@@ -330,6 +622,7 @@ void sptjit_invalidate_proto(SPTJitState *js, Proto *p) {
     if (js->hot_table[i].proto == p) {
       SPTTrace *t = js->hot_table[i].trace;
       if (t) {
+        jit_evict(js, t, SPT_JIT_EVICT_INVALIDATE);
         sptir_free(&t->ir);
         free(t);
       }
@@ -376,6 +669,9 @@ typedef struct {
   int inst_count;              /* instructions recorded */
   int aborted;                 /* recording aborted */
   const Instruction *abort_pc; /* PC where abort happened */
+  /* Why, when it is more specific than "unsupported shape/type" (the default
+     for the many operand checks in rec_inst, which leave this at NONE). */
+  SPTJitAbortReason abort_reason;
   /* Call inlining: absolute base of the frame currently being recorded.
      0 for the root function; when a pure straight-line leaf call is inlined,
      reg_map/reg_type are indexed by (frame_base + reg) so the callee's
@@ -3737,6 +4033,7 @@ static int rec_inst(SPTRecCtx *rc) {
 
   if (rc->inst_count++ > SPT_JIT_MAX_TRACE) {
     rc->aborted = 1;
+    rc->abort_reason = SPT_JIT_ABORT_TOO_LONG;
     return 0;
   }
 
@@ -4753,6 +5050,7 @@ static int rec_inst(SPTRecCtx *rc) {
         return 0;
       }
       rc->aborted = 1;
+      rc->abort_reason = SPT_JIT_ABORT_INNER_LOOP;
       rc->abort_pc = rc->pc;
       return 0;
     }
@@ -4807,6 +5105,7 @@ static int rec_inst(SPTRecCtx *rc) {
         return 0;
       }
       rc->aborted = 1;
+      rc->abort_reason = SPT_JIT_ABORT_INNER_LOOP;
       return 0;
     }
 
@@ -5323,6 +5622,7 @@ static int rec_inst(SPTRecCtx *rc) {
       }
       if (rc->inline_depth >= SPT_JIT_MAX_INLINE_DEPTH) {
         rc->aborted = 1;
+        rc->abort_reason = SPT_JIT_ABORT_INLINE_DEPTH;
         return 0;
       }
       /* Push caller frame onto the inline stack. The method_self_pc /
@@ -5417,6 +5717,7 @@ static int rec_inst(SPTRecCtx *rc) {
        reg_map (callee slot k == caller slot A+1+k), so nothing is copied. */
     if (rc->inline_depth >= SPT_JIT_MAX_INLINE_DEPTH) {
       rc->aborted = 1;
+      rc->abort_reason = SPT_JIT_ABORT_INLINE_DEPTH;
       return 0;
     }
     SPTInlineFrame *ff = &rc->inline_frames[rc->inline_depth];
@@ -5573,6 +5874,7 @@ static int rec_inst(SPTRecCtx *rc) {
         return 0;
       }
       rc->aborted = 1;
+      rc->abort_reason = SPT_JIT_ABORT_INNER_LOOP;
       return 0;
     }
     sptir_loop(ir);
@@ -5792,6 +6094,7 @@ static int rec_inst(SPTRecCtx *rc) {
 
   default:
     rc->aborted = 1;
+    rc->abort_reason = SPT_JIT_ABORT_NYI;
     return 0;
   }
 
@@ -5799,15 +6102,63 @@ static int rec_inst(SPTRecCtx *rc) {
   return 1;
 }
 
-/* Record a trace starting from start_pc. */
+/* Count a discarded recording under `reason` and report it. `rc` is NULL when
+   nothing was recorded; `at_pc` is where recording stopped (NULL when the trace
+   was rejected after recording, e.g. by the side-trace size gate). */
+static void rec_discard(SPTJitState *js, const Proto *p, const Instruction *start_pc,
+                        const SPTTrace *parent, int parent_exit, const SPTRecCtx *rc,
+                        const Instruction *at_pc, SPTJitAbortReason reason) {
+  js->stats.traces_aborted++;
+  js->stats.aborts_by_reason[reason]++;
+  js->last_abort = reason;
+  if (!jit_listening(js))
+    return;
+  SPTJitEvent ev;
+  jit_event_init(&ev, SPT_JIT_EV_ABORT, p, (int)(start_pc - p->code));
+  ev.parent_trace = parent ? parent->id : 0;
+  ev.parent_exit = parent ? parent_exit : -1;
+  ev.reason = reason;
+  if (rc) {
+    ev.insts = rc->inst_count;
+    if (at_pc && at_pc >= rc->p->code && at_pc < rc->p->code + rc->p->sizecode) {
+      ev.abort_proto = rc->p;
+      ev.abort_pc = (int)(at_pc - rc->p->code);
+      ev.abort_op = opnames[GET_OPCODE(*at_pc)];
+    }
+  }
+  jit_emit(js, &ev);
+}
+
+/* One more failed recording at hot entry `e` for (p, pc); report the PC once
+   its abort count reaches the blacklist limit. */
+static void hot_abort(SPTJitState *js, SPTHotEntry *e, const Proto *p, int pc) {
+  if (e->aborts < 0xFFFF)
+    e->aborts++;
+  if (e->aborts == SPT_JIT_MAX_ABORTS)
+    jit_blacklist(js, p, pc, js->last_abort);
+}
+
+/* Record a trace starting from start_pc. `parent` is NULL for a root trace;
+   for a side trace it is the trace whose snapshot `parent_exit` went hot. */
 static SPTTrace *record_trace(SPTJitState *js, lua_State *L, CallInfo *ci,
-                              const Instruction *start_pc, int is_side) {
+                              const Instruction *start_pc, SPTTrace *parent, int parent_exit) {
   LClosure *cl = clLvalue(s2v(ci->func.p));
   Proto *p = cl->p;
+  int is_side = parent != NULL;
+
+  if (jit_listening(js)) {
+    SPTJitEvent ev;
+    jit_event_init(&ev, SPT_JIT_EV_RECORD, p, (int)(start_pc - p->code));
+    ev.parent_trace = parent ? parent->id : 0;
+    ev.parent_exit = parent ? parent_exit : -1;
+    jit_emit(js, &ev);
+  }
 
   SPTTrace *t = (SPTTrace *)calloc(1, sizeof(SPTTrace));
-  if (!t)
+  if (!t) {
+    rec_discard(js, p, start_pc, parent, parent_exit, NULL, NULL, SPT_JIT_ABORT_NOMEM);
     return NULL;
+  }
   sptir_init(&t->ir);
 
   SPTRecCtx rc;
@@ -5863,15 +6214,16 @@ static SPTTrace *record_trace(SPTJitState *js, lua_State *L, CallInfo *ci,
   }
 
   if (rc.aborted) {
-    js->stats.traces_aborted++;
+    SPTJitAbortReason reason = rc.abort_reason ? rc.abort_reason : SPT_JIT_ABORT_UNSUPPORTED;
     if (js->debug) {
       OpCode bad = GET_OPCODE(*rc.pc);
       fprintf(stderr,
               "[JIT] aborted trace: proto=%p start_pc_offset=%d at op=%d "
-              "(pc_offset=%d) after %d insts\n",
+              "(pc_offset=%d) after %d insts: %s\n",
               (void *)p, (int)(start_pc - p->code), (int)bad, (int)(rc.pc - p->code),
-              rc.inst_count);
+              rc.inst_count, sptjit_abort_reason_name(reason));
     }
+    rec_discard(js, p, start_pc, parent, parent_exit, &rc, rc.pc, reason);
     sptir_free(&t->ir);
     free(t);
     return NULL;
@@ -5955,6 +6307,7 @@ static SPTTrace *record_trace(SPTJitState *js, lua_State *L, CallInfo *ci,
           fprintf(stderr, "[JIT] trace has an un-hoisted in-callee guard (exit "
                           "pc outside main proto, no resume info); refusing to compile, "
                           "fall back to interpreter\n");
+        rec_discard(js, p, start_pc, parent, parent_exit, &rc, epc, SPT_JIT_ABORT_CALLEE_GUARD);
         sptir_free(&t->ir);
         free(t);
         return NULL;
@@ -6009,6 +6362,7 @@ static SPTTrace *record_trace(SPTJitState *js, lua_State *L, CallInfo *ci,
               "[JIT] side trace too small (ir=%d < %d), discarded; "
               "arm stays in interpreter\n",
               t->ir.ninst, js->side_min_ir);
+    rec_discard(js, p, start_pc, parent, parent_exit, &rc, NULL, SPT_JIT_ABORT_SIDE_TOO_SMALL);
     sptir_free(&t->ir);
     free(t);
     return NULL;
@@ -6018,7 +6372,7 @@ static SPTTrace *record_trace(SPTJitState *js, lua_State *L, CallInfo *ci,
   sptjit_codegen_compile(t, js);
 
   if (!t->code) {
-    js->stats.traces_aborted++;
+    rec_discard(js, p, start_pc, parent, parent_exit, &rc, NULL, SPT_JIT_ABORT_CODEGEN);
     sptir_free(&t->ir);
     free(t);
     return NULL;
@@ -6026,6 +6380,9 @@ static SPTTrace *record_trace(SPTJitState *js, lua_State *L, CallInfo *ci,
 
   t->proto = p;
   t->pc_offset = (int)(start_pc - p->code);
+  t->id = ++js->next_trace_id;
+  t->parent_id = parent ? parent->id : 0;
+  t->parent_exit = parent ? parent_exit : -1;
   js->stats.traces_recorded++;
   js->stats.traces_compiled++;
 
@@ -6035,6 +6392,14 @@ static SPTTrace *record_trace(SPTJitState *js, lua_State *L, CallInfo *ci,
             "code=%zu bytes, %d exits\n",
             (void *)p, t->pc_offset, t->ir.ninst, t->code_size, t->nexits);
   }
+  if (jit_listening(js)) {
+    SPTJitEvent ev;
+    jit_event_trace(&ev, SPT_JIT_EV_COMPILE, t);
+    ev.ir_size = t->ir.ninst;
+    ev.code_size = t->code_size;
+    ev.nsnaps = t->ir.nsnaps;
+    jit_emit(js, &ev);
+  }
 
   return t;
 }
@@ -6193,17 +6558,17 @@ static void maybe_record_side_trace(SPTJitState *js, lua_State *L, CallInfo *ci,
   /* Is this exit hot? Find a parent snapshot whose exit PC matches and whose
      taken-count (bumped by the exit stub) has crossed the side-trace threshold.
      Multiple snapshots may share a PC; any one being hot makes the PC hot. */
-  int hot = 0;
+  int hot = -1;
   for (int s = 0; s < parent->ir.nsnaps && s < SPT_JIT_MAX_SNAPSHOTS; s++) {
     if (parent->exit_pcs[s] == exit_pc && parent->exit_count[s] >= js->side_hot_threshold) {
-      hot = 1;
+      hot = s;
       break;
     }
   }
-  if (!hot)
+  if (hot < 0)
     return;
 
-  SPTTrace *st = record_trace(js, L, ci, exit_pc, /*is_side=*/1);
+  SPTTrace *st = record_trace(js, L, ci, exit_pc, parent, hot);
   if (st) {
     e->proto = p;
     e->pc_offset = pc_offset;
@@ -6213,8 +6578,13 @@ static void maybe_record_side_trace(SPTJitState *js, lua_State *L, CallInfo *ci,
               "[JIT] recorded side trace: proto=%p pc_offset=%d "
               "(parent exit hot)\n",
               (void *)p, pc_offset);
-  } else if (e->aborts < 0xFFFF) {
-    e->aborts++;
+    if (jit_listening(js)) {
+      SPTJitEvent ev;
+      jit_event_trace(&ev, SPT_JIT_EV_LINK, st);
+      jit_emit(js, &ev);
+    }
+  } else {
+    hot_abort(js, e, p, pc_offset);
   }
 }
 
@@ -6309,7 +6679,10 @@ int sptjit_trace_enter(lua_State *L, CallInfo *ci, const Instruction *pc) {
     js->stats.trace_entries++;
     t->entry_count++;
     SPTTraceEntry entry = (SPTTraceEntry)t->code;
+    SPTTrace *outer = js->exec_trace; /* a trace entered from inside another one */
+    js->exec_trace = t;
     entry(L, ci);
+    js->exec_trace = outer;
 
     /* §10.68c: if the trace exited at an in-callee guard, sptjit_exit_resume
        pushed a callee CI and set L->ci != ci. Stop linking — the interpreter
@@ -6384,6 +6757,7 @@ int sptjit_trace_hot(lua_State *L, CallInfo *ci, const Instruction *pc) {
                   (void *)p, pc_offset, (unsigned long long)side_exits, t->entry_count,
                   e->runtime_fails + 1);
         }
+        jit_evict(js, t, SPT_JIT_EVICT_GUARD_FAILS);
         sptir_free(&t->ir);
         free(t);
         e->trace = NULL;
@@ -6391,6 +6765,7 @@ int sptjit_trace_hot(lua_State *L, CallInfo *ci, const Instruction *pc) {
           e->runtime_fails++;
         if (e->runtime_fails >= SPT_JIT_MAX_RUNTIME_FAILS) {
           e->aborts = SPT_JIT_MAX_ABORTS; /* full blacklist */
+          jit_blacklist(js, p, pc_offset, SPT_JIT_ABORT_NONE);
         } else {
           e->counter = e->aborts + e->runtime_fails; /* phase-shift retry */
         }
@@ -6422,13 +6797,12 @@ int sptjit_trace_hot(lua_State *L, CallInfo *ci, const Instruction *pc) {
       /* Enough samples: stop profiling and record using the majority tally. */
       sptjit_profiling_active = 0;
       e->counter = 0;
-      SPTTrace *t = record_trace(js, L, ci, pc, /*is_side=*/0);
+      SPTTrace *t = record_trace(js, L, ci, pc, NULL, -1);
       if (t) {
         e->trace = t;
         return sptjit_trace_enter(L, ci, pc);
       }
-      if (e->aborts < 0xFFFF)
-        e->aborts++;
+      hot_abort(js, e, p, pc_offset);
       e->counter = e->aborts;
       return 0;
     }
@@ -20,6 +20,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
 /* Forward declarations from VM */
 typedef struct lua_State lua_State;
@@ -234,6 +235,30 @@ void sptjit_invalidate_proto(SPTJitState *js, Proto *p);
 /* Flush all traces (e.g., for debugging). */
 void sptjit_flush_all(SPTJitState *js);
 
+/* The JIT of `L`'s global state (NULL if it could not be created). */
+SPTJitState *sptjit_get_state(lua_State *L);
+
+/*
+** Why a recording was discarded. Every discarded recording bumps
+** traces_aborted and exactly one aborts_by_reason[] slot.
+*/
+typedef enum SPTJitAbortReason {
+  SPT_JIT_ABORT_NONE = 0,
+  SPT_JIT_ABORT_NYI,            /* opcode the recorder does not handle at all */
+  SPT_JIT_ABORT_UNSUPPORTED,    /* handled opcode, unsupported operand shape/type */
+  SPT_JIT_ABORT_TOO_LONG,       /* more than SPT_JIT_MAX_TRACE bytecodes */
+  SPT_JIT_ABORT_INNER_LOOP,     /* back-edge of a loop other than the traced one */
+  SPT_JIT_ABORT_INLINE_DEPTH,   /* call nesting beyond SPT_JIT_MAX_INLINE_DEPTH */
+  SPT_JIT_ABORT_CALLEE_GUARD,   /* guard left inside an inlined callee, no resume info */
+  SPT_JIT_ABORT_SIDE_TOO_SMALL, /* side trace below side_min_ir */
+  SPT_JIT_ABORT_CODEGEN,        /* code generation failed (e.g. code pool full) */
+  SPT_JIT_ABORT_NOMEM,          /* out of memory */
+  SPT_JIT_ABORT__COUNT
+} SPTJitAbortReason;
+
+/* Short lowercase name of an abort reason ("nyi", "inner_loop", ...). */
+const char *sptjit_abort_reason_name(int reason);
+
 /* Statistics */
 typedef struct SPTJitStats {
   uint64_t traces_recorded;
@@ -242,10 +267,126 @@ typedef struct SPTJitStats {
   uint64_t trace_entries;
   uint64_t trace_exits;
   uint64_t trace_guard_fail;
+  uint64_t aborts_by_reason[SPT_JIT_ABORT__COUNT]; /* indexed by SPTJitAbortReason */
+  uint64_t blacklisted;                            /* PCs given up on */
+  uint64_t traces_evicted;                         /* compiled traces discarded */
 } SPTJitStats;
 
 void sptjit_get_stats(const SPTJitState *js, SPTJitStats *stats);
 
+/*
+** Trace event stream.
+**
+** Every decision the JIT makes about a loop is reported as an event, so a
+** production host can tell why a hot loop did not compile: recording started,
+** recording aborted (with the reason and the bytecode it stopped at), trace
+** compiled (IR and machine-code size), PC blacklisted, side trace linked to a
+** parent exit, compiled trace evicted. Events are delivered to a host callback
+** (sptjit_set_event_handler) and/or appended as JSON lines to a file
+** (sptjit_set_event_log, or the SPT_JIT_LOG=<path> environment variable; "-"
+** means stderr). Events are only built when someone listens, and all of them
+** fire on the recording/compile slow path, never per trace entry.
+**
+** Compiled traces get a stable id (1, 2, ...); id 0 means "no trace yet"
+** (record/abort of a recording that never compiled).
+*/
+typedef enum SPTJitEventKind {
+  SPT_JIT_EV_RECORD = 0, /* recording started at (proto, pc) */
+  SPT_JIT_EV_ABORT,      /* recording discarded: reason, abort_proto/abort_pc/op */
+  SPT_JIT_EV_COMPILE,    /* trace compiled: trace, ir_size, code_size, nsnaps */
+  SPT_JIT_EV_BLACKLIST,  /* (proto, pc) will not be recorded again */
+  SPT_JIT_EV_LINK,       /* side trace `trace` attached to parent_trace's exit */
+  SPT_JIT_EV_EVICT,      /* compiled trace discarded: evict */
+  SPT_JIT_EV__COUNT
+} SPTJitEventKind;
+
+/* Why a compiled trace was evicted (SPT_JIT_EV_EVICT). */
+typedef enum SPTJitEvictReason {
+  SPT_JIT_EVICT_GUARD_FAILS = 0, /* side exits dominated (runtime blacklist) */
+  SPT_JIT_EVICT_INVALIDATE,      /* sptjit_invalidate_proto */
+  SPT_JIT_EVICT_FLUSH,           /* sptjit_flush_all */
+} SPTJitEvictReason;
+
+typedef struct SPTJitEvent {
+  SPTJitEventKind kind;
+  uint32_t trace;        /* trace id (0 = none) */
+  uint32_t parent_trace; /* side traces: parent trace id (0 = root trace) */
+  int parent_exit;       /* side traces: parent snapshot the side trace hangs off */
+  const Proto *proto;    /* trace start */
+  int pc;                /* trace start PC offset in proto */
+  const char *source;    /* proto's chunk name ("?" if stripped) */
+  int line;              /* source line of pc (-1 if unknown) */
+  /* SPT_JIT_EV_ABORT, SPT_JIT_EV_BLACKLIST (last abort reason, NONE when the
+     blacklist came from runtime guard failures) */
+  SPTJitAbortReason reason;
+  const Proto *abort_proto; /* Proto recording stopped in (an inlined callee or proto) */
+  int abort_pc;             /* PC offset in abort_proto (-1 if not tied to a bytecode) */
+  int abort_line;
+  const char *abort_op;     /* opcode name at abort_pc (NULL if none) */
+  int insts;                /* bytecodes recorded before the abort */
+  /* SPT_JIT_EV_COMPILE */
+  int ir_size;
+  size_t code_size;
+  int nsnaps;
+  /* SPT_JIT_EV_EVICT */
+  SPTJitEvictReason evict;
+} SPTJitEvent;
+
+typedef void (*SPTJitEventFn)(void *ud, const SPTJitEvent *ev);
+
+/* Install (fn != NULL) or remove the event callback. It runs inside the
+   interpreter (mid-recording for RECORD/ABORT) and must not call back into the
+   Lua state; pointers in `ev` are only valid during the call. */
+void sptjit_set_event_handler(SPTJitState *js, SPTJitEventFn fn, void *ud);
+
+/* Append events to `path` as JSON lines ("-" = stderr, NULL = stop logging).
+   Returns 0 on success, -1 if the file could not be opened. */
+int sptjit_set_event_log(SPTJitState *js, const char *path);
+
+/* Short lowercase name of an event kind ("record", "abort", ...). */
+const char *sptjit_event_name(int kind);
+
+/*
+** On-demand trace dump for diagnosis. sptjit_dump_trace writes trace `id`'s
+** header (start Proto/PC/line, parent), its optimized IR, the snapshot map
+** (resume PC and line, machine-code offset of the owning guard, times taken,
+** slot->IR-ref map) and a hex listing of the machine code. Returns 0, or -1
+** if no live trace has that id.
+**
+** sptjit_trace_code returns the raw machine code (and its size) for feeding a
+** disassembler, e.g. written to a file and run through
+** `objdump -D -b binary -m i386:x86-64`; the offsets match the dump.
+*/
+int sptjit_dump_trace(const SPTJitState *js, uint32_t id, FILE *out);
+const void *sptjit_trace_code(const SPTJitState *js, uint32_t id, size_t *size);
+
+/*
+** Sampling-profiler support (see spt_profile.h).
+**
+** `sptjit_executing` returns the trace whose native code is running right now,
+** or NULL while the interpreter runs. It is a single volatile load and is safe
+** to call from a signal handler. `sptjit_set_executing` puts back the value
+** saved before a protected call when an error unwinds out of native code.
+**
+** `sptjit_trace_locate` resolves such a trace outside the signal handler. The
+** trace pointer is validated against the trace cache first (it may have been
+** discarded since it was sampled), then mapped to the Proto/PC it was recorded
+** from and, when `mcode` is a native PC inside the trace, to the bytecode PC of
+** the next guard's snapshot (which lies in an inlined callee's Proto when the
+** guard does). Returns 1 on success, 0 if `t` is no longer a live trace.
+*/
+typedef struct SPTTraceLoc {
+  Proto *proto;      /* Proto the trace was recorded from */
+  int pc;            /* loop-header PC offset in proto */
+  Proto *snap_proto; /* Proto of the nearest snapshot PC (NULL = unknown) */
+  int snap_pc;       /* PC offset in snap_proto */
+} SPTTraceLoc;
+
+SPTTrace *sptjit_executing(const SPTJitState *js);
+void sptjit_set_executing(SPTJitState *js, SPTTrace *t);
+int sptjit_trace_locate(const SPTJitState *js, const SPTTrace *t, const void *mcode,
+                        SPTTraceLoc *loc);
+
 #if defined(__cplusplus)
 }
 #endif
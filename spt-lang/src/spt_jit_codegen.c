@@ -2251,6 +2251,14 @@ static void gen_inst(SPTCodeGen *cg, int idx) {
 ** Main compilation entry point
 ** ===================================================================== */
 
+/* Record where the guard owning a snapshot ends in the native code, so a
+   sampled PC inside the trace can be mapped back to bytecode (profiler). */
+static void note_snap_mcode(SPTCodeGen *cg, int i) {
+  int s = cg->trace->ir.insts[i].snap_idx;
+  if (s >= 0 && s < SPT_JIT_MAX_SNAPSHOTS)
+    cg->trace->snap_mcode[s] = (uint32_t)sptasm_size(&cg->asm_);
+}
+
 void sptjit_codegen_compile(SPTTrace *t, SPTJitState *js) {
   SPTCodeGen cg;
   memset(&cg, 0, sizeof(cg));
@@ -2298,8 +2306,10 @@ void sptjit_codegen_compile(SPTTrace *t, SPTJitState *js) {
      into their registers and run their type guards once, before the loop. */
   if (cg.use_ra) {
     for (int i = 0; i < ir->ninst; i++) {
-      if (cg.ref_hoist[i])
+      if (cg.ref_hoist[i]) {
         gen_inst(&cg, i);
+        note_snap_mcode(&cg, i);
+      }
     }
   }
 
@@ -2311,6 +2321,7 @@ void sptjit_codegen_compile(SPTTrace *t, SPTJitState *js) {
     if (cg.use_ra && cg.ref_hoist[i])
       continue;
     gen_inst(&cg, i);
+    note_snap_mcode(&cg, i);
   }
 
   /* Generate exit stubs, one per emitted snapshot. */
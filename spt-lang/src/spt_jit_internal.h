@@ -85,6 +85,13 @@ struct SPTTrace {
   size_t code_size; /* code size */
   int nrefs;        /* reference count */
 
+  /* Identity for the event stream / sptjit_dump_trace: 1, 2, ... in compile
+     order. Side traces also record the parent trace and the parent snapshot
+     whose hot exit they were rooted at (parent_id 0 = root trace). */
+  uint32_t id;
+  uint32_t parent_id;
+  int parent_exit;
+
   /* IR (kept for debugging/recompilation) */
   SPTIRBuilder ir;
 
@@ -107,6 +114,12 @@ struct SPTTrace {
      *side* exit (type/bounds guard) is the signal for side-trace chaining. */
   uint64_t exit_count[SPT_JIT_MAX_SNAPSHOTS];
 
+  /* Native code offset (from `code`) just past the guard that owns each
+     snapshot; 0 = the snapshot has no guard in the body. Lets the sampling
+     profiler map a native PC inside the trace back to the bytecode PC of the
+     next guard (see sptjit_trace_locate). */
+  uint32_t snap_mcode[SPT_JIT_MAX_SNAPSHOTS];
+
   /* Snapshot index of the FORLOOP "count > 0" guard (the loop-continuation
      guard). Exits from this snapshot are normal loop termination and are
      excluded from the runtime guard-failure blacklist check. -1 = none (e.g.
@@ -208,6 +221,20 @@ struct SPTJitState {
   const Instruction *rec_end_pc;
   int rec_inst_count;
 
+  /* Trace whose native code is currently running (NULL while interpreting).
+     Written around every native entry in sptjit_trace_enter and read from the
+     sampling profiler's signal handler, hence volatile. */
+  SPTTrace *volatile exec_trace;
+
+  /* Trace event stream (see sptjit_set_event_handler). `last_abort` is the
+     reason of the most recent discarded recording, reported when the abort
+     count for that PC reaches the blacklist limit. */
+  SPTJitEventFn event_fn;
+  void *event_ud;
+  FILE *event_log;
+  uint32_t next_trace_id;
+  SPTJitAbortReason last_abort;
+
   /* Executable code arena */
   uint8_t *code_buf; /* executable memory pool */
   size_t code_buf_size;
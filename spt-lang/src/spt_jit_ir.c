@@ -779,8 +779,8 @@ static const char *irtypename(int t) {
   }
 }
 
-void sptir_dump(const SPTIRBuilder *b, const char *title) {
-  fprintf(stderr, "---- IR dump: %s (%d insts, maxslot=%d, loop_start=%d) ----\n",
+void sptir_dump_to(const SPTIRBuilder *b, const char *title, FILE *out) {
+  fprintf(out, "---- IR dump: %s (%d insts, maxslot=%d, loop_start=%d) ----\n",
           title ? title : "", b->ninst, b->maxslot, b->loop_start);
   for (int i = 0; i < b->ninst; i++) {
     const SPTIRInst *ir = &b->insts[i];
@@ -795,15 +795,17 @@ void sptir_dump(const SPTIRBuilder *b, const char *title) {
     if (ir->flags & SPTIRF_PHI)
       fl[fi++] = 'P';
     fl[fi] = 0;
-    fprintf(stderr, "  %4d  %-3s %-9s op1=%-4d op2=%-4d aux=%lld  %s\n", i, irtypename(ir->type),
+    fprintf(out, "  %4d  %-3s %-9s op1=%-4d op2=%-4d aux=%lld  %s\n", i, irtypename(ir->type),
             iropname(ir->op), (int)ir->op1, (int)ir->op2, (long long)ir->aux, fl);
   }
-  fprintf(stderr, "  reg_map (slot->ref):");
+  fprintf(out, "  reg_map (slot->ref):");
   for (int s = 0; s <= b->maxslot; s++)
-    fprintf(stderr, " [%d]=%d", s, (int)b->reg_map[s]);
-  fprintf(stderr, "\n----\n");
+    fprintf(out, " [%d]=%d", s, (int)b->reg_map[s]);
+  fprintf(out, "\n----\n");
 }
 
+void sptir_dump(const SPTIRBuilder *b, const char *title) { sptir_dump_to(b, title, stderr); }
+
 /* Chase a NOP-alias chain (from algebraic simplification or CSE) to the
    instruction that actually computes the value. */
 static int canon_nop(SPTIRBuilder *b, int ref) {
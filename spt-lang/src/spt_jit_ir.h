@@ -284,8 +284,9 @@ void sptir_loop(SPTIRBuilder *b);
 /* Get the type of an IR ref. */
 SPTType sptir_type(const SPTIRBuilder *b, int ref);
 
-/* Debug: print the IR to stderr. */
+/* Debug: print the IR to stderr (sptir_dump) or to `out`. */
 void sptir_dump(const SPTIRBuilder *b, const char *title);
+void sptir_dump_to(const SPTIRBuilder *b, const char *title, FILE *out);
 
 /* Get the instruction at a ref. */
 static inline SPTIRInst *sptir_get(const SPTIRBuilder *b, int ref) {
@@ -184,32 +184,50 @@ static int is_ident_part_cp(uint32_t cp) {
 }
 
 /* ===========================================================================
- * 关键字表
+ * 关键字表：完美哈希
+ *
+ * 槽位 = (首字节 * 7 + 末字节 * 33 + 长度 * 12) & 63，33 个关键字各占一槽，查找为一次取模
+ * 加一次定长比较，不再逐个 strlen + memcmp。增删关键字时需重新挑选系数使其不冲突
+ * （TestLexer 逐个校验所有关键字与若干近似标识符）。
  * ========================================================================= */
 typedef struct {
   const char *kw;
+  int len;
   SptTokenKind kind;
 } Keyword;
 
-static const Keyword KEYWORDS[] = {
-    {"int", TOK_INT},           {"float", TOK_FLOAT},     {"number", TOK_NUMBER},
-    {"str", TOK_STR},           {"bool", TOK_BOOL},       {"any", TOK_ANY},
-    {"void", TOK_VOID},         {"null", TOK_NULL},       {"list", TOK_LIST},
-    {"map", TOK_MAP},           {"fn", TOK_FUNCTION},     {"coro", TOK_COROUTINE},
-    {"vars", TOK_VARS},         {"if", TOK_IF},           {"else", TOK_ELSE},
-    {"while", TOK_WHILE},       {"for", TOK_FOR},         {"break", TOK_BREAK},
-    {"continue", TOK_CONTINUE}, {"return", TOK_RETURN},   {"defer", TOK_DEFER},
-    {"true", TOK_TRUE},         {"false", TOK_FALSE},     {"const", TOK_CONST},
-    {"auto", TOK_AUTO},         {"global", TOK_GLOBAL},   {"static", TOK_STATIC},
-    {"import", TOK_IMPORT},     {"as", TOK_AS},           {"from", TOK_FROM},
-    {"export", TOK_EXPORT},     {"declare", TOK_DECLARE}, {"class", TOK_CLASS},
+#define KW_SLOTS 64
+#define KW_MIN_LEN 2
+#define KW_MAX_LEN 8
+
+static const Keyword KEYWORDS[KW_SLOTS] = {
+    [2] = {"while", 5, TOK_WHILE},        [4] = {"class", 5, TOK_CLASS},
+    [5] = {"global", 6, TOK_GLOBAL},      [7] = {"from", 4, TOK_FROM},
+    [10] = {"bool", 4, TOK_BOOL},         [11] = {"false", 5, TOK_FALSE},
+    [14] = {"void", 4, TOK_VOID},         [15] = {"map", 3, TOK_MAP},
+    [16] = {"fn", 2, TOK_FUNCTION},       [18] = {"as", 2, TOK_AS},
+    [20] = {"return", 6, TOK_RETURN},     [21] = {"declare", 7, TOK_DECLARE},
+    [24] = {"list", 4, TOK_LIST},         [26] = {"continue", 8, TOK_CONTINUE},
+    [27] = {"import", 6, TOK_IMPORT},     [29] = {"if", 2, TOK_IF},
+    [30] = {"null", 4, TOK_NULL},         [32] = {"for", 3, TOK_FOR},
+    [33] = {"true", 4, TOK_TRUE},         [36] = {"any", 3, TOK_ANY},
+    [37] = {"const", 5, TOK_CONST},       [38] = {"auto", 4, TOK_AUTO},
+    [42] = {"defer", 5, TOK_DEFER},       [48] = {"static", 6, TOK_STATIC},
+    [52] = {"coro", 4, TOK_COROUTINE},    [53] = {"break", 5, TOK_BREAK},
+    [55] = {"int", 3, TOK_INT},           [56] = {"else", 4, TOK_ELSE},
+    [58] = {"float", 5, TOK_FLOAT},       [59] = {"str", 3, TOK_STR},
+    [60] = {"number", 6, TOK_NUMBER},     [61] = {"vars", 4, TOK_VARS},
+    [63] = {"export", 6, TOK_EXPORT},
 };
 
 static SptTokenKind keyword_lookup(const char *s, int len) {
-  for (size_t i = 0; i < sizeof(KEYWORDS) / sizeof(Keyword); i++) {
-    if ((int)strlen(KEYWORDS[i].kw) == len && memcmp(KEYWORDS[i].kw, s, (size_t)len) == 0)
-      return KEYWORDS[i].kind;
-  }
+  if (len < KW_MIN_LEN || len > KW_MAX_LEN)
+    return TOK_IDENTIFIER;
+  unsigned h = ((unsigned char)s[0] * 7u + (unsigned char)s[len - 1] * 33u + (unsigned)len * 12u) &
+               (KW_SLOTS - 1);
+  const Keyword *k = &KEYWORDS[h];
+  if (k->len == len && memcmp(k->kw, s, (size_t)len) == 0)
+    return k->kind;
   return TOK_IDENTIFIER;
 }
 
@@ -225,6 +243,180 @@ static char peek_at(Lexer *L, size_t off) {
   return p < L->len ? L->src[p] : '\0';
 }
 
+/* ===========================================================================
+ * 批量扫描（SIMD）
+ *
+ * 空白、注释体、字符串体、ASCII 标识符都是“一段连续字节里找第一个特殊字节”：每次比较
+ * LEX_VEC 个字节得到位掩码，ctz 取第一个命中位置，途经的换行用 popcount 计数、最高位定位
+ * 行首。x86-64 上默认 SSE2（16 字节），以 -mavx2 / /arch:AVX2 编译时改用 AVX2（32 字节）；
+ * 其余目标与剩余不足一个向量的尾部走标量循环。两条路径结果逐字节一致。
+ * ========================================================================= */
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LEX_VEC 32
+typedef __m256i LexVec;
+#define lv_load(p) _mm256_loadu_si256((const __m256i *)(const void *)(p))
+#define lv_splat(c) _mm256_set1_epi8((char)(c))
+#define lv_eq(a, b) _mm256_cmpeq_epi8((a), (b))
+#define lv_or(a, b) _mm256_or_si256((a), (b))
+#define lv_and(a, b) _mm256_and_si256((a), (b))
+#define lv_min(a, b) _mm256_min_epu8((a), (b))
+#define lv_max(a, b) _mm256_max_epu8((a), (b))
+#define lv_mask(v) ((uint32_t)_mm256_movemask_epi8(v))
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LEX_VEC 16
+typedef __m128i LexVec;
+#define lv_load(p) _mm_loadu_si128((const __m128i *)(const void *)(p))
+#define lv_splat(c) _mm_set1_epi8((char)(c))
+#define lv_eq(a, b) _mm_cmpeq_epi8((a), (b))
+#define lv_or(a, b) _mm_or_si128((a), (b))
+#define lv_and(a, b) _mm_and_si128((a), (b))
+#define lv_min(a, b) _mm_min_epu8((a), (b))
+#define lv_max(a, b) _mm_max_epu8((a), (b))
+#define lv_mask(v) ((uint32_t)_mm_movemask_epi8(v))
+#endif
+
+/* 0 = 默认（有向量单元时批量扫描），1 = 只走标量路径（spt_lex_set_scalar）。 */
+static int g_lex_scalar = 0;
+
+void spt_lex_set_scalar(int on) { g_lex_scalar = on ? 1 : 0; }
+
+/* 以下辅助只有批量扫描用到；没有向量单元的目标（aarch64、32 位 ARM 等）不编译。 */
+#ifdef LEX_VEC
+#define LEX_FULL ((uint32_t)(((uint64_t)1 << LEX_VEC) - 1))
+
+/* 无符号字节区间 [lo, hi] 判定：min/max 夹逼后与自身相等即在区间内。 */
+static LexVec lv_in(LexVec v, unsigned char lo, unsigned char hi) {
+  return lv_and(lv_eq(lv_max(v, lv_splat(lo)), v), lv_eq(lv_min(v, lv_splat(hi)), v));
+}
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+static int bit_ctz(uint32_t m) {
+  unsigned long i;
+  _BitScanForward(&i, m);
+  return (int)i;
+}
+static int bit_top(uint32_t m) {
+  unsigned long i;
+  _BitScanReverse(&i, m);
+  return (int)i;
+}
+static int bit_count(uint32_t m) {
+  m = m - ((m >> 1) & 0x55555555u);
+  m = (m & 0x33333333u) + ((m >> 2) & 0x33333333u);
+  return (int)((((m + (m >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24);
+}
+#else
+static int bit_ctz(uint32_t m) { return __builtin_ctz(m); }
+static int bit_top(uint32_t m) { return 31 - __builtin_clz(m); }
+static int bit_count(uint32_t m) { return __builtin_popcount(m); }
+#endif
+
+/* 记录 [at, at + LEX_VEC) 内由掩码 nl 标出的换行（nl 非零）。 */
+static void note_newlines(Lexer *L, size_t at, uint32_t nl) {
+  L->line += bit_count(nl);
+  L->line_start = at + (size_t)bit_top(nl) + 1;
+}
+#endif /* LEX_VEC */
+
+/* 跳过空白（空格、制表、CR、LF），更新行号。 */
+static void skip_blank(Lexer *L) {
+#ifdef LEX_VEC
+  if (!g_lex_scalar) {
+    const LexVec sp = lv_splat(' '), tab = lv_splat('\t'), cr = lv_splat('\r'),
+                 lf = lv_splat('\n');
+    while (L->pos + LEX_VEC <= L->len) {
+      LexVec v = lv_load(L->src + L->pos);
+      LexVec nlv = lv_eq(v, lf);
+      uint32_t ws = lv_mask(lv_or(lv_or(lv_eq(v, sp), lv_eq(v, tab)), lv_or(lv_eq(v, cr), nlv)));
+      uint32_t nl = lv_mask(nlv);
+      uint32_t stop = ~ws & LEX_FULL;
+      if (stop)
+        nl &= ((uint32_t)1 << bit_ctz(stop)) - 1;
+      if (nl)
+        note_newlines(L, L->pos, nl);
+      if (stop) {
+        L->pos += (size_t)bit_ctz(stop);
+        return;
+      }
+      L->pos += LEX_VEC;
+    }
+  }
+#endif
+  while (L->pos < L->len) {
+    char c = L->src[L->pos];
+    if (c == '\n') {
+      L->pos++;
+      L->line++;
+      L->line_start = L->pos;
+    } else if (c == ' ' || c == '\t' || c == '\r') {
+      L->pos++;
+    } else {
+      return;
+    }
+  }
+}
+
+/* 前进到第一个 a 或 b（不存在则到文末），途经的换行计入行号。 */
+static void advance_to(Lexer *L, char a, char b) {
+#ifdef LEX_VEC
+  if (!g_lex_scalar) {
+    const LexVec va = lv_splat(a), vb = lv_splat(b), lf = lv_splat('\n');
+    while (L->pos + LEX_VEC <= L->len) {
+      LexVec v = lv_load(L->src + L->pos);
+      uint32_t stop = lv_mask(lv_or(lv_eq(v, va), lv_eq(v, vb)));
+      uint32_t nl = lv_mask(lv_eq(v, lf));
+      if (stop)
+        nl &= ((uint32_t)1 << bit_ctz(stop)) - 1;
+      if (nl)
+        note_newlines(L, L->pos, nl);
+      if (stop) {
+        L->pos += (size_t)bit_ctz(stop);
+        return;
+      }
+      L->pos += LEX_VEC;
+    }
+  }
+#endif
+  while (L->pos < L->len) {
+    char c = L->src[L->pos];
+    if (c == a || c == b)
+      return;
+    if (c == '\n') {
+      L->line++;
+      L->line_start = L->pos + 1;
+    }
+    L->pos++;
+  }
+}
+
+static int is_ident_ascii(unsigned char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || (c >= '0' && c <= '9');
+}
+
+/* 前进过一段 ASCII 标识符字符 [A-Za-z0-9_]。 */
+static void skip_ident_ascii(Lexer *L) {
+#ifdef LEX_VEC
+  if (!g_lex_scalar) {
+    while (L->pos + LEX_VEC <= L->len) {
+      LexVec v = lv_load(L->src + L->pos);
+      LexVec id = lv_or(lv_or(lv_in(v, 'a', 'z'), lv_in(v, 'A', 'Z')),
+                        lv_or(lv_in(v, '0', '9'), lv_eq(v, lv_splat('_'))));
+      uint32_t stop = ~lv_mask(id) & LEX_FULL;
+      if (stop) {
+        L->pos += (size_t)bit_ctz(stop);
+        return;
+      }
+      L->pos += LEX_VEC;
+    }
+  }
+#endif
+  while (L->pos < L->len && is_ident_ascii((unsigned char)L->src[L->pos]))
+    L->pos++;
+}
+
 /* ===========================================================================
  * 各类词素扫描
  * ========================================================================= */
@@ -232,22 +424,16 @@ static char peek_at(Lexer *L, size_t off) {
 /* 跳过空白与注释，更新行号。 */
 static void skip_trivia(Lexer *L) {
   for (;;) {
+    skip_blank(L);
     if (L->pos >= L->len)
       return;
     char c = L->src[L->pos];
-    if (c == ' ' || c == '\t' || c == '\r') {
-      L->pos++;
-    } else if (c == '\n') {
-      L->pos++;
-      L->line++;
-      L->line_start = L->pos;
-    } else if (c == '/' && peek_at(L, 1) == '/') {
+    if (c == '/' && peek_at(L, 1) == '/') {
       /* 行注释：/// 为文档注释（捕获），// 为普通注释（跳过） */
       int is_doc = (peek_at(L, 2) == '/');
       L->pos += is_doc ? 3 : 2;
       size_t text_start = L->pos;
-      while (L->pos < L->len && L->src[L->pos] != '\n')
-        L->pos++;
+      advance_to(L, '\n', '\n');
       if (is_doc) {
         size_t s = text_start;
         /* 去掉文本开头的空格/制表符 */
@@ -265,17 +451,16 @@ static void skip_trivia(Lexer *L) {
       size_t inner_start = L->pos;
       int closed = 0;
       size_t inner_end = L->pos;
-      while (L->pos < L->len) {
-        if (L->src[L->pos] == '*' && peek_at(L, 1) == '/') {
+      for (;;) {
+        advance_to(L, '*', '*');
+        if (L->pos >= L->len)
+          break;
+        if (peek_at(L, 1) == '/') {
           inner_end = L->pos;
           L->pos += 2;
           closed = 1;
           break;
         }
-        if (L->src[L->pos] == '\n') {
-          L->line++;
-          L->line_start = L->pos + 1;
-        }
         L->pos++;
       }
       if (!closed) {
@@ -370,9 +555,11 @@ static int scan_string(Lexer *L) {
   int sline = L->line, scol = lex_col(L, L->pos);
   char quote = L->src[L->pos];
   L->pos++; /* 跳过开引号 */
-  while (L->pos < L->len) {
-    char c = L->src[L->pos];
-    if (c == '\\') {
+  for (;;) {
+    advance_to(L, quote, '\\');
+    if (L->pos >= L->len)
+      break;
+    if (L->src[L->pos] == '\\') {
       /* 转义：消耗反斜杠与其后一个字符（保证 \" 不闭合字符串） */
       L->pos++;
       if (L->pos < L->len) {
@@ -384,15 +571,8 @@ static int scan_string(Lexer *L) {
       }
       continue;
     }
-    if (c == quote) {
-      L->pos++; /* 跳过闭引号 */
-      return 1;
-    }
-    if (c == '\n') {
-      L->line++;
-      L->line_start = L->pos + 1;
-    }
-    L->pos++;
+    L->pos++; /* 跳过闭引号 */
+    return 1;
   }
   lex_error(L, sline, scol, "%s", "字符串字面量未闭合");
   return 0;
@@ -400,22 +580,16 @@ static int scan_string(Lexer *L) {
 
 /* 扫描标识符/关键字。pos 推进到末尾。返回 token 种类。 */
 static SptTokenKind scan_identifier(Lexer *L, size_t start) {
-  /* 首字符已确认是 ident-start，逐码点推进 */
-  while (L->pos < L->len) {
-    unsigned char c = (unsigned char)L->src[L->pos];
-    if (c < 0x80) {
-      if (is_ident_part_cp(c))
-        L->pos++;
-      else
-        break;
-    } else {
-      int adv;
-      uint32_t cp = utf8_decode(L->src + L->pos, L->len - L->pos, &adv);
-      if (cp != 0xFFFFFFFFu && is_ident_part_cp(cp))
-        L->pos += (size_t)adv;
-      else
-        break;
-    }
+  /* 首字符已确认是 ident-start：ASCII 段批量跳过，遇到非 ASCII 再逐码点判定 */
+  for (;;) {
+    skip_ident_ascii(L);
+    if (L->pos >= L->len || (unsigned char)L->src[L->pos] < 0x80)
+      break;
+    int adv;
+    uint32_t cp = utf8_decode(L->src + L->pos, L->len - L->pos, &adv);
+    if (cp == 0xFFFFFFFFu || !is_ident_part_cp(cp))
+      break;
+    L->pos += (size_t)adv;
   }
   return keyword_lookup(L->src + start, (int)(L->pos - start));
 }
@@ -424,12 +598,19 @@ static SptTokenKind scan_identifier(Lexer *L, size_t start) {
  * 主循环
  * ========================================================================= */
 int spt_lex(const char *source, size_t len, SptArena *arena, SptDiag *diag, SptTokenArray *out) {
+  return spt_lex_at(source, len, 1, 1, arena, diag, out);
+}
+
+int spt_lex_at(const char *source, size_t len, int line, int column, SptArena *arena,
+               SptDiag *diag, SptTokenArray *out) {
   Lexer L;
   L.src = source;
   L.len = len;
   L.pos = 0;
-  L.line = 1;
-  L.line_start = 0;
+  L.line = line;
+  /* 首行起点取在 source 之前 column-1 字节处，使 lex_col(0) == column；
+     无符号回绕在 lex_col 的差值里抵消。 */
+  L.line_start = (size_t)0 - (size_t)(column - 1);
   L.arena = arena;
   L.diag = diag;
   L.had_error = 0;
@@ -23,4 +23,14 @@ typedef struct {
 ** 成功返回 1；遇到非法字符等词法错误返回 0 并向 diag 写入诊断。 */
 int spt_lex(const char *source, size_t len, SptArena *arena, SptDiag *diag, SptTokenArray *out);
 
+/* 同 spt_lex，但把 source[0] 视为位于 (line, column)（均 1 起）：用于对整篇源码中的
+** 一个片段做词法分析（LSP 增量重解析），产出的 token 行列即为整篇坐标。 */
+int spt_lex_at(const char *source, size_t len, int line, int column, SptArena *arena,
+               SptDiag *diag, SptTokenArray *out);
+
+/* 空白、注释体、字符串体与标识符默认按向量宽度批量扫描（x86-64 为 SSE2，AVX2 构建为 32 字节）。
+** 传 1 强制只走标量路径，供基准与一致性测试对比；两条路径产出的 token 完全相同。
+** 进程级开关，应在开始词法分析前设置。 */
+void spt_lex_set_scalar(int on);
+
 #endif /* SPT_LEXER_H */
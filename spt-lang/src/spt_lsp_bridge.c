@@ -76,8 +76,340 @@ SptLspUnit *spt_lsp_parse(const char *source, size_t len) {
   return u;
 }
 
+/* ===========================================================================
+** 增量重解析
+** ========================================================================= */
+
+/* token 在其所属源码中的字节偏移。 */
+static size_t tok_off(const SptLspUnit *u, int i) {
+  return (size_t)(u->tokens[i].lexeme - u->source);
+}
+
+/* 最后一个偏移 <= off 的 token 下标（无则 0）。EOF token 的偏移即源码长度。 */
+static int tok_at_or_before(const SptLspUnit *u, size_t off) {
+  int lo = 0, hi = u->token_count - 1, r = 0;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (tok_off(u, mid) <= off) {
+      r = mid;
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return r;
+}
+
+static int loc_cmp(int l1, int c1, int l2, int c2) {
+  return l1 != l2 ? (l1 < l2 ? -1 : 1) : (c1 != c2 ? (c1 < c2 ? -1 : 1) : 0);
+}
+
+/* 顶层语句 i 的首 token 下标：按 loc 二分定位，`export class` 的 loc 在 class 上，回退一格。
+   loc 不落在任何 token 起点上时返回 -1（边界不可信）。 */
+static int stmt_first_tok(const SptLspUnit *u, int i) {
+  const AstNode *s = u->root->u.block.statements.items[i];
+  int lo = 0, hi = u->token_count - 1, r = -1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    const SptToken *t = &u->tokens[mid];
+    int c = loc_cmp(t->line, t->column, s->loc.line, s->loc.column);
+    if (c == 0) {
+      r = mid;
+      break;
+    }
+    if (c < 0)
+      lo = mid + 1;
+    else
+      hi = mid - 1;
+  }
+  if (r > 0 && u->tokens[r - 1].kind == TOK_EXPORT)
+    r--;
+  return r;
+}
+
+/* 包含 token k 的顶层语句：最后一个首 token <= k 的语句（无则 0）。 */
+static int stmt_containing(const SptLspUnit *u, int k) {
+  int lo = 0, hi = u->root->u.block.statements.count - 1, r = 0;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    int t = stmt_first_tok(u, mid);
+    if (t < 0)
+      return -1;
+    if (t <= k) {
+      r = mid;
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return r;
+}
+
+static int is_stmt_end(SptTokenKind k) { return k == TOK_SEMICOLON || k == TOK_RBRACE; }
+
+/* 拼接点 prev|next 是否必然是语句边界：';' 之后总是；'}' 之后只有 next 不可能延续前一条语句
+   （如 `else`、`(`、`.`、运算符、lambda 后的调用）时才是。prev < 0 表示文件开头。 */
+static int join_ok(int prev, int next) {
+  if (prev != TOK_RBRACE)
+    return 1;
+  if (next == TOK_IDENTIFIER || next == TOK_SEMICOLON || next == TOK_EOF)
+    return 1;
+  return next >= TOK_INT && next <= TOK_CLASS && next != TOK_ELSE && next != TOK_AS &&
+         next != TOK_FROM;
+}
+
+/* 后缀位置平移：原位于 line 行的列加 dc，所有行加 dl。 */
+typedef struct {
+  int line, dl, dc;
+} Shift;
+
+static void shift_loc(SourceLocation *l, const Shift *sh) {
+  if (l->line == sh->line)
+    l->column += sh->dc;
+  l->line += sh->dl;
+}
+
+static void shift_node(AstNode *n, void *ctx) {
+  const Shift *sh = (const Shift *)ctx;
+  shift_loc(&n->loc, sh);
+  if (n->type == NODE_BLOCK)
+    shift_loc(&n->u.block.end_loc, sh);
+  spt_ast_for_each_child(n, shift_node, ctx);
+}
+
+SptLspUnit *spt_lsp_reparse(SptLspUnit *old, const char *source, size_t len, size_t start,
+                            size_t old_end, size_t new_end, SptLspReparse *info) {
+  if (!old || !old->root || old->root->type != NODE_BLOCK || old->token_count <= 0 || !source)
+    return NULL;
+  const AstList *st = &old->root->u.block.statements;
+  int n = st->count;
+  if (n == 0 || start > old_end || old_end > old->source_len || start > new_end ||
+      old->source_len - (old_end - start) + (new_end - start) != len)
+    return NULL;
+  /* 旧片段在 arena 中成为垃圾；累计重解析量超过源码长度时全量重建以回收（arena 增长摊还与编辑
+     成正比；下面组装新单元的复制/平移仍是 O(文件)，见头文件）。 */
+  if (old->reparse_debt > old->source_len)
+    return NULL;
+
+  /* 1. 编辑区间 -> 包围它的顶层语句 [ia, ib]。 */
+  int ia = stmt_containing(old, tok_at_or_before(old, start));
+  int ib = old_end > start ? stmt_containing(old, tok_at_or_before(old, old_end - 1)) : ia;
+  if (ia < 0 || ib < 0)
+    return NULL;
+  /* 编辑紧贴首语句起点：其前的文档注释归属可能改变，连同上一条语句一起重解析。 */
+  int ta = stmt_first_tok(old, ia);
+  if (ia > 0 && start <= tok_off(old, ta))
+    ta = stmt_first_tok(old, --ia);
+  if (ia == 0)
+    ta = 0;
+  /* 编辑触及下一条语句前的空白/注释（其文档注释）时，把下一条语句也纳入。 */
+  int tb;
+  for (;;) {
+    tb = ib + 1 < n ? stmt_first_tok(old, ib + 1) : old->token_count - 1;
+    if (tb < 0)
+      return NULL;
+    if (ib + 1 >= n || tb == 0)
+      break;
+    const SptToken *last = &old->tokens[tb - 1];
+    if (old_end <= (size_t)(last->lexeme - old->source) + (size_t)last->length)
+      break;
+    ib++;
+  }
+  /* 片段两端必须是可靠的语句边界。 */
+  if (ta > 0 && !is_stmt_end(old->tokens[ta - 1].kind))
+    return NULL;
+  if (ib + 1 < n && (tb == 0 || !is_stmt_end(old->tokens[tb - 1].kind)))
+    return NULL;
+  size_t ra = ta > 0 ? tok_off(old, ta) : 0;
+  size_t rb_old = tok_off(old, tb); /* 后缀首 token（或 EOF）偏移 */
+  if (rb_old < old_end)
+    return NULL;
+  size_t rb_new = rb_old - old_end + new_end;
+
+  /* 2. 新源码副本（堆，单元拥有），片段在其中就地词法分析，token 直接指向它。 */
+  char *src = (char *)malloc(len + 1);
+  if (!src)
+    return NULL;
+  memcpy(src, source, len);
+  src[len] = '\0';
+
+  SptArena *arena = (SptArena *)old->arena;
+  SptDiag diag;
+  spt_diag_init(&diag, "<lsp>", src, len);
+  int line0 = ta > 0 ? old->tokens[ta].line : 1;
+  int col0 = ta > 0 ? old->tokens[ta].column : 1;
+  SptTokenArray rt;
+  if (!spt_lex_at(src + ra, rb_new - ra, line0, col0, arena, &diag, &rt) || rt.count <= 0) {
+    free(src);
+    return NULL;
+  }
+  int rcount = rt.count - 1; /* 不含片段 EOF */
+  /* 片段内括号必须平衡，且（非文件末尾时）以 ';' / '}' 收尾，否则全量解析可能跨越边界。 */
+  int depth = 0;
+  for (int i = 0; i < rcount && depth >= 0; i++) {
+    SptTokenKind k = rt.tokens[i].kind;
+    if (k == TOK_LBRACE || k == TOK_LPAREN || k == TOK_LBRACKET)
+      depth++;
+    else if (k == TOK_RBRACE || k == TOK_RPAREN || k == TOK_RBRACKET)
+      depth--;
+  }
+  int at_eof = ib + 1 >= n;
+  int prev = ta > 0 ? (int)old->tokens[ta - 1].kind : -1;
+  int first = rcount > 0 ? (int)rt.tokens[0].kind : (int)old->tokens[tb].kind;
+  int last = rcount > 0 ? (int)rt.tokens[rcount - 1].kind : prev;
+  if (depth != 0 || !join_ok(prev, first) ||
+      (!at_eof && last >= 0 && (!is_stmt_end((SptTokenKind)last) ||
+                                !join_ok(last, (int)old->tokens[tb].kind)))) {
+    free(src);
+    return NULL;
+  }
+  /* 片段首 token 的文档注释位于片段之前（未被编辑），沿用旧值。片段若删空，注释将改挂到
+     后缀首 token 上，此时回退全量。 */
+  if (ta > 0 && old->tokens[ta].doc) {
+    if (rcount == 0) {
+      free(src);
+      return NULL;
+    }
+    if (!rt.tokens[0].doc)
+      rt.tokens[0].doc = old->tokens[ta].doc;
+  }
+  /* 片段内某语句（含其错误恢复）读到了片段 EOF：接上后缀后它可能吞掉后缀 token，回退全量。 */
+  int crossed = 0;
+  AstNode *rroot = spt_parse_fragment(&rt, arena, &diag, &crossed);
+  if (!rroot || rroot->type != NODE_BLOCK || (crossed && !at_eof)) {
+    free(src);
+    return NULL;
+  }
+
+  /* 3. 后缀平移量：片段 EOF 的位置即后缀首 token 的新位置。 */
+  const SptToken *sfx = &old->tokens[tb];
+  const SptToken *reof = &rt.tokens[rcount];
+  Shift sh = {sfx->line, reof->line - sfx->line, reof->column - sfx->column};
+  ptrdiff_t dbytes = (ptrdiff_t)new_end - (ptrdiff_t)old_end;
+
+  /* 诊断：前缀保留、片段内丢弃、后缀平移，片段的新诊断插在中间。超出前端上限则回退全量。 */
+  int keep = 0;
+  for (int i = 0; i < old->diag_count; i++) {
+    const SptLspDiag *dg = &old->diags[i];
+    if (loc_cmp(dg->line, dg->column, line0, col0) < 0 ||
+        (!at_eof && loc_cmp(dg->line, dg->column, sfx->line, sfx->column) >= 0))
+      keep++;
+  }
+  int dcount = keep + diag.count;
+  if (dcount > SPT_DIAG_MAX) {
+    free(src);
+    return NULL;
+  }
+
+  /* 4. 组装新单元（与 old 共享 arena）。 */
+  int tcount = ta + rcount + (old->token_count - tb);
+  SptToken *toks = (SptToken *)malloc(sizeof(SptToken) * (size_t)tcount);
+  SptLspDiag *diags = dcount ? (SptLspDiag *)malloc(sizeof(SptLspDiag) * (size_t)dcount) : NULL;
+  int stmt_count = n - (ib - ia + 1) + rroot->u.block.statements.count;
+  AstNode **items =
+      (AstNode **)spt_arena_alloc(arena, sizeof(AstNode *) * (size_t)(stmt_count ? stmt_count : 1));
+  SptLspUnit *u = (SptLspUnit *)spt_arena_alloc(arena, sizeof(SptLspUnit));
+  AstNode *root = spt_ast_new(arena, NODE_BLOCK, old->root->loc);
+  if (!toks || (dcount && !diags) || !items || !u || !root) {
+    free(src);
+    free(toks);
+    free(diags);
+    return NULL;
+  }
+
+  /* token：前缀改指新源码；片段直接取用；后缀（含 EOF）平移行列与偏移。 */
+  for (int i = 0; i < ta; i++) {
+    toks[i] = old->tokens[i];
+    toks[i].lexeme = src + tok_off(old, i);
+  }
+  memcpy(toks + ta, rt.tokens, sizeof(SptToken) * (size_t)rcount);
+  for (int i = tb, w = ta + rcount; i < old->token_count; i++, w++) {
+    SptToken t = old->tokens[i];
+    t.lexeme = src + (ptrdiff_t)tok_off(old, i) + dbytes;
+    SourceLocation l = {t.line, t.column};
+    shift_loc(&l, &sh);
+    t.line = l.line;
+    t.column = l.column;
+    toks[w] = t;
+  }
+  if (at_eof)
+    toks[tcount - 1] = *reof;
+
+  int w = 0;
+  for (int i = 0; i < old->diag_count; i++) {
+    const SptLspDiag *dg = &old->diags[i];
+    if (loc_cmp(dg->line, dg->column, line0, col0) < 0)
+      diags[w++] = *dg;
+  }
+  for (int i = 0; i < diag.count; i++) {
+    diags[w].line = diag.entries[i].line;
+    diags[w].column = diag.entries[i].column;
+    diags[w].message = spt_arena_strdup(arena, diag.entries[i].message);
+    w++;
+  }
+  for (int i = 0; i < old->diag_count && !at_eof; i++) {
+    const SptLspDiag *dg = &old->diags[i];
+    if (loc_cmp(dg->line, dg->column, sfx->line, sfx->column) >= 0) {
+      SourceLocation l = {dg->line, dg->column};
+      shift_loc(&l, &sh);
+      diags[w] = *dg;
+      diags[w].line = l.line;
+      diags[w].column = l.column;
+      w++;
+    }
+  }
+
+  /* AST：前缀语句原样、片段语句替换、后缀语句就地平移。 */
+  const AstList *rs = &rroot->u.block.statements;
+  int si = 0;
+  for (int i = 0; i < ia; i++)
+    items[si++] = st->items[i];
+  for (int i = 0; i < rs->count; i++)
+    items[si++] = rs->items[i];
+  for (int i = ib + 1; i < n; i++) {
+    shift_node(st->items[i], &sh);
+    items[si++] = st->items[i];
+  }
+  root->u.block.statements.items = items;
+  root->u.block.statements.count = stmt_count;
+  root->u.block.end_loc = (SourceLocation){toks[tcount - 1].line, toks[tcount - 1].column};
+  root->u.block.use_end = true;
+  if (ta == 0)
+    root->loc = (SourceLocation){toks[0].line, toks[0].column};
+
+  u->arena = arena;
+  u->root = root;
+  u->tokens = u->own_tokens = toks;
+  u->token_count = tcount;
+  u->diags = u->own_diags = diags;
+  u->diag_count = dcount;
+  u->source = u->own_source = src;
+  u->source_len = len;
+  u->reparse_debt = old->reparse_debt + (rb_new - ra);
+
+  if (info) {
+    info->first_stmt = ia;
+    info->old_stmts = ib - ia + 1;
+    info->new_stmts = rs->count;
+    info->first_tok = ta;
+    info->new_toks = rcount;
+    info->start = ra;
+    info->old_end = rb_old;
+    info->new_end = rb_new;
+  }
+
+  /* old 的堆缓冲已被新单元取代；arena 由新单元接管。 */
+  free(old->own_source);
+  free(old->own_tokens);
+  free(old->own_diags);
+  return u;
+}
+
 void spt_lsp_unit_free(SptLspUnit *u) {
   if (!u)
     return;
+  free(u->own_source);
+  free(u->own_tokens);
+  free(u->own_diags);
   spt_arena_destroy((SptArena *)u->arena);
 }
@@ -36,11 +36,45 @@ typedef struct SptLspUnit {
 
   const char *source; /* 规范化（LF）后的源码副本，NUL 结尾 */
   size_t source_len;
+
+  /* 增量重解析（spt_lsp_reparse）产出的单元：source/tokens/diags 改由堆缓冲承载并由单元拥有
+     （每次编辑整体替换，不在 arena 里累积）；全量解析的单元三者均为 NULL。 */
+  char *own_source;
+  SptToken *own_tokens;
+  SptLspDiag *own_diags;
+  size_t reparse_debt; /* 自上次全量解析以来累计重解析的字节数（arena 中旧片段的上界） */
 } SptLspUnit;
 
+/* 一次增量重解析的结果摘要：新单元中被替换的顶层语句与 token 区间。 */
+typedef struct {
+  int first_stmt; /* 首条被替换的顶层语句下标（新旧相同） */
+  int old_stmts;  /* 被移除的旧语句数 */
+  int new_stmts;  /* 重解析得到的新语句数 */
+  int first_tok;  /* 重解析片段首 token 下标（新旧相同） */
+  int new_toks;   /* 片段内新 token 数（不含 EOF） */
+  size_t start;   /* 片段起点字节偏移（新旧相同） */
+  size_t old_end; /* 片段终点：旧源码中的字节偏移 */
+  size_t new_end; /* 片段终点：新源码中的字节偏移；其后 token 偏移 = 旧偏移 + new_end - old_end */
+} SptLspReparse;
+
 /* 解析源码为分析单元。永不返回 NULL（除 OOM）；诊断在 unit->diags。 */
 SptLspUnit *spt_lsp_parse(const char *source, size_t len);
 
+/* 增量重解析：旧源码 [start, old_end) 被替换为新源码 [start, new_end)，source/len 为编辑后的
+** 整篇源码（须已 LF 规范化，与 Document 文本一致）。
+**
+** 把编辑区间映射到 old 中包围它的顶层语句，只对这些语句所占的源码片段重新词法/容错解析，
+** 其后语句的 AST / token / 诊断位置整体平移，前缀原样保留。成功时返回新单元并接管 old 的
+** arena（old 不得再使用或释放），*info（可空）给出被替换的区间；片段边界不可靠（括号不平衡、
+** 片段不以 ';' / '}' 收尾、旧单元有词法失败等）或累计重解析量已超过源码长度（需全量解析
+** 回收 arena）时返回 NULL，old 保持不变，调用方应回退 spt_lsp_parse。
+**
+** 与编辑成正比的只有词法/语法分析：组装新单元仍是 O(文件)——整篇源码复制一份，token 数组
+** 整体复制并逐个平移后缀，后缀语句的 AST 与诊断逐节点平移。这些是线性拷贝，比重新解析
+** 便宜，但每次按键的代价仍随文件长度增长。 */
+SptLspUnit *spt_lsp_reparse(SptLspUnit *old, const char *source, size_t len, size_t start,
+                            size_t old_end, size_t new_end, SptLspReparse *info);
+
 /* 释放单元及其全部内存。u 可为 NULL。 */
 void spt_lsp_unit_free(SptLspUnit *u);
 
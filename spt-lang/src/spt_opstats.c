@@ -0,0 +1,369 @@
+/*
+** spt_opstats.c — interpreter dispatch statistics (see spt_opstats.h).
+**
+** spt_opstats_inst runs once per interpreted instruction, so it keeps the
+** counter block of the last Proto it saw: a Proto switch (call/return) costs
+** one hash lookup, every other instruction two increments. Counter blocks
+** live on the C heap and are dropped when their Proto is freed
+** (luaF_freeproto), so a report covers the functions still alive.
+*/
+#define spt_opstats_c
+#define LUA_CORE
+
+#include "lprefix.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lua.h"
+
+#include "ldebug.h"
+#include "lobject.h"
+#include "lopcodes.h"
+#include "lopnames.h"
+#include "lstate.h"
+
+#include "spt_opstats.h"
+
+#define OPS_NSLOW 3
+#define OPS_DEFAULT_TOPN 20
+
+typedef struct OpSite {
+  unsigned long long count; /* executions of this instruction */
+  unsigned long long slow;  /* finishget/finishset taken while executing it */
+} OpSite;
+
+typedef struct OpProto {
+  const Proto *p; /* NULL = empty slot */
+  OpSite *sites;  /* one per instruction */
+  int n;
+} OpProto;
+
+struct SPTOpStats {
+  int active;
+  unsigned long long ops[NUM_OPCODES];
+  unsigned long long slow[OPS_NSLOW];
+
+  /* Last Proto seen by spt_opstats_inst and the instruction executing. */
+  const Proto *last_p;
+  OpSite *last_sites;
+  int last_pc;
+
+  OpProto *protos; /* open addressing keyed by Proto address */
+  size_t sizeprotos, nprotos;
+};
+
+static size_t proto_hash(const Proto *p) {
+  size_t h = (size_t)p;
+  h ^= h >> 17;
+  h *= 0x9E3779B1u;
+  return h ^ (h >> 15);
+}
+
+#if defined(SPT_OPSTATS)
+
+static int protos_grow(SPTOpStats *os) {
+  size_t nsize = os->sizeprotos ? os->sizeprotos * 2 : 64;
+  OpProto *nt = (OpProto *)calloc(nsize, sizeof(OpProto));
+  if (!nt)
+    return 0;
+  for (size_t i = 0; i < os->sizeprotos; i++) {
+    OpProto *e = &os->protos[i];
+    if (!e->p)
+      continue;
+    size_t j = proto_hash(e->p) & (nsize - 1);
+    while (nt[j].p)
+      j = (j + 1) & (nsize - 1);
+    nt[j] = *e;
+  }
+  free(os->protos);
+  os->protos = nt;
+  os->sizeprotos = nsize;
+  return 1;
+}
+
+static OpSite *proto_sites(SPTOpStats *os, const Proto *p) {
+  size_t mask = os->sizeprotos - 1;
+  size_t j = proto_hash(p) & mask;
+  while (os->protos[j].p) {
+    if (os->protos[j].p == p)
+      return os->protos[j].sites;
+    j = (j + 1) & mask;
+  }
+  if ((os->nprotos + 1) * 4 > os->sizeprotos * 3) {
+    if (!protos_grow(os))
+      return NULL;
+    return proto_sites(os, p);
+  }
+  OpSite *sites = (OpSite *)calloc(p->sizecode > 0 ? (size_t)p->sizecode : 1, sizeof(OpSite));
+  if (!sites)
+    return NULL;
+  os->protos[j].p = p;
+  os->protos[j].sites = sites;
+  os->protos[j].n = p->sizecode;
+  os->nprotos++;
+  return sites;
+}
+
+#endif /* SPT_OPSTATS */
+
+/* =====================================================================
+** Hooks
+** ===================================================================== */
+
+void spt_opstats_inst(SPTOpStats *os, const Proto *p, int pc, int op) {
+  if (!os->active)
+    return;
+  os->ops[op]++;
+#if defined(SPT_OPSTATS)
+  if (p != os->last_p) {
+    os->last_p = p;
+    os->last_sites = proto_sites(os, p);
+  }
+  os->last_pc = pc;
+  if (os->last_sites && pc >= 0 && pc < p->sizecode)
+    os->last_sites[pc].count++;
+#else
+  (void)p;
+  (void)pc;
+#endif
+}
+
+void spt_opstats_slowpath(SPTOpStats *os, int kind) {
+  if (!os->active)
+    return;
+  os->slow[kind]++;
+  if (os->last_sites && os->last_pc >= 0 && os->last_pc < os->last_p->sizecode)
+    os->last_sites[os->last_pc].slow++;
+}
+
+void spt_opstats_freeproto(SPTOpStats *os, const Proto *p) {
+  if (os->last_p == p) {
+    os->last_p = NULL;
+    os->last_sites = NULL;
+  }
+  if (os->nprotos == 0)
+    return;
+  size_t mask = os->sizeprotos - 1;
+  size_t j = proto_hash(p) & mask;
+  while (os->protos[j].p != p) {
+    if (!os->protos[j].p)
+      return; /* never executed while counting */
+    j = (j + 1) & mask;
+  }
+  free(os->protos[j].sites);
+  os->nprotos--;
+  /* Backward-shift deletion keeps probe chains intact without tombstones. */
+  for (size_t k = (j + 1) & mask; os->protos[k].p; k = (k + 1) & mask) {
+    size_t home = proto_hash(os->protos[k].p) & mask;
+    if (((k - home) & mask) >= ((k - j) & mask)) {
+      os->protos[j] = os->protos[k];
+      j = k;
+    }
+  }
+  os->protos[j].p = NULL;
+}
+
+/* =====================================================================
+** Queries and report
+** ===================================================================== */
+
+static unsigned long long op_range(const SPTOpStats *os, int from, int to) {
+  unsigned long long n = 0;
+  for (int op = from; op <= to; op++)
+    n += os->ops[op];
+  return n;
+}
+
+static unsigned long long slow_count(const SPTOpStats *os, int kind) {
+  if (kind == SPT_OPSLOW_MMBIN)
+    return op_range(os, OP_MMBIN, OP_MMBINK);
+  return os->slow[kind];
+}
+
+LUA_API unsigned long long spt_opstats_opcount(lua_State *L, const char *opname) {
+  SPTOpStats *os = G(L)->opstats;
+  if (!os || !opname)
+    return 0;
+  for (int op = 0; op < NUM_OPCODES; op++)
+    if (strcmp(opnames[op], opname) == 0)
+      return os->ops[op];
+  return 0;
+}
+
+LUA_API unsigned long long spt_opstats_total(lua_State *L) {
+  SPTOpStats *os = G(L)->opstats;
+  return os ? op_range(os, 0, NUM_OPCODES - 1) : 0;
+}
+
+LUA_API unsigned long long spt_opstats_slow(lua_State *L, int kind) {
+  SPTOpStats *os = G(L)->opstats;
+  if (!os || kind < 0 || kind >= OPS_NSLOW)
+    return 0;
+  return slow_count(os, kind);
+}
+
+typedef struct OpRow {
+  const Proto *p;
+  int pc;
+  unsigned long long count, slow;
+} OpRow;
+
+static int oprow_cmp(const void *a, const void *b) {
+  const OpRow *x = (const OpRow *)a, *y = (const OpRow *)b;
+  if (x->count != y->count)
+    return x->count < y->count ? 1 : -1;
+  return (x->pc > y->pc) - (x->pc < y->pc);
+}
+
+static int opcode_cmp(const void *a, const void *b) {
+  const unsigned long long *x = *(const unsigned long long *const *)a;
+  const unsigned long long *y = *(const unsigned long long *const *)b;
+  return (*x < *y) - (*x > *y);
+}
+
+static double pct(unsigned long long part, unsigned long long whole) {
+  return whole ? 100.0 * (double)part / (double)whole : 0.0;
+}
+
+/* Keep the `topn` hottest instructions in rows[0..*nrows) (sorted). */
+static void hot_sites(SPTOpStats *os, OpRow *rows, int topn, int *nrows) {
+  *nrows = 0;
+  for (size_t i = 0; i < os->sizeprotos; i++) {
+    OpProto *e = &os->protos[i];
+    if (!e->p)
+      continue;
+    for (int pc = 0; pc < e->n; pc++) {
+      OpRow r = {e->p, pc, e->sites[pc].count, e->sites[pc].slow};
+      if (r.count == 0)
+        continue;
+      if (*nrows == topn && oprow_cmp(&r, &rows[topn - 1]) >= 0)
+        continue;
+      int at = (*nrows < topn) ? (*nrows)++ : topn - 1;
+      while (at > 0 && oprow_cmp(&r, &rows[at - 1]) < 0) { /* insertion sort */
+        rows[at] = rows[at - 1];
+        at--;
+      }
+      rows[at] = r;
+    }
+  }
+}
+
+LUA_API int spt_opstats_dump(lua_State *L, const char *path, int topn) {
+  SPTOpStats *os = G(L)->opstats;
+  if (!os)
+    return -1;
+  unsigned long long total = op_range(os, 0, NUM_OPCODES - 1);
+  if (total == 0)
+    return -1;
+  if (topn <= 0)
+    topn = OPS_DEFAULT_TOPN;
+  OpRow *rows = (OpRow *)malloc((size_t)topn * sizeof(OpRow));
+  if (!rows)
+    return -1;
+  FILE *f = path ? fopen(path, "w") : stderr;
+  if (!f) {
+    free(rows);
+    return -1;
+  }
+
+  const unsigned long long *order[NUM_OPCODES];
+  for (int op = 0; op < NUM_OPCODES; op++)
+    order[op] = &os->ops[op];
+  qsort(order, NUM_OPCODES, sizeof(order[0]), opcode_cmp);
+  fprintf(f, "# opcodes: %llu instructions\n", total);
+  fprintf(f, "%14s %7s  %s\n", "count", "%", "opcode");
+  for (int k = 0; k < NUM_OPCODES && *order[k] > 0; k++) {
+    int op = (int)(order[k] - os->ops);
+    fprintf(f, "%14llu %6.2f%%  %s\n", os->ops[op], pct(os->ops[op], total), opnames[op]);
+  }
+
+  unsigned long long arith = op_range(os, OP_ADDI, OP_SHR);
+  unsigned long long reads = op_range(os, OP_GETTABUP, OP_GETFIELD) + os->ops[OP_SELF];
+  unsigned long long writes = op_range(os, OP_SETTABUP, OP_SETFIELD);
+  fprintf(f, "\n# slow paths\n");
+  fprintf(f, "%-10s %14llu %6.2f%% of %llu arithmetic/bitwise ops\n", "mmbin",
+          slow_count(os, SPT_OPSLOW_MMBIN), pct(slow_count(os, SPT_OPSLOW_MMBIN), arith), arith);
+  fprintf(f, "%-10s %14llu %6.2f%% of %llu table reads\n", "finishget",
+          os->slow[SPT_OPSLOW_FINISHGET], pct(os->slow[SPT_OPSLOW_FINISHGET], reads), reads);
+  fprintf(f, "%-10s %14llu %6.2f%% of %llu table writes\n", "finishset",
+          os->slow[SPT_OPSLOW_FINISHSET], pct(os->slow[SPT_OPSLOW_FINISHSET], writes), writes);
+
+  int nrows;
+  hot_sites(os, rows, topn, &nrows);
+  fprintf(f, "\n# hot instructions (top %d)\n", topn);
+  fprintf(f, "%14s %7s %10s  %s\n", "count", "%", "slow", "site");
+  for (int k = 0; k < nrows; k++) {
+    const Proto *p = rows[k].p;
+    char src[LUA_IDSIZE];
+    if (p->source)
+      luaO_chunkid(src, getstr(p->source), tsslen(p->source));
+    else
+      memcpy(src, "?", 2);
+    fprintf(f, "%14llu %6.2f%% %10llu  %s:%d pc %d %s", rows[k].count, pct(rows[k].count, total),
+            rows[k].slow, src, luaG_getfuncline(p, rows[k].pc), rows[k].pc,
+            opnames[GET_OPCODE(p->code[rows[k].pc])]);
+    if (p->linedefined > 0)
+      fprintf(f, "  [function <%s:%d>]\n", src, p->linedefined);
+    else
+      fprintf(f, "  [main chunk]\n");
+  }
+  free(rows);
+  if (!path)
+    return fflush(f) == 0 ? 0 : -1;
+  return fclose(f) == 0 ? 0 : -1;
+}
+
+/* =====================================================================
+** Lifecycle
+** ===================================================================== */
+
+LUA_API int spt_opstats_available(void) {
+#if defined(SPT_OPSTATS)
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+LUA_API int spt_opstats_start(lua_State *L) {
+#if defined(SPT_OPSTATS)
+  global_State *g = G(L);
+  SPTOpStats *os = g->opstats;
+  if (!os) {
+    os = (SPTOpStats *)calloc(1, sizeof(SPTOpStats));
+    if (!os || !protos_grow(os)) {
+      free(os);
+      return 0;
+    }
+    g->opstats = os;
+  }
+  os->active = 1;
+  return 1;
+#else
+  (void)L;
+  return 0;
+#endif
+}
+
+LUA_API void spt_opstats_stop(lua_State *L) {
+  SPTOpStats *os = G(L)->opstats;
+  if (os)
+    os->active = 0;
+}
+
+LUA_API void spt_opstats_reset(lua_State *L) {
+  global_State *g = G(L);
+  SPTOpStats *os = g->opstats;
+  if (!os)
+    return;
+  g->opstats = NULL;
+  for (size_t i = 0; i < os->sizeprotos; i++)
+    if (os->protos[i].p)
+      free(os->protos[i].sites);
+  free(os->protos);
+  free(os);
+}
+
+void spt_opstats_close(lua_State *L) { spt_opstats_reset(L); }
@@ -0,0 +1,88 @@
+/*
+** spt_opstats.h — interpreter dispatch statistics.
+**
+** Counts how often each opcode executes, how often each instruction
+** (Proto, pc) executes, and how often the interpreter leaves its fast paths:
+**
+**   - mmbin:     arithmetic/bitwise ops that fell through to OP_MMBIN*
+**                (operand was not a number; metamethod dispatch);
+**   - finishget: table reads that missed the fast path (luaV_finishget:
+**                absent key, __index, or non-table receiver);
+**   - finishset: table writes that missed the fast path (luaV_finishset).
+**
+** The counting code lives in the interpreter's fetch step (vmfetch) and is
+** compiled only when the core is built with -DSPT_OPSTATS=ON (CMake option;
+** it defines the SPT_OPSTATS macro). Without it the functions below still
+** exist, spt_opstats_available() returns 0 and spt_opstats_start fails, so
+** embedders need no #ifdefs. Instructions executed inside JIT traces are not
+** counted; run with the JIT off to see the whole interpreter profile.
+**
+** Usage:
+**
+**   spt_opstats_start(L);
+**   lua_pcall(L, 0, 0, 0);
+**   spt_opstats_stop(L);
+**   spt_opstats_dump(L, NULL, 20);   // report to stderr, top 20 sites
+**
+** or from the command line: `sptscript --opstats[=FILE] script.spt`.
+*/
+#ifndef spt_opstats_h
+#define spt_opstats_h
+
+#include "lua.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Slow-path kinds for spt_opstats_slow. */
+#define SPT_OPSLOW_MMBIN 0
+#define SPT_OPSLOW_FINISHGET 1
+#define SPT_OPSLOW_FINISHSET 2
+
+/* 1 if the core was built with SPT_OPSTATS, 0 otherwise. */
+LUA_API int spt_opstats_available(void);
+
+/*
+** Start (or resume) counting in `L`'s state. Returns 1 on success, 0 if the
+** core was built without SPT_OPSTATS or on out of memory.
+*/
+LUA_API int spt_opstats_start(lua_State *L);
+
+/* Stop counting. Collected counts stay available until spt_opstats_reset. */
+LUA_API void spt_opstats_stop(lua_State *L);
+
+/* Stop counting and drop every counter. */
+LUA_API void spt_opstats_reset(lua_State *L);
+
+/* Executions of the opcode named `opname` (e.g. "GETFIELD"); 0 if unknown. */
+LUA_API unsigned long long spt_opstats_opcount(lua_State *L, const char *opname);
+
+/* Total instructions counted. */
+LUA_API unsigned long long spt_opstats_total(lua_State *L);
+
+/* Times the slow path `kind` (SPT_OPSLOW_*) was taken. */
+LUA_API unsigned long long spt_opstats_slow(lua_State *L, int kind);
+
+/*
+** Write the report (opcodes by count, slow-path rates, the `topn` hottest
+** instructions; topn <= 0: 20) to `path` (NULL = stderr). Returns 0 on
+** success, -1 if nothing was counted or the file could not be written.
+*/
+LUA_API int spt_opstats_dump(lua_State *L, const char *path, int topn);
+
+struct SPTOpStats;
+struct Proto;
+
+/* Internal: interpreter/VM hooks (only called while g->opstats is set). */
+void spt_opstats_inst(struct SPTOpStats *os, const struct Proto *p, int pc, int op);
+void spt_opstats_slowpath(struct SPTOpStats *os, int kind);
+void spt_opstats_freeproto(struct SPTOpStats *os, const struct Proto *p);
+/* Internal: free the counters (called by lua_close). */
+void spt_opstats_close(lua_State *L);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* spt_opstats_h */
@@ -27,13 +27,16 @@ typedef struct {
   SptArena *arena;
   SptDiag *diag;
   int scope_depth;
-  int panic; /* 处于错误恢复模式 */
+  int panic;    /* 处于错误恢复模式 */
+  int eof_seen; /* 检视过末尾 EOF token（片段解析据此判断语句是否越过片段边界） */
 } Parser;
 
 /* ---- token 游标 ---- */
 static const SptToken *tok_at(Parser *P, int i) {
-  if (i >= P->count)
+  if (i >= P->count - 1) {
     i = P->count - 1; /* 末尾 EOF */
+    P->eof_seen = 1;
+  }
   if (i < 0)
     i = 0;
   return &P->toks[i];
@@ -1126,6 +1129,7 @@ static AstNode *parse_class_decl(Parser *P) {
   while (!at(P, TOK_RBRACE) && !at_end(P)) {
     if (accept(P, TOK_SEMICOLON))
       continue; /* 空成员 */
+    int before = P->pos;
     SourceLocation mloc = cur_loc(P);
     int is_static = accept(P, TOK_STATIC) ? 1 : 0;
     int is_const = accept(P, TOK_CONST) ? 1 : 0;
@@ -1236,6 +1240,8 @@ static AstNode *parse_class_decl(Parser *P) {
     nv_push(&members, cm);
     if (P->panic)
       synchronize(P);
+    if (P->pos == before)
+      advance(P); /* 防止无进展死循环（如 `class A) {`：恢复停在 '{' 上） */
   }
   expect2(P, TOK_RBRACE);
   AstNode *n = spt_ast_new(P->arena, NODE_CLASS_DECL, loc);
@@ -1870,6 +1876,7 @@ static AstNode *parse_decl_class(Parser *P, SourceLocation loc, const char *doc)
   while (!at(P, TOK_RBRACE) && !at_end(P)) {
     if (accept(P, TOK_SEMICOLON))
       continue; /* 空成员 */
+    int before = P->pos;
     SourceLocation mloc = cur_loc(P);
     const char *mdoc = cur(P)->doc;
     int is_static = accept(P, TOK_STATIC) ? 1 : 0;
@@ -1968,6 +1975,8 @@ static AstNode *parse_decl_class(Parser *P, SourceLocation loc, const char *doc)
     nv_push(&members, cm);
     if (P->panic)
       synchronize(P);
+    if (P->pos == before)
+      advance(P); /* 防止无进展死循环（如 `class A) {`：恢复停在 '{' 上） */
   }
   expect2(P, TOK_RBRACE);
   AstNode *n = spt_ast_new(P->arena, NODE_CLASS_DECL, loc);
@@ -2205,7 +2214,8 @@ static AstNode *parse_statement(Parser *P) {
  * ========================================================================= */
 /* 解析核心：始终构建并返回尽力而为的根节点（带 panic-mode 恢复）。
 ** 错误写入 diag；是否因错误而对外返回 NULL 由各入口决定。 */
-static AstNode *run_parser(const SptTokenArray *toks, SptArena *arena, SptDiag *diag) {
+static AstNode *run_parser(const SptTokenArray *toks, SptArena *arena, SptDiag *diag,
+                           int *crossed) {
   Parser P;
   P.toks = toks->tokens;
   P.count = toks->count;
@@ -2214,17 +2224,21 @@ static AstNode *run_parser(const SptTokenArray *toks, SptArena *arena, SptDiag *
   P.diag = diag;
   P.scope_depth = 0;
   P.panic = 0;
+  P.eof_seen = 0;
 
   SourceLocation loc = cur_loc(&P);
   NodeVec stmts;
   nv_init(&stmts);
   while (!at_end(&P)) {
     int before = P.pos;
+    P.eof_seen = 0;
     AstNode *s = parse_statement(&P);
     if (s)
       nv_push(&stmts, s);
     if (P.panic)
       synchronize(&P);
+    if (crossed && P.eof_seen)
+      *crossed = 1; /* 语句（或其错误恢复）读到了 EOF：后面若还有 token 结果可能不同 */
     if (P.pos == before)
       advance(&P);
   }
@@ -2238,7 +2252,7 @@ static AstNode *run_parser(const SptTokenArray *toks, SptArena *arena, SptDiag *
 }
 
 AstNode *spt_parse(const SptTokenArray *toks, SptArena *arena, SptDiag *diag) {
-  AstNode *root = run_parser(toks, arena, diag);
+  AstNode *root = run_parser(toks, arena, diag, NULL);
   if (spt_diag_has_error(diag))
     return NULL; /* 编译路径语义：有错即失败 */
   return root;
@@ -2247,5 +2261,11 @@ AstNode *spt_parse(const SptTokenArray *toks, SptArena *arena, SptDiag *diag) {
 /* 容错解析（供 LSP 使用）：无论有无错误，都返回尽力而为的根节点。
 ** 诊断仍写入 diag，调用方据此报告问题。 */
 AstNode *spt_parse_tolerant(const SptTokenArray *toks, SptArena *arena, SptDiag *diag) {
-  return run_parser(toks, arena, diag);
+  return run_parser(toks, arena, diag, NULL);
+}
+
+AstNode *spt_parse_fragment(const SptTokenArray *toks, SptArena *arena, SptDiag *diag,
+                            int *crossed) {
+  *crossed = 0;
+  return run_parser(toks, arena, diag, crossed);
 }
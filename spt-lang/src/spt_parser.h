@@ -27,4 +27,9 @@ AstNode *spt_parse(const SptTokenArray *toks, SptArena *arena, SptDiag *diag);
 ** 诊断写入 diag。供语言服务器在用户编辑中途的不完整代码上工作。 */
 AstNode *spt_parse_tolerant(const SptTokenArray *toks, SptArena *arena, SptDiag *diag);
 
+/* 片段容错解析（LSP 增量重解析用）：同 spt_parse_tolerant，另经 *crossed 报告是否有
+** 顶层语句在结束前检视过末尾 EOF——此时把片段接回全文后语句边界可能不同。 */
+AstNode *spt_parse_fragment(const SptTokenArray *toks, SptArena *arena, SptDiag *diag,
+                            int *crossed);
+
 #endif /* SPT_PARSER_H */
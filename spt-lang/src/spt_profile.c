@@ -0,0 +1,444 @@
+/*
+** spt_profile.c — SPT sampling profiler (see spt_profile.h).
+**
+** Two halves:
+**   - prof_signal: the SIGPROF handler. Touches nothing but a few volatile
+**     fields of the profiler plus lua_sethook (which, like lua.c's SIGINT
+**     handler relies on, is safe to call asynchronously).
+**   - prof_hook: the one-shot count hook armed by the handler. Runs at a
+**     bytecode boundary, so the CallInfo chain and savedpc are consistent and
+**     the stack can be walked with the regular debug API.
+*/
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* REG_RIP in <ucontext.h> */
+#endif
+
+#define spt_profile_c
+#define LUA_CORE
+
+#include "lprefix.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lua.h"
+
+#include "ldebug.h"
+#include "lobject.h"
+#include "lstate.h"
+
+#include "spt_jit.h"
+#include "spt_profile.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SPT_PROF_SIGPROF 1
+#include <signal.h>
+#include <sys/time.h>
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#include <ucontext.h>
+#endif
+#else
+#define SPT_PROF_SIGPROF 0
+/* Count-hook fallback: instructions per sampling microsecond (rough). */
+#define SPT_PROF_INSNS_PER_US 100
+#endif
+
+#define SPT_PROF_MAXDEPTH 64   /* frames kept per sample (leaf side wins) */
+#define SPT_PROF_STACKBUF 4096 /* bytes of one folded stack */
+#define SPT_PROF_FRAMEBUF 256  /* bytes of one frame */
+
+typedef struct ProfEntry {
+  char *stack; /* folded stack (malloc'd), NULL = empty slot */
+  unsigned int hash;
+  unsigned long long count;
+} ProfEntry;
+
+struct SPTProfiler {
+  lua_State *L; /* main thread of the profiled state */
+  int interval_us;
+  int running; /* timer installed */
+
+  /* Written by the signal handler. */
+  volatile sig_atomic_t pending; /* ticks not yet attributed */
+  volatile sig_atomic_t in_hook; /* prof_hook is walking the stack */
+  SPTTrace *volatile trace;      /* trace executing at the last tick */
+  const void *volatile mcode;    /* native PC at the last tick */
+  lua_State *volatile armed;     /* thread carrying the one-shot hook */
+  lua_Hook saved_hook;           /* ...and its previous hook settings */
+  int saved_mask;
+  int saved_count;
+
+  /* Aggregated samples: open-addressing table keyed by folded stack. */
+  ProfEntry *tab;
+  size_t tabsize; /* power of 2 */
+  size_t ntab;
+  SPTProfileStats stats;
+};
+
+/* The profiler the process timer feeds (SIGPROF is process-wide). */
+static SPTProfiler *volatile prof_active = NULL;
+
+/* =====================================================================
+** Sample aggregation
+** ===================================================================== */
+
+static unsigned int prof_hash(const char *s) {
+  unsigned int h = 2166136261u; /* FNV-1a */
+  for (; *s; s++)
+    h = (h ^ (unsigned char)*s) * 16777619u;
+  return h;
+}
+
+static int prof_grow(SPTProfiler *P) {
+  size_t nsize = P->tabsize ? P->tabsize * 2 : 256;
+  ProfEntry *nt = (ProfEntry *)calloc(nsize, sizeof(ProfEntry));
+  if (!nt)
+    return 0;
+  for (size_t i = 0; i < P->tabsize; i++) {
+    ProfEntry *e = &P->tab[i];
+    if (!e->stack)
+      continue;
+    size_t j = e->hash & (nsize - 1);
+    while (nt[j].stack)
+      j = (j + 1) & (nsize - 1);
+    nt[j] = *e;
+  }
+  free(P->tab);
+  P->tab = nt;
+  P->tabsize = nsize;
+  return 1;
+}
+
+static void prof_add(SPTProfiler *P, const char *stack, unsigned long long n) {
+  if ((P->ntab + 1) * 4 > P->tabsize * 3 && !prof_grow(P))
+    return;
+  unsigned int h = prof_hash(stack);
+  size_t j = h & (P->tabsize - 1);
+  while (P->tab[j].stack) {
+    if (P->tab[j].hash == h && strcmp(P->tab[j].stack, stack) == 0) {
+      P->tab[j].count += n;
+      return;
+    }
+    j = (j + 1) & (P->tabsize - 1);
+  }
+  size_t len = strlen(stack);
+  char *copy = (char *)malloc(len + 1);
+  if (!copy)
+    return;
+  memcpy(copy, stack, len + 1);
+  P->tab[j].stack = copy;
+  P->tab[j].hash = h;
+  P->tab[j].count = n;
+  P->ntab++;
+  P->stats.stacks = P->ntab;
+}
+
+/* =====================================================================
+** Stack walking (runs inside prof_hook, at a bytecode boundary)
+** ===================================================================== */
+
+/* Frames may not contain ';' (frame separator) or newlines. */
+static void prof_sanitize(char *s) {
+  for (; *s; s++)
+    if (*s == ';' || *s == '\n' || *s == '\r')
+      *s = ':';
+}
+
+static void proto_src(const Proto *p, char *out) {
+  if (p->source)
+    luaO_chunkid(out, getstr(p->source), tsslen(p->source));
+  else
+    memcpy(out, "?", 2);
+}
+
+static int proto_line(const Proto *p, int pc) {
+  return (pc >= 0 && pc < p->sizecode) ? luaG_getfuncline(p, pc) : p->linedefined;
+}
+
+/* Append one frame to the folded stack being built in `buf`. */
+static void push_frame(char *buf, size_t *len, const char *frame) {
+  size_t fl = strlen(frame);
+  if (*len + fl + 2 >= SPT_PROF_STACKBUF)
+    return;
+  if (*len > 0)
+    buf[(*len)++] = ';';
+  memcpy(buf + *len, frame, fl);
+  *len += fl;
+  buf[*len] = '\0';
+}
+
+static void prof_record(SPTProfiler *P, lua_State *T, SPTTrace *trace, const void *mcode,
+                        unsigned long long n) {
+  char frames[SPT_PROF_MAXDEPTH][SPT_PROF_FRAMEBUF];
+  char src[LUA_IDSIZE];
+  char buf[SPT_PROF_STACKBUF];
+  size_t len = 0;
+  int nf = 0;
+  lua_Debug ar;
+  SPTTraceLoc loc;
+  int in_jit = trace && sptjit_trace_locate(G(T)->jit_state, trace, mcode, &loc);
+
+  /* Collect frames leaf-first, then emit them root-first. */
+  for (int level = 0; nf < SPT_PROF_MAXDEPTH && lua_getstack(T, level, &ar); level++) {
+    if (!lua_getinfo(T, "Sln", &ar))
+      break;
+    const Proto *p = (*ar.what != 'C') ? ci_func(ar.i_ci)->p : NULL;
+    /* An in-callee trace exit leaves the callee frame on top; the snapshot
+       below re-creates it, so skip it here. */
+    if (level == 0 && in_jit && p != loc.proto)
+      continue;
+    if (!p)
+      snprintf(frames[nf], SPT_PROF_FRAMEBUF, "[C] %s", ar.name ? ar.name : "?");
+    else if (*ar.what == 'm')
+      snprintf(frames[nf], SPT_PROF_FRAMEBUF, "main chunk (%s:%d)", ar.short_src,
+               ar.linedefined);
+    else
+      snprintf(frames[nf], SPT_PROF_FRAMEBUF, "%s (%s:%d)", ar.name ? ar.name : "?",
+               ar.short_src, ar.linedefined);
+    prof_sanitize(frames[nf]);
+    nf++;
+  }
+  for (int k = nf - 1; k >= 0; k--)
+    push_frame(buf, &len, frames[k]);
+
+  /* Leaf: the line being executed, under the trace marker for JIT samples. */
+  char frame[SPT_PROF_FRAMEBUF];
+  if (in_jit) {
+    proto_src(loc.proto, src);
+    snprintf(frame, sizeof(frame), "[trace %s:%d]", src, proto_line(loc.proto, loc.pc));
+    prof_sanitize(frame);
+    push_frame(buf, &len, frame);
+    if (loc.snap_proto) {
+      proto_src(loc.snap_proto, src);
+      if (loc.snap_proto != loc.proto) { /* guard inside an inlined callee */
+        snprintf(frame, sizeof(frame), "function <%s:%d>", src, loc.snap_proto->linedefined);
+        prof_sanitize(frame);
+        push_frame(buf, &len, frame);
+      }
+      snprintf(frame, sizeof(frame), "%s:%d", src, proto_line(loc.snap_proto, loc.snap_pc));
+      prof_sanitize(frame);
+      push_frame(buf, &len, frame);
+    }
+    P->stats.jit_samples += n;
+  } else if (lua_getstack(T, 0, &ar) && lua_getinfo(T, "Sl", &ar) && ar.currentline >= 0) {
+    snprintf(frame, sizeof(frame), "%s:%d", ar.short_src, ar.currentline);
+    prof_sanitize(frame);
+    push_frame(buf, &len, frame);
+  }
+  if (len == 0)
+    return;
+  prof_add(P, buf, n);
+  P->stats.samples += n;
+}
+
+/* =====================================================================
+** Timer + hook
+** ===================================================================== */
+
+static void prof_hook(lua_State *T, lua_Debug *ar);
+
+#if SPT_PROF_SIGPROF
+
+static const void *ucontext_pc(void *uctx) {
+#if defined(__x86_64__) && defined(__linux__)
+  return (const void *)((ucontext_t *)uctx)->uc_mcontext.gregs[REG_RIP];
+#elif defined(__x86_64__) && defined(__APPLE__)
+  return (const void *)((ucontext_t *)uctx)->uc_mcontext->__ss.__rip;
+#else
+  (void)uctx;
+  return NULL; /* no JIT on this target: the trace pointer alone suffices */
+#endif
+}
+
+static struct sigaction prof_oldact;
+
+static void prof_signal(int sig, siginfo_t *si, void *uctx) {
+  SPTProfiler *P = prof_active;
+  (void)sig;
+  (void)si;
+  if (!P)
+    return;
+  P->pending++;
+  if (P->in_hook)
+    return; /* the hook running now (or the next one) picks this tick up */
+  global_State *g = G(P->L);
+  P->trace = sptjit_executing(g->jit_state);
+  P->mcode = ucontext_pc(uctx);
+  lua_State *run = g->running;
+  if (P->armed == run)
+    return;
+  if (P->armed) /* a coroutine switched away before its sample was taken */
+    lua_sethook(P->armed, P->saved_hook, P->saved_mask, P->saved_count);
+  P->saved_hook = run->hook;
+  P->saved_mask = run->hookmask;
+  P->saved_count = run->basehookcount;
+  P->armed = run;
+  lua_sethook(run, prof_hook, LUA_MASKCOUNT, 1);
+}
+
+static int prof_timer_start(SPTProfiler *P) {
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_sigaction = prof_signal;
+  sa.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  if (sigaction(SIGPROF, &sa, &prof_oldact) != 0)
+    return 0;
+  struct itimerval tv;
+  tv.it_interval.tv_sec = P->interval_us / 1000000;
+  tv.it_interval.tv_usec = P->interval_us % 1000000;
+  tv.it_value = tv.it_interval;
+  if (setitimer(ITIMER_PROF, &tv, NULL) != 0) {
+    sigaction(SIGPROF, &prof_oldact, NULL);
+    return 0;
+  }
+  return 1;
+}
+
+static void prof_timer_stop(SPTProfiler *P) {
+  struct itimerval tv;
+  memset(&tv, 0, sizeof(tv));
+  setitimer(ITIMER_PROF, &tv, NULL);
+  sigaction(SIGPROF, &prof_oldact, NULL);
+  /* Undo a hook armed by a tick that never reached a bytecode boundary. */
+  if (P->armed) {
+    lua_sethook(P->armed, P->saved_hook, P->saved_mask, P->saved_count);
+    P->armed = NULL;
+  }
+}
+
+static void prof_hook(lua_State *T, lua_Debug *ar) {
+  SPTProfiler *P = G(T)->profiler;
+  (void)ar;
+  if (!P || !P->armed) { /* stale copy (e.g. inherited by a new coroutine) */
+    if (T->hook == prof_hook)
+      lua_sethook(T, P ? P->saved_hook : NULL, P ? P->saved_mask : 0, P ? P->saved_count : 0);
+    return;
+  }
+  P->in_hook = 1;
+  lua_State *armed = P->armed;
+  lua_sethook(armed, P->saved_hook, P->saved_mask, P->saved_count);
+  if (T != armed) /* inherited by a coroutine created while armed */
+    lua_sethook(T, P->saved_hook, P->saved_mask, P->saved_count);
+  P->armed = NULL;
+  unsigned long long n = (unsigned long long)P->pending;
+  P->pending = 0;
+  SPTTrace *trace = P->trace;
+  const void *mcode = P->mcode;
+  P->trace = NULL;
+  P->mcode = NULL;
+  if (n > 0)
+    prof_record(P, T, trace, mcode, n);
+  P->in_hook = 0;
+}
+
+#else /* !SPT_PROF_SIGPROF */
+
+static int prof_timer_start(SPTProfiler *P) {
+  lua_sethook(P->L, prof_hook, LUA_MASKCOUNT, P->interval_us * SPT_PROF_INSNS_PER_US);
+  return 1;
+}
+
+static void prof_timer_stop(SPTProfiler *P) { lua_sethook(P->L, NULL, 0, 0); }
+
+static void prof_hook(lua_State *T, lua_Debug *ar) {
+  SPTProfiler *P = G(T)->profiler;
+  (void)ar;
+  if (P && P->running)
+    prof_record(P, T, NULL, NULL, 1);
+}
+
+#endif /* SPT_PROF_SIGPROF */
+
+/* =====================================================================
+** Public API
+** ===================================================================== */
+
+LUA_API int spt_profile_start(lua_State *L, int interval_us) {
+  global_State *g = G(L);
+  if (prof_active)
+    return 0;
+  SPTProfiler *P = g->profiler;
+  if (!P) {
+    P = (SPTProfiler *)calloc(1, sizeof(SPTProfiler));
+    if (!P)
+      return 0;
+    P->L = mainthread(g);
+    g->profiler = P;
+  }
+  P->interval_us = interval_us > 0 ? interval_us : SPT_PROFILE_DEFAULT_INTERVAL;
+  P->pending = 0;
+  P->in_hook = 0;
+  P->trace = NULL;
+  P->armed = NULL;
+  prof_active = P;
+  if (!prof_timer_start(P)) {
+    prof_active = NULL;
+    return 0;
+  }
+  P->running = 1;
+  return 1;
+}
+
+LUA_API void spt_profile_stop(lua_State *L) {
+  SPTProfiler *P = G(L)->profiler;
+  if (!P || !P->running)
+    return;
+  prof_timer_stop(P);
+  P->running = 0;
+  prof_active = NULL;
+}
+
+static int entry_cmp(const void *a, const void *b) {
+  const ProfEntry *x = (const ProfEntry *)a, *y = (const ProfEntry *)b;
+  if (x->count != y->count)
+    return x->count < y->count ? 1 : -1;
+  return strcmp(x->stack, y->stack);
+}
+
+LUA_API int spt_profile_dump(lua_State *L, const char *path) {
+  SPTProfiler *P = G(L)->profiler;
+  if (!P || !path)
+    return -1;
+  ProfEntry *sorted = (ProfEntry *)malloc((P->ntab ? P->ntab : 1) * sizeof(ProfEntry));
+  if (!sorted)
+    return -1;
+  size_t n = 0;
+  for (size_t i = 0; i < P->tabsize; i++)
+    if (P->tab[i].stack)
+      sorted[n++] = P->tab[i];
+  qsort(sorted, n, sizeof(ProfEntry), entry_cmp);
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    free(sorted);
+    return -1;
+  }
+  for (size_t i = 0; i < n; i++)
+    fprintf(f, "%s %llu\n", sorted[i].stack, sorted[i].count);
+  free(sorted);
+  return fclose(f) == 0 ? 0 : -1;
+}
+
+LUA_API void spt_profile_getstats(lua_State *L, SPTProfileStats *st) {
+  SPTProfiler *P = G(L)->profiler;
+  if (!st)
+    return;
+  if (P)
+    *st = P->stats;
+  else
+    memset(st, 0, sizeof(*st));
+}
+
+void spt_profile_close(lua_State *L) {
+  global_State *g = G(L);
+  SPTProfiler *P = g->profiler;
+  if (!P)
+    return;
+  spt_profile_stop(L);
+  for (size_t i = 0; i < P->tabsize; i++)
+    free(P->tab[i].stack);
+  free(P->tab);
+  free(P);
+  g->profiler = NULL;
+}
@@ -0,0 +1,82 @@
+/*
+** spt_profile.h — SPT sampling profiler.
+**
+** A low-overhead statistical profiler for running scripts. A process timer
+** (SIGPROF / ITIMER_PROF on POSIX) fires every `interval_us` of CPU time; the
+** signal handler only takes an async-signal-safe snapshot (pending tick count,
+** the JIT trace whose native code is running, the interrupted native PC) and
+** arms a one-shot count hook on the running thread. At the next bytecode the
+** hook walks the CallInfo chain in a consistent state and attributes the
+** ticks to the stack (Proto + current line).
+**
+** Samples taken while a compiled trace runs are attributed to that trace:
+** the leaf frames become `[trace <src>:<line>]` followed by the bytecode line
+** of the nearest snapshot (resolved through sptjit_trace_locate), so JIT and
+** interpreted time are distinguishable in the same flame graph.
+**
+** Output is the "folded stacks" format consumed by flamegraph.pl/speedscope:
+**
+**   main chunk (bench.spt:0);fib (bench.spt:3);bench.spt:5 118
+**
+** Usage:
+**
+**   spt_profile_start(L, 0);          // 0 = SPT_PROFILE_DEFAULT_INTERVAL
+**   lua_pcall(L, 0, 0, 0);
+**   spt_profile_stop(L);
+**   spt_profile_dump(L, "out.folded");
+**
+** or from the command line: `sptscript --profile=out.folded script.spt`.
+**
+** Limitations: one profiled state per process (the timer is process-wide);
+** the state must run on the thread that receives SIGPROF; a debug hook
+** installed by the script is suspended for the one instruction a sample
+** takes. Platforms without SIGPROF (Windows) fall back to an instruction
+** count hook, which cannot see time spent inside JIT traces.
+*/
+#ifndef spt_profile_h
+#define spt_profile_h
+
+#include "lua.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Default sampling interval (microseconds of CPU time): 1 kHz. */
+#define SPT_PROFILE_DEFAULT_INTERVAL 1000
+
+typedef struct SPTProfileStats {
+  unsigned long long samples;     /* timer ticks attributed to a stack */
+  unsigned long long jit_samples; /* ... of which landed in a JIT trace */
+  unsigned long long stacks;      /* distinct folded stacks */
+} SPTProfileStats;
+
+/*
+** Start sampling `L` (any thread of the state; samples cover every
+** coroutine). Returns 1 on success, 0 if a profiler is already active in this
+** process or the timer could not be installed. Samples from a previous run of
+** the same state are kept and accumulate.
+*/
+LUA_API int spt_profile_start(lua_State *L, int interval_us);
+
+/* Stop sampling. Collected stacks remain available to spt_profile_dump. */
+LUA_API void spt_profile_stop(lua_State *L);
+
+/*
+** Write the collected stacks in folded format (most frequent first) to
+** `path`. Returns 0 on success, -1 if nothing was profiled or the file could
+** not be written.
+*/
+LUA_API int spt_profile_dump(lua_State *L, const char *path);
+
+/* Fill `st` with the counters of the current/last profile (zeros if none). */
+LUA_API void spt_profile_getstats(lua_State *L, SPTProfileStats *st);
+
+/* Internal: stop and free the profiler (called by lua_close). */
+void spt_profile_close(lua_State *L);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* spt_profile_h */
@@ -24,6 +24,8 @@
 #include "lua.h"
 #include "lualib.h"
 #include "spt_module.h"
+#include "spt_opstats.h"
+#include "spt_profile.h"
 
 #define SPT_VERSION "0.1.0"
 #define SPT_NAME "SPTScript"
@@ -37,6 +39,9 @@ static void printHelp(const char *progname) {
   printf("Usage: %s [options] [script [args...]]\n\n", progname);
   printf("Options:\n");
   printf("  -e 'code'       Execute code string directly\n");
+  printf("  --profile=FILE  Sample the run and write folded stacks to FILE\n");
+  printf("  --opstats[=FILE] Report opcode counts, slow paths and hot instructions\n");
+  printf("                  (stderr by default; needs a -DSPT_OPSTATS=ON build)\n");
   printf("  -v, --version   Show version information\n");
   printf("  -h, --help      Show this help message\n");
   printf("  -               Read script from stdin\n");
@@ -124,6 +129,33 @@ static const char *path_basename(const char *path) {
   return slash ? slash + 1 : path;
 }
 
+/* --profile=FILE：非 NULL 时对脚本执行阶段采样，结束后写 folded 栈。 */
+static const char *profileOut = NULL;
+
+/* --opstats[=FILE]：统计脚本执行阶段的指令分发，结束后输出报告（默认 stderr）。 */
+static int opstatsOn = 0;
+static const char *opstatsOut = NULL;
+
+static void profile_begin(lua_State *L) {
+  if (profileOut && !spt_profile_start(L, 0))
+    fprintf(stderr, "Warning: could not start profiler\n");
+  if (opstatsOn && !spt_opstats_start(L))
+    fprintf(stderr, "Warning: opstats unavailable (rebuild with -DSPT_OPSTATS=ON)\n");
+}
+
+static void profile_end(lua_State *L) {
+  if (opstatsOn && spt_opstats_available()) {
+    spt_opstats_stop(L);
+    if (spt_opstats_dump(L, opstatsOut, 0) != 0)
+      fprintf(stderr, "Warning: could not write opstats report\n");
+  }
+  if (!profileOut)
+    return;
+  spt_profile_stop(L);
+  if (spt_profile_dump(L, profileOut) != 0)
+    fprintf(stderr, "Warning: could not write profile to %s\n", profileOut);
+}
+
 static int runSource(const char *source, const char *chunkname, lua_State *L) {
   AstNode *ast = spt_frontend_parse(source, chunkname);
   if (!ast) {
@@ -142,7 +174,9 @@ static int runSource(const char *source, const char *chunkname, lua_State *L) {
     return -1;
   }
 
+  profile_begin(L);
   int status = lua_pcall(L, 0, 0, 0);
+  profile_end(L);
   if (status != LUA_OK) {
     const char *err = lua_tostring(L, -1);
     fprintf(stderr, "Runtime error: %s\n", err ? err : "unknown error");
@@ -275,6 +309,23 @@ int main(int argc, char *argv[]) {
         return -1;
       }
       executeCode = argv[i];
+    } else if (strncmp(arg, "--profile=", 10) == 0) {
+      profileOut = arg + 10;
+      if (!*profileOut) {
+        fprintf(stderr, "Error: --profile requires a file name\n");
+        free(scriptArgs);
+        return -1;
+      }
+    } else if (strcmp(arg, "--opstats") == 0) {
+      opstatsOn = 1;
+    } else if (strncmp(arg, "--opstats=", 10) == 0) {
+      opstatsOn = 1;
+      opstatsOut = arg + 10;
+      if (!*opstatsOut) {
+        fprintf(stderr, "Error: --opstats= requires a file name\n");
+        free(scriptArgs);
+        return -1;
+      }
     } else if (strcmp(arg, "-") == 0) {
       readStdin = 1;
     } else if (strcmp(arg, "--") == 0) {
@@ -386,6 +386,115 @@ int main() {
   }
   lua_pop(L, 4);
 
+  // =======================================================
+  // Test lua_arraywrite / lua_arrayread (bulk typed transfer)
+  // =======================================================
+  TEST("lua_arraywrite/lua_arrayread integers");
+  {
+    int src[300], dst[300];
+    for (int i = 0; i < 300; i++)
+      src[i] = i * 3 - 100;
+    lua_createarray(L, 0);
+    lua_arraywrite(L, -1, 0, LUA_BULK_INT, src, 300);
+    lua_geti(L, -1, 299);
+    lua_Integer last = lua_tointeger(L, -1);
+    int isint = lua_isinteger(L, -1);
+    lua_pop(L, 1);
+    memset(dst, 0, sizeof dst);
+    int ok = lua_arrayread(L, -1, 0, LUA_BULK_INT, dst, 300);
+    if (lua_arraylen(L, -1) != 300 || last != 797 || !isint) {
+      FAIL("write should set length and integer elements");
+    } else if (!ok || memcmp(src, dst, sizeof src) != 0) {
+      FAIL("read should return the written integers");
+    } else {
+      PASS();
+    }
+    lua_pop(L, 1);
+  }
+
+  TEST("lua_arraywrite append + lua_arrayread number/boolean kinds");
+  {
+    lua_Number nums[3] = {0.5, -2.25, 1e10};
+    unsigned char flags[4] = {1, 0, 0, 1};
+    lua_Integer ints[2] = {7, 8};
+    lua_Number back[5];
+    lua_Integer iback[5];
+    float fback[5];
+    unsigned char bback[4];
+    lua_createarray(L, 0);
+    lua_arraywrite(L, -1, 0, LUA_BULK_INTEGER, ints, 2);
+    lua_arraywrite(L, -1, 2, LUA_BULK_NUMBER, nums, 3); /* append at loglen */
+    int okn = lua_arrayread(L, -1, 0, LUA_BULK_NUMBER, back, 5); /* ints widen to float */
+    int okf = lua_arrayread(L, -1, 0, LUA_BULK_FLOAT, fback, 5);
+    int oki = lua_arrayread(L, -1, 0, LUA_BULK_INTEGER, iback, 5); /* floats present */
+    lua_Integer len = lua_arraylen(L, -1);
+    lua_pop(L, 1);
+    lua_createarray(L, 0);
+    lua_arraywrite(L, -1, 0, LUA_BULK_BOOLEAN, flags, 4);
+    int okb = lua_arrayread(L, -1, 0, LUA_BULK_BOOLEAN, bback, 4);
+    lua_geti(L, -1, 1);
+    int t1 = lua_type(L, -1);
+    lua_pop(L, 2);
+    if (len != 5 || !okn || back[0] != 7.0 || back[3] != -2.25 || back[4] != 1e10) {
+      FAIL("number read should widen integers and keep floats");
+    } else if (!okf || fback[2] != 0.5f || oki) {
+      FAIL("float read should succeed, integer read should reject floats");
+    } else if (!okb || memcmp(flags, bback, 4) != 0 || t1 != LUA_TBOOLEAN) {
+      FAIL("boolean round trip");
+    } else {
+      PASS();
+    }
+  }
+
+  TEST("lua_arrayread rejects mixed element types");
+  {
+    lua_Integer buf[3] = {-1, -1, -1};
+    lua_createarray(L, 3);
+    lua_pushinteger(L, 1);
+    lua_seti(L, -2, 0);
+    lua_pushstring(L, "two");
+    lua_seti(L, -2, 1);
+    lua_pushinteger(L, 3);
+    lua_seti(L, -2, 2);
+    int ok = lua_arrayread(L, -1, 0, LUA_BULK_INTEGER, buf, 3);
+    lua_Integer untouched = buf[0];
+    int ok_tail = lua_arrayread(L, -1, 2, LUA_BULK_INTEGER, buf, 1);
+    if (ok || untouched != -1) {
+      FAIL("mismatch should return 0 without writing");
+    } else if (!ok_tail || buf[0] != 3) {
+      FAIL("sub-range read should succeed");
+    } else {
+      PASS();
+    }
+    lua_pop(L, 1);
+  }
+
+  // =======================================================
+  // Test lua_arrayview (zero-copy)
+  // =======================================================
+  TEST("lua_arrayview");
+  {
+    lua_Number nums[4] = {1.5, 2.5, 3.5, 4.5};
+    const void *data = NULL;
+    ptrdiff_t stride = 0;
+    lua_Integer len = 0;
+    lua_createarray(L, 0);
+    lua_arraywrite(L, -1, 0, LUA_BULK_NUMBER, nums, 4);
+    int ok = lua_arrayview(L, -1, LUA_BULK_NUMBER, &data, &stride, &len);
+    double sum = 0;
+    for (lua_Integer i = 0; ok && i < len; i++)
+      sum += *(const lua_Number *)((const char *)data + i * stride);
+    int ok_int = lua_arrayview(L, -1, LUA_BULK_INTEGER, &data, &stride, &len);
+    lua_pop(L, 1);
+    if (!ok || len != 4 || sum != 12.0) {
+      FAIL("float view should expose all elements");
+    } else if (ok_int) {
+      FAIL("integer view over floats should fail");
+    } else {
+      PASS();
+    }
+  }
+
   lua_close(L);
 
   printf("\n=== Test Summary ===\n");
@@ -0,0 +1,363 @@
+/**
+ * TestClone.c — 验证状态克隆 (spt_clone.h)
+ *
+ * 覆盖:
+ *   - 全局变量、list/map、环引用、类、标准库在克隆中可用，且与模板/其他克隆互相隔离
+ *   - 闭包共享的 upvalue 在克隆内仍然共享
+ *   - luaL_ref 槽位随模板复制
+ *   - 原型共享字节码：克隆里 dump 出的函数与模板逐字节相同
+ *   - userdata：无 __gc 按字节复制；有 __gc 无 __clone 时克隆失败；__clone 钩子与终结器
+ *   - 模板持有协程时克隆失败
+ */
+
+#include "lauxlib.h"
+#include "lua.h"
+#include "lualib.h"
+#include "spt_clone.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TEST(name) printf("Testing: %s... ", name)
+#define PASS() printf("PASS\n")
+#define FAIL(msg)                                                                                  \
+  do {                                                                                             \
+    printf("FAIL: %s\n", msg);                                                                     \
+    failed++;                                                                                      \
+  } while (0)
+
+static int failed = 0;
+
+static const char *tpl_code = "global int counter = 0;\n"
+                              "global list<int> nums = [1, 2, 3];\n"
+                              "global map<str, any> cfg = {\"name\": \"tpl\", \"depth\": 2};\n"
+                              "cfg[\"self\"] = cfg;\n"
+                              "global any inc = null;\n"
+                              "global any get = null;\n"
+                              "{\n"
+                              "  int n = 0;\n"
+                              "  inc = fn() -> int { n = n + 1; return n; };\n"
+                              "  get = fn() -> int { return n; };\n"
+                              "}\n"
+                              "class Point {\n"
+                              "  int x;\n"
+                              "  int y;\n"
+                              "  void __init(int x, int y) { this.x = x; this.y = y; }\n"
+                              "  int sum() { return this.x + this.y; }\n"
+                              "}\n"
+                              "global any P = Point;\n"
+                              "global int bump(int k) { counter = counter + k; return counter; }\n";
+
+static int run(lua_State *L, const char *code) {
+  if (luaL_dostring(L, code) != LUA_OK) {
+    printf("(%s) ", lua_tostring(L, -1));
+    lua_pop(L, 1);
+    return 0;
+  }
+  return 1;
+}
+
+static lua_Integer global_int(lua_State *L, const char *name) {
+  lua_Integer v;
+  lua_getglobal(L, name);
+  v = lua_tointeger(L, -1);
+  lua_pop(L, 1);
+  return v;
+}
+
+/* ---- 测试用 userdata ---- */
+
+typedef struct Res {
+  int value;
+  int *live; /* 存活计数，由 __gc 递减 */
+} Res;
+
+static int live_res = 0;
+static int hook_calls = 0;
+
+static int res_gc(lua_State *L) {
+  Res *r = (Res *)lua_touserdata(L, 2);
+  (*r->live)--;
+  return 0;
+}
+
+/* 参数：nil, 克隆出的 userdata, 模板块 */
+static int res_clone(lua_State *L) {
+  Res *r = (Res *)lua_touserdata(L, 2);
+  const Res *src = (const Res *)lua_touserdata(L, 3);
+  hook_calls++;
+  r->value = src->value + 1000;
+  (*r->live)++;
+  return 0;
+}
+
+static void push_res(lua_State *L, int value, int with_hook) {
+  Res *r = (Res *)lua_newuserdatauv(L, sizeof(Res), 0);
+  r->value = value;
+  r->live = &live_res;
+  live_res++;
+  lua_createtable(L, 0, 2);
+  lua_pushcfunction(L, res_gc);
+  lua_setfield(L, -2, "__gc");
+  if (with_hook) {
+    lua_pushcfunction(L, res_clone);
+    lua_setfield(L, -2, "__clone");
+  }
+  lua_setmetatable(L, -2);
+}
+
+typedef struct DumpBuf {
+  char *p;
+  size_t n;
+} DumpBuf;
+
+static int write_buf(lua_State *L, const void *p, size_t sz, void *ud) {
+  DumpBuf *b = (DumpBuf *)ud;
+  char *np;
+  (void)L;
+  if (sz == 0)
+    return 0;
+  np = (char *)realloc(b->p, b->n + sz);
+  if (np == NULL)
+    return 1;
+  memcpy(np + b->n, p, sz);
+  b->p = np;
+  b->n += sz;
+  return 0;
+}
+
+/* dump 全局函数 name，结果由调用者 free */
+static DumpBuf dump_global(lua_State *L, const char *name) {
+  DumpBuf b = {NULL, 0};
+  lua_getglobal(L, name);
+  lua_dump(L, write_buf, &b, 0);
+  lua_pop(L, 1);
+  return b;
+}
+
+static double now_us(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+int main(void) {
+  char err[256];
+  lua_State *tpl = luaL_newstate();
+  luaL_openlibs(tpl);
+
+  printf("=== Testing state cloning ===\n\n");
+
+  if (!run(tpl, tpl_code)) {
+    printf("template script failed\n");
+    return 1;
+  }
+  lua_gc(tpl, LUA_GCCOLLECT);
+
+  /* ---- 1. 全局、容器、类与标准库 ---- */
+  TEST("contents");
+  {
+    lua_State *L = spt_clonestate(tpl, err, sizeof(err));
+    if (!L)
+      FAIL(err);
+    else {
+      if (!run(L, "assert(nums[2] == 3 && #nums == 3);\n"
+                  "assert(cfg[\"self\"][\"self\"][\"name\"] == \"tpl\");\n"
+                  "auto p = P(3, 4);\n"
+                  "assert(p.sum() == 7);\n"
+                  "assert(string.upper(\"ab\") == \"AB\" && math.max(1, 5) == 5);\n"
+                  "assert(bump(5) == 5);\n"))
+        FAIL("clone cannot run against cloned globals");
+      else
+        PASS();
+      lua_close(L);
+    }
+  }
+
+  /* ---- 2. 隔离：克隆的修改不影响模板和其他克隆 ---- */
+  TEST("isolation");
+  {
+    lua_State *a = spt_clonestate(tpl, err, sizeof(err));
+    lua_State *b = spt_clonestate(tpl, err, sizeof(err));
+    if (!a || !b)
+      FAIL(err);
+    else if (!run(a, "bump(7); list.push(nums, 9); cfg[\"name\"] = \"a\";") ||
+             !run(b, "bump(1);"))
+      FAIL("scripts failed");
+    else if (global_int(a, "counter") != 7 || global_int(b, "counter") != 1 ||
+             global_int(tpl, "counter") != 0)
+      FAIL("counters leaked between states");
+    else if (!run(b, "assert(#nums == 3 && cfg[\"name\"] == \"tpl\");") ||
+             !run(tpl, "assert(#nums == 3 && cfg[\"name\"] == \"tpl\");"))
+      FAIL("containers leaked between states");
+    else
+      PASS();
+    if (a)
+      lua_close(a);
+    if (b)
+      lua_close(b);
+  }
+
+  /* ---- 3. 共享 upvalue ---- */
+  TEST("shared_upvalues");
+  {
+    lua_State *L = spt_clonestate(tpl, err, sizeof(err));
+    if (!L)
+      FAIL(err);
+    else {
+      if (!run(L, "inc(); inc(); assert(get() == 2);") ||
+          !run(tpl, "assert(get() == 0);"))
+        FAIL("upvalue sharing not preserved");
+      else
+        PASS();
+      lua_close(L);
+    }
+  }
+
+  /* ---- 4. luaL_ref 槽位 ---- */
+  TEST("registry_refs");
+  {
+    int ref;
+    lua_State *L;
+    lua_getglobal(tpl, "nums");
+    ref = luaL_ref(tpl, LUA_REGISTRYINDEX);
+    L = spt_clonestate(tpl, err, sizeof(err));
+    if (!L)
+      FAIL(err);
+    else {
+      int ok = lua_getref(L, ref) == LUA_TARRAY && lua_arraylen(L, -1) == 3;
+      lua_getglobal(L, "nums");
+      ok = ok && lua_rawequal(L, -1, -2); /* 与克隆的全局是同一个对象 */
+      lua_pop(L, 2);
+      /* 空闲链表也被复制：克隆里新分配的槽位与模板一致 */
+      ok = ok && (lua_pushboolean(L, 1), luaL_ref(L, LUA_REGISTRYINDEX)) ==
+                     (lua_pushboolean(tpl, 1), luaL_ref(tpl, LUA_REGISTRYINDEX));
+      if (ok)
+        PASS();
+      else
+        FAIL("ref slot not cloned");
+      lua_close(L);
+    }
+    luaL_unref(tpl, LUA_REGISTRYINDEX, ref);
+  }
+
+  /* ---- 5. 原型共享字节码 ---- */
+  TEST("shared_bytecode");
+  {
+    lua_State *L = spt_clonestate(tpl, err, sizeof(err));
+    if (!L)
+      FAIL(err);
+    else {
+      DumpBuf d1 = dump_global(tpl, "bump");
+      DumpBuf d2 = dump_global(L, "bump");
+      if (d1.n == 0 || d1.n != d2.n || memcmp(d1.p, d2.p, d1.n) != 0)
+        FAIL("dumped prototypes differ");
+      else
+        PASS();
+      free(d1.p);
+      free(d2.p);
+      lua_close(L);
+    }
+  }
+
+  /* ---- 6. userdata：字节复制、缺少 __clone、钩子与终结器 ---- */
+  TEST("userdata");
+  {
+    lua_State *L;
+    int *plain = (int *)lua_newuserdatauv(tpl, sizeof(int), 1);
+    *plain = 42;
+    lua_pushstring(tpl, "uv");
+    lua_setiuservalue(tpl, -2, 1);
+    lua_setglobal(tpl, "plain");
+    push_res(tpl, 7, 0);
+    lua_setglobal(tpl, "res");
+    L = spt_clonestate(tpl, err, sizeof(err));
+    if (L || strstr(err, "__clone") == NULL) {
+      FAIL("userdata with __gc but no __clone must not clone");
+      if (L)
+        lua_close(L);
+    } else {
+      push_res(tpl, 7, 1);
+      lua_setglobal(tpl, "res");
+      lua_gc(tpl, LUA_GCCOLLECT);
+      L = spt_clonestate(tpl, err, sizeof(err));
+      if (!L)
+        FAIL(err);
+      else {
+        int ok, *p;
+        Res *r;
+        lua_getglobal(L, "plain");
+        p = (int *)lua_touserdata(L, -1);
+        lua_getiuservalue(L, -1, 1);
+        ok = p && *p == 42 && strcmp(lua_tostring(L, -1), "uv") == 0;
+        lua_pop(L, 2);
+        lua_getglobal(L, "res");
+        r = (Res *)lua_touserdata(L, -1);
+        lua_pop(L, 1);
+        ok = ok && r && r->value == 1007 && hook_calls == 1 && live_res == 2;
+        lua_close(L); /* 克隆的终结器已登记 */
+        if (ok && live_res == 1)
+          PASS();
+        else
+          FAIL("userdata not cloned as expected");
+      }
+    }
+    lua_pushnil(tpl);
+    lua_setglobal(tpl, "res");
+    lua_pushnil(tpl);
+    lua_setglobal(tpl, "plain");
+    lua_gc(tpl, LUA_GCCOLLECT);
+  }
+
+  /* ---- 7. 协程不可克隆 ---- */
+  TEST("coroutine_rejected");
+  {
+    lua_State *L;
+    lua_newthread(tpl);
+    lua_setglobal(tpl, "co");
+    L = spt_clonestate(tpl, err, sizeof(err));
+    if (L || strstr(err, "coroutine") == NULL) {
+      FAIL("template with a coroutine must not clone");
+      if (L)
+        lua_close(L);
+    } else
+      PASS();
+    lua_pushnil(tpl);
+    lua_setglobal(tpl, "co");
+    lua_gc(tpl, LUA_GCCOLLECT);
+  }
+
+  /* ---- 8. 批量克隆（并给出与重新初始化的耗时对比）---- */
+  TEST("many_clones");
+  {
+    int i, ok = 1;
+    double t0 = now_us(), t_clone, t_fresh;
+    for (i = 0; i < 200 && ok; i++) {
+      lua_State *L = spt_clonestate(tpl, err, sizeof(err));
+      ok = L && run(L, "assert(bump(2) == 2);");
+      if (L)
+        lua_close(L);
+    }
+    t_clone = (now_us() - t0) / 200;
+    t0 = now_us();
+    for (i = 0; i < 200 && ok; i++) {
+      lua_State *L = luaL_newstate();
+      luaL_openlibs(L);
+      ok = run(L, tpl_code) && run(L, "assert(bump(2) == 2);");
+      lua_close(L);
+    }
+    t_fresh = (now_us() - t0) / 200;
+    if (!ok)
+      FAIL("clone loop failed");
+    else {
+      printf("(clone %.1f us, fresh %.1f us) ", t_clone, t_fresh);
+      PASS();
+    }
+  }
+
+  lua_close(tpl);
+
+  printf("\n=== %s ===\n", failed ? "SOME TESTS FAILED" : "All clone tests passed");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,199 @@
+/**
+ * TestFrozen.c — 验证跨状态共享的冻结代码块 (spt_frozen.h)
+ *
+ * 覆盖:
+ *   - 冻结后关闭编译用的状态，代码块仍可载入多个状态并正确运行
+ *   - 各状态的全局、闭包互相独立；长字符串常量内容指向共享块
+ *   - 共享部分不计入状态的堆：与从源码载入相比的内存对比
+ *   - 创建者先释放引用、状态关闭时终结器仍可执行冻结的代码
+ *   - 剥离调试信息；非 Lua 函数不能冻结
+ */
+
+#include "lauxlib.h"
+#include "lua.h"
+#include "lualib.h"
+#include "spt_frozen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST(name) printf("Testing: %s... ", name)
+#define PASS() printf("PASS\n")
+#define FAIL(msg)                                                                                  \
+  do {                                                                                             \
+    printf("FAIL: %s\n", msg);                                                                     \
+    failed++;                                                                                      \
+  } while (0)
+
+static int failed = 0;
+
+#define BANNER "this constant is long enough to be stored as a long string"
+
+static const char *module_code =
+    "global int hits = 0;\n"
+    "global str banner = \"" BANNER "\";\n"
+    "global int fib(int n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }\n"
+    "global int bump(int k) { hits = hits + k; return hits; }\n"
+    "global any guard = setmetatable({}, {\"__gc\": fn(any o) -> void { note(banner); }});\n";
+
+static int notes = 0;
+
+/* 终结器经冻结代码调用：参数为 nil receiver, 字符串 */
+static int note(lua_State *L) {
+  if (strcmp(luaL_checkstring(L, 2), BANNER) == 0)
+    notes++;
+  return 0;
+}
+
+static lua_State *new_state(void) {
+  lua_State *L = luaL_newstate();
+  luaL_openlibs(L);
+  lua_register(L, "note", note);
+  return L;
+}
+
+static int run(lua_State *L, const char *code) {
+  if (luaL_dostring(L, code) != LUA_OK) {
+    printf("(%s) ", lua_tostring(L, -1));
+    lua_pop(L, 1);
+    return 0;
+  }
+  return 1;
+}
+
+static int run_frozen(lua_State *L, SPTFrozen *f) {
+  if (spt_frozen_push(L, f) != LUA_OK || lua_pcall(L, 0, 0, 0) != LUA_OK) {
+    printf("(%s) ", lua_tostring(L, -1));
+    lua_pop(L, 1);
+    return 0;
+  }
+  return 1;
+}
+
+static SPTFrozen *freeze_code(const char *code, int strip) {
+  SPTFrozen *f = NULL;
+  lua_State *L = luaL_newstate();
+  if (luaL_loadstring(L, code) == LUA_OK)
+    f = spt_freeze(L, -1, strip);
+  lua_close(L);
+  return f;
+}
+
+/* 生成一个有 n 个函数、每个带长字符串常量的模块 */
+static char *big_module(int n) {
+  size_t cap = (size_t)n * 256 + 64, len = 0;
+  char *s = (char *)malloc(cap);
+  int i;
+  for (i = 0; i < n; i++)
+    len += (size_t)snprintf(s + len, cap - len,
+                            "global str f%d(int x) { if (x > %d) { return \"%s-%d\"; }"
+                            " return \"short\" .. x; }\n",
+                            i, i, BANNER, i);
+  return s;
+}
+
+static size_t heap_bytes(lua_State *L) {
+  lua_gc(L, LUA_GCCOLLECT);
+  return (size_t)lua_gc(L, LUA_GCCOUNT) * 1024 + (size_t)lua_gc(L, LUA_GCCOUNTB);
+}
+
+int main(void) {
+  SPTFrozen *mod;
+
+  printf("=== Testing frozen chunks ===\n\n");
+
+  mod = freeze_code(module_code, 0);
+  if (mod == NULL) {
+    printf("freeze failed\n");
+    return 1;
+  }
+
+  /* ---- 1. 载入多个状态并运行 ---- */
+  TEST("load_into_states");
+  {
+    lua_State *a = new_state(), *b = new_state();
+    if (!run_frozen(a, mod) || !run_frozen(b, mod))
+      FAIL("frozen chunk failed to run");
+    else if (!run(a, "assert(fib(15) == 610); assert(bump(3) == 3 && bump(4) == 7);") ||
+             !run(b, "assert(bump(1) == 1); assert(banner == \"" BANNER "\");"))
+      FAIL("functions from the frozen chunk misbehave");
+    else
+      PASS();
+
+    /* ---- 2. 同一状态载入两次：新闭包，新全局值 ---- */
+    TEST("reload_in_same_state");
+    if (!run_frozen(a, mod) || !run(a, "assert(hits == 0 && bump(2) == 2);"))
+      FAIL("second load in the same state");
+    else
+      PASS();
+
+    /* ---- 3. 创建者释放后，状态仍持有代码块；关闭时终结器执行冻结代码 ---- */
+    TEST("release_before_close");
+    spt_frozen_release(mod);
+    mod = NULL;
+    notes = 0;
+    lua_close(a);
+    lua_close(b);
+    if (notes != 3)
+      FAIL("finalizers from frozen code did not run on close");
+    else
+      PASS();
+  }
+
+  /* ---- 4. 共享部分不计入状态的堆 ---- */
+  TEST("heap_savings");
+  {
+    char *src = big_module(200);
+    SPTFrozen *big = freeze_code(src, 0);
+    lua_State *from_src = new_state(), *from_frozen = new_state();
+    size_t base = heap_bytes(from_frozen), h_src, h_frozen;
+    int ok = big != NULL && run(from_src, src) && run_frozen(from_frozen, big) &&
+             run(from_frozen, "assert(f7(100) == \"" BANNER "-7\" && f7(1) == \"short1\");");
+    h_src = heap_bytes(from_src) - base;
+    h_frozen = heap_bytes(from_frozen) - base;
+    if (!ok)
+      FAIL("big module failed");
+    else if (h_frozen >= h_src || h_src - h_frozen < spt_frozen_size(big) / 2)
+      FAIL("frozen load did not save heap");
+    else {
+      printf("(module heap: source %zu B, frozen %zu B, shared %zu B) ", h_src, h_frozen,
+             spt_frozen_size(big));
+      PASS();
+    }
+    lua_close(from_src);
+    lua_close(from_frozen);
+    spt_frozen_release(big);
+    free(src);
+  }
+
+  /* ---- 5. 剥离调试信息 ---- */
+  TEST("stripped");
+  {
+    SPTFrozen *full = freeze_code(module_code, 0), *s = freeze_code(module_code, 1);
+    lua_State *L = new_state();
+    if (s == NULL || spt_frozen_size(s) >= spt_frozen_size(full) || !run_frozen(L, s) ||
+        !run(L, "assert(fib(10) == 55);"))
+      FAIL("stripped chunk");
+    else
+      PASS();
+    lua_close(L);
+    spt_frozen_release(s);
+    spt_frozen_release(full);
+  }
+
+  /* ---- 6. 错误情形 ---- */
+  TEST("errors");
+  {
+    lua_State *L = new_state();
+    lua_pushcfunction(L, note);
+    lua_pushinteger(L, 1);
+    if (spt_freeze(L, -2, 0) != NULL || spt_freeze(L, -1, 0) != NULL)
+      FAIL("only Lua functions can be frozen");
+    else
+      PASS();
+    lua_close(L);
+  }
+
+  printf("\n=== %s ===\n", failed ? "SOME TESTS FAILED" : "All frozen chunk tests passed");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,296 @@
+/**
+ * TestHeapProf.c — 验证分配 profiler (spt_heapprof.h)
+ *
+ * 覆盖:
+ *   - interval=1 时精确记录: 分配点归到 Proto + 源码行 + 类型
+ *   - 存活统计随 GC 释放更新 (live 归零)
+ *   - 报告: top-N 文本表按存活字节排序
+ *   - collectgarbage("heapprofile"/"heapsnapshot") 脚本接口与快照差分
+ *   - 构建快照时内存不足: 返回 0, 之后继续记录
+ *   - 反复加载/回收同一代码块: 旧 Proto 的分配点作废, 新分配记到新分配点
+ *   - stop / lua_close 释放全部数据
+ */
+
+#include "lauxlib.h"
+#include "lua.h"
+#include "lualib.h"
+#include "spt_heapprof.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST(name) printf("Testing: %s... ", name)
+#define PASS() printf("PASS\n")
+#define FAIL(msg)                                                                                  \
+  do {                                                                                             \
+    printf("FAIL: %s\n", msg);                                                                     \
+    failed++;                                                                                      \
+  } while (0)
+
+static int failed = 0;
+
+/* 第 3 行分配 list、第 4 行分配 map，全部挂在全局 keep 上保持存活。 */
+static const char *alloc_code = "global list<any> keep = [];\n"
+                                "for (int i = 1, 200) {\n"
+                                "  list<int> l = [i, i, i];\n"
+                                "  map<str, int> m = {\"a\": i};\n"
+                                "  list.push(keep, l);\n"
+                                "  list.push(keep, m);\n"
+                                "}\n";
+
+static char *read_all(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return NULL;
+  fseek(f, 0, SEEK_END);
+  long n = ftell(f);
+  rewind(f);
+  char *buf = (char *)malloc((size_t)n + 1);
+  size_t rd = fread(buf, 1, (size_t)n, f);
+  buf[rd] = '\0';
+  fclose(f);
+  return buf;
+}
+
+/* 可按需让扩大分配失败的分配器 */
+static int fail_allocs = 0;
+
+static void *failing_alloc(void *ud, void *ptr, size_t osize, size_t nsize) {
+  (void)ud;
+  if (nsize == 0) {
+    free(ptr);
+    return NULL;
+  }
+  if (fail_allocs && (ptr == NULL || nsize > osize))
+    return NULL;
+  return realloc(ptr, nsize);
+}
+
+/* 在快照 (栈顶 map) 中查找 key 以 suffix 结尾的分配点，返回其字段值 (-1 = 无)。 */
+static long long snapshot_field(lua_State *L, const char *suffix, const char *field) {
+  long long v = -1;
+  size_t sl = strlen(suffix);
+  lua_pushnil(L);
+  while (lua_next(L, -2)) {
+    size_t kl;
+    const char *k = lua_tolstring(L, -2, &kl);
+    if (k && kl >= sl && strcmp(k + kl - sl, suffix) == 0) {
+      lua_getfield(L, -1, field);
+      v = (long long)lua_tointeger(L, -1);
+      lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+  }
+  return v;
+}
+
+int main(void) {
+  const char *out = "TestHeapProf.txt";
+  lua_State *L = luaL_newstate();
+  luaL_openlibs(L);
+
+  printf("=== Testing allocation profiler ===\n\n");
+
+  /* ---- 1. 未启动时 dump/snapshot 失败 ---- */
+  TEST("inactive");
+  {
+    SPTHeapProfStats st;
+    spt_heapprof_getstats(L, &st);
+    if (spt_heapprof_active(L) || spt_heapprof_dump(L, out, 10) == 0 ||
+        spt_heapprof_pushsnapshot(L) || st.samples != 0)
+      FAIL("inactive profiler should report nothing");
+    else
+      PASS();
+  }
+
+  /* ---- 2. interval=1: 每次分配都归到具体行 ---- */
+  TEST("sites_exact");
+  {
+    spt_heapprof_start(L, 1);
+    if (luaL_dostring(L, alloc_code) != LUA_OK) {
+      FAIL(lua_tostring(L, -1));
+      lua_pop(L, 1);
+    } else if (!spt_heapprof_pushsnapshot(L)) {
+      FAIL("snapshot failed");
+    } else {
+      long long lists = snapshot_field(L, ":3 list", "live");
+      long long maps = snapshot_field(L, ":4 map", "live");
+      long long bytes = snapshot_field(L, ":3 list", "bytes");
+      lua_pop(L, 1);
+      if (lists != 200 || maps != 200) {
+        printf("(lists=%lld maps=%lld) ", lists, maps);
+        FAIL("expected 200 live objects at lines 3 and 4");
+      } else if (bytes <= 0)
+        FAIL("live bytes should be positive");
+      else
+        PASS();
+    }
+  }
+
+  /* ---- 3. top-N 报告按存活字节排序 ---- */
+  TEST("dump_topn");
+  {
+    char *text = NULL;
+    if (spt_heapprof_dump(L, out, 2) != 0 || !(text = read_all(out)))
+      FAIL("dump failed");
+    else {
+      int rows = 0;
+      unsigned long long prev = ~0ull;
+      int sorted = 1;
+      for (char *line = strtok(text, "\n"); line; line = strtok(NULL, "\n")) {
+        unsigned long long b;
+        if (line[0] == '#' || sscanf(line, "%llu", &b) != 1)
+          continue;
+        if (b > prev)
+          sorted = 0;
+        prev = b;
+        rows++;
+      }
+      if (rows != 2 || !sorted)
+        FAIL("expected 2 rows sorted by live bytes");
+      else
+        PASS();
+    }
+    free(text);
+  }
+
+  /* ---- 4. 释放后 live 归零, allocs 保留 ---- */
+  TEST("live_after_free");
+  {
+    luaL_dostring(L, "keep = null;");
+    lua_gc(L, LUA_GCCOLLECT);
+    lua_gc(L, LUA_GCCOLLECT);
+    spt_heapprof_pushsnapshot(L);
+    long long live = snapshot_field(L, ":3 list", "live");
+    long long allocs = snapshot_field(L, ":3 list", "allocs");
+    lua_pop(L, 1);
+    if (live != 0 || allocs != 200) {
+      printf("(live=%lld allocs=%lld) ", live, allocs);
+      FAIL("freed objects should leave allocs but no live");
+    } else
+      PASS();
+    spt_heapprof_stop(L);
+  }
+
+  /* ---- 5. 脚本接口: heapprofile + heapsnapshot 差分 ---- */
+  TEST("script_api");
+  {
+    const char *code =
+        "assert(collectgarbage(\"heapsnapshot\") == null, \"no snapshot while off\");\n"
+        "assert(collectgarbage(\"heapprofile\", 1) == false, \"was off\");\n"
+        "auto before = collectgarbage(\"heapsnapshot\");\n"
+        "list<any> hold = [];\n"
+        "for (int i = 0, 50) { list.push(hold, {\"x\": i}); }\n"
+        "auto after = collectgarbage(\"heapsnapshot\");\n"
+        "int grown = 0;\n"
+        "for (auto k, v : after) {\n"
+        "  int old = 0;\n"
+        "  if (before[k] != null) { old = before[k].live; }\n"
+        "  if (v.live - old >= 50) { grown = grown + 1; }\n"
+        "}\n"
+        "assert(grown >= 1, \"diff should show the loop's maps\");\n"
+        "assert(collectgarbage(\"heapprofile\", 0) == true, \"was on\");\n";
+    if (luaL_dostring(L, code) != LUA_OK) {
+      FAIL(lua_tostring(L, -1));
+      lua_pop(L, 1);
+    } else if (spt_heapprof_active(L))
+      FAIL("heapprofile 0 should stop the profiler");
+    else
+      PASS();
+  }
+
+  /* ---- 6. 采样模式: 默认间隔下只记录一部分分配 ---- */
+  TEST("sampled");
+  {
+    SPTHeapProfStats st;
+    spt_heapprof_start(L, 0);
+    luaL_dostring(L, alloc_code);
+    spt_heapprof_getstats(L, &st);
+    if (st.samples == 0 || st.samples >= 400 || st.live_bytes == 0)
+      FAIL("default interval should sample a subset of allocations");
+    else
+      PASS();
+  }
+
+  /* ---- 7. 快照内存不足: 不留下 busy 标记 ---- */
+  TEST("snapshot_out_of_memory");
+  {
+    lua_State *M = lua_newstate(failing_alloc, NULL, luaL_makeseed(NULL));
+    SPTHeapProfStats st0, st1;
+    luaL_openlibs(M);
+    spt_heapprof_start(M, 1);
+    int ok = luaL_dostring(M, alloc_code) == LUA_OK;
+    int top = lua_gettop(M);
+    fail_allocs = 1;
+    int snap = spt_heapprof_pushsnapshot(M);
+    fail_allocs = 0;
+    spt_heapprof_getstats(M, &st0);
+    ok = ok && luaL_dostring(M, "global list<int> more = [1, 2, 3];") == LUA_OK;
+    spt_heapprof_getstats(M, &st1);
+    if (!ok)
+      FAIL("allocation code failed");
+    else if (snap || lua_gettop(M) != top)
+      FAIL("failed snapshot should return 0 and push nothing");
+    else if (st1.samples <= st0.samples)
+      FAIL("tracking should continue after a failed snapshot");
+    else if (!spt_heapprof_pushsnapshot(M))
+      FAIL("snapshot should succeed once memory is available");
+    else
+      PASS();
+    lua_close(M);
+  }
+
+  /* ---- 8. 反复加载后回收: 被释放 Proto 的分配点不再命中 ---- */
+  TEST("reloaded_chunks");
+  {
+    /* 第 1 行 (函数体) 和第 2 行 (主块) 各分配一个 list, 均不保留 */
+    const char *chunk = "list<int> pair(int x) { return [x, x]; }\n"
+                        "list<int> l = [1, pair(2)[1]];\n";
+    SPTHeapProfStats st;
+    int ok = 1;
+    spt_heapprof_stop(L);
+    spt_heapprof_start(L, 1);
+    for (int i = 0; i < 50 && ok; i++) {
+      ok = luaL_loadstring(L, chunk) == LUA_OK && lua_pcall(L, 0, 0, 0) == LUA_OK;
+      lua_gc(L, LUA_GCCOLLECT);
+    }
+    spt_heapprof_getstats(L, &st);
+    spt_heapprof_pushsnapshot(L);
+    long long inner = snapshot_field(L, ":1 list", "allocs");
+    long long outer = snapshot_field(L, ":2 list", "allocs");
+    long long live = snapshot_field(L, ":1 list", "live") + snapshot_field(L, ":2 list", "live");
+    lua_pop(L, 1);
+    if (!ok)
+      FAIL("chunk failed");
+    else if (inner != 50 || outer != 50 || live != 0) {
+      printf("(inner=%lld outer=%lld live=%lld) ", inner, outer, live);
+      FAIL("each load should be recorded once and freed");
+    } else if (st.sites < 100)
+      FAIL("every load should get sites of its own");
+    else
+      PASS();
+  }
+
+  /* ---- 9. lua_close 释放活跃 profiler ---- */
+  TEST("close_while_active");
+  {
+    lua_close(L);
+    L = luaL_newstate();
+    if (spt_heapprof_active(L))
+      FAIL("new state should start without a profiler");
+    else
+      PASS();
+  }
+
+  lua_close(L);
+  remove(out);
+
+  printf("\n=== Test Summary ===\n");
+  if (failed == 0) {
+    printf("All tests PASSED!\n");
+    return 0;
+  } else {
+    printf("%d test(s) FAILED!\n", failed);
+    return 1;
+  }
+}
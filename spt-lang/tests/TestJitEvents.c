@@ -0,0 +1,233 @@
+/**
+ * TestJitEvents.c — 验证 JIT trace 事件流与 trace dump (spt_jit.h)
+ *
+ * 覆盖:
+ *   - 回调收到 record / compile 事件, trace id 从 1 开始
+ *   - abort 事件带原因与停止处的 opcode; 同一 PC 多次 abort 后 blacklist
+ *   - SPTJitStats.aborts_by_reason 之和等于 traces_aborted
+ *   - sptjit_dump_trace: IR + 快照表 + 机器码; 未知 id 返回 -1
+ *   - JSONL 日志文件: 每行一个事件对象
+ *   - 移除回调后不再收到事件
+ */
+
+#include "lauxlib.h"
+#include "lua.h"
+#include "lualib.h"
+#include "spt_jit.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST(name) printf("Testing: %s... ", name)
+#define PASS() printf("PASS\n")
+#define FAIL(msg)                                                                                  \
+  do {                                                                                             \
+    printf("FAIL: %s\n", msg);                                                                     \
+    failed++;                                                                                      \
+  } while (0)
+
+static int failed = 0;
+
+/* 回调收集到的事件 (只保留判断需要的字段)。 */
+typedef struct {
+  int count[SPT_JIT_EV__COUNT];
+  uint32_t last_compiled;
+  int compile_ir;
+  size_t compile_code;
+  int inner_loop_aborts;
+  char abort_op[32];
+  int blacklist_line;
+} EventLog;
+
+static void on_event(void *ud, const SPTJitEvent *ev) {
+  EventLog *log = (EventLog *)ud;
+  log->count[ev->kind]++;
+  switch (ev->kind) {
+  case SPT_JIT_EV_COMPILE:
+    log->last_compiled = ev->trace;
+    log->compile_ir = ev->ir_size;
+    log->compile_code = ev->code_size;
+    break;
+  case SPT_JIT_EV_ABORT:
+    if (ev->reason == SPT_JIT_ABORT_INNER_LOOP)
+      log->inner_loop_aborts++;
+    if (ev->abort_op)
+      snprintf(log->abort_op, sizeof(log->abort_op), "%s", ev->abort_op);
+    break;
+  case SPT_JIT_EV_BLACKLIST:
+    log->blacklist_line = ev->line;
+    break;
+  default:
+    break;
+  }
+}
+
+/* 可编译的简单循环。 */
+static const char *hot_code = "int s = 0;\n"
+                              "for (int i = 1, 5000) { s = s + i; }\n"
+                              "assert(s == 12502500);\n";
+
+/* 外层 for 内嵌 while: 外层每次录制都在内层回边处 abort (inner_loop)。 */
+static const char *nested_code = "int s = 0;\n"
+                                 "for (int i = 1, 3000) {\n"
+                                 "  int j = 0;\n"
+                                 "  while (j < 3) { j = j + 1; }\n"
+                                 "  s = s + j;\n"
+                                 "}\n"
+                                 "assert(s == 9000);\n";
+
+static char *read_all(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return NULL;
+  fseek(f, 0, SEEK_END);
+  long n = ftell(f);
+  rewind(f);
+  char *buf = (char *)malloc((size_t)n + 1);
+  size_t rd = fread(buf, 1, (size_t)n, f);
+  buf[rd] = '\0';
+  fclose(f);
+  return buf;
+}
+
+static int run(lua_State *L, const char *code) {
+  if (luaL_dostring(L, code) != LUA_OK) {
+    FAIL(lua_tostring(L, -1));
+    lua_pop(L, 1);
+    return 0;
+  }
+  return 1;
+}
+
+int main(void) {
+  const char *dump_out = "TestJitEvents.dump.txt";
+  const char *log_out = "TestJitEvents.jsonl";
+  lua_State *L = luaL_newstate();
+  luaL_openlibs(L);
+  SPTJitState *js = sptjit_get_state(L);
+  EventLog log;
+  memset(&log, 0, sizeof(log));
+
+  printf("=== Testing JIT trace events ===\n\n");
+
+  if (!js) {
+    printf("JIT unavailable on this platform, skipping\n");
+    lua_close(L);
+    return 0;
+  }
+  sptjit_enable(js);
+  sptjit_set_event_handler(js, on_event, &log);
+
+  /* ---- 1. record + compile ---- */
+  TEST("compile_event");
+  if (run(L, hot_code)) {
+    if (log.count[SPT_JIT_EV_RECORD] < 1 || log.count[SPT_JIT_EV_COMPILE] != 1 ||
+        log.last_compiled != 1 || log.compile_ir <= 0 || log.compile_code == 0)
+      FAIL("expected one record + compile with sizes and trace id 1");
+    else
+      PASS();
+  }
+
+  /* ---- 2. abort 原因 + blacklist ---- */
+  TEST("abort_reason");
+  if (run(L, nested_code)) {
+    if (log.inner_loop_aborts < SPT_JIT_MAX_ABORTS || strcmp(log.abort_op, "JMP") != 0) {
+      printf("(inner_loop=%d op=%s) ", log.inner_loop_aborts, log.abort_op);
+      FAIL("outer loop should abort at the inner JMP back-edge");
+    } else if (log.count[SPT_JIT_EV_BLACKLIST] != 1 || log.blacklist_line != 3)
+      FAIL("outer loop (body starts on line 3) should be blacklisted once");
+    else
+      PASS();
+  }
+
+  /* ---- 3. 统计: 按原因计数之和 == traces_aborted ---- */
+  TEST("stats_by_reason");
+  {
+    SPTJitStats st;
+    sptjit_get_stats(js, &st);
+    uint64_t sum = 0;
+    for (int r = 0; r < SPT_JIT_ABORT__COUNT; r++)
+      sum += st.aborts_by_reason[r];
+    if (sum != st.traces_aborted || st.aborts_by_reason[SPT_JIT_ABORT_INNER_LOOP] <
+                                        (uint64_t)SPT_JIT_MAX_ABORTS ||
+        st.blacklisted != 1)
+      FAIL("per-reason counters inconsistent");
+    else
+      PASS();
+  }
+
+  /* ---- 4. trace dump (trace 1 = 第 1 步的 for 循环) ---- */
+  TEST("dump_trace");
+  {
+    size_t size = 0;
+    const void *code = sptjit_trace_code(js, 1, &size);
+    FILE *f = fopen(dump_out, "w");
+    int rc = f ? sptjit_dump_trace(js, 1, f) : -1;
+    if (f)
+      fclose(f);
+    char *text = read_all(dump_out);
+    if (rc != 0 || !code || size == 0 || !text)
+      FAIL("dump of a live trace failed");
+    else if (!strstr(text, "==== trace 1 (root)") || !strstr(text, "IR dump") ||
+             !strstr(text, "---- snapshots") || !strstr(text, "loop-end") ||
+             !strstr(text, "---- mcode") || !strstr(text, "  0000:"))
+      FAIL("dump sections missing");
+    else if (sptjit_dump_trace(js, 9999, stdout) != -1 || sptjit_trace_code(js, 0, NULL))
+      FAIL("unknown trace id should fail");
+    else
+      PASS();
+    free(text);
+  }
+
+  /* ---- 5. JSONL 日志 ---- */
+  TEST("jsonl_log");
+  {
+    remove(log_out);
+    if (sptjit_set_event_log(js, log_out) != 0)
+      FAIL("cannot open log");
+    else if (run(L, "int t = 0; for (int k = 1, 5000) { t = t + k * 2; }")) {
+      sptjit_set_event_log(js, NULL);
+      char *text = read_all(log_out);
+      int lines = 0, ok = text != NULL;
+      for (char *line = text ? strtok(text, "\n") : NULL; line; line = strtok(NULL, "\n")) {
+        size_t n = strlen(line);
+        lines++;
+        if (strncmp(line, "{\"ev\":\"", 7) != 0 || line[n - 1] != '}')
+          ok = 0;
+      }
+      free(text);
+      text = read_all(log_out);
+      if (!ok || lines < 2 || !strstr(text, "\"ev\":\"compile\"") || !strstr(text, "\"ir\":"))
+        FAIL("log should hold one JSON object per event");
+      else
+        PASS();
+      free(text);
+    }
+  }
+
+  /* ---- 6. 移除回调 ---- */
+  TEST("handler_removed");
+  {
+    int before = log.count[SPT_JIT_EV_RECORD];
+    sptjit_set_event_handler(js, NULL, NULL);
+    if (run(L, "int u = 0; for (int k = 1, 5000) { u = u + k * 3; }")) {
+      if (log.count[SPT_JIT_EV_RECORD] != before)
+        FAIL("no events after removing the handler");
+      else
+        PASS();
+    }
+  }
+
+  lua_close(L);
+  remove(dump_out);
+  remove(log_out);
+
+  printf("\n=== Test Summary ===\n");
+  if (failed == 0) {
+    printf("All tests PASSED!\n");
+    return 0;
+  } else {
+    printf("%d test(s) FAILED!\n", failed);
+    return 1;
+  }
+}
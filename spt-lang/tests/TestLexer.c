@@ -0,0 +1,190 @@
+/**
+ * TestLexer.c — 词法器批量扫描路径与关键字完美哈希的一致性测试。
+ *
+ * 覆盖:
+ *   - 向量路径与标量路径 (spt_lex_set_scalar) 对同一输入产出完全相同的 token 与诊断，
+ *     含长空白/缩进、跨行块注释、文档注释、带转义与换行的字符串、Unicode 标识符
+ *   - 同一样例的每个前缀 (覆盖不足一个向量的尾部与未闭合字符串/注释)
+ *   - 全部关键字命中对应种类，近似拼写仍为标识符
+ */
+
+#include "spt_arena.h"
+#include "spt_diag.h"
+#include "spt_lexer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failed = 0;
+#define CHECK(cond, msg)                                                                           \
+  do {                                                                                             \
+    if (!(cond)) {                                                                                 \
+      printf("  FAIL: %s\n", msg);                                                                 \
+      failed++;                                                                                    \
+    }                                                                                              \
+  } while (0)
+
+typedef struct {
+  SptArena *arena;
+  SptDiag diag;
+  SptTokenArray toks;
+  int ok;
+} LexRun;
+
+static void lex_run(LexRun *r, const char *src, size_t len, int scalar) {
+  spt_lex_set_scalar(scalar);
+  r->arena = spt_arena_create(0);
+  spt_diag_init(&r->diag, "<test>", src, len);
+  r->toks.tokens = NULL;
+  r->toks.count = 0;
+  r->ok = spt_lex(src, len, r->arena, &r->diag, &r->toks);
+  spt_lex_set_scalar(0);
+}
+
+static int same_str(const char *a, const char *b) {
+  if (!a || !b)
+    return a == b;
+  return strcmp(a, b) == 0;
+}
+
+/* 向量路径与标量路径的结果逐项相同。 */
+static int same_lex(const char *src, size_t len) {
+  LexRun v, s;
+  lex_run(&v, src, len, 0);
+  lex_run(&s, src, len, 1);
+  int ok = v.ok == s.ok && v.toks.count == s.toks.count && v.diag.count == s.diag.count;
+  for (int i = 0; ok && i < v.toks.count; i++) {
+    const SptToken *a = &v.toks.tokens[i], *b = &s.toks.tokens[i];
+    ok = a->kind == b->kind && a->lexeme == b->lexeme && a->length == b->length &&
+         a->line == b->line && a->column == b->column && same_str(a->doc, b->doc);
+  }
+  for (int i = 0; ok && i < v.diag.count; i++)
+    ok = v.diag.entries[i].line == s.diag.entries[i].line &&
+         v.diag.entries[i].column == s.diag.entries[i].column &&
+         strcmp(v.diag.entries[i].message, s.diag.entries[i].message) == 0;
+  spt_arena_destroy(v.arena);
+  spt_arena_destroy(s.arena);
+  return ok;
+}
+
+static const char *const SAMPLES[] = {
+    "int x = 1;\n",
+    "                                                        int deep = 0;\n",
+    "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\r\n\r\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\nx",
+    "/* a block comment that runs well past a single vector width\n * second line\n"
+    " * third line with a star * and a slash / but no close */ y",
+    "/** doc\n    over several lines, long enough to need more than one vector */\nfn f() {}\n",
+    "/// first doc line, also quite long so that it spans vectors\n/// second\nint z;\n",
+    "str s = \"a long string literal body with no escapes at all, spanning vectors\";\n",
+    "str e = \"escape \\\" quote and \\\\ backslash \\n inside a long-ish literal\";\n",
+    "str m = 'multi\nline\nsingle-quoted string with embedded newlines and \\\n continuation';\n",
+    "int averyveryveryverylongidentifier_with_digits_0123456789_and_more = 1;\n",
+    "str 名字 = \"中文\"; int x\xCC\x81y = 2; int abc\xE2\x80\xBF\xE2\x80\xBF" "def = 3;\n",
+    "int a = 1;/*x*/int b=2;//c\nint c = 3;      // trailing\n",
+    "/**/ /***/ /* * */ x",
+    "\"unterminated string that goes on and on past the vector width",
+    "/* unterminated comment that goes on and on past the vector width",
+};
+
+static void test_paths_agree(void) {
+  printf("Testing: vector and scalar scanning agree...\n");
+  int bad = 0;
+  for (size_t i = 0; i < sizeof SAMPLES / sizeof *SAMPLES; i++) {
+    if (!same_lex(SAMPLES[i], strlen(SAMPLES[i]))) {
+      printf("  mismatch on sample %zu\n", i);
+      bad++;
+    }
+  }
+  CHECK(bad == 0, "every sample lexes identically on both paths");
+
+  /* 拼接全部样例后取每个前缀：尾部长度、未闭合结构落在任意位置。 */
+  size_t total = 0;
+  for (size_t i = 0; i < sizeof SAMPLES / sizeof *SAMPLES - 2; i++)
+    total += strlen(SAMPLES[i]);
+  char *all = (char *)malloc(total + 1);
+  size_t n = 0;
+  for (size_t i = 0; i < sizeof SAMPLES / sizeof *SAMPLES - 2; i++) {
+    memcpy(all + n, SAMPLES[i], strlen(SAMPLES[i]));
+    n += strlen(SAMPLES[i]);
+  }
+  all[n] = '\0';
+  bad = 0;
+  for (size_t k = 0; k <= n; k++)
+    bad += !same_lex(all, k);
+  CHECK(bad == 0, "every prefix of the concatenated samples lexes identically");
+  free(all);
+}
+
+static void test_line_tracking(void) {
+  printf("Testing: line/column tracking across bulk-skipped regions...\n");
+  const char *src = "a\n\n\n                                      b /* x\ny\nz */ c \"p\nq\" d";
+  LexRun r;
+  lex_run(&r, src, strlen(src), 0);
+  CHECK(r.ok && r.toks.count == 6, "six tokens incl. EOF");
+  if (r.ok && r.toks.count == 6) {
+    CHECK(r.toks.tokens[1].line == 4 && r.toks.tokens[1].column == 39, "b after blank lines");
+    CHECK(r.toks.tokens[2].line == 6 && r.toks.tokens[2].column == 6, "c after block comment");
+    CHECK(r.toks.tokens[3].line == 6 && r.toks.tokens[3].kind == TOK_STRING_LITERAL,
+          "string starts on line 6");
+    CHECK(r.toks.tokens[4].line == 7 && r.toks.tokens[4].column == 4, "d after multi-line string");
+  }
+  spt_arena_destroy(r.arena);
+}
+
+static void test_keywords(void) {
+  printf("Testing: keyword perfect hash...\n");
+  static const struct {
+    const char *kw;
+    SptTokenKind kind;
+  } kws[] = {
+      {"int", TOK_INT},           {"float", TOK_FLOAT},     {"number", TOK_NUMBER},
+      {"str", TOK_STR},           {"bool", TOK_BOOL},       {"any", TOK_ANY},
+      {"void", TOK_VOID},         {"null", TOK_NULL},       {"list", TOK_LIST},
+      {"map", TOK_MAP},           {"fn", TOK_FUNCTION},     {"coro", TOK_COROUTINE},
+      {"vars", TOK_VARS},         {"if", TOK_IF},           {"else", TOK_ELSE},
+      {"while", TOK_WHILE},       {"for", TOK_FOR},         {"break", TOK_BREAK},
+      {"continue", TOK_CONTINUE}, {"return", TOK_RETURN},   {"defer", TOK_DEFER},
+      {"true", TOK_TRUE},         {"false", TOK_FALSE},     {"const", TOK_CONST},
+      {"auto", TOK_AUTO},         {"global", TOK_GLOBAL},   {"static", TOK_STATIC},
+      {"import", TOK_IMPORT},     {"as", TOK_AS},           {"from", TOK_FROM},
+      {"export", TOK_EXPORT},     {"declare", TOK_DECLARE}, {"class", TOK_CLASS},
+  };
+  static const char *const near[] = {"in", "ints", "Int", "fnx", "f", "clas", "classs", "elsee",
+                                     "_if", "whilE", "continues", "iff", "esle", "declared", "x1"};
+  int bad = 0;
+  for (size_t i = 0; i < sizeof kws / sizeof *kws; i++) {
+    LexRun r;
+    lex_run(&r, kws[i].kw, strlen(kws[i].kw), 0);
+    if (!r.ok || r.toks.count != 2 || r.toks.tokens[0].kind != kws[i].kind) {
+      printf("  keyword '%s' not recognized\n", kws[i].kw);
+      bad++;
+    }
+    spt_arena_destroy(r.arena);
+  }
+  CHECK(bad == 0, "all keywords map to their token kinds");
+  bad = 0;
+  for (size_t i = 0; i < sizeof near / sizeof *near; i++) {
+    LexRun r;
+    lex_run(&r, near[i], strlen(near[i]), 0);
+    if (!r.ok || r.toks.count != 2 || r.toks.tokens[0].kind != TOK_IDENTIFIER) {
+      printf("  '%s' should be an identifier\n", near[i]);
+      bad++;
+    }
+    spt_arena_destroy(r.arena);
+  }
+  CHECK(bad == 0, "near-miss spellings stay identifiers");
+}
+
+int main(void) {
+  printf("=== TestLexer: bulk scanning + keyword hash ===\n");
+  test_paths_agree();
+  test_line_tracking();
+  test_keywords();
+  if (failed == 0) {
+    printf("=== TestLexer: ALL PASS ===\n");
+    return 0;
+  }
+  printf("=== TestLexer: %d CHECK(s) FAILED ===\n", failed);
+  return 1;
+}
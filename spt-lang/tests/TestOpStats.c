@@ -0,0 +1,164 @@
+/**
+ * TestOpStats.c — 验证指令分发统计 (spt_opstats.h)
+ *
+ * 覆盖:
+ *   - 未以 SPT_OPSTATS 构建时: API 存在但 start 失败、计数为零
+ *   - 以 SPT_OPSTATS 构建时:
+ *       按 opcode 计数、慢路径 (mmbin / finishget) 计数
+ *       报告包含三段 (opcodes / slow paths / hot instructions)
+ *       stop 后不再计数、reset 清空、lua_close 释放
+ */
+
+#include "lauxlib.h"
+#include "lua.h"
+#include "lualib.h"
+#include "spt_opstats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST(name) printf("Testing: %s... ", name)
+#define PASS() printf("PASS\n")
+#define FAIL(msg)                                                                                  \
+  do {                                                                                             \
+    printf("FAIL: %s\n", msg);                                                                     \
+    failed++;                                                                                      \
+  } while (0)
+
+static int failed = 0;
+
+/* 100 次 __add (OP_MMBIN) + 100 次缺失键读取 (luaV_finishget)。 */
+static const char *work_code = "class Vec2 {\n"
+                               "  int x;\n"
+                               "  int y;\n"
+                               "  void __init(int x, int y) { this.x = x; this.y = y; }\n"
+                               "  Vec2 __add(Vec2 o) { return Vec2(this.x + o.x, this.y + o.y); }\n"
+                               "}\n"
+                               "Vec2 acc = Vec2(0, 0);\n"
+                               "for (int i = 1, 100) { acc = acc + Vec2(i, i); }\n"
+                               "map<str, int> m = {\"a\": 1};\n"
+                               "int miss = 0;\n"
+                               "for (int i = 1, 100) { if (m[\"b\"] == null) { miss = miss + 1; } }\n"
+                               "assert(acc.x == 5050 && miss == 100);\n";
+
+static char *read_all(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return NULL;
+  fseek(f, 0, SEEK_END);
+  long n = ftell(f);
+  rewind(f);
+  char *buf = (char *)malloc((size_t)n + 1);
+  size_t rd = fread(buf, 1, (size_t)n, f);
+  buf[rd] = '\0';
+  fclose(f);
+  return buf;
+}
+
+int main(void) {
+  const char *out = "TestOpStats.txt";
+  lua_State *L = luaL_newstate();
+  luaL_openlibs(L);
+
+  printf("=== Testing interpreter opstats ===\n\n");
+
+  if (!spt_opstats_available()) {
+    TEST("compiled_out");
+    if (spt_opstats_start(L) || spt_opstats_total(L) != 0 || spt_opstats_dump(L, out, 5) == 0)
+      FAIL("opstats API should be inert without SPT_OPSTATS");
+    else
+      PASS();
+    lua_close(L);
+    printf("\n=== Test Summary ===\n");
+    printf(failed ? "%d test(s) FAILED!\n" : "All tests PASSED!\n", failed);
+    return failed ? 1 : 0;
+  }
+
+  /* ---- 1. 计数: opcode + 慢路径 ---- */
+  TEST("counts");
+  {
+    if (!spt_opstats_start(L))
+      FAIL("start failed");
+    else if (luaL_dostring(L, work_code) != LUA_OK) {
+      FAIL(lua_tostring(L, -1));
+      lua_pop(L, 1);
+    } else {
+      spt_opstats_stop(L);
+      unsigned long long mmbin = spt_opstats_slow(L, SPT_OPSLOW_MMBIN);
+      unsigned long long get = spt_opstats_slow(L, SPT_OPSLOW_FINISHGET);
+      unsigned long long add = spt_opstats_opcount(L, "ADD");
+      if (mmbin < 100 || get < 100 || add < 200 || spt_opstats_total(L) <= add) {
+        printf("(mmbin=%llu finishget=%llu ADD=%llu) ", mmbin, get, add);
+        FAIL("unexpected counters");
+      } else
+        PASS();
+    }
+  }
+
+  /* ---- 2. 报告三段齐全 ---- */
+  TEST("report");
+  {
+    char *text = NULL;
+    if (spt_opstats_dump(L, out, 5) != 0 || !(text = read_all(out)))
+      FAIL("dump failed");
+    else if (!strstr(text, "# opcodes") || !strstr(text, "finishget") ||
+             !strstr(text, "# hot instructions") || !strstr(text, " pc "))
+      FAIL("report sections missing");
+    else
+      PASS();
+    free(text);
+  }
+
+  /* ---- 3. stop 后不再计数 ---- */
+  TEST("stopped");
+  {
+    unsigned long long before = spt_opstats_total(L);
+    luaL_dostring(L, "int s = 0; for (int i = 1, 1000) { s = s + i; }");
+    if (spt_opstats_total(L) != before)
+      FAIL("counting should pause after stop");
+    else
+      PASS();
+  }
+
+  /* ---- 4. reset 清空, 再 start 从零开始 ---- */
+  TEST("reset");
+  {
+    spt_opstats_reset(L);
+    if (spt_opstats_total(L) != 0 || spt_opstats_dump(L, out, 5) == 0)
+      FAIL("reset should drop all counters");
+    else {
+      spt_opstats_start(L);
+      luaL_dostring(L, "int s = 0; for (int i = 1, 10) { s = s + i; }");
+      if (spt_opstats_opcount(L, "FORLOOP") != 10)
+        FAIL("expected exactly 10 FORLOOP after reset");
+      else
+        PASS();
+    }
+  }
+
+  /* ---- 5. 函数回收后计数块随之释放 (不崩溃), lua_close 释放 ---- */
+  TEST("proto_freed");
+  {
+    for (int r = 0; r < 20; r++)
+      luaL_dostring(L, "int f(int a) { return a + 1; } f(1);");
+    lua_gc(L, LUA_GCCOLLECT);
+    int ok = spt_opstats_dump(L, out, 5) == 0;
+    lua_close(L);
+    L = NULL;
+    if (!ok)
+      FAIL("dump after collecting protos failed");
+    else
+      PASS();
+  }
+
+  remove(out);
+
+  printf("\n=== Test Summary ===\n");
+  if (failed == 0) {
+    printf("All tests PASSED!\n");
+    return 0;
+  } else {
+    printf("%d test(s) FAILED!\n", failed);
+    return 1;
+  }
+}
@@ -0,0 +1,230 @@
+/**
+ * TestProfile.c — 验证采样 profiler (spt_profile.h)
+ *
+ * 覆盖:
+ *   - start/stop 生命周期: 重复 start 失败、stop 后可 dump
+ *   - 样本归因: folded 栈包含热点函数帧与叶子行号帧
+ *   - folded 格式: 每行 "frame;frame;... count"
+ *   - 重新 start 后样本累积
+ *   - JIT 样本归因到 [trace ...] 帧; 运行结束后不再有执行中的 trace
+ *   - lua_close 时自动停止并释放 (活跃 profiler 不泄漏定时器)
+ */
+
+#include "lauxlib.h"
+#include "lua.h"
+#include "lualib.h"
+#include "spt_jit.h"
+#include "spt_profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST(name) printf("Testing: %s... ", name)
+#define PASS() printf("PASS\n")
+#define FAIL(msg)                                                                                  \
+  do {                                                                                             \
+    printf("FAIL: %s\n", msg);                                                                     \
+    failed++;                                                                                      \
+  } while (0)
+
+static int failed = 0;
+
+static const char *busy_code = "int hot_loop(int n) {\n"
+                               "  int s = 0;\n"
+                               "  for (int i = 0, n) { s = s + i % 7; }\n"
+                               "  return s;\n"
+                               "}\n"
+                               "hot_loop(3000000);\n";
+
+/* 反复运行热点代码直到新采到至少 3 个样本 (内核定时器粒度可能到 4ms)。 */
+static int run_until_sampled(lua_State *L) {
+  SPTProfileStats st;
+  spt_profile_getstats(L, &st);
+  unsigned long long want = st.samples + 3;
+  for (int round = 0; round < 200; round++) {
+    if (luaL_dostring(L, busy_code) != LUA_OK) {
+      lua_pop(L, 1);
+      return 0;
+    }
+    spt_profile_getstats(L, &st);
+    if (st.samples >= want)
+      return 1;
+  }
+  return 0;
+}
+
+static char *read_all(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return NULL;
+  fseek(f, 0, SEEK_END);
+  long n = ftell(f);
+  rewind(f);
+  char *buf = (char *)malloc((size_t)n + 1);
+  size_t rd = fread(buf, 1, (size_t)n, f);
+  buf[rd] = '\0';
+  fclose(f);
+  return buf;
+}
+
+int main(void) {
+  const char *out = "TestProfile.folded";
+  lua_State *L = luaL_newstate();
+  luaL_openlibs(L);
+
+  printf("=== Testing sampling profiler ===\n\n");
+
+  /* ---- 1. 未启动时 dump 失败、统计为零 ---- */
+  TEST("dump_without_profile");
+  {
+    SPTProfileStats st;
+    spt_profile_getstats(L, &st);
+    if (spt_profile_dump(L, out) == 0 || st.samples != 0)
+      FAIL("dump before start should fail with empty stats");
+    else
+      PASS();
+  }
+
+  /* ---- 2. start + 重复 start ---- */
+  TEST("start_once");
+  {
+    if (!spt_profile_start(L, 200))
+      FAIL("start should succeed");
+    else if (spt_profile_start(L, 200))
+      FAIL("second start should fail while active");
+    else
+      PASS();
+  }
+
+  /* ---- 3. 采样归因到热点函数 ---- */
+  TEST("samples_attributed");
+  {
+    int ok = run_until_sampled(L);
+    spt_profile_stop(L);
+    if (!ok)
+      FAIL("no samples collected");
+    else if (spt_profile_dump(L, out) != 0)
+      FAIL("dump failed");
+    else {
+      char *text = read_all(out);
+      if (!text || !strstr(text, "hot_loop ("))
+        FAIL("hot_loop frame missing from folded output");
+      else
+        PASS();
+      free(text);
+    }
+  }
+
+  /* ---- 4. folded 格式: 每行以 " <count>" 结尾 ---- */
+  TEST("folded_format");
+  {
+    char *text = read_all(out);
+    int bad = !text || !*text;
+    for (char *line = text; !bad && line && *line;) {
+      char *nl = strchr(line, '\n');
+      if (!nl) {
+        bad = 1;
+        break;
+      }
+      *nl = '\0';
+      char *sp = strrchr(line, ' ');
+      if (!sp || atoi(sp + 1) <= 0)
+        bad = 1;
+      line = nl + 1;
+    }
+    if (bad)
+      FAIL("malformed folded line");
+    else
+      PASS();
+    free(text);
+  }
+
+  /* ---- 5. stop 后可重新 start (样本累积) ---- */
+  TEST("restart_accumulates");
+  {
+    SPTProfileStats before, after;
+    spt_profile_getstats(L, &before);
+    if (!spt_profile_start(L, 200))
+      FAIL("restart should succeed");
+    else {
+      int ok = run_until_sampled(L);
+      spt_profile_stop(L);
+      spt_profile_getstats(L, &after);
+      if (!ok || after.samples < before.samples + 3)
+        FAIL("samples should accumulate across runs");
+      else
+        PASS();
+    }
+  }
+
+  /* ---- 6. JIT 样本归因到 trace ---- */
+  TEST("jit_samples_attributed");
+  {
+    lua_State *J = luaL_newstate();
+    luaL_openlibs(J);
+    SPTJitState *js = sptjit_get_state(J);
+    SPTJitStats jst;
+    SPTProfileStats st;
+    if (!js) {
+      printf("(JIT unavailable, skipped) ");
+      PASS();
+    } else {
+      sptjit_enable(js);
+      spt_profile_start(J, 200);
+      int ok = 0;
+      for (int round = 0; round < 200 && !ok; round++) {
+        if (luaL_dostring(J, busy_code) != LUA_OK) {
+          lua_pop(J, 1);
+          break;
+        }
+        spt_profile_getstats(J, &st);
+        ok = st.jit_samples >= 3;
+      }
+      spt_profile_stop(J);
+      sptjit_get_stats(js, &jst);
+      if (jst.traces_compiled == 0) {
+        printf("(no trace compiled, skipped) ");
+        PASS();
+      } else if (!ok) {
+        FAIL("no samples landed in the compiled trace");
+      } else if (sptjit_executing(js) != NULL) {
+        FAIL("a trace is still marked as executing after the run");
+      } else if (spt_profile_dump(J, out) != 0) {
+        FAIL("dump failed");
+      } else {
+        char *text = read_all(out);
+        if (!text || !strstr(text, "hot_loop (") || !strstr(text, ";[trace "))
+          FAIL("JIT samples missing [trace ...] frame under hot_loop");
+        else
+          PASS();
+        free(text);
+      }
+    }
+    lua_close(J);
+  }
+
+  /* ---- 7. lua_close 释放活跃 profiler, 新状态可再启动 ---- */
+  TEST("close_while_active");
+  {
+    spt_profile_start(L, 200);
+    lua_close(L);
+    L = luaL_newstate();
+    if (!spt_profile_start(L, 200))
+      FAIL("profiler should be free after lua_close");
+    else
+      PASS();
+    spt_profile_stop(L);
+  }
+
+  lua_close(L);
+  remove(out);
+
+  printf("\n=== Test Summary ===\n");
+  if (failed == 0) {
+    printf("All tests PASSED!\n");
+    return 0;
+  } else {
+    printf("%d test(s) FAILED!\n", failed);
+    return 1;
+  }
+}
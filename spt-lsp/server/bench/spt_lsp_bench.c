@@ -0,0 +1,664 @@
+/*
+** spt_lsp_bench.c — LSP 会话回放基准 + 延迟回归门禁。
+**
+** 把一段会话（消息序列）逐条喂给 lsp_dispatch_write（与 lsp_run 相同的分派与序列化路径），
+** 按方法统计每条消息的耗时，输出 p50 / p95 / p99 / 最大值与进程峰值常驻内存。
+**
+** 会话来源二选一：
+**   --replay FILE  SPT_LSP_RECORD 录下的 jsonl（每行一条消息体，见 trace.h）；
+**   默认           合成会话：在临时目录生成 --files 个互相 import 的模块，打开其中
+**                  --open 个，做语义高亮 / 悬停 / 补全 / 跳转 / 引用 / 工作区符号查询，
+**                  再逐字符输入 --edits 次，每次后跟 delta 高亮与补全。
+**
+** 每轮（--reps，另有 --warmup 轮不计时）用全新的服务器实例回放整段会话。诊断按同步模式
+** 在 didOpen / didChange 内计算，计入这两个通知的耗时。semanticTokens/full/delta 的
+** previousResultId 改写为同一文档上一次高亮响应的 resultId，保证回放走增量路径。
+**
+** 给定 --baseline 时与先前输出的 JSON 按方法对比：p50 或 p95 变慢超过阈值（且绝对差超过
+** --min-ms，滤掉亚毫秒级抖动）即为回归；峰值内存增长超过阈值同样算回归。结果格式与对比
+** 规则由 spt-lang/bench/spt_bench_report.h 提供。用法见 spt-lsp-bench --help；CMake 目标
+** lsp_bench / lsp_bench_baseline / lsp_bench_check。
+*/
+#define _DEFAULT_SOURCE 1
+#define _XOPEN_SOURCE 700
+
+#include "json_writer.h"
+#include "server.h"
+#include "spt_bench_report.h"
+#include "workspace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define METHOD_MAX 128
+
+typedef struct {
+  const char *replay;
+  const char *root; /* 回放时改写 initialize 的 rootUri */
+  const char *out;
+  const char *baseline;
+  const char *save; /* 把会话写成 jsonl（可作为之后的 --replay 输入） */
+  int files, open, edits;
+  int reps, warmup;
+  double threshold; /* 百分比 */
+  double min_ms;
+  int index_cache;
+} Options;
+
+/* 一个方法的全部耗时样本。 */
+typedef struct {
+  char *method;
+  double *ms;
+  int n, cap;
+  double p50, p95, p99, max;
+} MethodStats;
+
+typedef struct {
+  cJSON **msgs;
+  int count, cap;
+} Session;
+
+/* ---- 内存 ---- */
+
+/* 进程峰值常驻内存（KiB）；不可得时返回 0。 */
+static long peak_rss_kb(void) {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS pmc;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof pmc))
+    return (long)(pmc.PeakWorkingSetSize / 1024);
+  return 0;
+#else
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) != 0)
+    return 0;
+#ifdef __APPLE__
+  return ru.ru_maxrss / 1024; /* macOS 以字节计 */
+#else
+  return ru.ru_maxrss;
+#endif
+#endif
+}
+
+/* ---- 会话 ---- */
+
+static void session_push(Session *s, cJSON *m) {
+  if (s->count >= s->cap) {
+    s->cap = s->cap ? s->cap * 2 : 256;
+    s->msgs = (cJSON **)realloc(s->msgs, sizeof(cJSON *) * (size_t)s->cap);
+  }
+  s->msgs[s->count++] = m;
+}
+
+static void session_free(Session *s) {
+  for (int i = 0; i < s->count; i++)
+    cJSON_Delete(s->msgs[i]);
+  free(s->msgs);
+  memset(s, 0, sizeof *s);
+}
+
+/* 读 SPT_LSP_RECORD 录制：每行一条消息体，空行与无法解析的行跳过。 */
+static int load_replay(const char *path, Session *s) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return 0;
+  }
+  size_t cap = 1 << 16, len = 0;
+  char *line = (char *)malloc(cap);
+  int skipped = 0, c = 0;
+  while (c != EOF) {
+    len = 0;
+    while ((c = fgetc(f)) != EOF && c != '\n') {
+      if (len + 1 >= cap)
+        line = (char *)realloc(line, cap *= 2);
+      line[len++] = (char)c;
+    }
+    line[len] = '\0';
+    if (len == 0 || (len == 1 && line[0] == '\r'))
+      continue;
+    cJSON *m = cJSON_ParseWithLength(line, len);
+    if (m && cJSON_IsObject(m))
+      session_push(s, m);
+    else {
+      cJSON_Delete(m);
+      skipped++;
+    }
+  }
+  free(line);
+  fclose(f);
+  if (skipped)
+    fprintf(stderr, "%s: %d unparseable line(s) skipped\n", path, skipped);
+  return 1;
+}
+
+/* 回放时把 initialize 的根目录改到 root（录制机器上的路径通常不存在）。 */
+static void rewrite_root(Session *s, const char *root) {
+  char uri[4200];
+  spt_path_to_uri(root, uri, sizeof uri);
+  for (int i = 0; i < s->count; i++) {
+    cJSON *m = cJSON_GetObjectItemCaseSensitive(s->msgs[i], "method");
+    cJSON *p = cJSON_GetObjectItemCaseSensitive(s->msgs[i], "params");
+    if (!cJSON_IsString(m) || strcmp(m->valuestring, "initialize") != 0 || !p)
+      continue;
+    cJSON_DeleteItemFromObjectCaseSensitive(p, "workspaceFolders");
+    cJSON_DeleteItemFromObjectCaseSensitive(p, "rootPath");
+    cJSON_DeleteItemFromObjectCaseSensitive(p, "rootUri");
+    cJSON_AddStringToObject(p, "rootUri", uri);
+  }
+}
+
+/* ---- 合成工作区 ---- */
+
+#define FNS_PER_FILE 12
+
+static char *make_temp_dir(char *out, size_t cap) {
+#ifdef _WIN32
+  char base[MAX_PATH];
+  if (!GetTempPathA(MAX_PATH, base))
+    return NULL;
+  snprintf(out, cap, "%ssptbench_%lu", base, (unsigned long)GetCurrentProcessId());
+  if (!CreateDirectoryA(out, NULL))
+    return NULL;
+#else
+  snprintf(out, cap, "/tmp/sptbench_%d", (int)getpid());
+  if (mkdir(out, 0777) != 0)
+    return NULL;
+#endif
+  return out;
+}
+
+static void remove_dir_recursive(const char *path) {
+  char cmd[4200];
+#ifdef _WIN32
+  snprintf(cmd, sizeof cmd, "rmdir /s /q \"%s\" 2>nul", path);
+#else
+  snprintf(cmd, sizeof cmd, "rm -rf %s", path);
+#endif
+  if (system(cmd) != 0) { /* best-effort */
+  }
+}
+
+/* 第 i 个模块的源码（调用方 free）。每个函数占 4 行：第 8 + 4k 行是
+   "  return helper<n>(s.area() + a);"。 */
+static char *module_text(int i, int nfiles) {
+  int n = (i + 1) % nfiles;
+  size_t cap = 4096 + FNS_PER_FILE * 160;
+  char *t = (char *)malloc(cap);
+  int w = snprintf(t, cap,
+                   "import { helper%d } from \"./mod%d\";\n"
+                   "class Shape%d {\n  int w;\n  int area() { return w * %d; }\n}\n"
+                   "int helper%d(int x) { return x + %d; }\n",
+                   n, n, i, i, i, i);
+  for (int k = 0; k < FNS_PER_FILE; k++)
+    w += snprintf(t + w, cap - (size_t)w,
+                  "int fn%d_%d(int a) {\n  Shape%d s = new Shape%d();\n"
+                  "  return helper%d(s.area() + a);\n}\n",
+                  i, k, i, i, n);
+  return t;
+}
+
+static void write_text(const char *path, const char *text) {
+  FILE *f = fopen(path, "wb");
+  if (f) {
+    fputs(text, f);
+    fclose(f);
+  }
+}
+
+/* ---- 合成会话 ---- */
+
+static cJSON *msg_new(int *id, const char *method, cJSON *params) {
+  cJSON *m = cJSON_CreateObject();
+  cJSON_AddStringToObject(m, "jsonrpc", "2.0");
+  if (id)
+    cJSON_AddNumberToObject(m, "id", (*id)++);
+  cJSON_AddStringToObject(m, "method", method);
+  if (params)
+    cJSON_AddItemToObject(m, "params", params);
+  return m;
+}
+
+static cJSON *td_params(const char *uri) {
+  cJSON *p = cJSON_CreateObject();
+  cJSON *td = cJSON_CreateObject();
+  cJSON_AddStringToObject(td, "uri", uri);
+  cJSON_AddItemToObject(p, "textDocument", td);
+  return p;
+}
+
+static cJSON *pos_params(const char *uri, int line, int ch) {
+  cJSON *p = td_params(uri);
+  cJSON *pos = cJSON_CreateObject();
+  cJSON_AddNumberToObject(pos, "line", line);
+  cJSON_AddNumberToObject(pos, "character", ch);
+  cJSON_AddItemToObject(p, "position", pos);
+  return p;
+}
+
+static cJSON *range_json(int l0, int c0, int l1, int c1) {
+  cJSON *r = cJSON_CreateObject();
+  cJSON *s = cJSON_CreateObject(), *e = cJSON_CreateObject();
+  cJSON_AddNumberToObject(s, "line", l0);
+  cJSON_AddNumberToObject(s, "character", c0);
+  cJSON_AddNumberToObject(e, "line", l1);
+  cJSON_AddNumberToObject(e, "character", c1);
+  cJSON_AddItemToObject(r, "start", s);
+  cJSON_AddItemToObject(r, "end", e);
+  return r;
+}
+
+/* 生成工作区文件并构造会话。dir 为已创建的临时目录。 */
+static void build_synthetic(Session *s, const char *dir, const Options *o) {
+  int id = 1;
+  char path[4200], uri[4400];
+  for (int i = 0; i < o->files; i++) {
+    snprintf(path, sizeof path, "%s/mod%d.spt", dir, i);
+    char *t = module_text(i, o->files);
+    write_text(path, t);
+    free(t);
+  }
+  spt_path_to_uri(dir, uri, sizeof uri);
+  cJSON *ip = cJSON_CreateObject();
+  cJSON_AddStringToObject(ip, "rootUri", uri);
+  session_push(s, msg_new(&id, "initialize", ip));
+  session_push(s, msg_new(NULL, "initialized", cJSON_CreateObject()));
+
+  int nopen = o->open < o->files ? o->open : o->files;
+  for (int i = 0; i < nopen; i++) {
+    snprintf(path, sizeof path, "%s/mod%d.spt", dir, i);
+    spt_path_to_uri(path, uri, sizeof uri);
+    char *text = module_text(i, o->files);
+    cJSON *p = td_params(uri);
+    cJSON *td = cJSON_GetObjectItemCaseSensitive(p, "textDocument");
+    cJSON_AddStringToObject(td, "languageId", "sptscript");
+    cJSON_AddNumberToObject(td, "version", 1);
+    cJSON_AddStringToObject(td, "text", text);
+    free(text);
+    session_push(s, msg_new(NULL, "textDocument/didOpen", p));
+    session_push(s, msg_new(&id, "textDocument/semanticTokens/full", td_params(uri)));
+    session_push(s, msg_new(&id, "textDocument/documentSymbol", td_params(uri)));
+    session_push(s, msg_new(&id, "textDocument/foldingRange", td_params(uri)));
+    session_push(s, msg_new(&id, "textDocument/inlayHint", td_params(uri)));
+    /* 第 7 行 "  Shape<i> s = ..."、第 8 行 "  return helper<n>(s.area() + a);"：
+       悬停 / 跳转 helper 调用，高亮 Shape，在 "s." 之后补全。 */
+    session_push(s, msg_new(&id, "textDocument/hover", pos_params(uri, 8, 11)));
+    session_push(s, msg_new(&id, "textDocument/definition", pos_params(uri, 8, 11)));
+    session_push(s, msg_new(&id, "textDocument/documentHighlight", pos_params(uri, 7, 4)));
+    cJSON *rp = pos_params(uri, 5, 6);
+    cJSON *ctx = cJSON_CreateObject();
+    cJSON_AddBoolToObject(ctx, "includeDeclaration", 1);
+    cJSON_AddItemToObject(rp, "context", ctx);
+    session_push(s, msg_new(&id, "textDocument/references", rp));
+    int after_dot = (int)strlen("  return helper(s.") + snprintf(NULL, 0, "%d", (i + 1) % o->files);
+    session_push(s, msg_new(&id, "textDocument/completion", pos_params(uri, 8, after_dot)));
+  }
+  const char *queries[] = {"", "Shape", "helper1", "fn"};
+  for (size_t q = 0; q < sizeof queries / sizeof queries[0]; q++) {
+    cJSON *p = cJSON_CreateObject();
+    cJSON_AddStringToObject(p, "query", queries[q]);
+    session_push(s, msg_new(&id, "workspace/symbol", p));
+  }
+
+  /* 在 mod0 第 5 行末逐字符输入注释，每次后跟 delta 高亮与补全。 */
+  if (nopen > 0) {
+    snprintf(path, sizeof path, "%s/mod0.spt", dir);
+    spt_path_to_uri(path, uri, sizeof uri);
+    int col = (int)strlen("int helper0(int x) { return x + 0; }");
+    const char *typed = " // typing a comment";
+    for (int e = 0; e < o->edits; e++) {
+      char ch[2] = {typed[e % (int)strlen(typed)], '\0'};
+      cJSON *p = td_params(uri);
+      cJSON_AddNumberToObject(cJSON_GetObjectItemCaseSensitive(p, "textDocument"), "version",
+                              e + 2);
+      cJSON *changes = cJSON_CreateArray();
+      cJSON *c = cJSON_CreateObject();
+      cJSON_AddItemToObject(c, "range", range_json(5, col + e, 5, col + e));
+      cJSON_AddStringToObject(c, "text", ch);
+      cJSON_AddItemToArray(changes, c);
+      cJSON_AddItemToObject(p, "contentChanges", changes);
+      session_push(s, msg_new(NULL, "textDocument/didChange", p));
+      cJSON *dp = td_params(uri);
+      cJSON_AddStringToObject(dp, "previousResultId", "");
+      session_push(s, msg_new(&id, "textDocument/semanticTokens/full/delta", dp));
+      session_push(s, msg_new(&id, "textDocument/completion", pos_params(uri, 8, 4)));
+    }
+    cJSON *rp = pos_params(uri, 5, 6);
+    cJSON_AddStringToObject(rp, "newName", "helperRenamed");
+    session_push(s, msg_new(&id, "textDocument/rename", rp));
+    session_push(s, msg_new(&id, "textDocument/formatting", td_params(uri)));
+  }
+  for (int i = 0; i < nopen; i++) {
+    snprintf(path, sizeof path, "%s/mod%d.spt", dir, i);
+    spt_path_to_uri(path, uri, sizeof uri);
+    session_push(s, msg_new(NULL, "textDocument/didClose", td_params(uri)));
+  }
+  session_push(s, msg_new(&id, "shutdown", NULL));
+  session_push(s, msg_new(NULL, "exit", NULL));
+}
+
+/* ---- 统计 ---- */
+
+static MethodStats *stats_for(MethodStats *st, int *n, const char *method) {
+  for (int i = 0; i < *n; i++)
+    if (strcmp(st[i].method, method) == 0)
+      return &st[i];
+  if (*n >= METHOD_MAX)
+    return NULL;
+  MethodStats *m = &st[(*n)++];
+  memset(m, 0, sizeof *m);
+  size_t len = strlen(method);
+  m->method = (char *)malloc(len + 1);
+  memcpy(m->method, method, len + 1);
+  return m;
+}
+
+static void stats_add(MethodStats *m, double ms) {
+  if (m->n >= m->cap) {
+    m->cap = m->cap ? m->cap * 2 : 64;
+    m->ms = (double *)realloc(m->ms, sizeof(double) * (size_t)m->cap);
+  }
+  m->ms[m->n++] = ms;
+}
+
+static void stats_finish(MethodStats *m) {
+  bench_sort(m->ms, m->n);
+  m->p50 = bench_percentile(m->ms, m->n, 0.50);
+  m->p95 = bench_percentile(m->ms, m->n, 0.95);
+  m->p99 = bench_percentile(m->ms, m->n, 0.99);
+  m->max = m->ms[m->n - 1];
+}
+
+/* ---- 回放 ---- */
+
+static void discard_emit(void *ctx, cJSON *msg) {
+  (void)ctx;
+  cJSON_Delete(msg);
+}
+
+/* 每个打开文档最近一次语义高亮响应的 resultId。 */
+typedef struct {
+  char uri[4400];
+  char result_id[64];
+} LastResult;
+
+static void remember_result_id(LastResult *lr, int *nlr, const char *uri, const JsonWriter *w) {
+  cJSON *resp = jw_parse(w);
+  cJSON *res = cJSON_GetObjectItemCaseSensitive(resp, "result");
+  cJSON *rid = cJSON_GetObjectItemCaseSensitive(res, "resultId");
+  if (cJSON_IsString(rid)) {
+    int i = 0;
+    while (i < *nlr && strcmp(lr[i].uri, uri) != 0)
+      i++;
+    if (i == *nlr && *nlr < 256) {
+      snprintf(lr[i].uri, sizeof lr[i].uri, "%s", uri);
+      (*nlr)++;
+    }
+    if (i < 256)
+      snprintf(lr[i].result_id, sizeof lr[i].result_id, "%s", rid->valuestring);
+  }
+  cJSON_Delete(resp);
+}
+
+static void patch_previous_id(cJSON *params, const LastResult *lr, int nlr, const char *uri) {
+  for (int i = 0; i < nlr; i++)
+    if (strcmp(lr[i].uri, uri) == 0) {
+      cJSON_DeleteItemFromObjectCaseSensitive(params, "previousResultId");
+      cJSON_AddStringToObject(params, "previousResultId", lr[i].result_id);
+      return;
+    }
+}
+
+/* 用全新的服务器回放一遍会话；record 时把每条消息的耗时计入 st。 */
+static void replay_once(const Session *s, const Options *o, int record, MethodStats *st, int *nst) {
+  LspServer srv;
+  lsp_server_init(&srv);
+  lsp_server_set_emit(&srv, discard_emit, NULL);
+  JsonWriter w;
+  jw_init(&w);
+  static LastResult lr[256];
+  int nlr = 0;
+  for (int i = 0; i < s->count && !srv.should_exit; i++) {
+    cJSON *m = s->msgs[i];
+    cJSON *method = cJSON_GetObjectItemCaseSensitive(m, "method");
+    const char *name = cJSON_IsString(method) ? method->valuestring : "(response)";
+    cJSON *params = cJSON_GetObjectItemCaseSensitive(m, "params");
+    cJSON *td = cJSON_GetObjectItemCaseSensitive(params, "textDocument");
+    cJSON *uri = cJSON_GetObjectItemCaseSensitive(td, "uri");
+    int semtok = strncmp(name, "textDocument/semanticTokens/full", 32) == 0;
+    if (semtok && name[32] == '/' && cJSON_IsString(uri))
+      patch_previous_id(params, lr, nlr, uri->valuestring);
+
+    jw_reset(&w);
+    double t0 = bench_now_ms();
+    if (lsp_dispatch_write(&srv, m, &w))
+      jw_frame(&w, NULL);
+    double t1 = bench_now_ms();
+
+    if (record) {
+      MethodStats *ms = stats_for(st, nst, name);
+      if (ms)
+        stats_add(ms, t1 - t0);
+    }
+    if (semtok && cJSON_IsString(uri))
+      remember_result_id(lr, &nlr, uri->valuestring, &w);
+    /* 录制里的根目录往往不可写或不属于本机：默认不读写磁盘索引缓存，每轮都冷启动。 */
+    if (!o->index_cache && strcmp(name, "initialize") == 0)
+      workspace_set_index_cache(&srv.ws, NULL);
+  }
+  jw_free(&w);
+  lsp_server_free(&srv);
+}
+
+/* ---- JSON 输出 / 基线 ---- */
+
+static const char *session_name(const Options *o) { return o->replay ? o->replay : "synthetic"; }
+
+#define METHOD_FIELDS 6
+
+static void write_json(FILE *f, const Options *o, int messages, long rss_kb, const MethodStats *st,
+                       int n) {
+  BenchField head[] = {{"session", session_name(o), 0, 0},  {"messages", NULL, messages, 0},
+                       {"reps", NULL, o->reps, 0},          {"warmup", NULL, o->warmup, 0},
+                       {"peak_rss_kb", NULL, (double)rss_kb, 0}};
+  BenchField *rows = (BenchField *)malloc(sizeof(BenchField) * METHOD_FIELDS * (size_t)(n ? n : 1));
+  if (!rows)
+    return;
+  for (int i = 0; i < n; i++) {
+    BenchField *fd = &rows[i * METHOD_FIELDS];
+    fd[0] = (BenchField){"method", st[i].method, 0, 0};
+    fd[1] = (BenchField){"count", NULL, st[i].n, 0};
+    fd[2] = (BenchField){"p50_ms", NULL, st[i].p50, 4};
+    fd[3] = (BenchField){"p95_ms", NULL, st[i].p95, 4};
+    fd[4] = (BenchField){"p99_ms", NULL, st[i].p99, 4};
+    fd[5] = (BenchField){"max_ms", NULL, st[i].max, 4};
+  }
+  bench_write_json(f, head, 5, "methods", rows, n, METHOD_FIELDS);
+  free(rows);
+}
+
+/* 逐方法对比 p50 / p95，再对比峰值内存；返回回归条数。 */
+static int compare_baseline(const BenchBaseline *b, const Options *o, long rss_kb,
+                            const MethodStats *st, int n) {
+  static const char *const keys[] = {"p50_ms", "p95_ms"};
+  BenchCompare c;
+  bench_compare_begin(&c, "method (ms)", o->threshold, o->min_ms);
+  for (int i = 0; i < n; i++) {
+    BenchField match = {"method", st[i].method, 0, 0};
+    const char *line = bench_baseline_find(b, &match, 1);
+    for (int k = 0; k < 2; k++) {
+      char label[METHOD_MAX * 2];
+      double base = -1;
+      if (!bench_baseline_num(line, keys[k], &base))
+        base = -1;
+      snprintf(label, sizeof label, "%s %.3s", st[i].method, keys[k]);
+      bench_compare_row(&c, label, base, k ? st[i].p95 : st[i].p50);
+    }
+  }
+  double base_rss;
+  if (bench_baseline_head(b, "peak_rss_kb", &base_rss) && base_rss > 0)
+    bench_compare_row(&c, "peak rss (KiB)", base_rss, (double)rss_kb);
+  return bench_compare_end(&c);
+}
+
+/* ---- 命令行 ---- */
+
+static void print_help(const char *prog) {
+  printf("Usage: %s [options]\n", prog);
+  printf("Session (default: synthetic):\n");
+  printf("  --replay FILE     replay a SPT_LSP_RECORD jsonl recording\n");
+  printf("  --root DIR        rewrite the replayed initialize rootUri to DIR\n");
+  printf("  --files N         synthetic workspace size in modules (default 200)\n");
+  printf("  --open N          synthetic documents opened and queried (default 20)\n");
+  printf("  --edits N         synthetic keystrokes, each followed by delta tokens (default 50)\n");
+  printf("  --save FILE       write the session as jsonl (usable with --replay)\n");
+  printf("Measurement:\n");
+  printf("  --reps N          timed replays, each on a fresh server (default 5)\n");
+  printf("  --warmup N        untimed replays first (default 1)\n");
+  printf("  --index-cache     keep the on-disk workspace index cache (default off)\n");
+  printf("  --out FILE        write JSON results to FILE (default stdout)\n");
+  printf("  --baseline FILE   compare p50/p95 and peak rss against a previous JSON result\n");
+  printf("  --threshold P     regression threshold in percent (default 20)\n");
+  printf("  --min-ms X        ignore latency deltas below X ms (default 0.05)\n");
+  printf("Exit status: 0 ok, 1 regression against the baseline,\n");
+  printf("             2 error (including a missing or unreadable baseline).\n");
+}
+
+int main(int argc, char *argv[]) {
+  Options o;
+  memset(&o, 0, sizeof o);
+  o.files = 200;
+  o.open = 20;
+  o.edits = 50;
+  o.reps = 5;
+  o.warmup = 1;
+  o.threshold = 20.0;
+  o.min_ms = 0.05;
+  for (int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+    if (strcmp(a, "--help") == 0 || strcmp(a, "-h") == 0) {
+      print_help(argv[0]);
+      return 0;
+    } else if (strcmp(a, "--index-cache") == 0)
+      o.index_cache = 1;
+    else if (v && strcmp(a, "--replay") == 0)
+      o.replay = argv[++i];
+    else if (v && strcmp(a, "--root") == 0)
+      o.root = argv[++i];
+    else if (v && strcmp(a, "--files") == 0)
+      o.files = atoi(argv[++i]);
+    else if (v && strcmp(a, "--open") == 0)
+      o.open = atoi(argv[++i]);
+    else if (v && strcmp(a, "--edits") == 0)
+      o.edits = atoi(argv[++i]);
+    else if (v && strcmp(a, "--save") == 0)
+      o.save = argv[++i];
+    else if (v && strcmp(a, "--reps") == 0)
+      o.reps = atoi(argv[++i]);
+    else if (v && strcmp(a, "--warmup") == 0)
+      o.warmup = atoi(argv[++i]);
+    else if (v && strcmp(a, "--out") == 0)
+      o.out = argv[++i];
+    else if (v && strcmp(a, "--baseline") == 0)
+      o.baseline = argv[++i];
+    else if (v && strcmp(a, "--threshold") == 0)
+      o.threshold = atof(argv[++i]);
+    else if (v && strcmp(a, "--min-ms") == 0)
+      o.min_ms = atof(argv[++i]);
+    else {
+      fprintf(stderr, "unknown option '%s' (see --help)\n", a);
+      return 2;
+    }
+  }
+  if (o.reps < 1 || o.warmup < 0 || o.files < 1 || o.open < 0 || o.edits < 0) {
+    fprintf(stderr, "--reps/--files must be >= 1, --warmup/--open/--edits >= 0\n");
+    return 2;
+  }
+
+  /* 基线先读：缺失时不必跑完回放才失败。 */
+  BenchBaseline base;
+  if (o.baseline && bench_baseline_load(&base, o.baseline, "lsp_bench_baseline") != 0)
+    return 2;
+
+  Session s;
+  memset(&s, 0, sizeof s);
+  char tmpl[4096];
+  char *dir = NULL;
+  if (o.replay) {
+    if (!load_replay(o.replay, &s))
+      return 2;
+    if (o.root)
+      rewrite_root(&s, o.root);
+  } else {
+    dir = make_temp_dir(tmpl, sizeof tmpl);
+    if (!dir) {
+      fprintf(stderr, "cannot create a temporary workspace\n");
+      return 2;
+    }
+    build_synthetic(&s, dir, &o);
+  }
+  if (o.save) {
+    FILE *f = fopen(o.save, "wb");
+    for (int i = 0; f && i < s.count; i++) {
+      char *j = cJSON_PrintUnformatted(s.msgs[i]);
+      fprintf(f, "%s\n", j ? j : "");
+      free(j);
+    }
+    if (f)
+      fclose(f);
+    else
+      fprintf(stderr, "cannot write %s\n", o.save);
+  }
+  fprintf(stderr, "%s: %d message(s), %d warmup + %d timed replay(s)\n", session_name(&o),
+          s.count, o.warmup, o.reps);
+
+  static MethodStats st[METHOD_MAX];
+  int nst = 0;
+  for (int r = 0; r < o.warmup + o.reps; r++)
+    replay_once(&s, &o, r >= o.warmup, st, &nst);
+  long rss = peak_rss_kb();
+  for (int i = 0; i < nst; i++) {
+    stats_finish(&st[i]);
+    fprintf(stderr, "%-40s n %6d  p50 %9.4f ms  p95 %9.4f ms  max %9.4f ms\n", st[i].method,
+            st[i].n, st[i].p50, st[i].p95, st[i].max);
+  }
+  fprintf(stderr, "peak rss %ld KiB\n", rss);
+
+  int rc = 0;
+  FILE *out = stdout;
+  if (o.out && !(out = fopen(o.out, "w"))) {
+    fprintf(stderr, "cannot write %s\n", o.out);
+    rc = 2;
+  } else {
+    write_json(out, &o, s.count, rss, st, nst);
+    if (out != stdout)
+      fclose(out);
+  }
+  if (o.baseline) {
+    int regressions = compare_baseline(&base, &o, rss, st, nst);
+    bench_baseline_free(&base);
+    if (rc == 0)
+      rc = regressions > 0;
+  }
+
+  for (int i = 0; i < nst; i++) {
+    free(st[i].method);
+    free(st[i].ms);
+  }
+  session_free(&s);
+  if (dir)
+    remove_dir_recursive(dir);
+  return rc;
+}
@@ -0,0 +1,123 @@
+/*
+** doc_cache.c — 按文档版本缓存解析单元与语义索引。
+*/
+#include "doc_cache.h"
+
+#include "spt_thread.h"
+
+#include <stdlib.h>
+
+/* 持有 unit 的缓存链表：semantic.c 只拿到 unit 时据此找回索引。
+   打开文档数很少，线性查找足够。线程局部：后台诊断线程的临时文档只在本线程可见。 */
+static SPT_THREAD_LOCAL DocCache *g_live = NULL;
+
+static void live_unlink(DocCache *c) {
+  for (DocCache **pp = &g_live; *pp; pp = &(*pp)->next) {
+    if (*pp == c) {
+      *pp = c->next;
+      break;
+    }
+  }
+  c->next = NULL;
+}
+
+DocCache *doc_cache_new(void) { return (DocCache *)calloc(1, sizeof(DocCache)); }
+
+void doc_cache_reset(DocCache *c) {
+  if (!c)
+    return;
+  if (c->unit)
+    live_unlink(c);
+  sem_index_free(c->index);
+  spt_lsp_unit_free(c->unit);
+  c->index = NULL;
+  c->unit = NULL;
+  c->text_gen = 0;
+  c->version = 0;
+  c->pending = 0;
+  c->last_from_gen = 0;
+}
+
+void doc_cache_note_edit(DocCache *c, size_t start, size_t old_end, size_t repl_len) {
+  if (!c || !c->unit)
+    return;
+  if (!c->pending) {
+    c->pending = 1;
+    c->start = start;
+    c->old_end = old_end;
+    c->new_end = start + repl_len;
+    return;
+  }
+  /* 与已有编辑合并：当前文本 = 单元源码在 [c->start, c->old_end) 处被改为 [c->start, c->new_end)。
+     新编辑之后不变的后缀起点（当前文本坐标）为 max(c->new_end, old_end)。 */
+  size_t tail = c->new_end > old_end ? c->new_end : old_end;
+  size_t unit_tail = tail - c->new_end + c->old_end;
+  if (start < c->start)
+    c->start = start;
+  c->old_end = unit_tail;
+  c->new_end = tail - old_end + start + repl_len;
+}
+
+void doc_cache_free(DocCache *c) {
+  doc_cache_reset(c);
+  free(c);
+}
+
+const SptLspUnit *doc_unit(const Document *d) {
+  DocCache *c = d ? d->cache : NULL;
+  if (!c)
+    return NULL;
+  if (c->unit && c->version == d->version && c->text_gen == d->text_gen)
+    return c->unit;
+  if (c->unit && c->pending) {
+    SptLspReparse r;
+    SptLspUnit *nu = spt_lsp_reparse(c->unit, doc_text(d), d->text_len, c->start, c->old_end,
+                                     c->new_end, &r);
+    if (nu) {
+      /* 旧单元已被 nu 接管（同一 arena），索引就地修补而非重建。 */
+      c->unit = nu;
+      if (c->index)
+        sem_index_patch(c->index, nu->root, r.first_stmt, r.old_stmts, r.new_stmts);
+      c->version = d->version;
+      c->text_gen = d->text_gen;
+      c->pending = 0;
+      c->last = r;
+      c->last_from_gen = c->gen++;
+      c->parses++;
+      c->reparses++;
+      return c->unit;
+    }
+  }
+  doc_cache_reset(c);
+  c->unit = spt_lsp_parse(doc_text(d), d->text_len);
+  c->version = d->version;
+  c->text_gen = d->text_gen;
+  c->gen++;
+  c->parses++;
+  if (c->unit) {
+    c->next = g_live;
+    g_live = c;
+  }
+  return c->unit;
+}
+
+static SemIndex *cache_index(DocCache *c) {
+  if (!c->index && c->unit && c->unit->root)
+    c->index = sem_index_build(c->unit->root);
+  return c->index;
+}
+
+SemIndex *doc_index(const Document *d) {
+  if (!doc_unit(d))
+    return NULL;
+  return cache_index(d->cache);
+}
+
+SemIndex *doc_cache_index_for(const SptLspUnit *u) {
+  if (!u)
+    return NULL;
+  for (DocCache *c = g_live; c; c = c->next)
+    if (c->unit == u)
+      return cache_index(c);
+  return NULL;
+}
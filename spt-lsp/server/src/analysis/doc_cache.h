@@ -0,0 +1,68 @@
+/*
+** doc_cache.h — 按文档版本缓存的分析结果（解析单元 + 语义索引）。
+**
+** 编辑器每次按键常连续发出 hover / semanticTokens / inlayHint / codeAction 等请求，
+** 它们针对的是同一版本的文本。每个打开文档挂一个 DocCache，键为 (uri, version)：
+** uri 由所属 Document 隐含，version 与文本代数（text_gen）同时匹配才算命中。
+**
+**   - unit：spt_lsp_parse 的结果，含 AST、诊断与 token 数组（tokens/token_count）；
+**   - index：sem_index_build 的文件级符号哈希，首次查询时惰性构建。
+**
+** 生命周期：全量文本变化（didChange 全量、didOpen 覆盖）或关闭时由 documents.c
+** 调用 doc_cache_reset 释放；provider 只借用，不得释放返回的 unit。
+** 缓存只在创建它的线程上使用（主线程的打开文档；后台诊断线程的临时快照），
+** 同一 dispatch 内借用的指针始终有效。
+**
+** 增量编辑（didChange 带 range）不清空缓存，而是经 doc_cache_note_edit 记下相对缓存单元的
+** 待合并编辑区间；下次 doc_unit 时先尝试 spt_lsp_reparse 只重解析包围编辑的顶层语句并修补
+** 索引（sem_index_patch），边界不可靠时回退全量解析。last 记录最近一次增量重解析的区间，
+** 供工作区引用索引按同一区间修补（gen / last_from_gen 校验它确实衔接工作区已索引的单元）。
+*/
+#ifndef SPT_LSP_DOC_CACHE_H
+#define SPT_LSP_DOC_CACHE_H
+
+#include "documents.h"
+#include "sem_index.h"
+#include "spt_lsp_bridge.h"
+
+typedef struct DocCache {
+  int version;           /* 缓存对应的文档版本 */
+  unsigned text_gen;     /* 缓存对应的文本代数（防同版本替换文本） */
+  SptLspUnit *unit;      /* 拥有；NULL = 未解析 */
+  SemIndex *index;       /* 拥有；NULL = 未构建（或 unit 无根） */
+  unsigned parses;       /* 该文档累计解析次数（测试/诊断用） */
+  unsigned reparses;     /* 其中增量重解析的次数 */
+  struct DocCache *next; /* 活跃缓存链表（供 doc_cache_index_for 反查） */
+
+  /* 待合并的增量编辑：unit->source 的 [start, old_end) 对应当前文本的 [start, new_end)。 */
+  int pending;
+  size_t start, old_end, new_end;
+
+  unsigned gen;           /* unit 代数：每次（全量或增量）产出新单元时递增 */
+  unsigned last_from_gen; /* last 描述的是从该代单元到当前单元的变化；0 = 无（全量解析） */
+  SptLspReparse last;     /* 最近一次增量重解析的区间（字节偏移、语句与 token 下标） */
+  unsigned ws_gen;        /* 工作区引用索引已反映的单元代数（workspace.c 维护） */
+} DocCache;
+
+/* 分配一个空缓存（doc_store_open 调用）。 */
+DocCache *doc_cache_new(void);
+/* 释放缓存内容（unit + index），保留 DocCache 本体以便复用。c 可为 NULL。 */
+void doc_cache_reset(DocCache *c);
+/* 释放缓存及其本体。c 可为 NULL。 */
+void doc_cache_free(DocCache *c);
+
+/* 记录一次增量编辑：当前文本的 [start, old_end) 被替换为 repl_len 字节（均为规范化后字节）。
+   与尚未消费的编辑合并为一个相对缓存单元的区间；无缓存单元时无事可做。c 可为 NULL。 */
+void doc_cache_note_edit(DocCache *c, size_t start, size_t old_end, size_t repl_len);
+
+/* 当前版本的解析单元；未命中时（增量或全量）解析并缓存。d 无缓存（非 DocStore 创建）时返回 NULL。 */
+const SptLspUnit *doc_unit(const Document *d);
+
+/* 当前版本的语义索引；未命中时惰性构建。无 AST 时返回 NULL。 */
+SemIndex *doc_index(const Document *d);
+
+/* 反查：u 若为某个文档缓存的单元，返回其语义索引（必要时构建），否则 NULL。
+   供 semantic.c 在只拿到 unit 的查询里复用文档缓存的索引。 */
+SemIndex *doc_cache_index_for(const SptLspUnit *u);
+
+#endif /* SPT_LSP_DOC_CACHE_H */
@@ -0,0 +1,410 @@
+/*
+** index_store.c — 逐文件索引事实 + 磁盘缓存实现。
+*/
+#include "index_store.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* 缓存文件头：魔数同时校验字节序；版本号在格式或提取规则变化时递增。 */
+#define STORE_MAGIC 0x58444953u /* "SIDX" */
+#define STORE_VERSION 1u
+
+static unsigned str_hash(const char *s, size_t n) {
+  unsigned h = 5381;
+  for (size_t i = 0; i < n; i++)
+    h = h * 33 + (unsigned char)s[i];
+  return h;
+}
+
+/* ---- FileFacts ---- */
+
+void facts_free(FileFacts *f) {
+  free(f->path);
+  free(f->pool);
+  free(f->syms);
+  free(f->refs);
+  free(f->imports);
+  free(f->name_cache);
+  memset(f, 0, sizeof *f);
+}
+
+const char *facts_at(const FileFacts *f, unsigned off) {
+  return off == FACT_NONE ? NULL : f->pool + off;
+}
+
+unsigned facts_str(FileFacts *f, const char *s, size_t n) {
+  if (f->pool_len + n + 1 > f->pool_cap) {
+    unsigned nc = f->pool_cap ? f->pool_cap : 256;
+    while (f->pool_len + n + 1 > nc)
+      nc *= 2;
+    char *np = (char *)realloc(f->pool, nc);
+    if (!np)
+      return FACT_NONE;
+    f->pool = np;
+    f->pool_cap = nc;
+  }
+  unsigned off = f->pool_len;
+  memcpy(f->pool + off, s, n);
+  f->pool[off + n] = '\0';
+  f->pool_len += (unsigned)n + 1;
+  return off;
+}
+
+/* 同一文件里标识符高度重复：引用名经一张小的直接映射表复用池偏移（冲突即新存一份，
+   不追求完全去重）。表为提取期的临时结构，facts_seal 释放。 */
+#define NAME_CACHE 256
+
+static unsigned facts_name(FileFacts *f, const char *s, size_t n) {
+  if (!f->name_cache)
+    f->name_cache = (unsigned *)calloc(2 * NAME_CACHE, sizeof(unsigned));
+  if (!f->name_cache)
+    return facts_str(f, s, n);
+  unsigned h = str_hash(s, n);
+  unsigned *slot = &f->name_cache[2 * (h & (NAME_CACHE - 1))]; /* [哈希, 偏移 + 1] */
+  if (slot[1] != 0 && slot[0] == h) {
+    const char *p = f->pool + slot[1] - 1;
+    if (strncmp(p, s, n) == 0 && p[n] == '\0')
+      return slot[1] - 1;
+  }
+  unsigned off = facts_str(f, s, n);
+  if (off != FACT_NONE) {
+    slot[0] = h;
+    slot[1] = off + 1;
+  }
+  return off;
+}
+
+void facts_seal(FileFacts *f) {
+  free(f->name_cache);
+  f->name_cache = NULL;
+}
+
+void facts_add_sym(FileFacts *f, const char *name, int kind, LspRange r, const char *container) {
+  if (!name)
+    return;
+  if (f->sym_count >= f->sym_cap) {
+    int nc = f->sym_cap ? f->sym_cap * 2 : 16;
+    FactSym *ns = (FactSym *)realloc(f->syms, sizeof(FactSym) * (size_t)nc);
+    if (!ns)
+      return;
+    f->syms = ns;
+    f->sym_cap = nc;
+  }
+  FactSym *s = &f->syms[f->sym_count++];
+  s->name = facts_name(f, name, strlen(name));
+  s->kind = kind;
+  s->range = r;
+  s->container = container ? facts_str(f, container, strlen(container)) : FACT_NONE;
+}
+
+void facts_add_ref(FileFacts *f, const char *name, size_t n, size_t offset, int length) {
+  if (f->ref_count >= f->ref_cap) {
+    int nc = f->ref_cap ? f->ref_cap * 2 : 64;
+    FactRef *nr = (FactRef *)realloc(f->refs, sizeof(FactRef) * (size_t)nc);
+    if (!nr)
+      return;
+    f->refs = nr;
+    f->ref_cap = nc;
+  }
+  FactRef *r = &f->refs[f->ref_count++];
+  r->name = facts_name(f, name, n);
+  r->offset = (unsigned)offset;
+  r->length = length;
+}
+
+void facts_add_import(FileFacts *f, const char *module_path) {
+  if (!module_path)
+    return;
+  if (f->imp_count >= f->imp_cap) {
+    int nc = f->imp_cap ? f->imp_cap * 2 : 4;
+    unsigned *ni = (unsigned *)realloc(f->imports, sizeof(unsigned) * (size_t)nc);
+    if (!ni)
+      return;
+    f->imports = ni;
+    f->imp_cap = nc;
+  }
+  f->imports[f->imp_count++] = facts_str(f, module_path, strlen(module_path));
+}
+
+unsigned long long facts_hash(const char *data, size_t len) {
+  unsigned long long h = 1469598103934665603ull;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (unsigned char)data[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+/* ---- FactTable ---- */
+
+void fact_table_init(FactTable *t) { memset(t, 0, sizeof *t); }
+
+void fact_table_free(FactTable *t) {
+  for (int i = 0; i < t->count; i++)
+    facts_free(&t->files[i]);
+  free(t->files);
+  free(t->slots);
+  memset(t, 0, sizeof *t);
+}
+
+static int *table_slot(const FactTable *t, const char *path) {
+  unsigned k = str_hash(path, strlen(path)) & (unsigned)(t->slot_cap - 1);
+  /* 被移走的条目 path 为 NULL（见 workspace_index），视为不匹配继续探测。 */
+  while (t->slots[k] && (!t->files[t->slots[k] - 1].path ||
+                         strcmp(t->files[t->slots[k] - 1].path, path) != 0))
+    k = (k + 1) & (unsigned)(t->slot_cap - 1);
+  return &t->slots[k];
+}
+
+FileFacts *fact_table_get(const FactTable *t, const char *path) {
+  if (!t->slot_cap || !path)
+    return NULL;
+  int s = *table_slot(t, path);
+  return s ? &t->files[s - 1] : NULL;
+}
+
+static int table_rehash(FactTable *t, int cap) {
+  int *ns = (int *)calloc((size_t)cap, sizeof(int));
+  if (!ns)
+    return 0;
+  free(t->slots);
+  t->slots = ns;
+  t->slot_cap = cap;
+  for (int i = 0; i < t->count; i++)
+    *table_slot(t, t->files[i].path) = i + 1;
+  return 1;
+}
+
+void fact_table_put(FactTable *t, FileFacts *f) {
+  if (!f->path)
+    return;
+  facts_seal(f);
+  FileFacts *old = fact_table_get(t, f->path);
+  if (old) {
+    facts_free(old);
+    *old = *f;
+    memset(f, 0, sizeof *f);
+    return;
+  }
+  if ((t->count + 1) * 2 > t->slot_cap && !table_rehash(t, t->slot_cap ? t->slot_cap * 2 : 64))
+    return;
+  if (t->count >= t->cap) {
+    int nc = t->cap ? t->cap * 2 : 64;
+    FileFacts *nf = (FileFacts *)realloc(t->files, sizeof(FileFacts) * (size_t)nc);
+    if (!nf)
+      return;
+    t->files = nf;
+    t->cap = nc;
+  }
+  t->files[t->count] = *f;
+  memset(f, 0, sizeof *f);
+  t->count++;
+  *table_slot(t, t->files[t->count - 1].path) = t->count;
+}
+
+/* ---- 磁盘缓存 ----
+** 头：magic, version, sizeof(FactSym), sizeof(FactRef), 文件数（均为 u32）。
+** 每个文件：路径（u32 长度 + 字节）、mtime（i64）、size、hash（u64）、
+**           池（u32 长度 + 字节）、符号 / 引用 / import 数组（u32 个数 + 原样数组）。
+** 尾：除自身外全部字节的 facts_hash（u64），读入时先校验，任何位损坏都整体丢弃。
+** 整个文件在内存中拼好 / 读入后再解析，避免逐字段 I/O。 */
+
+typedef struct {
+  char *p;
+  size_t len, cap;
+  int oom;
+} Buf;
+
+static void buf_put(Buf *b, const void *data, size_t n) {
+  if (b->oom || n == 0)
+    return;
+  if (b->len + n > b->cap) {
+    size_t nc = b->cap ? b->cap : 4096;
+    while (b->len + n > nc)
+      nc *= 2;
+    char *np = (char *)realloc(b->p, nc);
+    if (!np) {
+      b->oom = 1;
+      return;
+    }
+    b->p = np;
+    b->cap = nc;
+  }
+  memcpy(b->p + b->len, data, n);
+  b->len += n;
+}
+
+static void buf_u32(Buf *b, unsigned v) { buf_put(b, &v, sizeof v); }
+
+static void buf_arr(Buf *b, const void *p, unsigned count, size_t elem) {
+  buf_u32(b, count);
+  buf_put(b, p, elem * count);
+}
+
+int fact_table_save(const FactTable *t, const char *path) {
+  Buf b = {0};
+  buf_u32(&b, STORE_MAGIC);
+  buf_u32(&b, STORE_VERSION);
+  buf_u32(&b, (unsigned)sizeof(FactSym));
+  buf_u32(&b, (unsigned)sizeof(FactRef));
+  buf_u32(&b, (unsigned)t->count);
+  for (int i = 0; i < t->count; i++) {
+    const FileFacts *x = &t->files[i];
+    buf_arr(&b, x->path, (unsigned)strlen(x->path), 1);
+    buf_put(&b, &x->mtime, sizeof x->mtime);
+    buf_put(&b, &x->size, sizeof x->size);
+    buf_put(&b, &x->hash, sizeof x->hash);
+    buf_arr(&b, x->pool, x->pool_len, 1);
+    buf_arr(&b, x->syms, (unsigned)x->sym_count, sizeof(FactSym));
+    buf_arr(&b, x->refs, (unsigned)x->ref_count, sizeof(FactRef));
+    buf_arr(&b, x->imports, (unsigned)x->imp_count, sizeof(unsigned));
+  }
+  unsigned long long sum = facts_hash(b.p, b.len);
+  buf_put(&b, &sum, sizeof sum);
+
+  size_t n = strlen(path);
+  char *tmp = (char *)malloc(n + 5);
+  int ok = !b.oom && tmp != NULL;
+  FILE *f = NULL;
+  if (ok) {
+    memcpy(tmp, path, n);
+    memcpy(tmp + n, ".tmp", 5);
+    f = fopen(tmp, "wb");
+    ok = f != NULL;
+  }
+  if (f) {
+    ok = fwrite(b.p, 1, b.len, f) == b.len;
+    ok = (fclose(f) == 0) && ok;
+    if (ok) {
+      remove(path); /* Windows 的 rename 不覆盖已有文件 */
+      ok = rename(tmp, path) == 0;
+    }
+    if (!ok)
+      remove(tmp);
+  }
+  free(tmp);
+  free(b.p);
+  return ok;
+}
+
+/* 内存读游标：越界即置 bad。 */
+typedef struct {
+  const char *p;
+  size_t len, pos;
+  int bad;
+} Rd;
+
+static const void *rd_take(Rd *r, size_t n) {
+  if (r->bad || n > r->len - r->pos) {
+    r->bad = 1;
+    return NULL;
+  }
+  const void *q = r->p + r->pos;
+  r->pos += n;
+  return q;
+}
+
+static unsigned rd_u32(Rd *r) {
+  unsigned v = 0;
+  const void *q = rd_take(r, sizeof v);
+  if (q)
+    memcpy(&v, q, sizeof v);
+  return v;
+}
+
+/* 读 u32 个数 + 数组，复制到新分配的内存（extra 字节额外清零，供字符串补 NUL）。 */
+static void *rd_arr(Rd *r, unsigned *count, size_t elem, size_t extra) {
+  *count = rd_u32(r);
+  if (r->bad || (size_t)*count > (r->len - r->pos) / (elem ? elem : 1)) {
+    r->bad = 1;
+    return NULL;
+  }
+  size_t n = elem * *count;
+  char *p = (char *)calloc(1, n + extra ? n + extra : 1);
+  const void *q = rd_take(r, n);
+  if (!p || !q) {
+    free(p);
+    r->bad = 1;
+    return NULL;
+  }
+  memcpy(p, q, n);
+  return p;
+}
+
+/* 读入后的一致性检查：池以 NUL 结尾，所有偏移落在池内。 */
+static int facts_valid(const FileFacts *x) {
+  if (x->pool_len == 0)
+    return x->sym_count == 0 && x->ref_count == 0 && x->imp_count == 0;
+  if (x->pool[x->pool_len - 1] != '\0')
+    return 0;
+  for (int i = 0; i < x->sym_count; i++)
+    if (x->syms[i].name >= x->pool_len ||
+        (x->syms[i].container != FACT_NONE && x->syms[i].container >= x->pool_len))
+      return 0;
+  for (int i = 0; i < x->ref_count; i++)
+    if (x->refs[i].name >= x->pool_len)
+      return 0;
+  for (int i = 0; i < x->imp_count; i++)
+    if (x->imports[i] >= x->pool_len)
+      return 0;
+  return 1;
+}
+
+int fact_table_load(FactTable *t, const char *path) {
+  fact_table_free(t);
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return -1;
+  Buf b = {0};
+  char chunk[65536];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof chunk, f)) > 0)
+    buf_put(&b, chunk, n);
+  fclose(f);
+
+  unsigned long long sum = 0;
+  int ok = !b.oom && b.len >= sizeof sum;
+  if (ok) {
+    memcpy(&sum, b.p + b.len - sizeof sum, sizeof sum);
+    ok = facts_hash(b.p, b.len - sizeof sum) == sum;
+  }
+  Rd r = {b.p, ok ? b.len - sizeof sum : 0, 0, !ok};
+  unsigned magic = rd_u32(&r), version = rd_u32(&r), ssym = rd_u32(&r), sref = rd_u32(&r);
+  unsigned count = rd_u32(&r);
+  ok = !r.bad && magic == STORE_MAGIC && version == STORE_VERSION && ssym == sizeof(FactSym) &&
+       sref == sizeof(FactRef);
+  for (unsigned i = 0; ok && i < count; i++) {
+    FileFacts x;
+    memset(&x, 0, sizeof x);
+    unsigned c = 0;
+    x.path = (char *)rd_arr(&r, &c, 1, 1);
+    const void *q;
+    if ((q = rd_take(&r, sizeof x.mtime)) != NULL)
+      memcpy(&x.mtime, q, sizeof x.mtime);
+    if ((q = rd_take(&r, sizeof x.size)) != NULL)
+      memcpy(&x.size, q, sizeof x.size);
+    if ((q = rd_take(&r, sizeof x.hash)) != NULL)
+      memcpy(&x.hash, q, sizeof x.hash);
+    x.pool = (char *)rd_arr(&r, &x.pool_len, 1, 0);
+    x.pool_cap = x.pool_len;
+    x.syms = (FactSym *)rd_arr(&r, &c, sizeof(FactSym), 0);
+    x.sym_count = x.sym_cap = (int)c;
+    x.refs = (FactRef *)rd_arr(&r, &c, sizeof(FactRef), 0);
+    x.ref_count = x.ref_cap = (int)c;
+    x.imports = (unsigned *)rd_arr(&r, &c, sizeof(unsigned), 0);
+    x.imp_count = x.imp_cap = (int)c;
+    ok = !r.bad && x.path && facts_valid(&x);
+    if (ok)
+      fact_table_put(t, &x);
+    facts_free(&x);
+  }
+  ok = ok && r.pos == r.len;
+  free(b.p);
+  if (!ok) {
+    fact_table_free(t);
+    return -1;
+  }
+  return t->count;
+}
@@ -0,0 +1,88 @@
+/*
+** index_store.h — 工作区索引的逐文件事实与持久化缓存。
+**
+** 一个文件对工作区索引的全部贡献称为"事实"（FileFacts）：摊平的符号、标识符 token 的
+** (名字, 字节偏移, 长度)、顶层 import 的模块路径，外加用于失效判断的 mtime / 大小 / 内容哈希。
+** 事实只依赖文件文本，可在任意线程上独立提取，再由 workspace.c 在主线程按文件顺序合并进
+** 符号表 / 引用倒排 / 依赖图。
+**
+** 所有字符串存放在每个文件自己的字符串池里，以偏移引用（FACT_NONE 表示空），
+** 因此序列化就是把池与几个定长数组原样写出。
+**
+** FactTable 以路径为键保存事实，可整体读写磁盘缓存（本机格式，魔数 + 版本 + 整体哈希校验；
+** 读入时逐项做越界检查，任何损坏都整体丢弃）。
+*/
+#ifndef SPT_LSP_INDEX_STORE_H
+#define SPT_LSP_INDEX_STORE_H
+
+#include "protocol.h"
+
+#include <stddef.h>
+
+#define FACT_NONE 0xFFFFFFFFu
+
+typedef struct {
+  unsigned name; /* 池偏移 */
+  int kind;      /* LSP SymbolKind */
+  LspRange range;
+  unsigned container; /* 池偏移或 FACT_NONE */
+} FactSym;
+
+typedef struct {
+  unsigned name;   /* 池偏移 */
+  unsigned offset; /* 标识符在文件（LF 规范化后）中的字节偏移 */
+  int length;
+} FactRef;
+
+typedef struct {
+  char *path; /* 拥有；本地路径 */
+  long long mtime;
+  unsigned long long size, hash; /* 磁盘文件字节数与内容哈希（facts_hash） */
+
+  char *pool;
+  unsigned pool_len, pool_cap;
+  FactSym *syms;
+  int sym_count, sym_cap;
+  FactRef *refs;
+  int ref_count, ref_cap;
+  unsigned *imports; /* 池偏移 */
+  int imp_count, imp_cap;
+  unsigned *name_cache; /* 提取期的名字去重表（facts_seal 释放） */
+} FileFacts;
+
+/* 释放 f 的内容并清零（f 本体由调用方管理）。 */
+void facts_free(FileFacts *f);
+/* 把 s[0..n) 存入池（NUL 结尾），返回偏移。 */
+unsigned facts_str(FileFacts *f, const char *s, size_t n);
+void facts_add_sym(FileFacts *f, const char *name, int kind, LspRange r, const char *container);
+void facts_add_ref(FileFacts *f, const char *name, size_t n, size_t offset, int length);
+void facts_add_import(FileFacts *f, const char *module_path);
+/* 提取完毕：释放提取期的临时结构（可选；facts_free 也会释放）。 */
+void facts_seal(FileFacts *f);
+/* 池偏移 -> 字符串；FACT_NONE -> NULL。 */
+const char *facts_at(const FileFacts *f, unsigned off);
+
+/* 64 位 FNV-1a 内容哈希。 */
+unsigned long long facts_hash(const char *data, size_t len);
+
+/* ---- 路径 -> 事实 ---- */
+typedef struct {
+  FileFacts *files; /* 拥有 */
+  int count, cap;
+  int *slots; /* 开放寻址：files 下标 + 1，0 = 空 */
+  int slot_cap;
+} FactTable;
+
+void fact_table_init(FactTable *t);
+void fact_table_free(FactTable *t);
+/* 按路径查找；无则 NULL。返回的指针在下次 put 前有效。 */
+FileFacts *fact_table_get(const FactTable *t, const char *path);
+/* 接管 *f 的内容（*f 被清零）。同路径已存在时替换。 */
+void fact_table_put(FactTable *t, FileFacts *f);
+
+/* 磁盘缓存。load 成功返回读入的文件数，文件缺失或损坏返回 -1（t 保持为空）。
+   save 写临时文件后改名，成功返回 1。 */
+int fact_table_load(FactTable *t, const char *path);
+int fact_table_save(const FactTable *t, const char *path);
+
+#endif /* SPT_LSP_INDEX_STORE_H */
@@ -33,9 +33,9 @@ static void hash_free(SemHash *h) {
   h->capacity = h->count = 0;
 }
 
-/* 插入：同名覆盖（后插入者胜，匹配 sem_find_function 的"后声明优先"近似）。
+/* 插入：同名时顶层语句下标更大（或相同）者胜，匹配 sem_find_function 的"后声明优先"近似。
    name 为 NULL 的槽位视为空。 */
-static void hash_insert(SemHash *h, const char *name, const AstNode *node, int kind) {
+static void hash_insert(SemHash *h, const char *name, const AstNode *node, int kind, int stmt) {
   if (!name)
     return;
   if (h->count * 10 >= h->capacity * 7) {
@@ -58,8 +58,11 @@ static void hash_insert(SemHash *h, const char *name, const AstNode *node, int k
   while (h->slots[k].name) {
     if (strcmp(h->slots[k].name, name) == 0) {
       /* 同名覆盖。 */
-      h->slots[k].node = node;
-      h->slots[k].kind = kind;
+      if (stmt >= h->slots[k].stmt) {
+        h->slots[k].node = node;
+        h->slots[k].kind = kind;
+        h->slots[k].stmt = stmt;
+      }
       return;
     }
     k = (k + 1) & (h->capacity - 1);
@@ -67,6 +70,7 @@ static void hash_insert(SemHash *h, const char *name, const AstNode *node, int k
   h->slots[k].name = name;
   h->slots[k].node = node;
   h->slots[k].kind = kind;
+  h->slots[k].stmt = stmt;
   h->count++;
 }
 
@@ -92,14 +96,71 @@ static const SemSlot *hash_lookup(const SemHash *h, const char *name) {
 #define SK_MODULE 2
 
 /* ---- 从 AST 构建索引 ---- */
-static void index_class_members(SemIndex *idx, const AstNode *cls) {
+
+/* 插入一条来自顶层语句 si 的条目；only 非空时只收该名字（增量修补时按名重扫）。 */
+static void put(SemHash *h, const char *name, const AstNode *node, int kind, int si,
+                const char *only) {
+  if (name && (!only || strcmp(name, only) == 0))
+    hash_insert(h, name, node, kind, si);
+}
+
+static void index_class_members(SemIndex *idx, const AstNode *cls, int si, const char *only) {
   const AstList *m = &cls->u.class_decl.members;
   for (int i = 0; i < m->count; i++) {
     AstNode *decl = m->items[i]->u.class_member.member_declaration;
     if (!decl)
       continue;
-    if (decl->type == NODE_FUNCTION_DECL && decl->u.func_decl.name)
-      hash_insert(&idx->funcs, decl->u.func_decl.name, decl, SK_METHOD);
+    if (decl->type == NODE_FUNCTION_DECL)
+      put(&idx->funcs, decl->u.func_decl.name, decl, SK_METHOD, si, only);
+  }
+}
+
+/* 收录顶层语句 s（下标 si）定义的全部名字。 */
+static void index_stmt(SemIndex *idx, const AstNode *s, int si, const char *only) {
+  switch (s->type) {
+  case NODE_FUNCTION_DECL:
+    put(&idx->defs, s->u.func_decl.name, s, SK_FUNCTION, si, only);
+    put(&idx->funcs, s->u.func_decl.name, s, SK_FUNCTION, si, only);
+    break;
+  case NODE_CLASS_DECL:
+    put(&idx->defs, s->u.class_decl.name, s, SK_CLASS, si, only);
+    put(&idx->classes, s->u.class_decl.name, s, SK_CLASS, si, only);
+    index_class_members(idx, s, si, only);
+    break;
+  case NODE_VARIABLE_DECL:
+    put(&idx->defs, s->u.var_decl.name, s, s->u.var_decl.is_const ? SK_CONSTANT : SK_VARIABLE, si,
+        only);
+    break;
+  case NODE_MUTI_VARIABLE_DECL:
+    for (int k = 0; k < s->u.muti_var.count; k++)
+      put(&idx->defs, s->u.muti_var.vars[k].name, s, SK_VARIABLE, si, only);
+    break;
+  case NODE_IMPORT_NAMESPACE:
+    put(&idx->defs, s->u.import_ns.alias, s, SK_MODULE, si, only);
+    break;
+  case NODE_IMPORT_NAMED: {
+    const AstList *sp = &s->u.import_named.specifiers;
+    for (int k = 0; k < sp->count; k++) {
+      AstNode *spec = sp->items[k];
+      const char *nm = spec->u.import_spec.alias ? spec->u.import_spec.alias
+                                                 : spec->u.import_spec.imported_name;
+      put(&idx->defs, nm, spec, SK_VARIABLE, si, only);
+    }
+    break;
+  }
+  case NODE_DECLARE_MODULE: {
+    const AstList *mm = &s->u.declare_module.members;
+    for (int k = 0; k < mm->count; k++) {
+      AstNode *m = mm->items[k];
+      if (m->type == NODE_CLASS_DECL)
+        put(&idx->classes, m->u.class_decl.name, m, SK_CLASS, si, only);
+      if (m->type == NODE_FUNCTION_DECL)
+        put(&idx->funcs, m->u.func_decl.name, m, SK_FUNCTION, si, only);
+    }
+    break;
+  }
+  default:
+    break;
   }
 }
 
@@ -111,63 +172,72 @@ SemIndex *sem_index_build(const AstNode *root) {
   hash_init(&idx->classes, 32);
   hash_init(&idx->funcs, 64);
   const AstList *st = &root->u.block.statements;
-  for (int i = 0; i < st->count; i++) {
-    AstNode *s = st->items[i];
-    switch (s->type) {
-    case NODE_FUNCTION_DECL:
-      if (s->u.func_decl.name) {
-        hash_insert(&idx->defs, s->u.func_decl.name, s, SK_FUNCTION);
-        hash_insert(&idx->funcs, s->u.func_decl.name, s, SK_FUNCTION);
-      }
-      break;
-    case NODE_CLASS_DECL:
-      if (s->u.class_decl.name) {
-        hash_insert(&idx->defs, s->u.class_decl.name, s, SK_CLASS);
-        hash_insert(&idx->classes, s->u.class_decl.name, s, SK_CLASS);
-      }
-      index_class_members(idx, s);
-      break;
-    case NODE_VARIABLE_DECL:
-      if (s->u.var_decl.name)
-        hash_insert(&idx->defs, s->u.var_decl.name, s,
-                    s->u.var_decl.is_const ? SK_CONSTANT : SK_VARIABLE);
-      break;
-    case NODE_MUTI_VARIABLE_DECL:
-      for (int k = 0; k < s->u.muti_var.count; k++)
-        if (s->u.muti_var.vars[k].name)
-          hash_insert(&idx->defs, s->u.muti_var.vars[k].name, s, SK_VARIABLE);
-      break;
-    case NODE_IMPORT_NAMESPACE:
-      if (s->u.import_ns.alias)
-        hash_insert(&idx->defs, s->u.import_ns.alias, s, SK_MODULE);
-      break;
-    case NODE_IMPORT_NAMED: {
-      const AstList *sp = &s->u.import_named.specifiers;
-      for (int k = 0; k < sp->count; k++) {
-        AstNode *spec = sp->items[k];
-        const char *nm = spec->u.import_spec.alias ? spec->u.import_spec.alias
-                                                   : spec->u.import_spec.imported_name;
-        if (nm)
-          hash_insert(&idx->defs, nm, spec, SK_VARIABLE);
-      }
-      break;
-    }
-    case NODE_DECLARE_MODULE: {
-      const AstList *mm = &s->u.declare_module.members;
-      for (int k = 0; k < mm->count; k++) {
-        AstNode *m = mm->items[k];
-        if (m->type == NODE_CLASS_DECL && m->u.class_decl.name)
-          hash_insert(&idx->classes, m->u.class_decl.name, m, SK_CLASS);
-        if (m->type == NODE_FUNCTION_DECL && m->u.func_decl.name)
-          hash_insert(&idx->funcs, m->u.func_decl.name, m, SK_FUNCTION);
-      }
-      break;
-    }
-    default:
-      break;
+  for (int i = 0; i < st->count; i++)
+    index_stmt(idx, st->items[i], i, NULL);
+  return idx;
+}
+
+/* 按名字收集的小集合（被移除条目的名字，修补后需按名重扫）。 */
+typedef struct {
+  const char **names;
+  int count, cap;
+} NameSet;
+
+static void names_add(NameSet *ns, const char *name) {
+  for (int i = 0; i < ns->count; i++)
+    if (strcmp(ns->names[i], name) == 0)
+      return;
+  if (ns->count >= ns->cap) {
+    ns->cap = ns->cap ? ns->cap * 2 : 8;
+    ns->names = (const char **)realloc(ns->names, sizeof(char *) * (size_t)ns->cap);
+  }
+  ns->names[ns->count++] = name;
+}
+
+/* 删除 stmt 落在 [first, first+old_count) 的槽位（名字记入 ns），其后的下标平移 delta。
+   开放寻址不支持原地删除，幸存条目按原容量重插。 */
+static void hash_drop_range(SemHash *h, int first, int old_count, int delta, NameSet *ns) {
+  SemSlot *old = h->slots;
+  int cap = h->capacity;
+  hash_init(h, cap);
+  for (int i = 0; i < cap; i++) {
+    SemSlot e = old[i];
+    if (!e.name)
+      continue;
+    if (e.stmt >= first && e.stmt < first + old_count) {
+      names_add(ns, e.name);
+      continue;
     }
+    if (e.stmt >= first + old_count)
+      e.stmt += delta;
+    unsigned k = sem_hash_str(e.name) & (unsigned)(cap - 1);
+    while (h->slots[k].name)
+      k = (k + 1) & (cap - 1);
+    h->slots[k] = e;
+    h->count++;
   }
-  return idx;
+  free(old);
+}
+
+void sem_index_patch(SemIndex *idx, const AstNode *root, int first, int old_count,
+                     int new_count) {
+  if (!idx || !root || root->type != NODE_BLOCK)
+    return;
+  const AstList *st = &root->u.block.statements;
+  NameSet ns = {NULL, 0, 0};
+  int delta = new_count - old_count;
+  hash_drop_range(&idx->defs, first, old_count, delta, &ns);
+  hash_drop_range(&idx->classes, first, old_count, delta, &ns);
+  hash_drop_range(&idx->funcs, first, old_count, delta, &ns);
+  for (int i = first; i < first + new_count && i < st->count; i++)
+    index_stmt(idx, st->items[i], i, NULL);
+  /* 被移除的名字可能遮蔽过其它语句里的同名定义：按名重扫其余语句，"后声明优先"规则
+     保证结果与全量构建一致。 */
+  for (int k = 0; k < ns.count; k++)
+    for (int i = 0; i < st->count; i++)
+      if (i < first || i >= first + new_count)
+        index_stmt(idx, st->items[i], i, ns.names[k]);
+  free(ns.names);
 }
 
 void sem_index_free(SemIndex *idx) {
@@ -6,7 +6,8 @@
 **
 ** 索引不拥有任何内存——name 指针指向 AST arena，node 指针指向 AST 节点。
 ** 生命周期：由 sem_index_build 创建，sem_index_free 释放槽位数组。
-** 缓存策略由调用方（semantic.c）管理：单条目静态缓存，按 unit 指针命中。
+** 缓存策略由调用方管理：文档缓存（doc_cache.c）按版本持有并在增量重解析后修补，
+** 其余走 semantic.c 的单条目静态缓存，按 unit 指针命中。
 */
 #ifndef SPT_LSP_SEM_INDEX_H
 #define SPT_LSP_SEM_INDEX_H
@@ -19,6 +20,7 @@ typedef struct {
   const char *name;    /* 键：符号名（指向 AST arena，不拥有） */
   const AstNode *node; /* 值：定义节点（不拥有） */
   int kind;            /* LSP SymbolKind */
+  int stmt;            /* 来源顶层语句下标（同名取较大者；增量修补按此定位） */
 } SemSlot;
 
 typedef struct {
@@ -36,6 +38,11 @@ typedef struct {
 /* 为 unit 构建索引。返回 NULL 若 root 为空。调用方拥有返回值。 */
 SemIndex *sem_index_build(const AstNode *root);
 
+/* 增量修补（配合 spt_lsp_reparse）：root 的顶层语句 [first, first+old_count) 已被替换为
+   [first, first+new_count)。移除旧语句的条目、平移其后条目的语句下标、收录新语句，
+   被移除的名字按名重扫其余语句以恢复被遮蔽的定义。结果与对 root 全量 sem_index_build 一致。 */
+void sem_index_patch(SemIndex *idx, const AstNode *root, int first, int old_count, int new_count);
+
 /* 释放索引。idx 可为 NULL。 */
 void sem_index_free(SemIndex *idx);
 
@@ -2,10 +2,12 @@
 ** semantic.c — 基于 AST 的符号收集与名字解析。
 */
 #include "semantic.h"
+#include "doc_cache.h"
 #include "sem_index.h"
 
 #include "protocol.h"
 #include "spt_ast.h"
+#include "spt_thread.h"
 #include "spt_token.h"
 
 #include <stdarg.h>
@@ -14,17 +16,22 @@
 #include <string.h>
 
 /* ===========================================================================
-** Phase 5a: 语义索引缓存（单条目，按 unit 指针命中）。
-** 服务器单线程，同一 dispatch 内 unit 稳定；用 source 指针防 stale（unit 释放后
-** 原址可能被新 parse 复用，source 指针必然不同）。
+** Phase 5a: 语义索引缓存。
+** 打开文档的 unit 由 doc_cache 按版本持有，索引随之缓存（doc_cache_index_for）；
+** 其余 unit（测试或临时解析）退回单条目缓存，按 unit 指针命中。
+** 缓存为线程局部（后台诊断线程各有一份）；同一 dispatch 内 unit 稳定；用 source 指针防
+** stale（unit 释放后原址可能被新 parse 复用，source 指针必然不同）。
 ** ========================================================================= */
-static const SptLspUnit *g_idx_unit = NULL;
-static const char *g_idx_source = NULL;
-static SemIndex *g_idx = NULL;
+static SPT_THREAD_LOCAL const SptLspUnit *g_idx_unit = NULL;
+static SPT_THREAD_LOCAL const char *g_idx_source = NULL;
+static SPT_THREAD_LOCAL SemIndex *g_idx = NULL;
 
 static SemIndex *sem_get_index(const SptLspUnit *u) {
   if (!u || !u->root)
     return NULL;
+  SemIndex *cached = doc_cache_index_for(u);
+  if (cached)
+    return cached;
   if (g_idx_unit == u && g_idx_source == u->source && g_idx)
     return g_idx;
   if (g_idx) {
@@ -46,15 +53,17 @@ static size_t off_of(const Document *d, int line1, int col1) {
     l = 0;
   if (l >= d->line_count)
     return d->text_len;
-  size_t off = d->line_starts[l] + (size_t)(col1 > 0 ? col1 - 1 : 0);
+  size_t off = doc_line_start(d, l) + (size_t)(col1 > 0 ? col1 - 1 : 0);
   if (off > d->text_len)
     off = d->text_len;
   return off;
 }
 
 static size_t line_end_off(const Document *d, int line1) {
-  if (line1 >= 1 && line1 < d->line_count)
-    return d->line_starts[line1] > 0 ? d->line_starts[line1] - 1 : 0;
+  if (line1 >= 1 && line1 < d->line_count) {
+    size_t next = doc_line_start(d, line1);
+    return next > 0 ? next - 1 : 0;
+  }
   return d->text_len;
 }
 
@@ -3,29 +3,35 @@
 */
 #include "workspace.h"
 
+#include "doc_cache.h"
 #include "documents.h"
+#include "index_store.h"
 #include "module_resolve.h"
 #include "semantic.h"
+#include "spt_arena.h"
 #include "spt_lsp_bridge.h"
+#include "spt_thread.h"
 
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #ifdef _WIN32
 #include <windows.h>
 #else
 #include <dirent.h>
-#include <sys/stat.h>
 #endif
+#include <sys/stat.h>
+#include <sys/types.h>
 
 /* ===========================================================================
 ** Phase 5b/5c: 引用倒排索引 + 模块依赖图（前置声明，实现在文件末尾）
 ** ========================================================================= */
 typedef struct {
-  char *uri;
   size_t offset;
+  int uri; /* 驻留 id（ws->uris） */
   int length;
 } RefOcc;
 
@@ -53,14 +59,17 @@ typedef struct {
 
 static void ref_index_init(RefIndex *ri, int cap);
 static void ref_index_free(RefIndex *ri);
-static void ref_index_remove_uri(RefIndex *ri, const char *uri);
+static void ref_index_remove_uri(RefIndex *ri, int uri);
+static void ref_index_edit_uri(RefIndex *ri, int uri, size_t start, size_t old_end,
+                               size_t new_end);
 static void dep_graph_init(DepGraph *dg, int cap);
 static void dep_graph_free(DepGraph *dg);
 static void dep_graph_remove_uri(DepGraph *dg, const char *uri);
-static void index_ref_tokens(Workspace *ws, const SptLspUnit *u, const char *uri,
-                             const Document *d);
-static void index_imports(Workspace *ws, const SptLspUnit *u, const char *uri);
-static void index_file(Workspace *ws, const char *path);
+static void ref_index_add(RefIndex *ri, const char *name, int uri, size_t offset, int length);
+static void dep_graph_add(DepGraph *dg, const char *mod, const char *importer_uri);
+static long read_file_all(const char *path, char **out_buf);
+static void index_file_ex(Workspace *ws, const char *path, int with_refs);
+static int patch_doc_refs(Workspace *ws, const char *uri);
 
 /* ---- URI <-> path ---- */
 static int hexval(int c) {
@@ -129,6 +138,8 @@ void spt_path_to_uri(const char *path, char *out, size_t cap) {
 /* ---- 根目录 ---- */
 void workspace_init(Workspace *ws) {
   memset(ws, 0, sizeof *ws);
+  ws->uris = uri_table_new();
+  ws->unit_budget = WS_UNIT_BUDGET_DEFAULT;
   ws->ref_idx = calloc(1, sizeof(RefIndex));
   ws->dep_graph = calloc(1, sizeof(DepGraph));
   ref_index_init((RefIndex *)ws->ref_idx, 256);
@@ -165,44 +176,57 @@ static void syms_remove_uri(Workspace *ws, const char *uri) {
   ws->sym_count = w;
 }
 
-/* 释放单个独立 Document（非 DocStore 管理）。 */
-static void doc_free_one(Document *d) {
-  if (!d)
-    return;
-  free(d->uri);
-  free(d->text);
-  free(d->line_starts);
-  free(d);
+static void unit_release(Workspace *ws, int i) {
+  spt_lsp_unit_free(ws->units[i].unit);
+  doc_free(ws->units[i].temp_doc);
+  ws->unit_bytes -= ws->units[i].bytes;
+  ws->unit_of[ws->units[i].uri] = 0;
 }
 
 /* 释放目标文件解析缓存。 */
 static void free_units(Workspace *ws) {
-  for (int i = 0; i < ws->unit_count; i++) {
-    free(ws->units[i].path);
-    spt_lsp_unit_free(ws->units[i].unit);
-    doc_free_one(ws->units[i].temp_doc);
-  }
+  for (int i = 0; i < ws->unit_count; i++)
+    unit_release(ws, i);
   free(ws->units);
   ws->units = NULL;
   ws->unit_count = ws->unit_cap = 0;
+  ws->unit_bytes = 0;
 }
 
-/* Phase 5d: 释放指定 path 的缓存 unit（按路径精确匹配）。返回是否命中。 */
-static int free_unit_by_path(Workspace *ws, const char *path) {
-  if (!path)
+/* 移除第 i 个缓存 unit，用末尾元素填补空洞。 */
+static void unit_remove(Workspace *ws, int i) {
+  unit_release(ws, i);
+  int last = --ws->unit_count;
+  if (i != last) {
+    ws->units[i] = ws->units[last];
+    ws->unit_of[ws->units[i].uri] = i + 1;
+  }
+}
+
+static int unit_index(const Workspace *ws, int uri) {
+  return uri >= 0 && uri < ws->unit_of_cap ? ws->unit_of[uri] - 1 : -1;
+}
+
+/* Phase 5d: 释放指定 URI 的缓存 unit。返回是否命中。 */
+static int free_unit_by_uri(Workspace *ws, int uri) {
+  int i = unit_index(ws, uri);
+  if (i < 0)
     return 0;
-  for (int i = 0; i < ws->unit_count; i++) {
-    if (ws->units[i].path && strcmp(ws->units[i].path, path) == 0) {
-      free(ws->units[i].path);
-      spt_lsp_unit_free(ws->units[i].unit);
-      doc_free_one(ws->units[i].temp_doc);
-      /* 用末尾元素填补空洞。 */
-      ws->units[i] = ws->units[ws->unit_count - 1];
-      ws->unit_count--;
-      return 1;
-    }
+  unit_remove(ws, i);
+  return 1;
+}
+
+void workspace_trim_units(Workspace *ws) {
+  /* 缓存的 unit 通常只有几十个，线性找最久未用者即可。 */
+  while (ws->unit_budget && ws->unit_bytes > ws->unit_budget && ws->unit_count > 0) {
+    int victim = -1;
+    for (int i = 0; i < ws->unit_count; i++)
+      if (!ws->units[i].parsing && (victim < 0 || ws->units[i].used < ws->units[victim].used))
+        victim = i;
+    if (victim < 0)
+      break;
+    unit_remove(ws, victim);
   }
-  return 0;
 }
 
 void workspace_free(Workspace *ws) {
@@ -211,6 +235,8 @@ void workspace_free(Workspace *ws) {
   free(ws->roots);
   free_syms(ws);
   free_units(ws);
+  free(ws->unit_of);
+  uri_table_release(ws->uris);
   if (ws->ref_idx) {
     ref_index_free((RefIndex *)ws->ref_idx);
     free(ws->ref_idx);
@@ -219,6 +245,11 @@ void workspace_free(Workspace *ws) {
     dep_graph_free((DepGraph *)ws->dep_graph);
     free(ws->dep_graph);
   }
+  if (ws->facts) {
+    fact_table_free((FactTable *)ws->facts);
+    free(ws->facts);
+  }
+  free(ws->cache_path);
   memset(ws, 0, sizeof *ws);
 }
 
@@ -245,7 +276,31 @@ void workspace_add_root_uri(Workspace *ws, const char *root_uri) {
   workspace_add_root_path(ws, path);
 }
 
-void workspace_set_overlay(Workspace *ws, const DocStore *overlay) { ws->overlay = overlay; }
+void workspace_set_overlay(Workspace *ws, const DocStore *overlay) {
+  ws->overlay = overlay;
+  if (!overlay || !overlay->uris || overlay->uris == ws->uris)
+    return;
+  /* 换驻留表：缓存 unit 与引用倒排里的 id 都按旧表分配，整体作废。 */
+  free_units(ws);
+  free(ws->unit_of);
+  ws->unit_of = NULL;
+  ws->unit_of_cap = 0;
+  uri_table_release(ws->uris);
+  ws->uris = uri_table_retain(overlay->uris);
+  if (ws->indexed)
+    ws->dirty = 1;
+}
+
+void workspace_set_index_cache(Workspace *ws, const char *path) {
+  free(ws->cache_path);
+  ws->cache_path = path && path[0] ? dupz(path) : NULL;
+  /* 丢弃内存中的事实表，下次 workspace_index 从新路径载入。 */
+  if (ws->facts) {
+    fact_table_free((FactTable *)ws->facts);
+    free(ws->facts);
+    ws->facts = NULL;
+  }
+}
 
 void workspace_mark_dirty(Workspace *ws) {
   if (ws->indexed)
@@ -269,14 +324,18 @@ void workspace_mark_doc_dirty(Workspace *ws, const char *uri) {
   /* 1. 释放该 URI 对应的缓存 unit（若磁盘文件解析过）。 */
   char path[4096];
   spt_uri_to_path(uri, path, sizeof path);
-  free_unit_by_path(ws, path);
-  /* 2. 从三个索引中移除该 URI 的条目。 */
-  ref_index_remove_uri((RefIndex *)ws->ref_idx, uri);
+  int id = uri_table_find(ws->uris, uri);
+  free_unit_by_uri(ws, id);
+  /* 2. 从三个索引中移除该 URI 的条目。打开文档刚做过增量重解析时，引用倒排只修补
+     被重解析的片段（patch_doc_refs），其余两个按文件重建（均只看顶层声明，成本低）。 */
+  int refs_patched = patch_doc_refs(ws, uri);
+  if (!refs_patched)
+    ref_index_remove_uri((RefIndex *)ws->ref_idx, id);
   dep_graph_remove_uri((DepGraph *)ws->dep_graph, uri);
   syms_remove_uri(ws, uri);
   /* 3. 单文件重建（若文件存在且在根目录下，index_file 会重新解析并加入索引）。
      若文件已删除（didClose 后磁盘无对应），index_file 静默跳过——条目已被清除。 */
-  index_file(ws, path);
+  index_file_ex(ws, path, !refs_patched);
 }
 
 /* ---- 符号收集 ---- */
@@ -305,7 +364,7 @@ static LspRange range_from_json(cJSON *rng) {
 }
 
 /* 摊平 sem_document_symbols 的层级结果。 */
-static void flatten(Workspace *ws, const char *uri, cJSON *arr, const char *container) {
+static void flatten(FileFacts *f, cJSON *arr, const char *container) {
   if (!arr)
     return;
   int n = cJSON_GetArraySize(arr);
@@ -316,63 +375,105 @@ static void flatten(Workspace *ws, const char *uri, cJSON *arr, const char *cont
     cJSON *sel = cJSON_GetObjectItemCaseSensitive(it, "selectionRange");
     if (nm && nm->valuestring) {
       LspRange r = range_from_json(sel);
-      sym_push(ws, nm->valuestring, kd ? kd->valueint : 0, uri, r, container);
+      facts_add_sym(f, nm->valuestring, kd ? kd->valueint : 0, r, container);
     }
     cJSON *ch = cJSON_GetObjectItemCaseSensitive(it, "children");
     if (ch)
-      flatten(ws, uri, ch, nm ? nm->valuestring : NULL);
+      flatten(f, ch, nm ? nm->valuestring : NULL);
+  }
+}
+
+/* 从解析结果提取文件的索引事实：符号、标识符 token、顶层 import。
+   只读 u / d，不碰工作区，可在索引线程上调用。 */
+static void facts_collect(FileFacts *f, const SptLspUnit *u, const Document *d) {
+  cJSON *syms = sem_document_symbols(u, d);
+  flatten(f, syms, NULL);
+  cJSON_Delete(syms);
+  for (int ti = 0; ti < u->token_count; ti++) {
+    const SptToken *t = &u->tokens[ti];
+    if (t->kind != TOK_IDENTIFIER || t->length <= 0)
+      continue;
+    /* token 的 line/column 是 1 起；转为字节偏移。 */
+    int li = t->line - 1;
+    if (li < 0 || li >= d->line_count)
+      continue;
+    size_t off = doc_line_start(d, li) + (size_t)(t->column > 0 ? t->column - 1 : 0);
+    size_t nl = (size_t)t->length < 255 ? (size_t)t->length : 255;
+    facts_add_ref(f, t->lexeme, nl, off, t->length);
+  }
+  if (u->root && u->root->type == NODE_BLOCK) {
+    const AstList *st = &u->root->u.block.statements;
+    for (int i = 0; i < st->count; i++) {
+      AstNode *s = st->items[i];
+      if (s->type == NODE_IMPORT_NAMESPACE)
+        facts_add_import(f, s->u.import_ns.module_path);
+      else if (s->type == NODE_IMPORT_NAMED)
+        facts_add_import(f, s->u.import_named.module_path);
+    }
+  }
+}
+
+/* 把一个文件的事实并入符号表 / 引用倒排（with_refs）/ 依赖图。 */
+static void merge_facts(Workspace *ws, const FileFacts *f, const char *uri, int with_refs) {
+  int id = uri_table_intern(ws->uris, uri);
+  for (int i = 0; i < f->sym_count; i++) {
+    const FactSym *s = &f->syms[i];
+    sym_push(ws, facts_at(f, s->name), s->kind, uri, s->range, facts_at(f, s->container));
   }
+  if (with_refs && ws->ref_idx && id >= 0)
+    for (int i = 0; i < f->ref_count; i++)
+      ref_index_add((RefIndex *)ws->ref_idx, facts_at(f, f->refs[i].name), id, f->refs[i].offset,
+                    f->refs[i].length);
+  if (ws->dep_graph)
+    for (int i = 0; i < f->imp_count; i++)
+      dep_graph_add((DepGraph *)ws->dep_graph, facts_at(f, f->imports[i]), uri);
+}
+
+/* 打开文档（主线程缓存）的事实并入工作区。 */
+static void index_overlay_doc(Workspace *ws, const Document *od, const char *uri, int with_refs) {
+  const SptLspUnit *u = doc_unit(od); /* 借用文档的版本缓存（doc_cache.h），随文档释放 */
+  if (!u)
+    return;
+  FileFacts f;
+  memset(&f, 0, sizeof f);
+  facts_collect(&f, u, od);
+  merge_facts(ws, &f, uri, with_refs);
+  facts_free(&f);
+  /* 记下工作区已反映的单元代数，供下次增量修补校验衔接。 */
+  if (od->cache)
+    od->cache->ws_gen = od->cache->gen;
+}
+
+/* 解析磁盘文本（已读入 buf）并提取事实到 f。 */
+static void facts_from_text(FileFacts *f, const char *uri, const char *buf, size_t len) {
+  Document *td = doc_new(uri, buf, len, 1);
+  const SptLspUnit *u = td ? doc_unit(td) : NULL;
+  if (u)
+    facts_collect(f, u, td);
+  doc_free(td);
 }
 
-static void index_file(Workspace *ws, const char *path) {
+/* with_refs=0：引用倒排已由 patch_doc_refs 修补，只收符号与 import。 */
+static void index_file_ex(Workspace *ws, const char *path, int with_refs) {
   char uri[4096];
   spt_path_to_uri(path, uri, sizeof uri);
 
   /* 覆盖层：若该文件正打开（未保存改动），用打开文档的文本而非磁盘内容。 */
   const Document *od = ws->overlay ? doc_store_get((DocStore *)ws->overlay, uri) : NULL;
-  SptLspUnit *u = NULL;
-  DocStore tmp;
-  int tmp_inited = 0;
-  const Document *d = NULL;
   if (od) {
-    u = spt_lsp_parse(od->text, od->text_len);
-    d = od;
-  } else {
-    FILE *f = fopen(path, "rb");
-    if (!f)
-      return;
-    fseek(f, 0, SEEK_END);
-    long sz = ftell(f);
-    if (sz < 0) {
-      fclose(f);
-      return;
-    }
-    fseek(f, 0, SEEK_SET);
-    char *buf = (char *)malloc((size_t)sz + 1);
-    size_t rd = fread(buf, 1, (size_t)sz, f);
-    fclose(f);
-    buf[rd] = '\0';
-    doc_store_init(&tmp);
-    tmp_inited = 1;
-    Document *td = doc_store_open(&tmp, uri, buf, rd, 1);
-    if (td) {
-      u = spt_lsp_parse(td->text, td->text_len);
-      d = td;
-    }
-    free(buf);
-  }
-
-  if (u && d) {
-    cJSON *syms = sem_document_symbols(u, d);
-    flatten(ws, uri, syms, NULL);
-    cJSON_Delete(syms);
-    /* Phase 5b/5c: 构建引用倒排索引 + 模块依赖图。 */
-    index_ref_tokens(ws, u, uri, d);
-    index_imports(ws, u, uri);
+    index_overlay_doc(ws, od, uri, with_refs);
+    return;
   }
-  spt_lsp_unit_free(u);
-  if (tmp_inited)
-    doc_store_free(&tmp);
+  char *buf = NULL;
+  long len = read_file_all(path, &buf);
+  if (len < 0)
+    return;
+  FileFacts f;
+  memset(&f, 0, sizeof f);
+  facts_from_text(&f, uri, buf, (size_t)len);
+  free(buf);
+  merge_facts(ws, &f, uri, with_refs);
+  facts_free(&f);
 }
 
 static int has_spt_ext(const char *name) {
@@ -380,7 +481,25 @@ static int has_spt_ext(const char *name) {
   return n >= 4 && strcmp(name + n - 4, ".spt") == 0;
 }
 
-static void walk_dir(Workspace *ws, const char *dir, int depth) {
+/* 扫描得到的待索引文件路径（按遍历顺序）。 */
+typedef struct {
+  char **paths;
+  int count, cap;
+} PathList;
+
+static void path_list_push(PathList *pl, const char *path) {
+  if (pl->count >= pl->cap) {
+    int nc = pl->cap ? pl->cap * 2 : 64;
+    char **np = (char **)realloc(pl->paths, sizeof(char *) * (size_t)nc);
+    if (!np)
+      return;
+    pl->paths = np;
+    pl->cap = nc;
+  }
+  pl->paths[pl->count++] = dupz(path);
+}
+
+static void walk_dir(PathList *pl, const char *dir, int depth) {
   if (depth > 24)
     return;
 #ifdef _WIN32
@@ -398,9 +517,9 @@ static void walk_dir(Workspace *ws, const char *dir, int depth) {
     snprintf(full, sizeof full, "%s\\%s", dir, nm);
     if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
       if (nm[0] != '.')
-        walk_dir(ws, full, depth + 1);
+        walk_dir(pl, full, depth + 1);
     } else if (has_spt_ext(nm)) {
-      index_file(ws, full);
+      path_list_push(pl, full);
     }
   } while (FindNextFileA(h, &fd));
   FindClose(h);
@@ -422,16 +541,122 @@ static void walk_dir(Workspace *ws, const char *dir, int depth) {
       continue;
     if (S_ISDIR(st.st_mode)) {
       if (strcmp(nm, "node_modules") != 0)
-        walk_dir(ws, full, depth + 1);
+        walk_dir(pl, full, depth + 1);
     } else if (S_ISREG(st.st_mode) && has_spt_ext(nm)) {
-      index_file(ws, full);
+      path_list_push(pl, full);
     }
   }
   closedir(dp);
 #endif
 }
 
+/* ---- 并行索引 ----
+** workspace_index 分三步：遍历根目录收集路径；索引线程逐文件判断能否复用事实表
+** （mtime + 大小命中，或内容哈希命中），否则读盘解析提取新事实；主线程按遍历顺序把
+** 事实并入符号表 / 引用倒排 / 依赖图（与逐文件顺序索引的结果一致），并换上新事实表。
+** 打开文档的 DocCache 归主线程所有，它们不交给索引线程，在合并时就地处理。 */
+
+enum { JOB_MISSING, JOB_SAME_STAT, JOB_SAME_HASH, JOB_PARSED, JOB_OVERLAY };
+
+typedef struct {
+  const char *path;
+  int state;
+  long long mtime;
+  unsigned long long size;
+  FileFacts facts; /* JOB_PARSED 时的新事实 */
+} IndexJob;
+
+typedef struct {
+  IndexJob *jobs;
+  int count;
+  const FactTable *old; /* 上一轮事实表（索引期间只读） */
+  int next;             /* 下一个待领取的 job */
+  SptMutex mu;
+} IndexPool;
+
+static int file_stat(const char *path, long long *mtime, unsigned long long *size) {
+#ifdef _WIN32
+  struct _stat64 st;
+  if (_stat64(path, &st) != 0)
+    return 0;
+#else
+  struct stat st;
+  if (stat(path, &st) != 0)
+    return 0;
+#endif
+  *mtime = (long long)st.st_mtime;
+  *size = (unsigned long long)st.st_size;
+  return 1;
+}
+
+/* mtime 只有秒精度：记录事实时 mtime 距索引开始不足这么多秒的文件，之后仍可能在同一秒内
+   被改动而 mtime / 大小都不变。这类文件记为 FACTS_MTIME_RACY，下次必定比较内容哈希。 */
+#define FACTS_RACY_SECS 2
+#define FACTS_MTIME_RACY (-1LL)
+
+/* 处理一个磁盘文件：能复用旧事实则只记状态，否则解析。只读 old。
+   mtime + 大小命中即复用（旧事实若被记为 racy 则 mtime 永不命中）；否则读盘比较内容哈希，
+   哈希相同仍复用，不同才解析。 */
+static void run_job(IndexJob *j, const FactTable *old) {
+  if (!file_stat(j->path, &j->mtime, &j->size)) {
+    j->state = JOB_MISSING;
+    return;
+  }
+  const FileFacts *of = fact_table_get(old, j->path);
+  if (of && of->mtime == j->mtime && of->size == j->size) {
+    j->state = JOB_SAME_STAT;
+    return;
+  }
+  char *buf = NULL;
+  long len = read_file_all(j->path, &buf);
+  if (len < 0) {
+    j->state = JOB_MISSING;
+    return;
+  }
+  unsigned long long h = facts_hash(buf, (size_t)len);
+  if (of && of->hash == h) {
+    j->state = JOB_SAME_HASH; /* 只是被 touch 过 */
+  } else {
+    char uri[4096];
+    spt_path_to_uri(j->path, uri, sizeof uri);
+    facts_from_text(&j->facts, uri, buf, (size_t)len);
+    j->facts.path = dupz(j->path);
+    j->facts.hash = h;
+    j->state = JOB_PARSED;
+  }
+  j->size = (unsigned long long)len;
+  free(buf);
+}
+
+static void index_worker(void *arg) {
+  IndexPool *p = (IndexPool *)arg;
+  for (;;) {
+    spt_mutex_lock(&p->mu);
+    int i = p->next < p->count ? p->next++ : -1;
+    spt_mutex_unlock(&p->mu);
+    if (i < 0)
+      break;
+    if (p->jobs[i].state != JOB_OVERLAY)
+      run_job(&p->jobs[i], p->old);
+  }
+}
+
+/* 用 n 个线程（含当前线程）跑完全部 job；线程创建失败时由剩余线程（至少当前线程）兜底。 */
+static void run_pool(IndexPool *p, int n) {
+  spt_mutex_init(&p->mu);
+  SptThread th[32];
+  int started = 0;
+  for (int i = 1; i < n && i < 32; i++)
+    if (spt_thread_create(&th[started], index_worker, p))
+      started++;
+  index_worker(p);
+  for (int i = 0; i < started; i++)
+    spt_thread_join(th[i]);
+  spt_mutex_destroy(&p->mu);
+}
+
 void workspace_index(Workspace *ws) {
+  long long started = (long long)time(NULL);
   free_syms(ws);
   /* Phase 5b/5c: 清空索引后重建。 */
   if (ws->ref_idx) {
@@ -442,12 +667,126 @@ void workspace_index(Workspace *ws) {
     dep_graph_free((DepGraph *)ws->dep_graph);
     dep_graph_init((DepGraph *)ws->dep_graph, 64);
   }
+  /* 首次索引（或换了缓存路径）时从磁盘缓存载入事实表。 */
+  int need_save = 0;
+  if (!ws->facts) {
+    ws->facts = calloc(1, sizeof(FactTable));
+    if (ws->facts && ws->cache_path)
+      need_save = fact_table_load((FactTable *)ws->facts, ws->cache_path) < 0;
+  }
+  FactTable *old = (FactTable *)ws->facts;
+
+  PathList pl = {0};
   for (int i = 0; i < ws->root_count; i++)
-    walk_dir(ws, ws->roots[i], 0);
+    walk_dir(&pl, ws->roots[i], 0);
+
+  IndexJob *jobs = (IndexJob *)calloc(pl.count ? (size_t)pl.count : 1, sizeof(IndexJob));
+  int disk = 0;
+  for (int i = 0; jobs && i < pl.count; i++) {
+    jobs[i].path = pl.paths[i];
+    char uri[4096];
+    spt_path_to_uri(pl.paths[i], uri, sizeof uri);
+    if (ws->overlay && doc_store_get((DocStore *)ws->overlay, uri))
+      jobs[i].state = JOB_OVERLAY;
+    else
+      disk++;
+  }
+  int nthreads = ws->index_threads > 0 ? ws->index_threads : spt_cpu_count();
+  if (nthreads > 8 && ws->index_threads <= 0)
+    nthreads = 8; /* 解析以内存分配为主，更多线程收益有限 */
+  if (nthreads > disk)
+    nthreads = disk;
+  if (jobs && old) {
+    IndexPool pool;
+    pool.jobs = jobs;
+    pool.count = pl.count;
+    pool.old = old;
+    pool.next = 0;
+    run_pool(&pool, nthreads);
+  }
+
+  /* 合并：按遍历顺序并入，复用的事实从旧表移入新表。 */
+  FactTable fresh;
+  fact_table_init(&fresh);
+  ws->index_parsed = ws->index_reused = 0;
+  int changed = need_save;
+  for (int i = 0; jobs && i < pl.count; i++) {
+    IndexJob *j = &jobs[i];
+    char uri[4096];
+    spt_path_to_uri(j->path, uri, sizeof uri);
+    FileFacts *of = old ? fact_table_get(old, j->path) : NULL;
+    if (j->state == JOB_OVERLAY) {
+      index_overlay_doc(ws, doc_store_get((DocStore *)ws->overlay, uri), uri, 1);
+      if (of) /* 磁盘版本的事实保留到下次（打开文档不入缓存） */
+        fact_table_put(&fresh, of);
+      continue;
+    }
+    if (j->state == JOB_MISSING)
+      continue;
+    FileFacts *f = &j->facts;
+    if (j->state == JOB_PARSED) {
+      ws->index_parsed++;
+      changed = 1;
+    } else {
+      ws->index_reused++;
+      f = of;
+      changed |= j->state == JOB_SAME_HASH;
+    }
+    /* 太新的 mtime 不可信（见 FACTS_RACY_SECS）：下次改为比较哈希。 */
+    f->mtime = j->mtime > started - FACTS_RACY_SECS ? FACTS_MTIME_RACY : j->mtime;
+    f->size = j->size;
+    merge_facts(ws, f, uri, 1);
+    fact_table_put(&fresh, f);
+  }
+  if (old) {
+    /* 有文件被删除（旧表条目未被移走）也需要重写缓存。 */
+    for (int i = 0; i < old->count && !changed; i++)
+      changed = old->files[i].path != NULL;
+    fact_table_free(old);
+    *old = fresh;
+  } else {
+    fact_table_free(&fresh);
+  }
+  if (ws->cache_path && old && changed)
+    workspace_save_index_cache(ws);
+
+  for (int i = 0; jobs && i < pl.count; i++)
+    facts_free(&jobs[i].facts);
+  free(jobs);
+  for (int i = 0; i < pl.count; i++)
+    free(pl.paths[i]);
+  free(pl.paths);
   ws->indexed = 1;
   ws->dirty = 0;
 }
 
+/* 创建缓存文件所在目录（单层；父目录需已存在）。 */
+static void ensure_parent_dir(const char *path) {
+  char dir[4096];
+  snprintf(dir, sizeof dir, "%s", path);
+  char *slash = strrchr(dir, '/');
+#ifdef _WIN32
+  char *bslash = strrchr(dir, '\\');
+  if (!slash || (bslash && bslash > slash))
+    slash = bslash;
+#endif
+  if (!slash || slash == dir)
+    return;
+  *slash = '\0';
+#ifdef _WIN32
+  CreateDirectoryA(dir, NULL);
+#else
+  mkdir(dir, 0755);
+#endif
+}
+
+int workspace_save_index_cache(Workspace *ws) {
+  if (!ws->cache_path || !ws->facts)
+    return 0;
+  ensure_parent_dir(ws->cache_path);
+  return fact_table_save((const FactTable *)ws->facts, ws->cache_path);
+}
+
 /* ---- 查询 ---- */
 static int ci_contains(const char *hay, const char *needle) {
   if (!needle || !needle[0])
@@ -465,26 +804,46 @@ static int ci_contains(const char *hay, const char *needle) {
   return 0;
 }
 
-cJSON *workspace_symbols(Workspace *ws, const char *query) {
+void workspace_ensure_index(Workspace *ws) {
   if (!ws->indexed || ws->dirty)
     workspace_index(ws);
-  cJSON *arr = cJSON_CreateArray();
+}
+
+void workspace_symbols_write(Workspace *ws, const char *query, JsonWriter *w) {
+  workspace_ensure_index(ws);
+  jw_begin_array(w);
   for (int i = 0; i < ws->sym_count; i++) {
     WsSymbol *s = &ws->syms[i];
     if (!ci_contains(s->name, query))
       continue;
-    cJSON *si = cJSON_CreateObject();
-    cJSON_AddStringToObject(si, "name", s->name);
-    cJSON_AddNumberToObject(si, "kind", s->kind);
-    cJSON *loc = cJSON_CreateObject();
-    cJSON_AddStringToObject(loc, "uri", s->uri);
-    cJSON_AddItemToObject(loc, "range", lsp_range_to_json(s->range));
-    cJSON_AddItemToObject(si, "location", loc);
-    if (s->container)
-      cJSON_AddStringToObject(si, "containerName", s->container);
-    cJSON_AddItemToArray(arr, si);
+    jw_begin_object(w);
+    jw_key(w, "name");
+    jw_string(w, s->name);
+    jw_key(w, "kind");
+    jw_int(w, s->kind);
+    jw_key(w, "location");
+    jw_begin_object(w);
+    jw_key(w, "uri");
+    jw_string(w, s->uri);
+    jw_key(w, "range");
+    lsp_range_write(w, s->range);
+    jw_end_object(w);
+    if (s->container) {
+      jw_key(w, "containerName");
+      jw_string(w, s->container);
+    }
+    jw_end_object(w);
   }
-  return arr;
+  jw_end_array(w);
+}
+
+cJSON *workspace_symbols(Workspace *ws, const char *query) {
+  JsonWriter w;
+  jw_init(&w);
+  workspace_symbols_write(ws, query, &w);
+  cJSON *arr = jw_parse(&w);
+  jw_free(&w);
+  return arr ? arr : cJSON_CreateArray();
 }
 
 /* ---- 跨文件 import 解析 ---- */
@@ -527,66 +886,97 @@ static long read_file_all(const char *path, char **out_buf) {
   return (long)rd;
 }
 
+/* 估计一个缓存 unit 的常驻内存。 */
+static size_t unit_cost(const SptLspUnit *u, const Document *temp_doc) {
+  size_t n = sizeof(SptLspUnit);
+  if (u) {
+    n += spt_arena_bytes_used((const SptArena *)u->arena);
+    if (u->own_source)
+      n += u->source_len + 1 + sizeof(SptToken) * (size_t)u->token_count;
+  }
+  if (temp_doc)
+    n += doc_bytes(temp_doc);
+  return n;
+}
+
 WsUnit workspace_get_unit(Workspace *ws, const char *path) {
   WsUnit r = {NULL, NULL};
   if (!path)
     return r;
 
-  /* 该路径是否在 overlay 中打开？决定文本来源与 doc 归属。 */
+  /* 该路径是否在 overlay 中打开？决定文本来源与 doc 归属。overlay 与缓存共用驻留 id。 */
   char uri[4096];
   spt_path_to_uri(path, uri, sizeof uri);
-  Document *od = ws->overlay ? doc_store_get((DocStore *)ws->overlay, uri) : NULL;
-
-  /* 查缓存（overlay 与 disk 共用 path 键）。 */
-  for (int i = 0; i < ws->unit_count; i++) {
-    if (strcmp(ws->units[i].path, path) == 0) {
-      if (ws->units[i].parsing)
-        return r; /* 防环 */
-      r.unit = ws->units[i].unit;
-      r.doc = od ? od : ws->units[i].temp_doc;
-      return r;
-    }
+  int id = uri_table_intern(ws->uris, uri);
+  if (id < 0)
+    return r;
+  Document *od = ws->overlay ? doc_store_get_id(ws->overlay, id) : NULL;
+
+  /* 查缓存（overlay 与 disk 共用 uri 键）。 */
+  int hit = unit_index(ws, id);
+  if (hit >= 0) {
+    if (ws->units[hit].parsing)
+      return r; /* 防环 */
+    ws->units[hit].used = ++ws->unit_clock;
+    r.unit = ws->units[hit].unit;
+    r.doc = od ? od : ws->units[hit].temp_doc;
+    return r;
   }
 
   /* 未缓存：取文本（overlay 优先，否则磁盘）。 */
   const char *text = NULL;
   size_t text_len = 0;
-  char *buf = NULL;
   Document *owned = NULL;
   if (od) {
-    text = od->text;
+    text = doc_text(od);
     text_len = od->text_len;
   } else {
+    char *buf = NULL;
     long sz = read_file_all(path, &buf);
     if (sz < 0)
       return r;
     /* 构造独立 Document（LF 规范化 + 行索引）。 */
-    DocStore tmp;
-    doc_store_init(&tmp);
-    Document *td = doc_store_open(&tmp, uri, buf, (size_t)sz, 0);
+    owned = doc_new(uri, buf, (size_t)sz, 0);
     free(buf);
-    if (!td)
+    if (!owned)
       return r;
-    owned = td;
-    free(tmp.docs); /* 释放 Document* 数组壳，保留 td 本体 */
-    doc_store_init(&tmp);
-    text = owned->text;
+    text = doc_text(owned);
     text_len = owned->text_len;
   }
 
-  /* 扩容缓存数组。 */
+  /* 扩容缓存数组与 id 映射。 */
+  if (id >= ws->unit_of_cap) {
+    int nc = ws->unit_of_cap ? ws->unit_of_cap : 64;
+    while (nc <= id)
+      nc *= 2;
+    int *no = (int *)realloc(ws->unit_of, sizeof(int) * (size_t)nc);
+    if (!no) {
+      doc_free(owned);
+      return r;
+    }
+    memset(no + ws->unit_of_cap, 0, sizeof(int) * (size_t)(nc - ws->unit_of_cap));
+    ws->unit_of = no;
+    ws->unit_of_cap = nc;
+  }
   if (ws->unit_count >= ws->unit_cap) {
     ws->unit_cap = ws->unit_cap ? ws->unit_cap * 2 : 8;
     ws->units = (void *)realloc(ws->units, sizeof(ws->units[0]) * (size_t)ws->unit_cap);
   }
   int idx = ws->unit_count++;
-  ws->units[idx].path = dupz(path);
+  ws->unit_of[id] = idx + 1;
+  ws->units[idx].uri = id;
   ws->units[idx].parsing = 1;
   ws->units[idx].temp_doc = owned; /* disk 文件才拥有；overlay 时为 NULL */
-  ws->units[idx].unit = spt_lsp_parse(text, text_len);
+  ws->units[idx].bytes = 0;
+  SptLspUnit *u = spt_lsp_parse(text, text_len);
+  /* 解析期间不会重入本函数，idx 仍有效。 */
+  ws->units[idx].unit = u;
   ws->units[idx].parsing = 0;
+  ws->units[idx].used = ++ws->unit_clock;
+  ws->units[idx].bytes = unit_cost(u, owned);
+  ws->unit_bytes += ws->units[idx].bytes;
 
-  r.unit = ws->units[idx].unit;
+  r.unit = u;
   r.doc = od ? od : owned;
   return r;
 }
@@ -613,8 +1003,6 @@ static void ref_index_init(RefIndex *ri, int cap) {
 
 static void ref_bucket_free(RefBucket *b) {
   free(b->name);
-  for (int i = 0; i < b->occ_count; i++)
-    free(b->occs[i].uri);
   free(b->occs);
   b->name = NULL;
   b->occs = NULL;
@@ -674,16 +1062,15 @@ static RefBucket *ref_index_get_or_create(RefIndex *ri, const char *name) {
   return &ri->slots[insert_k];
 }
 
-static void ref_index_add(RefIndex *ri, const char *name, const char *uri, size_t offset,
-                          int length) {
-  if (!name || !uri)
+static void ref_index_add(RefIndex *ri, const char *name, int uri, size_t offset, int length) {
+  if (!name || uri < 0)
     return;
   RefBucket *b = ref_index_get_or_create(ri, name);
   if (b->occ_count >= b->occ_cap) {
     b->occ_cap = b->occ_cap ? b->occ_cap * 2 : 8;
     b->occs = (RefOcc *)realloc(b->occs, sizeof(RefOcc) * (size_t)b->occ_cap);
   }
-  b->occs[b->occ_count].uri = dupz(uri);
+  b->occs[b->occ_count].uri = uri;
   b->occs[b->occ_count].offset = offset;
   b->occs[b->occ_count].length = length;
   b->occ_count++;
@@ -703,8 +1090,15 @@ static const RefBucket *ref_index_lookup(const RefIndex *ri, const char *name) {
 
 /* Phase 5d: 移除指定 URI 的所有引用出现。空桶标记为墓碑（name=""），
    保持开放寻址探测链不断裂。get_or_create / lookup 均跳过墓碑。 */
-static void ref_index_remove_uri(RefIndex *ri, const char *uri) {
-  if (!ri->slots || !uri)
+static void ref_index_remove_uri(RefIndex *ri, int uri) {
+  ref_index_edit_uri(ri, uri, 0, (size_t)-1, (size_t)-1);
+}
+
+/* 按一次编辑修补指定 URI 的引用出现：偏移落在 [start, old_end) 的移除，>= old_end 的
+   平移到 new_end 起算。ref_index_remove_uri 即整段区间的特例。 */
+static void ref_index_edit_uri(RefIndex *ri, int uri, size_t start, size_t old_end,
+                               size_t new_end) {
+  if (!ri->slots || uri < 0)
     return;
   for (int i = 0; i < ri->capacity; i++) {
     RefBucket *b = &ri->slots[i];
@@ -713,13 +1107,15 @@ static void ref_index_remove_uri(RefIndex *ri, const char *uri) {
     /* 过滤掉匹配 URI 的出现，保留其余。 */
     int w = 0;
     for (int j = 0; j < b->occ_count; j++) {
-      if (strcmp(b->occs[j].uri, uri) == 0) {
-        free(b->occs[j].uri);
-      } else {
-        if (w != j)
-          b->occs[w] = b->occs[j];
-        w++;
-      }
+      RefOcc *o = &b->occs[j];
+      int same = o->uri == uri;
+      if (same && o->offset >= start && o->offset < old_end)
+        continue;
+      if (same && o->offset >= old_end)
+        o->offset = o->offset - old_end + new_end;
+      if (w != j)
+        b->occs[w] = b->occs[j];
+      w++;
     }
     b->occ_count = w;
     /* 若桶空了，转为墓碑（name=""），探测链不断裂。 */
@@ -862,52 +1258,35 @@ static void dep_graph_remove_uri(DepGraph *dg, const char *uri) {
 
 /* ---- 索引构建：在 index_file 中调用 ---- */
 
-/* 扫描 unit 的标识符 token，加入引用倒排索引。 */
-static void index_ref_tokens(Workspace *ws, const SptLspUnit *u, const char *uri,
-                             const Document *d) {
-  if (!u || !d)
-    return;
+/* 增量修补引用倒排：uri 对应的打开文档刚做过一次增量重解析（doc_cache.h 的 last），且工作区
+   索引的正是重解析前的单元时，移除/平移片段内外的旧出现并只收录片段内的新标识符 token。
+   返回 1 表示已修补；0 表示不衔接（调用方按文件重建）。 */
+static int patch_doc_refs(Workspace *ws, const char *uri) {
+  Document *od = ws->overlay ? doc_store_get((DocStore *)ws->overlay, uri) : NULL;
+  if (!od || !od->cache)
+    return 0;
+  const SptLspUnit *u = doc_unit(od);
+  DocCache *c = od->cache;
+  if (!u || !c->last_from_gen || c->ws_gen != c->last_from_gen || c->gen != c->last_from_gen + 1)
+    return 0;
   RefIndex *ri = (RefIndex *)ws->ref_idx;
-  if (!ri)
-    return;
-  for (int ti = 0; ti < u->token_count; ti++) {
+  const SptLspReparse *r = &c->last;
+  int id = uri_table_intern(ws->uris, uri);
+  ref_index_edit_uri(ri, id, r->start, r->old_end, r->new_end);
+  for (int ti = r->first_tok; ti < r->first_tok + r->new_toks && ti < u->token_count; ti++) {
     const SptToken *t = &u->tokens[ti];
     if (t->kind != TOK_IDENTIFIER || t->length <= 0)
       continue;
-    /* token 的 line/column 是 1 起；转为字节偏移。 */
-    int li = t->line - 1;
-    if (li < 0 || li >= d->line_count)
-      continue;
-    size_t off = d->line_starts[li] + (size_t)(t->column > 0 ? t->column - 1 : 0);
-    /* 用 lexeme 做 name（NUL 结尾由 lexer 保证）。 */
     char nm[256];
     int nl = t->length;
     if (nl >= (int)sizeof nm)
       nl = (int)sizeof nm - 1;
     memcpy(nm, t->lexeme, (size_t)nl);
     nm[nl] = '\0';
-    ref_index_add(ri, nm, uri, off, t->length);
-  }
-}
-
-/* 扫描 unit 的顶层 import 语句，加入模块依赖图。 */
-static void index_imports(Workspace *ws, const SptLspUnit *u, const char *uri) {
-  if (!u || !u->root || u->root->type != NODE_BLOCK)
-    return;
-  DepGraph *dg = (DepGraph *)ws->dep_graph;
-  if (!dg)
-    return;
-  const AstList *st = &u->root->u.block.statements;
-  for (int i = 0; i < st->count; i++) {
-    AstNode *s = st->items[i];
-    const char *mod = NULL;
-    if (s->type == NODE_IMPORT_NAMESPACE)
-      mod = s->u.import_ns.module_path;
-    else if (s->type == NODE_IMPORT_NAMED)
-      mod = s->u.import_named.module_path;
-    if (mod)
-      dep_graph_add(dg, mod, uri);
+    ref_index_add(ri, nm, id, (size_t)(t->lexeme - u->source), t->length);
   }
+  c->ws_gen = c->gen;
+  return 1;
 }
 
 /* ---- 公开查询函数 ---- */
@@ -920,7 +1299,7 @@ int workspace_find_occurrences(Workspace *ws, const char *name, RefOccCb cb, voi
   if (!b)
     return 0;
   for (int i = 0; i < b->occ_count; i++)
-    cb(ctx, b->occs[i].uri, b->occs[i].offset, b->occs[i].length);
+    cb(ctx, uri_table_str(ws->uris, b->occs[i].uri), b->occs[i].offset, b->occs[i].length);
   return b->occ_count;
 }
 
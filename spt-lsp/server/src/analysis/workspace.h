@@ -7,6 +7,10 @@
 **
 ** 取舍：索引优先用打开文档（未保存改动）的文本覆盖磁盘内容；didOpen/didChange/didClose
 ** 标记索引脏，下次 workspace/symbol 查询时懒重建。
+**
+** 索引缓存：每个磁盘文件的贡献（符号 / 引用 token / import）作为"事实"保存在事实表里
+** （index_store.h），按 mtime + 大小 + 内容哈希失效；重建时只解析变化的文件，且解析在
+** 线程池上并行，主线程按文件顺序合并。事实表可持久化，服务器启动时载入。
 */
 #ifndef SPT_LSP_WORKSPACE_H
 #define SPT_LSP_WORKSPACE_H
@@ -18,6 +22,8 @@
 
 #include <stddef.h>
 
+#define WS_UNIT_BUDGET_DEFAULT ((size_t)64 << 20) /* 目标文件解析缓存默认上限 64 MiB */
+
 typedef struct {
   char *name;
   int kind;        /* LSP SymbolKind */
@@ -42,18 +48,36 @@ typedef struct {
   int dirty;               /* 打开文档变更后置位，下次查询时重建索引 */
   const DocStore *overlay; /* 打开文档覆盖层：索引时优先用打开文档的文本，可空 */
 
-  /* 目标文件解析缓存（跨文件 import 解析用）。dirty 时整体失效。 */
+  UriTable *uris; /* URI 驻留表（持有引用）：设置 overlay 后与之共用，id 两边一致 */
+
+  /* 目标文件解析缓存（跨文件 import 解析用），uri id 直接下标定位。dirty 时整体失效；
+     估计占用超过 unit_budget 时由 workspace_trim_units 按最近最少使用淘汰。 */
   struct {
-    char *path;         /* 拥有，缓存键（本地路径） */
-    SptLspUnit *unit;   /* 拥有；disk 文件的解析结果 */
+    int uri;            /* 驻留 id（缓存键） */
+    SptLspUnit *unit;   /* 拥有 */
     Document *temp_doc; /* 拥有；disk 文件的临时 Document（非 overlay 时） */
     int parsing;        /* 正在解析标记（防环） */
+    size_t bytes;       /* 估计占用：arena + 临时文档的文本与行索引 */
+    unsigned long long used; /* 最近一次取用时的 unit_clock */
   } *units;
-
   int unit_count, unit_cap;
+  int *unit_of; /* uri id -> units 下标 + 1，0 = 未缓存 */
+  int unit_of_cap;
+  size_t unit_bytes;  /* 全部缓存 unit 的估计占用 */
+  size_t unit_budget; /* 占用上限（字节）；0 = 不限 */
+  unsigned long long unit_clock;
+
   /* Phase 5b/5c: 引用倒排索引 + 模块依赖图（内部实现，opaque）。 */
   void *ref_idx;   /* RefIndex* */
   void *dep_graph; /* DepGraph* */
+
+  /* 逐文件索引事实（index_store.h 的 FactTable*，opaque）：跨次 workspace_index 复用，
+     并可持久化到 cache_path。 */
+  void *facts;
+  char *cache_path;        /* 磁盘缓存路径；NULL = 只在内存中复用 */
+  int index_threads;       /* 并行解析线程数；<= 0 = 按 CPU 数（至多 8） */
+  unsigned index_parsed;   /* 最近一次 workspace_index 实际解析的文件数 */
+  unsigned index_reused;   /* 其中复用缓存事实（未解析）的文件数 */
 } Workspace;
 
 void workspace_init(Workspace *ws);
@@ -64,7 +88,8 @@ void workspace_add_root_uri(Workspace *ws, const char *root_uri);
 /* 直接增加一个文件系统根目录路径。 */
 void workspace_add_root_path(Workspace *ws, const char *path);
 
-/* 设置打开文档覆盖层（索引时优先用打开文档的文本而非磁盘）。 */
+/* 设置打开文档覆盖层（索引时优先用打开文档的文本而非磁盘），并改用其 URI 驻留表；
+   已建的索引随之标记为脏。 */
 void workspace_set_overlay(Workspace *ws, const DocStore *overlay);
 
 /* 标记索引脏（打开文档变更后调用），下次查询时懒重建；同时清空目标文件缓存。 */
@@ -74,11 +99,23 @@ void workspace_mark_dirty(Workspace *ws);
    其余文档复用缓存。若索引未建立或已脏，回退到 workspace_mark_dirty。 */
 void workspace_mark_doc_dirty(Workspace *ws, const char *uri);
 
-/* 扫描根目录并建立符号索引（可重复调用以重建）。 */
+/* 设置索引缓存文件路径（NULL/空串 = 不持久化）。下次 workspace_index 时载入。 */
+void workspace_set_index_cache(Workspace *ws, const char *path);
+
+/* 扫描根目录并建立符号索引（可重复调用以重建）。磁盘文件在线程池上并行解析；
+   mtime + 大小或内容哈希未变的文件直接复用缓存事实。有变化时写回 cache_path。 */
 void workspace_index(Workspace *ws);
 
+/* 把当前事实表写到 cache_path（必要时创建其所在目录）。成功返回 1。 */
+int workspace_save_index_cache(Workspace *ws);
+
+/* 索引未建立或已脏时（重）建索引。 */
+void workspace_ensure_index(Workspace *ws);
+
 /* workspace/symbol：返回匹配 query（子串，空串=全部）的 SymbolInformation[]。 */
 cJSON *workspace_symbols(Workspace *ws, const char *query);
+/* 同上，直接写入 w（大工作区不建 cJSON 树）。 */
+void workspace_symbols_write(Workspace *ws, const char *query, JsonWriter *w);
 
 /* 跨文件 import 解析：由 from_uri（当前文件 URI）+ module_name 解析目标文件 URI。
    写入 out_uri（需至少 4096 字节）。返回 1=解析成功，0=未找到。 */
@@ -89,9 +126,14 @@ int workspace_resolve_module(Workspace *ws, const char *from_uri, const char *mo
    - 若该文件在 overlay 中打开：用 overlay 文本解析（不缓存，每次重解析）。
    - 否则：读磁盘 + 解析 + 缓存（按 path），后续命中直接返回。
    - 防环：解析中再次请求同 path 返回 {NULL,NULL}。
-   返回的 unit/doc 在下次 workspace_mark_dirty 前有效。 */
+   返回的 unit/doc 在下次 workspace_mark_dirty / workspace_trim_units 前有效（一个请求内
+   取得的多个 unit 同时有效，淘汰只发生在请求之间）。 */
 WsUnit workspace_get_unit(Workspace *ws, const char *path);
 
+/* 目标文件缓存超出 unit_budget 时淘汰最久未用的 unit，直到回到上限以内。
+   服务器在两次请求之间调用。 */
+void workspace_trim_units(Workspace *ws);
+
 /* 工具：file:// URI <-> 本地路径（最小百分号解码/编码）。out 需足够大。 */
 void spt_uri_to_path(const char *uri, char *out, size_t cap);
 void spt_path_to_uri(const char *path, char *out, size_t cap);
@@ -5,6 +5,7 @@
 ** - outgoing：遍历函数体找所有调用 → CallHierarchyOutgoingCall[]
 ** - incoming：用倒排索引查"谁调用了此函数" → CallHierarchyIncomingCall[]
 */
+#include "doc_cache.h"
 #include "lsp_features.h"
 #include "semantic.h"
 #include "spt_lsp_bridge.h"
@@ -36,11 +37,12 @@ static cJSON *make_call_item(const SptLspUnit *u, const Document *d, const char
       li = 0;
     if (li >= d->line_count)
       continue;
-    size_t s = d->line_starts[li] + (size_t)(u->tokens[i].column > 0 ? u->tokens[i].column - 1 : 0);
+    size_t s =
+        doc_line_start(d, li) + (size_t)(u->tokens[i].column > 0 ? u->tokens[i].column - 1 : 0);
     /* 确认是函数声明处的名字（在 fn->loc 附近）。 */
     size_t decl_s = 0;
     if (fn->u.func_decl.body && fn->u.func_decl.body->type == NODE_BLOCK) {
-      decl_s = d->line_starts[fn->loc.line - 1 < d->line_count ? fn->loc.line - 1 : 0] +
+      decl_s = doc_line_start(d, fn->loc.line - 1 < d->line_count ? fn->loc.line - 1 : 0) +
                (size_t)(fn->loc.column > 0 ? fn->loc.column - 1 : 0);
     }
     /* 名字 token 应在声明起始之后、body 之前。 */
@@ -58,9 +60,8 @@ static cJSON *make_call_item(const SptLspUnit *u, const Document *d, const char
       fn->u.func_decl.body->u.block.use_end) {
     int eli = fn->u.func_decl.body->u.block.end_loc.line - 1;
     if (eli >= 0 && eli < d->line_count) {
-      range_end = d->line_starts[eli] + (size_t)(fn->u.func_decl.body->u.block.end_loc.column > 0
-                                                     ? fn->u.func_decl.body->u.block.end_loc.column
-                                                     : 0);
+      int ecol = fn->u.func_decl.body->u.block.end_loc.column;
+      range_end = doc_line_start(d, eli) + (size_t)(ecol > 0 ? ecol : 0);
     }
   }
 
@@ -75,7 +76,7 @@ static cJSON *make_call_item(const SptLspUnit *u, const Document *d, const char
 
 /* ---- prepareCallHierarchy ---- */
 cJSON *feature_prepare_call_hierarchy(const Document *d, LspPos pos, const char *uri) {
-  SptLspUnit *u = spt_lsp_parse(d->text, d->text_len);
+  const SptLspUnit *u = doc_unit(d);
   cJSON *arr = cJSON_CreateArray();
   if (!u)
     return arr;
@@ -92,7 +93,6 @@ cJSON *feature_prepare_call_hierarchy(const Document *d, LspPos pos, const char
     }
   }
 
-  spt_lsp_unit_free(u);
   return arr;
 }
 
@@ -206,7 +206,7 @@ static void outgoing_cb(void *ctx, const char *callee, size_t offset, int length
 }
 
 cJSON *feature_call_hierarchy_outgoing(const Document *d, const char *fn_name, Workspace *ws) {
-  SptLspUnit *u = spt_lsp_parse(d->text, d->text_len);
+  const SptLspUnit *u = doc_unit(d);
   cJSON *arr = cJSON_CreateArray();
   if (!u)
     return arr;
@@ -217,7 +217,6 @@ cJSON *feature_call_hierarchy_outgoing(const Document *d, const char *fn_name, W
     sem_outgoing_calls(u, fn, outgoing_cb, &c);
   }
 
-  spt_lsp_unit_free(u);
   return arr;
 }
 
@@ -248,7 +247,7 @@ static void incoming_occ_cb(void *ctx, const char *uri, size_t offset, int lengt
     int li = wu.unit->tokens[ti].line - 1;
     if (li < 0 || li >= wu.doc->line_count)
       continue;
-    size_t s = wu.doc->line_starts[li] +
+    size_t s = doc_line_start(wu.doc, li) +
                (size_t)(wu.unit->tokens[ti].column > 0 ? wu.unit->tokens[ti].column - 1 : 0);
     if (s != offset)
       continue;
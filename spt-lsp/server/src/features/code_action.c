@@ -5,6 +5,7 @@
 **     生成 CodeAction（quickfix）插入 "export " 前缀。
 **   - 仅处理文件级声明（is_module_root），不处理函数内局部变量。
 */
+#include "doc_cache.h"
 #include "lsp_features.h"
 #include "spt_ast.h"
 #include "spt_lsp_bridge.h"
@@ -58,12 +59,10 @@ static int check_export_missing(const AstNode *n, size_t off_s, size_t off_e, co
 }
 
 cJSON *feature_code_action(const Document *d, LspRange range) {
-  SptLspUnit *u = spt_lsp_parse(d->text, d->text_len);
+  const SptLspUnit *u = doc_unit(d);
   cJSON *arr = cJSON_CreateArray();
-  if (!u || !u->root) {
-    spt_lsp_unit_free(u);
+  if (!u || !u->root)
     return arr;
-  }
 
   size_t off_s = doc_offset_at(d, range.start);
   size_t off_e = doc_offset_at(d, range.end);
@@ -100,6 +99,5 @@ cJSON *feature_code_action(const Document *d, LspRange range) {
     cJSON_AddItemToArray(arr, action);
   }
 
-  spt_lsp_unit_free(u);
   return arr;
 }
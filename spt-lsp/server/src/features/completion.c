@@ -6,6 +6,7 @@
 ** Phase 4: snippet 增强——函数符号生成参数占位符调用模板，
 ** 关键字（class/declare/function/if/while/for/import）生成结构化模板。
 */
+#include "doc_cache.h"
 #include "lsp_features.h"
 #include "semantic.h"
 #include "spt_lsp_bridge.h"
@@ -172,8 +173,9 @@ static int recv_name(const char *text, size_t dot_pos, char *out, size_t cap) {
 }
 
 cJSON *feature_completion(const Document *d, LspPos pos, Workspace *ws) {
-  SptLspUnit *u = spt_lsp_parse(d->text, d->text_len);
+  const SptLspUnit *u = doc_unit(d);
   size_t off = doc_offset_at(d, pos);
+  const char *text = doc_text(d);
 
   /* 成员上下文：光标前（跳过空白）是否为 '.' 或 ':'。dot_pos 为点号字节位置。 */
   int member = 0;
@@ -181,7 +183,7 @@ cJSON *feature_completion(const Document *d, LspPos pos, Workspace *ws) {
   {
     size_t i = off;
     while (i > 0) {
-      char c = d->text[i - 1];
+      char c = text[i - 1];
       if (c == ' ' || c == '\t') {
         i--;
         continue;
@@ -199,7 +201,7 @@ cJSON *feature_completion(const Document *d, LspPos pos, Workspace *ws) {
     int handled = 0;
     if (ws && u) {
       char rn[256];
-      if (recv_name(d->text, dot_pos, rn, sizeof rn)) {
+      if (recv_name(text, dot_pos, rn, sizeof rn)) {
         char mp[256];
         if (sem_namespace_import_path(u, rn, mp, sizeof mp)) {
           char tgt_uri[4096];
@@ -218,7 +220,7 @@ cJSON *feature_completion(const Document *d, LspPos pos, Workspace *ws) {
     /* Phase 2: 接收者类型推断 → 只列该类成员。 */
     if (!handled && u) {
       char rn[256];
-      if (recv_name(d->text, dot_pos, rn, sizeof rn))
+      if (recv_name(text, dot_pos, rn, sizeof rn))
         handled = sem_members_of_receiver(u, d, rn, dot_pos, comp_cb, &c);
     }
     /* 兜底：全文件类成员 + declare 模块成员。 */
@@ -239,6 +241,5 @@ cJSON *feature_completion(const Document *d, LspPos pos, Workspace *ws) {
       cJSON_AddItemToArray(arr, it);
     }
   }
-  spt_lsp_unit_free(u);
   return arr;
 }
@@ -3,12 +3,13 @@
 ** Phase 6b: declare 块成员跳到同文件 declare 块内的声明处；
 ** 普通符号回退到 definition（SPT 无头文件/实现分离概念）。
 */
+#include "doc_cache.h"
 #include "lsp_features.h"
 #include "semantic.h"
 #include "spt_lsp_bridge.h"
 
 cJSON *feature_declaration(const Document *d, LspPos pos, const char *uri, Workspace *ws) {
-  SptLspUnit *u = spt_lsp_parse(d->text, d->text_len);
+  const SptLspUnit *u = doc_unit(d);
   size_t off = doc_offset_at(d, pos);
   cJSON *res = NULL;
 
@@ -31,6 +32,5 @@ cJSON *feature_declaration(const Document *d, LspPos pos, const char *uri, Works
     res = feature_definition(d, pos, uri, ws);
   }
 
-  spt_lsp_unit_free(u);
   return res;
 }
@@ -5,6 +5,7 @@
 ** 解析目标模块路径，在目标文件的导出符号中查找定义，返回目标文件 Location。
 ** 降级：路径解析失败/目标无此导出 -> 回退到当前文件结果（可能为 null）。
 */
+#include "doc_cache.h"
 #include "lsp_features.h"
 #include "semantic.h"
 #include "spt_lsp_bridge.h"
@@ -12,7 +13,7 @@
 #include <string.h>
 
 cJSON *feature_definition(const Document *d, LspPos pos, const char *uri, Workspace *ws) {
-  SptLspUnit *u = spt_lsp_parse(d->text, d->text_len);
+  const SptLspUnit *u = doc_unit(d);
   size_t off = doc_offset_at(d, pos);
   SemRef r = sem_resolve(u, d, off);
   cJSON *res = NULL;
@@ -56,6 +57,5 @@ cJSON *feature_definition(const Document *d, LspPos pos, const char *uri, Worksp
     cJSON_AddItemToObject(res, "range", lsp_range_to_json(doc_range(d, r.def_start, r.def_end)));
   }
 
-  spt_lsp_unit_free(u);
   return res;
 }
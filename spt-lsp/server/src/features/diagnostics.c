@@ -8,6 +8,7 @@
 */
 #include "diagnostics.h"
 
+#include "doc_cache.h"
 #include "protocol.h"
 #include "semantic.h"
 #include "spt_ast.h"
@@ -108,7 +109,7 @@ static void check_undefined_names(const SptLspUnit *u, const Document *d, cJSON
     if (li < 0)
       li = 0;
     if (li < d->line_count)
-      byte_off = d->line_starts[li] + (size_t)(t->column > 0 ? t->column - 1 : 0);
+      byte_off = doc_line_start(d, li) + (size_t)(t->column > 0 ? t->column - 1 : 0);
 
     SemRef r = sem_resolve(u, d, byte_off);
     if (r.found && !r.has_def && !r.is_member) {
@@ -265,7 +266,7 @@ static void arity_walk_block(ArityCtx *c, const AstNode *block) {
 cJSON *diagnostics_compute(const Document *d) {
   cJSON *arr = cJSON_CreateArray();
 
-  SptLspUnit *u = spt_lsp_parse(d->text, d->text_len);
+  const SptLspUnit *u = doc_unit(d);
   if (u) {
     /* 解析错误（来自前端容错解析）。 */
     for (int i = 0; i < u->diag_count; i++) {
@@ -293,7 +294,6 @@ cJSON *diagnostics_compute(const Document *d) {
       arity_walk_block(&ac, u->root);
     }
 
-    spt_lsp_unit_free(u);
   }
 
   cJSON *params = cJSON_CreateObject();
@@ -3,6 +3,7 @@
 ** Phase 6c: import 语句中的 "mod" 字符串字面量 → 可点击链接到目标文件。
 ** 遍历 token 数组找 `from "..."` 模式，用 workspace_resolve_module 解析目标路径。
 */
+#include "doc_cache.h"
 #include "lsp_features.h"
 #include "semantic.h"
 #include "spt_lsp_bridge.h"
@@ -12,7 +13,7 @@
 #include <string.h>
 
 cJSON *feature_document_link(const Document *d, const char *uri, Workspace *ws) {
-  SptLspUnit *u = spt_lsp_parse(d->text, d->text_len);
+  const SptLspUnit *u = doc_unit(d);
   cJSON *arr = cJSON_CreateArray();
   if (!u)
     return arr;
@@ -47,7 +48,7 @@ cJSON *feature_document_link(const Document *d, const char *uri, Workspace *ws)
       li = 0;
     if (li >= d->line_count)
       continue;
-    size_t s = d->line_starts[li] + (size_t)(t->column > 0 ? t->column - 1 : 0);
+    size_t s = doc_line_start(d, li) + (size_t)(t->column > 0 ? t->column - 1 : 0);
     size_t e = s + (size_t)t->length;
 
     cJSON *link = cJSON_CreateObject();
@@ -56,6 +57,5 @@ cJSON *feature_document_link(const Document *d, const char *uri, Workspace *ws)
     cJSON_AddItemToArray(arr, link);
   }
 
-  spt_lsp_unit_free(u);
   return arr;
 }
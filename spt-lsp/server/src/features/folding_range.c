@@ -4,6 +4,7 @@
 ** FoldingRange（起始行..结束行）。覆盖函数体、if/else/while/for/defer 体。
 ** class_decl 无 BLOCK 包裹，单独按首行..末成员末行折叠。
 */
+#include "doc_cache.h"
 #include "lsp_features.h"
 #include "spt_ast.h"
 #include "spt_lsp_bridge.h"
@@ -15,7 +16,7 @@ static size_t off_of_lc(const Document *d, int line1, int col1) {
     l = 0;
   if (l >= d->line_count)
     return d->text_len;
-  size_t off = d->line_starts[l] + (size_t)(col1 > 0 ? col1 - 1 : 0);
+  size_t off = doc_line_start(d, l) + (size_t)(col1 > 0 ? col1 - 1 : 0);
   if (off > d->text_len)
     off = d->text_len;
   return off;
@@ -120,12 +121,11 @@ static void fold_walk(const AstNode *n, const Document *d, FoldCtx *c) {
 }
 
 cJSON *feature_folding_range(const Document *d) {
-  SptLspUnit *u = spt_lsp_parse(d->text, d->text_len);
+  const SptLspUnit *u = doc_unit(d);
   cJSON *arr = cJSON_CreateArray();
   if (u && u->root) {
     FoldCtx c = {arr, d};
     fold_walk(u->root, d, &c);
   }
-  spt_lsp_unit_free(u);
   return arr;
 }
@@ -25,6 +25,7 @@ cJSON *feature_format(const Document *d, const cJSON *options) {
   }
 
   /* 生成格式化后的文本 */
+  const char *text = doc_text(d);
   size_t cap = d->text_len + d->text_len / 2 + 16;
   char *out = (char *)malloc(cap);
   size_t w = 0;
@@ -37,7 +38,7 @@ cJSON *feature_format(const Document *d, const cJSON *options) {
     /* 1. 计算前导白空的视觉列数 */
     int col = 0;
     while (i < d->text_len) {
-      char c = d->text[i];
+      char c = text[i];
       if (c == ' ') {
         col++;
         i++;
@@ -68,15 +69,15 @@ cJSON *feature_format(const Document *d, const cJSON *options) {
 
     /* 3. 拷贝行内容到行尾（含 \n），去行尾空白 */
     size_t content_write_start = w;
-    while (i < d->text_len && d->text[i] != '\n') {
-      out[w++] = d->text[i++];
+    while (i < d->text_len && text[i] != '\n') {
+      out[w++] = text[i++];
     }
     /* 去行尾空白 */
     while (w > content_write_start && (out[w - 1] == ' ' || out[w - 1] == '\t'))
       w--;
 
     /* 4. 拷贝换行符 */
-    if (i < d->text_len && d->text[i] == '\n') {
+    if (i < d->text_len && text[i] == '\n') {
       out[w++] = '\n';
       i++;
     }
@@ -90,7 +91,7 @@ cJSON *feature_format(const Document *d, const cJSON *options) {
   out[w++] = '\n';
 
   cJSON *res;
-  if (w == d->text_len && memcmp(out, d->text, w) == 0) {
+  if (w == d->text_len && memcmp(out, text, w) == 0) {
     res = cJSON_CreateArray(); /* 无变化 */
   } else {
     res = cJSON_CreateArray();
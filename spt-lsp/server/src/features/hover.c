@@ -3,6 +3,7 @@
 ** 单文件：sem_resolve 给出当前文件定义的签名/文档。
 ** 跨文件（Phase 1）：若点击处是 import 引入的名字，显示目标文件导出定义的签名/文档。
 */
+#include "doc_cache.h"
 #include "lsp_features.h"
 #include "semantic.h"
 #include "spt_lsp_bridge.h"
@@ -11,7 +12,7 @@
 #include <string.h>
 
 cJSON *feature_hover(const Document *d, LspPos pos, Workspace *ws) {
-  SptLspUnit *u = spt_lsp_parse(d->text, d->text_len);
+  const SptLspUnit *u = doc_unit(d);
   size_t off = doc_offset_at(d, pos);
   SemRef r = sem_resolve(u, d, off);
 
@@ -67,6 +68,5 @@ cJSON *feature_hover(const Document *d, LspPos pos, Workspace *ws) {
     cJSON_AddItemToObject(res, "contents", contents);
     cJSON_AddItemToObject(res, "range", lsp_range_to_json(doc_range(d, r.use_start, r.use_end)));
   }
-  spt_lsp_unit_free(u);
   return res;
 }
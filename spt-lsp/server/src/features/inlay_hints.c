@@ -6,6 +6,7 @@
 ** 实现：递归遍历 AST，找到所有 NODE_FUNCTION_CALL 节点，
 ** 解析被调用函数的形参列表，为每个实参生成 InlayHint。
 */
+#include "doc_cache.h"
 #include "lsp_features.h"
 #include "semantic.h"
 #include "spt_ast.h"
@@ -226,12 +227,11 @@ static void walk_block(HintCtx *c, const AstNode *block) {
 }
 
 cJSON *feature_inlay_hints(const Document *d, LspRange range, Workspace *ws) {
-  SptLspUnit *u = spt_lsp_parse(d->text, d->text_len);
+  const SptLspUnit *u = doc_unit(d);
   cJSON *hints = cJSON_CreateArray();
   if (u && u->root) {
     HintCtx c = {u, d, ws, hints, range};
     walk_block(&c, u->root);
   }
-  spt_lsp_unit_free(u);
   return hints;
 }
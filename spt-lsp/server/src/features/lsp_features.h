@@ -3,6 +3,9 @@
 **
 ** 约定：每个功能接收 Document（+ 需要的参数），内部容错解析，返回应放入响应
 ** result 的 cJSON（调用方拥有）。返回 NULL 表示 result 为 null。
+**
+** 结果可能很大的功能（语义高亮、引用）另有 *_write 版本，把 result 直接写入 JsonWriter，
+** 服务器热路径用它免去建树；cJSON 版本由写出的文本解析得到，两者输出一致。
 */
 #ifndef SPT_LSP_FEATURES_H
 #define SPT_LSP_FEATURES_H
@@ -26,6 +29,8 @@ cJSON *feature_definition(const Document *d, LspPos pos, const char *uri, Worksp
 /* textDocument/references -> Location[] */
 cJSON *feature_references(const Document *d, LspPos pos, const char *uri, int include_decl,
                           Workspace *ws);
+void feature_references_write(const Document *d, LspPos pos, const char *uri, int include_decl,
+                              Workspace *ws, JsonWriter *w);
 
 /* textDocument/completion -> CompletionItem[]
    ws 可空；非空时支持命名空间导入 m. 的成员补全来自目标文件导出。 */
@@ -43,8 +48,25 @@ cJSON *feature_prepare_rename(const Document *d, LspPos pos);
    ws 可空；非空时支持跨文件具名导入函数的签名帮助。 */
 cJSON *feature_signature_help(const Document *d, LspPos pos, Workspace *ws);
 
-/* textDocument/semanticTokens/full -> {data:int[]} */
-cJSON *feature_semantic_tokens_full(const Document *d);
+/* semanticTokens 的 delta 基线：每个文档最近一次 full/delta 结果及其 resultId。 */
+typedef struct SemTokStore SemTokStore;
+SemTokStore *semtok_store_new(void);
+void semtok_store_free(SemTokStore *st);
+/* 文档关闭时丢弃其基线；uri_id 为文档在 DocStore 驻留表中的 id（Document.uri_id）。
+   st 可为 NULL，uri_id 可为 -1。 */
+void semtok_store_forget(SemTokStore *st, int uri_id);
+
+/* textDocument/semanticTokens/full -> {resultId?, data:int[]}
+   st 可空；非空时记下结果作为该文档的 delta 基线并返回 resultId（独立文档不记基线）。 */
+cJSON *feature_semantic_tokens_full(const Document *d, SemTokStore *st);
+void feature_semantic_tokens_full_write(const Document *d, SemTokStore *st, JsonWriter *w);
+
+/* textDocument/semanticTokens/full/delta -> {resultId, edits:SemanticTokensEdit[]}
+   previous_id 与 st 中该文档的基线不符时退化为 full 结果（{resultId, data}）；
+   st 为 NULL 时总是回完整结果（不带 resultId）。 */
+cJSON *feature_semantic_tokens_delta(const Document *d, const char *previous_id, SemTokStore *st);
+void feature_semantic_tokens_delta_write(const Document *d, const char *previous_id,
+                                         SemTokStore *st, JsonWriter *w);
 
 /* 语义高亮图例（与 capabilities 中声明一致）。返回 token 类型名数组与修饰名数组。 */
 extern const char *const SPT_TOKEN_TYPES[];
@@ -96,5 +118,6 @@ cJSON *feature_range_formatting(const Document *d, LspRange range, const cJSON *
 
 /* textDocument/semanticTokens/range -> {data:int[]} */
 cJSON *feature_semantic_tokens_range(const Document *d, LspRange range);
+void feature_semantic_tokens_range_write(const Document *d, LspRange range, JsonWriter *w);
 
 #endif /* SPT_LSP_FEATURES_H */
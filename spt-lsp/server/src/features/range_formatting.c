@@ -25,9 +25,10 @@ cJSON *feature_range_formatting(const Document *d, LspRange range, const cJSON *
   size_t end_off = doc_offset_at(d, range.end);
 
   /* 对齐到行首/行尾。 */
-  while (start_off > 0 && d->text[start_off - 1] != '\n')
+  const char *text = doc_text(d);
+  while (start_off > 0 && text[start_off - 1] != '\n')
     start_off--;
-  while (end_off < d->text_len && d->text[end_off] != '\n')
+  while (end_off < d->text_len && text[end_off] != '\n')
     end_off++;
 
   if (start_off >= end_off)
@@ -43,7 +44,7 @@ cJSON *feature_range_formatting(const Document *d, LspRange range, const cJSON *
   while (i < end_off) {
     int col = 0;
     while (i < end_off) {
-      char c = d->text[i];
+      char c = text[i];
       if (c == ' ') {
         col++;
         i++;
@@ -67,20 +68,20 @@ cJSON *feature_range_formatting(const Document *d, LspRange range, const cJSON *
     }
 
     size_t content_write_start = w;
-    while (i < end_off && d->text[i] != '\n') {
-      out[w++] = d->text[i++];
+    while (i < end_off && text[i] != '\n') {
+      out[w++] = text[i++];
     }
     while (w > content_write_start && (out[w - 1] == ' ' || out[w - 1] == '\t'))
       w--;
 
-    if (i < end_off && d->text[i] == '\n') {
+    if (i < end_off && text[i] == '\n') {
       out[w++] = '\n';
       i++;
     }
   }
 
   cJSON *res;
-  if (w == seg_len && memcmp(out, d->text + start_off, w) == 0) {
+  if (w == seg_len && memcmp(out, text + start_off, w) == 0) {
     res = cJSON_CreateArray();
   } else {
     res = cJSON_CreateArray();
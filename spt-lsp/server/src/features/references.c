@@ -4,6 +4,7 @@
 ** 跨文件（Phase 3e）：若符号是导出定义或导入绑定，
 ** 扫描工作区中导入该符号的文件，收集所有匹配 token 的引用。
 */
+#include "doc_cache.h"
 #include "lsp_features.h"
 #include "semantic.h"
 #include "spt_lsp_bridge.h"
@@ -11,22 +12,29 @@
 
 #include <string.h>
 
+static void write_loc(JsonWriter *w, const char *uri, LspRange r) {
+  jw_begin_object(w);
+  jw_key(w, "uri");
+  jw_string(w, uri);
+  jw_key(w, "range");
+  lsp_range_write(w, r);
+  jw_end_object(w);
+}
+
 typedef struct {
-  cJSON *arr;
+  JsonWriter *w;
   const Document *d;
   const char *uri;
 } RefCtx;
 
 static void ref_cb(void *ctx, size_t start, size_t end) {
   RefCtx *c = (RefCtx *)ctx;
-  cJSON *loc = cJSON_CreateObject();
-  cJSON_AddStringToObject(loc, "uri", c->uri);
-  cJSON_AddItemToObject(loc, "range", lsp_range_to_json(doc_range(c->d, start, end)));
-  cJSON_AddItemToArray(c->arr, loc);
+  write_loc(c->w, c->uri, doc_range(c->d, start, end));
 }
 
-/* 在 wu 文件中扫描所有匹配 name 的标识符 token，写入 arr。 */
-static void collect_token_refs(const WsUnit *wu, const char *name, const char *uri, cJSON *arr) {
+/* 在 wu 文件中扫描所有匹配 name 的标识符 token，写入 w。 */
+static void collect_token_refs(const WsUnit *wu, const char *name, const char *uri,
+                               JsonWriter *w) {
   if (!wu->unit || !wu->doc)
     return;
   size_t nl = strlen(name);
@@ -41,21 +49,18 @@ static void collect_token_refs(const WsUnit *wu, const char *name, const char *u
       li = 0;
     if (li >= wu->doc->line_count)
       continue;
-    size_t s = wu->doc->line_starts[li] + (size_t)(t->column > 0 ? t->column - 1 : 0);
+    size_t s = doc_line_start(wu->doc, li) + (size_t)(t->column > 0 ? t->column - 1 : 0);
     size_t e = s + (size_t)t->length;
-    cJSON *loc = cJSON_CreateObject();
-    cJSON_AddStringToObject(loc, "uri", uri);
-    cJSON_AddItemToObject(loc, "range", lsp_range_to_json(doc_range(wu->doc, s, e)));
-    cJSON_AddItemToArray(arr, loc);
+    write_loc(w, uri, doc_range(wu->doc, s, e));
   }
 }
 
-cJSON *feature_references(const Document *d, LspPos pos, const char *uri, int include_decl,
-                          Workspace *ws) {
-  SptLspUnit *u = spt_lsp_parse(d->text, d->text_len);
+void feature_references_write(const Document *d, LspPos pos, const char *uri, int include_decl,
+                              Workspace *ws, JsonWriter *w) {
+  const SptLspUnit *u = doc_unit(d);
   size_t off = doc_offset_at(d, pos);
-  cJSON *arr = cJSON_CreateArray();
-  RefCtx c = {arr, d, uri};
+  jw_begin_array(w);
+  RefCtx c = {w, d, uri};
   sem_references(u, d, off, include_decl, ref_cb, &c);
 
   /* 跨文件引用：扫描工作区中导入该符号的文件。 */
@@ -83,11 +88,11 @@ cJSON *feature_references(const Document *d, LspPos pos, const char *uri, int in
         spt_uri_to_path(def_uri, def_path, sizeof def_path);
         WsUnit def_wu = workspace_get_unit(ws, def_path);
         if (def_wu.unit && def_wu.doc)
-          collect_token_refs(&def_wu, r.name, def_uri, arr);
+          collect_token_refs(&def_wu, r.name, def_uri, w);
       }
 
       /* 扫描工作区中所有文件，找出导入此符号的文件。 */
-      workspace_symbols(ws, ""); /* 触发懒构建 */
+      workspace_ensure_index(ws);
       for (int i = 0; i < ws->sym_count; i++) {
         const char *other_uri = ws->syms[i].uri;
         if (!other_uri)
@@ -119,11 +124,19 @@ cJSON *feature_references(const Document *d, LspPos pos, const char *uri, int in
         if (strcmp(tgt_uri, target_uri) != 0)
           continue;
 
-        collect_token_refs(&wu, r.name, other_uri, arr);
+        collect_token_refs(&wu, r.name, other_uri, w);
       }
     }
   }
+  jw_end_array(w);
+}
 
-  spt_lsp_unit_free(u);
-  return arr;
+cJSON *feature_references(const Document *d, LspPos pos, const char *uri, int include_decl,
+                          Workspace *ws) {
+  JsonWriter w;
+  jw_init(&w);
+  feature_references_write(d, pos, uri, include_decl, ws, &w);
+  cJSON *arr = jw_parse(&w);
+  jw_free(&w);
+  return arr ? arr : cJSON_CreateArray();
 }
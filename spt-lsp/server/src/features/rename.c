@@ -5,6 +5,7 @@
 **   2. 重命名导入的符号：解析目标模块，在定义文件中改名，并扫描其他导入者。
 ** 局部变量仅限当前文件（不会被 import）。
 */
+#include "doc_cache.h"
 #include "lsp_features.h"
 #include "semantic.h"
 #include "spt_lsp_bridge.h"
@@ -84,7 +85,7 @@ static int collect_token_edits(const WsUnit *wu, const char *name, const char *n
       li = 0;
     if (li >= wu->doc->line_count)
       continue;
-    s = wu->doc->line_starts[li] + (size_t)(t->column > 0 ? t->column - 1 : 0);
+    s = doc_line_start(wu->doc, li) + (size_t)(t->column > 0 ? t->column - 1 : 0);
     e = s + (size_t)t->length;
     cross_ref_cb(&cc, s, e);
     n++;
@@ -133,7 +134,7 @@ static void occ_uri_cb(void *ctx, const char *uri, size_t off, int len) {
 
 cJSON *feature_rename(const Document *d, LspPos pos, const char *uri, const char *new_name,
                       Workspace *ws) {
-  SptLspUnit *u = spt_lsp_parse(d->text, d->text_len);
+  const SptLspUnit *u = doc_unit(d);
   size_t off = doc_offset_at(d, pos);
   SemRef r = sem_resolve(u, d, off);
   cJSON *res = NULL;
@@ -170,7 +171,7 @@ cJSON *feature_rename(const Document *d, LspPos pos, const char *uri, const char
     }
 
     if (do_cross && ws) {
-      workspace_symbols(ws, ""); /* 触发懒构建 */
+      workspace_ensure_index(ws);
 
       /* 情况 B: 先在定义文件中改名（定义 + 所有引用）。 */
       if (def_uri[0] != '\0' && strcmp(def_uri, uri) != 0) {
@@ -257,6 +258,5 @@ cJSON *feature_rename(const Document *d, LspPos pos, const char *uri, const char
     res = cJSON_CreateObject();
     cJSON_AddItemToObject(res, "changes", changes);
   }
-  spt_lsp_unit_free(u);
   return res;
 }
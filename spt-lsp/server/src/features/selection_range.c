@@ -3,12 +3,13 @@
 ** 返回光标处标识符的区间（最内层 SelectionRange）。编辑器据此做"双击选词"式的
 ** 层级选区。v1 只返回标识符 token 区间；后续可叠加语句/函数/类外层区间。
 */
+#include "doc_cache.h"
 #include "lsp_features.h"
 #include "spt_ast.h"
 #include "spt_lsp_bridge.h"
 
 cJSON *feature_selection_range(const Document *d, LspPos pos) {
-  SptLspUnit *u = spt_lsp_parse(d->text, d->text_len);
+  const SptLspUnit *u = doc_unit(d);
   size_t off = doc_offset_at(d, pos);
   cJSON *res = NULL;
   if (u) {
@@ -21,7 +22,7 @@ cJSON *feature_selection_range(const Document *d, LspPos pos) {
         l = 0;
       if (l >= d->line_count)
         continue;
-      size_t s = d->line_starts[l] + (size_t)(t->column > 0 ? t->column - 1 : 0);
+      size_t s = doc_line_start(d, l) + (size_t)(t->column > 0 ? t->column - 1 : 0);
       size_t e = s + (size_t)t->length;
       if (off >= s && off <= e) {
         res = cJSON_CreateObject();
@@ -29,7 +30,6 @@ cJSON *feature_selection_range(const Document *d, LspPos pos) {
         break;
       }
     }
-    spt_lsp_unit_free(u);
   }
   if (!res) {
     /* 光标不在标识符上：返回单字符区间（合法降级）。 */
@@ -1,4 +1,13 @@
-/* semantic_tokens.c — textDocument/semanticTokens/full（标识符分类，补充 TextMate） */
+/*
+** semantic_tokens.c — textDocument/semanticTokens/full | full/delta | range（标识符分类，补充 TextMate）。
+**
+** 三个请求共用一次编码：标识符 token -> LSP 相对坐标五元组 (Δline, Δchar, len, type, 0)。
+** full 在给了 SemTokStore 时为每个文档记下结果与 resultId；full/delta 带上次的 resultId 来时，
+** 与新结果比较公共前缀 / 后缀，只回一条替换中间区段的编辑——相对坐标下，一处编辑只改动
+** 附近少数整数，大文件逐键不再整篇重发。range 只编码视口内的行。
+** 结果直接写入 JsonWriter（*_write）；cJSON 版本由写出的文本解析得到。
+*/
+#include "doc_cache.h"
 #include "lsp_features.h"
 #include "semantic.h"
 #include "spt_ast.h"
@@ -133,165 +142,276 @@ static void gather(const AstNode *root, NameSet *funcs, NameSet *classes) {
     fclose(dbg);
 }
 
-cJSON *feature_semantic_tokens_full(const Document *d) {
-  FILE *dbg = spt_open_log();
-  if (dbg) {
-    fprintf(dbg, "semtok: start, text_len=%zu line_count=%d\n", d->text_len, d->line_count);
-    fflush(dbg);
-  }
+/* ---- 编码 ---- */
 
-  SptLspUnit *u = spt_lsp_parse(d->text, d->text_len);
-  if (dbg) {
-    fprintf(dbg, "semtok: parsed, u=%p root=%p tokens=%d\n", (void *)u, u ? (void *)u->root : NULL,
-            u ? u->token_count : 0);
-    fflush(dbg);
+typedef struct {
+  int *v;
+  int n, cap;
+} IntBuf;
+
+static void ib_push5(IntBuf *b, int dl, int dc, int len, int type) {
+  if (b->n + 5 > b->cap) {
+    int nc = b->cap ? b->cap * 2 : 256;
+    int *nv = (int *)realloc(b->v, sizeof(int) * (size_t)nc);
+    if (!nv)
+      return;
+    b->v = nv;
+    b->cap = nc;
   }
+  int *p = b->v + b->n;
+  p[0] = dl;
+  p[1] = dc;
+  p[2] = len;
+  p[3] = type;
+  p[4] = 0;
+  b->n += 5;
+}
 
-  cJSON *data = cJSON_CreateArray();
-  if (u && u->root) {
-    NameSet funcs = {0}, classes = {0};
-    gather(u->root, &funcs, &classes);
-    if (dbg) {
-      fprintf(dbg, "semtok: gathered, funcs=%d classes=%d\n", funcs.n, classes.n);
-      fflush(dbg);
-    }
+/* 把 d 的标识符 token 编码进 out；range 非空时只取落在其中的 token。
+   token 按行有序：range 之前的行不做 UTF-16 换算，越过 range 末行即停。 */
+static void encode(const Document *d, const LspRange *range, IntBuf *out) {
+  const SptLspUnit *u = doc_unit(d);
+  if (!u || !u->root)
+    return;
+  NameSet funcs = {0}, classes = {0};
+  gather(u->root, &funcs, &classes);
 
-    int prev_line = 0, prev_char = 0;
-    for (int i = 0; i < u->token_count; i++) {
-      const SptToken *t = &u->tokens[i];
-      if (t->kind != TOK_IDENTIFIER)
-        continue;
-      int member =
-          (i > 0 && (u->tokens[i - 1].kind == TOK_DOT || u->tokens[i - 1].kind == TOK_COLON));
-      int type;
-      if (member)
-        type = TT_PROPERTY;
-      else if (ns_has(&funcs, t->lexeme, (size_t)t->length))
-        type = TT_FUNCTION;
-      else if (ns_has(&classes, t->lexeme, (size_t)t->length))
-        type = TT_CLASS;
-      else
-        type = TT_VARIABLE;
-
-      if (dbg && i < 20) {
-        fprintf(dbg, "semtok: tok[%d] lexeme=%s line=%d col=%d len=%d\n", i,
-                t->lexeme ? t->lexeme : "(null)", t->line, t->column, t->length);
-        fflush(dbg);
-      }
+  int prev_line = 0, prev_char = 0;
+  for (int i = 0; i < u->token_count; i++) {
+    const SptToken *t = &u->tokens[i];
+    if (t->kind != TOK_IDENTIFIER)
+      continue;
+    int l = t->line - 1;
+    if (l < 0)
+      l = 0;
+    if (range && l < range->start.line)
+      continue;
+    if (range && l > range->end.line)
+      break;
+    int member =
+        (i > 0 && (u->tokens[i - 1].kind == TOK_DOT || u->tokens[i - 1].kind == TOK_COLON));
+    int type;
+    if (member)
+      type = TT_PROPERTY;
+    else if (ns_has(&funcs, t->lexeme, (size_t)t->length))
+      type = TT_FUNCTION;
+    else if (ns_has(&classes, t->lexeme, (size_t)t->length))
+      type = TT_CLASS;
+    else
+      type = TT_VARIABLE;
 
-      /* LSP 坐标 + UTF-16 长度 */
-      int l = t->line - 1;
-      if (l < 0)
-        l = 0;
-      size_t base = (l < d->line_count) ? d->line_starts[l] : d->text_len;
-      size_t s = base + (size_t)(t->column > 0 ? t->column - 1 : 0);
-      if (s > d->text_len)
-        s = d->text_len;
-      size_t e = s + (size_t)t->length;
-      if (e > d->text_len)
-        e = d->text_len;
-      LspPos ps = doc_pos_at(d, s), pe = doc_pos_at(d, e);
-      int line = ps.line, ch = ps.character, len = pe.character - ps.character;
-      if (len <= 0)
-        len = t->length;
-
-      int dl = line - prev_line;
-      int dc = (dl == 0) ? ch - prev_char : ch;
-      prev_line = line;
-      prev_char = ch;
-
-      cJSON_AddItemToArray(data, cJSON_CreateNumber(dl));
-      cJSON_AddItemToArray(data, cJSON_CreateNumber(dc));
-      cJSON_AddItemToArray(data, cJSON_CreateNumber(len));
-      cJSON_AddItemToArray(data, cJSON_CreateNumber(type));
-      cJSON_AddItemToArray(data, cJSON_CreateNumber(0));
-    }
-    free(funcs.a);
-    free(classes.a);
-    if (dbg) {
-      fprintf(dbg, "semtok: loop done\n");
-      fflush(dbg);
+    /* LSP 坐标 + UTF-16 长度 */
+    size_t base = (l < d->line_count) ? doc_line_start(d, l) : d->text_len;
+    size_t s = base + (size_t)(t->column > 0 ? t->column - 1 : 0);
+    if (s > d->text_len)
+      s = d->text_len;
+    size_t e = s + (size_t)t->length;
+    if (e > d->text_len)
+      e = d->text_len;
+    LspPos ps = doc_pos_at(d, s), pe = doc_pos_at(d, e);
+    int line = ps.line, ch = ps.character, len = pe.character - ps.character;
+    if (len <= 0)
+      len = t->length;
+
+    if (range) {
+      if (line < range->start.line || line > range->end.line)
+        continue;
+      if (line == range->start.line && ch < range->start.character)
+        continue;
+      if (line == range->end.line && ch >= range->end.character)
+        continue;
     }
+
+    int dl = line - prev_line;
+    int dc = (dl == 0) ? ch - prev_char : ch;
+    prev_line = line;
+    prev_char = ch;
+    ib_push5(out, dl, dc, len, type);
+  }
+  free(funcs.a);
+  free(classes.a);
+}
+
+/* ---- delta 基线 ---- */
+
+typedef struct {
+  unsigned id; /* resultId（十进制文本形式发给客户端）；0 = 无基线 */
+  int *data;
+  int len;
+} SemTokBase;
+
+/* 以文档在 DocStore 驻留表中的 uri id 直接下标（id 稠密且存活到表释放，见 uri_table.h）。 */
+struct SemTokStore {
+  SemTokBase *by_id;
+  int cap;
+  unsigned next_id;
+};
+
+SemTokStore *semtok_store_new(void) { return (SemTokStore *)calloc(1, sizeof(SemTokStore)); }
+
+void semtok_store_free(SemTokStore *st) {
+  if (!st)
+    return;
+  for (int i = 0; i < st->cap; i++)
+    free(st->by_id[i].data);
+  free(st->by_id);
+  free(st);
+}
+
+/* uri_id 的基线；没有时返回 NULL。 */
+static SemTokBase *store_find(const SemTokStore *st, int uri_id) {
+  if (uri_id < 0 || uri_id >= st->cap || st->by_id[uri_id].id == 0)
+    return NULL;
+  return &st->by_id[uri_id];
+}
+
+void semtok_store_forget(SemTokStore *st, int uri_id) {
+  SemTokBase *e = st ? store_find(st, uri_id) : NULL;
+  if (!e)
+    return;
+  free(e->data);
+  memset(e, 0, sizeof(*e));
+}
+
+/* 以 b 作为 uri_id 的新基线（接管 b->v），返回分配的 resultId；
+   独立文档（uri_id < 0）或内存不足返回 0（不记基线）。 */
+static unsigned store_put(SemTokStore *st, int uri_id, IntBuf *b) {
+  if (uri_id < 0)
+    return 0;
+  if (uri_id >= st->cap) {
+    int nc = st->cap ? st->cap : 8;
+    while (nc <= uri_id)
+      nc *= 2;
+    SemTokBase *ni = (SemTokBase *)realloc(st->by_id, sizeof(SemTokBase) * (size_t)nc);
+    if (!ni)
+      return 0;
+    memset(ni + st->cap, 0, sizeof(SemTokBase) * (size_t)(nc - st->cap));
+    st->by_id = ni;
+    st->cap = nc;
   }
-  spt_lsp_unit_free(u);
+  SemTokBase *e = &st->by_id[uri_id];
+  free(e->data);
+  e->data = b->v;
+  e->len = b->n;
+  b->v = NULL;
+  b->n = b->cap = 0;
+  if (++st->next_id == 0)
+    st->next_id = 1;
+  e->id = st->next_id;
+  return e->id;
+}
+
+static void write_result_id(JsonWriter *w, unsigned id) {
+  if (id == 0)
+    return;
+  char buf[16];
+  snprintf(buf, sizeof buf, "%u", id);
+  jw_key(w, "resultId");
+  jw_string(w, buf);
+}
+
+/* 树形结果：由写出的文本解析得到（测试与内部调用方用；服务器热路径直接写出）。 */
+static cJSON *as_tree(JsonWriter *w) {
+  cJSON *res = jw_parse(w);
+  jw_free(w);
+  return res;
+}
+
+void feature_semantic_tokens_full_write(const Document *d, SemTokStore *st, JsonWriter *w) {
+  FILE *dbg = spt_open_log();
   if (dbg) {
-    fprintf(dbg, "semtok: unit freed\n");
+    fprintf(dbg, "semtok: start, text_len=%zu line_count=%d\n", d->text_len, d->line_count);
     fflush(dbg);
   }
-  cJSON *res = cJSON_CreateObject();
-  cJSON_AddItemToObject(res, "data", data);
+  IntBuf b = {0};
+  encode(d, NULL, &b);
+  jw_begin_object(w);
+  jw_key(w, "data");
+  jw_int_array(w, b.v, b.n);
+  if (st)
+    write_result_id(w, store_put(st, d->uri_id, &b));
+  jw_end_object(w);
+  free(b.v);
   if (dbg) {
     fprintf(dbg, "semtok: done\n");
     fflush(dbg);
     fclose(dbg);
   }
-  return res;
 }
 
-/* Phase 6e: semanticTokens/range — 只返回 range 内的 token。 */
-cJSON *feature_semantic_tokens_range(const Document *d, LspRange range) {
-  SptLspUnit *u = spt_lsp_parse(d->text, d->text_len);
-  cJSON *data = cJSON_CreateArray();
-  if (u && u->root) {
-    NameSet funcs = {0}, classes = {0};
-    gather(u->root, &funcs, &classes);
-
-    int prev_line = 0, prev_char = 0;
-    for (int i = 0; i < u->token_count; i++) {
-      const SptToken *t = &u->tokens[i];
-      if (t->kind != TOK_IDENTIFIER)
-        continue;
-      int member =
-          (i > 0 && (u->tokens[i - 1].kind == TOK_DOT || u->tokens[i - 1].kind == TOK_COLON));
-      int type;
-      if (member)
-        type = TT_PROPERTY;
-      else if (ns_has(&funcs, t->lexeme, (size_t)t->length))
-        type = TT_FUNCTION;
-      else if (ns_has(&classes, t->lexeme, (size_t)t->length))
-        type = TT_CLASS;
-      else
-        type = TT_VARIABLE;
-
-      int l = t->line - 1;
-      if (l < 0)
-        l = 0;
-      size_t base = (l < d->line_count) ? d->line_starts[l] : d->text_len;
-      size_t s = base + (size_t)(t->column > 0 ? t->column - 1 : 0);
-      if (s > d->text_len)
-        s = d->text_len;
-      size_t e = s + (size_t)t->length;
-      if (e > d->text_len)
-        e = d->text_len;
-      LspPos ps = doc_pos_at(d, s), pe = doc_pos_at(d, e);
-      int line = ps.line, ch = ps.character, len = pe.character - ps.character;
-      if (len <= 0)
-        len = t->length;
-
-      /* range 过滤：跳过 range 外的 token。 */
-      if (line < range.start.line || line > range.end.line)
-        continue;
-      if (line == range.start.line && ch < range.start.character)
-        continue;
-      if (line == range.end.line && ch >= range.end.character)
-        continue;
+cJSON *feature_semantic_tokens_full(const Document *d, SemTokStore *st) {
+  JsonWriter w;
+  jw_init(&w);
+  feature_semantic_tokens_full_write(d, st, &w);
+  return as_tree(&w);
+}
 
-      int dl = line - prev_line;
-      int dc = (dl == 0) ? ch - prev_char : ch;
-      prev_line = line;
-      prev_char = ch;
+void feature_semantic_tokens_delta_write(const Document *d, const char *previous_id,
+                                         SemTokStore *st, JsonWriter *w) {
+  SemTokBase *base = (previous_id && st) ? store_find(st, d->uri_id) : NULL;
+  char buf[16];
+  if (base) {
+    snprintf(buf, sizeof buf, "%u", base->id);
+    if (strcmp(buf, previous_id) != 0)
+      base = NULL;
+  }
+  if (!base) { /* 基线未知（重启 / 已被更新的结果取代 / 无基线表）：回完整结果 */
+    feature_semantic_tokens_full_write(d, st, w);
+    return;
+  }
 
-      cJSON_AddItemToArray(data, cJSON_CreateNumber(dl));
-      cJSON_AddItemToArray(data, cJSON_CreateNumber(dc));
-      cJSON_AddItemToArray(data, cJSON_CreateNumber(len));
-      cJSON_AddItemToArray(data, cJSON_CreateNumber(type));
-      cJSON_AddItemToArray(data, cJSON_CreateNumber(0));
-    }
-    free(funcs.a);
-    free(classes.a);
+  IntBuf b = {0};
+  encode(d, NULL, &b);
+  const int *old = base->data;
+  int old_len = base->len;
+  int pre = 0;
+  while (pre < old_len && pre < b.n && old[pre] == b.v[pre])
+    pre++;
+  int suf = 0;
+  while (suf < old_len - pre && suf < b.n - pre &&
+         old[old_len - 1 - suf] == b.v[b.n - 1 - suf])
+    suf++;
+
+  jw_begin_object(w);
+  jw_key(w, "edits");
+  jw_begin_array(w);
+  if (pre < old_len || pre < b.n) {
+    jw_begin_object(w);
+    jw_key(w, "start");
+    jw_int(w, pre);
+    jw_key(w, "deleteCount");
+    jw_int(w, old_len - pre - suf);
+    jw_key(w, "data");
+    jw_int_array(w, b.v + pre, b.n - pre - suf);
+    jw_end_object(w);
   }
-  spt_lsp_unit_free(u);
-  cJSON *res = cJSON_CreateObject();
-  cJSON_AddItemToObject(res, "data", data);
-  return res;
+  jw_end_array(w);
+  write_result_id(w, store_put(st, d->uri_id, &b)); /* 接管 b，old 自此失效 */
+  jw_end_object(w);
+  free(b.v);
+}
+
+cJSON *feature_semantic_tokens_delta(const Document *d, const char *previous_id, SemTokStore *st) {
+  JsonWriter w;
+  jw_init(&w);
+  feature_semantic_tokens_delta_write(d, previous_id, st, &w);
+  return as_tree(&w);
+}
+
+/* Phase 6e: semanticTokens/range — 只返回 range 内的 token。 */
+void feature_semantic_tokens_range_write(const Document *d, LspRange range, JsonWriter *w) {
+  IntBuf b = {0};
+  encode(d, &range, &b);
+  jw_begin_object(w);
+  jw_key(w, "data");
+  jw_int_array(w, b.v, b.n);
+  jw_end_object(w);
+  free(b.v);
+}
+
+cJSON *feature_semantic_tokens_range(const Document *d, LspRange range) {
+  JsonWriter w;
+  jw_init(&w);
+  feature_semantic_tokens_range_write(d, range, &w);
+  return as_tree(&w);
 }
@@ -3,6 +3,7 @@
 ** Phase 3: 跨文件签名帮助。若本地未找到函数，检查是否为具名导入，
 ** 解析目标模块并在其导出中查找函数签名。
 */
+#include "doc_cache.h"
 #include "lsp_features.h"
 #include "semantic.h"
 #include "spt_ast.h"
@@ -20,7 +21,7 @@ static size_t off_of_tok(const Document *d, const SptToken *t) {
     l = 0;
   if (l >= d->line_count)
     return d->text_len;
-  size_t o = d->line_starts[l] + (size_t)(t->column > 0 ? t->column - 1 : 0);
+  size_t o = doc_line_start(d, l) + (size_t)(t->column > 0 ? t->column - 1 : 0);
   return o > d->text_len ? d->text_len : o;
 }
 
@@ -38,9 +39,9 @@ static void sappend(char *b, size_t cap, size_t *p, const char *fmt, ...) {
 }
 
 cJSON *feature_signature_help(const Document *d, LspPos pos, Workspace *ws) {
-  SptLspUnit *u = spt_lsp_parse(d->text, d->text_len);
+  const SptLspUnit *u = doc_unit(d);
   size_t off = doc_offset_at(d, pos);
-  const char *txt = d->text;
+  const char *txt = doc_text(d);
 
   /* 向左找深度为 0 的未匹配 '('，记录其位置，并统计深度 0 的逗号数。 */
   int depth = 0, commas = 0;
@@ -145,6 +146,5 @@ cJSON *feature_signature_help(const Document *d, LspPos pos, Workspace *ws) {
       }
     }
   }
-  spt_lsp_unit_free(u);
   return res;
 }
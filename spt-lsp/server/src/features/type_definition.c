@@ -4,12 +4,13 @@
 ** 复用 sem_type_definition（基于 Phase 2 的 infer_class_from_def）。
 ** 推导失败（无类型注解/内建类型）→ 返回 null，客户端回退到 definition。
 */
+#include "doc_cache.h"
 #include "lsp_features.h"
 #include "semantic.h"
 #include "spt_lsp_bridge.h"
 
 cJSON *feature_type_definition(const Document *d, LspPos pos) {
-  SptLspUnit *u = spt_lsp_parse(d->text, d->text_len);
+  const SptLspUnit *u = doc_unit(d);
   size_t off = doc_offset_at(d, pos);
   SemRef r;
   cJSON *res = NULL;
@@ -19,6 +20,5 @@ cJSON *feature_type_definition(const Document *d, LspPos pos) {
     cJSON_AddItemToObject(res, "range", lsp_range_to_json(doc_range(d, r.def_start, r.def_end)));
   }
 
-  spt_lsp_unit_free(u);
   return res;
 }
@@ -0,0 +1,210 @@
+/*
+** diag_worker.c — 后台诊断线程实现。
+**
+** 待算任务按 uri 去重（每个 uri 至多一条，保存最新版本的文本快照），到期时间 = 最近一次
+** 登记 + debounce_ms。线程取到期最早的任务，在临时 DocStore 上计算诊断；计算期间若该 uri
+** 又被登记或关闭，则结果作废。推送在持锁时进行，保证 diag_worker_forget 返回后不再推送。
+*/
+#include "diag_worker.h"
+
+#include "diagnostics.h"
+#include "documents.h"
+#include "spt_rpc.h"
+#include "spt_thread.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  char *uri;
+  int version;
+  char *text;
+  size_t len;
+  long long due; /* spt_now_ms() 时间点 */
+} DiagJob;
+
+struct DiagWorker {
+  SptThread thread;
+  SptMutex mu;
+  SptCond cv; /* 任何状态变化都广播：新任务、完成、停止、flush */
+  int debounce_ms;
+  DiagEmitFn emit;
+  void *emit_ctx;
+
+  DiagJob *jobs;
+  int count, cap;
+  char *busy;     /* 正在计算的 uri（拥有）；NULL = 空闲 */
+  int busy_stale; /* 正在计算的版本已被新版本取代或文档已关闭 */
+  int flushing;   /* >0：忽略去抖，立即计算 */
+  int stop;
+
+  unsigned computed, dropped;
+};
+
+static void job_free(DiagJob *j) {
+  free(j->uri);
+  free(j->text);
+}
+
+static int find_job(DiagWorker *w, const char *uri) {
+  for (int i = 0; i < w->count; i++)
+    if (strcmp(w->jobs[i].uri, uri) == 0)
+      return i;
+  return -1;
+}
+
+static void remove_job(DiagWorker *w, int i) {
+  w->jobs[i] = w->jobs[--w->count]; /* 顺序无关：按到期时间挑选 */
+}
+
+static void worker_main(void *arg) {
+  DiagWorker *w = (DiagWorker *)arg;
+  spt_mutex_lock(&w->mu);
+  while (!w->stop) {
+    int pick = -1;
+    for (int i = 0; i < w->count; i++)
+      if (pick < 0 || w->jobs[i].due < w->jobs[pick].due)
+        pick = i;
+    if (pick < 0) {
+      spt_cond_wait(&w->cv, &w->mu);
+      continue;
+    }
+    long long wait = w->jobs[pick].due - spt_now_ms();
+    if (!w->flushing && wait > 0) {
+      spt_cond_wait_ms(&w->cv, &w->mu, (long)wait);
+      continue;
+    }
+    DiagJob job = w->jobs[pick];
+    remove_job(w, pick);
+    w->busy = job.uri;
+    w->busy_stale = 0;
+    spt_mutex_unlock(&w->mu);
+
+    /* 在线程私有的临时文档上计算，不触碰主线程状态。 */
+    Document *d = doc_new(job.uri, job.text, job.len, job.version);
+    cJSON *params = d ? diagnostics_compute(d) : NULL;
+    doc_free(d);
+
+    spt_mutex_lock(&w->mu);
+    w->computed++;
+    if (params && !w->busy_stale && !w->stop && w->emit) {
+      w->emit(w->emit_ctx, rpc_make_notification("textDocument/publishDiagnostics", params));
+    } else {
+      cJSON_Delete(params);
+      w->dropped++;
+    }
+    w->busy = NULL;
+    job_free(&job);
+    spt_cond_broadcast(&w->cv);
+  }
+  spt_mutex_unlock(&w->mu);
+}
+
+DiagWorker *diag_worker_start(int debounce_ms, DiagEmitFn emit, void *ctx) {
+  DiagWorker *w = (DiagWorker *)calloc(1, sizeof *w);
+  if (!w)
+    return NULL;
+  w->debounce_ms = debounce_ms < 0 ? 0 : debounce_ms;
+  w->emit = emit;
+  w->emit_ctx = ctx;
+  spt_mutex_init(&w->mu);
+  spt_cond_init(&w->cv);
+  if (!spt_thread_create(&w->thread, worker_main, w)) {
+    spt_cond_destroy(&w->cv);
+    spt_mutex_destroy(&w->mu);
+    free(w);
+    return NULL;
+  }
+  return w;
+}
+
+void diag_worker_stop(DiagWorker *w) {
+  if (!w)
+    return;
+  spt_mutex_lock(&w->mu);
+  w->stop = 1;
+  spt_cond_broadcast(&w->cv);
+  spt_mutex_unlock(&w->mu);
+  spt_thread_join(w->thread);
+  for (int i = 0; i < w->count; i++)
+    job_free(&w->jobs[i]);
+  free(w->jobs);
+  spt_cond_destroy(&w->cv);
+  spt_mutex_destroy(&w->mu);
+  free(w);
+}
+
+void diag_worker_schedule(DiagWorker *w, const char *uri, int version, const char *text,
+                          size_t len) {
+  char *copy = (char *)malloc(len + 1);
+  if (!copy)
+    return;
+  memcpy(copy, text, len);
+  copy[len] = '\0';
+
+  spt_mutex_lock(&w->mu);
+  int i = find_job(w, uri);
+  if (i >= 0) {
+    free(w->jobs[i].text); /* 旧版本尚未计算即被取代 */
+    w->dropped++;
+  } else {
+    char *u = (char *)malloc(strlen(uri) + 1);
+    if (w->count == w->cap) {
+      int nc = w->cap ? w->cap * 2 : 8;
+      DiagJob *nj = (DiagJob *)realloc(w->jobs, sizeof(DiagJob) * (size_t)nc);
+      if (nj) {
+        w->jobs = nj;
+        w->cap = nc;
+      }
+    }
+    if (!u || w->count == w->cap) {
+      free(u);
+      free(copy);
+      spt_mutex_unlock(&w->mu);
+      return;
+    }
+    strcpy(u, uri);
+    i = w->count++;
+    w->jobs[i].uri = u;
+  }
+  w->jobs[i].version = version;
+  w->jobs[i].text = copy;
+  w->jobs[i].len = len;
+  w->jobs[i].due = spt_now_ms() + w->debounce_ms;
+  if (w->busy && strcmp(w->busy, uri) == 0)
+    w->busy_stale = 1;
+  spt_cond_broadcast(&w->cv);
+  spt_mutex_unlock(&w->mu);
+}
+
+void diag_worker_forget(DiagWorker *w, const char *uri) {
+  spt_mutex_lock(&w->mu);
+  int i = find_job(w, uri);
+  if (i >= 0) {
+    job_free(&w->jobs[i]);
+    remove_job(w, i);
+    w->dropped++;
+  }
+  if (w->busy && strcmp(w->busy, uri) == 0)
+    w->busy_stale = 1;
+  spt_mutex_unlock(&w->mu);
+}
+
+void diag_worker_flush(DiagWorker *w) {
+  spt_mutex_lock(&w->mu);
+  w->flushing++;
+  spt_cond_broadcast(&w->cv);
+  while (!w->stop && (w->count > 0 || w->busy))
+    spt_cond_wait(&w->cv, &w->mu);
+  w->flushing--;
+  spt_mutex_unlock(&w->mu);
+}
+
+void diag_worker_stats(DiagWorker *w, unsigned *computed, unsigned *dropped) {
+  spt_mutex_lock(&w->mu);
+  if (computed)
+    *computed = w->computed;
+  if (dropped)
+    *dropped = w->dropped;
+  spt_mutex_unlock(&w->mu);
+}
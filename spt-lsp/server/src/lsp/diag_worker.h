@@ -0,0 +1,43 @@
+/*
+** diag_worker.h — 后台诊断线程：去抖 + 丢弃过期版本。
+**
+** didOpen/didChange 只把 (uri, version, 文本快照) 交给 diag_worker_schedule 后立即返回，
+** 主线程继续响应 hover/completion 等请求；诊断（解析 + 未定义名 + 参数个数检查）在后台线程
+** 上对快照计算，不触碰主线程的 DocStore / 缓存。
+**
+**   - 去抖：同一 uri 在 debounce_ms 内的连续编辑只计算最后一版；
+**   - 过期丢弃：计算期间又来了新版本（或文档已关闭），计算结果直接丢弃，不推送；
+**   - 推送：结果经 emit 发出（在后台线程调用，emit 须线程安全）。
+**
+** 分析层的每线程缓存（doc_cache 活跃链表、semantic 单条目索引）为线程局部，
+** 后台线程的临时文档与主线程互不可见。
+*/
+#ifndef SPT_LSP_DIAG_WORKER_H
+#define SPT_LSP_DIAG_WORKER_H
+
+#include "cJSON.h"
+
+#include <stddef.h>
+
+typedef struct DiagWorker DiagWorker;
+
+/* 通知出口（与 LspEmitFn 同型：接管 msg 所有权）。 */
+typedef void (*DiagEmitFn)(void *ctx, cJSON *msg);
+
+/* 启动后台线程。失败返回 NULL（调用方退回同步诊断）。 */
+DiagWorker *diag_worker_start(int debounce_ms, DiagEmitFn emit, void *ctx);
+/* 停止线程并释放；尚未计算的任务直接丢弃。w 可为 NULL。 */
+void diag_worker_stop(DiagWorker *w);
+
+/* 登记 uri 的新版本（复制 text）。覆盖该 uri 尚未计算的旧版本并重新计时。 */
+void diag_worker_schedule(DiagWorker *w, const char *uri, int version, const char *text,
+                          size_t len);
+/* 文档关闭：丢弃该 uri 的待算任务；正在计算的结果也不再推送。返回后不会再为该 uri 推送。 */
+void diag_worker_forget(DiagWorker *w, const char *uri);
+/* 忽略去抖窗口，立即计算全部待算任务并等待推送完毕（测试 / 需要同步结果时）。 */
+void diag_worker_flush(DiagWorker *w);
+
+/* 统计：实际计算次数、因去抖合并或过期而未推送的版本数。 */
+void diag_worker_stats(DiagWorker *w, unsigned *computed, unsigned *dropped);
+
+#endif /* SPT_LSP_DIAG_WORKER_H */
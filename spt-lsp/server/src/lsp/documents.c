@@ -2,6 +2,7 @@
 ** documents.c — 文档存储与位置换算实现。
 */
 #include "documents.h"
+#include "doc_cache.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -73,71 +74,158 @@ static size_t normalize_newlines(char *s, size_t len) {
   return w;
 }
 
-/* ---- 重建行索引 ---- */
-static void build_line_index(Document *d) {
-  free(d->line_starts);
-  int cap = 16, n = 0;
-  size_t *starts = (size_t *)malloc(sizeof(size_t) * (size_t)cap);
-  starts[n++] = 0; /* line_starts[0] = 0：第 0 行起始字节偏移 */
-  for (size_t i = 0; i < d->text_len; i++) {
-    if (d->text[i] == '\n') {
-      if (n >= cap) {
-        cap *= 2;
-        starts = (size_t *)realloc(starts, sizeof(size_t) * (size_t)cap);
-      }
-      starts[n++] = i + 1;
-    }
-  }
-  d->line_starts = starts;
-  d->line_count = n;
-}
-
 static void doc_set_text(Document *d, const char *text, size_t text_len) {
-  free(d->text);
+  doc_cache_reset(d->cache);
   char *t = (char *)malloc(text_len + 1);
   memcpy(t, text ? text : "", text_len);
   t[text_len] = '\0';
-  d->text_len = normalize_newlines(t, text_len);
-  d->text = t;
-  build_line_index(d);
+  text_len = normalize_newlines(t, text_len);
+  rope_assign(&d->rope, t, text_len);
+  /* 规范化后的副本直接作为连续视图。 */
+  free(d->view);
+  d->view = t;
+  d->view_len = text_len;
+  d->view_cap = text_len + 1;
+  d->view_dirty = 0;
+  d->text_len = text_len;
+  d->line_count = d->rope.newlines + 1;
+  d->text_gen++;
+}
+
+/* 记下一次增量编辑，视图留到下次 doc_text 再修补（与 doc_cache_note_edit 同样合并区间）。 */
+static void view_note_edit(Document *d, size_t start, size_t old_end, size_t repl_len) {
+  if (d->view_dirty == 2)
+    return;
+  if (d->view_dirty == 0) {
+    d->view_dirty = 1;
+    d->view_start = start;
+    d->view_old_end = old_end;
+    d->view_new_end = start + repl_len;
+    return;
+  }
+  size_t tail = d->view_new_end > old_end ? d->view_new_end : old_end;
+  size_t view_tail = tail - d->view_new_end + d->view_old_end;
+  if (start < d->view_start)
+    d->view_start = start;
+  d->view_old_end = view_tail;
+  d->view_new_end = tail - old_end + start + repl_len;
+}
+
+const char *doc_text(const Document *cd) {
+  Document *d = (Document *)cd; /* 视图只是 rope 的缓存，物化不改变文档内容 */
+  if (d->view && !d->view_dirty)
+    return d->view;
+  if (d->text_len + 1 > d->view_cap) {
+    size_t nc = d->view_cap + d->view_cap / 2;
+    if (nc < d->text_len + 1)
+      nc = d->text_len + 1;
+    d->view = (char *)realloc(d->view, nc);
+    d->view_cap = nc;
+  }
+  if (d->view_dirty == 1) {
+    /* 就地修补：挪动未变的后缀，再从 rope 取编辑后的区间。 */
+    memmove(d->view + d->view_new_end, d->view + d->view_old_end,
+            d->view_len - d->view_old_end);
+    rope_copy(&d->rope, d->view_start, d->view_new_end - d->view_start,
+              d->view + d->view_start);
+  } else {
+    rope_copy(&d->rope, 0, d->text_len, d->view);
+  }
+  d->view[d->text_len] = '\0';
+  d->view_len = d->text_len;
+  d->view_dirty = 0;
+  return d->view;
+}
+
+size_t doc_line_start(const Document *d, int line) {
+  if (line >= d->line_count)
+    return d->text_len;
+  return rope_line_start(&d->rope, line);
+}
+
+size_t doc_bytes(const Document *d) {
+  return sizeof(Document) + rope_bytes(&d->rope) + d->view_cap;
 }
 
 /* ---- 存储 ---- */
 void doc_store_init(DocStore *s) {
-  s->docs = NULL;
-  s->count = 0;
-  s->cap = 0;
+  memset(s, 0, sizeof *s);
+  s->uris = uri_table_new();
+}
+
+static Document *doc_alloc(const char *uri) {
+  Document *d = (Document *)calloc(1, sizeof(Document));
+  d->uri = dup_str(uri);
+  d->cache = doc_cache_new();
+  d->uri_id = -1;
+  rope_init(&d->rope);
+  d->view_dirty = 2;
+  return d;
+}
+
+Document *doc_new(const char *uri, const char *text, size_t text_len, int version) {
+  Document *d = doc_alloc(uri);
+  d->version = version;
+  doc_set_text(d, text, text_len);
+  return d;
+}
+
+void doc_free(Document *d) {
+  if (!d)
+    return;
+  doc_cache_free(d->cache);
+  free(d->uri);
+  rope_free(&d->rope);
+  free(d->view);
+  free(d);
 }
 
 void doc_store_free(DocStore *s) {
-  for (int i = 0; i < s->count; i++) {
-    free(s->docs[i]->uri);
-    free(s->docs[i]->text);
-    free(s->docs[i]->line_starts);
-    free(s->docs[i]);
-  }
+  for (int i = 0; i < s->count; i++)
+    doc_free(s->docs[i]);
   free(s->docs);
-  doc_store_init(s);
+  free(s->by_id);
+  uri_table_release(s->uris);
+  memset(s, 0, sizeof *s);
+}
+
+Document *doc_store_get_id(const DocStore *s, int uri_id) {
+  if (uri_id < 0 || uri_id >= s->by_id_cap)
+    return NULL;
+  return s->by_id[uri_id];
 }
 
 Document *doc_store_get(DocStore *s, const char *uri) {
-  for (int i = 0; i < s->count; i++)
-    if (strcmp(s->docs[i]->uri, uri) == 0)
-      return s->docs[i];
-  return NULL;
+  return doc_store_get_id(s, uri_table_find(s->uris, uri));
 }
 
 Document *doc_store_open(DocStore *s, const char *uri, const char *text, size_t text_len,
                          int version) {
   Document *d = doc_store_get(s, uri);
   if (!d) {
-    d = (Document *)calloc(1, sizeof(Document));
-    d->uri = dup_str(uri);
+    int id = uri_table_intern(s->uris, uri);
+    if (id < 0)
+      return NULL;
+    if (id >= s->by_id_cap) {
+      int nc = s->by_id_cap ? s->by_id_cap : 16;
+      while (nc <= id)
+        nc *= 2;
+      Document **nb = (Document **)realloc(s->by_id, sizeof(Document *) * (size_t)nc);
+      if (!nb)
+        return NULL;
+      memset(nb + s->by_id_cap, 0, sizeof(Document *) * (size_t)(nc - s->by_id_cap));
+      s->by_id = nb;
+      s->by_id_cap = nc;
+    }
     if (s->count >= s->cap) {
       s->cap = s->cap ? s->cap * 2 : 8;
       s->docs = (Document **)realloc(s->docs, sizeof(Document *) * (size_t)s->cap);
     }
+    d = doc_alloc(uri);
+    d->uri_id = id;
+    d->slot = s->count;
     s->docs[s->count++] = d;
+    s->by_id[id] = d;
   }
   d->version = version;
   doc_set_text(d, text, text_len);
@@ -176,34 +264,27 @@ Document *doc_store_change_range(DocStore *s, const char *uri, size_t start_off,
   norm_repl[repl_len] = '\0';
   size_t norm_len = normalize_newlines(norm_repl, repl_len);
 
-  /* 拼接新文本：前缀 + replacement + 后缀。 */
-  size_t new_len = start_off + norm_len + (d->text_len - end_off);
-  char *new_text = (char *)malloc(new_len + 1);
-  memcpy(new_text, d->text, start_off);
-  memcpy(new_text + start_off, norm_repl, norm_len);
-  memcpy(new_text + start_off + norm_len, d->text + end_off, d->text_len - end_off);
-  new_text[new_len] = '\0';
-  free(norm_repl);
-
   d->version = version;
-  free(d->text);
-  d->text = new_text;
-  d->text_len = new_len;
-  build_line_index(d);
+  /* 不清空缓存：记下编辑区间，下次 doc_unit 只重解析包围它的顶层语句（doc_cache.h）。 */
+  doc_cache_note_edit(d->cache, start_off, end_off, norm_len);
+  rope_replace(&d->rope, start_off, end_off, norm_repl, norm_len);
+  free(norm_repl);
+  view_note_edit(d, start_off, end_off, norm_len);
+  d->text_len = d->rope.len;
+  d->line_count = d->rope.newlines + 1;
+  d->text_gen++;
   return d;
 }
 
 void doc_store_close(DocStore *s, const char *uri) {
-  for (int i = 0; i < s->count; i++) {
-    if (strcmp(s->docs[i]->uri, uri) == 0) {
-      free(s->docs[i]->uri);
-      free(s->docs[i]->text);
-      free(s->docs[i]->line_starts);
-      free(s->docs[i]);
-      s->docs[i] = s->docs[--s->count];
-      return;
-    }
-  }
+  Document *d = doc_store_get(s, uri);
+  if (!d)
+    return;
+  s->by_id[d->uri_id] = NULL;
+  Document *last = s->docs[--s->count];
+  s->docs[d->slot] = last;
+  last->slot = d->slot;
+  doc_free(d);
 }
 
 /* ---- 换算 ---- */
@@ -213,19 +294,20 @@ size_t doc_offset_at(const Document *d, LspPos p) {
     line = 0;
   if (line >= d->line_count)
     return d->text_len; /* 超出末行 -> 文末 */
-  size_t ls = d->line_starts[line];
-  size_t le = (line + 1 < d->line_count) ? d->line_starts[line + 1] : d->text_len;
-  /* 行内：把 character（UTF-16 码元）转为字节偏移 */
+  size_t ls = doc_line_start(d, line);
+  size_t le = (line + 1 < d->line_count) ? doc_line_start(d, line + 1) - 1 : d->text_len;
+  /* 行内：把 character（UTF-16 码元）转为字节偏移，不越过行尾 */
   int want = p.character;
   if (want <= 0)
     return ls;
+  if (rope_ascii_span(&d->rope, ls, le))
+    return (size_t)want < le - ls ? ls + (size_t)want : le;
+  const char *text = doc_text(d);
   int units = 0;
   size_t i = ls;
   while (i < le) {
-    if (d->text[i] == '\n')
-      break; /* 不越过行尾 */
     int adv;
-    unsigned cp = utf8_next(d->text, d->text_len, i, &adv);
+    unsigned cp = utf8_next(text, d->text_len, i, &adv);
     int u = utf16_units(cp);
     if (units + u > want)
       break;
@@ -241,24 +323,18 @@ LspPos doc_pos_at(const Document *d, size_t off) {
   LspPos p = {0, 0};
   if (off > d->text_len)
     off = d->text_len;
-  /* 二分定位行：最大的 line 使 line_starts[line] <= off */
-  int lo = 0, hi = d->line_count - 1, line = 0;
-  while (lo <= hi) {
-    int mid = (lo + hi) / 2;
-    if (d->line_starts[mid] <= off) {
-      line = mid;
-      lo = mid + 1;
-    } else {
-      hi = mid - 1;
-    }
-  }
-  p.line = line;
+  p.line = rope_line_of(&d->rope, off);
   /* 行内 UTF-16 码元计数到 off */
-  size_t i = d->line_starts[line];
+  size_t i = doc_line_start(d, p.line);
+  if (rope_ascii_span(&d->rope, i, off)) {
+    p.character = (int)(off - i);
+    return p;
+  }
+  const char *text = doc_text(d);
   int units = 0;
   while (i < off) {
     int adv;
-    unsigned cp = utf8_next(d->text, d->text_len, i, &adv);
+    unsigned cp = utf8_next(text, d->text_len, i, &adv);
     units += utf16_units(cp);
     i += (size_t)adv;
   }
@@ -281,7 +357,7 @@ LspPos doc_pos_from_frontend(const Document *d, int line1, int col1_bytes) {
     LspPos p = {d->line_count > 0 ? d->line_count - 1 : 0, 0};
     return p;
   }
-  size_t byte_off = d->line_starts[line0] + (size_t)(col1_bytes > 0 ? col1_bytes - 1 : 0);
+  size_t byte_off = doc_line_start(d, line0) + (size_t)(col1_bytes > 0 ? col1_bytes - 1 : 0);
   if (byte_off > d->text_len)
     byte_off = d->text_len;
   return doc_pos_at(d, byte_off);
@@ -2,29 +2,53 @@
 ** documents.h — 文档存储 + 位置换算（UTF-16 ↔ 字节偏移）。
 **
 ** 文本在存入时做 CRLF/CR -> LF 规范化（与前端解析一致，且不改变 LSP 的
-** line/character 语义）。每个文档维护行起始字节偏移索引，用于 O(log n) 定位行，
-** 行内再按 UTF-8 解码计 UTF-16 码元做 character 换算。
+** line/character 语义）。文本存在分块 rope 里（rope.h）：增量编辑只改动所在的块，行索引随块
+** 的换行表与树状数组一起维护，定位行、偏移 -> 行都是 O(log n)，不再每次按键复制全文、重扫行首。
+** 行内按 UTF-8 解码计 UTF-16 码元做 character 换算；行所在的块全为 ASCII 时直接用字节差。
+**
+** 词法分析等需要连续文本的调用方经 doc_text 取视图：首次使用时物化，之后的增量编辑只记下
+** 待修补区间，下次取视图时就地挪动后缀、从 rope 补入新内容，而不是重新分配整份文本。
+**
+** 按 URI 查找走驻留表（uri_table.h）：URI -> id 一次哈希，id -> 文档直接下标，打开文档再多
+** 也是 O(1)。驻留表可与工作区共用（workspace_set_overlay），两边的 id 一致。
 */
 #ifndef SPT_LSP_DOCUMENTS_H
 #define SPT_LSP_DOCUMENTS_H
 
 #include "protocol.h"
+#include "rope.h"
+#include "uri_table.h"
 
 #include <stddef.h>
 
+struct DocCache;
+
 typedef struct {
-  char *uri;       /* 拥有，NUL 结尾 */
-  char *text;      /* 拥有，LF 规范化后的 UTF-8，NUL 结尾 */
-  size_t text_len; /* 不含末尾 NUL */
+  char *uri;              /* 拥有，NUL 结尾 */
+  Rope rope;              /* 拥有；LF 规范化后的 UTF-8 文本 */
+  size_t text_len;        /* 文本字节数 */
   int version;
-  size_t *line_starts; /* line_starts[i] = 第 i 行起始字节偏移 */
-  int line_count;      /* 行数（至少 1） */
+  int line_count;         /* 行数（至少 1） */
+  struct DocCache *cache; /* 拥有；按版本缓存的解析结果（doc_cache.h），全量变化时清空、增量变化时修补 */
+  int uri_id;             /* 所在 DocStore 驻留表中的 id；独立文档（doc_new）为 -1 */
+  int slot;               /* 在 DocStore.docs 中的下标 */
+  unsigned text_gen;      /* 文本每变化一次加一（缓存据此识别版本号不变的文本替换） */
+
+  /* 连续视图（doc_text 维护）：view_dirty 为 1 时 view 的 [view_start, view_old_end) 对应当前
+     文本的 [view_start, view_new_end)，其余字节一致；为 2 时需整体重建。 */
+  char *view;
+  size_t view_len, view_cap;
+  int view_dirty;
+  size_t view_start, view_old_end, view_new_end;
 } Document;
 
 typedef struct {
-  Document **docs;
+  Document **docs; /* 紧凑数组（顺序无关），供遍历 */
   int count;
   int cap;
+  UriTable *uris;  /* 持有一个引用；doc_store_init 新建 */
+  Document **by_id; /* uri id -> 文档，未打开为 NULL */
+  int by_id_cap;
 } DocStore;
 
 void doc_store_init(DocStore *s);
@@ -43,6 +67,20 @@ Document *doc_store_change_range(DocStore *s, const char *uri, size_t start_off,
                                  const char *replacement, size_t repl_len, int version);
 
 Document *doc_store_get(DocStore *s, const char *uri);
+/* 按驻留 id 查找（id 来自 s->uris）；未打开返回 NULL。 */
+Document *doc_store_get_id(const DocStore *s, int uri_id);
+
+/* 新建不属于任何 DocStore 的独立文档（如工作区读盘解析的临时文档），text 同样规范化。 */
+Document *doc_new(const char *uri, const char *text, size_t text_len, int version);
+/* 释放独立文档。d 可为 NULL。 */
+void doc_free(Document *d);
+
+/* 连续文本视图（NUL 结尾，长度 text_len），在下一次修改文档前有效。 */
+const char *doc_text(const Document *d);
+/* 第 line 行（0 起）的起始字节偏移；line >= line_count 时返回 text_len。 */
+size_t doc_line_start(const Document *d, int line);
+/* 文档常驻内存估计（rope + 视图）。 */
+size_t doc_bytes(const Document *d);
 
 /* ---- 位置换算 ---- */
 /* LSP 位置 -> 字节偏移（钳制到合法范围）。 */
@@ -10,6 +10,24 @@ cJSON *lsp_pos_to_json(LspPos p) {
   return o;
 }
 
+static void pos_write(JsonWriter *w, LspPos p) {
+  jw_begin_object(w);
+  jw_key(w, "line");
+  jw_int(w, p.line);
+  jw_key(w, "character");
+  jw_int(w, p.character);
+  jw_end_object(w);
+}
+
+void lsp_range_write(JsonWriter *w, LspRange r) {
+  jw_begin_object(w);
+  jw_key(w, "start");
+  pos_write(w, r.start);
+  jw_key(w, "end");
+  pos_write(w, r.end);
+  jw_end_object(w);
+}
+
 cJSON *lsp_range_to_json(LspRange r) {
   cJSON *o = cJSON_CreateObject();
   cJSON_AddItemToObject(o, "start", lsp_pos_to_json(r.start));
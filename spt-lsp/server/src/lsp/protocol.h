@@ -9,6 +9,7 @@
 #define SPT_LSP_PROTOCOL_H
 
 #include "cJSON.h"
+#include "json_writer.h"
 
 typedef struct {
   int line;      /* 0 起 */
@@ -26,6 +27,8 @@ cJSON *lsp_pos_to_json(LspPos p);
 cJSON *lsp_range_to_json(LspRange r);
 LspPos lsp_pos_from_json(const cJSON *o);     /* 读取 {line,character}，缺失为 0 */
 LspRange lsp_range_from_json(const cJSON *o); /* 读取 {start,end}，子字段缺失则对应位置为 0。 */
+/* 流式写出 {start:{line,character},end:{...}}（与 lsp_range_to_json 同形）。 */
+void lsp_range_write(JsonWriter *w, LspRange r);
 
 /* DiagnosticSeverity */
 enum { LSP_SEV_ERROR = 1, LSP_SEV_WARNING = 2, LSP_SEV_INFO = 3, LSP_SEV_HINT = 4 };
@@ -0,0 +1,346 @@
+/*
+** rope.c — 分块文本实现。
+*/
+#include "rope.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void rope_init(Rope *r) { memset(r, 0, sizeof *r); }
+
+static void chunk_free(RopeChunk *c) {
+  free(c->bytes);
+  free(c->nl);
+}
+
+void rope_free(Rope *r) {
+  for (int i = 0; i < r->count; i++)
+    chunk_free(&r->chunks[i]);
+  free(r->chunks);
+  free(r->fw_len);
+  free(r->fw_nl);
+  rope_init(r);
+}
+
+static unsigned count_nl(const char *s, size_t n) {
+  unsigned k = 0;
+  for (const char *p = s, *e = s + n; (p = (const char *)memchr(p, '\n', (size_t)(e - p))); p++)
+    k++;
+  return k;
+}
+
+/* 保证块缓冲至少 need 字节、换行表至少 nl 项；need <= ROPE_CHUNK_MAX。 */
+static int chunk_reserve(RopeChunk *c, unsigned need, unsigned nl) {
+  if (need > c->cap) {
+    unsigned nc = c->cap ? c->cap : 256;
+    while (nc < need)
+      nc *= 2;
+    if (nc > ROPE_CHUNK_MAX)
+      nc = ROPE_CHUNK_MAX;
+    char *nb = (char *)realloc(c->bytes, nc);
+    if (!nb)
+      return 0;
+    c->bytes = nb;
+    c->cap = nc;
+  }
+  if (nl > c->nl_cap) {
+    unsigned nc = c->nl_cap ? c->nl_cap * 2 : 16;
+    while (nc < nl)
+      nc *= 2;
+    unsigned short *nn = (unsigned short *)realloc(c->nl, sizeof(unsigned short) * nc);
+    if (!nn)
+      return 0;
+    c->nl = nn;
+    c->nl_cap = nc;
+  }
+  return 1;
+}
+
+/* 重算块的换行表与 ASCII 标志；换行表容量须已足够。 */
+static void chunk_scan(RopeChunk *c) {
+  unsigned k = 0;
+  int ascii = 1;
+  for (unsigned i = 0; i < c->len; i++) {
+    unsigned char b = (unsigned char)c->bytes[i];
+    if (b == '\n')
+      c->nl[k++] = (unsigned short)i;
+    ascii &= b < 0x80;
+  }
+  c->nl_count = k;
+  c->ascii = ascii;
+}
+
+/* ---- 树状数组 ---- */
+static void fw_rebuild(Rope *r) {
+  for (int i = 1; i <= r->count; i++) {
+    r->fw_len[i] = r->chunks[i - 1].len;
+    r->fw_nl[i] = (int)r->chunks[i - 1].nl_count;
+  }
+  for (int i = 1; i <= r->count; i++) {
+    int j = i + (i & -i);
+    if (j <= r->count) {
+      r->fw_len[j] += r->fw_len[i];
+      r->fw_nl[j] += r->fw_nl[i];
+    }
+  }
+}
+
+/* 块 ci 的字节数变化 dlen（模 2^n 的差值）、换行数变化 dnl。 */
+static void fw_add(Rope *r, int ci, size_t dlen, int dnl) {
+  for (int i = ci + 1; i <= r->count; i += i & -i) {
+    r->fw_len[i] += dlen;
+    r->fw_nl[i] += dnl;
+  }
+}
+
+static int fw_top(int count) {
+  int step = 1;
+  while (step * 2 <= count)
+    step *= 2;
+  return step;
+}
+
+/* 累计字节数 >= target 的第一个块（target <= len，count > 0）；*base / *nl_before 为其之前的
+   字节数与换行数。target 恰在块边界时取前一块（其末尾）。 */
+static int find_off(const Rope *r, size_t target, size_t *base, int *nl_before) {
+  int pos = 0, nl = 0;
+  size_t b = 0;
+  for (int step = fw_top(r->count); step; step >>= 1) {
+    int nx = pos + step;
+    if (nx <= r->count && b + r->fw_len[nx] < target) {
+      pos = nx;
+      b += r->fw_len[nx];
+      nl += r->fw_nl[nx];
+    }
+  }
+  if (pos >= r->count)
+    pos = r->count - 1; /* 仅 target > len 时，调用方已钳制 */
+  *base = b;
+  *nl_before = nl;
+  return pos;
+}
+
+/* 累计换行数 >= line 的第一个块（1 <= line <= newlines）。 */
+static int find_nl(const Rope *r, int line, size_t *base, int *nl_before) {
+  int pos = 0, nl = 0;
+  size_t b = 0;
+  for (int step = fw_top(r->count); step; step >>= 1) {
+    int nx = pos + step;
+    if (nx <= r->count && nl + r->fw_nl[nx] < line) {
+      pos = nx;
+      b += r->fw_len[nx];
+      nl += r->fw_nl[nx];
+    }
+  }
+  *base = b;
+  *nl_before = nl;
+  return pos;
+}
+
+/* 块 ci 内位置 < rem 的换行个数。 */
+static int nl_before_in(const RopeChunk *c, size_t rem) {
+  int lo = 0, hi = (int)c->nl_count;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (c->nl[mid] < rem)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/* ---- 结构性替换：块 [ci, ci + nremove) 换成 pre + s + post 重新切出的块 ---- */
+typedef struct {
+  const char *p;
+  size_t n;
+} Span;
+
+static int splice_chunks(Rope *r, int ci, int nremove, Span seg[3]) {
+  size_t m = seg[0].n + seg[1].n + seg[2].n;
+  int k = (int)((m + ROPE_CHUNK_FILL - 1) / ROPE_CHUNK_FILL);
+  int ncount = r->count - nremove + k;
+  RopeChunk *fresh = k ? (RopeChunk *)calloc((size_t)k, sizeof(RopeChunk)) : NULL;
+  if (k && !fresh)
+    return 0;
+
+  /* 先在新块里填好内容（失败时 rope 不变）：均分 m 字节，每块不超过 ROPE_CHUNK_FILL。 */
+  int si = 0;
+  size_t sp = 0;
+  for (int i = 0; i < k; i++) {
+    unsigned want = (unsigned)(m / (size_t)k + ((size_t)i < m % (size_t)k));
+    RopeChunk *c = &fresh[i];
+    if (!chunk_reserve(c, want, 0))
+      goto fail;
+    while (c->len < want) {
+      while (sp >= seg[si].n) {
+        si++;
+        sp = 0;
+      }
+      size_t take = seg[si].n - sp;
+      if (take > want - c->len)
+        take = want - c->len;
+      memcpy(c->bytes + c->len, seg[si].p + sp, take);
+      c->len += (unsigned)take;
+      sp += take;
+    }
+    if (!chunk_reserve(c, want, count_nl(c->bytes, c->len)))
+      goto fail;
+    chunk_scan(c);
+  }
+
+  if (ncount > r->cap) {
+    int nc = r->cap ? r->cap : 8;
+    while (nc < ncount)
+      nc *= 2;
+    RopeChunk *nch = (RopeChunk *)realloc(r->chunks, sizeof(RopeChunk) * (size_t)nc);
+    if (!nch)
+      goto fail;
+    r->chunks = nch;
+    size_t *nfl = (size_t *)realloc(r->fw_len, sizeof(size_t) * (size_t)(nc + 1));
+    if (!nfl)
+      goto fail;
+    r->fw_len = nfl;
+    int *nfn = (int *)realloc(r->fw_nl, sizeof(int) * (size_t)(nc + 1));
+    if (!nfn)
+      goto fail;
+    r->fw_nl = nfn;
+    r->cap = nc;
+  }
+
+  size_t old_len = 0;
+  int old_nl = 0;
+  for (int i = ci; i < ci + nremove; i++) {
+    old_len += r->chunks[i].len;
+    old_nl += (int)r->chunks[i].nl_count;
+    chunk_free(&r->chunks[i]);
+  }
+  if (r->count > ci + nremove)
+    memmove(r->chunks + ci + k, r->chunks + ci + nremove,
+            sizeof(RopeChunk) * (size_t)(r->count - ci - nremove));
+  int new_nl = 0;
+  for (int i = 0; i < k; i++) {
+    r->chunks[ci + i] = fresh[i];
+    new_nl += (int)fresh[i].nl_count;
+  }
+  free(fresh);
+  r->count = ncount;
+  r->len = r->len - old_len + m;
+  r->newlines += new_nl - old_nl;
+  fw_rebuild(r);
+  return 1;
+
+fail:
+  for (int i = 0; i < k; i++)
+    chunk_free(&fresh[i]);
+  free(fresh);
+  return 0;
+}
+
+int rope_assign(Rope *r, const char *s, size_t n) {
+  Span seg[3] = {{NULL, 0}, {s, n}, {NULL, 0}};
+  return splice_chunks(r, 0, r->count, seg);
+}
+
+int rope_replace(Rope *r, size_t start, size_t end, const char *s, size_t n) {
+  if (start > end || end > r->len)
+    return 0;
+  if (r->count == 0) {
+    Span seg[3] = {{NULL, 0}, {s, n}, {NULL, 0}};
+    return splice_chunks(r, 0, 0, seg);
+  }
+  size_t base;
+  int nlb;
+  int ci = find_off(r, start, &base, &nlb);
+  RopeChunk *c = &r->chunks[ci];
+  size_t a = start - base, b = end - base;
+  size_t nlen = b <= c->len ? c->len - (b - a) + n : 0;
+
+  /* 快路径：编辑落在单块内且结果仍放得下——就地改块，树状数组点更新。 */
+  if (b <= c->len && nlen > 0 && nlen <= ROPE_CHUNK_MAX) {
+    unsigned old_len = c->len, old_nl = c->nl_count;
+    if (!chunk_reserve(c, (unsigned)nlen, old_nl + count_nl(s, n)))
+      return 0;
+    memmove(c->bytes + a + n, c->bytes + b, c->len - b);
+    if (n)
+      memcpy(c->bytes + a, s, n);
+    c->len = (unsigned)nlen;
+    chunk_scan(c);
+    int dnl = (int)c->nl_count - (int)old_nl;
+    fw_add(r, ci, (size_t)c->len - old_len, dnl);
+    r->len = r->len - (end - start) + n;
+    r->newlines += dnl;
+    return 1;
+  }
+
+  /* 慢路径：首块前缀 + 替换文本 + 末块后缀，重切成新块。 */
+  size_t base1;
+  int nlb1;
+  int ci1 = find_off(r, end, &base1, &nlb1);
+  const RopeChunk *c1 = &r->chunks[ci1];
+  Span seg[3] = {{c->bytes, a}, {s, n}, {c1->bytes + (end - base1), c1->len - (end - base1)}};
+  return splice_chunks(r, ci, ci1 - ci + 1, seg);
+}
+
+size_t rope_line_start(const Rope *r, int line) {
+  if (line <= 0 || r->count == 0)
+    return 0;
+  if (line > r->newlines)
+    return r->len;
+  size_t base;
+  int nlb;
+  int ci = find_nl(r, line, &base, &nlb);
+  return base + r->chunks[ci].nl[line - nlb - 1] + 1;
+}
+
+int rope_line_of(const Rope *r, size_t off) {
+  if (r->count == 0)
+    return 0;
+  if (off > r->len)
+    off = r->len;
+  size_t base;
+  int nlb;
+  int ci = find_off(r, off, &base, &nlb);
+  return nlb + nl_before_in(&r->chunks[ci], off - base);
+}
+
+int rope_ascii_span(const Rope *r, size_t a, size_t b) {
+  if (b > r->len)
+    b = r->len;
+  if (a >= b)
+    return 1;
+  size_t base;
+  int nlb;
+  int c0 = find_off(r, a + 1, &base, &nlb);
+  int c1 = find_off(r, b, &base, &nlb);
+  for (int i = c0; i <= c1; i++)
+    if (!r->chunks[i].ascii)
+      return 0;
+  return 1;
+}
+
+void rope_copy(const Rope *r, size_t off, size_t n, char *out) {
+  if (n == 0)
+    return;
+  size_t base;
+  int nlb;
+  int ci = find_off(r, off + 1, &base, &nlb);
+  size_t rem = off - base;
+  while (n > 0 && ci < r->count) {
+    const RopeChunk *c = &r->chunks[ci++];
+    size_t take = c->len - rem;
+    if (take > n)
+      take = n;
+    memcpy(out, c->bytes + rem, take);
+    out += take;
+    n -= take;
+    rem = 0;
+  }
+}
+
+size_t rope_bytes(const Rope *r) {
+  size_t n = (sizeof(RopeChunk) + sizeof(size_t) + sizeof(int)) * (size_t)r->cap;
+  for (int i = 0; i < r->count; i++)
+    n += r->chunks[i].cap + sizeof(unsigned short) * r->chunks[i].nl_cap;
+  return n;
+}
@@ -0,0 +1,57 @@
+/*
+** rope.h — 分块文本（rope）：O(log n) 的区间替换与行定位。
+**
+** 文本切成不超过 ROPE_CHUNK_MAX 字节的块，块内记下各 '\n' 的偏移与是否全为 ASCII；
+** 两棵树状数组分别累计各块字节数与换行数，于是
+**   - 字节偏移 -> 块、行号 -> 行首偏移、偏移 -> 行号 都是 O(log 块数) + 块内二分；
+**   - 落在单块内的编辑（逐键输入的常态）就地改块并点更新树状数组，不碰其余文本；
+**   - 跨块或使块溢出的编辑只重建受影响的几个块，再 O(块数) 重建树状数组。
+**
+** 不变量：至少有一个块；块数大于 1 时没有空块。只存字节，不做换行规范化（由调用方负责）。
+*/
+#ifndef SPT_LSP_ROPE_H
+#define SPT_LSP_ROPE_H
+
+#include <stddef.h>
+
+#define ROPE_CHUNK_MAX 4096 /* 块容量上限 */
+#define ROPE_CHUNK_FILL 2048 /* 切块时的目标大小，给就地插入留余量 */
+
+typedef struct {
+  char *bytes; /* 拥有 */
+  unsigned len, cap;
+  unsigned short *nl; /* 块内 '\n' 的偏移（升序），拥有 */
+  unsigned nl_count, nl_cap;
+  int ascii; /* 块内全部为 ASCII 字节 */
+} RopeChunk;
+
+typedef struct {
+  RopeChunk *chunks;
+  int count, cap;
+  size_t *fw_len; /* 树状数组（1 起）：块字节数 */
+  int *fw_nl;     /* 树状数组（1 起）：块换行数 */
+  int fw_cap;
+  size_t len;   /* 总字节数 */
+  int newlines; /* 总换行数（行数 = newlines + 1） */
+} Rope;
+
+void rope_init(Rope *r);
+void rope_free(Rope *r);
+
+/* 整体替换为 s[0, n)。内存不足返回 0（rope 保持原样）。 */
+int rope_assign(Rope *r, const char *s, size_t n);
+/* 把 [start, end) 替换为 s[0, n)；区间须合法（start <= end <= len）。内存不足返回 0。 */
+int rope_replace(Rope *r, size_t start, size_t end, const char *s, size_t n);
+
+/* 第 line 行（0 起）的起始偏移；line 须在 [0, newlines] 内。 */
+size_t rope_line_start(const Rope *r, int line);
+/* 偏移 off（<= len）所在的行号（0 起）。 */
+int rope_line_of(const Rope *r, size_t off);
+/* [a, b) 覆盖的块是否全为 ASCII（是则该区间的 UTF-16 码元数等于字节数）。 */
+int rope_ascii_span(const Rope *r, size_t a, size_t b);
+/* 复制 [off, off + n) 到 out（不加 NUL）；区间须合法。 */
+void rope_copy(const Rope *r, size_t off, size_t n, char *out);
+/* 常驻内存估计（块缓冲 + 索引）。 */
+size_t rope_bytes(const Rope *r);
+
+#endif /* SPT_LSP_ROPE_H */
@@ -6,9 +6,11 @@
 #endif
 #include "server.h"
 
+#include "diag_worker.h"
 #include "diagnostics.h"
 #include "lsp_features.h"
 #include "spt_rpc.h"
+#include "spt_thread.h"
 #include "trace.h"
 
 #include <errno.h>
@@ -16,9 +18,11 @@
 #include <string.h>
 #ifdef _WIN32
 #include <io.h>
+#include <windows.h>
 #define spt_fileno _fileno
 #define spt_read _read
 #else
+#include <poll.h>
 #include <unistd.h>
 #define spt_fileno fileno
 #define spt_read read
@@ -27,6 +31,11 @@
 #define SPT_LSP_NAME "spt-lsp"
 #define SPT_LSP_VERSION "0.1.0"
 
+/* lsp_run 的诊断去抖窗口：连续按键间隔通常 < 150ms，停顿后才计算。 */
+#define SPT_LSP_DIAG_DEBOUNCE_MS 150
+
+static bool request_cancelled(LspServer *s, const cJSON *id);
+
 void lsp_server_init(LspServer *s) {
   s->state = LSP_UNINITIALIZED;
   s->should_exit = false;
@@ -34,11 +43,34 @@ void lsp_server_init(LspServer *s) {
   doc_store_init(&s->docs);
   workspace_init(&s->ws);
   workspace_set_overlay(&s->ws, &s->docs);
+  /* 目标文件解析缓存上限：$SPT_LSP_UNIT_CACHE_MB（0 = 不限），默认 WS_UNIT_BUDGET_DEFAULT。 */
+  const char *mb = getenv("SPT_LSP_UNIT_CACHE_MB");
+  if (mb && mb[0])
+    s->ws.unit_budget = (size_t)strtoul(mb, NULL, 10) << 20;
   s->emit = NULL;
   s->emit_ctx = NULL;
+  s->diag = NULL;
+  s->semtok = semtok_store_new();
+  s->poll = NULL;
+  s->poll_ctx = NULL;
+  s->cancelled = NULL;
+  s->cancelled_count = s->cancelled_cap = 0;
+}
+
+static void clear_cancelled(LspServer *s) {
+  for (int i = 0; i < s->cancelled_count; i++)
+    free(s->cancelled[i]);
+  s->cancelled_count = 0;
 }
 
 void lsp_server_free(LspServer *s) {
+  lsp_server_stop_diagnostics(s);
+  clear_cancelled(s);
+  free(s->cancelled);
+  s->cancelled = NULL;
+  s->cancelled_cap = 0;
+  semtok_store_free(s->semtok);
+  s->semtok = NULL;
   doc_store_free(&s->docs);
   workspace_free(&s->ws);
 }
@@ -48,6 +80,11 @@ void lsp_server_set_emit(LspServer *s, LspEmitFn fn, void *ctx) {
   s->emit_ctx = ctx;
 }
 
+void lsp_server_set_poll(LspServer *s, LspPollFn fn, void *ctx) {
+  s->poll = fn;
+  s->poll_ctx = ctx;
+}
+
 void lsp_emit(LspServer *s, cJSON *msg) {
   if (s->emit)
     s->emit(s->emit_ctx, msg); /* 出口接管所有权 */
@@ -55,11 +92,31 @@ void lsp_emit(LspServer *s, cJSON *msg) {
     cJSON_Delete(msg); /* 无出口：丢弃，避免泄漏 */
 }
 
-/* 针对某文档计算并推送诊断。 */
+bool lsp_server_start_diagnostics(LspServer *s, int debounce_ms) {
+  if (!s->diag)
+    s->diag = diag_worker_start(debounce_ms, s->emit, s->emit_ctx);
+  return s->diag != NULL;
+}
+
+void lsp_server_stop_diagnostics(LspServer *s) {
+  diag_worker_stop(s->diag);
+  s->diag = NULL;
+}
+
+void lsp_server_flush_diagnostics(LspServer *s) {
+  if (s->diag)
+    diag_worker_flush(s->diag);
+}
+
+/* 针对某文档计算并推送诊断；启用后台线程时只登记文本快照，立即返回。 */
 static void publish_diagnostics(LspServer *s, const char *uri) {
   Document *d = doc_store_get(&s->docs, uri);
   if (!d)
     return;
+  if (s->diag) {
+    diag_worker_schedule(s->diag, d->uri, d->version, doc_text(d), d->text_len);
+    return;
+  }
   cJSON *params = diagnostics_compute(d);
   lsp_emit(s, rpc_make_notification("textDocument/publishDiagnostics", params));
 }
@@ -105,7 +162,7 @@ static cJSON *make_initialize_result(void) {
   cJSON_AddItemToArray(strig, cJSON_CreateString(","));
   cJSON_AddItemToObject(sig, "triggerCharacters", strig);
   cJSON_AddItemToObject(caps, "signatureHelpProvider", sig);
-  /* semantic tokens (full) */
+  /* semantic tokens (full + delta) */
   cJSON *sem = cJSON_CreateObject();
   cJSON *legend = cJSON_CreateObject();
   cJSON *types = cJSON_CreateArray();
@@ -114,7 +171,9 @@ static cJSON *make_initialize_result(void) {
   cJSON_AddItemToObject(legend, "tokenTypes", types);
   cJSON_AddItemToObject(legend, "tokenModifiers", cJSON_CreateArray());
   cJSON_AddItemToObject(sem, "legend", legend);
-  cJSON_AddBoolToObject(sem, "full", 1);
+  cJSON *sem_full = cJSON_CreateObject();
+  cJSON_AddBoolToObject(sem_full, "delta", 1);
+  cJSON_AddItemToObject(sem, "full", sem_full);
   cJSON_AddBoolToObject(sem, "range", 1); /* Phase 6e */
   cJSON_AddItemToObject(caps, "semanticTokensProvider", sem);
 
@@ -136,6 +195,25 @@ static cJSON *make_initialize_result(void) {
   return result;
 }
 
+/* 工作区索引缓存：$SPT_LSP_INDEX_CACHE 指定文件路径（设为空串或 "off" 关闭），
+** 未设置时默认 <首个根目录>/.spt-lsp/index.bin（隐藏目录，不会被索引扫描到）。 */
+static void setup_index_cache(LspServer *s) {
+  const char *env = getenv("SPT_LSP_INDEX_CACHE");
+  if (env) {
+    workspace_set_index_cache(&s->ws, strcmp(env, "off") == 0 ? NULL : env);
+    return;
+  }
+  if (s->ws.root_count == 0)
+    return;
+  char path[4200];
+#ifdef _WIN32
+  snprintf(path, sizeof path, "%s\\.spt-lsp\\index.bin", s->ws.roots[0]);
+#else
+  snprintf(path, sizeof path, "%s/.spt-lsp/index.bin", s->ws.roots[0]);
+#endif
+  workspace_set_index_cache(&s->ws, path);
+}
+
 /* ---- 请求参数辅助 ---- */
 static Document *get_doc(LspServer *s, const cJSON *params) {
   cJSON *td = cJSON_GetObjectItemCaseSensitive((cJSON *)params, "textDocument");
@@ -181,6 +259,7 @@ static cJSON *handle_request(LspServer *s, const char *method, const cJSON *id,
       else if (rp && cJSON_IsString(rp))
         workspace_add_root_path(&s->ws, rp->valuestring);
     }
+    setup_index_cache(s);
     return rpc_make_response(id, make_initialize_result());
   }
 
@@ -259,7 +338,13 @@ static cJSON *handle_request(LspServer *s, const char *method, const cJSON *id,
   }
   if (strcmp(method, "textDocument/semanticTokens/full") == 0) {
     Document *d = get_doc(s, params);
-    return rpc_make_response(id, d ? feature_semantic_tokens_full(d) : NULL);
+    return rpc_make_response(id, d ? feature_semantic_tokens_full(d, s->semtok) : NULL);
+  }
+  if (strcmp(method, "textDocument/semanticTokens/full/delta") == 0) {
+    Document *d = get_doc(s, params);
+    cJSON *prev = cJSON_GetObjectItemCaseSensitive((cJSON *)params, "previousResultId");
+    const char *prev_id = (prev && cJSON_IsString(prev)) ? prev->valuestring : NULL;
+    return rpc_make_response(id, d ? feature_semantic_tokens_delta(d, prev_id, s->semtok) : NULL);
   }
   if (strcmp(method, "textDocument/formatting") == 0) {
     Document *d = get_doc(s, params);
@@ -335,6 +420,10 @@ static cJSON *handle_request(LspServer *s, const char *method, const cJSON *id,
   }
 
   if (strcmp(method, "workspace/symbol") == 0) {
+    /* 建索引是最重的阶段：建完若已被取消就不再查询（lsp_dispatch 回复取消）。 */
+    workspace_ensure_index(&s->ws);
+    if (request_cancelled(s, id))
+      return NULL;
     cJSON *q = cJSON_GetObjectItemCaseSensitive((cJSON *)params, "query");
     const char *query = (q && cJSON_IsString(q)) ? q->valuestring : "";
     return rpc_make_response(id, workspace_symbols(&s->ws, query));
@@ -344,6 +433,30 @@ static cJSON *handle_request(LspServer *s, const char *method, const cJSON *id,
   return rpc_make_error(id, RPC_METHOD_NOT_FOUND, method);
 }
 
+/* 登记 $/cancelRequest 的 id。已执行请求的迟到取消永远不会被取走，登记表满
+** LSP_CANCEL_KEEP 条时丢弃最旧的一条（id 不会复用，旧条目只会是这类残留）。 */
+static void register_cancel(LspServer *s, const cJSON *params) {
+  cJSON *id = cJSON_GetObjectItemCaseSensitive((cJSON *)params, "id");
+  char *key = id ? cJSON_PrintUnformatted(id) : NULL;
+  if (!key)
+    return;
+  if (s->cancelled_count == LSP_CANCEL_KEEP) {
+    free(s->cancelled[0]);
+    memmove(s->cancelled, s->cancelled + 1, sizeof(char *) * (size_t)--s->cancelled_count);
+  }
+  if (s->cancelled_count == s->cancelled_cap) {
+    int nc = s->cancelled_cap ? s->cancelled_cap * 2 : 8;
+    char **nv = (char **)realloc(s->cancelled, sizeof(char *) * (size_t)nc);
+    if (!nv) {
+      free(key);
+      return;
+    }
+    s->cancelled = nv;
+    s->cancelled_cap = nc;
+  }
+  s->cancelled[s->cancelled_count++] = key;
+}
+
 /* 通知处理：无响应。 */
 static void handle_notification(LspServer *s, const char *method, const cJSON *params) {
   if (strcmp(method, "exit") == 0) {
@@ -408,6 +521,9 @@ static void handle_notification(LspServer *s, const char *method, const cJSON *p
     cJSON *td = cJSON_GetObjectItemCaseSensitive((cJSON *)params, "textDocument");
     cJSON *uri = td ? cJSON_GetObjectItemCaseSensitive(td, "uri") : NULL;
     if (uri && cJSON_IsString(uri)) {
+      if (s->diag)
+        diag_worker_forget(s->diag, uri->valuestring); /* 之后不会再推送旧诊断 */
+      semtok_store_forget(s->semtok, uri_table_find(s->docs.uris, uri->valuestring));
       doc_store_close(&s->docs, uri->valuestring);
       workspace_mark_doc_dirty(&s->ws, uri->valuestring);
       /* 关闭时清空该文件的诊断（推送空数组）。 */
@@ -419,15 +535,58 @@ static void handle_notification(LspServer *s, const char *method, const cJSON *p
     return;
   }
 
+  /* $/cancelRequest：登记 id；请求尚未答复时 lsp_dispatch 回复 RequestCancelled。 */
+  if (strcmp(method, "$/cancelRequest") == 0) {
+    register_cancel(s, params);
+    return;
+  }
+
   /* 其它通知：暂忽略。 */
 }
 
+/* id 在取消登记表中的下标；无则 -1。 */
+static int find_cancelled(LspServer *s, const cJSON *id) {
+  if (!id || s->cancelled_count == 0)
+    return -1;
+  char *key = cJSON_PrintUnformatted(id);
+  int hit = -1;
+  for (int i = 0; key && i < s->cancelled_count; i++) {
+    if (strcmp(s->cancelled[i], key) == 0) {
+      hit = i;
+      break;
+    }
+  }
+  free(key);
+  return hit;
+}
+
+/* id 是否已被取消；命中则移出登记表。 */
+static bool take_cancelled(LspServer *s, const cJSON *id) {
+  int i = find_cancelled(s, id);
+  if (i < 0)
+    return false;
+  free(s->cancelled[i]);
+  s->cancelled_count--;
+  memmove(s->cancelled + i, s->cancelled + i + 1,
+          sizeof(char *) * (size_t)(s->cancelled_count - i));
+  return true;
+}
+
+/* 请求执行期间的取消检查：先经 poll 钩子收取已到达的输入，再查 id 是否已被取消。 */
+static bool request_cancelled(LspServer *s, const cJSON *id) {
+  if (s->poll)
+    s->poll(s->poll_ctx);
+  return find_cancelled(s, id) >= 0;
+}
+
 cJSON *lsp_dispatch(LspServer *s, const cJSON *msg) {
   if (!msg || !cJSON_IsObject(msg))
     return rpc_make_error(NULL, RPC_INVALID_REQUEST, "message is not a JSON object");
 
   const char *method = rpc_method(msg);
   const cJSON *id = rpc_id(msg);
+  /* 消息之间没有人持有缓存 unit，此时淘汰才安全（workspace_get_unit 的有效期约定）。 */
+  workspace_trim_units(&s->ws);
 
   FILE *dbg = spt_open_log();
   if (dbg) {
@@ -446,7 +605,19 @@ cJSON *lsp_dispatch(LspServer *s, const cJSON *msg) {
   }
 
   if (rpc_is_request(msg)) {
-    cJSON *resp = handle_request(s, method, id, rpc_params(msg));
+    cJSON *resp = NULL;
+    if (!take_cancelled(s, id)) {
+      resp = handle_request(s, method, id, rpc_params(msg));
+      /* 执行期间到达的取消：丢弃结果。生命周期请求的副作用已生效，照常答复。 */
+      if (strcmp(method, "initialize") != 0 && strcmp(method, "shutdown") != 0 &&
+          request_cancelled(s, id)) {
+        take_cancelled(s, id);
+        cJSON_Delete(resp);
+        resp = NULL;
+      }
+    }
+    if (!resp)
+      resp = rpc_make_error(id, RPC_REQUEST_CANCELLED, "request cancelled");
     dbg = spt_open_log();
     if (dbg) {
       char *rs = resp ? cJSON_PrintUnformatted(resp) : strdup("(null)");
@@ -468,97 +639,312 @@ cJSON *lsp_dispatch(LspServer *s, const cJSON *msg) {
   return NULL;
 }
 
-/* 生产出口：把服务器主动消息写到 out 并释放。 */
+/* 热点请求的 result 直接写入 w。method 不是热点时返回 false 且不写任何内容。
+** 与 handle_request 中对应分支的结果一致（cJSON 版本由同一写出函数解析而来）。 */
+static bool write_hot_result(LspServer *s, const char *method, const cJSON *id,
+                             const cJSON *params, JsonWriter *w) {
+  if (strncmp(method, "textDocument/semanticTokens/", 28) == 0) {
+    const char *kind = method + 28;
+    Document *d = get_doc(s, params);
+    if (strcmp(kind, "full") == 0) {
+      if (d)
+        feature_semantic_tokens_full_write(d, s->semtok, w);
+      else
+        jw_null(w);
+      return true;
+    }
+    if (strcmp(kind, "full/delta") == 0) {
+      cJSON *prev = cJSON_GetObjectItemCaseSensitive((cJSON *)params, "previousResultId");
+      if (d)
+        feature_semantic_tokens_delta_write(
+            d, (prev && cJSON_IsString(prev)) ? prev->valuestring : NULL, s->semtok, w);
+      else
+        jw_null(w);
+      return true;
+    }
+    if (strcmp(kind, "range") == 0) {
+      cJSON *rng = cJSON_GetObjectItemCaseSensitive((cJSON *)params, "range");
+      LspRange r = rng ? lsp_range_from_json(rng) : (LspRange){{0, 0}, {0, 0}};
+      if (d)
+        feature_semantic_tokens_range_write(d, r, w);
+      else
+        jw_null(w);
+      return true;
+    }
+    return false;
+  }
+  if (strcmp(method, "textDocument/references") == 0) {
+    Document *d = get_doc(s, params);
+    int incl = 1;
+    cJSON *ctx = cJSON_GetObjectItemCaseSensitive((cJSON *)params, "context");
+    cJSON *idf = ctx ? cJSON_GetObjectItemCaseSensitive(ctx, "includeDeclaration") : NULL;
+    if (idf && cJSON_IsBool(idf))
+      incl = cJSON_IsTrue(idf);
+    if (d) {
+      feature_references_write(d, get_pos(params), get_uri(params), incl, &s->ws, w);
+    } else {
+      jw_begin_array(w);
+      jw_end_array(w);
+    }
+    return true;
+  }
+  if (strcmp(method, "workspace/symbol") == 0) {
+    /* 同 handle_request：建完索引先检查取消（调用方丢弃结果并回复取消）。 */
+    workspace_ensure_index(&s->ws);
+    if (request_cancelled(s, id))
+      return true;
+    cJSON *q = cJSON_GetObjectItemCaseSensitive((cJSON *)params, "query");
+    workspace_symbols_write(&s->ws, (q && cJSON_IsString(q)) ? q->valuestring : "", w);
+    return true;
+  }
+  return false;
+}
+
+int lsp_dispatch_write(LspServer *s, const cJSON *msg, JsonWriter *w) {
+  const char *method = (msg && cJSON_IsObject(msg)) ? rpc_method(msg) : NULL;
+  /* 热路径只处理已初始化、未被取消的请求；生命周期错误与取消仍由 lsp_dispatch 回复。 */
+  if (method && rpc_is_request(msg) && s->state == LSP_INITIALIZED &&
+      find_cancelled(s, rpc_id(msg)) < 0) {
+    workspace_trim_units(&s->ws);
+    jw_begin_object(w);
+    jw_key(w, "jsonrpc");
+    jw_string(w, "2.0");
+    jw_key(w, "id");
+    jw_cjson(w, rpc_id(msg));
+    jw_key(w, "result");
+    /* 执行期间到达的取消：丢弃已写出的结果，交给 lsp_dispatch 回复 RequestCancelled。 */
+    if (write_hot_result(s, method, rpc_id(msg), rpc_params(msg), w) &&
+        !request_cancelled(s, rpc_id(msg))) {
+      jw_end_object(w);
+      return 1;
+    }
+    jw_reset(w);
+  }
+  cJSON *resp = lsp_dispatch(s, msg);
+  if (!resp)
+    return 0;
+  jw_cjson(w, resp);
+  cJSON_Delete(resp);
+  return 1;
+}
+
+/* 生产出口：后台诊断线程与主线程共用 out，写出经互斥量串行化。 */
+typedef struct {
+  FILE *out;
+  SptMutex lock;
+  JsonWriter note; /* 通知（任一线程，持锁使用） */
+  JsonWriter resp; /* 响应（仅主线程） */
+} StdioOut;
+
+/* 复用的输出缓冲超过该大小时，写完即释放，免得一次超大响应长期占住内存。 */
+#define SPT_LSP_OUT_KEEP (4u << 20)
+
+static void write_out(StdioOut *o, JsonWriter *w) {
+  rpc_write_body(o->out, w);
+  if (w->cap > SPT_LSP_OUT_KEEP)
+    jw_free(w);
+  else
+    jw_reset(w);
+}
+
+/* 把一条消息写到 out 并释放（线程安全）。 */
 static void stdio_emit(void *ctx, cJSON *msg) {
-  FILE *out = (FILE *)ctx;
-  rpc_write(out, msg);
+  StdioOut *o = (StdioOut *)ctx;
+  spt_mutex_lock(&o->lock);
+  jw_cjson(&o->note, msg);
+  write_out(o, &o->note);
+  spt_mutex_unlock(&o->lock);
   cJSON_Delete(msg);
 }
 
-int lsp_run(LspServer *s, FILE *in, FILE *out) {
-  FILE *dbg = spt_open_log();
+/* 生产入口：读缓冲 + 已解析、待分派的消息队列。$/cancelRequest 取出时立即登记，不入队，
+** 因此排在它前面的请求只要尚未答复就能被取消。 */
+typedef struct {
+  LspServer *s;
+  StdioOut *o;
   RpcReader r;
-  rpc_reader_init(&r);
+  int fd;
+  bool eof;    /* 读到 EOF 或读错误：客户端断开 */
+  bool broken; /* 帧格式损坏，无法继续读 */
+  cJSON **queue;
+  int head, count, cap;
+  FILE *dbg;
+} StdioIn;
+
+/* 取出读缓冲中全部完整消息：取消立即登记，其余入队。 */
+static void in_drain(StdioIn *in) {
+  int rc;
+  const char *body;
+  size_t blen;
+  while ((rc = rpc_reader_next(&in->r, &body, &blen)) == 1) {
+    if (in->dbg) {
+      fprintf(in->dbg, "lsp_run: got msg, blen=%zu\n", blen);
+      fflush(in->dbg);
+    }
+    /* 录制接收到的原始消息 */
+    FILE *rec = spt_open_record();
+    if (rec) {
+      fwrite(body, 1, blen, rec);
+      fputc('\n', rec);
+      fflush(rec);
+      fclose(rec);
+    }
+    cJSON *msg = rpc_parse(body, blen);
+    if (!msg) {
+      if (in->dbg) {
+        fprintf(in->dbg, "lsp_run: parse failed\n");
+        fflush(in->dbg);
+      }
+      stdio_emit(in->o, rpc_make_error(NULL, RPC_PARSE_ERROR, "invalid JSON"));
+      continue;
+    }
+    const char *m = rpc_method(msg);
+    if (m && !rpc_is_request(msg) && strcmp(m, "$/cancelRequest") == 0) {
+      register_cancel(in->s, rpc_params(msg));
+      cJSON_Delete(msg);
+      continue;
+    }
+    if (in->head > 0 && in->count == in->cap) {
+      in->count -= in->head;
+      memmove(in->queue, in->queue + in->head, sizeof(cJSON *) * (size_t)in->count);
+      in->head = 0;
+    }
+    if (in->count == in->cap) {
+      int nc = in->cap ? in->cap * 2 : 16;
+      cJSON **nv = (cJSON **)realloc(in->queue, sizeof(cJSON *) * (size_t)nc);
+      if (!nv) {
+        cJSON_Delete(msg);
+        rc = -1;
+        break;
+      }
+      in->queue = nv;
+      in->cap = nc;
+    }
+    in->queue[in->count++] = msg;
+  }
+  if (rc == -1) {
+    if (in->dbg) {
+      fprintf(in->dbg, "lsp_run: rpc_reader_next error\n");
+      fflush(in->dbg);
+    }
+    in->broken = true;
+  }
+}
+
+/* 读一块输入喂给读缓冲（可能阻塞）。EOF 或错误时置 eof。 */
+static void in_read(StdioIn *in) {
   char chunk[8192];
+  int n = (int)spt_read(in->fd, chunk, sizeof(chunk));
+  if (in->dbg) {
+    fprintf(in->dbg, "lsp_run: read n=%d errno=%d\n", n, errno);
+    fflush(in->dbg);
+  }
+  if (n <= 0)
+    in->eof = true;
+  else
+    rpc_reader_feed(&in->r, chunk, (size_t)n);
+}
+
+/* fd 上是否有可立即读取的输入（不阻塞）。 */
+static bool in_ready(int fd) {
+#ifdef _WIN32
+  HANDLE h = (HANDLE)_get_osfhandle(fd);
+  if (GetFileType(h) != FILE_TYPE_PIPE)
+    return GetFileType(h) == FILE_TYPE_DISK;
+  DWORD avail = 0;
+  return PeekNamedPipe(h, NULL, 0, NULL, &avail, NULL) && avail > 0;
+#else
+  struct pollfd p = {fd, POLLIN, 0};
+  return poll(&p, 1, 0) > 0 && (p.revents & (POLLIN | POLLHUP)) != 0;
+#endif
+}
+
+/* LspPollFn：请求执行期间收取已到达的输入，登记其中的取消。 */
+static void stdio_poll(void *ctx) {
+  StdioIn *in = (StdioIn *)ctx;
+  while (!in->eof && !in->broken && in_ready(in->fd)) {
+    in_read(in);
+    in_drain(in);
+  }
+}
+
+/* 分派一条消息并写出响应（若有）。 */
+static void dispatch_one(LspServer *s, StdioOut *o, const cJSON *msg, FILE *dbg) {
+  if (lsp_dispatch_write(s, msg, &o->resp)) {
+    if (dbg) {
+      fprintf(dbg, "lsp_run: dispatch done, writing resp\n");
+      fflush(dbg);
+    }
+    spt_mutex_lock(&o->lock);
+    write_out(o, &o->resp);
+    spt_mutex_unlock(&o->lock);
+  } else if (dbg) {
+    fprintf(dbg, "lsp_run: dispatch returned null (notification)\n");
+    fflush(dbg);
+  }
+}
 
-  lsp_server_set_emit(s, stdio_emit, out);
+int lsp_run(LspServer *s, FILE *in, FILE *out) {
+  FILE *dbg = spt_open_log();
+
+  StdioOut o;
+  o.out = out;
+  spt_mutex_init(&o.lock);
+  jw_init(&o.note);
+  jw_init(&o.resp);
+  lsp_server_set_emit(s, stdio_emit, &o);
+  if (!lsp_server_start_diagnostics(s, SPT_LSP_DIAG_DEBOUNCE_MS) && dbg) {
+    fprintf(dbg, "lsp_run: diagnostics worker unavailable, publishing synchronously\n");
+    fflush(dbg);
+  }
+
+  StdioIn si;
+  memset(&si, 0, sizeof si);
+  si.s = s;
+  si.o = &o;
+  rpc_reader_init(&si.r);
+  si.fd = spt_fileno(in);
+  si.dbg = dbg;
+  lsp_server_set_poll(s, stdio_poll, &si);
   if (dbg) {
     fprintf(dbg, "lsp_run: emit set, entering loop\n");
     fflush(dbg);
   }
 
   while (!s->should_exit) {
-    const char *body;
-    size_t blen;
-    int rc = rpc_reader_next(&r, &body, &blen);
-    if (rc == 1) {
-      if (dbg) {
-        fprintf(dbg, "lsp_run: got msg, blen=%zu\n", blen);
-        fflush(dbg);
-      }
-      /* 录制接收到的原始消息 */
-      FILE *rec = spt_open_record();
-      if (rec) {
-        fwrite(body, 1, blen, rec);
-        fputc('\n', rec);
-        fflush(rec);
-        fclose(rec);
-      }
-      cJSON *msg = rpc_parse(body, blen);
-      if (!msg) {
-        if (dbg) {
-          fprintf(dbg, "lsp_run: parse failed\n");
-          fflush(dbg);
-        }
-        cJSON *err = rpc_make_error(NULL, RPC_PARSE_ERROR, "invalid JSON");
-        rpc_write(out, err);
-        cJSON_Delete(err);
-        continue;
-      }
-      cJSON *resp = lsp_dispatch(s, msg);
-      if (resp) {
-        if (dbg) {
-          fprintf(dbg, "lsp_run: dispatch done, writing resp\n");
-          fflush(dbg);
-        }
-        rpc_write(out, resp);
-        cJSON_Delete(resp);
-      } else {
-        if (dbg) {
-          fprintf(dbg, "lsp_run: dispatch returned null (notification)\n");
-          fflush(dbg);
-        }
-      }
+    /* 先取出缓冲中全部完整消息（其中的取消随即生效），再按到达顺序逐条分派。 */
+    in_drain(&si);
+    if (si.head < si.count) {
+      cJSON *msg = si.queue[si.head++];
+      dispatch_one(s, &o, msg, dbg);
       cJSON_Delete(msg);
       continue;
     }
-    if (rc == -1) {
-      if (dbg) {
-        fprintf(dbg, "lsp_run: rpc_reader_next error\n");
-        fflush(dbg);
-      }
+    si.head = si.count = 0;
+    if (si.broken || si.eof)
       break;
-    }
     if (dbg) {
       fprintf(dbg, "lsp_run: need more data, reading\n");
       fflush(dbg);
     }
-    int fd = spt_fileno(in);
-    int n = (int)spt_read(fd, chunk, sizeof(chunk));
-    if (dbg) {
-      fprintf(dbg, "lsp_run: read n=%d errno=%d\n", n, errno);
-      fflush(dbg);
-    }
-    if (n <= 0)
-      break; /* EOF 或错误：客户端断开 */
-    rpc_reader_feed(&r, chunk, (size_t)n);
+    in_read(&si);
   }
 
   if (dbg) {
     fprintf(dbg, "lsp_run: loop exited, should_exit=%d\n", s->should_exit);
     fflush(dbg);
   }
-  rpc_reader_free(&r);
+  /* 出入口在本栈帧上：先停后台线程，再解除出口与输入钩子。 */
+  lsp_server_stop_diagnostics(s);
+  lsp_server_set_emit(s, NULL, NULL);
+  lsp_server_set_poll(s, NULL, NULL);
+  spt_mutex_destroy(&o.lock);
+  jw_free(&o.note);
+  jw_free(&o.resp);
+  for (int i = si.head; i < si.count; i++)
+    cJSON_Delete(si.queue[i]);
+  free(si.queue);
+  rpc_reader_free(&si.r);
   if (dbg)
     fclose(dbg);
   return s->exit_code;
@@ -4,9 +4,16 @@
 ** 设计要点（为 TDD 而分离）：
 **   - lsp_dispatch 是纯函数式核心：输入 (server, 已解析的消息) -> 输出响应 cJSON
 **     （请求）或 NULL（通知/无响应）。不触碰 I/O，可在内存中直接断言。
-**   - lsp_run 是生产环境主循环：从 in 读、分派、向 out 写，直到 exit。
+**   - lsp_run 是生产环境主循环：从 in 读、分派、向 out 写，直到 exit。响应经
+**     lsp_dispatch_write 写入可复用的 JsonWriter，帧头就地补上后一次写出。
 **   - 生命周期遵循 LSP：initialize 前除 initialize 外的请求返回 not-initialized；
 **     shutdown 后的请求返回 invalid-request；exit 通知置退出标志。
+**   - 诊断：默认在 didOpen/didChange 内同步计算并推送；lsp_server_start_diagnostics 后改由
+**     后台线程去抖计算（diag_worker.h），lsp_run 总是启用后台诊断。
+**   - $/cancelRequest：登记被取消的请求 id，该请求若尚未执行则回复 RequestCancelled。
+**     lsp_run 把已到达的消息取出排队，其中的取消先于排队的请求生效；请求执行期间经
+**     poll 钩子收取新到达的输入，在阶段之间（建索引后、写出结果前）检查取消，命中则丢弃
+**     结果改回 RequestCancelled。取消登记跨读批保留，只保留最近 LSP_CANCEL_KEEP 条。
 */
 #ifndef SPT_LSP_SERVER_H
 #define SPT_LSP_SERVER_H
@@ -18,6 +25,9 @@
 #include <stdbool.h>
 #include <stdio.h>
 
+struct DiagWorker;
+struct SemTokStore;
+
 typedef enum {
   LSP_UNINITIALIZED = 0, /* 尚未收到 initialize */
   LSP_INITIALIZED,       /* 已 initialize（initialized 通知后亦同此态） */
@@ -28,6 +38,13 @@ typedef enum {
 ** 实现接管 msg 的所有权（负责写出并 cJSON_Delete）。 */
 typedef void (*LspEmitFn)(void *ctx, cJSON *msg);
 
+/* 收取已到达输入的钩子：请求执行期间调用，不阻塞；其中的 $/cancelRequest 立即登记，
+** 其它消息由实现自行排队，留到当前请求结束后分派。 */
+typedef void (*LspPollFn)(void *ctx);
+
+/* 取消登记表最多保留的条数（已执行请求的迟到取消不会被取走，超出时丢弃最旧的）。 */
+#define LSP_CANCEL_KEEP 64
+
 typedef struct {
   LspState state;
   bool should_exit; /* 收到 exit 后置位 */
@@ -36,6 +53,12 @@ typedef struct {
   Workspace ws;   /* 跨文件符号索引 */
   LspEmitFn emit; /* 通知出口（可空：无出口时丢弃） */
   void *emit_ctx;
+  struct DiagWorker *diag; /* 后台诊断线程；NULL = 同步诊断 */
+  struct SemTokStore *semtok; /* semanticTokens/full/delta 的逐文档基线 */
+  LspPollFn poll;          /* 请求执行期间收取输入（可空：只看已登记的取消） */
+  void *poll_ctx;
+  char **cancelled;        /* 已请求取消、尚未答复的请求 id（JSON 文本形式，先到在前） */
+  int cancelled_count, cancelled_cap;
 } LspServer;
 
 void lsp_server_init(LspServer *s);
@@ -44,14 +67,30 @@ void lsp_server_free(LspServer *s);
 /* 设置通知出口（测试用捕获器 / 生产用写 stdout）。 */
 void lsp_server_set_emit(LspServer *s, LspEmitFn fn, void *ctx);
 
+/* 设置请求执行期间的输入收取钩子（lsp_run 设置；测试可模拟执行中到达的取消）。 */
+void lsp_server_set_poll(LspServer *s, LspPollFn fn, void *ctx);
+
 /* 主动发出一条消息（接管 msg 所有权）。 */
 void lsp_emit(LspServer *s, cJSON *msg);
 
+/* 改用后台线程计算诊断（去抖 debounce_ms 毫秒），推送经当前的通知出口（须线程安全）。
+** 已启用时无操作。线程创建失败返回 false，保持同步诊断。 */
+bool lsp_server_start_diagnostics(LspServer *s, int debounce_ms);
+/* 停止后台诊断线程（丢弃未计算的任务），回到同步诊断。 */
+void lsp_server_stop_diagnostics(LspServer *s);
+/* 立即计算全部待算诊断并等待推送完毕；同步模式下无操作。 */
+void lsp_server_flush_diagnostics(LspServer *s);
+
 /* 分派一条已解析的消息。
 **   - 请求（含 id）：返回应回复的 cJSON（成功或错误），调用方负责 framing/写出/删除。
 **   - 通知（无 id）：返回 NULL（无响应）；副作用在内部完成。 */
 cJSON *lsp_dispatch(LspServer *s, const cJSON *msg);
 
+/* 同 lsp_dispatch，但把响应消息体直接写入 w（调用方先 jw_reset）。返回 1 = 有响应，0 = 无。
+** 结果可能很大的请求（semanticTokens full/delta/range、references、workspace/symbol）不建
+** cJSON 树，由 provider 直接写出；其余请求仍经 lsp_dispatch，再把树写进 w。 */
+int lsp_dispatch_write(LspServer *s, const cJSON *msg, JsonWriter *w);
+
 /* 生产主循环：从 in 读 LSP 消息、分派、把响应写入 out，直到 should_exit。
 ** 返回进程退出码。 */
 int lsp_run(LspServer *s, FILE *in, FILE *out);
@@ -0,0 +1,147 @@
+/*
+** spt_thread.h — 最小线程原语封装（POSIX pthread / Win32），供后台诊断线程与并行索引使用。
+**
+** 只提供本服务器用到的部分：线程、互斥量、条件变量（含毫秒超时等待）、单调毫秒时钟、
+** CPU 数、线程局部存储说明符。全部为 static inline，无额外翻译单元。
+*/
+#ifndef SPT_LSP_THREAD_H
+#define SPT_LSP_THREAD_H
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SPT_THREAD_LOCAL __declspec(thread)
+#else
+#define SPT_THREAD_LOCAL _Thread_local
+#endif
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <process.h>
+#include <windows.h>
+
+typedef HANDLE SptThread;
+typedef CRITICAL_SECTION SptMutex;
+typedef CONDITION_VARIABLE SptCond;
+typedef void (*SptThreadFn)(void *arg);
+
+typedef struct {
+  SptThreadFn fn;
+  void *arg;
+} SptThreadStart_;
+
+static unsigned __stdcall spt_thread_trampoline_(void *p) {
+  SptThreadStart_ st = *(SptThreadStart_ *)p;
+  free(p);
+  st.fn(st.arg);
+  return 0;
+}
+
+static inline int spt_thread_create(SptThread *t, SptThreadFn fn, void *arg) {
+  SptThreadStart_ *st = (SptThreadStart_ *)malloc(sizeof *st);
+  if (!st)
+    return 0;
+  st->fn = fn;
+  st->arg = arg;
+  *t = (HANDLE)_beginthreadex(NULL, 0, spt_thread_trampoline_, st, 0, NULL);
+  if (!*t) {
+    free(st);
+    return 0;
+  }
+  return 1;
+}
+static inline void spt_thread_join(SptThread t) {
+  WaitForSingleObject(t, INFINITE);
+  CloseHandle(t);
+}
+static inline void spt_mutex_init(SptMutex *m) { InitializeCriticalSection(m); }
+static inline void spt_mutex_destroy(SptMutex *m) { DeleteCriticalSection(m); }
+static inline void spt_mutex_lock(SptMutex *m) { EnterCriticalSection(m); }
+static inline void spt_mutex_unlock(SptMutex *m) { LeaveCriticalSection(m); }
+static inline void spt_cond_init(SptCond *c) { InitializeConditionVariable(c); }
+static inline void spt_cond_destroy(SptCond *c) { (void)c; }
+static inline void spt_cond_wait(SptCond *c, SptMutex *m) {
+  SleepConditionVariableCS(c, m, INFINITE);
+}
+static inline void spt_cond_wait_ms(SptCond *c, SptMutex *m, long ms) {
+  SleepConditionVariableCS(c, m, ms > 0 ? (DWORD)ms : 0);
+}
+static inline void spt_cond_broadcast(SptCond *c) { WakeAllConditionVariable(c); }
+static inline long long spt_now_ms(void) { return (long long)GetTickCount64(); }
+static inline int spt_cpu_count(void) {
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  return si.dwNumberOfProcessors > 0 ? (int)si.dwNumberOfProcessors : 1;
+}
+
+#else /* POSIX */
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef pthread_t SptThread;
+typedef pthread_mutex_t SptMutex;
+typedef pthread_cond_t SptCond;
+typedef void (*SptThreadFn)(void *arg);
+
+typedef struct {
+  SptThreadFn fn;
+  void *arg;
+} SptThreadStart_;
+
+static void *spt_thread_trampoline_(void *p) {
+  SptThreadStart_ st = *(SptThreadStart_ *)p;
+  free(p);
+  st.fn(st.arg);
+  return NULL;
+}
+
+static inline int spt_thread_create(SptThread *t, SptThreadFn fn, void *arg) {
+  SptThreadStart_ *st = (SptThreadStart_ *)malloc(sizeof *st);
+  if (!st)
+    return 0;
+  st->fn = fn;
+  st->arg = arg;
+  if (pthread_create(t, NULL, spt_thread_trampoline_, st) != 0) {
+    free(st);
+    return 0;
+  }
+  return 1;
+}
+static inline void spt_thread_join(SptThread t) { pthread_join(t, NULL); }
+static inline void spt_mutex_init(SptMutex *m) { pthread_mutex_init(m, NULL); }
+static inline void spt_mutex_destroy(SptMutex *m) { pthread_mutex_destroy(m); }
+static inline void spt_mutex_lock(SptMutex *m) { pthread_mutex_lock(m); }
+static inline void spt_mutex_unlock(SptMutex *m) { pthread_mutex_unlock(m); }
+static inline void spt_cond_init(SptCond *c) { pthread_cond_init(c, NULL); }
+static inline void spt_cond_destroy(SptCond *c) { pthread_cond_destroy(c); }
+static inline void spt_cond_wait(SptCond *c, SptMutex *m) { pthread_cond_wait(c, m); }
+/* 最多等待 ms 毫秒（可被唤醒或虚假唤醒提前返回；调用方循环检查条件）。 */
+static inline void spt_cond_wait_ms(SptCond *c, SptMutex *m, long ms) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  if (ms < 0)
+    ms = 0;
+  ts.tv_sec += ms / 1000;
+  ts.tv_nsec += (ms % 1000) * 1000000L;
+  if (ts.tv_nsec >= 1000000000L) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000L;
+  }
+  pthread_cond_timedwait(c, m, &ts);
+}
+static inline void spt_cond_broadcast(SptCond *c) { pthread_cond_broadcast(c); }
+static inline long long spt_now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+static inline int spt_cpu_count(void) {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+}
+#endif
+
+#endif /* SPT_LSP_THREAD_H */
@@ -0,0 +1,121 @@
+/*
+** uri_table.c — URI 驻留表实现。
+*/
+#include "uri_table.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned hash_str(const char *s) {
+  unsigned h = 2166136261u; /* FNV-1a */
+  for (; *s; s++)
+    h = (h ^ (unsigned char)*s) * 16777619u;
+  return h;
+}
+
+UriTable *uri_table_new(void) {
+  UriTable *t = (UriTable *)calloc(1, sizeof(UriTable));
+  if (t)
+    t->refs = 1;
+  return t;
+}
+
+UriTable *uri_table_retain(UriTable *t) {
+  if (t)
+    t->refs++;
+  return t;
+}
+
+void uri_table_release(UriTable *t) {
+  if (!t || --t->refs > 0)
+    return;
+  for (int i = 0; i < t->count; i++)
+    free(t->strs[i]);
+  free(t->strs);
+  free(t->hashes);
+  free(t->slots);
+  free(t);
+}
+
+/* 在槽表中查 uri：命中返回 id，否则返回 -1 并把空槽位置写入 *empty。 */
+static int probe(const UriTable *t, const char *uri, unsigned h, int *empty) {
+  unsigned mask = (unsigned)t->slot_cap - 1;
+  for (unsigned k = h & mask;; k = (k + 1) & mask) {
+    int v = t->slots[k];
+    if (v == 0) {
+      if (empty)
+        *empty = (int)k;
+      return -1;
+    }
+    if (t->hashes[v - 1] == h && strcmp(t->strs[v - 1], uri) == 0)
+      return v - 1;
+  }
+}
+
+static int grow_slots(UriTable *t) {
+  int nc = t->slot_cap ? t->slot_cap * 2 : 64;
+  int *ns = (int *)calloc((size_t)nc, sizeof(int));
+  if (!ns)
+    return 0;
+  unsigned mask = (unsigned)nc - 1;
+  for (int id = 0; id < t->count; id++) {
+    unsigned k = t->hashes[id] & mask;
+    while (ns[k])
+      k = (k + 1) & mask;
+    ns[k] = id + 1;
+  }
+  free(t->slots);
+  t->slots = ns;
+  t->slot_cap = nc;
+  return 1;
+}
+
+int uri_table_find(const UriTable *t, const char *uri) {
+  if (!t || !uri || t->slot_cap == 0)
+    return -1;
+  return probe(t, uri, hash_str(uri), NULL);
+}
+
+int uri_table_intern(UriTable *t, const char *uri) {
+  if (!t || !uri)
+    return -1;
+  unsigned h = hash_str(uri);
+  if (t->slot_cap > 0) {
+    int id = probe(t, uri, h, NULL);
+    if (id >= 0)
+      return id;
+  }
+  /* 负载因子保持在 1/2 以下。 */
+  if ((t->count + 1) * 2 > t->slot_cap && !grow_slots(t))
+    return -1;
+  if (t->count >= t->cap) {
+    int nc = t->cap ? t->cap * 2 : 32;
+    char **ns = (char **)realloc(t->strs, sizeof(char *) * (size_t)nc);
+    if (!ns)
+      return -1;
+    t->strs = ns;
+    unsigned *nh = (unsigned *)realloc(t->hashes, sizeof(unsigned) * (size_t)nc);
+    if (!nh)
+      return -1;
+    t->hashes = nh;
+    t->cap = nc;
+  }
+  size_t n = strlen(uri);
+  char *copy = (char *)malloc(n + 1);
+  if (!copy)
+    return -1;
+  memcpy(copy, uri, n + 1);
+  int empty = 0;
+  probe(t, uri, h, &empty);
+  int id = t->count++;
+  t->strs[id] = copy;
+  t->hashes[id] = h;
+  t->slots[empty] = id + 1;
+  return id;
+}
+
+const char *uri_table_str(const UriTable *t, int id) {
+  if (!t || id < 0 || id >= t->count)
+    return NULL;
+  return t->strs[id];
+}
@@ -0,0 +1,36 @@
+/*
+** uri_table.h — URI 驻留表：字符串 <-> 稠密整数 id。
+**
+** 同一个 URI 在文档存储、工作区的目标文件缓存、引用倒排里反复出现；驻留后各处只存 id，
+** 查找为一次哈希 + 一次 strcmp，比较为整数比较，引用出现不再各自复制一份 URI。
+**
+** id 从 0 起连续分配，存活到表释放为止（URI 数量以工作区文件数为界），因此调用方可直接
+** 用 id 下标普通数组做 O(1) 映射。表带引用计数，供 DocStore 与 Workspace 共用。
+** 不是线程安全的：只在主线程上使用。
+*/
+#ifndef SPT_LSP_URI_TABLE_H
+#define SPT_LSP_URI_TABLE_H
+
+typedef struct UriTable {
+  char **strs;      /* id -> 拥有的字符串 */
+  unsigned *hashes; /* id -> 哈希（扩容重排时不必重算） */
+  int count, cap;
+  int *slots; /* 开放寻址：id + 1，0 = 空 */
+  int slot_cap;
+  int refs;
+} UriTable;
+
+/* 新建（引用计数 1）；内存不足返回 NULL。 */
+UriTable *uri_table_new(void);
+UriTable *uri_table_retain(UriTable *t);
+/* 引用计数减一，归零时释放。t 可为 NULL。 */
+void uri_table_release(UriTable *t);
+
+/* 取 uri 的 id，不存在时登记。内存不足返回 -1。 */
+int uri_table_intern(UriTable *t, const char *uri);
+/* 只查不登记；不存在返回 -1。 */
+int uri_table_find(const UriTable *t, const char *uri);
+/* id -> 字符串；越界返回 NULL。 */
+const char *uri_table_str(const UriTable *t, int id);
+
+#endif /* SPT_LSP_URI_TABLE_H */
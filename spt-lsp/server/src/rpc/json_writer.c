@@ -0,0 +1,312 @@
+/*
+** json_writer.c — 流式 JSON 写出器实现（格式与 cJSON_PrintUnformatted 一致）。
+*/
+#include "json_writer.h"
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void jw_init(JsonWriter *w) {
+  memset(w, 0, sizeof *w);
+  w->len = JW_HEADROOM;
+}
+
+void jw_free(JsonWriter *w) {
+  free(w->buf);
+  jw_init(w);
+}
+
+void jw_reset(JsonWriter *w) {
+  w->len = JW_HEADROOM;
+  w->oom = 0;
+  w->depth = 0;
+  w->after_key = 0;
+}
+
+/* 保证还能写 n 字节；失败置 oom 并返回 0。 */
+static int reserve(JsonWriter *w, size_t n) {
+  if (w->oom)
+    return 0;
+  if (w->len + n <= w->cap)
+    return 1;
+  size_t nc = w->cap ? w->cap : 4096;
+  while (w->len + n > nc)
+    nc *= 2;
+  char *nb = (char *)realloc(w->buf, nc);
+  if (!nb) {
+    w->oom = 1;
+    return 0;
+  }
+  w->buf = nb;
+  w->cap = nc;
+  return 1;
+}
+
+static void put(JsonWriter *w, const char *s, size_t n) {
+  if (reserve(w, n)) {
+    memcpy(w->buf + w->len, s, n);
+    w->len += n;
+  }
+}
+
+static void put_c(JsonWriter *w, char c) {
+  if (reserve(w, 1))
+    w->buf[w->len++] = c;
+}
+
+/* 写一个值之前：数组 / 对象内的非首元素先写逗号（对象成员的逗号由 jw_key 负责）。 */
+static void before_value(JsonWriter *w) {
+  if (w->after_key) {
+    w->after_key = 0;
+    return;
+  }
+  if (w->depth > 0) {
+    if (w->nonempty[w->depth - 1])
+      put_c(w, ',');
+    w->nonempty[w->depth - 1] = 1;
+  }
+}
+
+static void begin(JsonWriter *w, char c) {
+  before_value(w);
+  put_c(w, c);
+  if (w->depth < JW_MAX_DEPTH)
+    w->nonempty[w->depth] = 0;
+  else
+    w->oom = 1; /* 嵌套过深：按失败处理 */
+  w->depth++;
+}
+
+static void end(JsonWriter *w, char c) {
+  if (w->depth > 0)
+    w->depth--;
+  put_c(w, c);
+}
+
+void jw_begin_object(JsonWriter *w) { begin(w, '{'); }
+void jw_end_object(JsonWriter *w) { end(w, '}'); }
+void jw_begin_array(JsonWriter *w) { begin(w, '['); }
+void jw_end_array(JsonWriter *w) { end(w, ']'); }
+
+static void put_escaped(JsonWriter *w, const char *s, size_t n) {
+  static const char hex[] = "0123456789abcdef";
+  /* 最坏每字节 6 字节（\u00XX），一次预留避免逐字节检查容量。 */
+  if (!reserve(w, n * 6 + 2))
+    return;
+  char *o = w->buf + w->len;
+  *o++ = '"';
+  for (size_t i = 0; i < n; i++) {
+    unsigned char c = (unsigned char)s[i];
+    if (c >= 32 && c != '"' && c != '\\') {
+      *o++ = (char)c;
+      continue;
+    }
+    *o++ = '\\';
+    switch (c) {
+    case '"':
+      *o++ = '"';
+      break;
+    case '\\':
+      *o++ = '\\';
+      break;
+    case '\b':
+      *o++ = 'b';
+      break;
+    case '\f':
+      *o++ = 'f';
+      break;
+    case '\n':
+      *o++ = 'n';
+      break;
+    case '\r':
+      *o++ = 'r';
+      break;
+    case '\t':
+      *o++ = 't';
+      break;
+    default:
+      *o++ = 'u';
+      *o++ = '0';
+      *o++ = '0';
+      *o++ = hex[c >> 4];
+      *o++ = hex[c & 15];
+      break;
+    }
+  }
+  *o++ = '"';
+  w->len = (size_t)(o - w->buf);
+}
+
+void jw_key(JsonWriter *w, const char *key) {
+  if (w->depth > 0) {
+    if (w->nonempty[w->depth - 1])
+      put_c(w, ',');
+    w->nonempty[w->depth - 1] = 1;
+  }
+  put_escaped(w, key, strlen(key));
+  put_c(w, ':');
+  w->after_key = 1;
+}
+
+void jw_string_n(JsonWriter *w, const char *s, size_t n) {
+  before_value(w);
+  put_escaped(w, s, n);
+}
+
+void jw_string(JsonWriter *w, const char *s) {
+  if (!s) {
+    jw_null(w);
+    return;
+  }
+  jw_string_n(w, s, strlen(s));
+}
+
+/* 十进制整数写入 out（不含 NUL），返回长度。 */
+static int fmt_int(char *out, long long v) {
+  char tmp[24];
+  int n = 0;
+  unsigned long long u = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+  do {
+    tmp[n++] = (char)('0' + u % 10);
+    u /= 10;
+  } while (u);
+  int k = 0;
+  if (v < 0)
+    out[k++] = '-';
+  while (n > 0)
+    out[k++] = tmp[--n];
+  return k;
+}
+
+void jw_int(JsonWriter *w, long long v) {
+  before_value(w);
+  if (reserve(w, 21))
+    w->len += (size_t)fmt_int(w->buf + w->len, v);
+}
+
+void jw_number(JsonWriter *w, double d) {
+  char buf[32];
+  int n;
+  /* 与 cJSON print_number 相同：int 范围内的整数值按整数打印，其余先 15 位有效数字，
+     不能还原再用 17 位。 */
+  if (isnan(d) || isinf(d)) {
+    n = snprintf(buf, sizeof buf, "null");
+  } else if (d >= (double)INT_MIN && d <= (double)INT_MAX && d == (double)(int)d) {
+    n = fmt_int(buf, (int)d);
+  } else {
+    double test = 0.0;
+    n = snprintf(buf, sizeof buf, "%1.15g", d);
+    int ok = sscanf(buf, "%lg", &test) == 1;
+    double mag = fabs(test) > fabs(d) ? fabs(test) : fabs(d);
+    if (!ok || fabs(test - d) > mag * DBL_EPSILON)
+      n = snprintf(buf, sizeof buf, "%1.17g", d);
+  }
+  before_value(w);
+  if (n > 0)
+    put(w, buf, (size_t)n);
+}
+
+void jw_bool(JsonWriter *w, int v) {
+  before_value(w);
+  if (v)
+    put(w, "true", 4);
+  else
+    put(w, "false", 5);
+}
+
+void jw_null(JsonWriter *w) {
+  before_value(w);
+  put(w, "null", 4);
+}
+
+void jw_int_array(JsonWriter *w, const int *v, int n) {
+  jw_begin_array(w);
+  /* 每个元素至多 11 位 + 逗号，一次预留后直接写。 */
+  if (n > 0 && reserve(w, (size_t)n * 12)) {
+    char *o = w->buf + w->len;
+    for (int i = 0; i < n; i++) {
+      if (i > 0)
+        *o++ = ',';
+      o += fmt_int(o, v[i]);
+    }
+    w->len = (size_t)(o - w->buf);
+    w->nonempty[w->depth - 1] = 1;
+  }
+  jw_end_array(w);
+}
+
+void jw_cjson(JsonWriter *w, const cJSON *v) {
+  if (!v) {
+    jw_null(w);
+    return;
+  }
+  switch (v->type & 0xFF) {
+  case cJSON_NULL:
+    jw_null(w);
+    break;
+  case cJSON_False:
+    jw_bool(w, 0);
+    break;
+  case cJSON_True:
+    jw_bool(w, 1);
+    break;
+  case cJSON_Number:
+    jw_number(w, v->valuedouble);
+    break;
+  case cJSON_String:
+    jw_string(w, v->valuestring ? v->valuestring : "");
+    break;
+  case cJSON_Raw:
+    before_value(w);
+    if (v->valuestring)
+      put(w, v->valuestring, strlen(v->valuestring));
+    break;
+  case cJSON_Array:
+    jw_begin_array(w);
+    for (const cJSON *c = v->child; c; c = c->next)
+      jw_cjson(w, c);
+    jw_end_array(w);
+    break;
+  case cJSON_Object:
+    jw_begin_object(w);
+    for (const cJSON *c = v->child; c; c = c->next) {
+      jw_key(w, c->string ? c->string : "");
+      jw_cjson(w, c);
+    }
+    jw_end_object(w);
+    break;
+  default:
+    jw_null(w);
+    break;
+  }
+}
+
+cJSON *jw_parse(const JsonWriter *w) {
+  size_t n;
+  const char *body = jw_body(w, &n);
+  return w->oom ? NULL : cJSON_ParseWithLength(body, n);
+}
+
+const char *jw_body(const JsonWriter *w, size_t *len) {
+  if (len)
+    *len = w->len - JW_HEADROOM;
+  return w->buf ? w->buf + JW_HEADROOM : "";
+}
+
+const char *jw_frame(JsonWriter *w, size_t *len) {
+  if (!reserve(w, 0)) /* 空消息体时也要有缓冲放帧头 */
+    return NULL;
+  char hdr[JW_HEADROOM];
+  int hn = snprintf(hdr, sizeof hdr, "Content-Length: %zu\r\n\r\n", w->len - JW_HEADROOM);
+  if (hn <= 0 || hn > JW_HEADROOM)
+    return NULL;
+  char *start = w->buf + JW_HEADROOM - hn;
+  memcpy(start, hdr, (size_t)hn);
+  if (len)
+    *len = w->len - JW_HEADROOM + (size_t)hn;
+  return start;
+}
@@ -0,0 +1,65 @@
+/*
+** json_writer.h — 流式 JSON 写出器（直接写入可复用的输出缓冲）。
+**
+** 大响应（语义高亮、跨工作区引用、workspace/symbol）若先建 cJSON 树再 cJSON_PrintUnformatted，
+** 要分配成千上万个小节点，再拼一整份字符串，最后为加 Content-Length 头又复制一次。
+** JsonWriter 让 provider 边算边写：逗号由嵌套栈自动维护，缓冲在多次响应间复用（jw_reset 不释放）。
+**
+** 缓冲开头预留 JW_HEADROOM 字节：消息体写完后长度已知，rpc_write_body 把
+** "Content-Length: N\r\n\r\n" 就地写进消息体之前的预留区，整帧一次写出，无需再复制消息体。
+**
+** 任一步内存不足时置 oom，之后的写入都被忽略；调用方在写完后检查一次即可。
+*/
+#ifndef SPT_JSON_WRITER_H
+#define SPT_JSON_WRITER_H
+
+#include "cJSON.h"
+
+#include <stddef.h>
+
+#define JW_HEADROOM 48 /* >= strlen("Content-Length: ") + 20 位十进制 + "\r\n\r\n" */
+#define JW_MAX_DEPTH 64
+
+typedef struct {
+  char *buf;  /* [0, JW_HEADROOM) 为帧头预留区，消息体从 JW_HEADROOM 开始 */
+  size_t len; /* 含预留区 */
+  size_t cap;
+  int oom;
+  int depth;
+  int after_key;                         /* 刚写完 "key":，下一个值不加逗号 */
+  unsigned char nonempty[JW_MAX_DEPTH]; /* 各层是否已有元素（决定是否先写逗号） */
+} JsonWriter;
+
+void jw_init(JsonWriter *w);
+void jw_free(JsonWriter *w);
+/* 清空内容以写下一条消息（保留缓冲）。 */
+void jw_reset(JsonWriter *w);
+
+void jw_begin_object(JsonWriter *w);
+void jw_end_object(JsonWriter *w);
+void jw_begin_array(JsonWriter *w);
+void jw_end_array(JsonWriter *w);
+/* 对象成员名；其后必须紧跟一个值。 */
+void jw_key(JsonWriter *w, const char *key);
+
+void jw_string(JsonWriter *w, const char *s);
+void jw_string_n(JsonWriter *w, const char *s, size_t n);
+void jw_int(JsonWriter *w, long long v);
+void jw_number(JsonWriter *w, double v); /* 与 cJSON 的数字格式一致 */
+void jw_bool(JsonWriter *w, int v);
+void jw_null(JsonWriter *w);
+/* 整数数组 [v0,v1,...]。 */
+void jw_int_array(JsonWriter *w, const int *v, int n);
+/* 写出一棵 cJSON 子树（与 cJSON_PrintUnformatted 输出相同）；v 为 NULL 时写 null。 */
+void jw_cjson(JsonWriter *w, const cJSON *v);
+
+/* 把已写出的消息体解析回 cJSON 树（调用方 cJSON_Delete）；供仍需树形结果的调用方。 */
+cJSON *jw_parse(const JsonWriter *w);
+
+/* 已写出的消息体（不含预留区）。 */
+const char *jw_body(const JsonWriter *w, size_t *len);
+
+/* 在预留区就地写帧头，返回整帧起始指针与总长度；oom 时返回 NULL。 */
+const char *jw_frame(JsonWriter *w, size_t *len);
+
+#endif /* SPT_JSON_WRITER_H */
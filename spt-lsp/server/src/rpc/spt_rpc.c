@@ -160,60 +160,56 @@ int rpc_reader_next(RpcReader *r, const char **body, size_t *body_len) {
 /* ===========================================================================
 ** 写出
 ** ========================================================================= */
-long rpc_write(FILE *out, const cJSON *v) {
-  char *body = cJSON_PrintUnformatted((cJSON *)v);
-  if (!body)
-    return -1;
-  size_t blen = strlen(body);
-  char hdr[64];
-  int hn = snprintf(hdr, sizeof(hdr), "Content-Length: %zu\r\n\r\n", blen);
-  if (hn < 0) {
-    free(body);
+long rpc_write_body(FILE *out, JsonWriter *w) {
+  size_t total;
+  const char *frame = jw_frame(w, &total);
+  if (!frame)
     return -1;
-  }
 #ifdef _WIN32
   /* Windows: fwrite/fprintf 在管道上可能缓冲不刷新，用 _write 直接写 fd */
   int fd = _fileno(out);
-  if (_write(fd, hdr, hn) != hn) {
-    free(body);
-    return -1;
-  }
-  if (_write(fd, body, (int)blen) != (int)blen) {
-    free(body);
-    return -1;
+  size_t written = total;
+  while (total > 0) {
+    int chunk = total > 0x40000000u ? 0x40000000 : (int)total;
+    int wn = _write(fd, frame, (unsigned)chunk);
+    if (wn <= 0)
+      return -1;
+    frame += wn;
+    total -= (size_t)wn;
   }
+  return (long)written;
 #else
-  size_t wn = fwrite(hdr, 1, (size_t)hn, out);
-  wn += fwrite(body, 1, blen, out);
+  size_t wn = fwrite(frame, 1, total, out);
   fflush(out);
-  free(body);
-  if (wn != (size_t)hn + blen)
+  if (wn != total)
     return -1;
-  return (long)((size_t)hn + blen);
+  return (long)total;
 #endif
-  free(body);
-  return (long)((size_t)hn + blen);
+}
+
+long rpc_write(FILE *out, const cJSON *v) {
+  JsonWriter w;
+  jw_init(&w);
+  jw_cjson(&w, v);
+  long n = rpc_write_body(out, &w);
+  jw_free(&w);
+  return n;
 }
 
 char *rpc_frame_to_string(const cJSON *v, size_t *out_len) {
-  char *body = cJSON_PrintUnformatted((cJSON *)v);
-  if (!body)
-    return NULL;
-  size_t blen = strlen(body);
-  char hdr[64];
-  int hn = snprintf(hdr, sizeof(hdr), "Content-Length: %zu\r\n\r\n", blen);
-  size_t total = (size_t)hn + blen;
-  char *out = (char *)malloc(total + 1);
-  if (!out) {
-    free(body);
-    return NULL;
+  JsonWriter w;
+  jw_init(&w);
+  jw_cjson(&w, v);
+  size_t total;
+  const char *frame = jw_frame(&w, &total);
+  char *out = frame ? (char *)malloc(total + 1) : NULL;
+  if (out) {
+    memcpy(out, frame, total);
+    out[total] = '\0';
+    if (out_len)
+      *out_len = total;
   }
-  memcpy(out, hdr, (size_t)hn);
-  memcpy(out + hn, body, blen);
-  out[total] = '\0';
-  free(body);
-  if (out_len)
-    *out_len = total;
+  jw_free(&w);
   return out;
 }
 
@@ -17,6 +17,7 @@
 #define SPT_RPC_H
 
 #include "cJSON.h"
+#include "json_writer.h"
 
 #include <stddef.h>
 #include <stdio.h>
@@ -30,6 +31,7 @@ enum {
   RPC_INTERNAL_ERROR = -32603,
   /* LSP 专用 */
   RPC_SERVER_NOT_INITIALIZED = -32002,
+  RPC_REQUEST_CANCELLED = -32800,
   RPC_REQUEST_FAILED = -32803
 };
 
@@ -61,9 +63,14 @@ int rpc_reader_next(RpcReader *r, const char **body, size_t *body_len);
 ** 写出
 ** ------------------------------------------------------------------------- */
 /* 把 JSON 值序列化并加 Content-Length 头写入 out（生产用 stdout）。
-** 返回写出的总字节数（含头）；失败返回 -1。不释放 v。 */
+** 返回写出的总字节数（含头）；失败返回 -1。不释放 v。
+** 经 JsonWriter 直接序列化（json_writer.h），不产生中间字符串。 */
 long rpc_write(FILE *out, const cJSON *v);
 
+/* 把 w 中已写好的消息体加 Content-Length 头一次写出（帧头写在 w 的预留区，不复制消息体）。
+** 返回写出的总字节数；失败返回 -1。w 可随后 jw_reset 复用。 */
+long rpc_write_body(FILE *out, JsonWriter *w);
+
 /* 测试友好：把带头的整条消息写入 malloc 缓冲（调用方 free）。*out_len 可空。 */
 char *rpc_frame_to_string(const cJSON *v, size_t *out_len);
 
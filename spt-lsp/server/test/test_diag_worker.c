@@ -0,0 +1,401 @@
+/*
+** test_diag_worker.c — 后台诊断（去抖 / 过期丢弃 / 关闭后不推送）与 $/cancelRequest。
+*/
+#include "diag_worker.h"
+#include "server.h"
+#include "spt_rpc.h"
+#include "spt_thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failed = 0;
+#define CHECK(cond, msg)                                                                           \
+  do {                                                                                             \
+    if (!(cond)) {                                                                                 \
+      printf("  FAIL: %s\n", msg);                                                                 \
+      failed++;                                                                                    \
+    }                                                                                              \
+  } while (0)
+
+/* 捕获服务器主动发出的消息（后台线程推送时由 worker 锁串行化；主线程只在 flush 之后读取）。 */
+typedef struct {
+  cJSON **msgs;
+  int count, cap;
+} Capture;
+
+static void cap_emit(void *ctx, cJSON *msg) {
+  Capture *c = (Capture *)ctx;
+  if (c->count >= c->cap) {
+    c->cap = c->cap ? c->cap * 2 : 8;
+    c->msgs = (cJSON **)realloc(c->msgs, sizeof(cJSON *) * (size_t)c->cap);
+  }
+  c->msgs[c->count++] = msg;
+}
+
+static void cap_clear(Capture *c) {
+  for (int i = 0; i < c->count; i++)
+    cJSON_Delete(c->msgs[i]);
+  c->count = 0;
+}
+
+static cJSON *publish_params(Capture *c, int i) {
+  return cJSON_GetObjectItemCaseSensitive(c->msgs[i], "params");
+}
+
+static int publish_version(Capture *c, int i) {
+  cJSON *v = cJSON_GetObjectItemCaseSensitive(publish_params(c, i), "version");
+  return v && cJSON_IsNumber(v) ? v->valueint : -1;
+}
+
+static int publish_diag_count(Capture *c, int i) {
+  cJSON *arr = cJSON_GetObjectItemCaseSensitive(publish_params(c, i), "diagnostics");
+  return arr ? cJSON_GetArraySize(arr) : -1;
+}
+
+static cJSON *message(const char *method, int id, cJSON *params) {
+  cJSON *o = cJSON_CreateObject();
+  cJSON_AddStringToObject(o, "jsonrpc", "2.0");
+  if (id > 0)
+    cJSON_AddNumberToObject(o, "id", id);
+  cJSON_AddStringToObject(o, "method", method);
+  cJSON_AddItemToObject(o, "params", params ? params : cJSON_CreateObject());
+  return o;
+}
+
+static cJSON *did_open(const char *uri, const char *text, int version) {
+  cJSON *td = cJSON_CreateObject();
+  cJSON_AddStringToObject(td, "uri", uri);
+  cJSON_AddStringToObject(td, "languageId", "sptscript");
+  cJSON_AddNumberToObject(td, "version", version);
+  cJSON_AddStringToObject(td, "text", text);
+  cJSON *p = cJSON_CreateObject();
+  cJSON_AddItemToObject(p, "textDocument", td);
+  return message("textDocument/didOpen", 0, p);
+}
+
+static cJSON *did_change(const char *uri, const char *text, int version) {
+  cJSON *td = cJSON_CreateObject();
+  cJSON_AddStringToObject(td, "uri", uri);
+  cJSON_AddNumberToObject(td, "version", version);
+  cJSON *ch = cJSON_CreateObject();
+  cJSON_AddStringToObject(ch, "text", text);
+  cJSON *arr = cJSON_CreateArray();
+  cJSON_AddItemToArray(arr, ch);
+  cJSON *p = cJSON_CreateObject();
+  cJSON_AddItemToObject(p, "textDocument", td);
+  cJSON_AddItemToObject(p, "contentChanges", arr);
+  return message("textDocument/didChange", 0, p);
+}
+
+static cJSON *did_close(const char *uri) {
+  cJSON *td = cJSON_CreateObject();
+  cJSON_AddStringToObject(td, "uri", uri);
+  cJSON *p = cJSON_CreateObject();
+  cJSON_AddItemToObject(p, "textDocument", td);
+  return message("textDocument/didClose", 0, p);
+}
+
+static cJSON *hover(const char *uri, int id) {
+  cJSON *td = cJSON_CreateObject();
+  cJSON_AddStringToObject(td, "uri", uri);
+  cJSON *pos = cJSON_CreateObject();
+  cJSON_AddNumberToObject(pos, "line", 0);
+  cJSON_AddNumberToObject(pos, "character", 4);
+  cJSON *p = cJSON_CreateObject();
+  cJSON_AddItemToObject(p, "textDocument", td);
+  cJSON_AddItemToObject(p, "position", pos);
+  return message("textDocument/hover", id, p);
+}
+
+static cJSON *cancel(int id) {
+  cJSON *p = cJSON_CreateObject();
+  cJSON_AddNumberToObject(p, "id", id);
+  return message("$/cancelRequest", 0, p);
+}
+
+/* 分派并丢弃结果。 */
+static void send(LspServer *s, cJSON *msg) {
+  cJSON_Delete(lsp_dispatch(s, msg));
+  cJSON_Delete(msg);
+}
+
+static int error_code(const cJSON *resp) {
+  cJSON *err = cJSON_GetObjectItemCaseSensitive(resp, "error");
+  cJSON *code = err ? cJSON_GetObjectItemCaseSensitive(err, "code") : NULL;
+  return code && cJSON_IsNumber(code) ? code->valueint : 0;
+}
+
+static void init_server(LspServer *s, Capture *cap) {
+  lsp_server_init(s);
+  lsp_server_set_emit(s, cap_emit, cap);
+  send(s, message("initialize", 1, NULL));
+}
+
+static const char *URI = "file:///w.spt";
+
+/* 去抖窗口内的连续编辑只计算最后一版。窗口设得很长，由 flush 触发计算，结果确定。 */
+static void test_debounce(void) {
+  printf("Testing: edits inside the debounce window coalesce...\n");
+  LspServer s;
+  Capture cap = {0};
+  init_server(&s, &cap);
+  CHECK(lsp_server_start_diagnostics(&s, 60000), "worker starts");
+
+  send(&s, did_open(URI, "int x = ;\n", 1));
+  for (int v = 2; v <= 6; v++)
+    send(&s, did_change(URI, v == 6 ? "int x = 1;\n" : "int x = ;\n", v));
+  CHECK(cap.count == 0, "nothing published while inside the debounce window");
+
+  /* 诊断待算时请求照常即时响应。 */
+  cJSON *h = hover(URI, 2);
+  cJSON *resp = lsp_dispatch(&s, h);
+  CHECK(resp && error_code(resp) == 0, "hover answered while diagnostics are pending");
+  cJSON_Delete(resp);
+  cJSON_Delete(h);
+
+  lsp_server_flush_diagnostics(&s);
+  CHECK(cap.count == 1, "exactly one publish after flush");
+  if (cap.count == 1) {
+    CHECK(publish_version(&cap, 0) == 6, "published the latest version");
+    CHECK(publish_diag_count(&cap, 0) == 0, "latest text is clean");
+  }
+  unsigned computed = 0, dropped = 0;
+  diag_worker_stats(s.diag, &computed, &dropped);
+  CHECK(computed == 1 && dropped == 5, "superseded versions were never computed");
+
+  /* 关闭后旧版本的诊断不再推送，只剩关闭时的空诊断。 */
+  printf("Testing: closing a document drops its pending diagnostics...\n");
+  cap_clear(&cap);
+  send(&s, did_change(URI, "int x = ;\n", 7));
+  send(&s, did_close(URI));
+  lsp_server_flush_diagnostics(&s);
+  CHECK(cap.count == 1 && publish_diag_count(&cap, 0) == 0, "only the empty close publish");
+
+  lsp_server_free(&s);
+  cap_clear(&cap);
+  free(cap.msgs);
+}
+
+/* 短窗口：不 flush，等定时器到期自行推送。 */
+static void test_timer(void) {
+  printf("Testing: diagnostics publish once the window elapses...\n");
+  LspServer s;
+  Capture cap = {0};
+  init_server(&s, &cap);
+  CHECK(lsp_server_start_diagnostics(&s, 5), "worker starts");
+  send(&s, did_open(URI, "int x = ;\n", 1));
+  long long deadline = spt_now_ms() + 10000;
+  unsigned computed = 0;
+  while (computed == 0 && spt_now_ms() < deadline)
+    diag_worker_stats(s.diag, &computed, NULL);
+  lsp_server_flush_diagnostics(&s); /* 与推送同步后再读取捕获 */
+  CHECK(computed == 1, "computed without flush");
+  CHECK(cap.count == 1 && publish_diag_count(&cap, 0) >= 1, "broken file published");
+  lsp_server_free(&s);
+  cap_clear(&cap);
+  free(cap.msgs);
+}
+
+/* $/cancelRequest 先于请求到达时，请求回复 RequestCancelled。 */
+static void test_cancel_dispatch(void) {
+  printf("Testing: cancelled requests answer RequestCancelled...\n");
+  LspServer s;
+  Capture cap = {0};
+  init_server(&s, &cap);
+  send(&s, did_open(URI, "int x = 1;\n", 1));
+  cap_clear(&cap);
+
+  send(&s, cancel(42));
+  cJSON *h = hover(URI, 42);
+  cJSON *resp = lsp_dispatch(&s, h);
+  CHECK(resp && error_code(resp) == RPC_REQUEST_CANCELLED, "cancelled request gets -32800");
+  cJSON_Delete(resp);
+  cJSON_Delete(h);
+
+  h = hover(URI, 43);
+  resp = lsp_dispatch(&s, h);
+  CHECK(resp && error_code(resp) == 0, "other requests are unaffected");
+  cJSON_Delete(resp);
+  cJSON_Delete(h);
+
+  lsp_server_free(&s);
+  cap_clear(&cap);
+  free(cap.msgs);
+}
+
+/* 模拟请求执行期间到达的输入：poll 钩子第一次被调用时登记对 id 的取消。 */
+typedef struct {
+  LspServer *s;
+  int id;
+  int calls;
+} LatePoll;
+
+static void late_cancel(void *ctx) {
+  LatePoll *lp = (LatePoll *)ctx;
+  if (lp->calls++ == 0)
+    send(lp->s, cancel(lp->id));
+}
+
+/* 取消在请求开始执行之后（下一读批）才到达：丢弃结果，回复 RequestCancelled。 */
+static void test_cancel_in_flight(void) {
+  printf("Testing: cancels arriving while a request runs...\n");
+  LspServer s;
+  Capture cap = {0};
+  init_server(&s, &cap);
+  send(&s, did_open(URI, "int x = 1;\n", 1));
+  LatePoll lp = {&s, 50, 0};
+  lsp_server_set_poll(&s, late_cancel, &lp);
+
+  cJSON *h = hover(URI, 50);
+  cJSON *resp = lsp_dispatch(&s, h);
+  CHECK(resp && error_code(resp) == RPC_REQUEST_CANCELLED, "in-flight request gets -32800");
+  CHECK(lp.calls >= 1, "poll hook consulted while the request ran");
+  cJSON_Delete(resp);
+  cJSON_Delete(h);
+
+  /* 热路径（直接写出）：建完索引后的阶段检查命中，已写的结果被丢弃。 */
+  JsonWriter w;
+  jw_init(&w);
+  lp.id = 51;
+  lp.calls = 0;
+  cJSON *q = cJSON_CreateObject();
+  cJSON_AddStringToObject(q, "query", "");
+  cJSON *ws = message("workspace/symbol", 51, q);
+  CHECK(lsp_dispatch_write(&s, ws, &w) == 1, "hot path answers");
+  resp = jw_parse(&w);
+  CHECK(resp && error_code(resp) == RPC_REQUEST_CANCELLED, "hot-path request gets -32800");
+  cJSON_Delete(resp);
+  cJSON_Delete(ws);
+  jw_free(&w);
+
+  /* 取消已被取走：后续同类请求照常答复。 */
+  lsp_server_set_poll(&s, NULL, NULL);
+  h = hover(URI, 52);
+  resp = lsp_dispatch(&s, h);
+  CHECK(resp && error_code(resp) == 0, "later requests are unaffected");
+  CHECK(s.cancelled_count == 0, "matched cancels are removed");
+  cJSON_Delete(resp);
+  cJSON_Delete(h);
+
+  /* 迟到的取消（请求早已答复）不会无限累积。 */
+  for (int i = 0; i < LSP_CANCEL_KEEP + 10; i++)
+    send(&s, cancel(1000 + i));
+  CHECK(s.cancelled_count == LSP_CANCEL_KEEP, "stale cancels are bounded");
+
+  lsp_server_free(&s);
+  cap_clear(&cap);
+  free(cap.msgs);
+}
+
+/* 读出 out 中全部响应，codes[id] = 错误码（0 = 成功；未答复保持原值）。 */
+static void read_codes(FILE *out, int *codes, int max_id) {
+  rewind(out);
+  RpcReader r;
+  rpc_reader_init(&r);
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof buf, out)) > 0)
+    rpc_reader_feed(&r, buf, n);
+  const char *body;
+  size_t blen;
+  while (rpc_reader_next(&r, &body, &blen) == 1) {
+    cJSON *m = rpc_parse(body, blen);
+    cJSON *id = cJSON_GetObjectItemCaseSensitive(m, "id");
+    if (id && cJSON_IsNumber(id) && id->valueint >= 0 && id->valueint <= max_id)
+      codes[id->valueint] = error_code(m);
+    cJSON_Delete(m);
+  }
+  rpc_reader_free(&r);
+}
+
+/* lsp_run：同一批到达的请求 + 其取消，请求不执行而回复 RequestCancelled。 */
+static void test_cancel_run(void) {
+  printf("Testing: lsp_run applies cancels to queued requests...\n");
+  FILE *in = tmpfile();
+  FILE *out = tmpfile();
+  CHECK(in && out, "tmpfile");
+  if (!in || !out)
+    return;
+  cJSON *msgs[] = {message("initialize", 1, NULL), did_open(URI, "int x = ;\n", 1),
+                   hover(URI, 2),                  cancel(2),
+                   hover(URI, 3),                  message("shutdown", 4, NULL),
+                   message("exit", 0, NULL)};
+  for (size_t i = 0; i < sizeof msgs / sizeof msgs[0]; i++) {
+    rpc_write(in, msgs[i]);
+    cJSON_Delete(msgs[i]);
+  }
+  rewind(in);
+
+  LspServer s;
+  lsp_server_init(&s);
+  int rc = lsp_run(&s, in, out);
+  CHECK(rc == 0, "clean exit");
+  CHECK(s.diag == NULL, "worker stopped when lsp_run returns");
+  lsp_server_free(&s);
+
+  int codes[4] = {1, 1, 1, 1};
+  read_codes(out, codes, 3);
+  CHECK(codes[2] == RPC_REQUEST_CANCELLED, "queued request was cancelled");
+  CHECK(codes[3] == 0, "next request still answered");
+  fclose(in);
+  fclose(out);
+}
+
+/* lsp_run：请求在第一次读入的块里，它的取消隔着一条大通知落在后面的块里。请求执行时
+** 收取新输入，取消仍然生效。 */
+static void test_cancel_run_across_reads(void) {
+  printf("Testing: lsp_run honours cancels from a later read...\n");
+  FILE *in = tmpfile();
+  FILE *out = tmpfile();
+  CHECK(in && out, "tmpfile");
+  if (!in || !out)
+    return;
+  char *pad = (char *)malloc(16384);
+  memset(pad, 'x', 16383);
+  pad[16383] = '\0';
+  cJSON *pp = cJSON_CreateObject();
+  cJSON_AddStringToObject(pp, "value", pad);
+  free(pad);
+  cJSON *msgs[] = {message("initialize", 1, NULL), hover(URI, 2),
+                   message("$/padding", 0, pp),    cancel(2),
+                   hover(URI, 3),                  message("shutdown", 4, NULL),
+                   message("exit", 0, NULL)};
+  for (size_t i = 0; i < sizeof msgs / sizeof msgs[0]; i++) {
+    rpc_write(in, msgs[i]);
+    cJSON_Delete(msgs[i]);
+  }
+  rewind(in);
+
+  LspServer s;
+  lsp_server_init(&s);
+  int rc = lsp_run(&s, in, out);
+  CHECK(rc == 0, "clean exit");
+  CHECK(s.poll == NULL, "poll hook detached when lsp_run returns");
+  lsp_server_free(&s);
+
+  int codes[5] = {1, 1, 1, 1, 1};
+  read_codes(out, codes, 4);
+  CHECK(codes[2] == RPC_REQUEST_CANCELLED, "request cancelled by a later read");
+  CHECK(codes[3] == 0, "next request still answered");
+  CHECK(codes[4] == 0, "shutdown answered");
+  fclose(in);
+  fclose(out);
+}
+
+int main(void) {
+  printf("=== TestDiagWorker: background diagnostics + cancellation ===\n");
+  test_debounce();
+  test_timer();
+  test_cancel_dispatch();
+  test_cancel_in_flight();
+  test_cancel_run();
+  test_cancel_run_across_reads();
+  if (failed == 0) {
+    printf("=== TestDiagWorker: ALL PASS ===\n");
+    return 0;
+  }
+  printf("=== TestDiagWorker: %d CHECK(s) FAILED ===\n", failed);
+  return 1;
+}
@@ -0,0 +1,243 @@
+/*
+** test_dispatch_write.c — lsp_dispatch_write（流式响应）与 lsp_dispatch（cJSON 树）等价。
+**
+** 两个服务器按同一消息脚本同步推进：一个走 lsp_dispatch，一个走 lsp_dispatch_write 再解析，
+** 每条响应须逐项相同（含 semanticTokens 的 resultId / delta 编辑、引用、workspace/symbol、
+** 生命周期错误与取消）。
+*/
+#include "server.h"
+#include "spt_rpc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+static int failed = 0;
+#define CHECK(cond, msg)                                                                           \
+  do {                                                                                             \
+    if (!(cond)) {                                                                                 \
+      printf("  FAIL: %s\n", msg);                                                                 \
+      failed++;                                                                                    \
+    }                                                                                              \
+  } while (0)
+
+static char LIB[4200], APP[4200], ROOT[4200];
+
+static const char *LIB_SRC = "export int helper(int x) { return x + 1; }\n"
+                             "export class Point {\n  int x;\n  int y;\n"
+                             "  int sum() { return x + y; }\n}\n";
+static const char *APP_SRC = "import { helper, Point } from \"./lib\";\n"
+                             "int run() {\n  Point p = new Point();\n"
+                             "  int a = helper(p.sum());\n  return helper(a) + a;\n}\n";
+
+static int next_id = 1;
+
+/* 临时工作区：lib.spt / app.spt 落盘并作为根目录，引用与 workspace/symbol 才有跨文件结果。 */
+static char *make_workspace(char *dir, size_t cap) {
+#ifdef _WIN32
+  char base[MAX_PATH];
+  if (!GetTempPathA(MAX_PATH, base))
+    return NULL;
+  snprintf(dir, cap, "%ssptdw_%lu", base, (unsigned long)GetCurrentProcessId());
+  if (!CreateDirectoryA(dir, NULL))
+    return NULL;
+#else
+  snprintf(dir, cap, "/tmp/sptdw_%d", (int)getpid());
+  if (mkdir(dir, 0777) != 0)
+    return NULL;
+#endif
+  const char *names[] = {"lib.spt", "app.spt"};
+  const char *texts[] = {LIB_SRC, APP_SRC};
+  char *uris[] = {LIB, APP};
+  for (int i = 0; i < 2; i++) {
+    char path[4200];
+    snprintf(path, sizeof path, "%s/%s", dir, names[i]);
+    FILE *f = fopen(path, "wb");
+    if (!f)
+      return NULL;
+    fputs(texts[i], f);
+    fclose(f);
+    spt_path_to_uri(path, uris[i], sizeof LIB);
+  }
+  spt_path_to_uri(dir, ROOT, sizeof ROOT);
+  return dir;
+}
+
+static void remove_workspace(const char *dir) {
+  char cmd[4300];
+#ifdef _WIN32
+  snprintf(cmd, sizeof cmd, "rmdir /s /q \"%s\" 2>nul", dir);
+#else
+  snprintf(cmd, sizeof cmd, "rm -rf %s", dir);
+#endif
+  if (system(cmd) != 0) { /* best-effort */
+  }
+}
+
+static cJSON *message(const char *method, int id, cJSON *params) {
+  cJSON *o = cJSON_CreateObject();
+  cJSON_AddStringToObject(o, "jsonrpc", "2.0");
+  if (id > 0)
+    cJSON_AddNumberToObject(o, "id", id);
+  cJSON_AddStringToObject(o, "method", method);
+  cJSON_AddItemToObject(o, "params", params ? params : cJSON_CreateObject());
+  return o;
+}
+
+static cJSON *doc(const char *uri) {
+  cJSON *td = cJSON_CreateObject();
+  cJSON_AddStringToObject(td, "uri", uri);
+  cJSON *p = cJSON_CreateObject();
+  cJSON_AddItemToObject(p, "textDocument", td);
+  return p;
+}
+
+static cJSON *at(const char *uri, int line, int ch) {
+  cJSON *p = doc(uri);
+  cJSON *pos = cJSON_CreateObject();
+  cJSON_AddNumberToObject(pos, "line", line);
+  cJSON_AddNumberToObject(pos, "character", ch);
+  cJSON_AddItemToObject(p, "position", pos);
+  return p;
+}
+
+static cJSON *open_doc(const char *uri, const char *text) {
+  cJSON *p = doc(uri);
+  cJSON *td = cJSON_GetObjectItemCaseSensitive(p, "textDocument");
+  cJSON_AddStringToObject(td, "languageId", "sptscript");
+  cJSON_AddNumberToObject(td, "version", 1);
+  cJSON_AddStringToObject(td, "text", text);
+  return message("textDocument/didOpen", 0, p);
+}
+
+/* 两个服务器各分派一次 msg（接管），比较响应。 */
+static void step(LspServer *tree, LspServer *stream, JsonWriter *w, cJSON *msg, const char *what) {
+  cJSON *want = lsp_dispatch(tree, msg);
+  jw_reset(w);
+  int has = lsp_dispatch_write(stream, msg, w);
+  cJSON *got = has ? jw_parse(w) : NULL;
+  CHECK((want == NULL) == (has == 0), what);
+  if (want && got && !cJSON_Compare(want, got, 1)) {
+    char *a = cJSON_PrintUnformatted(want);
+    size_t n;
+    const char *b = jw_body(w, &n);
+    printf("  FAIL: %s\n    tree   %.200s\n    stream %.200s\n", what, a, b);
+    free(a);
+    failed++;
+  }
+  cJSON_Delete(want);
+  cJSON_Delete(got);
+  cJSON_Delete(msg);
+}
+
+static cJSON *request(const char *method, cJSON *params) {
+  return message(method, next_id++, params);
+}
+
+int main(void) {
+  printf("=== TestDispatchWrite: streamed responses equal tree responses ===\n");
+  char dir[4096];
+  if (!make_workspace(dir, sizeof dir)) {
+    printf("  FAIL: temp workspace\n");
+    return 1;
+  }
+  LspServer a, b;
+  lsp_server_init(&a);
+  lsp_server_init(&b);
+  JsonWriter w;
+  jw_init(&w);
+
+  printf("Testing: lifecycle errors before initialize...\n");
+  step(&a, &b, &w, request("textDocument/semanticTokens/full", doc(APP)), "not initialized");
+
+  {
+    cJSON *p = cJSON_CreateObject();
+    cJSON_AddStringToObject(p, "rootUri", ROOT);
+    step(&a, &b, &w, request("initialize", p), "initialize");
+  }
+  step(&a, &b, &w, open_doc(LIB, LIB_SRC), "didOpen lib");
+  step(&a, &b, &w, open_doc(APP, APP_SRC), "didOpen app");
+
+  printf("Testing: semantic tokens full / delta / range...\n");
+  step(&a, &b, &w, request("textDocument/semanticTokens/full", doc(APP)), "semanticTokens/full");
+  {
+    cJSON *p = doc(APP);
+    cJSON_AddStringToObject(p, "previousResultId", "1"); /* 上一条 full 的 id（两边一致） */
+    step(&a, &b, &w, request("textDocument/semanticTokens/full/delta", p), "delta, no change");
+  }
+  {
+    cJSON *p = doc(APP);
+    cJSON_AddNumberToObject(cJSON_GetObjectItemCaseSensitive(p, "textDocument"), "version", 2);
+    cJSON *ch = cJSON_CreateObject();
+    cJSON_AddStringToObject(ch, "text", "import { helper } from \"./lib\";\n"
+                                        "int extra = helper(1);\nint run() { return extra; }\n");
+    cJSON *arr = cJSON_CreateArray();
+    cJSON_AddItemToArray(arr, ch);
+    cJSON_AddItemToObject(p, "contentChanges", arr);
+    step(&a, &b, &w, message("textDocument/didChange", 0, p), "didChange app");
+  }
+  {
+    cJSON *p = doc(APP);
+    cJSON_AddStringToObject(p, "previousResultId", "2");
+    step(&a, &b, &w, request("textDocument/semanticTokens/full/delta", p), "delta after edit");
+  }
+  {
+    cJSON *p = doc(LIB);
+    cJSON *r = cJSON_CreateObject();
+    cJSON *s = cJSON_CreateObject(), *e = cJSON_CreateObject();
+    cJSON_AddNumberToObject(s, "line", 1);
+    cJSON_AddNumberToObject(s, "character", 0);
+    cJSON_AddNumberToObject(e, "line", 4);
+    cJSON_AddNumberToObject(e, "character", 10);
+    cJSON_AddItemToObject(r, "start", s);
+    cJSON_AddItemToObject(r, "end", e);
+    cJSON_AddItemToObject(p, "range", r);
+    step(&a, &b, &w, request("textDocument/semanticTokens/range", p), "semanticTokens/range");
+  }
+  step(&a, &b, &w, request("textDocument/semanticTokens/full", doc("file:///none.spt")),
+       "semanticTokens on unknown document");
+
+  printf("Testing: references and workspace/symbol...\n");
+  step(&a, &b, &w, request("textDocument/references", at(LIB, 0, 12)), "references helper");
+  step(&a, &b, &w, request("textDocument/references", at(LIB, 4, 7)), "references member");
+  step(&a, &b, &w, request("textDocument/references", at("file:///none.spt", 0, 0)),
+       "references on unknown document");
+  {
+    cJSON *p = cJSON_CreateObject();
+    cJSON_AddStringToObject(p, "query", "");
+    step(&a, &b, &w, request("workspace/symbol", p), "workspace/symbol all");
+    p = cJSON_CreateObject();
+    cJSON_AddStringToObject(p, "query", "poi");
+    step(&a, &b, &w, request("workspace/symbol", p), "workspace/symbol query");
+  }
+
+  printf("Testing: non-streamed requests and cancellation...\n");
+  step(&a, &b, &w, request("textDocument/hover", at(APP, 3, 11)), "hover falls back to tree");
+  {
+    cJSON *p = cJSON_CreateObject();
+    cJSON_AddNumberToObject(p, "id", next_id);
+    step(&a, &b, &w, message("$/cancelRequest", 0, p), "cancel");
+    step(&a, &b, &w, request("textDocument/semanticTokens/full", doc(APP)),
+         "cancelled streamed request");
+  }
+  step(&a, &b, &w, request("shutdown", NULL), "shutdown");
+  step(&a, &b, &w, request("workspace/symbol", NULL), "after shutdown");
+
+  jw_free(&w);
+  lsp_server_free(&a);
+  lsp_server_free(&b);
+  remove_workspace(dir);
+  if (failed == 0) {
+    printf("=== TestDispatchWrite: ALL PASS ===\n");
+    return 0;
+  }
+  printf("=== TestDispatchWrite: %d CHECK(s) FAILED ===\n", failed);
+  return 1;
+}
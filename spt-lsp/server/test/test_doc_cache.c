@@ -0,0 +1,113 @@
+/*
+** test_doc_cache.c — 按文档版本缓存的解析单元/语义索引。
+**
+** 覆盖：
+**   - 同一版本上多个 provider（hover/semanticTokens/inlayHint/codeAction/...）只解析一次
+**   - 全量 didChange 与 didOpen 覆盖使缓存失效；增量 didChange 记下待重解析的编辑区间，
+**     下一次访问重新解析（增量重解析的正确性见 test_incremental）
+**   - 语义索引随 unit 缓存；semantic.c 经 unit 反查得到同一索引
+**   - 关闭文档释放缓存
+*/
+#include "diagnostics.h"
+#include "doc_cache.h"
+#include "documents.h"
+#include "lsp_features.h"
+#include "semantic.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int failed = 0;
+#define CHECK(cond, msg)                                                                           \
+  do {                                                                                             \
+    if (!(cond)) {                                                                                 \
+      printf("  FAIL: %s\n", msg);                                                                 \
+      failed++;                                                                                    \
+    }                                                                                              \
+  } while (0)
+
+static const char *src = "class Point {\n"
+                         "  int x;\n"
+                         "  int y;\n"
+                         "}\n"
+                         "int add(int a, int b) { return a + b; }\n"
+                         "int r = add(1, 2);\n";
+
+/* 模拟一次按键后编辑器发出的一串请求。 */
+static void run_providers(const Document *d) {
+  LspPos pos = {5, 9}; /* add(1, 2) 的 add */
+  LspRange all = {{0, 0}, {6, 0}};
+  cJSON_Delete(feature_hover(d, pos, NULL));
+  cJSON_Delete(feature_semantic_tokens_full(d, NULL));
+  cJSON_Delete(feature_semantic_tokens_range(d, all));
+  cJSON_Delete(feature_inlay_hints(d, all, NULL));
+  cJSON_Delete(feature_code_action(d, all));
+  cJSON_Delete(feature_document_symbols(d));
+  cJSON_Delete(feature_folding_range(d));
+  cJSON_Delete(feature_definition(d, pos, d->uri, NULL));
+  cJSON_Delete(diagnostics_compute(d));
+}
+
+static void test_shared_per_version(void) {
+  printf("Testing: providers share one parse per version...\n");
+  DocStore s;
+  doc_store_init(&s);
+  Document *d = doc_store_open(&s, "file:///c.spt", src, strlen(src), 1);
+  CHECK(d && d->cache, "open attaches a cache");
+  CHECK(d->cache->parses == 0, "parse is lazy");
+
+  run_providers(d);
+  CHECK(d->cache->parses == 1, "nine providers, one parse");
+  const SptLspUnit *u = doc_unit(d);
+  CHECK(u && u->token_count > 0, "cached unit holds the token array");
+  CHECK(doc_unit(d) == u && d->cache->parses == 1, "repeat access hits");
+
+  SemIndex *idx = doc_index(d);
+  CHECK(idx != NULL, "index built from cached unit");
+  CHECK(doc_cache_index_for(u) == idx, "reverse lookup by unit finds the same index");
+  CHECK(sem_find_function(u, "add") != NULL, "semantic lookups use the cached index");
+  CHECK(doc_index(d) == idx, "index reused");
+  doc_store_free(&s);
+}
+
+static void test_invalidation(void) {
+  printf("Testing: full/range change and reopen invalidate...\n");
+  DocStore s;
+  doc_store_init(&s);
+  Document *d = doc_store_open(&s, "file:///c.spt", src, strlen(src), 1);
+  const SptLspUnit *u1 = doc_unit(d);
+  CHECK(doc_cache_index_for(u1) != NULL, "live unit registered");
+
+  const char *t2 = "int only() { return 1; }\n";
+  doc_store_change(&s, "file:///c.spt", t2, strlen(t2), 2);
+  CHECK(d->cache->unit == NULL, "full change drops the unit");
+  const SptLspUnit *u2 = doc_unit(d);
+  CHECK(d->cache->parses == 2 && d->cache->version == 2, "reparsed for version 2");
+  CHECK(u2 && sem_find_function(u2, "only") != NULL, "new text visible");
+
+  /* 增量：only -> once */
+  doc_store_change_range(&s, "file:///c.spt", 4, 8, "once", 4, 3);
+  CHECK(d->cache->pending && d->cache->version == 2, "range change leaves a pending edit");
+  const SptLspUnit *u3 = doc_unit(d);
+  CHECK(d->cache->parses == 3 && sem_find_function(u3, "once") != NULL, "range edit reparsed");
+
+  doc_store_open(&s, "file:///c.spt", src, strlen(src), 3);
+  CHECK(d->cache->unit == NULL, "reopen with same version still drops the unit");
+  CHECK(sem_find_function(doc_unit(d), "add") != NULL, "reopened text visible");
+
+  doc_store_close(&s, "file:///c.spt");
+  CHECK(doc_store_get(&s, "file:///c.spt") == NULL, "closed");
+  doc_store_free(&s);
+}
+
+int main(void) {
+  printf("=== TestDocCache: versioned parse cache ===\n");
+  test_shared_per_version();
+  test_invalidation();
+  if (failed == 0) {
+    printf("=== TestDocCache: ALL PASS ===\n");
+    return 0;
+  }
+  printf("=== TestDocCache: %d CHECK(s) FAILED ===\n", failed);
+  return 1;
+}
@@ -4,6 +4,7 @@
 #include "documents.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 static int failed = 0;
@@ -36,6 +37,48 @@ static void test_open_change_close(void) {
   doc_store_free(&s);
 }
 
+/* 大量文档：按 URI 查找走驻留表；关闭时用末尾文档填洞后查找仍然正确，重开复用同一 id。 */
+static void test_many_docs(void) {
+  printf("Testing: many open docs, close in the middle, reopen...\n");
+  enum { N = 2000 };
+  DocStore s;
+  doc_store_init(&s);
+  char uri[64];
+  for (int i = 0; i < N; i++) {
+    snprintf(uri, sizeof uri, "file:///w/f%d.spt", i);
+    doc_store_open(&s, uri, "int a;\n", 7, i);
+  }
+  CHECK(s.count == N, "all docs open");
+  int ok = 1;
+  for (int i = 0; i < N; i += 7) {
+    snprintf(uri, sizeof uri, "file:///w/f%d.spt", i);
+    Document *d = doc_store_get(&s, uri);
+    ok &= d && d->version == i && strcmp(d->uri, uri) == 0;
+  }
+  CHECK(ok, "every doc found by uri");
+  CHECK(doc_store_get(&s, "file:///w/none.spt") == NULL, "unknown uri misses");
+
+  int id5 = doc_store_get(&s, "file:///w/f5.spt")->uri_id;
+  for (int i = 0; i < N; i += 2) {
+    snprintf(uri, sizeof uri, "file:///w/f%d.spt", i);
+    doc_store_close(&s, uri);
+  }
+  CHECK(s.count == N / 2, "half closed");
+  ok = 1;
+  for (int i = 0; i < N; i++) {
+    snprintf(uri, sizeof uri, "file:///w/f%d.spt", i);
+    Document *d = doc_store_get(&s, uri);
+    ok &= (i % 2 == 0) ? d == NULL : (d && d->version == i && s.docs[d->slot] == d);
+  }
+  CHECK(ok, "survivors still found, slots consistent");
+  CHECK(doc_store_get_id(&s, id5) == doc_store_get(&s, "file:///w/f5.spt"), "lookup by id");
+
+  Document *re = doc_store_open(&s, "file:///w/f0.spt", "x", 1, 99);
+  CHECK(re && re->uri_id == uri_table_find(s.uris, "file:///w/f0.spt"), "reopen reuses id");
+  CHECK(s.uris->count == N, "no duplicate interning");
+  doc_store_free(&s);
+}
+
 static void test_crlf_normalization(void) {
   printf("Testing: CRLF normalized, line semantics preserved...\n");
   DocStore s;
@@ -94,12 +137,122 @@ static void test_frontend_coords(void) {
   doc_store_free(&s);
 }
 
+/* ---- 对照实现：在扁平文本上逐字节计算 ---- */
+static unsigned g_seed = 12345u;
+static unsigned rnd(void) {
+  g_seed = g_seed * 1103515245u + 12345u;
+  return (g_seed >> 8) & 0xFFFFFF;
+}
+
+static LspPos ref_pos_at(const char *t, size_t off) {
+  LspPos p = {0, 0};
+  for (size_t i = 0; i < off;) {
+    unsigned char c = (unsigned char)t[i];
+    if (c == '\n') {
+      p.line++;
+      p.character = 0;
+      i++;
+      continue;
+    }
+    int adv = c < 0x80 ? 1 : (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : 4;
+    p.character += adv == 4 ? 2 : 1;
+    i += (size_t)adv;
+  }
+  return p;
+}
+
+/* 随机编辑（含跨块粘贴与大段删除）后，rope 的文本、行首、位置换算与扁平文本逐项一致。 */
+static void test_rope_edits(void) {
+  printf("Testing: rope-backed text vs flat reference under random edits...\n");
+  static const char *pieces[] = {"x", "\n", "ab\ncd", "\xC3\xA9", "\xF0\x9F\x98\x80",
+                                 "\r\n", "  ", ""};
+  size_t cap = 1 << 20, len = 0;
+  char *ref = (char *)malloc(cap);
+  for (int i = 0; i < 1500; i++)
+    len += (size_t)sprintf(ref + len, i % 7 ? "let v%d = %d;\n" : "// \xE6\xB3\xA8 %d\n", i, i);
+  DocStore s;
+  doc_store_init(&s);
+  Document *d = doc_store_open(&s, "file:///big.spt", ref, len, 1);
+  CHECK(d->rope.count > 1, "large document spans several chunks");
+  char big[12000];
+  for (size_t i = 0; i < sizeof big; i++)
+    big[i] = i % 61 == 60 ? '\n' : (char)('a' + i % 26);
+  int bad = 0;
+  for (int it = 0; it < 3000 && !bad; it++) {
+    size_t a = rnd() % (len + 1), b = a;
+    unsigned k = rnd() % 20;
+    if (k < 6)
+      b = a + rnd() % ((len - a) < 40 ? (len - a) + 1 : 40);
+    else if (k == 6)
+      b = a + rnd() % ((len - a) < 9000 ? (len - a) + 1 : 9000);
+    /* 编辑落在字符边界上（编辑器不会拆开多字节字符）。 */
+    while (a > 0 && (ref[a] & 0xC0) == 0x80)
+      a--;
+    while (b < len && (ref[b] & 0xC0) == 0x80)
+      b++;
+    const char *repl = pieces[rnd() % (sizeof pieces / sizeof *pieces)];
+    size_t rn = strlen(repl);
+    if (k == 7) {
+      repl = big;
+      rn = 1000 + rnd() % (sizeof big - 1000);
+    }
+    doc_store_change_range(&s, "file:///big.spt", a, b, repl, rn, it + 2);
+    /* 参照：同样先规范化替换文本的换行。 */
+    char norm[sizeof big];
+    size_t nn = 0;
+    for (size_t i = 0; i < rn; i++) {
+      if (repl[i] == '\r') {
+        norm[nn++] = '\n';
+        if (i + 1 < rn && repl[i + 1] == '\n')
+          i++;
+      } else {
+        norm[nn++] = repl[i];
+      }
+    }
+    if (len - (b - a) + nn + 1 > cap)
+      break;
+    memmove(ref + a + nn, ref + b, len - b);
+    memcpy(ref + a, norm, nn);
+    len = len - (b - a) + nn;
+    ref[len] = '\0';
+
+    int lines = 1;
+    for (size_t i = 0; i < len; i++)
+      lines += ref[i] == '\n';
+    bad |= d->text_len != len || d->line_count != lines;
+    /* 隔几次才取一次视图，覆盖多次编辑合并后的就地修补。 */
+    if (!bad && rnd() % 3 == 0)
+      bad |= memcmp(doc_text(d), ref, len + 1) != 0;
+    for (int q = 0; q < 8 && !bad; q++) {
+      size_t off = rnd() % (len + 1);
+      LspPos want = ref_pos_at(ref, off);
+      LspPos got = doc_pos_at(d, off);
+      bad |= got.line != want.line || got.character != want.character;
+      size_t ls = off;
+      while (ls > 0 && ref[ls - 1] != '\n')
+        ls--;
+      bad |= doc_line_start(d, want.line) != ls;
+      /* 落在字符边界上的偏移可以往返。 */
+      if ((ref[off] & 0xC0) != 0x80)
+        bad |= doc_offset_at(d, want) != off;
+    }
+    if (bad)
+      printf("  mismatch after edit #%d\n", it);
+  }
+  CHECK(!bad, "rope text, line starts and positions match the flat reference");
+  CHECK(memcmp(doc_text(d), ref, len + 1) == 0, "final contiguous view matches");
+  doc_store_free(&s);
+  free(ref);
+}
+
 int main(void) {
   printf("=== TestDocuments: store + UTF-16 positions ===\n");
   test_open_change_close();
+  test_many_docs();
   test_crlf_normalization();
   test_utf16_positions();
   test_frontend_coords();
+  test_rope_edits();
   if (failed == 0) {
     printf("=== TestDocuments: ALL PASS ===\n");
     return 0;
@@ -0,0 +1,452 @@
+/*
+** test_incremental.c — 增量重解析（spt_lsp_reparse + DocCache + SemIndex/RefIndex 修补）。
+**
+** 覆盖：
+**   - 函数体内编辑、换行增删、改名、引入/修复语法错误、删除整条语句、文末追加、
+**     文档注释编辑、同一行多条语句、未闭合括号（回退全量）、多次编辑合并
+**   - 每一步都与对同一文本的全量解析逐项比对：token（种类/行列/偏移/文档）、
+**     AST（节点种类/位置/名字）、诊断、语义索引查找结果、工作区引用倒排
+**   - 确定性随机编辑序列（含大量无效中间态）同样逐步比对
+*/
+#include "doc_cache.h"
+#include "documents.h"
+#include "sem_index.h"
+#include "workspace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failed = 0;
+#define CHECK(cond, msg)                                                                           \
+  do {                                                                                             \
+    if (!(cond)) {                                                                                 \
+      printf("  FAIL: %s\n", msg);                                                                 \
+      failed++;                                                                                    \
+    }                                                                                              \
+  } while (0)
+
+static const char *URI = "file:///inc.spt";
+
+/* ---- AST 文本化：种类 + 位置 + 名字，整树比较 ---- */
+typedef struct {
+  char *buf;
+  size_t len, cap;
+} Out;
+
+static void out_put(Out *o, const char *s) {
+  size_t n = strlen(s);
+  if (o->len + n + 1 > o->cap) {
+    o->cap = (o->len + n + 1) * 2;
+    o->buf = (char *)realloc(o->buf, o->cap);
+  }
+  memcpy(o->buf + o->len, s, n + 1);
+  o->len += n;
+}
+
+static void dump_node(AstNode *n, void *ctx) {
+  Out *o = (Out *)ctx;
+  char line[320];
+  const char *name = NULL;
+  switch (n->type) {
+  case NODE_IDENTIFIER:
+    name = n->u.ident.name;
+    break;
+  case NODE_FUNCTION_DECL:
+    name = n->u.func_decl.name;
+    break;
+  case NODE_CLASS_DECL:
+    name = n->u.class_decl.name;
+    break;
+  case NODE_VARIABLE_DECL:
+    name = n->u.var_decl.name;
+    break;
+  case NODE_MEMBER_ACCESS:
+    name = n->u.member.member;
+    break;
+  default:
+    break;
+  }
+  const char *doc = NULL;
+  if (n->type == NODE_FUNCTION_DECL)
+    doc = n->u.func_decl.doc;
+  else if (n->type == NODE_CLASS_DECL)
+    doc = n->u.class_decl.doc;
+  snprintf(line, sizeof line, "(%d %d:%d %s %s", (int)n->type, n->loc.line, n->loc.column,
+           name ? name : "-", doc ? doc : "-");
+  out_put(o, line);
+  if (n->type == NODE_BLOCK) {
+    snprintf(line, sizeof line, " end=%d:%d", n->u.block.end_loc.line, n->u.block.end_loc.column);
+    out_put(o, line);
+  }
+  spt_ast_for_each_child(n, dump_node, o);
+  out_put(o, ")");
+}
+
+static char *dump_tree(AstNode *root) {
+  Out o = {NULL, 0, 0};
+  out_put(&o, "");
+  if (root)
+    dump_node(root, &o);
+  return o.buf;
+}
+
+/* ---- 单元比对 ---- */
+static int same_unit(const SptLspUnit *a, const SptLspUnit *b, const char *what) {
+  int ok = 1;
+  char msg[256];
+#define DIFF(cond, ...)                                                                            \
+  do {                                                                                             \
+    if (ok && (cond)) {                                                                            \
+      snprintf(msg, sizeof msg, __VA_ARGS__);                                                      \
+      printf("  [%s] %s\n", what, msg);                                                            \
+      ok = 0;                                                                                      \
+    }                                                                                              \
+  } while (0)
+  DIFF(a->source_len != b->source_len || memcmp(a->source, b->source, a->source_len) != 0,
+       "source differs");
+  DIFF(a->token_count != b->token_count, "token count %d vs %d", a->token_count, b->token_count);
+  for (int i = 0; ok && i < a->token_count; i++) {
+    const SptToken *x = &a->tokens[i], *y = &b->tokens[i];
+    DIFF(x->kind != y->kind || x->line != y->line || x->column != y->column ||
+             x->length != y->length || (x->lexeme - a->source) != (y->lexeme - b->source),
+         "token %d: kind %d/%d at %d:%d vs %d:%d", i, (int)x->kind, (int)y->kind, x->line,
+         x->column, y->line, y->column);
+    DIFF((x->doc == NULL) != (y->doc == NULL) || (x->doc && strcmp(x->doc, y->doc) != 0),
+         "token %d doc differs", i);
+  }
+  DIFF(a->diag_count != b->diag_count, "diag count %d vs %d", a->diag_count, b->diag_count);
+  for (int i = 0; ok && i < a->diag_count; i++)
+    DIFF(a->diags[i].line != b->diags[i].line || a->diags[i].column != b->diags[i].column ||
+             strcmp(a->diags[i].message, b->diags[i].message) != 0,
+         "diag %d: %d:%d vs %d:%d", i, a->diags[i].line, a->diags[i].column, b->diags[i].line,
+         b->diags[i].column);
+  if (ok) {
+    char *ta = dump_tree(a->root), *tb = dump_tree(b->root);
+    DIFF(strcmp(ta, tb) != 0, "AST differs");
+    free(ta);
+    free(tb);
+  }
+#undef DIFF
+  return ok;
+}
+
+/* 语义索引：每个表里的每个名字在两边指向位置相同的节点。 */
+static int same_hash(const SemHash *h, const SemIndex *other, int which) {
+  for (int i = 0; i < h->capacity; i++) {
+    const SemSlot *s = &h->slots[i];
+    if (!s->name)
+      continue;
+    const AstNode *o = which == 0   ? (sem_index_lookup_def(other, s->name)
+                                           ? sem_index_lookup_def(other, s->name)->node
+                                           : NULL)
+                       : which == 1 ? sem_index_lookup_class(other, s->name)
+                                    : sem_index_lookup_func(other, s->name);
+    if (!o || o->loc.line != s->node->loc.line || o->loc.column != s->node->loc.column ||
+        o->type != s->node->type)
+      return 0;
+  }
+  return 1;
+}
+
+static int same_index(const SemIndex *a, const SemIndex *b) {
+  if (!a || !b)
+    return a == b;
+  return a->defs.count == b->defs.count && a->classes.count == b->classes.count &&
+         a->funcs.count == b->funcs.count && same_hash(&a->defs, b, 0) &&
+         same_hash(&a->classes, b, 1) && same_hash(&a->funcs, b, 2);
+}
+
+/* 引用倒排：对 unit 中每个标识符名，两个工作区报告的出现集合（偏移之和/个数）一致。 */
+typedef struct {
+  int count;
+  size_t sum;
+} OccAcc;
+
+static void occ_cb(void *ctx, const char *uri, size_t offset, int length) {
+  OccAcc *a = (OccAcc *)ctx;
+  (void)uri;
+  a->count++;
+  a->sum += offset * 31 + (size_t)length;
+}
+
+static int same_refs(Workspace *wa, Workspace *wb, const SptLspUnit *u) {
+  for (int i = 0; i < u->token_count; i++) {
+    const SptToken *t = &u->tokens[i];
+    if (t->kind != TOK_IDENTIFIER)
+      continue;
+    char nm[256];
+    int n = t->length < 255 ? t->length : 255;
+    memcpy(nm, t->lexeme, (size_t)n);
+    nm[n] = '\0';
+    OccAcc x = {0, 0}, y = {0, 0};
+    workspace_find_occurrences(wa, nm, occ_cb, &x);
+    workspace_find_occurrences(wb, nm, occ_cb, &y);
+    if (x.count != y.count || x.sum != y.sum) {
+      printf("  refs for '%s': %d vs %d\n", nm, x.count, y.count);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* ---- 驱动：store 走增量路径，每步与全量解析比对 ---- */
+typedef struct {
+  DocStore store;
+  Workspace ws;
+  Document *d;
+} Session;
+
+static void session_open(Session *s, const char *text) {
+  doc_store_init(&s->store);
+  workspace_init(&s->ws);
+  workspace_set_overlay(&s->ws, &s->store);
+  workspace_index(&s->ws);
+  s->d = doc_store_open(&s->store, URI, text, strlen(text), 1);
+  workspace_mark_doc_dirty(&s->ws, URI);
+}
+
+static void session_close(Session *s) {
+  workspace_free(&s->ws);
+  doc_store_free(&s->store);
+}
+
+/* 用全量解析对照当前文档：返回 1 表示一致。 */
+static int verify(Session *s, const char *what) {
+  const SptLspUnit *u = doc_unit(s->d);
+  SemIndex *idx = doc_index(s->d);
+  Session ref;
+  session_open(&ref, doc_text(s->d));
+  const SptLspUnit *full = doc_unit(ref.d);
+  int ok = u && full && same_unit(u, full, what);
+  if (ok && !same_index(idx, doc_index(ref.d))) {
+    printf("  [%s] semantic index differs\n", what);
+    ok = 0;
+  }
+  if (ok && !same_refs(&s->ws, &ref.ws, full)) {
+    printf("  [%s] reference index differs\n", what);
+    ok = 0;
+  }
+  session_close(&ref);
+  return ok;
+}
+
+static int g_version = 1;
+
+/* 在 store 中把第一次出现的 needle 替换为 repl（模拟编辑器的 range didChange）。 */
+static void edit(Session *s, const char *needle, const char *repl) {
+  const char *text = doc_text(s->d);
+  const char *p = strstr(text, needle);
+  if (!p) {
+    printf("  (needle not found: %s)\n", needle);
+    failed++;
+    return;
+  }
+  size_t a = (size_t)(p - text);
+  doc_store_change_range(&s->store, URI, a, a + strlen(needle), repl, strlen(repl), ++g_version);
+}
+
+static void edit_at(Session *s, size_t a, size_t b, const char *repl) {
+  doc_store_change_range(&s->store, URI, a, b, repl, strlen(repl), ++g_version);
+}
+
+/* 一次按键：编辑 + 工作区按文档失效（与 server.c 的 didChange 处理一致）+ 比对。 */
+static void step(Session *s, const char *what) {
+  workspace_mark_doc_dirty(&s->ws, URI);
+  CHECK(verify(s, what), what);
+}
+
+static const char *src = "/// 模块头\n"
+                         "import { helper } from \"util\";\n"
+                         "int W = 200;\n"
+                         "int H = 200;\n"
+                         "\n"
+                         "/// 二维点\n"
+                         "class Point {\n"
+                         "  int x;\n"
+                         "  int y;\n"
+                         "  int len() { return this.x + this.y; }\n"
+                         "}\n"
+                         "\n"
+                         "export class Grid {\n"
+                         "  list<int> cells;\n"
+                         "}\n"
+                         "\n"
+                         "// 普通注释\n"
+                         "int add(int a, int b) {\n"
+                         "  int s = a + b;\n"
+                         "  return s;\n"
+                         "}\n"
+                         "\n"
+                         "/// 乘法\n"
+                         "int mul(int a, int b) { return a * b; }\n"
+                         "int a1 = 1; int a2 = add(a1, 2);\n"
+                         "auto f = function(int v) -> int { return v + W; };\n"
+                         "if (W > H) {\n"
+                         "  print(\"wide\");\n"
+                         "} else {\n"
+                         "  print(\"tall\");\n"
+                         "}\n"
+                         "int tail = mul(W, H);\n";
+
+static void test_scripted(void) {
+  printf("Testing: scripted edits match a full reparse...\n");
+  Session s;
+  session_open(&s, src);
+  CHECK(verify(&s, "initial"), "initial parse");
+  unsigned parses0 = s.d->cache->parses;
+
+  edit(&s, "int s = a + b;", "int s = a + b + 1;");
+  step(&s, "edit inside a function body");
+  edit(&s, "  return s;\n", "\n\n  return s;\n");
+  step(&s, "insert lines inside a body (shifts following decls)");
+  edit(&s, "int mul(", "int times(");
+  step(&s, "rename a function");
+  CHECK(sem_index_lookup_func(doc_index(s.d), "times") != NULL, "renamed function indexed");
+  CHECK(sem_index_lookup_func(doc_index(s.d), "mul") == NULL, "old name dropped from index");
+  edit(&s, "return a * b;", "return a * ;");
+  step(&s, "introduce a syntax error");
+  CHECK(doc_unit(s.d)->diag_count > 0, "error reported");
+  edit(&s, "return a * ;", "return a * b;");
+  step(&s, "fix the syntax error");
+  edit(&s, "int a1 = 1;", "int a1 = 10;");
+  step(&s, "edit the first of two statements on one line");
+  edit(&s, "int H = 200;\n", "");
+  step(&s, "delete a whole statement");
+  edit(&s, "/// 二维点", "/// 二维点（整数）");
+  step(&s, "edit a doc comment");
+  edit(&s, "int tail = mul(W, H);\n", "int tail = times(W, H);\nint more = 3;\n");
+  step(&s, "append at end of file");
+  edit(&s, "int W = 200;", "int W = 300;");
+  step(&s, "edit near the start of file");
+  edit(&s, "  int y;\n", "  int y;\n  int z;\n");
+  step(&s, "add a class field");
+  edit(&s, "print(\"wide\");", "print(\"wider\");");
+  step(&s, "edit inside an if/else");
+
+  /* 多次编辑在一次 doc_unit 之前合并。 */
+  edit(&s, "int s = a + b + 1;", "int s = a - b;");
+  edit(&s, "return v + W;", "return v + H2;");
+  edit(&s, "int more = 3;", "int more = 4;");
+  step(&s, "several edits merged before one reparse");
+
+  unsigned reparses = s.d->cache->reparses;
+  CHECK(reparses >= 10, "most scripted edits took the incremental path");
+
+  /* 未闭合的括号可能吞掉后续语句：必须回退全量。 */
+  unsigned before = s.d->cache->reparses;
+  edit(&s, "int s = a - b;", "int s = a - b; if (s) {");
+  step(&s, "unbalanced brace");
+  CHECK(s.d->cache->reparses == before, "unbalanced edit falls back to a full parse");
+  edit(&s, "if (s) {", "");
+  step(&s, "rebalance");
+  CHECK(s.d->cache->parses > parses0, "parses counted");
+  session_close(&s);
+}
+
+static void test_append_and_prepend(void) {
+  printf("Testing: edits at file boundaries...\n");
+  Session s;
+  session_open(&s, "int a = 1;\nint b = 2;\n");
+  CHECK(verify(&s, "initial"), "initial");
+  edit_at(&s, 0, 0, "int z = 0;\n");
+  step(&s, "insert before the first statement");
+  edit_at(&s, s.d->text_len, s.d->text_len, "int c = 3;\n");
+  step(&s, "append after the last statement");
+  edit_at(&s, 0, s.d->text_len, "");
+  step(&s, "delete everything");
+  edit_at(&s, 0, 0, "int q = 1;\n");
+  step(&s, "type into an empty file");
+  session_close(&s);
+}
+
+/* 确定性伪随机编辑：大量中间态无效，但每一步都必须与全量解析完全一致。 */
+static unsigned g_seed = 12345;
+static unsigned rnd(void) {
+  g_seed = g_seed * 1103515245u + 12345u;
+  return (g_seed >> 16) & 0x7fff;
+}
+
+static void test_random(void) {
+  printf("Testing: random edits match a full reparse...\n");
+  static const char *pieces[] = {"x",    "1",     ";",      " ",    "\n",         "}",
+                                 "{",    "(",     ")",      "a.b",  "int v = 2;", "return;",
+                                 "+",    "else",  "fn()",   "{}",   "/// d\n",    "// c\n",
+                                 "q();", "int k;", "if (x) {}", "class K {}"};
+  Session s;
+  session_open(&s, src);
+  int bad = 0;
+  for (int it = 0; it < 200 && !bad; it++) {
+    size_t len = s.d->text_len;
+    size_t a = len ? rnd() % (len + 1) : 0;
+    size_t b = a;
+    if (rnd() % 3 == 0 && len > a)
+      b = a + rnd() % ((len - a) < 8 ? (len - a) + 1 : 8);
+    const char *repl = rnd() % 4 == 0 ? "" : pieces[rnd() % (sizeof pieces / sizeof *pieces)];
+    edit_at(&s, a, b, repl);
+    workspace_mark_doc_dirty(&s.ws, URI);
+    char what[64];
+    snprintf(what, sizeof what, "random edit #%d", it);
+    if (!verify(&s, what)) {
+      printf("  text:\n%s\n", doc_text(s.d));
+      bad = 1;
+    }
+  }
+  CHECK(!bad, "random edit sequence matches full reparse");
+  printf("  (%u of %u parses were incremental)\n", s.d->cache->reparses, s.d->cache->parses);
+  CHECK(s.d->cache->reparses > 0, "random sequence exercised the incremental path");
+  session_close(&s);
+}
+
+/* 逐键输入：在随机行首逐字符敲入一条语句、偶尔删除整行。中间态的错误局限在被编辑的声明内，
+   绝大多数按键应走增量路径。 */
+static void test_typing(void) {
+  printf("Testing: keystroke-by-keystroke typing...\n");
+  static const char *lines[] = {"  int t = a * 2;\n", "  print(a.b);\n",
+                                "  if (a > 1) { a = 0; }\n", "int g = 7;\n", "/// 说明\n"};
+  Session s;
+  session_open(&s, src);
+  int bad = 0;
+  unsigned p0 = s.d->cache->parses, r0 = s.d->cache->reparses;
+  for (int it = 0; it < 40 && !bad; it++) {
+    /* 随机挑一个行首。 */
+    int nl = s.d->line_count - 1;
+    int target = (int)(rnd() % (unsigned)(nl ? nl : 1));
+    size_t at = doc_line_start(s.d, target);
+    if (rnd() % 5 == 0) {
+      size_t end = doc_line_start(s.d, target + 1);
+      edit_at(&s, at, end, "");
+      workspace_mark_doc_dirty(&s.ws, URI);
+      bad = !verify(&s, "delete a line");
+      continue;
+    }
+    const char *ln = lines[rnd() % (sizeof lines / sizeof *lines)];
+    for (size_t k = 0; ln[k] && !bad; k++) {
+      char ch[2] = {ln[k], 0};
+      edit_at(&s, at + k, at + k, ch);
+      workspace_mark_doc_dirty(&s.ws, URI);
+      bad = !verify(&s, "typing");
+    }
+  }
+  if (bad)
+    printf("  text:\n%s\n", doc_text(s.d));
+  CHECK(!bad, "typing sequence matches full reparse");
+  unsigned parses = s.d->cache->parses - p0, reparses = s.d->cache->reparses - r0;
+  printf("  (%u of %u parses were incremental)\n", reparses, parses);
+  CHECK(reparses * 2 > parses, "most keystrokes reparse incrementally");
+  session_close(&s);
+}
+
+int main(void) {
+  printf("=== TestIncremental: incremental reparse ===\n");
+  test_scripted();
+  test_append_and_prepend();
+  test_random();
+  test_typing();
+  if (failed == 0) {
+    printf("=== TestIncremental: ALL PASS ===\n");
+    return 0;
+  }
+  printf("=== TestIncremental: %d CHECK(s) FAILED ===\n", failed);
+  return 1;
+}
@@ -0,0 +1,324 @@
+/*
+** test_index_cache.c — 并行工作区索引 + 持久化索引缓存。
+**
+** 并行索引的结果须与单线程逐文件索引逐项一致；缓存命中时不再解析，改动 / 删除 / touch /
+** 损坏的缓存各自按预期失效。
+*/
+#define _DEFAULT_SOURCE 1
+#define _XOPEN_SOURCE 700
+
+#include "workspace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <sys/utime.h>
+#include <windows.h>
+#define utime _utime
+#define utimbuf _utimbuf
+#else
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+static int failed = 0;
+#define CHECK(cond, msg)                                                                           \
+  do {                                                                                             \
+    if (!(cond)) {                                                                                 \
+      printf("  FAIL: %s\n", msg);                                                                 \
+      failed++;                                                                                    \
+    }                                                                                              \
+  } while (0)
+
+#define NFILES 40
+
+static void join(char *out, size_t cap, const char *dir, const char *name) {
+#ifdef _WIN32
+  snprintf(out, cap, "%s\\%s", dir, name);
+#else
+  snprintf(out, cap, "%s/%s", dir, name);
+#endif
+}
+
+static void write_file(const char *path, const char *content) {
+  FILE *f = fopen(path, "wb");
+  if (f) {
+    fputs(content, f);
+    fclose(f);
+  }
+}
+
+static char *make_temp_dir(char *out, size_t cap) {
+#ifdef _WIN32
+  char base[MAX_PATH];
+  if (!GetTempPathA(MAX_PATH, base))
+    return NULL;
+  snprintf(out, cap, "%ssptidx_%lu", base, (unsigned long)GetCurrentProcessId());
+  if (!CreateDirectoryA(out, NULL))
+    return NULL;
+  return out;
+#else
+  snprintf(out, cap, "/tmp/sptidx_%d", (int)getpid());
+  if (mkdir(out, 0777) != 0)
+    return NULL;
+  return out;
+#endif
+}
+
+static void remove_dir_recursive(const char *path) {
+  char cmd[4200];
+#ifdef _WIN32
+  snprintf(cmd, sizeof cmd, "rmdir /s /q \"%s\" 2>nul", path);
+#else
+  snprintf(cmd, sizeof cmd, "rm -rf %s", path);
+#endif
+  if (system(cmd) != 0) { /* best-effort */
+  }
+}
+
+/* 生成 NFILES 个互相 import 的模块，外加一个子目录里的文件。 */
+static void make_project(const char *dir) {
+  char path[4096], src[1024], sub[4096];
+  for (int i = 0; i < NFILES; i++) {
+    snprintf(src, sizeof src,
+             "import { helper%d } from \"./mod%d\";\n"
+             "class Shape%d {\n  int w;\n  int area() { return w * %d; }\n}\n"
+             "int helper%d(int x) { return x + %d; }\n"
+             "int use%d() { Shape%d s = new Shape%d(); return helper%d(s.area()); }\n",
+             (i + 1) % NFILES, (i + 1) % NFILES, i, i, i, i, i, i, i, (i + 1) % NFILES);
+    char name[64];
+    snprintf(name, sizeof name, "mod%d.spt", i);
+    join(path, sizeof path, dir, name);
+    write_file(path, src);
+  }
+  join(sub, sizeof sub, dir, "sub");
+#ifdef _WIN32
+  _mkdir(sub);
+#else
+  mkdir(sub, 0777);
+#endif
+  join(path, sizeof path, sub, "deep.spt");
+  write_file(path, "int deepValue = 1;\nint helper0(int y) { return y; }\n");
+}
+
+/* 索引快照：全部符号 + 若干名字的引用出现 + 导入者，拼成一个字符串便于整体比较。 */
+typedef struct {
+  char *buf;
+  size_t len, cap;
+} Str;
+
+static void str_add(Str *s, const char *t) {
+  size_t n = strlen(t);
+  if (s->len + n + 1 > s->cap) {
+    s->cap = (s->len + n + 1) * 2;
+    s->buf = (char *)realloc(s->buf, s->cap);
+  }
+  memcpy(s->buf + s->len, t, n + 1);
+  s->len += n;
+}
+
+static void occ_cb(void *ctx, const char *uri, size_t offset, int length) {
+  char line[4300];
+  snprintf(line, sizeof line, "%s@%zu+%d;", uri, offset, length);
+  str_add((Str *)ctx, line);
+}
+
+static void imp_cb(void *ctx, const char *uri) {
+  str_add((Str *)ctx, uri);
+  str_add((Str *)ctx, ";");
+}
+
+static char *snapshot(Workspace *ws) {
+  Str s = {0};
+  cJSON *syms = workspace_symbols(ws, "");
+  char *j = cJSON_PrintUnformatted(syms);
+  str_add(&s, j);
+  free(j);
+  cJSON_Delete(syms);
+  const char *names[] = {"helper0", "helper7", "Shape3", "w", "area", "deepValue", "x"};
+  for (size_t i = 0; i < sizeof names / sizeof names[0]; i++) {
+    str_add(&s, "\n");
+    str_add(&s, names[i]);
+    str_add(&s, ":");
+    workspace_find_occurrences(ws, names[i], occ_cb, &s);
+  }
+  str_add(&s, "\nimporters:");
+  workspace_find_importers(ws, "./mod5", imp_cb, &s);
+  return s.buf;
+}
+
+/* workspace_symbols 是模糊匹配：只数名字完全相同的结果。 */
+static int count_named(Workspace *ws, const char *name) {
+  cJSON *r = workspace_symbols(ws, name);
+  int n = 0;
+  cJSON *it;
+  cJSON_ArrayForEach(it, r) {
+    cJSON *nm = cJSON_GetObjectItemCaseSensitive(it, "name");
+    if (cJSON_IsString(nm) && strcmp(nm->valuestring, name) == 0)
+      n++;
+  }
+  cJSON_Delete(r);
+  return n;
+}
+
+static char *index_snapshot(const char *dir, int threads, const char *cache,
+                            unsigned *parsed, unsigned *reused) {
+  Workspace ws;
+  workspace_init(&ws);
+  workspace_add_root_path(&ws, dir);
+  ws.index_threads = threads;
+  workspace_set_index_cache(&ws, cache);
+  workspace_index(&ws);
+  if (parsed)
+    *parsed = ws.index_parsed;
+  if (reused)
+    *reused = ws.index_reused;
+  char *snap = snapshot(&ws);
+  workspace_free(&ws);
+  return snap;
+}
+
+int main(void) {
+  printf("=== TestIndexCache: parallel indexing + persistent index ===\n");
+  char tmpl[4096];
+  char *dir = make_temp_dir(tmpl, sizeof tmpl);
+  CHECK(dir != NULL, "temp dir");
+  if (!dir)
+    return 1;
+  make_project(dir);
+  char cache[4096], cache_dir[4096];
+  join(cache_dir, sizeof cache_dir, dir, ".spt-lsp");
+  join(cache, sizeof cache, cache_dir, "index.bin");
+
+  printf("Testing: parallel index matches sequential index...\n");
+  unsigned parsed = 0, reused = 0;
+  char *seq = index_snapshot(dir, 1, NULL, &parsed, &reused);
+  CHECK(parsed == NFILES + 1 && reused == 0, "sequential index parses every file");
+  char *par = index_snapshot(dir, 6, NULL, NULL, NULL);
+  CHECK(strcmp(seq, par) == 0, "parallel snapshot identical to sequential");
+  CHECK(strstr(seq, "deepValue") != NULL, "subdirectory file indexed");
+  free(par);
+
+  printf("Testing: cache round trip skips parsing...\n");
+  char *first = index_snapshot(dir, 4, cache, &parsed, &reused);
+  CHECK(parsed == NFILES + 1, "cold start parses everything");
+  FILE *cf = fopen(cache, "rb");
+  CHECK(cf != NULL, "cache file written");
+  if (cf)
+    fclose(cf);
+  char *warm = index_snapshot(dir, 4, cache, &parsed, &reused);
+  CHECK(parsed == 0 && reused == NFILES + 1, "warm start parses nothing");
+  CHECK(strcmp(warm, seq) == 0, "warm snapshot identical to a fresh index");
+  free(first);
+  free(warm);
+
+  /* 同一个工作区内：改一个文件后 mark_dirty + 重建只解析它。 */
+  printf("Testing: only changed files are re-parsed...\n");
+  {
+    Workspace ws;
+    workspace_init(&ws);
+    workspace_add_root_path(&ws, dir);
+    workspace_set_index_cache(&ws, cache);
+    workspace_index(&ws);
+    CHECK(ws.index_parsed == 0, "loaded from cache");
+    char path[4096];
+    join(path, sizeof path, dir, "mod3.spt");
+    write_file(path, "int brandNewName = 3;\nint helper3(int x) { return x; }\n");
+    workspace_mark_dirty(&ws);
+    workspace_index(&ws);
+    CHECK(ws.index_parsed == 1 && ws.index_reused == NFILES, "one file re-parsed");
+    CHECK(count_named(&ws, "brandNewName") == 1, "new symbol visible");
+    CHECK(count_named(&ws, "Shape3") == 0, "removed symbol gone");
+
+    join(path, sizeof path, dir, "mod4.spt");
+    remove(path);
+    workspace_mark_dirty(&ws);
+    workspace_index(&ws);
+    CHECK(ws.index_parsed == 0 && ws.index_reused == NFILES, "deleted file dropped");
+    CHECK(count_named(&ws, "Shape4") == 0, "deleted file's symbols gone");
+    workspace_free(&ws);
+  }
+  char *after = index_snapshot(dir, 4, cache, &parsed, &reused);
+  CHECK(parsed == 0 && reused == NFILES, "cache rewritten after change + delete");
+  char *fresh = index_snapshot(dir, 1, NULL, NULL, NULL);
+  CHECK(strcmp(after, fresh) == 0, "cached snapshot identical to a fresh index");
+  free(after);
+  free(fresh);
+
+  /* 只改 mtime（内容不变）：靠内容哈希识别，不解析。 */
+  printf("Testing: touched but unchanged files are not re-parsed...\n");
+  {
+    char path[4096];
+    join(path, sizeof path, dir, "mod7.spt");
+    struct utimbuf tb;
+    tb.actime = tb.modtime = (time_t)1000000000; /* 与写入时间必然不同 */
+    CHECK(utime(path, &tb) == 0, "utime");
+    free(index_snapshot(dir, 4, cache, &parsed, &reused));
+    CHECK(parsed == 0 && reused == NFILES, "hash match reuses facts");
+  }
+
+  /* 损坏的缓存：整体丢弃并全量重建，不崩溃。 */
+  printf("Testing: corrupt cache falls back to a full index...\n");
+  {
+    FILE *f = fopen(cache, "r+b");
+    CHECK(f != NULL, "open cache");
+    if (f) {
+      fseek(f, 64, SEEK_SET);
+      for (int i = 0; i < 64; i++)
+        fputc(0xFF, f);
+      fclose(f);
+    }
+    char *c = index_snapshot(dir, 4, cache, &parsed, &reused);
+    CHECK(parsed == NFILES && reused == 0, "corrupt cache ignored");
+    char *ref = index_snapshot(dir, 1, NULL, NULL, NULL);
+    CHECK(strcmp(c, ref) == 0, "rebuilt snapshot correct");
+    free(c);
+    free(ref);
+    f = fopen(cache, "wb");
+    if (f) {
+      fputs("garbage", f);
+      fclose(f);
+    }
+    free(index_snapshot(dir, 2, cache, &parsed, &reused));
+    CHECK(parsed == NFILES, "truncated cache ignored");
+  }
+
+  /* 同一秒内改写且大小不变（mtime 精度为秒，stat 看不出变化）：刚写入的文件不信 mtime，
+     比较内容哈希后重新解析。 */
+  printf("Testing: same-size edits within one mtime second are re-parsed...\n");
+  {
+    char path[4096];
+    join(path, sizeof path, dir, "mod8.spt");
+    write_file(path, "int racyOldName = 8;\n");
+    struct stat st;
+    CHECK(stat(path, &st) == 0, "stat");
+    Workspace ws;
+    workspace_init(&ws);
+    workspace_add_root_path(&ws, dir);
+    workspace_index(&ws);
+    CHECK(count_named(&ws, "racyOldName") == 1, "first version indexed");
+    write_file(path, "int racyNewName = 8;\n");
+    struct utimbuf tb;
+    tb.actime = tb.modtime = st.st_mtime; /* 与上次索引时 stat 到的完全一致 */
+    CHECK(utime(path, &tb) == 0, "utime");
+    workspace_mark_dirty(&ws);
+    workspace_index(&ws);
+    CHECK(ws.index_parsed == 1, "racy file re-parsed");
+    CHECK(count_named(&ws, "racyNewName") == 1 && count_named(&ws, "racyOldName") == 0,
+          "second version indexed");
+    workspace_free(&ws);
+  }
+
+  free(seq);
+  remove_dir_recursive(dir);
+  if (failed == 0) {
+    printf("=== TestIndexCache: ALL PASS ===\n");
+    return 0;
+  }
+  printf("=== TestIndexCache: %d CHECK(s) FAILED ===\n", failed);
+  return 1;
+}
@@ -527,7 +527,7 @@ int main(void) {
     {
       Document *d = doc_store_get(&srv.docs, svc_uri);
       if (d) {
-        SptLspUnit *u = spt_lsp_parse(d->text, d->text_len);
+        SptLspUnit *u = spt_lsp_parse(doc_text(d), d->text_len);
         if (u) {
           SemRef r = sem_resolve(u, d, off);
           printf("  sem_resolve: found=%d, has_def=%d, name=\"%s\", is_member=%d, is_ambient=%d\n",
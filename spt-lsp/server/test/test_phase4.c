@@ -324,7 +324,7 @@ int main(void) {
     if (d) {
       /* 应为 "int f() {\n  return 42;\n}\n" */
       const char *expected = "int f() {\n  return 42;\n}\n";
-      if (d->text_len == strlen(expected) && memcmp(d->text, expected, d->text_len) == 0)
+      if (d->text_len == strlen(expected) && memcmp(doc_text(d), expected, d->text_len) == 0)
         inc_ok = 1;
     }
     CHECK(inc_ok, "incremental didChange applied correctly (1->42)");
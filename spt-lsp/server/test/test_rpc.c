@@ -1,5 +1,5 @@
 /*
-** test_rpc.c — spt_rpc 单元测试：Content-Length 分帧 + JSON-RPC 构造/解析。
+** test_rpc.c — spt_rpc 单元测试：Content-Length 分帧 + JSON-RPC 构造/解析 + 流式写出器。
 */
 #include "spt_rpc.h"
 
@@ -198,6 +198,95 @@ static void test_message_construction(void) {
   cJSON_Delete(id);
 }
 
+/* ---- 7. 流式写出器：与 cJSON_PrintUnformatted 逐字节一致 ---- */
+static int same_as_cjson(const cJSON *v) {
+  char *want = cJSON_PrintUnformatted((cJSON *)v);
+  JsonWriter w;
+  jw_init(&w);
+  jw_cjson(&w, v);
+  size_t n;
+  const char *got = jw_body(&w, &n);
+  int ok = want && strlen(want) == n && memcmp(want, got, n) == 0;
+  if (!ok)
+    printf("    want %s\n    got  %.*s\n", want ? want : "(null)", (int)n, got);
+  free(want);
+  jw_free(&w);
+  return ok;
+}
+
+static void test_json_writer(void) {
+  printf("Testing: JsonWriter matches cJSON output...\n");
+  cJSON *o = cJSON_CreateObject();
+  cJSON_AddStringToObject(o, "plain", "hello");
+  cJSON_AddStringToObject(o, "esc", "q\" b\\ nl\n tab\t cr\r bs\b ff\f ctl\x01\x1f end");
+  cJSON_AddStringToObject(o, "utf8", "\xe4\xb8\xad\xe6\x96\x87 / ok");
+  cJSON_AddStringToObject(o, "", "empty key");
+  double nums[] = {0, -1, 42, 1.5, -0.25, 0.1, 1e300, -2147483648.0, 2147483647.0,
+                   2147483648.0, 123456789012.0, 3.141592653589793, 1e-7};
+  cJSON *arr = cJSON_AddArrayToObject(o, "nums");
+  for (size_t i = 0; i < sizeof nums / sizeof nums[0]; i++)
+    cJSON_AddItemToArray(arr, cJSON_CreateNumber(nums[i]));
+  cJSON_AddItemToObject(o, "empty_arr", cJSON_CreateArray());
+  cJSON_AddItemToObject(o, "empty_obj", cJSON_CreateObject());
+  cJSON *nest = cJSON_AddArrayToObject(o, "nest");
+  cJSON_AddItemToArray(nest, cJSON_CreateNull());
+  cJSON_AddItemToArray(nest, cJSON_CreateTrue());
+  cJSON_AddItemToArray(nest, cJSON_CreateFalse());
+  cJSON *inner = cJSON_CreateObject();
+  cJSON_AddItemToObject(inner, "a", cJSON_CreateArray());
+  cJSON_AddNumberToObject(inner, "b", 7);
+  cJSON_AddItemToArray(nest, inner);
+  CHECK(same_as_cjson(o), "tree serialization identical");
+  cJSON_Delete(o);
+
+  /* 手写 API：逗号 / 嵌套 / 整数数组。 */
+  JsonWriter w;
+  jw_init(&w);
+  int ints[] = {0, -7, 2147483647, -2147483647 - 1, 5};
+  jw_begin_object(&w);
+  jw_key(&w, "data");
+  jw_int_array(&w, ints, 5);
+  jw_key(&w, "none");
+  jw_int_array(&w, ints, 0);
+  jw_key(&w, "list");
+  jw_begin_array(&w);
+  jw_int(&w, 1);
+  jw_string(&w, "x");
+  jw_begin_object(&w);
+  jw_end_object(&w);
+  jw_null(&w);
+  jw_end_array(&w);
+  jw_end_object(&w);
+  size_t n;
+  const char *body = jw_body(&w, &n);
+  const char *want =
+      "{\"data\":[0,-7,2147483647,-2147483648,5],\"none\":[],\"list\":[1,\"x\",{},null]}";
+  CHECK(n == strlen(want) && memcmp(body, want, n) == 0, "hand-written output");
+
+  /* 帧头就地写入预留区；与 rpc_frame_to_string 相同。 */
+  cJSON *msg = mk_req(9, "frame");
+  jw_reset(&w);
+  jw_cjson(&w, msg);
+  size_t flen;
+  const char *frame = jw_frame(&w, &flen);
+  size_t slen;
+  char *framed = rpc_frame_to_string(msg, &slen);
+  CHECK(frame && framed && flen == slen && memcmp(frame, framed, flen) == 0,
+        "in-place frame equals rpc_frame_to_string");
+  free(framed);
+
+  /* 复用：reset 后不残留上一条内容。 */
+  jw_reset(&w);
+  jw_int(&w, 3);
+  body = jw_body(&w, &n);
+  CHECK(n == 1 && body[0] == '3', "reset writer starts empty");
+  cJSON *back = jw_parse(&w);
+  CHECK(back && cJSON_IsNumber(back) && back->valueint == 3, "jw_parse round-trips");
+  cJSON_Delete(back);
+  cJSON_Delete(msg);
+  jw_free(&w);
+}
+
 int main(void) {
   printf("=== TestRpc: framing + JSON-RPC ===\n");
   test_frame_roundtrip();
@@ -206,6 +295,7 @@ int main(void) {
   test_missing_content_length();
   test_extra_headers();
   test_message_construction();
+  test_json_writer();
   if (failed == 0) {
     printf("=== TestRpc: ALL PASS ===\n");
     return 0;
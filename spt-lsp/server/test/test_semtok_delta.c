@@ -0,0 +1,323 @@
+/*
+** test_semtok_delta.c — semanticTokens/full/delta 与 semanticTokens/range。
+**
+** delta 的编辑作用到上一版 data 上，须与同一版本的 full 结果逐项相同；
+** 基线未知时退化为完整结果；range 须等于 full 中落在范围内的那一段。
+*/
+#include "lsp_features.h"
+#include "server.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failed = 0;
+#define CHECK(cond, msg)                                                                           \
+  do {                                                                                             \
+    if (!(cond)) {                                                                                 \
+      printf("  FAIL: %s\n", msg);                                                                 \
+      failed++;                                                                                    \
+    }                                                                                              \
+  } while (0)
+
+static const char *URI = "file:///big.spt";
+
+static cJSON *message(const char *method, int id, cJSON *params) {
+  cJSON *o = cJSON_CreateObject();
+  cJSON_AddStringToObject(o, "jsonrpc", "2.0");
+  if (id > 0)
+    cJSON_AddNumberToObject(o, "id", id);
+  cJSON_AddStringToObject(o, "method", method);
+  cJSON_AddItemToObject(o, "params", params ? params : cJSON_CreateObject());
+  return o;
+}
+
+static cJSON *doc_params(void) {
+  cJSON *td = cJSON_CreateObject();
+  cJSON_AddStringToObject(td, "uri", URI);
+  cJSON *p = cJSON_CreateObject();
+  cJSON_AddItemToObject(p, "textDocument", td);
+  return p;
+}
+
+/* 分派并返回 result 的副本（调用方释放）。 */
+static cJSON *call(LspServer *s, const char *method, cJSON *params) {
+  static int next_id = 100;
+  cJSON *msg = message(method, next_id++, params);
+  cJSON *resp = lsp_dispatch(s, msg);
+  cJSON_Delete(msg);
+  cJSON *r = resp ? cJSON_GetObjectItemCaseSensitive(resp, "result") : NULL;
+  cJSON *out = r ? cJSON_Duplicate(r, 1) : NULL;
+  cJSON_Delete(resp);
+  return out;
+}
+
+static void notify(LspServer *s, const char *method, cJSON *params) {
+  cJSON *msg = message(method, 0, params);
+  cJSON_Delete(lsp_dispatch(s, msg));
+  cJSON_Delete(msg);
+}
+
+static void change(LspServer *s, const char *text, int version) {
+  cJSON *p = doc_params();
+  cJSON_AddNumberToObject(cJSON_GetObjectItemCaseSensitive(p, "textDocument"), "version",
+                          version);
+  cJSON *ch = cJSON_CreateObject();
+  cJSON_AddStringToObject(ch, "text", text);
+  cJSON *arr = cJSON_CreateArray();
+  cJSON_AddItemToArray(arr, ch);
+  cJSON_AddItemToObject(p, "contentChanges", arr);
+  notify(s, "textDocument/didChange", p);
+}
+
+typedef struct {
+  int *v;
+  int n;
+} Ints;
+
+static Ints ints_of(const cJSON *arr) {
+  Ints r = {NULL, cJSON_GetArraySize(arr)};
+  r.v = (int *)malloc(sizeof(int) * (size_t)(r.n + 1));
+  int i = 0;
+  const cJSON *it;
+  cJSON_ArrayForEach(it, arr) r.v[i++] = it->valueint;
+  return r;
+}
+
+static Ints data_of(const cJSON *res) {
+  return ints_of(cJSON_GetObjectItemCaseSensitive(res, "data"));
+}
+
+static const char *result_id(const cJSON *res) {
+  cJSON *id = cJSON_GetObjectItemCaseSensitive(res, "resultId");
+  return cJSON_IsString(id) ? id->valuestring : NULL;
+}
+
+static int ints_eq(Ints a, Ints b) {
+  return a.n == b.n && (a.n == 0 || memcmp(a.v, b.v, sizeof(int) * (size_t)a.n) == 0);
+}
+
+/* 把 delta 的 edits 依次作用到 base 上（start 相对于原数组，按 LSP 约定从后往前应用）。 */
+static Ints apply_edits(Ints base, const cJSON *edits) {
+  Ints cur = {(int *)malloc(sizeof(int) * (size_t)(base.n + 1)), base.n};
+  memcpy(cur.v, base.v, sizeof(int) * (size_t)base.n);
+  for (int k = cJSON_GetArraySize(edits) - 1; k >= 0; k--) {
+    cJSON *e = cJSON_GetArrayItem(edits, k);
+    int start = cJSON_GetObjectItemCaseSensitive(e, "start")->valueint;
+    int del = cJSON_GetObjectItemCaseSensitive(e, "deleteCount")->valueint;
+    Ints ins = ints_of(cJSON_GetObjectItemCaseSensitive(e, "data"));
+    int n = cur.n - del + ins.n;
+    int *v = (int *)malloc(sizeof(int) * (size_t)(n + 1));
+    memcpy(v, cur.v, sizeof(int) * (size_t)start);
+    memcpy(v + start, ins.v, sizeof(int) * (size_t)ins.n);
+    memcpy(v + start + ins.n, cur.v + start + del, sizeof(int) * (size_t)(cur.n - start - del));
+    free(cur.v);
+    free(ins.v);
+    cur.v = v;
+    cur.n = n;
+  }
+  return cur;
+}
+
+/* 200 个函数的大文件；mutate 时改第 k 个函数（名字与长度都变）。 */
+static char *make_source(int mutate) {
+  size_t cap = 64 * 1024, len = 0;
+  char *buf = (char *)malloc(cap);
+  for (int i = 0; i < 200; i++) {
+    if (i == mutate)
+      len += (size_t)snprintf(buf + len, cap - len,
+                              "int renamed%d(int alpha) { int beta = alpha; return beta; }\n", i);
+    else
+      len += (size_t)snprintf(buf + len, cap - len,
+                              "int f%d(int a) { int b = a + %d; return f%d(b); }\n", i, i,
+                              i > 0 ? i - 1 : 0);
+  }
+  return buf;
+}
+
+static void open_doc(LspServer *s, int version) {
+  char *src = make_source(-1);
+  cJSON *p = doc_params();
+  cJSON *td = cJSON_GetObjectItemCaseSensitive(p, "textDocument");
+  cJSON_AddStringToObject(td, "languageId", "sptscript");
+  cJSON_AddNumberToObject(td, "version", version);
+  cJSON_AddStringToObject(td, "text", src);
+  free(src);
+  notify(s, "textDocument/didOpen", p);
+}
+
+static cJSON *delta(LspServer *s, const char *prev) {
+  cJSON *p = doc_params();
+  if (prev)
+    cJSON_AddStringToObject(p, "previousResultId", prev);
+  return call(s, "textDocument/semanticTokens/full/delta", p);
+}
+
+static void test_delta(LspServer *s) {
+  printf("Testing: full/delta edits reproduce the full result...\n");
+  cJSON *full0 = call(s, "textDocument/semanticTokens/full", doc_params());
+  const char *id0 = result_id(full0);
+  CHECK(id0 != NULL, "full returns a resultId");
+  Ints base = data_of(full0);
+  CHECK(base.n > 1000, "big file has many tokens");
+
+  char *src = make_source(120);
+  change(s, src, 2);
+  free(src);
+  cJSON *d1 = delta(s, id0);
+  cJSON *edits = cJSON_GetObjectItemCaseSensitive(d1, "edits");
+  CHECK(edits && cJSON_GetArraySize(edits) == 1, "one edit for one changed line");
+  const char *id1 = result_id(d1);
+  CHECK(id1 && strcmp(id1, id0) != 0, "delta returns a new resultId");
+  Ints patched = edits ? apply_edits(base, edits) : (Ints){NULL, 0};
+  cJSON *full1 = call(s, "textDocument/semanticTokens/full", doc_params());
+  Ints want = data_of(full1);
+  CHECK(ints_eq(patched, want), "patched data equals a fresh full result");
+  cJSON *ed = edits ? cJSON_GetArrayItem(edits, 0) : NULL;
+  int sent = ed ? cJSON_GetArraySize(cJSON_GetObjectItemCaseSensitive(ed, "data")) : -1;
+  /* 改动的那一行 + 下一行对 f120 的调用（分类由函数变为变量），远小于整篇。 */
+  CHECK(sent >= 0 && sent <= 60 && base.n > 20 * sent, "delta ships only the changed tokens");
+
+  /* 未变化：空编辑列表。 */
+  cJSON *d2 = delta(s, result_id(full1));
+  edits = cJSON_GetObjectItemCaseSensitive(d2, "edits");
+  CHECK(edits && cJSON_GetArraySize(edits) == 0, "no edits when nothing changed");
+
+  /* 已被取代的 resultId：退化为完整结果。 */
+  cJSON *d3 = delta(s, id0);
+  CHECK(cJSON_GetObjectItemCaseSensitive(d3, "edits") == NULL, "stale id falls back to full");
+  Ints again = data_of(d3);
+  CHECK(ints_eq(again, want), "fallback carries the full data");
+
+  /* 关闭后基线丢弃：重开同一 uri，旧 resultId 不再被当作基线。 */
+  char keep[32];
+  snprintf(keep, sizeof keep, "%s", result_id(d3) ? result_id(d3) : "");
+  notify(s, "textDocument/didClose", doc_params());
+  open_doc(s, 3);
+  cJSON *d4 = delta(s, keep);
+  CHECK(cJSON_GetObjectItemCaseSensitive(d4, "data") != NULL, "closed document has no baseline");
+  cJSON_Delete(d4);
+
+  free(base.v);
+  free(patched.v);
+  free(want.v);
+  free(again.v);
+  cJSON_Delete(full0);
+  cJSON_Delete(full1);
+  cJSON_Delete(d1);
+  cJSON_Delete(d2);
+  cJSON_Delete(d3);
+}
+
+/* 解码相对坐标为绝对 (line, char, len, type)。 */
+static Ints absolute(Ints rel) {
+  Ints r = {(int *)malloc(sizeof(int) * (size_t)(rel.n + 1)), rel.n};
+  int line = 0, ch = 0;
+  for (int i = 0; i + 4 < rel.n; i += 5) {
+    line += rel.v[i];
+    ch = rel.v[i] ? rel.v[i + 1] : ch + rel.v[i + 1];
+    r.v[i] = line;
+    r.v[i + 1] = ch;
+    r.v[i + 2] = rel.v[i + 2];
+    r.v[i + 3] = rel.v[i + 3];
+    r.v[i + 4] = rel.v[i + 4];
+  }
+  return r;
+}
+
+static void test_range(LspServer *s) {
+  printf("Testing: range equals the matching slice of full...\n");
+  cJSON *full = call(s, "textDocument/semanticTokens/full", doc_params());
+  Ints fa = data_of(full), fabs_ = absolute(fa);
+  int sl = 50, sc = 4, el = 80, ec = 10;
+  cJSON *p = doc_params();
+  cJSON *rng = cJSON_CreateObject();
+  cJSON *st = cJSON_CreateObject(), *en = cJSON_CreateObject();
+  cJSON_AddNumberToObject(st, "line", sl);
+  cJSON_AddNumberToObject(st, "character", sc);
+  cJSON_AddNumberToObject(en, "line", el);
+  cJSON_AddNumberToObject(en, "character", ec);
+  cJSON_AddItemToObject(rng, "start", st);
+  cJSON_AddItemToObject(rng, "end", en);
+  cJSON_AddItemToObject(p, "range", rng);
+  cJSON *ranged = call(s, "textDocument/semanticTokens/range", p);
+  Ints ra = data_of(ranged), rabs = absolute(ra);
+
+  Ints want = {(int *)malloc(sizeof(int) * (size_t)(fabs_.n + 1)), 0};
+  for (int i = 0; i < fabs_.n; i += 5) {
+    int l = fabs_.v[i], c = fabs_.v[i + 1];
+    if (l < sl || l > el || (l == sl && c < sc) || (l == el && c >= ec))
+      continue;
+    memcpy(want.v + want.n, fabs_.v + i, sizeof(int) * 5);
+    want.n += 5;
+  }
+  CHECK(want.n > 0, "range is not empty");
+  CHECK(ints_eq(rabs, want), "range tokens equal the full slice");
+
+  free(fa.v);
+  free(fabs_.v);
+  free(ra.v);
+  free(rabs.v);
+  free(want.v);
+  cJSON_Delete(full);
+  cJSON_Delete(ranged);
+}
+
+/* 基线表缺失（semtok_store_new 内存不足时为 NULL）：delta 退化为不带 resultId 的完整结果。 */
+static void test_no_store(LspServer *s) {
+  printf("Testing: full/delta without a baseline store answers in full...\n");
+  cJSON *full = call(s, "textDocument/semanticTokens/full", doc_params());
+  Ints want = data_of(full);
+  struct SemTokStore *saved = s->semtok;
+  s->semtok = NULL;
+  cJSON *res = delta(s, result_id(full));
+  Ints got = data_of(res);
+  CHECK(res && cJSON_GetObjectItemCaseSensitive(res, "edits") == NULL, "no edits without a store");
+  CHECK(ints_eq(got, want), "full data returned");
+  CHECK(result_id(res) == NULL, "no resultId without a store");
+  s->semtok = saved;
+  free(want.v);
+  free(got.v);
+  cJSON_Delete(res);
+  cJSON_Delete(full);
+}
+
+/* 基线按 DocStore 驻留的 uri id 存放：独立文档（uri_id 为 -1）只拿完整结果，不记基线。 */
+static void test_standalone(LspServer *s) {
+  printf("Testing: standalone documents get no baseline...\n");
+  const char *src = "int f(int a) { return a; }\n";
+  Document *d = doc_new("file:///standalone.spt", src, strlen(src), 1);
+  cJSON *full = feature_semantic_tokens_full(d, s->semtok);
+  Ints got = data_of(full);
+  CHECK(got.n > 0 && result_id(full) == NULL, "full data without a resultId");
+  free(got.v);
+  cJSON_Delete(full);
+  doc_free(d);
+}
+
+int main(void) {
+  printf("=== TestSemtokDelta: semanticTokens full/delta + range ===\n");
+  LspServer s;
+  lsp_server_init(&s);
+  cJSON *init = call(&s, "initialize", NULL);
+  cJSON *caps = cJSON_GetObjectItemCaseSensitive(init, "capabilities");
+  cJSON *sem = caps ? cJSON_GetObjectItemCaseSensitive(caps, "semanticTokensProvider") : NULL;
+  cJSON *full = sem ? cJSON_GetObjectItemCaseSensitive(sem, "full") : NULL;
+  CHECK(full && cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(full, "delta")),
+        "advertises full.delta");
+  cJSON_Delete(init);
+  open_doc(&s, 1);
+
+  test_range(&s);
+  test_delta(&s);
+  test_no_store(&s);
+  test_standalone(&s);
+
+  lsp_server_free(&s);
+  if (failed == 0) {
+    printf("=== TestSemtokDelta: ALL PASS ===\n");
+    return 0;
+  }
+  printf("=== TestSemtokDelta: %d CHECK(s) FAILED ===\n", failed);
+  return 1;
+}
@@ -284,6 +284,46 @@ int main(void) {
 
   lsp_server_free(&s);
 
+  /* ---- 目标文件解析缓存：按 URI id 命中，超出上限时淘汰最久未用者 ---- */
+  printf("Testing: unit cache hits + LRU trim...\n");
+  {
+    char pa[4200], pb[4200], pc[4200], ub[4400];
+#ifdef _WIN32
+    snprintf(pa, sizeof pa, "%s\\a.spt", dir);
+    snprintf(pb, sizeof pb, "%s\\b.spt", dir);
+    snprintf(pc, sizeof pc, "%s\\c.spt", sub);
+#else
+    snprintf(pa, sizeof pa, "%s/a.spt", dir);
+    snprintf(pb, sizeof pb, "%s/b.spt", dir);
+    snprintf(pc, sizeof pc, "%s/c.spt", sub);
+#endif
+    Workspace ws;
+    workspace_init(&ws);
+    WsUnit a = workspace_get_unit(&ws, pa);
+    WsUnit b = workspace_get_unit(&ws, pb);
+    WsUnit c = workspace_get_unit(&ws, pc);
+    CHECK(a.unit && b.unit && c.unit && ws.unit_count == 3, "three units cached");
+    CHECK(workspace_get_unit(&ws, pa).unit == a.unit, "second lookup hits cache");
+    size_t all = ws.unit_bytes;
+    CHECK(all > 0, "cache size accounted");
+
+    workspace_trim_units(&ws); /* 默认上限远大于三个小文件 */
+    CHECK(ws.unit_count == 3, "under budget: nothing evicted");
+    /* a 刚被取用，b 最久未用：上限降到只容两个时淘汰 b。 */
+    ws.unit_budget = all - 1;
+    workspace_trim_units(&ws);
+    CHECK(ws.unit_count == 2 && ws.unit_bytes <= ws.unit_budget, "trimmed to budget");
+    spt_path_to_uri(pb, ub, sizeof ub);
+    int bid = uri_table_find(ws.uris, ub);
+    CHECK(bid >= 0 && (bid >= ws.unit_of_cap || ws.unit_of[bid] == 0), "LRU victim is b.spt");
+    CHECK(workspace_get_unit(&ws, pa).unit == a.unit, "a.spt survived");
+    CHECK(workspace_get_unit(&ws, pb).unit != NULL, "b.spt re-parsed on demand");
+
+    workspace_mark_doc_dirty(&ws, ub); /* 未建索引：整体失效 */
+    CHECK(ws.unit_count == 0 && ws.unit_bytes == 0, "mark dirty drops every unit");
+    workspace_free(&ws);
+  }
+
   /* cleanup */
   remove_dir_recursive(dir);
 
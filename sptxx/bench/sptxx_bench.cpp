@@ -0,0 +1,1007 @@
+// sptxx_bench.cpp - sptxx 绑定层微基准：每一项与等价的手写 C API 实现成对计时
+//
+// 写法仿 Google Benchmark：基准函数接收 bench::state，准备工作写在循环外，
+// `for (auto _ : st)` 的循环体即被计时的一次迭代。harness 先按 --min-time 标定迭代次数
+// （每轮按已测速度预测，至多放大 10 倍），再以该次数重复 --reps 次取最快一次，
+// 报告每次操作的纳秒数。每次运行都在全新的状态中进行，准备工作不计时。
+//
+// 每项基准由一对函数组成：c_* 直接调用 C API（有经验的 C 绑定作者会写的样子），
+// cxx_* 为 sptxx 写法；二者之比（sptxx / C）即绑定层的开销。比值基本不随机器快慢变化，
+// 给定 --baseline 时与基线 JSON（本程序先前的输出）按名称对比比值，变大超过阈值即判为
+// 回归，进程返回 1。结果格式与基线对比用 spt-lang/bench/spt_bench_report.h。
+//
+// 脚本驱动的基准（脚本循环里调用绑定函数、读写属性、调用方法）两侧载入同一段脚本、
+// 用同一个驱动函数，差别只在被调用的一侧；一次迭代执行 kLoop 次内层操作，按内层操作计时。
+//
+//   sptxx_bench [--filter S] [--min-time SEC] [--reps N] [--out FILE]
+//               [--baseline FILE] [--threshold P] [--list]
+//
+// CMake 目标 sptxx_bench_run / sptxx_bench_baseline / sptxx_bench_check。
+
+#include "sptxx.hpp"
+
+#include "spt_bench_report.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+// 阻止编译器把被测结果当作死代码消除。
+template <typename T> inline void do_not_optimize(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "m"(value) : "memory");
+#else
+  static volatile const void *sink;
+  sink = &value;
+#endif
+}
+
+class state {
+  using clock = std::chrono::steady_clock;
+
+public:
+  explicit state(std::uint64_t iterations) : iterations_(iterations) {}
+
+  struct [[maybe_unused]] value {}; // `for (auto _ : st)` 的循环变量不会触发未使用警告
+
+  class iterator {
+  public:
+    iterator(state *st, std::uint64_t left) : st_(st), left_(left) {}
+    value operator*() const { return {}; }
+    iterator &operator++() {
+      --left_;
+      return *this;
+    }
+    // 最后一次比较时停表，循环之后的校验与清理不计时。
+    bool operator!=(const iterator &) const {
+      if (left_ != 0)
+        return true;
+      st_->stop();
+      return false;
+    }
+
+  private:
+    state *st_;
+    std::uint64_t left_;
+  };
+
+  iterator begin() {
+    start_ = clock::now();
+    return iterator(this, iterations_);
+  }
+  iterator end() { return iterator(this, 0); }
+
+  // 一次迭代包含的内层操作数；结果按内层操作计时。
+  void set_items_per_iteration(std::uint64_t n) { items_ = n; }
+
+  std::uint64_t iterations() const { return iterations_; }
+  std::uint64_t items() const { return iterations_ * items_; }
+  double elapsed_ns() const { return elapsed_ns_; }
+
+private:
+  void stop() {
+    elapsed_ns_ = std::chrono::duration<double, std::nano>(clock::now() - start_).count();
+  }
+
+  std::uint64_t iterations_;
+  std::uint64_t items_ = 1;
+  clock::time_point start_;
+  double elapsed_ns_ = 0;
+};
+
+using function = void (*)(state &);
+
+} // namespace bench
+
+namespace {
+
+constexpr int kLoop = 1000;   // 脚本驱动基准每次迭代的内层操作数
+constexpr int kListLen = 1000; // list 元素访问 / 转换的元素数
+constexpr int kMapLen = 100;   // map 元素访问 / 转换的键数
+
+// 两侧共用的脚本；obj 由各自的准备代码放进全局表。
+const char *const kScript = R"(
+global int loop_call(any o, int n) {
+  int s = 0;
+  for (int i = 1, n) { s = add(s, 1); }
+  return s;
+}
+global int loop_get(any o, int n) {
+  int s = 0;
+  for (int i = 1, n) { s = s + o.x; }
+  return s;
+}
+global int loop_set(any o, int n) {
+  for (int i = 1, n) { o.x = i; }
+  return o.x;
+}
+global int loop_call_overload(any o, int n) {
+  int s = 0;
+  for (int i = 1, n) { s = s + mix(i) + mix(i, 1); }
+  return s;
+}
+global int loop_inherited(any o, int n) {
+  int s = 0;
+  for (int i = 1, n) { s = s + o.base_method(i); }
+  return s;
+}
+global int loop_overload(any o, int n) {
+  int s = 0;
+  for (int i = 1, n) { s = s + o.apply(i) + o.apply(i, 1); }
+  return s;
+}
+global int lua_add(int a, int b) { return a + b; }
+global any gen = fn() -> void {
+  int i = 0;
+  while (true) { i = i + 1; coroutine.yield(i); }
+};
+)";
+
+void check(lua_State *L, int status) {
+  if (status != LUA_OK) {
+    const char *msg = lua_tostring(L, -1);
+    throw std::runtime_error(msg ? msg : "unknown Lua error");
+  }
+}
+
+// C 侧的状态：开库并载入共用脚本。
+struct c_state {
+  lua_State *L;
+  c_state() : L(luaL_newstate()) {
+    if (!L)
+      throw std::runtime_error("failed to create Lua state");
+    luaL_openlibs(L);
+    check(L, luaL_dostring(L, kScript));
+  }
+  ~c_state() { lua_close(L); }
+  c_state(const c_state &) = delete;
+  c_state &operator=(const c_state &) = delete;
+};
+
+// sptxx 侧的状态：同上。
+struct cxx_state : sptxx::state_with_coroutine {
+  cxx_state() {
+    open_libraries();
+    do_string(kScript);
+  }
+};
+
+// 调用脚本中的 fname(obj, n)；两侧共用，计时区内只有这一次 pcall 的固定开销。
+lua_Integer drive(lua_State *L, const char *fname, int n) {
+  lua_getglobal(L, fname);
+  lua_pushnil(L); // Slot 0 receiver
+  lua_getglobal(L, "obj");
+  lua_pushinteger(L, n);
+  check(L, lua_pcall(L, 3, 1, 0));
+  lua_Integer r = lua_tointeger(L, -1);
+  lua_pop(L, 1);
+  return r;
+}
+
+void drive_loop(bench::state &st, lua_State *L, const char *fname, int items_per_loop = 1) {
+  st.set_items_per_iteration(static_cast<std::uint64_t>(kLoop) * items_per_loop);
+  for (auto _ : st)
+    bench::do_not_optimize(drive(L, fname, kLoop));
+}
+
+// ---- 被绑定的 C++ 类型与函数 ----
+
+int cxx_add(int a, int b) { return a + b; }
+
+struct Point {
+  int x = 0;
+  int y = 0;
+};
+
+struct Base {
+  int base_val = 1;
+  int base_method(int v) { return base_val + v; }
+};
+
+struct Derived : Base {
+  int derived_val = 2;
+  int derived_method() { return derived_val; }
+};
+
+struct Calc {
+  int base = 100;
+  int apply(int v) const { return base + v; }
+  int apply(int v, int w) const { return base + v + w; }
+};
+
+// ---- 手写 C 绑定 ----
+
+int c_add(lua_State *L) {
+  lua_pushinteger(L, luaL_checkinteger(L, 2) + luaL_checkinteger(L, 3));
+  return 1;
+}
+
+int c_add_bias(lua_State *L) {
+  lua_pushinteger(L, luaL_checkinteger(L, 2) + luaL_checkinteger(L, 3) +
+                         lua_tointeger(L, lua_upvalueindex(1)));
+  return 1;
+}
+
+// 与 cxx_call_overload 的重载集同序判定：(string) / (int, int) / (number, number) / (int)。
+int c_mix(lua_State *L) {
+  int n = lua_gettop(L) - 1;
+  if (n == 1 && lua_type(L, 2) == LUA_TSTRING)
+    lua_pushinteger(L, static_cast<lua_Integer>(lua_rawlen(L, 2)));
+  else if (n == 2 && lua_isinteger(L, 2) && lua_isinteger(L, 3))
+    lua_pushinteger(L, lua_tointeger(L, 2) + lua_tointeger(L, 3));
+  else if (n == 2 && lua_isnumber(L, 2) && lua_isnumber(L, 3))
+    lua_pushinteger(L, static_cast<lua_Integer>(lua_tonumber(L, 2) * lua_tonumber(L, 3)));
+  else if (n == 1 && lua_isinteger(L, 2))
+    lua_pushinteger(L, lua_tointeger(L, 2));
+  else
+    return luaL_error(L, "no matching overload");
+  return 1;
+}
+
+int c_traceback(lua_State *L) {
+  const char *msg = lua_tostring(L, 1);
+  luaL_traceback(L, L, msg ? msg : "(error object is not a string)", 1);
+  return 1;
+}
+
+int c_point_index(lua_State *L) {
+  Point *p = static_cast<Point *>(luaL_checkudata(L, 1, "CPoint"));
+  const char *k = luaL_checkstring(L, 2);
+  if (std::strcmp(k, "x") == 0)
+    lua_pushinteger(L, p->x);
+  else if (std::strcmp(k, "y") == 0)
+    lua_pushinteger(L, p->y);
+  else
+    lua_pushnil(L);
+  return 1;
+}
+
+int c_point_newindex(lua_State *L) {
+  Point *p = static_cast<Point *>(luaL_checkudata(L, 1, "CPoint"));
+  const char *k = luaL_checkstring(L, 2);
+  int v = static_cast<int>(luaL_checkinteger(L, 3));
+  if (std::strcmp(k, "x") == 0)
+    p->x = v;
+  else if (std::strcmp(k, "y") == 0)
+    p->y = v;
+  else
+    return luaL_error(L, "no field '%s'", k);
+  return 0;
+}
+
+// 基类方法接受 CDerived 与 CBase 两种 userdata。
+int c_base_method(lua_State *L) {
+  void *ud = luaL_testudata(L, 1, "CDerived");
+  Base *b = ud ? static_cast<Base *>(static_cast<Derived *>(ud))
+               : static_cast<Base *>(luaL_checkudata(L, 1, "CBase"));
+  lua_pushinteger(L, b->base_method(static_cast<int>(luaL_checkinteger(L, 2))));
+  return 1;
+}
+
+int c_derived_method(lua_State *L) {
+  Derived *d = static_cast<Derived *>(luaL_checkudata(L, 1, "CDerived"));
+  lua_pushinteger(L, d->derived_method());
+  return 1;
+}
+
+int c_calc_apply(lua_State *L) {
+  const Calc *c = static_cast<const Calc *>(luaL_checkudata(L, 1, "CCalc"));
+  int v = static_cast<int>(luaL_checkinteger(L, 2));
+  if (lua_gettop(L) >= 3)
+    lua_pushinteger(L, c->apply(v, static_cast<int>(luaL_checkinteger(L, 3))));
+  else
+    lua_pushinteger(L, c->apply(v));
+  return 1;
+}
+
+// ---- 函数注册 ----
+
+void c_register_function(bench::state &st) {
+  c_state s;
+  for (auto _ : st) {
+    lua_pushcfunction(s.L, c_add);
+    lua_setglobal(s.L, "add");
+  }
+}
+
+void cxx_register_function(bench::state &st) {
+  cxx_state lua;
+  for (auto _ : st)
+    lua.set_function("add", [](int a, int b) { return a + b; });
+}
+
+void c_register_closure(bench::state &st) {
+  c_state s;
+  lua_Integer bias = 7;
+  for (auto _ : st) {
+    lua_pushinteger(s.L, bias);
+    lua_pushcclosure(s.L, c_add_bias, 1);
+    lua_setglobal(s.L, "add");
+  }
+}
+
+void cxx_register_closure(bench::state &st) {
+  cxx_state lua;
+  int bias = 7;
+  for (auto _ : st)
+    lua.set_function("add", [bias](int a, int b) { return a + b + bias; });
+}
+
+// ---- 函数调用 ----
+
+void c_call_from_script(bench::state &st) {
+  c_state s;
+  lua_register(s.L, "add", c_add);
+  drive_loop(st, s.L, "loop_call");
+}
+
+void cxx_call_from_script(bench::state &st) {
+  cxx_state lua;
+  lua.set_function("add", sptxx::fn<&cxx_add>{});
+  drive_loop(st, lua.lua_state(), "loop_call");
+}
+
+void c_call_overload(bench::state &st) {
+  c_state s;
+  lua_register(s.L, "mix", c_mix);
+  drive_loop(st, s.L, "loop_call_overload", 2);
+}
+
+void cxx_call_overload(bench::state &st) {
+  cxx_state lua;
+  lua.set_function("mix", sptxx::overload([](const std::string &v) { return static_cast<int>(v.size()); },
+                                          [](int a, int b) { return a + b; },
+                                          [](double a, double b) { return static_cast<int>(a * b); },
+                                          [](int a) { return a; }));
+  drive_loop(st, lua.lua_state(), "loop_call_overload", 2);
+}
+
+void c_call_from_host(bench::state &st) {
+  c_state s;
+  lua_State *L = s.L;
+  int i = 0;
+  for (auto _ : st) {
+    lua_getglobal(L, "lua_add");
+    lua_pushnil(L);
+    lua_pushinteger(L, i++);
+    lua_pushinteger(L, 1);
+    check(L, lua_pcall(L, 3, 1, 0));
+    bench::do_not_optimize(lua_tointeger(L, -1));
+    lua_pop(L, 1);
+  }
+}
+
+void cxx_call_from_host(bench::state &st) {
+  cxx_state lua;
+  int i = 0;
+  for (auto _ : st)
+    bench::do_not_optimize(lua.call<int>("lua_add", i++, 1));
+}
+
+// 函数与错误处理函数固定在栈上（与 protected_function 相同的做法）。
+void c_call_protected(bench::state &st) {
+  c_state s;
+  lua_State *L = s.L;
+  lua_pushcfunction(L, c_traceback);
+  int msgh = lua_gettop(L);
+  lua_getglobal(L, "lua_add");
+  int f = lua_gettop(L);
+  int i = 0;
+  for (auto _ : st) {
+    lua_pushvalue(L, f);
+    lua_pushnil(L);
+    lua_pushinteger(L, i++);
+    lua_pushinteger(L, 1);
+    check(L, lua_pcall(L, 3, 1, msgh));
+    bench::do_not_optimize(lua_tointeger(L, -1));
+    lua_pop(L, 1);
+  }
+}
+
+void cxx_call_protected(bench::state &st) {
+  cxx_state lua;
+  auto f = lua.get_protected_function<int(int, int)>("lua_add");
+  int i = 0;
+  for (auto _ : st)
+    bench::do_not_optimize(f(i++, 1));
+}
+
+// ---- usertype 属性 ----
+
+void c_push_point(lua_State *L) {
+  if (luaL_newmetatable(L, "CPoint")) {
+    lua_pushcfunction(L, c_point_index);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, c_point_newindex);
+    lua_setfield(L, -2, "__newindex");
+  }
+  lua_pop(L, 1);
+  new (lua_newuserdatauv(L, sizeof(Point), 0)) Point{1, 2};
+  luaL_setmetatable(L, "CPoint");
+  lua_setglobal(L, "obj");
+}
+
+void cxx_push_point(sptxx::state &lua) {
+  auto ut = lua.new_usertype<Point>("Point");
+  ut.set("x", &Point::x);
+  ut.set("y", &Point::y);
+  ut.push_value(Point{1, 2});
+  lua_setglobal(lua.lua_state(), "obj");
+}
+
+void c_property_get(bench::state &st) {
+  c_state s;
+  c_push_point(s.L);
+  drive_loop(st, s.L, "loop_get");
+}
+
+void cxx_property_get(bench::state &st) {
+  cxx_state lua;
+  cxx_push_point(lua);
+  drive_loop(st, lua.lua_state(), "loop_get");
+}
+
+void c_property_set(bench::state &st) {
+  c_state s;
+  c_push_point(s.L);
+  drive_loop(st, s.L, "loop_set");
+}
+
+void cxx_property_set(bench::state &st) {
+  cxx_state lua;
+  cxx_push_point(lua);
+  drive_loop(st, lua.lua_state(), "loop_set");
+}
+
+// ---- 方法分派：继承与重载 ----
+
+// 经典的 C 写法：方法表按 __index 链接成继承链。
+void c_method_inherited(bench::state &st) {
+  c_state s;
+  lua_State *L = s.L;
+  luaL_newmetatable(L, "CBase");
+  lua_newtable(L);
+  int base_methods = lua_gettop(L);
+  lua_pushcfunction(L, c_base_method);
+  lua_setfield(L, -2, "base_method");
+  lua_pushvalue(L, base_methods);
+  lua_setfield(L, -3, "__index");
+
+  luaL_newmetatable(L, "CDerived");
+  lua_newtable(L);
+  lua_pushcfunction(L, c_derived_method);
+  lua_setfield(L, -2, "derived_method");
+  lua_newtable(L);
+  lua_pushvalue(L, base_methods);
+  lua_setfield(L, -2, "__index");
+  lua_setmetatable(L, -2);
+  lua_setfield(L, -2, "__index");
+  lua_settop(L, 0);
+
+  new (lua_newuserdatauv(L, sizeof(Derived), 0)) Derived();
+  luaL_setmetatable(L, "CDerived");
+  lua_setglobal(L, "obj");
+  drive_loop(st, L, "loop_inherited");
+}
+
+void cxx_method_inherited(bench::state &st) {
+  cxx_state lua;
+  auto base = lua.new_usertype<Base>("Base");
+  base.set("base_val", &Base::base_val);
+  base.set("base_method", &Base::base_method);
+  auto derived = lua.new_usertype<Derived>("Derived");
+  derived.base<Base>("Base");
+  derived.set("derived_val", &Derived::derived_val);
+  derived.set("derived_method", &Derived::derived_method);
+  derived.push_value(Derived());
+  lua_setglobal(lua.lua_state(), "obj");
+  drive_loop(st, lua.lua_state(), "loop_inherited");
+}
+
+// 手写 C 按参数个数在一个函数里分派。
+void c_method_overload(bench::state &st) {
+  c_state s;
+  lua_State *L = s.L;
+  luaL_newmetatable(L, "CCalc");
+  lua_newtable(L);
+  lua_pushcfunction(L, c_calc_apply);
+  lua_setfield(L, -2, "apply");
+  lua_setfield(L, -2, "__index");
+  lua_pop(L, 1);
+  new (lua_newuserdatauv(L, sizeof(Calc), 0)) Calc();
+  luaL_setmetatable(L, "CCalc");
+  lua_setglobal(L, "obj");
+  drive_loop(st, L, "loop_overload", 2);
+}
+
+void cxx_method_overload(bench::state &st) {
+  cxx_state lua;
+  auto ut = lua.new_usertype<Calc>("Calc");
+  ut.set_overload("apply", static_cast<int (Calc::*)(int) const>(&Calc::apply),
+                  static_cast<int (Calc::*)(int, int) const>(&Calc::apply));
+  ut.push_value(Calc());
+  lua_setglobal(lua.lua_state(), "obj");
+  drive_loop(st, lua.lua_state(), "loop_overload", 2);
+}
+
+// ---- list / map 元素访问（宿主侧，经 registry 引用） ----
+
+int c_make_list(lua_State *L) {
+  lua_createarray(L, kListLen);
+  for (int i = 0; i < kListLen; ++i) {
+    lua_pushinteger(L, i);
+    lua_seti(L, -2, i);
+  }
+  return luaL_ref(L, LUA_REGISTRYINDEX);
+}
+
+sptxx::list<int> cxx_make_list(sptxx::state &lua) {
+  auto l = lua.create_list<int>(kListLen);
+  for (int i = 0; i < kListLen; ++i)
+    l.set(i, i);
+  return l;
+}
+
+void c_list_get(bench::state &st) {
+  c_state s;
+  lua_State *L = s.L;
+  int ref = c_make_list(L);
+  lua_Integer i = 0;
+  for (auto _ : st) {
+    lua_getref(L, ref);
+    lua_geti(L, -1, i);
+    bench::do_not_optimize(lua_tointeger(L, -1));
+    lua_pop(L, 2);
+    i = (i + 1) % kListLen;
+  }
+}
+
+void cxx_list_get(bench::state &st) {
+  cxx_state lua;
+  auto l = cxx_make_list(lua);
+  std::size_t i = 0;
+  for (auto _ : st) {
+    bench::do_not_optimize(l.get(i));
+    i = (i + 1) % kListLen;
+  }
+}
+
+void c_list_set(bench::state &st) {
+  c_state s;
+  lua_State *L = s.L;
+  int ref = c_make_list(L);
+  lua_Integer i = 0;
+  for (auto _ : st) {
+    lua_getref(L, ref);
+    lua_pushinteger(L, i);
+    lua_seti(L, -2, i);
+    lua_pop(L, 1);
+    i = (i + 1) % kListLen;
+  }
+}
+
+void cxx_list_set(bench::state &st) {
+  cxx_state lua;
+  auto l = cxx_make_list(lua);
+  std::size_t i = 0;
+  for (auto _ : st) {
+    l.set(i, static_cast<int>(i));
+    i = (i + 1) % kListLen;
+  }
+}
+
+std::vector<std::string> map_keys() {
+  std::vector<std::string> keys;
+  for (int i = 0; i < kMapLen; ++i)
+    keys.push_back("key" + std::to_string(i));
+  return keys;
+}
+
+int c_make_map(lua_State *L, const std::vector<std::string> &keys) {
+  lua_createtable(L, 0, kMapLen);
+  for (int i = 0; i < kMapLen; ++i) {
+    lua_pushinteger(L, i);
+    lua_setfield(L, -2, keys[i].c_str());
+  }
+  return luaL_ref(L, LUA_REGISTRYINDEX);
+}
+
+sptxx::map<int> cxx_make_map(sptxx::state &lua, const std::vector<std::string> &keys) {
+  auto m = lua.create_map<int>();
+  for (int i = 0; i < kMapLen; ++i)
+    m.set(keys[i], i);
+  return m;
+}
+
+void c_map_get(bench::state &st) {
+  c_state s;
+  lua_State *L = s.L;
+  auto keys = map_keys();
+  int ref = c_make_map(L, keys);
+  std::size_t i = 0;
+  for (auto _ : st) {
+    lua_getref(L, ref);
+    lua_getfield(L, -1, keys[i].c_str());
+    bench::do_not_optimize(lua_tointeger(L, -1));
+    lua_pop(L, 2);
+    i = (i + 1) % kMapLen;
+  }
+}
+
+void cxx_map_get(bench::state &st) {
+  cxx_state lua;
+  auto keys = map_keys();
+  auto m = cxx_make_map(lua, keys);
+  std::size_t i = 0;
+  for (auto _ : st) {
+    bench::do_not_optimize(m.get(keys[i]));
+    i = (i + 1) % kMapLen;
+  }
+}
+
+void c_map_set(bench::state &st) {
+  c_state s;
+  lua_State *L = s.L;
+  auto keys = map_keys();
+  int ref = c_make_map(L, keys);
+  std::size_t i = 0;
+  for (auto _ : st) {
+    lua_getref(L, ref);
+    lua_pushinteger(L, static_cast<lua_Integer>(i));
+    lua_setfield(L, -2, keys[i].c_str());
+    lua_pop(L, 1);
+    i = (i + 1) % kMapLen;
+  }
+}
+
+void cxx_map_set(bench::state &st) {
+  cxx_state lua;
+  auto keys = map_keys();
+  auto m = cxx_make_map(lua, keys);
+  std::size_t i = 0;
+  for (auto _ : st) {
+    m.set(keys[i], static_cast<int>(i));
+    i = (i + 1) % kMapLen;
+  }
+}
+
+// ---- 容器转换（整段，一次迭代转换一个容器） ----
+
+std::vector<double> sample_vector() {
+  std::vector<double> v(kListLen);
+  for (int i = 0; i < kListLen; ++i)
+    v[i] = i * 0.5;
+  return v;
+}
+
+void c_vector_to_list(bench::state &st) {
+  c_state s;
+  lua_State *L = s.L;
+  auto v = sample_vector();
+  for (auto _ : st) {
+    lua_createarray(L, kListLen);
+    lua_arraywrite(L, -1, 0, LUA_BULK_NUMBER, v.data(), kListLen);
+    lua_pop(L, 1);
+  }
+}
+
+void cxx_vector_to_list(bench::state &st) {
+  cxx_state lua;
+  lua_State *L = lua.lua_state();
+  auto v = sample_vector();
+  for (auto _ : st) {
+    sptxx::stack::push(L, v);
+    lua_pop(L, 1);
+  }
+}
+
+void c_list_to_vector(bench::state &st) {
+  c_state s;
+  lua_State *L = s.L;
+  auto v = sample_vector();
+  lua_createarray(L, kListLen);
+  lua_arraywrite(L, -1, 0, LUA_BULK_NUMBER, v.data(), kListLen);
+  for (auto _ : st) {
+    std::vector<double> out(static_cast<std::size_t>(lua_arraylen(L, -1)));
+    if (!lua_arrayread(L, -1, 0, LUA_BULK_NUMBER, out.data(), static_cast<lua_Integer>(out.size())))
+      throw std::runtime_error("lua_arrayread failed");
+    bench::do_not_optimize(out.data()[0]);
+  }
+}
+
+void cxx_list_to_vector(bench::state &st) {
+  cxx_state lua;
+  lua_State *L = lua.lua_state();
+  sptxx::stack::push(L, sample_vector());
+  for (auto _ : st) {
+    auto out = sptxx::stack::get<std::vector<double>>(L, -1);
+    bench::do_not_optimize(out.data()[0]);
+  }
+}
+
+std::map<std::string, int> sample_map() {
+  std::map<std::string, int> m;
+  auto keys = map_keys();
+  for (int i = 0; i < kMapLen; ++i)
+    m.emplace(keys[i], i);
+  return m;
+}
+
+void c_map_to_table(bench::state &st) {
+  c_state s;
+  lua_State *L = s.L;
+  auto m = sample_map();
+  for (auto _ : st) {
+    lua_createtable(L, 0, static_cast<int>(m.size()));
+    for (const auto &[k, v] : m) {
+      lua_pushinteger(L, v);
+      lua_setfield(L, -2, k.c_str());
+    }
+    lua_pop(L, 1);
+  }
+}
+
+void cxx_map_to_table(bench::state &st) {
+  cxx_state lua;
+  lua_State *L = lua.lua_state();
+  auto m = sample_map();
+  for (auto _ : st) {
+    sptxx::stack::push(L, m);
+    lua_pop(L, 1);
+  }
+}
+
+void c_table_to_map(bench::state &st) {
+  c_state s;
+  lua_State *L = s.L;
+  auto keys = map_keys();
+  lua_getref(L, c_make_map(L, keys));
+  for (auto _ : st) {
+    std::map<std::string, int> out;
+    lua_pushnil(L);
+    while (lua_next(L, -2)) {
+      out.emplace(lua_tostring(L, -2), static_cast<int>(lua_tointeger(L, -1)));
+      lua_pop(L, 1);
+    }
+    bench::do_not_optimize(out.size());
+  }
+}
+
+void cxx_table_to_map(bench::state &st) {
+  cxx_state lua;
+  lua_State *L = lua.lua_state();
+  sptxx::stack::push(L, sample_map());
+  for (auto _ : st) {
+    auto out = sptxx::stack::get<std::map<std::string, int>>(L, -1);
+    bench::do_not_optimize(out.size());
+  }
+}
+
+// ---- 协程 ----
+
+void c_coroutine_resume(bench::state &st) {
+  c_state s;
+  lua_State *L = s.L;
+  lua_State *co = lua_newthread(L); // 留在主栈上作锚
+  lua_getglobal(co, "gen");
+  for (auto _ : st) {
+    int nres = 0;
+    int status = lua_resume(co, L, 0, &nres);
+    if (status != LUA_YIELD)
+      check(co, status == LUA_OK ? LUA_ERRRUN : status);
+    bench::do_not_optimize(lua_tointeger(co, -1));
+    lua_pop(co, nres);
+  }
+}
+
+void cxx_coroutine_resume(bench::state &st) {
+  cxx_state lua;
+  auto co = lua.create_coroutine_from_function("gen");
+  for (auto _ : st)
+    bench::do_not_optimize(co.resume_with_result<int>().second);
+}
+
+struct pair {
+  const char *name;
+  bench::function c;
+  bench::function cxx;
+};
+
+const pair kPairs[] = {
+    {"register_function", c_register_function, cxx_register_function},
+    {"register_closure", c_register_closure, cxx_register_closure},
+    {"call_from_script", c_call_from_script, cxx_call_from_script},
+    {"call_overload", c_call_overload, cxx_call_overload},
+    {"call_from_host", c_call_from_host, cxx_call_from_host},
+    {"call_protected", c_call_protected, cxx_call_protected},
+    {"property_get", c_property_get, cxx_property_get},
+    {"property_set", c_property_set, cxx_property_set},
+    {"method_inherited", c_method_inherited, cxx_method_inherited},
+    {"method_overload", c_method_overload, cxx_method_overload},
+    {"list_get", c_list_get, cxx_list_get},
+    {"list_set", c_list_set, cxx_list_set},
+    {"map_get", c_map_get, cxx_map_get},
+    {"map_set", c_map_set, cxx_map_set},
+    {"vector_to_list", c_vector_to_list, cxx_vector_to_list},
+    {"list_to_vector", c_list_to_vector, cxx_list_to_vector},
+    {"map_to_table", c_map_to_table, cxx_map_to_table},
+    {"table_to_map", c_table_to_map, cxx_table_to_map},
+    {"coroutine_resume", c_coroutine_resume, cxx_coroutine_resume},
+};
+
+// ---- harness ----
+
+struct options {
+  const char *filter = nullptr;
+  double min_time_ns = 0.2e9;
+  int reps = 3;
+  const char *out = nullptr;
+  const char *baseline = nullptr;
+  double threshold = 25.0; // 百分比
+  bool list = false;
+};
+
+struct result {
+  const char *name;
+  double c_ns, cxx_ns; // 每次操作
+  double ratio;        // cxx_ns / c_ns
+};
+
+// 标定迭代次数后重复 reps 次，返回最快一次的每操作纳秒数。
+double measure(bench::function fn, const options &o) {
+  constexpr std::uint64_t kMaxIterations = 1000000000;
+  std::uint64_t n = 1;
+  double best;
+  for (;;) {
+    bench::state st(n);
+    fn(st);
+    best = st.elapsed_ns() / static_cast<double>(st.items());
+    if (st.elapsed_ns() >= o.min_time_ns || n >= kMaxIterations)
+      break;
+    double mult = st.elapsed_ns() > 0 ? o.min_time_ns * 1.4 / st.elapsed_ns() : 10.0;
+    n = std::min(kMaxIterations, static_cast<std::uint64_t>(n * std::clamp(mult, 2.0, 10.0)));
+  }
+  for (int r = 1; r < o.reps; ++r) {
+    bench::state st(n);
+    fn(st);
+    best = std::min(best, st.elapsed_ns() / static_cast<double>(st.items()));
+  }
+  return best;
+}
+
+void write_json(FILE *f, const options &o, const std::vector<result> &rs) {
+  const BenchField head[] = {{"min_time_s", nullptr, o.min_time_ns / 1e9, 3},
+                             {"reps", nullptr, static_cast<double>(o.reps), 0}};
+  std::vector<BenchField> rows;
+  rows.reserve(rs.size() * 4);
+  for (const auto &r : rs) {
+    rows.push_back({"name", r.name, 0, 0});
+    rows.push_back({"c_ns", nullptr, r.c_ns, 3});
+    rows.push_back({"sptxx_ns", nullptr, r.cxx_ns, 3});
+    rows.push_back({"ratio", nullptr, r.ratio, 4});
+  }
+  bench_write_json(f, head, 2, "results", rows.data(), static_cast<int>(rs.size()), 4);
+}
+
+// 按名称对比开销比，返回回归条数。
+int compare_baseline(const BenchBaseline &b, const std::vector<result> &rs, double threshold) {
+  BenchCompare c;
+  bench_compare_begin(&c, "benchmark (sptxx / C)", threshold, 0);
+  for (const auto &r : rs) {
+    const BenchField key = {"name", r.name, 0, 0};
+    double base = -1;
+    if (!bench_baseline_num(bench_baseline_find(&b, &key, 1), "ratio", &base) || base <= 0)
+      base = -1;
+    bench_compare_row(&c, r.name, base, r.ratio);
+  }
+  return bench_compare_end(&c);
+}
+
+void print_help(const char *prog) {
+  std::printf("Usage: %s [options]\n", prog);
+  std::printf("Options:\n");
+  std::printf("  --filter S        only benchmarks whose name contains S\n");
+  std::printf("  --min-time SEC    minimum timed duration per calibration (default 0.2)\n");
+  std::printf("  --reps N          timed runs after calibration, fastest wins (default 3)\n");
+  std::printf("  --out FILE        write JSON results to FILE (default stdout)\n");
+  std::printf("  --baseline FILE   compare sptxx/C ratios against a previous JSON result\n");
+  std::printf("  --threshold P     regression threshold in percent (default 25)\n");
+  std::printf("  --list            list registered benchmarks and exit\n");
+  std::printf("Exit status: 0 ok, 1 regression against the baseline,\n");
+  std::printf("             2 error (including a missing or unreadable baseline).\n");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  options o;
+  for (int i = 1; i < argc; ++i) {
+    const char *a = argv[i];
+    bool v = i + 1 < argc;
+    if (std::strcmp(a, "--help") == 0 || std::strcmp(a, "-h") == 0) {
+      print_help(argv[0]);
+      return 0;
+    } else if (std::strcmp(a, "--list") == 0)
+      o.list = true;
+    else if (v && std::strcmp(a, "--filter") == 0)
+      o.filter = argv[++i];
+    else if (v && std::strcmp(a, "--min-time") == 0)
+      o.min_time_ns = std::atof(argv[++i]) * 1e9;
+    else if (v && std::strcmp(a, "--reps") == 0)
+      o.reps = std::atoi(argv[++i]);
+    else if (v && std::strcmp(a, "--out") == 0)
+      o.out = argv[++i];
+    else if (v && std::strcmp(a, "--baseline") == 0)
+      o.baseline = argv[++i];
+    else if (v && std::strcmp(a, "--threshold") == 0)
+      o.threshold = std::atof(argv[++i]);
+    else {
+      std::fprintf(stderr, "unknown option '%s' (see --help)\n", a);
+      return 2;
+    }
+  }
+  if (o.reps < 1 || o.min_time_ns < 0) {
+    std::fprintf(stderr, "--reps must be >= 1 and --min-time >= 0\n");
+    return 2;
+  }
+  if (o.list) {
+    for (const auto &p : kPairs)
+      std::printf("%s\n", p.name);
+    return 0;
+  }
+  // 基线先读：缺失时不必跑完全套才失败。
+  BenchBaseline base;
+  if (o.baseline && bench_baseline_load(&base, o.baseline, "sptxx_bench_baseline") != 0)
+    return 2;
+
+  std::vector<result> results;
+  int failed = 0;
+  std::fprintf(stderr, "%-20s %12s %12s %8s\n", "benchmark", "C (ns/op)", "sptxx (ns/op)",
+               "ratio");
+  for (const auto &p : kPairs) {
+    if (o.filter && !std::strstr(p.name, o.filter))
+      continue;
+    try {
+      result r{p.name, 0, 0, 0};
+      r.c_ns = measure(p.c, o);
+      r.cxx_ns = measure(p.cxx, o);
+      r.ratio = r.c_ns > 0 ? r.cxx_ns / r.c_ns : 0;
+      std::fprintf(stderr, "%-20s %12.1f %12.1f %7.2fx\n", r.name, r.c_ns, r.cxx_ns, r.ratio);
+      results.push_back(r);
+    } catch (const std::exception &e) {
+      std::fprintf(stderr, "%-20s failed: %s\n", p.name, e.what());
+      ++failed;
+    }
+  }
+
+  int rc = 0;
+  FILE *out = stdout;
+  if (o.out && !(out = std::fopen(o.out, "w"))) {
+    std::fprintf(stderr, "cannot write %s\n", o.out);
+    rc = 2;
+  } else {
+    write_json(out, o, results);
+    if (out != stdout)
+      std::fclose(out);
+  }
+
+  int regressions = 0;
+  if (o.baseline) {
+    regressions = compare_baseline(base, results, o.threshold);
+    bench_baseline_free(&base);
+  }
+  if (failed) {
+    std::fprintf(stderr, "%d benchmark(s) failed\n", failed);
+    rc = 2;
+  }
+  return rc ? rc : regressions > 0;
+}
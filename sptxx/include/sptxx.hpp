@@ -7,6 +7,9 @@
 #include "sptxx/list.hpp"
 #include "sptxx/map.hpp"
 #include "sptxx/function.hpp"
+#include "sptxx/protected_function.hpp"
+#include "sptxx/frozen_chunk.hpp"
+#include "sptxx/state_pool.hpp"
 #include "sptxx/usertype.hpp"
 #include "sptxx/stack.hpp"
 #include "sptxx/error.hpp"
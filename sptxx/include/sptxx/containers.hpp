@@ -1,6 +1,7 @@
 // containers.hpp - STL 容器与 Lua table/array 的双向转换
 // - std::vector<T>      ↔ SPT LUA_TARRAY（0-based 数组）
 // - std::array<T, N>    → LUA_TARRAY（仅 push；get 需显式 N）
+// - std::span<T>        → LUA_TARRAY（仅 push，C++20）
 // - std::map<K,V>       ↔ 普通 Lua table（hash）
 // - std::unordered_map  ↔ 普通 Lua table
 //
@@ -8,6 +9,9 @@
 //   lua.set_function("sum_vec", [](std::vector<int> v) { ... });
 //   lua["data"] = std::vector<int>{1,2,3};
 //   auto m = lua["cfg"].get<std::map<std::string,int>>();
+//
+// 算术元素（整数/浮点/bool）的 List 走 VM 批量接口 lua_arraywrite / lua_arrayread，
+// 一次调用整段搬运，不经栈；元素类型不一致时 get 回退为逐元素转换（语义不变）。
 
 #pragma once
 
@@ -18,11 +22,19 @@ extern "C" {
 
 #include "stack.hpp"
 #include <array>
+#include <cstddef>
 #include <map>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#if __has_include(<span>) &&                                                                     \
+    (__cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L))
+#include <span>
+#define SPTXX_HAS_SPAN 1
+#endif
+
 namespace sptxx {
 
 namespace detail {
@@ -31,6 +43,88 @@ inline bool is_table_or_array(lua_State *L, int index) {
   int t = lua_type(L, index);
   return t == LUA_TTABLE || t == LUA_TARRAY;
 }
+
+// ---- 算术元素的批量传输 ----
+
+template <typename T> inline constexpr bool is_bulk_v = std::is_arithmetic_v<T>;
+
+// T 与某个 LUA_BULK_* 的缓冲布局一致时返回该种类（整段直传），否则 -1（经暂存缓冲转换）。
+template <typename T> constexpr int bulk_direct_kind() {
+  if constexpr (std::is_same_v<T, bool>)
+    return sizeof(bool) == 1 ? LUA_BULK_BOOLEAN : -1;
+  else if constexpr (std::is_same_v<T, lua_Number>)
+    return LUA_BULK_NUMBER;
+  else if constexpr (std::is_same_v<T, float>)
+    return LUA_BULK_FLOAT;
+  else if constexpr (std::is_integral_v<T> && std::is_signed_v<T> &&
+                     sizeof(T) == sizeof(lua_Integer))
+    return LUA_BULK_INTEGER;
+  else if constexpr (std::is_integral_v<T> && std::is_signed_v<T> && sizeof(T) == sizeof(int))
+    return LUA_BULK_INT;
+  else
+    return -1;
+}
+
+// 暂存缓冲的元素类型与种类：bool → unsigned char，浮点 → lua_Number，其余整型 → lua_Integer。
+template <typename T>
+using bulk_stage_t =
+    std::conditional_t<std::is_same_v<T, bool>, unsigned char,
+                       std::conditional_t<std::is_floating_point_v<T>, lua_Number, lua_Integer>>;
+
+template <typename T> constexpr int bulk_stage_kind() {
+  if constexpr (std::is_same_v<T, bool>)
+    return LUA_BULK_BOOLEAN;
+  else if constexpr (std::is_floating_point_v<T>)
+    return LUA_BULK_NUMBER;
+  else
+    return LUA_BULK_INTEGER;
+}
+
+constexpr std::size_t bulk_chunk = 256;
+
+// 把 [first, first + n) 写入栈顶数组的 [0, n)，每 bulk_chunk 个元素一次 lua_arraywrite。
+template <typename T, typename It> void bulk_write_staged(lua_State *L, It first, std::size_t n) {
+  bulk_stage_t<T> buf[bulk_chunk];
+  for (std::size_t done = 0; done < n;) {
+    std::size_t k = n - done < bulk_chunk ? n - done : bulk_chunk;
+    for (std::size_t i = 0; i < k; ++i, ++first)
+      buf[i] = static_cast<bulk_stage_t<T>>(*first);
+    lua_arraywrite(L, -1, static_cast<lua_Integer>(done), bulk_stage_kind<T>(), buf,
+                   static_cast<lua_Integer>(k));
+    done += k;
+  }
+}
+
+template <typename T> void bulk_write(lua_State *L, const T *p, std::size_t n) {
+  if constexpr (bulk_direct_kind<T>() >= 0)
+    lua_arraywrite(L, -1, 0, bulk_direct_kind<T>(), p, static_cast<lua_Integer>(n));
+  else
+    bulk_write_staged<T>(L, p, n);
+}
+
+// 读数组 index 的 [0, n) 到 out；任一元素类型不符返回 false（out 内容未定义）。
+template <typename T, typename Out>
+bool bulk_read_staged(lua_State *L, int index, std::size_t n, Out out) {
+  bulk_stage_t<T> buf[bulk_chunk];
+  for (std::size_t done = 0; done < n;) {
+    std::size_t k = n - done < bulk_chunk ? n - done : bulk_chunk;
+    if (!lua_arrayread(L, index, static_cast<lua_Integer>(done), bulk_stage_kind<T>(), buf,
+                       static_cast<lua_Integer>(k)))
+      return false;
+    for (std::size_t i = 0; i < k; ++i, ++out)
+      *out = static_cast<T>(buf[i]);
+    done += k;
+  }
+  return true;
+}
+
+template <typename T> bool bulk_read(lua_State *L, int index, T *out, std::size_t n) {
+  if constexpr (bulk_direct_kind<T>() >= 0)
+    return lua_arrayread(L, index, 0, bulk_direct_kind<T>(), out, static_cast<lua_Integer>(n)) !=
+           0;
+  else
+    return bulk_read_staged<T>(L, index, n, out);
+}
 } // namespace detail
 
 // ---- std::vector<T> ----
@@ -38,6 +132,14 @@ inline bool is_table_or_array(lua_State *L, int index) {
 template <typename T> struct pusher<std::vector<T>> {
   static void push(lua_State *L, const std::vector<T> &v) {
     lua_createarray(L, static_cast<int>(v.size()));
+    if constexpr (detail::is_bulk_v<T>) {
+      // std::vector<bool> 没有连续存储，经暂存缓冲
+      if constexpr (std::is_same_v<T, bool>)
+        detail::bulk_write_staged<T>(L, v.begin(), v.size());
+      else
+        detail::bulk_write(L, v.data(), v.size());
+      return;
+    }
     if (!v.empty())
       lua_arraysetlen(L, -1, static_cast<lua_Integer>(v.size()));
     for (std::size_t i = 0; i < v.size(); ++i) {
@@ -61,8 +163,21 @@ template <typename T> struct getter<std::vector<T>> {
       len = lua_tointeger(L, -1);
       lua_pop(L, 1);
     }
-    result.reserve(static_cast<std::size_t>(len > 0 ? len : 0));
     int t = lua_absindex(L, index);
+    if constexpr (detail::is_bulk_v<T>) {
+      if (lua_gettablemode(L, t) == 1 && len > 0) {
+        result.resize(static_cast<std::size_t>(len));
+        bool ok;
+        if constexpr (std::is_same_v<T, bool>)
+          ok = detail::bulk_read_staged<T>(L, t, result.size(), result.begin());
+        else
+          ok = detail::bulk_read(L, t, result.data(), result.size());
+        if (ok)
+          return result;
+        result.clear(); // 含非数值元素：逐元素转换以给出原有的错误信息
+      }
+    }
+    result.reserve(static_cast<std::size_t>(len > 0 ? len : 0));
     for (lua_Integer i = 0; i < len; ++i) {
       lua_geti(L, t, i);
       result.push_back(stack::get<T>(L, -1));
@@ -77,6 +192,10 @@ template <typename T> struct getter<std::vector<T>> {
 template <typename T, std::size_t N> struct pusher<std::array<T, N>> {
   static void push(lua_State *L, const std::array<T, N> &a) {
     lua_createarray(L, static_cast<int>(N));
+    if constexpr (detail::is_bulk_v<T>) {
+      detail::bulk_write(L, a.data(), N);
+      return;
+    }
     if (N > 0)
       lua_arraysetlen(L, -1, static_cast<lua_Integer>(N));
     for (std::size_t i = 0; i < N; ++i) {
@@ -92,6 +211,11 @@ template <typename T, std::size_t N> struct getter<std::array<T, N>> {
       luaL_error(L, "expected array/table for std::array conversion");
     std::array<T, N> result{};
     int t = lua_absindex(L, index);
+    if constexpr (detail::is_bulk_v<T>) {
+      if (lua_gettablemode(L, t) == 1 && static_cast<std::size_t>(lua_arraylen(L, t)) >= N &&
+          detail::bulk_read(L, t, result.data(), N))
+        return result;
+    }
     for (std::size_t i = 0; i < N; ++i) {
       lua_geti(L, t, static_cast<lua_Integer>(i));
       result[i] = stack::get<T>(L, -1);
@@ -101,6 +225,25 @@ template <typename T, std::size_t N> struct getter<std::array<T, N>> {
   }
 };
 
+#ifdef SPTXX_HAS_SPAN
+// ---- std::span<T, E>（仅 push：拷贝到新 List）----
+
+template <typename T, std::size_t E> struct pusher<std::span<T, E>> {
+  static void push(lua_State *L, std::span<T, E> s) {
+    using V = std::remove_cv_t<T>;
+    lua_createarray(L, static_cast<int>(s.size()));
+    if constexpr (detail::is_bulk_v<V>) {
+      detail::bulk_write<V>(L, s.data(), s.size());
+    } else {
+      for (std::size_t i = 0; i < s.size(); ++i) {
+        stack::push(L, s[i]);
+        lua_seti(L, -2, static_cast<lua_Integer>(i));
+      }
+    }
+  }
+};
+#endif
+
 // ---- std::map<K, V> ----
 
 template <typename K, typename V> struct pusher<std::map<K, V>> {
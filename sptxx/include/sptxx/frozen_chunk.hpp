@@ -0,0 +1,106 @@
+// frozen_chunk.hpp - 跨状态共享的已编译代码块（spt_frozen.h 的 RAII 包装）
+// - frozen_chunk::compile(code)：在临时状态中编译一次，结果不依赖任何状态。
+// - push(L) / state::do_frozen(chunk)：载入某个状态。字节码、行号信息与长字符串常量留在共享块中，
+//   各状态只建自己的原型与短字符串，不重新解析、生成代码。
+// 共享块原子引用计数：句柄的拷贝共享同一块，载入过它的状态各持一份引用直到 lua_close，
+// 因此句柄可先于状态销毁，也可在多个线程中同时载入。
+
+#pragma once
+
+extern "C" {
+#include <lua.h>
+#include <lauxlib.h>
+#include <spt_frozen.h>
+}
+
+#include "error.hpp"
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace sptxx {
+
+class frozen_chunk {
+public:
+  frozen_chunk() = default;
+
+  // 接管一份 spt_freeze 返回的引用。
+  explicit frozen_chunk(SPTFrozen *f) : f_(f) {}
+
+  // 编译 code 并冻结；strip 为 true 时去掉调试信息（行号、局部变量名）。
+  static frozen_chunk compile(std::string_view code, const char *chunkname = "=frozen",
+                              bool strip = false) {
+    lua_State *L = luaL_newstate();
+    if (!L)
+      throw error("frozen_chunk: failed to create Lua state");
+    if (luaL_loadbuffer(L, code.data(), code.size(), chunkname) != LUA_OK) {
+      const char *msg = lua_tostring(L, -1);
+      std::string err = msg ? msg : "unknown Lua error";
+      lua_close(L);
+      throw runtime_error(std::move(err));
+    }
+    SPTFrozen *f = spt_freeze(L, -1, strip);
+    lua_close(L);
+    if (!f)
+      throw error("frozen_chunk: not enough memory");
+    return frozen_chunk(f);
+  }
+
+  // 冻结 L 上 index 处的 Lua 函数（通常是 lua_load 得到的主块）。
+  static frozen_chunk from_stack(lua_State *L, int index, bool strip = false) {
+    if (!lua_isfunction(L, index) || lua_iscfunction(L, index))
+      throw type_error("frozen_chunk: value is not a Lua function");
+    SPTFrozen *f = spt_freeze(L, index, strip);
+    if (!f)
+      throw error("frozen_chunk: not enough memory");
+    return frozen_chunk(f);
+  }
+
+  frozen_chunk(const frozen_chunk &other) : f_(other.f_) {
+    if (f_)
+      spt_frozen_retain(f_);
+  }
+
+  frozen_chunk &operator=(const frozen_chunk &other) {
+    if (this != &other) {
+      if (other.f_)
+        spt_frozen_retain(other.f_);
+      spt_frozen_release(f_);
+      f_ = other.f_;
+    }
+    return *this;
+  }
+
+  frozen_chunk(frozen_chunk &&other) noexcept : f_(std::exchange(other.f_, nullptr)) {}
+
+  frozen_chunk &operator=(frozen_chunk &&other) noexcept {
+    if (this != &other) {
+      spt_frozen_release(f_);
+      f_ = std::exchange(other.f_, nullptr);
+    }
+    return *this;
+  }
+
+  ~frozen_chunk() { spt_frozen_release(f_); }
+
+  bool valid() const { return f_ != nullptr; }
+  explicit operator bool() const { return valid(); }
+
+  SPTFrozen *get() const { return f_; }
+
+  // 共享块的字节数（不计入任何状态的内存）。
+  std::size_t size() const { return f_ ? spt_frozen_size(f_) : 0; }
+
+  // 在 L 栈顶压入该块的新闭包（与 lua_load 相同：第一个 upvalue 为全局表）。
+  void push(lua_State *L) const {
+    if (!f_)
+      throw error("invalid frozen_chunk");
+    detail::handle_lua_error(L, spt_frozen_push(L, f_));
+  }
+
+private:
+  SPTFrozen *f_ = nullptr;
+};
+
+} // namespace sptxx
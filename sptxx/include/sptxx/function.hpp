@@ -1,6 +1,7 @@
 // function.hpp - 函数绑定与 Lua 函数引用
-// - push_function_wrapper: 把任意可调用对象包装成 userdata + cclosure，
-//   每次 set_function 都独立存储（无 static 共享 bug）。
+// - push_function_wrapper: 把可调用对象包装成 Lua C 函数。fn<&f> 与可默认构造的空 functor
+//   直接成为无 upvalue 的 lua_CFunction；其余 functor 存入 userdata 作 upvalue，每次
+//   set_function 独立存储（无 static 共享 bug），需析构时挂每类型共享的 __gc metatable。
 // - function_ref<R(Args...)>: 持有 Lua 函数的 registry 引用，可被 C++ 调用。
 //
 // SPT Slot 0 约定：普通函数调用 a(args...) 时，index 1 是 receiver（nil），
@@ -17,13 +18,24 @@ extern "C" {
 #include "error.hpp"
 #include "stack.hpp"
 #include "variadic.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <functional>
+#include <string>
+#include <string_view>
 #include <tuple>
 #include <type_traits>
 #include <utility>
 
 namespace sptxx {
 
+// fn<&f>：函数指针作为模板参数绑定，压入时是无 upvalue 的 lua_CFunction，调用不读 upvalue。
+//   lua.set_function("add", sptxx::fn<&add>{});
+template <auto F> struct fn {
+  static constexpr auto value = F;
+};
+
 namespace detail {
 
 // ---- 参数提取 ----
@@ -73,6 +85,9 @@ template <typename R, typename... Args> struct function_traits<R(Args...)> {
 template <typename R, typename... Args>
 struct function_traits<R (*)(Args...)> : function_traits<R(Args...)> {};
 
+template <typename R, typename... Args>
+struct function_traits<R (*)(Args...) noexcept> : function_traits<R(Args...)> {};
+
 template <typename R, typename C, typename... Args>
 struct function_traits<R (C::*)(Args...)> : function_traits<R(Args...)> {};
 
@@ -90,6 +105,8 @@ struct function_traits : function_traits<decltype(&T::operator())> {};
 
 template <typename T> struct function_traits<std::function<T>> : function_traits<T> {};
 
+template <auto F> struct function_traits<fn<F>> : function_traits<decltype(F)> {};
+
 template <typename T> using function_traits_t = function_traits<std::decay_t<T>>;
 
 // ---- 调用器 ----
@@ -122,62 +139,234 @@ struct function_caller<std::tuple<Rs...>, Func, std::tuple<Args...>> {
   }
 };
 
-// ---- 重载：参数类型预检查（避免 luaL_check* 直接 lua_error 无法 try/catch）----
+// ---- 重载决议 ----
+// 每次调用先把实参（跳过 Slot 0）逐个归类成 arg_kind，打包为签名；各候选每个形参可接受的
+// 类别在编译期展开为两个位掩码：精确匹配与需转换的匹配。按声明顺序取第一个全部精确匹配的
+// 候选，没有则取第一个可转换匹配的候选，再经编译期生成的函数指针表调用。决议不分配内存，
+// 只在两种情况下再问 VM：字符串实参对浮点形参（能否转成数），userdata 实参对已注册为
+// usertype 的类类型形参（与缓存的 metatable 指针比较）。
+
+enum arg_kind : unsigned {
+  kind_nil,
+  kind_bool,
+  kind_int,
+  kind_float,
+  kind_string,
+  kind_userdata,
+  kind_other // table / function / thread / array / lightuserdata
+};
 
-template <typename T> inline bool check_arg(lua_State *L, int index) {
-  using DT = std::decay_t<T>;
-  if constexpr (std::is_same_v<DT, bool>) {
-    return lua_isboolean(L, index) != 0;
-  } else if constexpr (std::is_integral_v<DT>) {
-    return lua_isinteger(L, index) != 0;
-  } else if constexpr (std::is_floating_point_v<DT>) {
-    return lua_isnumber(L, index) != 0;
-  } else if constexpr (std::is_same_v<DT, std::string> ||
-                      std::is_same_v<DT, const char *> ||
-                      std::is_same_v<DT, std::string_view>) {
-    return lua_isstring(L, index) != 0;
-  } else {
-    (void)L;
-    (void)index;
-    return true; // 未知/自定义类型放宽，交给 getter 报错
+inline unsigned classify_arg(lua_State *L, int index) {
+  switch (lua_type(L, index)) {
+  case LUA_TNIL:
+    return kind_nil;
+  case LUA_TBOOLEAN:
+    return kind_bool;
+  case LUA_TNUMBER:
+    return lua_isinteger(L, index) ? kind_int : kind_float;
+  case LUA_TSTRING:
+    return kind_string;
+  case LUA_TUSERDATA:
+    return kind_userdata;
+  default:
+    return kind_other;
   }
 }
 
-template <typename ArgsTuple, std::size_t... Is>
-inline bool check_args_impl(lua_State *L, int start, std::index_sequence<Is...>) {
-  return (check_arg<std::tuple_element_t<Is, ArgsTuple>>(
-              L, start + static_cast<int>(Is)) &&
-          ...);
+// 实参签名：个数与前 packed_max 个实参的类别（每个 4 位），其后的按需归类。
+struct arg_signature {
+  static constexpr int packed_max = 16;
+
+  lua_State *L;
+  int count;
+  std::uint64_t packed = 0;
+
+  explicit arg_signature(lua_State *L) : L(L), count(lua_gettop(L) - 1) {
+    int n = count < packed_max ? count : packed_max;
+    for (int i = 0; i < n; ++i)
+      packed |= static_cast<std::uint64_t>(classify_arg(L, 2 + i)) << (4 * i);
+  }
+
+  unsigned kind(int i) const {
+    return i < packed_max ? static_cast<unsigned>(packed >> (4 * i)) & 0xf
+                          : classify_arg(L, 2 + i);
+  }
+};
+
+// 每个类型一对 registry 键，usertype 注册时存入 owned / unowned metatable。
+template <typename T> struct usertype_key {
+  static inline const char owned = 0;
+  static inline const char unowned = 0;
+};
+
+// 类类型形参对应 usertype 的 metatable 指针，首次遇到 userdata 实参时取得并缓存。
+// 拷贝（克隆状态时的 __clone）得到空缓存，在新状态中重新取得。
+struct usertype_ref {
+  const void *owned = nullptr;
+  const void *unowned = nullptr;
+
+  usertype_ref() = default;
+  usertype_ref(const usertype_ref &) {}
+  usertype_ref &operator=(const usertype_ref &) {
+    owned = unowned = nullptr;
+    return *this;
+  }
+};
+
+enum match_quality : unsigned { match_none, match_convert, match_exact };
+
+// index 处的 userdata 是否为 C（或其派生类）的 usertype 对象。C 未注册时放宽为可转换，
+// 交给 getter；派生类对象沿 __base 链按名比较，算作转换。
+template <typename C> unsigned match_usertype(lua_State *L, int index, usertype_ref &ref) {
+  if (!ref.owned) {
+    if (lua_rawgetp(L, LUA_REGISTRYINDEX, &usertype_key<C>::owned) != LUA_TTABLE) {
+      lua_pop(L, 1);
+      return match_convert;
+    }
+    lua_rawgetp(L, LUA_REGISTRYINDEX, &usertype_key<C>::unowned);
+    ref.owned = lua_topointer(L, -2);
+    ref.unowned = lua_topointer(L, -1);
+    lua_pop(L, 2);
+  }
+  if (!lua_getmetatable(L, index))
+    return match_none;
+  const void *mt = lua_topointer(L, -1);
+  if (mt == ref.owned || mt == ref.unowned) {
+    lua_pop(L, 1);
+    return match_exact;
+  }
+  int top = lua_gettop(L) - 1;
+  unsigned q = match_none;
+  for (int depth = 0; depth < 64; ++depth) {
+    if (lua_getfield(L, -1, "__base") != LUA_TSTRING ||
+        luaL_getmetatable(L, lua_tostring(L, -1)) != LUA_TTABLE)
+      break;
+    if (lua_topointer(L, -1) == ref.owned) {
+      q = match_convert;
+      break;
+    }
+  }
+  lua_settop(L, top);
+  return q;
 }
 
-// 检查 Lua 栈（跳过 Slot 0 receiver）参数是否匹配 ArgsTuple。
-// 若最后一个参数为 variadic_args，则按"至少 N-1 个固定参数"校验，
-// 且只对固定参数做类型检查。
-template <typename ArgsTuple> inline bool check_args(lua_State *L) {
-  int available = lua_gettop(L) - 1; // 跳 Slot 0
-  constexpr std::size_t size = std::tuple_size_v<ArgsTuple>;
-  if constexpr (size > 0) {
-    using LastT = std::decay_t<std::tuple_element_t<size - 1, ArgsTuple>>;
-    if constexpr (std::is_same_v<LastT, variadic_args>) {
-      if (available < static_cast<int>(size) - 1)
-        return false;
-      return check_args_impl<ArgsTuple>(
-          L, 2, std::make_index_sequence<size - 1>{});
-    } else {
-      if (available != static_cast<int>(size))
-        return false;
-      return check_args_impl<ArgsTuple>(
-          L, 2, std::make_index_sequence<size>{});
+// 形参类型 T 在各实参类别下的匹配程度。
+template <typename T> struct param_traits {
+  using DT = std::decay_t<T>;
+  using object_type = std::remove_cv_t<std::remove_pointer_t<DT>>;
+
+  static constexpr bool is_string = std::is_same_v<DT, std::string> ||
+                                    std::is_same_v<DT, const char *> ||
+                                    std::is_same_v<DT, std::string_view>;
+  // 可能是 usertype 的类类型（值、引用或指针）：userdata 实参要核对 metatable
+  static constexpr bool is_object = !is_string && std::is_class_v<object_type>;
+
+  static constexpr unsigned bit(unsigned k) { return 1u << k; }
+
+  static constexpr unsigned exact_mask() {
+    if constexpr (std::is_same_v<DT, bool>)
+      return bit(kind_bool);
+    else if constexpr (std::is_integral_v<DT>)
+      return bit(kind_int);
+    else if constexpr (std::is_floating_point_v<DT>)
+      return bit(kind_float);
+    else if constexpr (is_string)
+      return bit(kind_string);
+    else
+      return 0;
+  }
+
+  static constexpr unsigned convert_mask() {
+    if constexpr (std::is_same_v<DT, bool> || std::is_integral_v<DT>)
+      return 0;
+    else if constexpr (std::is_floating_point_v<DT>)
+      return bit(kind_int); // 字符串另行检查
+    else if constexpr (is_string)
+      return bit(kind_int) | bit(kind_float);
+    else
+      return ~0u; // 未知/自定义类型放宽，交给 getter 报错
+  }
+
+  static constexpr unsigned exact = exact_mask();
+  static constexpr unsigned convert = convert_mask();
+
+  static unsigned match(const arg_signature &sig, int i, usertype_ref &ref) {
+    unsigned k = sig.kind(i);
+    if (exact & bit(k))
+      return match_exact;
+    if constexpr (std::is_floating_point_v<DT>) {
+      if (k == kind_string)
+        return lua_isnumber(sig.L, 2 + i) ? match_convert : match_none;
     }
-  } else {
-    return available == 0;
+    if constexpr (is_object) {
+      if (k == kind_userdata)
+        return match_usertype<object_type>(sig.L, 2 + i, ref);
+    }
+    (void)ref;
+    return convert & bit(k) ? match_convert : match_none;
+  }
+};
+
+// 一个候选（形参元组）。末尾为 variadic_args 时要求至少有全部固定参数，且至多算作转换，
+// 使个数恰好匹配的候选优先。
+template <typename ArgsTuple> struct overload_candidate {
+  static constexpr std::size_t size = std::tuple_size_v<ArgsTuple>;
+  static constexpr bool variadic = [] {
+    if constexpr (size > 0)
+      return std::is_same_v<std::decay_t<std::tuple_element_t<size - 1, ArgsTuple>>,
+                            variadic_args>;
+    else
+      return false;
+  }();
+  static constexpr std::size_t fixed = variadic ? size - 1 : size;
+
+  using refs_type = std::array<usertype_ref, fixed>;
+
+  static unsigned match(const arg_signature &sig, refs_type &refs) {
+    if (variadic ? sig.count < static_cast<int>(fixed) : sig.count != static_cast<int>(fixed))
+      return match_none;
+    return match_params(sig, refs, std::make_index_sequence<fixed>{});
   }
+
+  template <std::size_t... Is>
+  static unsigned match_params(const arg_signature &sig, refs_type &refs,
+                               std::index_sequence<Is...>) {
+    unsigned q = variadic ? match_convert : match_exact;
+    ((q = q == match_none
+              ? q
+              : std::min(q, param_traits<std::tuple_element_t<Is, ArgsTuple>>::match(
+                                sig, static_cast<int>(Is), refs[Is]))),
+     ...);
+    (void)sig;
+    (void)refs;
+    return q;
+  }
+};
+
+// 在候选中选一个：第一个精确匹配，否则第一个可转换匹配；都没有时返回候选个数。
+template <typename... Candidates, typename Refs, std::size_t... Is>
+std::size_t resolve_overload(const arg_signature &sig, Refs &refs, std::index_sequence<Is...>) {
+  constexpr std::size_t none = sizeof...(Candidates);
+  std::size_t exact = none, convert = none;
+  auto consider = [&](std::size_t i, unsigned q) {
+    if (q == match_exact)
+      exact = i;
+    else if (q == match_convert && convert == none)
+      convert = i;
+  };
+  ((exact == none ? consider(Is, Candidates::match(sig, std::get<Is>(refs))) : void()), ...);
+  return exact != none ? exact : convert;
 }
 
 // ---- overload_set：持有多个可调用对象，按参数分派 ----
 
 template <typename... Funcs> struct overload_set {
+  using candidates = std::tuple<
+      overload_candidate<typename function_traits<Funcs>::args_tuple>...>;
+
   std::tuple<Funcs...> funcs;
+  std::tuple<typename overload_candidate<typename function_traits<Funcs>::args_tuple>::refs_type...>
+      refs;
 
   template <typename... Args>
   overload_set(Args &&...args) : funcs(std::forward<Args>(args)...) {}
@@ -186,24 +375,21 @@ template <typename... Funcs> struct overload_set {
     return dispatch_impl(L, std::index_sequence_for<Funcs...>{});
   }
 
-  template <std::size_t... Is> int dispatch_impl(lua_State *L, std::index_sequence<Is...>) {
-    int result = -1;
-    bool done = false;
-    ((!done && ((result = try_one<Is>(L)) >= 0) ? (done = true, true) : false), ...);
-    if (result < 0)
+  template <std::size_t... Is> int dispatch_impl(lua_State *L, std::index_sequence<Is...> seq) {
+    using invoker = int (*)(overload_set &, lua_State *);
+    static constexpr invoker table[] = {&overload_set::call_one<Is>...};
+    std::size_t i = resolve_overload<std::tuple_element_t<Is, candidates>...>(
+        arg_signature(L), refs, seq);
+    if (i == sizeof...(Funcs))
       throw error("no matching overload for given arguments");
-    return result;
+    return table[i](*this, L);
   }
 
-  template <std::size_t I> int try_one(lua_State *L) {
+  template <std::size_t I> static int call_one(overload_set &self, lua_State *L) {
     using FuncType = std::tuple_element_t<I, std::tuple<Funcs...>>;
     using Traits = function_traits<FuncType>;
-    using ReturnType = typename Traits::return_type;
-    using ArgsTuple = typename Traits::args_tuple;
-    if (!check_args<ArgsTuple>(L))
-      return -1;
-    auto &func = std::get<I>(funcs);
-    return function_caller<ReturnType, FuncType, ArgsTuple>::call(L, func);
+    return function_caller<typename Traits::return_type, FuncType,
+                           typename Traits::args_tuple>::call(L, std::get<I>(self.funcs));
   }
 };
 
@@ -221,26 +407,67 @@ struct is_function_like<R (*)(Args...)> : std::true_type {};
 template <typename T>
 struct is_function_like<
     T, std::void_t<decltype(&std::decay_t<T>::operator())>> : std::true_type {};
+template <auto F> struct is_function_like<fn<F>> : std::true_type {};
+
+template <typename T> struct is_static_fn : std::false_type {};
+template <auto F> struct is_static_fn<fn<F>> : std::true_type {};
 template <typename T>
 inline constexpr bool is_function_like_v = is_function_like<std::decay_t<T>>::value;
 
-// ---- overload_set 的栈包装（类似 push_function_wrapper）----
+// ---- userdata 中的 C++ 对象 ----
 
-template <typename... Funcs>
-void push_overload_wrapper(lua_State *L, overload_set<Funcs...> &&os) {
-  using OSType = overload_set<Funcs...>;
-  void *storage = lua_newuserdatauv(L, sizeof(OSType), 0);
-  new (storage) OSType(std::move(os));
+// 每个类型一个 registry 键（取其地址作 lightuserdata）。
+template <typename T> struct type_key {
+  static inline const char id = 0;
+};
 
-  lua_createtable(L, 0, 1);
+// 压入析构 T 的 __gc metatable：每个 lua_State 每个 T 只建一次，缓存在 registry。
+// __clone 供 spt_clonestate 使用：在克隆的块内拷贝构造 T（index 2 为新块，index 3 为模板块）。
+template <typename T> void push_gc_metatable(lua_State *L) {
+  if (lua_rawgetp(L, LUA_REGISTRYINDEX, &type_key<T>::id) == LUA_TTABLE)
+    return;
+  lua_pop(L, 1);
+  lua_createtable(L, 0, 2);
   lua_pushcfunction(L, [](lua_State *L) -> int {
-    OSType *self = static_cast<OSType *>(lua_touserdata(L, 1));
-    self->~OSType();
+    static_cast<T *>(lua_touserdata(L, 1))->~T();
     return 0;
   });
   lua_setfield(L, -2, "__gc");
-  lua_setmetatable(L, -2);
+  lua_pushcfunction(L, [](lua_State *L) -> int {
+    if constexpr (std::is_copy_constructible_v<T>) {
+      try {
+        new (lua_touserdata(L, 2)) T(*static_cast<const T *>(lua_touserdata(L, 3)));
+        return 0;
+      } catch (...) {
+        return propagate_exception(L);
+      }
+    } else {
+      return luaL_error(L, "cannot clone a non-copyable C++ callable");
+    }
+  });
+  lua_setfield(L, -2, "__clone");
+  lua_pushvalue(L, -1);
+  lua_rawsetp(L, LUA_REGISTRYINDEX, &type_key<T>::id);
+}
+
+// 新建 userdata 并在其中构造 T；T 需析构或不能按位拷贝（克隆状态时要走 __clone）时才挂
+// __gc metatable（构造成功之后）。
+template <typename T, typename U> T *push_userdata_object(lua_State *L, U &&value) {
+  void *storage = lua_newuserdatauv(L, sizeof(T), 0);
+  T *obj = new (storage) T(std::forward<U>(value));
+  if constexpr (!std::is_trivially_destructible_v<T> || !std::is_trivially_copyable_v<T>) {
+    push_gc_metatable<T>(L);
+    lua_setmetatable(L, -2);
+  }
+  return obj;
+}
 
+// ---- overload_set 的栈包装（类似 push_function_wrapper）----
+
+template <typename... Funcs>
+void push_overload_wrapper(lua_State *L, overload_set<Funcs...> &&os) {
+  using OSType = overload_set<Funcs...>;
+  push_userdata_object<OSType>(L, std::move(os));
   lua_pushcclosure(
       L,
       [](lua_State *L) -> int {
@@ -254,45 +481,46 @@ void push_overload_wrapper(lua_State *L, overload_set<Funcs...> &&os) {
       1);
 }
 
-// ---- 函数包装器：userdata + __gc + cclosure ----
-// 每次调用都创建独立的 userdata 存储 functor，避免 static 共享 bug。
+// ---- 函数包装器 ----
+
+template <typename Func> inline int call_guarded(lua_State *L, Func &f) {
+  using Traits = function_traits<Func>;
+  try {
+    return function_caller<typename Traits::return_type, Func, typename Traits::args_tuple>::call(
+        L, f);
+  } catch (...) {
+    return propagate_exception(L);
+  }
+}
+
+template <auto F> int static_function_trampoline(lua_State *L) {
+  auto f = F;
+  return call_guarded(L, f);
+}
+
+// 无状态 functor：每次调用就地构造一个，无需存储。
+template <typename FuncType> int empty_functor_trampoline(lua_State *L) {
+  FuncType f{};
+  return call_guarded(L, f);
+}
+
+template <typename FuncType> int stored_functor_trampoline(lua_State *L) {
+  return call_guarded(L, *static_cast<FuncType *>(lua_touserdata(L, lua_upvalueindex(1))));
+}
 
 template <typename Func> void push_function_wrapper(lua_State *L, Func &&f) {
   using FuncType = std::decay_t<Func>;
   if constexpr (is_overload_set_v<FuncType>) {
     push_overload_wrapper(L, std::forward<Func>(f));
-    return;
+  } else if constexpr (is_static_fn<FuncType>::value) {
+    lua_pushcfunction(L, &static_function_trampoline<FuncType::value>);
+  } else if constexpr (std::is_class_v<FuncType> && std::is_empty_v<FuncType> &&
+                       std::is_default_constructible_v<FuncType> &&
+                       std::is_trivially_copyable_v<FuncType>) {
+    lua_pushcfunction(L, &empty_functor_trampoline<FuncType>);
   } else {
-    using Traits = function_traits<FuncType>;
-    using ReturnType = typename Traits::return_type;
-    using ArgsTuple = typename Traits::args_tuple;
-
-    // 1. 创建 userdata 存储 functor
-    void *storage = lua_newuserdatauv(L, sizeof(FuncType), 0);
-    new (storage) FuncType(std::forward<Func>(f));
-
-    // 2. 设置 metatable，仅含 __gc 析构 userdata
-    lua_createtable(L, 0, 1);
-    lua_pushcfunction(L, [](lua_State *L) -> int {
-      FuncType *self = static_cast<FuncType *>(lua_touserdata(L, 1));
-      self->~FuncType();
-      return 0;
-    });
-    lua_setfield(L, -2, "__gc");
-    lua_setmetatable(L, -2);
-
-    // 3. 创建 cclosure，userdata 作为 upvalue
-    lua_pushcclosure(
-        L,
-        [](lua_State *L) -> int {
-          FuncType *func = static_cast<FuncType *>(lua_touserdata(L, lua_upvalueindex(1)));
-          try {
-            return function_caller<ReturnType, FuncType, ArgsTuple>::call(L, *func);
-          } catch (...) {
-            return propagate_exception(L);
-          }
-        },
-        1);
+    push_userdata_object<FuncType>(L, std::forward<Func>(f));
+    lua_pushcclosure(L, &stored_functor_trampoline<FuncType>, 1);
   }
 }
 
@@ -1,6 +1,8 @@
 // list.hpp - SPT 数组（LUA_TARRAY）的 C++ 绑定
 // list<T> 持有强类型元素；list<void>（object_list）允许异构元素。
 // 通过 registry ref 持有 Lua 数组，析构时自动释放。
+// list_view<T> 是数值 List 的只读零拷贝视图，不持有引用。
+// pinned_list<T>（list<T>::pin()）把数组固定在栈上，循环内逐元素访问不再查 registry。
 
 #pragma once
 
@@ -18,6 +20,220 @@ extern "C" {
 
 namespace sptxx {
 
+// 数值 List 的只读零拷贝视图：直接读 VM 的数组存储（lua_arrayview），不经栈、不拷贝。
+// T 为整型时要求元素全为整数，为浮点型时要求全为浮点数。
+// 视图不持有引用：只在数组仍被引用且未被写入/扩容期间有效。
+// 典型用法是作为绑定函数的参数（调用期间实参一直在栈上）或经 list<T>::view() 取得。
+template <typename T> class list_view {
+  static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>,
+                "list_view<T> requires an integer or floating-point T");
+
+  using slot_type = std::conditional_t<std::is_floating_point_v<T>, lua_Number, lua_Integer>;
+
+public:
+  static constexpr int kind = std::is_floating_point_v<T> ? LUA_BULK_NUMBER : LUA_BULK_INTEGER;
+
+  list_view() = default;
+
+  // 打开栈上 index 处的 List；不是 List 或元素类型不符时返回 false。
+  static bool open(lua_State *L, int index, list_view &out) {
+    if (lua_gettablemode(L, index) != 1)
+      return false;
+    const void *data = nullptr;
+    std::ptrdiff_t stride = 0;
+    lua_Integer len = 0;
+    if (!lua_arrayview(L, index, kind, &data, &stride, &len))
+      return false;
+    out.data_ = static_cast<const char *>(data);
+    out.stride_ = stride;
+    out.size_ = static_cast<std::size_t>(len);
+    return true;
+  }
+
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  T operator[](std::size_t index) const {
+    return static_cast<T>(
+        *reinterpret_cast<const slot_type *>(data_ + static_cast<std::ptrdiff_t>(index) * stride_));
+  }
+
+  T at(std::size_t index) const {
+    if (index >= size_)
+      throw error("list_view index out of range");
+    return (*this)[index];
+  }
+
+  class iterator {
+  public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = T;
+    using pointer = const T *;
+    using reference = T;
+    using iterator_category = std::forward_iterator_tag;
+
+    iterator() : view_(nullptr), pos_(0) {}
+    iterator(const list_view *v, std::size_t p) : view_(v), pos_(p) {}
+
+    T operator*() const { return (*view_)[pos_]; }
+
+    iterator &operator++() {
+      ++pos_;
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator tmp = *this;
+      ++pos_;
+      return tmp;
+    }
+
+    bool operator==(const iterator &other) const {
+      return view_ == other.view_ && pos_ == other.pos_;
+    }
+    bool operator!=(const iterator &other) const { return !(*this == other); }
+
+  private:
+    const list_view *view_;
+    std::size_t pos_;
+  };
+
+  iterator begin() const { return iterator(this, 0); }
+  iterator end() const { return iterator(this, size_); }
+
+private:
+  const char *data_ = nullptr;
+  std::ptrdiff_t stride_ = 0;
+  std::size_t size_ = 0;
+};
+
+namespace detail {
+template <typename T>
+inline constexpr bool is_viewable_v = std::is_arithmetic_v<T> && !std::is_same_v<T, bool>;
+} // namespace detail
+
+// list<T> 的固定访问器（RAII，由 list<T>::pin() 取得）。
+// 构造时把数组压栈一次并缓存长度，之后按栈上绝对索引访问；析构时恢复构造前的栈顶。
+// T 为数值类型且元素类型一致时直接读 VM 存储（同 list_view），operator[] 即一次内存读取；
+// 否则每次访问一次 lua_geti。长度在 pin 期间固定（不提供增删），
+// pin 期间也不要运行可能改变该数组长度或元素类型的脚本。
+template <typename T> class pinned_list {
+public:
+  pinned_list(lua_State *L, int ref) : L_(L) {
+    lua_getref(L_, ref);
+    idx_ = lua_gettop(L_);
+    size_ = static_cast<std::size_t>(lua_arraylen(L_, idx_));
+    if constexpr (detail::is_viewable_v<T>)
+      fast_ = list_view<T>::open(L_, idx_, view_);
+  }
+
+  pinned_list(const pinned_list &) = delete;
+  pinned_list &operator=(const pinned_list &) = delete;
+
+  ~pinned_list() { lua_settop(L_, idx_ - 1); }
+
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // 不检查越界（同 std::vector::operator[]）；需要检查时用 at()。
+  T operator[](std::size_t index) const {
+    if constexpr (detail::is_viewable_v<T>) {
+      if (fast_)
+        return view_[index];
+    }
+    lua_geti(L_, idx_, static_cast<lua_Integer>(index));
+    T result = stack::get<T>(L_, -1);
+    lua_pop(L_, 1);
+    return result;
+  }
+
+  T at(std::size_t index) const {
+    if (index >= size_)
+      throw error("list index out of range");
+    return (*this)[index];
+  }
+
+  // 只改元素值；写入同类型的值不会使直接读取的存储失效。
+  void set(std::size_t index, const T &value) {
+    if (index >= size_)
+      throw error("list index out of range");
+    stack::push(L_, value);
+    lua_seti(L_, idx_, static_cast<lua_Integer>(index));
+  }
+
+  class iterator {
+  public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = T;
+    using pointer = const T *;
+    using reference = T;
+    using iterator_category = std::random_access_iterator_tag;
+
+    iterator() : pin_(nullptr), pos_(0) {}
+    iterator(const pinned_list *p, std::size_t pos) : pin_(p), pos_(pos) {}
+
+    T operator*() const { return (*pin_)[pos_]; }
+    T operator[](difference_type n) const { return (*pin_)[pos_ + n]; }
+
+    iterator &operator++() {
+      ++pos_;
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator tmp = *this;
+      ++pos_;
+      return tmp;
+    }
+    iterator &operator--() {
+      --pos_;
+      return *this;
+    }
+    iterator operator--(int) {
+      iterator tmp = *this;
+      --pos_;
+      return tmp;
+    }
+    iterator &operator+=(difference_type n) {
+      pos_ += n;
+      return *this;
+    }
+    iterator &operator-=(difference_type n) {
+      pos_ -= n;
+      return *this;
+    }
+    iterator operator+(difference_type n) const { return iterator(pin_, pos_ + n); }
+    iterator operator-(difference_type n) const { return iterator(pin_, pos_ - n); }
+    friend iterator operator+(difference_type n, const iterator &it) { return it + n; }
+    difference_type operator-(const iterator &other) const {
+      return static_cast<difference_type>(pos_) - static_cast<difference_type>(other.pos_);
+    }
+
+    bool operator==(const iterator &other) const {
+      return pin_ == other.pin_ && pos_ == other.pos_;
+    }
+    bool operator!=(const iterator &other) const { return !(*this == other); }
+    bool operator<(const iterator &other) const { return pos_ < other.pos_; }
+    bool operator>(const iterator &other) const { return pos_ > other.pos_; }
+    bool operator<=(const iterator &other) const { return pos_ <= other.pos_; }
+    bool operator>=(const iterator &other) const { return pos_ >= other.pos_; }
+
+  private:
+    const pinned_list *pin_;
+    std::size_t pos_;
+  };
+
+  iterator begin() const { return iterator(this, 0); }
+  iterator end() const { return iterator(this, size_); }
+
+private:
+  using view_type = std::conditional_t<detail::is_viewable_v<T>, list_view<T>, char>;
+
+  lua_State *L_;
+  int idx_ = 0;
+  std::size_t size_ = 0;
+  bool fast_ = false;
+  view_type view_{};
+};
+
 // 强类型数组包装。T 为元素类型。
 template <typename T = void> class list {
 public:
@@ -125,9 +341,8 @@ public:
 
   T get(std::size_t index) const {
     require_valid();
-    if (index >= size())
-      throw error("list index out of range");
     lua_getref(L_, ref_);
+    check_index(index);
     lua_geti(L_, -1, static_cast<lua_Integer>(index));
     T result = stack::get<T>(L_, -1);
     lua_pop(L_, 2);
@@ -136,9 +351,8 @@ public:
 
   void set(std::size_t index, const T &value) {
     require_valid();
-    if (index >= size())
-      throw error("list index out of range");
     lua_getref(L_, ref_);
+    check_index(index);
     stack::push(L_, value);
     lua_seti(L_, -2, static_cast<lua_Integer>(index));
     lua_pop(L_, 1);
@@ -146,9 +360,8 @@ public:
 
   void set(std::size_t index, T &&value) {
     require_valid();
-    if (index >= size())
-      throw error("list index out of range");
     lua_getref(L_, ref_);
+    check_index(index);
     stack::push(L_, std::move(value));
     lua_seti(L_, -2, static_cast<lua_Integer>(index));
     lua_pop(L_, 1);
@@ -156,19 +369,19 @@ public:
 
   void push_back(const T &value) {
     require_valid();
-    std::size_t n = size();
     lua_getref(L_, ref_);
+    lua_Integer n = lua_arraylen(L_, -1);
     stack::push(L_, value);
-    lua_seti(L_, -2, static_cast<lua_Integer>(n));
+    lua_seti(L_, -2, n);
     lua_pop(L_, 1);
   }
 
   void push_back(T &&value) {
     require_valid();
-    std::size_t n = size();
     lua_getref(L_, ref_);
+    lua_Integer n = lua_arraylen(L_, -1);
     stack::push(L_, std::move(value));
-    lua_seti(L_, -2, static_cast<lua_Integer>(n));
+    lua_seti(L_, -2, n);
     lua_pop(L_, 1);
   }
 
@@ -182,6 +395,24 @@ public:
     return result;
   }
 
+  // 固定访问器（见 pinned_list）：循环内逐元素读写只按栈索引访问，不再查 registry。
+  pinned_list<T> pin() const {
+    require_valid();
+    return pinned_list<T>(L_, ref_);
+  }
+
+  // 零拷贝只读视图（见 list_view）；在本 list 存活且数组未被写入/扩容期间有效。
+  list_view<T> view() const {
+    require_valid();
+    lua_getref(L_, ref_);
+    list_view<T> v;
+    bool ok = list_view<T>::open(L_, -1, v);
+    lua_pop(L_, 1);
+    if (!ok)
+      throw error("list elements do not all have the view's numeric type");
+    return v;
+  }
+
   // ---- 迭代器 ----
 
   class iterator {
@@ -227,6 +458,14 @@ private:
       throw error("invalid list");
   }
 
+  // 栈顶为本数组：越界时弹出并抛出。
+  void check_index(std::size_t index) const {
+    if (index >= static_cast<std::size_t>(lua_arraylen(L_, -1))) {
+      lua_pop(L_, 1);
+      throw error("list index out of range");
+    }
+  }
+
   void release() {
     if (valid())
       luaL_unref(L_, LUA_REGISTRYINDEX, ref_);
@@ -336,9 +575,8 @@ public:
   // 异构访问：调用方显式指定目标类型
   template <typename U> U get(std::size_t index) const {
     require_valid();
-    if (index >= size())
-      throw error("list index out of range");
     lua_getref(L_, ref_);
+    check_index(index);
     lua_geti(L_, -1, static_cast<lua_Integer>(index));
     U result = stack::get<U>(L_, -1);
     lua_pop(L_, 2);
@@ -347,9 +585,8 @@ public:
 
   template <typename U> void set(std::size_t index, const U &value) {
     require_valid();
-    if (index >= size())
-      throw error("list index out of range");
     lua_getref(L_, ref_);
+    check_index(index);
     stack::push(L_, value);
     lua_seti(L_, -2, static_cast<lua_Integer>(index));
     lua_pop(L_, 1);
@@ -357,10 +594,10 @@ public:
 
   template <typename U> void push_back(const U &value) {
     require_valid();
-    std::size_t n = size();
     lua_getref(L_, ref_);
+    lua_Integer n = lua_arraylen(L_, -1);
     stack::push(L_, value);
-    lua_seti(L_, -2, static_cast<lua_Integer>(n));
+    lua_seti(L_, -2, n);
     lua_pop(L_, 1);
   }
 
@@ -383,6 +620,14 @@ private:
       throw error("invalid list");
   }
 
+  // 栈顶为本数组：越界时弹出并抛出。
+  void check_index(std::size_t index) const {
+    if (index >= static_cast<std::size_t>(lua_arraylen(L_, -1))) {
+      lua_pop(L_, 1);
+      throw error("list index out of range");
+    }
+  }
+
   void release() {
     if (valid())
       luaL_unref(L_, LUA_REGISTRYINDEX, ref_);
@@ -402,6 +647,16 @@ template <typename T> struct getter<list<T>> {
   }
 };
 
+template <typename T> struct getter<list_view<T>> {
+  static list_view<T> get(lua_State *L, int index) {
+    list_view<T> v;
+    if (!list_view<T>::open(L, index, v))
+      luaL_error(L, "expected list of %s for list_view",
+                 std::is_floating_point_v<T> ? "floats" : "integers");
+    return v;
+  }
+};
+
 template <typename T> struct pusher<list<T>> {
   static void push(lua_State *L, const list<T> &value) {
     if (value.valid())
@@ -2,6 +2,7 @@
 // map<V> 持有强类型值；map<void>（object_map）允许异构值。
 // 通过 registry ref 持有 Lua 表，析构时自动释放。
 // 迭代器基于 lua_next；K 默认为 std::string，可显式指定 begin<int>() 等。
+// pinned_map<V>（map<V>::pin()）把表固定在栈上，查找与遍历不再经 registry。
 
 #pragma once
 
@@ -20,6 +21,137 @@ extern "C" {
 
 namespace sptxx {
 
+// map<V> 的固定访问器（RAII，由 map<V>::pin() 取得）。
+// 构造时把表压栈一次，查找与遍历都按栈上绝对索引进行；析构时恢复构造前的栈顶。
+// 遍历时当前键留在栈顶交给 lua_next，每步不再建立/释放 registry 引用；
+// 因此同一时刻只能有一个活动的遍历，循环体须保持栈平衡，遍历期间不要新增键。
+template <typename V> class pinned_map {
+public:
+  pinned_map(lua_State *L, int ref) : L_(L) {
+    lua_getref(L_, ref);
+    idx_ = lua_gettop(L_);
+  }
+
+  pinned_map(const pinned_map &) = delete;
+  pinned_map &operator=(const pinned_map &) = delete;
+
+  ~pinned_map() { lua_settop(L_, idx_ - 1); }
+
+  template <typename Key> V get(const Key &key) const {
+    stack::push(L_, key);
+    lua_gettable(L_, idx_);
+    if (lua_isnil(L_, -1)) {
+      lua_pop(L_, 1);
+      throw error("key not found in map");
+    }
+    V result = stack::get<V>(L_, -1);
+    lua_pop(L_, 1);
+    return result;
+  }
+
+  template <typename Key> std::optional<V> try_get(const Key &key) const {
+    stack::push(L_, key);
+    lua_gettable(L_, idx_);
+    if (lua_isnil(L_, -1)) {
+      lua_pop(L_, 1);
+      return std::nullopt;
+    }
+    V result = stack::get<V>(L_, -1);
+    lua_pop(L_, 1);
+    return result;
+  }
+
+  template <typename Key> bool contains(const Key &key) const {
+    stack::push(L_, key);
+    lua_gettable(L_, idx_);
+    bool exists = !lua_isnil(L_, -1);
+    lua_pop(L_, 1);
+    return exists;
+  }
+
+  // 改已有键的值在遍历中也是安全的。
+  template <typename Key> void set(const Key &key, const V &value) {
+    stack::push(L_, key);
+    stack::push(L_, value);
+    lua_settable(L_, idx_);
+  }
+
+  // 单遍输入迭代器（只可移动）。提前结束时析构负责弹出栈顶的键。
+  template <typename K = std::string> class iterator {
+  public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = std::pair<K, V>;
+    using pointer = const value_type *;
+    using reference = const value_type &;
+    using iterator_category = std::input_iterator_tag;
+
+    iterator() : L_(nullptr), idx_(0), at_end_(true) {}
+
+    iterator(lua_State *L, int idx) : L_(L), idx_(idx), at_end_(false) {
+      lua_pushnil(L_);
+      advance();
+    }
+
+    iterator(const iterator &) = delete;
+    iterator &operator=(const iterator &) = delete;
+
+    iterator(iterator &&other) noexcept
+        : L_(other.L_), idx_(other.idx_), at_end_(other.at_end_),
+          current_(std::move(other.current_)) {
+      other.at_end_ = true;
+    }
+
+    ~iterator() {
+      if (!at_end_)
+        lua_pop(L_, 1);
+    }
+
+    const value_type &operator*() const { return current_; }
+    const value_type *operator->() const { return &current_; }
+
+    iterator &operator++() {
+      advance();
+      return *this;
+    }
+
+    bool operator==(const iterator &other) const { return at_end_ && other.at_end_; }
+    bool operator!=(const iterator &other) const { return !(*this == other); }
+
+  private:
+    lua_State *L_;
+    int idx_;
+    bool at_end_;
+    value_type current_;
+
+    void advance() {
+      // 栈：[..., key]；lua_next 弹出 key，成功时压入 key, value
+      if (lua_next(L_, idx_) == 0) {
+        at_end_ = true;
+        return;
+      }
+      current_.second = stack::get<V>(L_, -1);
+      lua_pushvalue(L_, -2); // 在副本上转换，避免 lua_tolstring 改写 lua_next 的键
+      current_.first = stack::get<K>(L_, -1);
+      lua_pop(L_, 2); // 留下 key
+    }
+  };
+
+  template <typename K = std::string> iterator<K> begin() { return iterator<K>(L_, idx_); }
+  template <typename K = std::string> iterator<K> end() { return iterator<K>(); }
+
+  // 以其他键类型遍历：for (auto &kv : pinned.items<int>())
+  template <typename K> struct range {
+    pinned_map *m;
+    iterator<K> begin() { return m->template begin<K>(); }
+    iterator<K> end() { return iterator<K>(); }
+  };
+  template <typename K> range<K> items() { return range<K>{this}; }
+
+private:
+  lua_State *L_;
+  int idx_ = 0;
+};
+
 // 强类型 Map。V 为值类型；键类型由各方法模板参数显式指定。
 template <typename V = void> class map {
 public:
@@ -312,6 +444,12 @@ public:
   template <typename K = std::string> iterator<K> begin() { return iterator<K>(this, false); }
   template <typename K = std::string> iterator<K> end() { return iterator<K>(this, true); }
 
+  // 固定访问器（见 pinned_map）：查找与遍历不再经 registry。
+  pinned_map<V> pin() const {
+    require_valid();
+    return pinned_map<V>(L_, ref_);
+  }
+
 private:
   lua_State *L_;
   int ref_;
@@ -0,0 +1,374 @@
+// protected_function.hpp - 固定在专用 Lua 线程上的函数句柄（高频回调用）
+// - protected_function<R(Args...)>：构造时新建一个 Lua 线程（registry 引用锚定），其栈
+//   index 1 为错误处理函数（附 traceback），index 2 为被调函数。每次调用只在该线程栈顶压入
+//   函数副本、nil receiver 与参数后 lua_pcall，不查全局表、不读 registry。参数/返回值的转换
+//   由签名在编译期确定。
+// - call_each：对一个 C++ 区间逐元素调用（单参数签名），栈检查与基址只准备一次。
+// - stats()：调用次数与错误次数；enable_timing(true) 后另计总耗时与最大单次耗时（纳秒）。
+//
+// 调用可重入：被调函数经 C++ 再次调用同一句柄时线程正在运行，栈索引相对当前 C 帧，
+// 此时改为在栈顶压入错误处理函数并经 registry 引用取函数。句柄只可移动。
+//
+// 返回值转换在 lua_pcall 之外进行，getter 的 luaL_check* 报错会在固定线程上直接 panic。
+// 因此内建类型先按 getter 的接受规则核对类型，不符时抛 type_error；其它类型（usertype、
+// 用户特化的 getter 等）无法预先判断，改在受保护调用内转换。
+
+#pragma once
+
+extern "C" {
+#include <lua.h>
+#include <lauxlib.h>
+}
+
+#include "error.hpp"
+#include "function.hpp"
+#include "stack.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace sptxx {
+
+struct call_stats {
+  std::uint64_t calls = 0;
+  std::uint64_t errors = 0;
+  std::uint64_t total_ns = 0; // 仅 enable_timing 时累计
+  std::uint64_t max_ns = 0;
+
+  double mean_ns() const { return calls ? static_cast<double>(total_ns) / calls : 0.0; }
+};
+
+namespace detail {
+
+// 错误处理函数：把错误对象转成字符串并附上 traceback。
+// VM 以 Slot 0 约定调用 errfunc：index 1 为 nil receiver，错误对象在 index 2。
+inline int traceback_handler(lua_State *L) {
+  const char *msg = lua_tostring(L, 2);
+  if (!msg)
+    msg = lua_pushfstring(L, "(error object is a %s value)", luaL_typename(L, 2));
+  luaL_traceback(L, L, msg, 1);
+  return 1;
+}
+
+template <typename T> struct is_optional : std::false_type {};
+template <typename T> struct is_optional<std::optional<T>> : std::true_type {};
+
+// 返回值预检：1 = index 处的值能按 T 转换，0 = 不能，-1 = 无法预先判断。
+// 与 stack.hpp 中内建 getter 的接受规则一致（整数接受可精确转换的浮点数与数字串）。
+template <typename T> int result_fits(lua_State *L, int index) {
+  using U = std::decay_t<T>;
+  if constexpr (std::is_same_v<U, bool>) {
+    return 1;
+  } else if constexpr (std::is_integral_v<U>) {
+    int isnum = 0;
+    lua_tointegerx(L, index, &isnum);
+    return isnum;
+  } else if constexpr (std::is_floating_point_v<U>) {
+    return lua_isnumber(L, index);
+  } else if constexpr (std::is_same_v<U, std::string> || std::is_same_v<U, std::string_view> ||
+                       std::is_same_v<U, const char *>) {
+    return lua_isstring(L, index);
+  } else if constexpr (is_optional<U>::value) {
+    return lua_isnil(L, index) ? 1 : result_fits<typename U::value_type>(L, index);
+  } else {
+    return -1;
+  }
+}
+
+// 从 first 起的 result 个返回值逐项预检：0 = 全部能转换，k > 0 = 第 k 个不能，-1 = 有无法
+// 预先判断的项。
+template <typename Tuple, std::size_t... Is>
+int tuple_results_fit(lua_State *L, int first, std::index_sequence<Is...>) {
+  int bad = 0;
+  bool unknown = false;
+  auto one = [&](int fit, int pos) {
+    if (fit == 0 && bad == 0)
+      bad = pos;
+    unknown = unknown || fit < 0;
+  };
+  (one(result_fits<std::tuple_element_t<Is, Tuple>>(L, first + static_cast<int>(Is)),
+       static_cast<int>(Is) + 1),
+   ...);
+  return bad ? bad : unknown ? -1 : 0;
+}
+
+template <typename R> int results_fit(lua_State *L, int first) {
+  if constexpr (is_tuple_v<R>) {
+    return tuple_results_fit<R>(L, first, std::make_index_sequence<std::tuple_size_v<R>>{});
+  } else {
+    int fit = result_fits<R>(L, first);
+    return fit == 1 ? 0 : fit == 0 ? 1 : -1;
+  }
+}
+
+// 受保护的返回值转换：index 2 为 std::optional<R>*，返回值从 index 3 起。
+template <typename R> int convert_results(lua_State *L) {
+  auto *slot = static_cast<std::optional<R> *>(lua_touserdata(L, 2));
+  if constexpr (is_tuple_v<R>)
+    slot->emplace(extract_multi_return<R>(L, 3));
+  else
+    slot->emplace(stack::get<R>(L, 3));
+  return 0;
+}
+
+} // namespace detail
+
+template <typename Signature> class protected_function;
+
+template <typename R, typename... Args> class protected_function<R(Args...)> {
+  using clock = std::chrono::steady_clock;
+
+  static constexpr int handler_slot = 1;  // 线程栈上错误处理函数的位置
+  static constexpr int function_slot = 2; // 线程栈上被调函数的位置
+
+public:
+  protected_function() = default;
+
+  // 固定 L 上 index 处的函数。
+  protected_function(lua_State *L, int index) {
+    if (!lua_isfunction(L, index))
+      throw type_error("protected_function: value is not a function");
+    index = lua_absindex(L, index);
+    lua_State *T = lua_newthread(L);
+    if (!T)
+      throw error("protected_function: failed to create thread");
+    lua_pushcfunction(T, &detail::traceback_handler);
+    lua_pushvalue(L, index);
+    lua_xmove(L, T, 1);
+    L_ = L;
+    T_ = T;
+    ref_ = luaL_ref(L, LUA_REGISTRYINDEX); // 弹出并锚定线程
+    lua_pushvalue(L, index);
+    fn_ref_ = luaL_ref(L, LUA_REGISTRYINDEX); // 重入调用时使用
+  }
+
+  protected_function(const protected_function &) = delete;
+  protected_function &operator=(const protected_function &) = delete;
+
+  protected_function(protected_function &&other) noexcept
+      : L_(other.L_), T_(other.T_), ref_(other.ref_), fn_ref_(other.fn_ref_),
+        timing_(other.timing_), stats_(other.stats_) {
+    other.L_ = other.T_ = nullptr;
+    other.ref_ = other.fn_ref_ = LUA_NOREF;
+  }
+
+  protected_function &operator=(protected_function &&other) noexcept {
+    if (this != &other) {
+      release();
+      L_ = other.L_;
+      T_ = other.T_;
+      ref_ = other.ref_;
+      fn_ref_ = other.fn_ref_;
+      timing_ = other.timing_;
+      stats_ = other.stats_;
+      other.L_ = other.T_ = nullptr;
+      other.ref_ = other.fn_ref_ = LUA_NOREF;
+    }
+    return *this;
+  }
+
+  ~protected_function() { release(); }
+
+  bool valid() const { return T_ != nullptr; }
+  explicit operator bool() const { return valid(); }
+
+  lua_State *lua_state() const { return L_; }
+  lua_State *thread() const { return T_; }
+
+  void enable_timing(bool on) { timing_ = on; }
+  const call_stats &stats() const { return stats_; }
+  void reset_stats() { stats_ = call_stats{}; }
+
+  R operator()(Args... args) const {
+    int base = prepare(sizeof...(Args) + 3);
+    clock::time_point t0 = timing_ ? clock::now() : clock::time_point{};
+    int errfunc = push_callee();
+    lua_pushnil(T_); // Slot 0 receiver
+    try {
+      detail::push_args(T_, std::forward<Args>(args)...);
+    } catch (...) {
+      lua_settop(T_, base);
+      throw;
+    }
+    invoke(base, errfunc, static_cast<int>(sizeof...(Args)) + 1, t0, -1);
+    if constexpr (std::is_void_v<R>) {
+      lua_settop(T_, base);
+    } else {
+      R ret = convert_result(base, -1);
+      lua_settop(T_, base);
+      return ret;
+    }
+  }
+
+  // 对 range 中每个元素 e 调用 f(e)，丢弃返回值。出错时抛出，已完成的调用不回滚。
+  template <typename Range> void call_each(const Range &range) const {
+    each(range, [](int, long long) {});
+  }
+
+  // 同上，并把每次的返回值依次写入 out，返回写入后的迭代器。
+  template <typename Range, typename OutIt> OutIt call_each(const Range &range, OutIt out) const {
+    static_assert(!std::is_void_v<R>, "call_each with an output iterator needs a return value");
+    each(range, [this, &out](int base, long long i) {
+      *out = convert_result(base, i);
+      ++out;
+    });
+    return out;
+  }
+
+private:
+  lua_State *L_ = nullptr;
+  lua_State *T_ = nullptr;
+  int ref_ = LUA_NOREF;
+  int fn_ref_ = LUA_NOREF;
+  bool timing_ = false;
+  mutable int depth_ = 0; // 正在进行的调用层数
+  mutable call_stats stats_;
+
+  static constexpr int result_count() {
+    if constexpr (std::is_void_v<R>)
+      return 0;
+    else if constexpr (detail::is_tuple_v<R>)
+      return static_cast<int>(std::tuple_size_v<R>);
+    else
+      return 1;
+  }
+
+  void release() {
+    if (L_ && ref_ != LUA_NOREF) {
+      luaL_unref(L_, LUA_REGISTRYINDEX, ref_);
+      luaL_unref(L_, LUA_REGISTRYINDEX, fn_ref_);
+    }
+    L_ = T_ = nullptr;
+    ref_ = fn_ref_ = LUA_NOREF;
+  }
+
+  // 检查句柄与栈空间，返回调用前的栈顶。
+  int prepare(std::size_t slots) const {
+    if (!T_)
+      throw error("invalid protected_function");
+    if (!lua_checkstack(T_, static_cast<int>(slots) + result_count()))
+      throw runtime_error("protected_function: stack overflow");
+    return lua_gettop(T_);
+  }
+
+  // 压入被调函数，返回 lua_pcall 的错误处理函数位置。
+  int push_callee() const {
+    if (depth_ == 0) {
+      lua_pushvalue(T_, function_slot);
+      return handler_slot;
+    }
+    lua_pushcfunction(T_, &detail::traceback_handler);
+    lua_getref(T_, fn_ref_);
+    return lua_gettop(T_) - 1;
+  }
+
+  void record(clock::time_point t0) const {
+    ++stats_.calls;
+    if (timing_) {
+      auto ns = static_cast<std::uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - t0).count());
+      stats_.total_ns += ns;
+      if (ns > stats_.max_ns)
+        stats_.max_ns = ns;
+    }
+  }
+
+  // 栈顶为 函数, nil, 参数...；调用后栈顶为 result_count() 个返回值。
+  // element >= 0 表示 call_each 的第几个元素（仅用于错误消息）。
+  void invoke(int base, int errfunc, int nargs, clock::time_point t0, long long element) const {
+    ++depth_;
+    int status = lua_pcall(T_, nargs, result_count(), errfunc);
+    --depth_;
+    record(t0);
+    if (status != LUA_OK) {
+      ++stats_.errors;
+      const char *msg = lua_tostring(T_, -1);
+      std::string err = msg ? std::string(msg) : std::string("unknown Lua error");
+      lua_settop(T_, base);
+      if (element >= 0)
+        err = "call_each element " + std::to_string(element) + ": " + err;
+      throw runtime_error(std::move(err));
+    }
+  }
+
+  // 栈顶 result_count() 个返回值转换为 R（栈不动，调用方复原）。类型不符时复原到 base、
+  // 计一次错误并抛 type_error。
+  R convert_result(int base, long long element) const {
+    constexpr int n = result_count();
+    int first = lua_gettop(T_) - n + 1;
+    int fit = detail::results_fit<R>(T_, first);
+    if (fit == 0) {
+      if constexpr (detail::is_tuple_v<R>)
+        return detail::extract_multi_return<R>(T_, first);
+      else
+        return stack::get<R>(T_, first);
+    }
+    std::string err;
+    if (fit > 0) {
+      err = std::string("protected_function: cannot convert result ") + std::to_string(fit) +
+            " (a " + luaL_typename(T_, first + fit - 1) + " value)";
+    } else if (lua_checkstack(T_, 3)) {
+      std::optional<R> slot;
+      lua_pushcfunction(T_, &detail::convert_results<R>);
+      lua_pushnil(T_);
+      lua_pushlightuserdata(T_, &slot);
+      lua_rotate(T_, first, 3); // 函数, nil, slot 移到返回值之下
+      if (lua_pcall(T_, n + 2, 0, 0) == LUA_OK)
+        return std::move(*slot);
+      const char *msg = lua_tostring(T_, -1);
+      err = std::string("protected_function: cannot convert result: ") +
+            (msg ? msg : "unknown Lua error");
+    } else {
+      err = "protected_function: stack overflow";
+    }
+    ++stats_.errors;
+    lua_settop(T_, base);
+    if (element >= 0)
+      err = "call_each element " + std::to_string(element) + ": " + err;
+    throw type_error(std::move(err));
+  }
+
+  template <typename Range, typename OnResult>
+  void each(const Range &range, OnResult &&on_result) const {
+    static_assert(sizeof...(Args) == 1, "call_each requires a single-argument signature");
+    using Arg = std::decay_t<std::tuple_element_t<0, std::tuple<Args..., void>>>;
+    int base = prepare(4);
+    long long i = 0;
+    for (const auto &element : range) {
+      clock::time_point t0 = timing_ ? clock::now() : clock::time_point{};
+      int errfunc = push_callee();
+      lua_pushnil(T_);
+      try {
+        const Arg &arg = element;
+        stack::push(T_, arg);
+      } catch (...) {
+        lua_settop(T_, base);
+        throw;
+      }
+      invoke(base, errfunc, 2, t0, i);
+      on_result(base, i);
+      lua_settop(T_, base);
+      ++i;
+    }
+  }
+};
+
+// ---- stack 特化：C++ 函数参数可直接接收 protected_function ----
+
+template <typename R, typename... Args> struct getter<protected_function<R(Args...)>> {
+  static protected_function<R(Args...)> get(lua_State *L, int index) {
+    if (lua_isnil(L, index))
+      return protected_function<R(Args...)>();
+    if (!lua_isfunction(L, index))
+      luaL_error(L, "expected function at index %d", index);
+    return protected_function<R(Args...)>(L, index);
+  }
+};
+
+} // namespace sptxx
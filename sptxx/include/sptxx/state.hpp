@@ -1,6 +1,7 @@
 // state.hpp - Lua state 管理与顶层 API
 // basic_state 持有 lua_State*，提供 set/get_global、set_function、
-// create_list/create_map、new_usertype/get_usertype、call、do_string/do_file 等。
+// create_list/create_map、new_usertype/get_usertype、call、get_protected_function、
+// do_string/do_file/do_frozen 等。
 // state = basic_state<>（默认分配器）。
 
 #pragma once
@@ -12,9 +13,11 @@ extern "C" {
 }
 
 #include "error.hpp"
+#include "frozen_chunk.hpp"
 #include "function.hpp"
 #include "list.hpp"
 #include "map.hpp"
+#include "protected_function.hpp"
 #include "stack.hpp"
 #include "table_proxy.hpp"
 #include "usertype.hpp"
@@ -86,6 +89,14 @@ public:
     return status;
   }
 
+  // 载入并执行一个冻结代码块（见 frozen_chunk.hpp），不重新编译。
+  int do_frozen(const frozen_chunk &chunk) {
+    chunk.push(L_);
+    int status = lua_pcall(L_, 0, LUA_MULTRET, 0);
+    detail::handle_lua_error(L_, status);
+    return status;
+  }
+
   // ---- 全局变量 ----
 
   template <typename T> T get_global(const char *name) {
@@ -154,6 +165,21 @@ public:
     return function_ref<Signature>(L_, ref);
   }
 
+  // 取全局函数并固定为 protected_function（全局名只解析这一次），用于高频回调。
+  template <typename Signature>
+  protected_function<Signature> get_protected_function(const char *name) {
+    lua_getglobal(L_, name);
+    if (!lua_isfunction(L_, -1)) {
+      bool missing = lua_isnil(L_, -1);
+      lua_pop(L_, 1);
+      throw error(missing ? std::string("function '") + name + "' not found"
+                          : std::string("'") + name + "' is not a function");
+    }
+    protected_function<Signature> f(L_, -1);
+    lua_pop(L_, 1);
+    return f;
+  }
+
   // 调用全局 Lua 函数。R 可为 void、单值、或 std::tuple（多返回值）。
   template <typename R = void, typename... Args> R call(const char *name, Args &&...args) {
     lua_getglobal(L_, name);
@@ -0,0 +1,165 @@
+// state_pool.hpp - 预初始化状态池（每请求一个独立 lua_State）
+// - state_pool(init, capacity)：新建模板 state 并执行 init（开库、注册绑定、加载脚本），
+//   full GC 后预先克隆 capacity 个状态备用。克隆由 spt_clonestate 完成：对象图逐一复制，
+//   函数原型的字节码与行号信息与模板共享，不重新编译。
+// - acquire()：取一个就绪状态，池空时当场克隆。返回 lease，析构时关闭该状态（不回收复用，
+//   请求之间互不可见）。
+// - refill()：补足到 capacity，可在后台线程调用；克隆只读模板，多个线程可同时克隆。
+//
+// 模板在构造后不再修改，由 lease 共同持有，池先于 lease 析构也无妨。
+// 模板中的 C++ 对象（usertype、绑定的 lambda）在克隆时拷贝构造，不可拷贝的类型会让克隆失败；
+// 模板不能持有协程（包括 protected_function 句柄与 coroutine 包装器）。
+
+#pragma once
+
+extern "C" {
+#include <lua.h>
+#include <spt_clone.h>
+}
+
+#include "error.hpp"
+#include "state.hpp"
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+
+namespace sptxx {
+
+namespace detail {
+
+// 模板状态：构造后只读，最后一个 lease 释放时关闭。
+class pool_template {
+public:
+  explicit pool_template(const std::function<void(state &)> &init) : tpl_() {
+    if (init)
+      init(tpl_);
+    lua_gc(tpl_.lua_state(), LUA_GCCOLLECT);
+  }
+
+  pool_template(const pool_template &) = delete;
+  pool_template &operator=(const pool_template &) = delete;
+
+  lua_State *clone() const {
+    char err[256];
+    lua_State *L = spt_clonestate(tpl_.lua_state(), err, sizeof(err));
+    if (!L)
+      throw error(std::string("state_pool: ") + err);
+    return L;
+  }
+
+private:
+  state tpl_;
+};
+
+} // namespace detail
+
+// 从池中取出的状态。只可移动；析构时关闭状态并释放对模板的引用。
+class lease {
+public:
+  lease() = default;
+  lease(std::shared_ptr<const detail::pool_template> tpl, lua_State *L)
+      : tpl_(std::move(tpl)), state_(std::in_place, L, true) {}
+
+  lease(lease &&other) noexcept : tpl_(std::move(other.tpl_)), state_(std::move(other.state_)) {
+    other.state_.reset();
+  }
+  lease &operator=(lease &&other) noexcept {
+    if (this != &other) {
+      state_.reset(); // 先关闭状态，再释放模板
+      state_ = std::move(other.state_);
+      other.state_.reset();
+      tpl_ = std::move(other.tpl_);
+    }
+    return *this;
+  }
+
+  bool valid() const { return state_.has_value(); }
+  explicit operator bool() const { return valid(); }
+
+  state &operator*() { return *state_; }
+  state *operator->() { return &*state_; }
+  lua_State *lua_state() const { return state_ ? state_->lua_state() : nullptr; }
+
+private:
+  std::shared_ptr<const detail::pool_template> tpl_; // 必须比 state_ 后析构
+  std::optional<state> state_;
+};
+
+class state_pool {
+public:
+  using initializer = std::function<void(state &)>;
+
+  explicit state_pool(initializer init, std::size_t capacity = 0)
+      : tpl_(std::make_shared<const detail::pool_template>(init)), capacity_(capacity) {
+    refill();
+  }
+
+  state_pool(const state_pool &) = delete;
+  state_pool &operator=(const state_pool &) = delete;
+
+  ~state_pool() {
+    for (lua_State *L : ready_)
+      lua_close(L);
+  }
+
+  // 取一个就绪状态；池空时当场克隆。
+  lease acquire() {
+    lua_State *L = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!ready_.empty()) {
+        L = ready_.front();
+        ready_.pop_front();
+      }
+    }
+    if (!L)
+      L = tpl_->clone();
+    return lease(tpl_, L);
+  }
+
+  // 克隆到就绪数达到 capacity，返回新克隆的个数。克隆在锁外进行。
+  std::size_t refill() {
+    std::size_t made = 0;
+    for (;;) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (ready_.size() + pending_ >= capacity_)
+          return made;
+        ++pending_;
+      }
+      lua_State *L;
+      try {
+        L = tpl_->clone();
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --pending_;
+        throw;
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      --pending_;
+      ready_.push_back(L);
+      ++made;
+    }
+  }
+
+  std::size_t ready() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ready_.size();
+  }
+
+  std::size_t capacity() const { return capacity_; }
+
+private:
+  std::shared_ptr<const detail::pool_template> tpl_;
+  std::size_t capacity_;
+  mutable std::mutex mutex_;
+  std::deque<lua_State *> ready_;
+  std::size_t pending_ = 0; // 正在克隆、尚未入队的个数
+};
+
+} // namespace sptxx
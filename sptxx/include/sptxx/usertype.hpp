@@ -1,16 +1,24 @@
 // usertype.hpp - 类绑定系统
 // 支持：变参构造函数、成员属性、成员方法、运算符重载、三种所有权语义。
 //
-// 存储格式：userdata 内仅存 T*（8 字节）。这与用户特化 pusher<T> 的常见写法
-// （存 T*）一致，保证 operator 结果能被后续 method/operator 正确读取。
+// 存储格式：userdata 开头是 T*。这与用户特化 pusher<T> 的常见写法（存 T*）一致，
+// 保证 operator 结果能被后续 method/operator 正确读取。脚本构造与 push_value 的小对象
+// （is_inline_usertype<T>）就地构造在同一块内，T* 指向块内本体：一次分配，读路径不变。
 //
 // 所有权：
-// - owned:   使用类型 metatable（如 "Player"），__gc 会 delete T*。
+// - owned:   使用类型 metatable（如 "Player"），__gc 会 delete T*；
+//            T* 指向块内（就地对象）时只调用析构函数。
 // - unowned: 使用 "Player#unowned" metatable，__gc 不操作。
 // - shared:  使用类型 metatable，但把 shared_ptr<T>* 登记到 side-registry；
 //            __gc 优先查 side-registry，命中则删除 shared_ptr（refcount--），
 //            未命中则 delete T*（owned 路径）。
 //
+// 成员查找：__index/__newindex 是同一组 upvalue 的 C 闭包（owned 与 unowned 共享），upvalue 1
+// 为按键展平的分派表：本类型与 __base 链上各层的字段、方法、metatable 字段按原查找顺序合并，
+// 首次访问时构建。字段/属性项是指向 member_entry 的 lightuserdata，处理器直接调用其中的
+// 访问函数（成员指针读写），不经过嵌套 lua_call；方法项就是方法闭包本身。
+// 任何注册都会推进全局 epoch，各类型的展平表在下一次访问时重建。
+//
 // SPT Slot 0 约定：方法调用 a.b(args) 时 receiver=a 在 index 1，用户参数从 index 2。
 // 因此 method wrapper 从 index 1 读 self，从 index 2+ 读参数。
 // 运算符是 metamethod，不走 Slot 0：__add(a,b) 中 a 在 index 1、b 在 index 2。
@@ -25,6 +33,7 @@ extern "C" {
 #include "error.hpp"
 #include "function.hpp"
 #include "stack.hpp"
+#include <cstdint>
 #include <cstring>
 #include <functional>
 #include <memory>
@@ -41,6 +50,18 @@ enum class ownership {
   shared   // shared_ptr 共享，GC 时 refcount--
 };
 
+#ifndef SPTXX_INLINE_USERTYPE_MAX
+#define SPTXX_INLINE_USERTYPE_MAX 128
+#endif
+
+// 脚本构造（constructor<>）与 push_value/emplace_usertype 是否就地存放对象。
+// 默认：不超过 SPTXX_INLINE_USERTYPE_MAX 字节且析构不抛异常。可对具体类型特化关闭
+// （例如对象地址需在 Lua 值回收后仍由 C++ 接管时）。
+template <typename T>
+struct is_inline_usertype
+    : std::bool_constant<sizeof(T) <= SPTXX_INLINE_USERTYPE_MAX &&
+                         std::is_nothrow_destructible_v<T>> {};
+
 enum class operator_type {
   add, sub, mul, div, mod, pow, unm, idiv,
   band, bor, bxor, bnot, shl, shr,
@@ -121,11 +142,200 @@ template <typename T> inline T *get_object_ptr(lua_State *L, int index) {
   return *static_cast<T **>(ud);
 }
 
+// 就地对象的 userdata 大小：T* 头 + 对齐填充 + T。userdata 至少按指针对齐。
+template <typename T> constexpr std::size_t inline_block_size() {
+  return sizeof(T *) + sizeof(T) + (alignof(T) > alignof(T *) ? alignof(T) - alignof(T *) : 0);
+}
+
+template <typename T> inline void *inline_body(void *ud) {
+  std::uintptr_t p = reinterpret_cast<std::uintptr_t>(ud) + sizeof(T *);
+  p = (p + alignof(T) - 1) / alignof(T) * alignof(T);
+  return reinterpret_cast<void *>(p);
+}
+
+// obj 是否落在 userdata 块 [ud, ud + size) 内（即就地对象）。
+inline bool points_into(const void *ud, std::size_t size, const void *obj) {
+  auto b = reinterpret_cast<std::uintptr_t>(ud), p = reinterpret_cast<std::uintptr_t>(obj);
+  return p > b && p < b + size;
+}
+
+// ---- 展平分派 ----
+// 字段/属性项。get/set 接收 userdata 中的对象指针（单继承下与各层基类地址相同），
+// 成员指针按位存放在 getter_data/setter_data；数据成员的 set 也读 getter_data。
+struct member_entry {
+  int (*get)(lua_State *L, void *obj, const member_entry *e); // 压入值，返回个数
+  void (*set)(lua_State *L, void *obj, const member_entry *e); // 值在 index 3
+  unsigned char getter_data[32];
+  unsigned char setter_data[32];
+};
+
+// 注册代数：每个状态一份，挂在注册表上。本状态内每次注册 +1，展平表记录构建时的代数，
+// 不一致即重建；其它状态（状态池、每请求一个状态）的注册互不影响。从不为 0。
+struct usertype_epoch_cell {
+  unsigned epoch;
+};
+
+// 压入本状态的代数 userdata（首次调用时创建）。
+inline usertype_epoch_cell *push_usertype_epoch(lua_State *L) {
+  static const char key = 0;
+  if (lua_rawgetp(L, LUA_REGISTRYINDEX, &key) != LUA_TUSERDATA) {
+    lua_pop(L, 1);
+    auto *cell =
+        static_cast<usertype_epoch_cell *>(lua_newuserdatauv(L, sizeof(usertype_epoch_cell), 0));
+    cell->epoch = 1;
+    lua_pushvalue(L, -1);
+    lua_rawsetp(L, LUA_REGISTRYINDEX, &key);
+  }
+  return static_cast<usertype_epoch_cell *>(lua_touserdata(L, -1));
+}
+
+inline void bump_usertype_epoch(lua_State *L) {
+  usertype_epoch_cell *cell = push_usertype_epoch(L);
+  if (++cell->epoch == 0)
+    cell->epoch = 1;
+  lua_pop(L, 1);
+}
+
+struct dispatch_cache {
+  unsigned epoch; // 0 = 尚未构建
+};
+
+// 压入 dispatch_cache 的 metatable：只有 __clone。展平表里的 lightuserdata 指向模板状态的
+// member_entry，克隆出的状态把代数清零，首次访问时按自己的 __fields 重建。
+inline void push_dispatch_cache_metatable(lua_State *L) {
+  static const char key = 0;
+  if (lua_rawgetp(L, LUA_REGISTRYINDEX, &key) == LUA_TTABLE)
+    return;
+  lua_pop(L, 1);
+  lua_createtable(L, 0, 1);
+  lua_pushcfunction(L, [](lua_State *L) -> int {
+    static_cast<dispatch_cache *>(lua_touserdata(L, 2))->epoch = 0;
+    return 0;
+  });
+  lua_setfield(L, -2, "__clone");
+  lua_pushvalue(L, -1);
+  lua_rawsetp(L, LUA_REGISTRYINDEX, &key);
+}
+
+// 把 src 表中 flat 尚无的字符串键拷入 flat；as_entry 时值为 member_entry userdata，
+// 存为 lightuserdata（entry 由 __fields 表持有）。
+inline void merge_missing(lua_State *L, int flat, int src, bool as_entry) {
+  lua_pushnil(L);
+  while (lua_next(L, src)) {
+    if (lua_type(L, -2) != LUA_TSTRING || lua_type(L, -1) == LUA_TLIGHTUSERDATA) {
+      lua_pop(L, 1);
+      continue;
+    }
+    lua_pushvalue(L, -2);
+    if (lua_rawget(L, flat) != LUA_TNIL) {
+      lua_pop(L, 2);
+      continue;
+    }
+    lua_pop(L, 1);
+    lua_pushvalue(L, -2);
+    if (as_entry)
+      lua_pushlightuserdata(L, lua_touserdata(L, -2));
+    else
+      lua_pushvalue(L, -2);
+    lua_rawset(L, flat);
+    lua_pop(L, 1);
+  }
+}
+
+// 本状态的注册代数（__index / __newindex 的 upvalue 4）。
+inline unsigned upvalue_epoch(lua_State *L) {
+  return static_cast<usertype_epoch_cell *>(lua_touserdata(L, lua_upvalueindex(4)))->epoch;
+}
+
+// 重建 upvalue 1 的展平表：沿 __base 链逐层按 字段 → 方法 → metatable 自身字段 合并，
+// 先到者优先，与逐层查找的结果一致。
+inline void rebuild_dispatch(lua_State *L) {
+  int top = lua_gettop(L);
+  int flat = lua_upvalueindex(1);
+  lua_pushnil(L);
+  while (lua_next(L, flat)) {
+    lua_pop(L, 1);
+    lua_pushvalue(L, -1);
+    lua_pushnil(L);
+    lua_rawset(L, flat);
+  }
+  lua_pushvalue(L, lua_upvalueindex(3)); // 本类型 owned metatable
+  for (int depth = 0; depth < 64; ++depth) {
+    int mt = lua_gettop(L);
+    if (lua_getfield(L, mt, "__fields") == LUA_TTABLE)
+      merge_missing(L, flat, mt + 1, true);
+    lua_pop(L, 1);
+    if (lua_getfield(L, mt, "__methods") == LUA_TTABLE)
+      merge_missing(L, flat, mt + 1, false);
+    lua_pop(L, 1);
+    merge_missing(L, flat, mt, false);
+    const char *base_name = lua_getfield(L, mt, "__base") == LUA_TSTRING ? lua_tostring(L, -1)
+                                                                        : nullptr;
+    if (!base_name || luaL_getmetatable(L, base_name) != LUA_TTABLE)
+      break;
+    lua_replace(L, mt);
+    lua_pop(L, 1); // __base
+  }
+  lua_settop(L, top);
+  auto *cache = static_cast<dispatch_cache *>(lua_touserdata(L, lua_upvalueindex(2)));
+  cache->epoch = upvalue_epoch(L);
+}
+
+inline void ensure_dispatch(lua_State *L) {
+  auto *cache = static_cast<dispatch_cache *>(lua_touserdata(L, lua_upvalueindex(2)));
+  if (cache->epoch != upvalue_epoch(L))
+    rebuild_dispatch(L);
+}
+
+inline int usertype_index(lua_State *L) {
+  lua_settop(L, 2);
+  ensure_dispatch(L);
+  lua_pushvalue(L, 2);
+  if (lua_rawget(L, lua_upvalueindex(1)) != LUA_TLIGHTUSERDATA)
+    return 1; // 方法 / metatable 字段 / nil
+  const auto *e = static_cast<const member_entry *>(lua_touserdata(L, -1));
+  if (!e->get)
+    return luaL_error(L, "cannot get field '%s'", lua_tostring(L, 2));
+  void *obj = get_object_ptr<void>(L, 1);
+  if (!obj)
+    return luaL_error(L, "null object in getter");
+  lua_pop(L, 1);
+  return e->get(L, obj, e);
+}
+
+inline int usertype_newindex(lua_State *L) {
+  lua_settop(L, 3);
+  ensure_dispatch(L);
+  lua_pushvalue(L, 2);
+  if (lua_rawget(L, lua_upvalueindex(1)) == LUA_TLIGHTUSERDATA) {
+    const auto *e = static_cast<const member_entry *>(lua_touserdata(L, -1));
+    if (e->set) {
+      void *obj = get_object_ptr<void>(L, 1);
+      if (!obj)
+        return luaL_error(L, "null object in setter");
+      lua_pop(L, 1);
+      e->set(L, obj, e);
+      return 0;
+    }
+  }
+  const char *key = lua_tostring(L, 2);
+  if (!key)
+    return luaL_error(L, "field name must be a string");
+  return luaL_error(L, "cannot set field '%s'", key);
+}
+
 } // namespace detail
 
 // ---- method_overload_set：usertype 方法重载分派 ----
+// 决议与 overload_set 相同（detail::resolve_overload），receiver 在 index 1。
 template <typename T, typename... MethodPtrs> struct method_overload_set {
+  using candidates = std::tuple<
+      detail::overload_candidate<typename detail::function_traits<MethodPtrs>::args_tuple>...>;
+
   std::tuple<MethodPtrs...> methods;
+  std::tuple<typename detail::overload_candidate<
+      typename detail::function_traits<MethodPtrs>::args_tuple>::refs_type...>
+      refs;
 
   template <typename... Args>
   method_overload_set(Args &&...args) : methods(std::forward<Args>(args)...) {}
@@ -135,31 +345,28 @@ template <typename T, typename... MethodPtrs> struct method_overload_set {
     return dispatch_impl(L, std::index_sequence_for<MethodPtrs...>{});
   }
 
-  template <std::size_t... Is> int dispatch_impl(lua_State *L, std::index_sequence<Is...>) {
-    int result = -1;
-    bool done = false;
-    ((!done && ((result = try_method<Is>(L)) >= 0) ? (done = true, true) : false), ...);
-    if (result < 0)
+  template <std::size_t... Is> int dispatch_impl(lua_State *L, std::index_sequence<Is...> seq) {
+    using invoker = int (*)(method_overload_set &, lua_State *, T *);
+    static constexpr invoker table[] = {&method_overload_set::call_one<Is>...};
+    std::size_t i = detail::resolve_overload<std::tuple_element_t<Is, candidates>...>(
+        detail::arg_signature(L), refs, seq);
+    if (i == sizeof...(MethodPtrs))
       throw error("no matching method overload for given arguments");
-    return result;
+    T *obj = detail::get_object_ptr<T>(L, 1);
+    if (!obj)
+      return luaL_error(L, "null object in method overload");
+    return table[i](*this, L, obj);
   }
 
-  template <std::size_t I> int try_method(lua_State *L) {
+  template <std::size_t I> static int call_one(method_overload_set &self, lua_State *L, T *obj) {
     using MethodPtr = std::tuple_element_t<I, std::tuple<MethodPtrs...>>;
     using Traits = detail::function_traits<MethodPtr>;
-    using ReturnType = typename Traits::return_type;
-    using ArgsTuple = typename Traits::args_tuple;
-    if (!detail::check_args<ArgsTuple>(L))
-      return -1;
-    T *obj = detail::get_object_ptr<T>(L, 1);
-    if (!obj)
-      return luaL_error(L, "null object in method overload");
-    auto method = std::get<I>(methods);
-    return call_method_impl<ReturnType, MethodPtr>(L, obj, method, ArgsTuple{});
+    return self.call_method_impl<typename Traits::return_type, MethodPtr>(
+        L, obj, std::get<I>(self.methods), static_cast<typename Traits::args_tuple *>(nullptr));
   }
 
   template <typename R, typename MethodPtr, typename... Args>
-  int call_method_impl(lua_State *L, T *obj, MethodPtr method, std::tuple<Args...>) {
+  int call_method_impl(lua_State *L, T *obj, MethodPtr method, std::tuple<Args...> *) {
     auto args = detail::extract_args_from_2<Args...>(L);
     if constexpr (std::is_void_v<R>) {
       std::apply([obj, method](auto &&...a) { (obj->*method)(std::forward<decltype(a)>(a)...); },
@@ -175,6 +382,29 @@ template <typename T, typename... MethodPtrs> struct method_overload_set {
   }
 };
 
+// 以 owned 语义压入一个新构造的 T（metatable 为 name），返回对象指针。
+// is_inline_usertype<T> 时就地构造（一次分配），否则堆分配后存 T*。
+// 构造抛异常时 userdata 头保持 nullptr，__gc 跳过；name 未注册时抛 error。
+template <typename T, typename... Args>
+T *emplace_usertype(lua_State *L, const char *name, Args &&...args) {
+  constexpr bool inline_storage = is_inline_usertype<T>::value;
+  std::size_t size = inline_storage ? detail::inline_block_size<T>() : sizeof(T *);
+  void *ud = lua_newuserdatauv(L, size, 0);
+  *static_cast<T **>(ud) = nullptr;
+  if (luaL_getmetatable(L, name) != LUA_TTABLE) {
+    lua_pop(L, 2);
+    throw error(std::string("usertype '") + name + "' not registered");
+  }
+  lua_setmetatable(L, -2);
+  T *obj;
+  if constexpr (inline_storage)
+    obj = new (detail::inline_body<T>(ud)) T(std::forward<Args>(args)...);
+  else
+    obj = new T(std::forward<Args>(args)...);
+  *static_cast<T **>(ud) = obj;
+  return obj;
+}
+
 template <typename T> class usertype {
 public:
   usertype(lua_State *L, const char *name) : L_(L), type_name_(name) {
@@ -193,22 +423,36 @@ public:
 
     lua_pushcfunction(L_, &usertype::gc_owned);
     lua_setfield(L_, -2, "__gc");
+    lua_pushcfunction(L_, &usertype::clone_owned);
+    lua_setfield(L_, -2, "__clone");
 
-    lua_pushcfunction(L_, &usertype::index_handler);
-    lua_setfield(L_, -2, "__index");
-
-    lua_pushcfunction(L_, &usertype::newindex_handler);
-    lua_setfield(L_, -2, "__newindex");
-
+    // __index / __newindex 共享 upvalue：展平表、构建代数、本 metatable、本状态的注册代数
     lua_newtable(L_);
-    lua_setfield(L_, -2, "__getters");
+    auto *cache = static_cast<detail::dispatch_cache *>(
+        lua_newuserdatauv(L_, sizeof(detail::dispatch_cache), 0));
+    cache->epoch = 0;
+    detail::push_dispatch_cache_metatable(L_);
+    lua_setmetatable(L_, -2);
+    detail::push_usertype_epoch(L_);
+    for (lua_CFunction handler : {&detail::usertype_index, &detail::usertype_newindex}) {
+      lua_pushvalue(L_, -3);
+      lua_pushvalue(L_, -3);
+      lua_pushvalue(L_, -6);
+      lua_pushvalue(L_, -4);
+      lua_pushcclosure(L_, handler, 4);
+      lua_setfield(L_, -5, handler == &detail::usertype_index ? "__index" : "__newindex");
+    }
+    lua_pop(L_, 3);
+
     lua_newtable(L_);
-    lua_setfield(L_, -2, "__setters");
+    lua_setfield(L_, -2, "__fields");
     lua_newtable(L_);
     lua_setfield(L_, -2, "__methods");
 
     lua_pushvalue(L_, -1);
     lua_setfield(L_, -2, "__index_self"); // 便于 index_handler 回退
+    lua_pushvalue(L_, -1);
+    lua_rawsetp(L_, LUA_REGISTRYINDEX, &detail::usertype_key<T>::owned); // 供重载决议核对实参
     lua_pop(L_, 1);
 
     // unowned metatable：继承主 metatable 的 __index/__newindex，但 __gc 为空
@@ -219,17 +463,21 @@ public:
 
     lua_pushcfunction(L_, &usertype::gc_unowned);
     lua_setfield(L_, -2, "__gc");
+    lua_pushcfunction(L_, &usertype::clone_unowned);
+    lua_setfield(L_, -2, "__clone");
+    lua_pushvalue(L_, -1);
+    lua_rawsetp(L_, LUA_REGISTRYINDEX, &detail::usertype_key<T>::unowned);
 
-    // 复用主 metatable 的 __index / __newindex / __getters / __setters / __methods
+    // 复用主 metatable 的 __index / __newindex / __fields / __methods
     luaL_getmetatable(L_, name);
-    const char *fields[] = {"__index", "__newindex", "__getters", "__setters",
-                            "__methods", nullptr};
+    const char *fields[] = {"__index", "__newindex", "__fields", "__methods", nullptr};
     for (int i = 0; fields[i]; ++i) {
       lua_getfield(L_, -1, fields[i]);
       lua_setfield(L_, -3, fields[i]);
     }
     lua_pop(L_, 1);
     lua_pop(L_, 1);
+    detail::bump_usertype_epoch(L_); // 已声明以本类型为基类的派生类需重建
   }
 
   usertype(const usertype &) = delete;
@@ -246,17 +494,12 @@ public:
     auto ctor_wrapper = [](lua_State *L) -> int {
       const char *name = lua_tostring(L, lua_upvalueindex(1));
       try {
-        void *ud = lua_newuserdatauv(L, sizeof(T *), 0);
-        *static_cast<T **>(ud) = nullptr; // 先置空：若下方 extract/construct 抛异常，
-                                          // __gc 会读到 nullptr 而跳过 delete，避免 UB
-        luaL_getmetatable(L, name);
-        lua_setmetatable(L, -2);
-
         auto args = detail::extract_args_from_2<Args...>(L);
-        T *obj = std::apply(
-            [](auto &&...unpacked) { return new T(std::forward<decltype(unpacked)>(unpacked)...); },
+        std::apply(
+            [L, name](auto &&...unpacked) {
+              emplace_usertype<T>(L, name, std::forward<decltype(unpacked)>(unpacked)...);
+            },
             std::move(args));
-        *static_cast<T **>(ud) = obj;
         return 1;
       } catch (...) {
         return detail::propagate_exception(L);
@@ -286,25 +529,12 @@ public:
 
   // ---- 成员属性 ----
   template <typename U> void set(const char *name, U T::*member) {
-    luaL_getmetatable(L_, type_name_.c_str());
-
-    // getter
-    lua_getfield(L_, -1, "__getters");
-    void *gstorage = lua_newuserdatauv(L_, sizeof(U T::*), 0);
-    std::memcpy(gstorage, &member, sizeof(U T::*));
-    lua_pushcclosure(L_, &usertype::member_getter<U>, 1);
-    lua_setfield(L_, -2, name);
-    lua_pop(L_, 1);
-
-    // setter
-    lua_getfield(L_, -1, "__setters");
-    void *sstorage = lua_newuserdatauv(L_, sizeof(U T::*), 0);
-    std::memcpy(sstorage, &member, sizeof(U T::*));
-    lua_pushcclosure(L_, &usertype::member_setter<U>, 1);
-    lua_setfield(L_, -2, name);
-    lua_pop(L_, 1);
-
-    lua_pop(L_, 1);
+    static_assert(sizeof(member) <= sizeof(detail::member_entry::getter_data),
+                  "member pointer too large for member_entry");
+    detail::member_entry *e = field_entry(name, true);
+    std::memcpy(e->getter_data, &member, sizeof(member));
+    e->get = &usertype::member_getter<U>;
+    e->set = &usertype::member_setter<U>;
   }
 
   // ---- 成员方法 ----
@@ -349,19 +579,7 @@ public:
     using MOS = method_overload_set<T, MethodPtrs...>;
     luaL_getmetatable(L_, type_name_.c_str());
     lua_getfield(L_, -1, "__methods");
-    void *storage = lua_newuserdatauv(L_, sizeof(MOS), 0);
-    new (storage) MOS{std::move(methods)...};
-
-    // __gc metatable 析构 MOS
-    lua_createtable(L_, 0, 1);
-    lua_pushcfunction(L_, [](lua_State *L) -> int {
-      MOS *self = static_cast<MOS *>(lua_touserdata(L, 1));
-      self->~MOS();
-      return 0;
-    });
-    lua_setfield(L_, -2, "__gc");
-    lua_setmetatable(L_, -2);
-
+    detail::push_userdata_object<MOS>(L_, MOS{std::move(methods)...});
     lua_pushcclosure(
         L_,
         [](lua_State *L) -> int {
@@ -375,12 +593,14 @@ public:
         1);
     lua_setfield(L_, -2, name);
     lua_pop(L_, 2);
+    detail::bump_usertype_epoch(L_);
   }
 
   // ---- 继承链：声明 T 派生自 Base ----
-  // 单继承假设：Derived* 与 Base* 地址相同，因此 Base 的 getter/setter/method
-  // 闭包直接通过 get_object_ptr<Base>(L,1) 读取同一 userdata 即可。
-  // base_name 必须是 Base 在 Lua 中注册的类型名（如 "Base"）。
+  // 单继承假设：Derived* 与 Base* 地址相同，因此 Base 的字段访问函数与方法闭包
+  // 直接读取同一 userdata 中的对象指针即可。
+  // base_name 必须是 Base 在 Lua 中注册的类型名（如 "Base"），可晚于本调用注册；
+  // 展平表在下一次访问时按名解析 __base 链。
   // 同时在 owned 与 unowned 两个 metatable 上设置 __base，使两种所有权语义
   // 都支持继承。
   template <typename Base> void base(const char *base_name) {
@@ -395,6 +615,7 @@ public:
     };
     set_on(type_name_.c_str());
     set_on((type_name_ + "#unowned").c_str());
+    detail::bump_usertype_epoch(L_);
   }
 
   // ---- 静态成员：注册到类型同名的全局 table 上 ----
@@ -431,6 +652,9 @@ public:
     lua_setmetatable(L_, -2);
   }
 
+  // 值语义：拷贝/移动进 Lua，就地存放（见 is_inline_usertype），GC 时析构。
+  T *push_value(T obj) { return emplace_usertype<T>(L_, type_name_.c_str(), std::move(obj)); }
+
   void push_shared(std::shared_ptr<T> obj) {
     void *ud = lua_newuserdatauv(L_, sizeof(T *), 0);
     T *raw = obj.get();
@@ -450,8 +674,7 @@ public:
                                Op == operator_type::len || Op == operator_type::tostring);
 
     luaL_getmetatable(L_, type_name_.c_str());
-    void *storage = lua_newuserdatauv(L_, sizeof(FuncType), 0);
-    new (storage) FuncType(std::forward<Func>(func));
+    FuncType *stored = detail::push_userdata_object<FuncType>(L_, std::forward<Func>(func));
 
     if constexpr (is_unary) {
       lua_pushcclosure(L_, &usertype::unary_operator_wrapper<FuncType>, 1);
@@ -463,8 +686,7 @@ public:
     // unowned metatable 也要能看到运算符
     std::string unowned_name = type_name_ + "#unowned";
     if (luaL_getmetatable(L_, unowned_name.c_str()) == LUA_TTABLE) {
-      void *storage2 = lua_newuserdatauv(L_, sizeof(FuncType), 0);
-      new (storage2) FuncType(std::forward<Func>(func));
+      detail::push_userdata_object<FuncType>(L_, *stored);
       if constexpr (is_unary) {
         lua_pushcclosure(L_, &usertype::unary_operator_wrapper<FuncType>, 1);
       } else {
@@ -477,6 +699,7 @@ public:
     }
 
     lua_pop(L_, 1);
+    detail::bump_usertype_epoch(L_);
   }
 
   template <typename Func> void set_add(Func &&f)    { set_operator<operator_type::add>(std::forward<Func>(f)); }
@@ -525,9 +748,14 @@ private:
       delete sp;
       return 0;
     }
-    // owned 路径：delete T*
+    // owned 路径：就地对象只析构，堆对象 delete T*
     T *obj = *static_cast<T **>(ud);
-    if (obj) delete obj;
+    if (!obj) return 0;
+    *static_cast<T **>(ud) = nullptr;
+    if (detail::points_into(ud, lua_rawlen(L, 1), obj))
+      obj->~T();
+    else
+      delete obj;
     return 0;
   }
 
@@ -538,160 +766,122 @@ private:
     return 0;
   }
 
-  // ---- __index / __newindex ----
-  // 沿 __base 链查找：getter → method → metatable 自身字段 → __base → 递归。
-  static int index_handler(lua_State *L) {
-    const char *key = lua_tostring(L, 2);
-    if (!key) return 0;
-
-    lua_getmetatable(L, 1); // mt（栈顶）
-    for (;;) {
-      // 1. getter
-      lua_getfield(L, -1, "__getters");
-      lua_getfield(L, -1, key);
-      if (!lua_isnil(L, -1)) {
-        lua_pushvalue(L, 1);
-        lua_call(L, 1, 1);
-        return 1;
-      }
-      lua_pop(L, 2);
-
-      // 2. method
-      lua_getfield(L, -1, "__methods");
-      lua_getfield(L, -1, key);
-      if (!lua_isnil(L, -1)) {
-        return 1;
-      }
-      lua_pop(L, 2);
-
-      // 3. metatable 自身字段（如运算符、__name）
-      lua_getfield(L, -1, key);
-      if (!lua_isnil(L, -1)) {
-        return 1;
-      }
-      lua_pop(L, 1);
-
-      // 4. __base 链
-      lua_getfield(L, -1, "__base");
-      if (lua_isnil(L, -1)) {
-        lua_pop(L, 2); // __base nil + mt
-        return 0;
-      }
-      const char *base_name = lua_tostring(L, -1);
-      lua_pop(L, 2); // __base + 当前 mt
-      if (!base_name) return 0;
-      luaL_getmetatable(L, base_name); // 压入 base mt 作为新栈顶
-      if (lua_isnil(L, -1)) {
-        lua_pop(L, 1);
-        return 0;
+  // ---- __clone（spt_clonestate）----
+  // index 2 为克隆出的 userdata（模板块的逐字节副本），index 3 为模板块。
+  // shared：side-registry 随状态复制，仍以模板块为 key；改登记为新块并复制 shared_ptr（refcount++）。
+  // owned：拷贝构造一份，就地对象构造在新块内，堆对象 new T。
+  static int clone_owned(lua_State *L) {
+    void *ud = lua_touserdata(L, 2);
+    void *src = lua_touserdata(L, 3);
+    if (void *sp_ptr = detail::shared_registry_take(L, src)) {
+      auto *sp = new std::shared_ptr<T>(*static_cast<std::shared_ptr<T> *>(sp_ptr));
+      detail::shared_registry_set(L, ud, sp);
+      return 0;
+    }
+    T *obj = *static_cast<T **>(ud);
+    if (!obj)
+      return 0;
+    *static_cast<T **>(ud) = nullptr; // 拷贝失败时 __gc 跳过
+    if constexpr (std::is_copy_constructible_v<T>) {
+      try {
+        if (detail::points_into(src, lua_rawlen(L, 2), obj))
+          obj = new (detail::inline_body<T>(ud)) T(*obj);
+        else
+          obj = new T(*obj);
+      } catch (...) {
+        return detail::propagate_exception(L);
       }
+      *static_cast<T **>(ud) = obj;
+      return 0;
+    } else {
+      luaL_getmetafield(L, 2, "__name");
+      return luaL_error(L, "cannot clone usertype '%s' (not copy-constructible)",
+                        lua_tostring(L, -1));
     }
   }
 
-  static int newindex_handler(lua_State *L) {
-    const char *key = lua_tostring(L, 2);
-    if (!key) return luaL_error(L, "field name must be a string");
-
-    lua_getmetatable(L, 1); // mt（栈顶）
-    for (;;) {
-      lua_getfield(L, -1, "__setters");
-      lua_getfield(L, -1, key);
-      if (!lua_isnil(L, -1)) {
-        lua_pushvalue(L, 1);
-        lua_pushvalue(L, 3);
-        lua_call(L, 2, 0);
-        return 0;
-      }
-      lua_pop(L, 2);
+  // unowned：对象由 C++ 持有，复制指针即可。
+  static int clone_unowned(lua_State *) { return 0; }
 
-      // __base 链
-      lua_getfield(L, -1, "__base");
-      if (lua_isnil(L, -1)) {
-        lua_pop(L, 2);
-        return luaL_error(L, "cannot set field '%s'", key);
-      }
-      const char *base_name = lua_tostring(L, -1);
-      lua_pop(L, 2);
-      if (!base_name)
-        return luaL_error(L, "cannot set field '%s'", key);
-      luaL_getmetatable(L, base_name);
-      if (lua_isnil(L, -1)) {
-        lua_pop(L, 1);
-        return luaL_error(L, "cannot set field '%s'", key);
-      }
+  // 本类型 __fields[name] 处的 entry；不存在则新建（get/set 为空）。推进注册代数。
+  // reset：重新注册整个字段（数据成员 / 属性 getter），清空旧的 get/set 与两份成员指针，
+  // 免得沿用另一种注册留下的 set（例如数据成员改注册为只读属性后，set 会把 getter 的
+  // 成员函数指针当作数据成员指针解读）。
+  detail::member_entry *field_entry(const char *name, bool reset) {
+    luaL_getmetatable(L_, type_name_.c_str());
+    lua_getfield(L_, -1, "__fields");
+    void *e = lua_getfield(L_, -1, name) == LUA_TUSERDATA ? lua_touserdata(L_, -1) : nullptr;
+    lua_pop(L_, 1);
+    if (!e) {
+      e = lua_newuserdatauv(L_, sizeof(detail::member_entry), 0);
+      std::memset(e, 0, sizeof(detail::member_entry));
+      lua_setfield(L_, -2, name);
+    } else if (reset) {
+      std::memset(e, 0, sizeof(detail::member_entry));
     }
+    lua_pop(L_, 2);
+    detail::bump_usertype_epoch(L_);
+    return static_cast<detail::member_entry *>(e);
   }
 
-  // ---- 成员 getter/setter ----
-  template <typename U> static int member_getter(lua_State *L) {
-    T *obj = detail::get_object_ptr<T>(L, 1);
-    if (!obj) return luaL_error(L, "null object in getter");
-
+  // ---- 成员 getter/setter（member_entry 访问函数）----
+  template <typename U>
+  static int member_getter(lua_State *L, void *obj, const detail::member_entry *e) {
     U T::*member;
-    std::memcpy(&member, lua_touserdata(L, lua_upvalueindex(1)), sizeof(member));
-    stack::push(L, obj->*member);
+    std::memcpy(&member, e->getter_data, sizeof(member));
+    stack::push(L, static_cast<T *>(obj)->*member);
     return 1;
   }
 
-  template <typename U> static int member_setter(lua_State *L) {
-    T *obj = detail::get_object_ptr<T>(L, 1);
-    if (!obj) return luaL_error(L, "null object in setter");
-
+  template <typename U>
+  static void member_setter(lua_State *L, void *obj, const detail::member_entry *e) {
     U T::*member;
-    std::memcpy(&member, lua_touserdata(L, lua_upvalueindex(1)), sizeof(member));
-    obj->*member = stack::get<std::decay_t<U>>(L, 2);
-    return 0;
+    std::memcpy(&member, e->getter_data, sizeof(member));
+    static_cast<T *>(obj)->*member = stack::get<std::decay_t<U>>(L, 3);
   }
 
-  // ---- 属性函数 getter/setter wrapper ----
+  // ---- 属性函数 getter/setter ----
   // GetterPtr 形如 R (T::*)() const 或 R (T::*)()
-  template <typename GetterPtr, typename R> static int property_getter(lua_State *L) {
-    T *obj = detail::get_object_ptr<T>(L, 1);
-    if (!obj) return luaL_error(L, "null object in property getter");
+  template <typename GetterPtr, typename R>
+  static int property_getter(lua_State *L, void *obj, const detail::member_entry *e) {
     GetterPtr g;
-    std::memcpy(&g, lua_touserdata(L, lua_upvalueindex(1)), sizeof(g));
+    std::memcpy(&g, e->getter_data, sizeof(g));
     if constexpr (std::is_void_v<R>) {
-      (obj->*g)();
+      (static_cast<T *>(obj)->*g)();
       return 0;
     } else {
-      R result = (obj->*g)();
+      R result = (static_cast<T *>(obj)->*g)();
       stack::push(L, std::move(result));
       return 1;
     }
   }
 
   // SetterPtr 形如 void (T::*)(V)
-  template <typename SetterPtr, typename V> static int property_setter(lua_State *L) {
-    T *obj = detail::get_object_ptr<T>(L, 1);
-    if (!obj) return luaL_error(L, "null object in property setter");
+  template <typename SetterPtr, typename V>
+  static void property_setter(lua_State *L, void *obj, const detail::member_entry *e) {
     SetterPtr s;
-    std::memcpy(&s, lua_touserdata(L, lua_upvalueindex(1)), sizeof(s));
-    V value = stack::get<std::decay_t<V>>(L, 2);
-    (obj->*s)(std::move(value));
-    return 0;
+    std::memcpy(&s, e->setter_data, sizeof(s));
+    V value = stack::get<std::decay_t<V>>(L, 3);
+    (static_cast<T *>(obj)->*s)(std::move(value));
   }
 
   // ---- 属性函数注册 ----
   template <typename R, typename GetterType>
   void register_property_getter(const char *name, GetterType getter) {
-    luaL_getmetatable(L_, type_name_.c_str());
-    lua_getfield(L_, -1, "__getters");
-    void *storage = lua_newuserdatauv(L_, sizeof(GetterType), 0);
-    std::memcpy(storage, &getter, sizeof(getter));
-    lua_pushcclosure(L_, &usertype::property_getter<GetterType, R>, 1);
-    lua_setfield(L_, -2, name);
-    lua_pop(L_, 2);
+    static_assert(sizeof(getter) <= sizeof(detail::member_entry::getter_data),
+                  "member function pointer too large for member_entry");
+    detail::member_entry *e = field_entry(name, true);
+    std::memcpy(e->getter_data, &getter, sizeof(getter));
+    e->get = &usertype::property_getter<GetterType, R>;
   }
 
   template <typename V, typename SetterType>
   void register_property_setter(const char *name, SetterType setter) {
-    luaL_getmetatable(L_, type_name_.c_str());
-    lua_getfield(L_, -1, "__setters");
-    void *storage = lua_newuserdatauv(L_, sizeof(SetterType), 0);
-    std::memcpy(storage, &setter, sizeof(setter));
-    lua_pushcclosure(L_, &usertype::property_setter<SetterType, V>, 1);
-    lua_setfield(L_, -2, name);
-    lua_pop(L_, 2);
+    static_assert(sizeof(setter) <= sizeof(detail::member_entry::setter_data),
+                  "member function pointer too large for member_entry");
+    detail::member_entry *e = field_entry(name, false); // 紧跟同名 getter 注册
+    std::memcpy(e->setter_data, &setter, sizeof(setter));
+    e->set = &usertype::property_setter<SetterType, V>;
   }
 
   // ---- 方法注册 ----
@@ -733,6 +923,7 @@ private:
 
     // unowned metatable 也需共享 __methods（已通过构造时复制，无需重复）
     lua_pop(L_, 2);
+    detail::bump_usertype_epoch(L_);
   }
 
   // ---- 运算符 wrapper ----
@@ -0,0 +1,167 @@
+// test_containers_bulk.cpp - 测试算术元素容器的批量转换与 list_view 零拷贝视图
+
+#include "sptxx.hpp"
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+template <typename T> static bool roundtrip(sptxx::state &lua, const char *name, std::size_t n) {
+  std::vector<T> v(n);
+  for (std::size_t i = 0; i < n; ++i)
+    v[i] = static_cast<T>(i % 7 == 0 ? 0 : i * 3 + 1);
+  lua[name] = v;
+  std::vector<T> back = lua[name].template get<std::vector<T>>();
+  if (back != v) {
+    std::cerr << "FAIL: roundtrip " << name << " size=" << back.size() << "\n";
+    return false;
+  }
+  std::cout << "PASS: roundtrip " << name << " (" << n << " elements)\n";
+  return true;
+}
+
+int main() {
+  try {
+    sptxx::state lua;
+    lua.open_libraries();
+
+    // ---- 1. 各种算术类型往返（直传与经暂存缓冲两条路径，跨多个分段）----
+    if (!roundtrip<int>(lua, "v_int", 1000) || !roundtrip<long long>(lua, "v_ll", 600) ||
+        !roundtrip<double>(lua, "v_double", 700) || !roundtrip<float>(lua, "v_float", 300) ||
+        !roundtrip<short>(lua, "v_short", 600) || !roundtrip<unsigned>(lua, "v_uint", 513) ||
+        !roundtrip<std::uint64_t>(lua, "v_u64", 257))
+      return 1;
+    {
+      std::vector<bool> flags(700);
+      for (std::size_t i = 0; i < flags.size(); ++i)
+        flags[i] = i % 3 == 0;
+      lua["v_bool"] = flags;
+      if (lua["v_bool"].get<std::vector<bool>>() != flags) {
+        std::cerr << "FAIL: roundtrip vector<bool>\n";
+        return 1;
+      }
+      std::cout << "PASS: roundtrip vector<bool>\n";
+    }
+
+    // ---- 2. 批量写入的元素在脚本侧类型正确 ----
+    lua["ints"] = std::vector<int>{5, 6, 7};
+    lua["dbls"] = std::vector<double>{0.5, 1.0};
+    lua.do_string("s = ints[0] + ints[1] + ints[2]; ti = math.type(ints[2]); "
+                  "td = math.type(dbls[1]); n = #ints;");
+    {
+      int s = lua.get_global<int>("s");
+      std::string ti = lua.get_global<std::string>("ti");
+      std::string td = lua.get_global<std::string>("td");
+      int n = lua.get_global<int>("n");
+      if (s != 18 || ti != "integer" || td != "float" || n != 3) {
+        std::cerr << "FAIL: script view s=" << s << " ti=" << ti << " td=" << td << " n=" << n
+                  << "\n";
+        return 1;
+      }
+      std::cout << "PASS: bulk-written elements keep integer/float subtypes\n";
+    }
+
+    // ---- 3. 混合类型：整数可读为 double；非数值元素回退并报错 ----
+    lua.set_function("sum_d", [](std::vector<double> v) {
+      double s = 0;
+      for (double x : v) s += x;
+      return s;
+    });
+    lua.set_function("sum_i", [](std::vector<int> v) {
+      int s = 0;
+      for (int x : v) s += x;
+      return s;
+    });
+    lua.do_string("list<any> mixed = [1, 2.5, 3]; rd = sum_d(mixed);");
+    {
+      double rd = lua.get_global<double>("rd");
+      if (rd != 6.5) { std::cerr << "FAIL: mixed int/float sum=" << rd << "\n"; return 1; }
+      std::cout << "PASS: mixed int/float list → vector<double>: " << rd << "\n";
+    }
+    {
+      bool threw = false;
+      try {
+        lua.do_string("list<any> bad = [1, \"two\", 3]; rb = sum_i(bad);");
+      } catch (const sptxx::error &) {
+        threw = true;
+      }
+      if (!threw) { std::cerr << "FAIL: non-numeric element should raise\n"; return 1; }
+      std::cout << "PASS: non-numeric element still raises\n";
+    }
+
+    // ---- 4. std::array 往返 ----
+    lua["arr"] = std::array<int, 4>{9, 8, 7, 6};
+    {
+      auto a = lua["arr"].get<std::array<int, 4>>();
+      if (a != std::array<int, 4>{9, 8, 7, 6}) { std::cerr << "FAIL: std::array\n"; return 1; }
+      std::cout << "PASS: std::array roundtrip\n";
+    }
+
+    // ---- 5. list_view：零拷贝参数 ----
+    lua.set_function("sum_view", [](sptxx::list_view<double> v) {
+      double s = 0;
+      for (double x : v) s += x;
+      return s;
+    });
+    lua.set_function("max_view", [](sptxx::list_view<int> v) {
+      int m = v.empty() ? 0 : v[0];
+      for (std::size_t i = 1; i < v.size(); ++i)
+        if (v[i] > m) m = v[i];
+      return m;
+    });
+    lua.do_string("list<float> fs = [0.25, 0.5, 0.75, 1.5]; rv = sum_view(fs); "
+                  "list<int> is = [3, 11, -4, 7]; rm = max_view(is);");
+    {
+      double rv = lua.get_global<double>("rv");
+      int rm = lua.get_global<int>("rm");
+      if (rv != 3.0 || rm != 11) {
+        std::cerr << "FAIL: list_view rv=" << rv << " rm=" << rm << "\n";
+        return 1;
+      }
+      std::cout << "PASS: list_view arguments: sum=" << rv << " max=" << rm << "\n";
+    }
+    {
+      bool threw = false;
+      try {
+        lua.do_string("rx = max_view([1, 2.5]);");
+      } catch (const sptxx::error &) {
+        threw = true;
+      }
+      if (!threw) { std::cerr << "FAIL: list_view<int> over floats should raise\n"; return 1; }
+      std::cout << "PASS: list_view rejects mismatched element type\n";
+    }
+
+    // ---- 6. list<T>::view() ----
+    lua["big"] = std::vector<double>(2000, 0.5);
+    {
+      auto big = lua["big"].get<sptxx::list<double>>();
+      auto view = big.view();
+      double s = 0;
+      for (std::size_t i = 0; i < view.size(); ++i)
+        s += view[i];
+      if (view.size() != 2000 || s != 1000.0 || view.at(1999) != 0.5) {
+        std::cerr << "FAIL: list::view size=" << view.size() << " sum=" << s << "\n";
+        return 1;
+      }
+      std::cout << "PASS: list::view over " << view.size() << " elements\n";
+    }
+
+#ifdef SPTXX_HAS_SPAN
+    // ---- 7. std::span push ----
+    {
+      std::vector<int> backing{1, 2, 3, 4, 5, 6};
+      lua["sp"] = std::span<const int>(backing).subspan(2);
+      auto back = lua["sp"].get<std::vector<int>>();
+      if (back != std::vector<int>{3, 4, 5, 6}) { std::cerr << "FAIL: span push\n"; return 1; }
+      std::cout << "PASS: std::span push\n";
+    }
+#endif
+
+    std::cout << "=== All bulk container tests passed! ===\n";
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << "test crashed: " << e.what() << "\n";
+    return 1;
+  }
+}
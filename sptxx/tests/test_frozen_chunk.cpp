@@ -0,0 +1,109 @@
+// test_frozen_chunk.cpp - 测试 frozen_chunk：编译一次，多状态、多线程载入
+
+#include "sptxx.hpp"
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static int failures = 0;
+#define CHECK(cond, msg)                                                                           \
+  do {                                                                                             \
+    if (!(cond)) {                                                                                 \
+      std::cerr << "FAIL: " << msg << " (line " << __LINE__ << ")\n";                              \
+      ++failures;                                                                                  \
+    } else {                                                                                       \
+      std::cout << "PASS: " << msg << "\n";                                                        \
+    }                                                                                              \
+  } while (0)
+
+static const char *module_code = "global int total = 0;\n"
+                                 "global int add(int n) { total = total + n; return total; }\n"
+                                 "global str greet(str who) { return \"hello, \" .. who; }\n";
+
+int main() {
+  try {
+    auto chunk = sptxx::frozen_chunk::compile(module_code, "=module");
+    CHECK(chunk && chunk.size() > 0, "compile once");
+
+    // ---- 1. 载入多个状态，各自独立 ----
+    {
+      sptxx::state a, b;
+      a.open_libraries();
+      b.open_libraries();
+      a.do_frozen(chunk);
+      b.do_frozen(chunk);
+      a.do_string("add(5); add(6);");
+      b.do_string("add(1);");
+      CHECK(a.get_global<int>("total") == 11 && b.get_global<int>("total") == 1,
+            "states are independent");
+      b.do_string("r = greet(\"spt\");");
+      CHECK(b.get_global<std::string>("r") == "hello, spt", "string constants");
+    }
+
+    // ---- 2. 拷贝与移动共享同一块；句柄先于状态销毁 ----
+    {
+      sptxx::state s;
+      {
+        auto copy = chunk;
+        auto moved = std::move(copy);
+        CHECK(!copy.valid() && moved.get() == chunk.get(), "copy and move share the block");
+        auto temp = sptxx::frozen_chunk::compile("global int k = 42;");
+        s.do_frozen(temp);
+      } // temp 在此释放，s 仍持有引用
+      s.do_string("k2 = k + 1;");
+      CHECK(s.get_global<int>("k2") == 43, "state keeps the block alive");
+    }
+
+    // ---- 3. 从栈上冻结；编译错误 ----
+    {
+      sptxx::state s;
+      luaL_loadstring(s.lua_state(), "global int twice(int x) { return x * 2; }");
+      auto f = sptxx::frozen_chunk::from_stack(s.lua_state(), -1, true);
+      lua_pop(s.lua_state(), 1);
+      sptxx::state t;
+      t.do_frozen(f);
+      t.do_string("v = twice(21);");
+      CHECK(t.get_global<int>("v") == 42, "freeze from the stack (stripped)");
+
+      bool threw = false;
+      try {
+        sptxx::frozen_chunk::compile("global int = ;");
+      } catch (const sptxx::runtime_error &) {
+        threw = true;
+      }
+      CHECK(threw, "syntax error raises");
+    }
+
+    // ---- 4. 多线程同时载入同一块 ----
+    {
+      std::atomic<int> ok{0};
+      std::vector<std::thread> threads;
+      for (int t = 0; t < 8; ++t)
+        threads.emplace_back([&, t] {
+          for (int i = 0; i < 20; ++i) {
+            sptxx::state s;
+            s.open_libraries();
+            s.do_frozen(chunk);
+            s.do_string(("r = add(" + std::to_string(t) + ");").c_str());
+            if (s.get_global<int>("r") == t)
+              ++ok;
+          }
+        });
+      for (auto &th : threads)
+        th.join();
+      CHECK(ok == 160, "concurrent loads");
+    }
+
+    if (failures == 0) {
+      std::cout << "=== All frozen_chunk tests passed! ===\n";
+      return 0;
+    }
+    std::cerr << "=== " << failures << " test(s) FAILED ===\n";
+    return 1;
+  } catch (const std::exception &e) {
+    std::cerr << "test crashed: " << e.what() << "\n";
+    return 1;
+  }
+}
@@ -0,0 +1,130 @@
+// test_function_static.cpp - 测试 fn<&f> 静态绑定、无状态 functor 与共享 __gc metatable
+
+#include "sptxx.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+static int failures = 0;
+#define CHECK(cond, msg)                                                                           \
+  do {                                                                                             \
+    if (!(cond)) {                                                                                 \
+      std::cerr << "FAIL: " << msg << " (line " << __LINE__ << ")\n";                              \
+      ++failures;                                                                                  \
+    } else {                                                                                       \
+      std::cout << "PASS: " << msg << "\n";                                                        \
+    }                                                                                              \
+  } while (0)
+
+static int add(int a, int b) { return a + b; }
+static double half(double x) noexcept { return x / 2; }
+static std::string shout(const std::string &s) { return s + "!"; }
+static int fail(int) { throw std::runtime_error("boom"); }
+
+struct Twice {
+  int operator()(int x) const { return 2 * x; }
+};
+
+static int alive = 0;
+struct Tracker {
+  Tracker() { ++alive; }
+  Tracker(const Tracker &) { ++alive; }
+  ~Tracker() { --alive; }
+};
+
+static auto make_counter(int start) {
+  return [n = start, t = Tracker{}]() mutable { return n++; };
+}
+
+// 栈顶函数的 upvalue 数（C 函数 upvalue 名为 ""）
+static int upvalue_count(lua_State *L) {
+  int n = 0;
+  while (lua_getupvalue(L, -1, n + 1)) {
+    lua_pop(L, 1);
+    ++n;
+  }
+  return n;
+}
+
+int main() {
+  try {
+    sptxx::state lua;
+    lua.open_libraries();
+    lua_State *L = lua.lua_state();
+
+    // ---- 1. fn<&f>：无 upvalue 的 lua_CFunction ----
+    lua.set_function("add", sptxx::fn<&add>{});
+    lua.set_function("half", sptxx::fn<&half>{});
+    lua.set_function("shout", sptxx::fn<&shout>{});
+    lua.do_string("r1 = add(2, 3); r2 = half(5.0); r3 = shout('hi');");
+    CHECK(lua.get_global<int>("r1") == 5, "fn<&add>");
+    CHECK(lua.get_global<double>("r2") == 2.5, "fn<&half> (noexcept)");
+    CHECK(lua.get_global<std::string>("r3") == "hi!", "fn<&shout>");
+    lua_getglobal(L, "add");
+    CHECK(lua_iscfunction(L, -1) && upvalue_count(L) == 0, "fn<&add> has no upvalue");
+    lua_pop(L, 1);
+
+    // ---- 2. 异常经静态 trampoline 传播 ----
+    lua.set_function("fail", sptxx::fn<&fail>{});
+    {
+      bool threw = false;
+      try {
+        lua.do_string("fail(1);");
+      } catch (const sptxx::error &e) {
+        threw = std::string(e.what()).find("boom") != std::string::npos;
+      }
+      CHECK(threw, "exception from fn<&fail> propagates");
+    }
+
+    // ---- 3. 可默认构造的空 functor：无 upvalue ----
+    lua.set_function("twice", Twice{});
+    lua.do_string("r4 = twice(21);");
+    CHECK(lua.get_global<int>("r4") == 42, "empty functor");
+    lua_getglobal(L, "twice");
+    CHECK(upvalue_count(L) == 0, "empty functor has no upvalue");
+    lua_pop(L, 1);
+
+    // ---- 4. 普通函数指针与无捕获 lambda：userdata 无 metatable ----
+    lua.set_function("addp", &add);
+    lua.set_function("neg", [](int x) { return -x; });
+    lua.do_string("r5 = addp(1, 1) + neg(7);");
+    CHECK(lua.get_global<int>("r5") == -5, "runtime function pointer and lambda");
+    lua_getglobal(L, "addp");
+    lua_getupvalue(L, -1, 1);
+    CHECK(lua_isuserdata(L, -1) && !lua_getmetatable(L, -1), "trivial functor has no __gc");
+    lua_pop(L, 2);
+
+    // ---- 5. 有状态 functor：同类型共享一个 __gc metatable，GC 时析构 ----
+    lua.set_function("c1", make_counter(10));
+    lua.set_function("c2", make_counter(100));
+    lua.do_string("c1(); r6 = c1() + c2();");
+    CHECK(lua.get_global<int>("r6") == 111, "stateful functors keep separate state");
+    lua_getglobal(L, "c1");
+    lua_getupvalue(L, -1, 1);
+    lua_getmetatable(L, -1);
+    lua_getglobal(L, "c2");
+    lua_getupvalue(L, -1, 1);
+    lua_getmetatable(L, -1);
+    CHECK(lua_istable(L, -1) && lua_rawequal(L, -1, -4), "one metatable per functor type");
+    lua_pop(L, 6);
+    CHECK(alive == 2, "two live captured trackers");
+    lua.do_string("c1 = null; c2 = null;");
+    lua_gc(L, LUA_GCCOLLECT);
+    CHECK(alive == 0, "captures destroyed by shared __gc");
+
+    // ---- 6. set_static 同样接受 fn<&f> ----
+    lua.new_usertype<Twice>("Math").set_static("add", sptxx::fn<&add>{});
+    lua.do_string("r7 = Math.add(4, 5);");
+    CHECK(lua.get_global<int>("r7") == 9, "set_static with fn<&add>");
+
+    if (failures == 0) {
+      std::cout << "=== All static function binding tests passed! ===\n";
+      return 0;
+    }
+    std::cerr << "=== " << failures << " test(s) FAILED ===\n";
+    return 1;
+  } catch (const std::exception &e) {
+    std::cerr << "test crashed: " << e.what() << "\n";
+    return 1;
+  }
+}
@@ -0,0 +1,166 @@
+// test_overload_dispatch.cpp - 测试重载决议：精确匹配优先、转换回退、usertype 实参区分、克隆状态
+
+#include "sptxx.hpp"
+#include <iostream>
+#include <string>
+
+static int failures = 0;
+#define CHECK(cond, msg)                                                                           \
+  do {                                                                                             \
+    if (!(cond)) {                                                                                 \
+      std::cerr << "FAIL: " << msg << " (line " << __LINE__ << ")\n";                              \
+      ++failures;                                                                                  \
+    } else {                                                                                       \
+      std::cout << "PASS: " << msg << "\n";                                                        \
+    }                                                                                              \
+  } while (0)
+
+struct Shape {
+  int side = 2;
+  Shape() = default;
+  Shape(int s) : side(s) {}
+};
+struct Square : Shape {
+  Square(int s) : Shape(s) {}
+};
+struct Point {
+  int x = 0;
+  Point() = default;
+};
+
+// usertype 实参以 T* 形参接收（userdata 开头是 T*）
+namespace sptxx {
+template <> struct getter<Shape *> {
+  static Shape *get(lua_State *L, int index) { return *static_cast<Shape **>(lua_touserdata(L, index)); }
+};
+template <> struct getter<Square *> {
+  static Square *get(lua_State *L, int index) {
+    return *static_cast<Square **>(lua_touserdata(L, index));
+  }
+};
+template <> struct getter<Point *> {
+  static Point *get(lua_State *L, int index) { return *static_cast<Point **>(lua_touserdata(L, index)); }
+};
+} // namespace sptxx
+
+static std::string run(sptxx::state &lua, const char *code) {
+  lua.do_string(code);
+  return lua.get_global<std::string>("r");
+}
+
+static void register_shapes(sptxx::state &lua) {
+  auto shape = lua.new_usertype<Shape>("Shape");
+  shape.constructor<int>();
+  auto square = lua.new_usertype<Square>("Square");
+  square.constructor<int>();
+  square.base<Shape>("Shape");
+  auto point = lua.new_usertype<Point>("Point");
+  point.constructor<>();
+  lua.set_function("area", sptxx::overload(
+                               [](Point *) -> std::string { return "point"; },
+                               [](Shape *s) -> std::string { return "shape " + std::to_string(s->side); },
+                               [](Square *s) -> std::string { return "square " + std::to_string(s->side); }));
+}
+
+int main() {
+  try {
+    sptxx::state lua;
+    lua.open_libraries();
+
+    // ---- 1. 精确匹配优先于声明顺序在前的转换匹配 ----
+    lua.set_function("mix", sptxx::overload(
+                                [](const std::string &s) -> std::string { return "str " + s; },
+                                [](double a, double b) -> std::string { return "dd " + std::to_string(a + b); },
+                                [](int a, int b) -> std::string { return "ii " + std::to_string(a + b); },
+                                [](int a) -> std::string { return "int " + std::to_string(a); }));
+    CHECK(run(lua, "r = mix(5);") == "int 5", "integer picks (int) over earlier (string)");
+    CHECK(run(lua, "r = mix(\"x\");") == "str x", "string picks (string)");
+    CHECK(run(lua, "r = mix(1, 2);") == "ii 3", "two integers pick (int, int) over earlier (double, double)");
+    CHECK(run(lua, "r = mix(1.5, 2);").rfind("dd 3.5", 0) == 0, "float and integer fall back to (double, double)");
+    CHECK(run(lua, "r = mix(2.5);").rfind("str 2.5", 0) == 0, "float converts to the string overload");
+
+    // ---- 2. 无精确匹配时按声明顺序取第一个可转换的 ----
+    lua.set_function("conv", sptxx::overload(
+                                 [](double d) -> std::string { return "double " + std::to_string(static_cast<int>(d)); },
+                                 [](bool) -> std::string { return "bool"; }));
+    CHECK(run(lua, "r = conv(\"42\");") == "double 42", "numeric string converts to double");
+    CHECK(run(lua, "r = conv(7);") == "double 7", "integer converts to double");
+    CHECK(run(lua, "r = conv(false);") == "bool", "bool is exact");
+    bool threw = false;
+    try {
+      lua.do_string("r = conv(\"abc\");");
+    } catch (const std::exception &) {
+      threw = true;
+    }
+    CHECK(threw, "non-numeric string has no matching overload");
+
+    // ---- 3. 变参：个数恰好匹配的固定参数候选优先 ----
+    lua.set_function("va", sptxx::overload(
+                               [](int, sptxx::variadic_args rest) -> std::string {
+                                 return "va " + std::to_string(rest.size());
+                               },
+                               [](int, int) -> std::string { return "fixed"; }));
+    CHECK(run(lua, "r = va(1, 2);") == "fixed", "fixed arity beats variadic");
+    CHECK(run(lua, "r = va(1, 2, 3);") == "va 2", "variadic takes the rest");
+    CHECK(run(lua, "r = va(1);") == "va 0", "variadic with no extras");
+
+    // ---- 4. usertype 实参：按 metatable 区分，派生类对象回退到基类 ----
+    register_shapes(lua);
+    CHECK(run(lua, "r = area(Square(3));") == "square 3", "derived object picks its own overload");
+    CHECK(run(lua, "r = area(Shape(4));") == "shape 4", "base object skips the derived overload");
+    CHECK(run(lua, "r = area(Point());") == "point", "unrelated usertype");
+    lua.set_function("base_only", sptxx::overload(
+                                      [](Point *) -> std::string { return "point"; },
+                                      [](Shape *s) -> std::string { return "shape " + std::to_string(s->side); }));
+    CHECK(run(lua, "r = base_only(Square(5));") == "shape 5", "derived object converts to base overload");
+    threw = false;
+    try {
+      lua.do_string("r = base_only(io.stdout);");
+    } catch (const std::exception &) {
+      threw = true;
+    }
+    CHECK(threw, "foreign userdata matches no usertype overload");
+
+    // ---- 5. 方法重载 ----
+    struct Acc {
+      int total = 0;
+      Acc() = default;
+      int add(int x) { return total += x; }
+      int add(double x) { return total += static_cast<int>(x * 10); }
+      int add(const std::string &s) { return total += static_cast<int>(s.size()); }
+    };
+    auto acc = lua.new_usertype<Acc>("Acc");
+    acc.constructor<>();
+    acc.set_overload("add", static_cast<int (Acc::*)(const std::string &)>(&Acc::add),
+                     static_cast<int (Acc::*)(double)>(&Acc::add),
+                     static_cast<int (Acc::*)(int)>(&Acc::add));
+    lua.do_string("a = Acc(); t1 = a.add(5); t2 = a.add(0.5); t3 = a.add(\"abc\");");
+    CHECK(lua.get_global<int>("t1") == 5 && lua.get_global<int>("t2") == 10 &&
+              lua.get_global<int>("t3") == 13,
+          "method overloads pick exact parameter kinds");
+
+    // ---- 6. 克隆状态：缓存的 metatable 在新状态中重新取得 ----
+    {
+      sptxx::state_pool pool(
+          [](sptxx::state &t) {
+            t.open_libraries();
+            register_shapes(t);
+            t.do_string("warm = area(Square(1));");
+          },
+          1);
+      auto s = pool.acquire();
+      CHECK(run(*s, "r = area(Square(6));") == "square 6", "usertype overload in a cloned state");
+      CHECK(run(*s, "r = area(Shape(7));") == "shape 7", "base overload in a cloned state");
+    }
+
+    if (failures == 0) {
+      std::cout << "=== All overload dispatch tests passed! ===\n";
+      return 0;
+    }
+    std::cerr << "=== " << failures << " test(s) FAILED ===\n";
+    return 1;
+  } catch (const std::exception &e) {
+    std::cerr << "test crashed: " << e.what() << "\n";
+    return 1;
+  }
+}
@@ -0,0 +1,143 @@
+// test_pinned_access.cpp - 测试 list<T>::pin() / map<V>::pin() 固定访问器
+
+#include "sptxx.hpp"
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+static void expect(bool cond, const char *what) {
+  if (!cond)
+    throw std::runtime_error(std::string("FAIL: ") + what);
+  std::cout << "PASS: " << what << "\n";
+}
+
+int main() {
+  try {
+    sptxx::state lua;
+    lua.open_libraries();
+    lua_State *L = lua.lua_state();
+    int top = lua_gettop(L);
+
+    std::cout << "=== Testing pinned list/map access ===\n";
+
+    // ---- 1. 整数 List：直接读存储 + 随机访问迭代器 ----
+    lua.do_string("global list<int> sorted = []; "
+                  "for (int i = 0, 999) { list.push(sorted, i * 2); }");
+    {
+      auto lst = lua.get_global<sptxx::list<int>>("sorted");
+      auto pin = lst.pin();
+      expect(pin.size() == 1000 && pin[0] == 0 && pin[999] == 1998, "pinned int list reads");
+      long long sum = 0;
+      for (int x : pin)
+        sum += x;
+      expect(sum == 999000, "range-for over pinned list");
+      auto it = std::lower_bound(pin.begin(), pin.end(), 777);
+      expect(it - pin.begin() == 389 && *it == 778, "std::lower_bound on random-access iterator");
+      expect(*(pin.end() - 1) == 1998 && pin.begin()[10] == 20 && (2 + pin.begin())[0] == 4,
+             "iterator arithmetic");
+      pin.set(5, -1);
+      expect(pin[5] == -1, "set through pin is visible to direct reads");
+      bool threw = false;
+      try {
+        pin.at(1000);
+      } catch (const sptxx::error &) {
+        threw = true;
+      }
+      expect(threw, "at() checks bounds");
+    }
+    expect(lua_gettop(L) == top, "stack restored after list pin");
+    lua.do_string("check5 = sorted[5];");
+    expect(lua.get_global<int>("check5") == -1, "script sees value written through pin");
+
+    // ---- 2. 混合整数/浮点的 List<double> 与字符串 List：逐元素路径 ----
+    lua.do_string("global list<any> mixed = [1, 2.5, 4]; "
+                  "global list<str> words = ['a', 'bb', 'ccc'];");
+    {
+      auto mixed = lua.get_global<sptxx::list<double>>("mixed");
+      auto pin = mixed.pin();
+      expect(std::accumulate(pin.begin(), pin.end(), 0.0) == 7.5,
+             "mixed numeric list via lua_geti");
+      auto words = lua.get_global<sptxx::list<std::string>>("words");
+      auto wp = words.pin();
+      std::string joined;
+      for (std::string w : wp)
+        joined += w;
+      expect(joined == "abbccc", "string list via lua_geti");
+      expect(lua_gettop(L) == top + 2, "two pins occupy two stack slots");
+    }
+    expect(lua_gettop(L) == top, "stack restored after nested pins");
+
+    // ---- 3. list::get/set 单次 registry 访问后行为不变 ----
+    {
+      auto lst = lua.create_list<int>(0);
+      lst.push_back(10);
+      lst.push_back(20);
+      lst.set(1, 21);
+      bool threw = false;
+      try {
+        lst.get(2);
+      } catch (const sptxx::error &) {
+        threw = true;
+      }
+      expect(lst.size() == 2 && lst.get(0) == 10 && lst.get(1) == 21 && threw,
+             "list get/set/push_back and bounds check");
+      expect(lua_gettop(L) == top, "stack balanced after out-of-range get");
+    }
+
+    // ---- 4. Map 固定遍历 ----
+    auto m = lua.create_map<int>();
+    for (int i = 0; i < 100; ++i)
+      m.set<std::string>("k" + std::to_string(i), i);
+    {
+      auto pin = m.pin();
+      int count = 0, sum = 0;
+      for (const auto &[key, value] : pin) {
+        count++;
+        sum += value;
+        if (key != "k" + std::to_string(value))
+          throw std::runtime_error("FAIL: key/value mismatch for " + key);
+      }
+      expect(count == 100 && sum == 4950, "range-for over pinned map");
+      expect(lua_gettop(L) == top + 1, "finished iteration leaves only the table");
+
+      for (auto it = pin.begin(); it != pin.end(); ++it) {
+        if (it->second >= 0)
+          break; // 提前结束：迭代器析构弹出键
+      }
+      expect(lua_gettop(L) == top + 1, "early break pops the pending key");
+
+      expect(pin.get("k42") == 42 && pin.contains("k7") && !pin.contains("nope") &&
+                 !pin.try_get("nope").has_value(),
+             "pinned lookups");
+      for (const auto &kv : pin)
+        pin.set(kv.first, kv.second * 2); // 改已有键的值
+      expect(pin.get("k10") == 20, "set existing keys during iteration");
+    }
+    expect(lua_gettop(L) == top && m.get("k99") == 198, "stack restored after map pin");
+
+    // ---- 5. 非字符串键 ----
+    lua.do_string("global map<int, int> sq = {}; for (int i = 1, 10) { sq[i] = i * i; }");
+    {
+      auto sq = lua.get_global<sptxx::map<int>>("sq");
+      auto pin = sq.pin();
+      std::map<int, int> seen;
+      for (const auto &[k, v] : pin.items<int>())
+        seen[k] = v;
+      expect(seen.size() == 10 && seen[7] == 49, "items<int>() over integer keys");
+      int n = 0;
+      for (const auto &kv : pin) // 整数键按 std::string 读取不会破坏 lua_next
+        n += kv.first.empty() ? 0 : 1;
+      expect(n == 10, "string view of integer keys keeps iteration intact");
+    }
+    expect(lua_gettop(L) == top, "stack restored after integer-key map pin");
+
+    std::cout << "=== All pinned access tests passed! ===\n";
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+}
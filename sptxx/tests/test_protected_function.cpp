@@ -0,0 +1,191 @@
+// test_protected_function.cpp - 测试 protected_function 句柄、call_each 与调用统计
+
+#include "sptxx.hpp"
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <tuple>
+#include <vector>
+
+static int failures = 0;
+#define CHECK(cond, msg)                                                                           \
+  do {                                                                                             \
+    if (!(cond)) {                                                                                 \
+      std::cerr << "FAIL: " << msg << " (line " << __LINE__ << ")\n";                              \
+      ++failures;                                                                                  \
+    } else {                                                                                       \
+      std::cout << "PASS: " << msg << "\n";                                                        \
+    }                                                                                              \
+  } while (0)
+
+int main() {
+  try {
+    sptxx::state lua;
+    lua.open_libraries();
+    lua_State *L = lua.lua_state();
+    int top = lua_gettop(L);
+
+    lua.do_string("global int add(int a, int b) { return a + b; }\n"
+                  "global int square(int x) { return x * x; }\n"
+                  "divmod = fn(int a, int b) -> vars { return a / b - a % b / b, a % b; };\n"
+                  "global int seen = 0;\n"
+                  "global void touch(int x) { seen = seen + x; }\n"
+                  "global int boom(int x) { if (x == 3) { error('bad ' .. x); } return x; }\n");
+
+    // ---- 1. 基本调用与多返回值 ----
+    auto add = lua.get_protected_function<int(int, int)>("add");
+    auto divmod = lua.get_protected_function<std::tuple<int, int>(int, int)>("divmod");
+    int sum = 0;
+    for (int i = 0; i < 1000; ++i)
+      sum = add(sum, 1);
+    CHECK(sum == 1000, "repeated calls");
+    CHECK(divmod(17, 5) == std::make_tuple(3, 2), "multiple returns");
+    CHECK(add.stats().calls == 1000 && add.stats().errors == 0, "call counter");
+    CHECK(lua_gettop(L) == top && lua_gettop(add.thread()) == 2, "stacks balanced");
+
+    // ---- 2. 原全局被改写后，句柄仍指向固定的闭包 ----
+    lua.do_string("add = null;");
+    CHECK(add(2, 3) == 5, "handle keeps the pinned closure");
+
+    // ---- 3. 错误：带 traceback，统计错误数，线程栈复原 ----
+    auto boom = lua.get_protected_function<int(int)>("boom");
+    {
+      std::string msg;
+      try {
+        boom(3);
+      } catch (const sptxx::runtime_error &e) {
+        msg = e.what();
+      }
+      CHECK(msg.find("bad 3") != std::string::npos && msg.find("traceback") != std::string::npos,
+            "error message with traceback");
+      CHECK(boom.stats().errors == 1 && lua_gettop(boom.thread()) == 2,
+            "error counted, stack reset");
+      CHECK(boom(4) == 4, "handle usable after error");
+    }
+
+    // ---- 4. call_each：输出迭代器与丢弃返回值 ----
+    auto square = lua.get_protected_function<int(int)>("square");
+    std::vector<int> in{1, 2, 3, 4, 5}, out;
+    square.call_each(in, std::back_inserter(out));
+    CHECK(out == std::vector<int>({1, 4, 9, 16, 25}), "call_each collects results");
+    auto touch = lua.get_protected_function<void(int)>("touch");
+    touch.call_each(std::vector<short>{10, 20, 30});
+    CHECK(lua.get_global<int>("seen") == 60, "call_each with converted elements");
+    {
+      std::vector<int> got;
+      std::string msg;
+      try {
+        boom.call_each(std::vector<int>{1, 2, 3, 4}, std::back_inserter(got));
+      } catch (const sptxx::runtime_error &e) {
+        msg = e.what();
+      }
+      CHECK(got == std::vector<int>({1, 2}) && msg.find("element 2") != std::string::npos,
+            "call_each stops at the failing element");
+    }
+
+    // ---- 5. 计时 ----
+    square.reset_stats();
+    square.enable_timing(true);
+    for (int i = 0; i < 100; ++i)
+      square(i);
+    const auto &st = square.stats();
+    CHECK(st.calls == 100 && st.total_ns > 0 && st.max_ns > 0 && st.max_ns <= st.total_ns &&
+              st.mean_ns() > 0,
+          "latency counters");
+
+    // ---- 6. 重入：被调函数经 C++ 再次调用同一句柄 ----
+    auto fact_holder = std::make_shared<sptxx::protected_function<int(int)>>();
+    lua.set_function("cxx_fact",
+                     [fact_holder](int n) { return n <= 1 ? 1 : n * (*fact_holder)(n - 1); });
+    lua.do_string("global int fact(int n) { return cxx_fact(n); }");
+    *fact_holder = lua.get_protected_function<int(int)>("fact");
+    CHECK((*fact_holder)(6) == 720, "re-entrant calls on the same handle");
+    CHECK(lua_gettop(fact_holder->thread()) == 2, "thread stack balanced after re-entry");
+
+    // ---- 7. 作为 C++ 回调参数接收 ----
+    lua.set_function("apply_twice",
+                     [](sptxx::protected_function<int(int)> f, int x) { return f(f(x)); });
+    lua.do_string("r7 = apply_twice(square, 3);");
+    CHECK(lua.get_global<int>("r7") == 81, "protected_function as a parameter");
+
+    // ---- 8. 移动与失效 ----
+    auto moved = std::move(square);
+    CHECK(moved(7) == 49 && !square.valid(), "move transfers the handle");
+    {
+      bool threw = false;
+      try {
+        lua.get_protected_function<void()>("missing_fn");
+      } catch (const sptxx::error &) {
+        threw = true;
+      }
+      CHECK(threw, "missing global raises");
+    }
+
+    // ---- 9. 返回值类型不符：抛 type_error，固定的处理函数与被调函数不受影响 ----
+    lua.do_string("maybe = fn(int x) -> any {\n"
+                  "  if (x == 0) { return 'str'; } return x;\n"
+                  "};\n"
+                  "pair = fn(int x) -> vars {\n"
+                  "  if (x == 0) { return x, true; } return x, 'p' .. x;\n"
+                  "};\n"
+                  "vec = fn(int x) -> any { if (x == 0) { return 'str'; } return [x, x]; };");
+    {
+      auto maybe = lua.get_protected_function<int(int)>("maybe");
+      std::string msg;
+      try {
+        maybe(0);
+      } catch (const sptxx::type_error &e) {
+        msg = e.what();
+      }
+      CHECK(msg.find("result 1") != std::string::npos && msg.find("string") != std::string::npos,
+            "wrong return type raises type_error");
+      CHECK(maybe.stats().errors == 1 && lua_gettop(maybe.thread()) == 2,
+            "conversion error counted, stack reset");
+      CHECK(maybe(5) == 5, "pinned function survives a conversion error");
+
+      auto pair = lua.get_protected_function<std::tuple<int, std::string>(int)>("pair");
+      bool threw = false;
+      try {
+        pair(0);
+      } catch (const sptxx::type_error &) {
+        threw = true;
+      }
+      CHECK(threw && pair(2) == std::make_tuple(2, std::string("p2")),
+            "wrong type in a multiple return");
+
+      // 无法预先判断的类型在受保护调用内转换
+      auto vec = lua.get_protected_function<std::vector<int>(int)>("vec");
+      threw = false;
+      try {
+        vec(0);
+      } catch (const sptxx::type_error &) {
+        threw = true;
+      }
+      CHECK(threw && lua_gettop(vec.thread()) == 2, "container result checked under pcall");
+      CHECK(vec(3) == std::vector<int>({3, 3}), "container result converts");
+
+      std::vector<int> got;
+      msg.clear();
+      try {
+        maybe.call_each(std::vector<int>{1, 0, 2}, std::back_inserter(got));
+      } catch (const sptxx::type_error &e) {
+        msg = e.what();
+      }
+      CHECK(got == std::vector<int>({1}) && msg.find("element 1") != std::string::npos,
+            "call_each reports the element with the bad result");
+    }
+
+    fact_holder.reset();
+    CHECK(lua_gettop(L) == top, "main stack untouched");
+
+    if (failures == 0) {
+      std::cout << "=== All protected_function tests passed! ===\n";
+      return 0;
+    }
+    std::cerr << "=== " << failures << " test(s) FAILED ===\n";
+    return 1;
+  } catch (const std::exception &e) {
+    std::cerr << "test crashed: " << e.what() << "\n";
+    return 1;
+  }
+}
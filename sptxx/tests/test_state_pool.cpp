@@ -0,0 +1,182 @@
+// test_state_pool.cpp - 测试 state_pool：模板克隆、隔离、C++ 对象拷贝、并发取用
+
+#include "sptxx.hpp"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+static int failures = 0;
+#define CHECK(cond, msg)                                                                           \
+  do {                                                                                             \
+    if (!(cond)) {                                                                                 \
+      std::cerr << "FAIL: " << msg << " (line " << __LINE__ << ")\n";                              \
+      ++failures;                                                                                  \
+    } else {                                                                                       \
+      std::cout << "PASS: " << msg << "\n";                                                        \
+    }                                                                                              \
+  } while (0)
+
+static std::atomic<int> live{0};
+
+struct Vec2 {
+  int x, y;
+  Vec2(int x_, int y_) : x(x_), y(y_) { ++live; }
+  Vec2(const Vec2 &o) : x(o.x), y(o.y) { ++live; }
+  ~Vec2() { --live; }
+  int dot() const { return x * x + y * y; }
+};
+
+struct Config {
+  char blob[1024] = {};
+  int level = 3;
+};
+
+struct Unique {
+  std::unique_ptr<int> p = std::make_unique<int>(1);
+};
+
+static void init_template(sptxx::state &lua, std::shared_ptr<int> token) {
+  lua.open_libraries();
+  auto uv = lua.new_usertype<Vec2>("Vec2");
+  uv.constructor<int, int>();
+  uv.set("x", &Vec2::x);
+  uv.set("dot", &Vec2::dot);
+  auto uc = lua.new_usertype<Config>("Config");
+  uc.constructor<>();
+  uc.set("level", &Config::level);
+  std::string prefix = "req-";
+  lua.set_function("tag", [prefix, token](int n) { return prefix + std::to_string(n); });
+  lua.do_string("global int hits = 0;\n"
+                "global int handle(int n) { hits = hits + n; return hits; }\n"
+                "origin = Vec2(3, 4);\n"
+                "cfg = Config();\n");
+}
+
+int main() {
+  try {
+    auto token = std::make_shared<int>(0);
+
+    // ---- 1. 预克隆 ----
+    {
+      sptxx::state_pool pool([&](sptxx::state &lua) { init_template(lua, token); }, 3);
+      CHECK(pool.ready() == 3 && pool.capacity() == 3, "pool prefilled");
+      CHECK(live == 4, "usertype objects copied into each clone");
+      CHECK(token.use_count() == 5, "bound lambda copied into each clone");
+
+      // ---- 2. 克隆可用：脚本函数、C++ 函数、usertype 字段与方法 ----
+      {
+        auto a = pool.acquire();
+        CHECK(a && pool.ready() == 2, "acquire takes a ready state");
+        a->do_string("r1 = handle(5); t1 = tag(7); d1 = origin.dot(); origin.x = 10;"
+                     "l1 = cfg.level; v1 = Vec2(1, 1).dot();");
+        CHECK(a->get_global<int>("r1") == 5 && a->get_global<std::string>("t1") == "req-7",
+              "script and C++ functions in clone");
+        CHECK(a->get_global<int>("d1") == 25 && a->get_global<int>("l1") == 3 &&
+                  a->get_global<int>("v1") == 2,
+              "usertype dispatch in clone");
+
+        // ---- 3. 隔离：另一个克隆看不到 a 的修改 ----
+        auto b = pool.acquire();
+        b->do_string("r2 = handle(1); x2 = origin.x;");
+        CHECK(b->get_global<int>("r2") == 1 && b->get_global<int>("x2") == 3,
+              "clones are isolated");
+      }
+      CHECK(live == 2 && token.use_count() == 3, "closing a lease releases its C++ objects");
+
+      // ---- 4. 池空时当场克隆，refill 补足 ----
+      {
+        auto c = pool.acquire();
+        auto d = pool.acquire();
+        CHECK(pool.ready() == 0 && d.lua_state() != nullptr, "acquire clones on demand");
+        CHECK(pool.refill() == 3 && pool.ready() == 3, "refill tops up");
+      }
+
+      // ---- 5. lease 可比池活得久 ----
+      sptxx::lease kept = pool.acquire();
+      sptxx::lease moved = std::move(kept);
+      CHECK(!kept.valid() && moved.valid(), "lease is movable");
+      // 内层池先析构，moved 仍持有它的模板
+      {
+        sptxx::state_pool inner([&](sptxx::state &lua) { init_template(lua, token); });
+        moved = inner.acquire();
+      }
+      moved->do_string("r5 = handle(2) + origin.dot();");
+      CHECK(moved->get_global<int>("r5") == 27, "lease outlives its pool");
+    }
+    CHECK(live == 0 && token.use_count() == 1, "everything released");
+
+    // ---- 6. 不可拷贝的 usertype 让克隆失败 ----
+    {
+      sptxx::state_pool pool([](sptxx::state &lua) {
+        auto u = lua.new_usertype<Unique>("Unique");
+        u.constructor<>();
+        lua.do_string("u = Unique();");
+      });
+      std::string msg;
+      try {
+        pool.acquire();
+      } catch (const sptxx::error &e) {
+        msg = e.what();
+      }
+      CHECK(msg.find("not copy-constructible") != std::string::npos, "non-copyable usertype");
+    }
+
+    // ---- 7. 多线程取用与后台补充 ----
+    {
+      sptxx::state_pool pool([&](sptxx::state &lua) { init_template(lua, token); }, 8);
+      std::atomic<int> ok{0};
+      std::vector<std::thread> threads;
+      for (int t = 0; t < 4; ++t)
+        threads.emplace_back([&] {
+          for (int i = 0; i < 25; ++i) {
+            auto l = pool.acquire();
+            l->do_string("r = handle(3);");
+            if (l->get_global<int>("r") == 3)
+              ++ok;
+          }
+        });
+      threads.emplace_back([&] {
+        for (int i = 0; i < 20; ++i)
+          pool.refill();
+      });
+      for (auto &th : threads)
+        th.join();
+      CHECK(ok == 100, "concurrent acquire and refill");
+    }
+    CHECK(live == 0 && token.use_count() == 1, "nothing leaked across threads");
+
+    // ---- 8. 耗时对比（仅输出）----
+    {
+      using clock = std::chrono::steady_clock;
+      sptxx::state_pool pool([&](sptxx::state &lua) { init_template(lua, token); });
+      auto t0 = clock::now();
+      for (int i = 0; i < 100; ++i)
+        pool.acquire();
+      auto t1 = clock::now();
+      for (int i = 0; i < 100; ++i) {
+        sptxx::state lua;
+        init_template(lua, token);
+      }
+      auto t2 = clock::now();
+      auto us = [](clock::duration d) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(d).count() / 100.0;
+      };
+      std::cout << "clone " << us(t1 - t0) << " us/state, fresh init " << us(t2 - t1)
+                << " us/state\n";
+    }
+
+    if (failures == 0) {
+      std::cout << "=== All state_pool tests passed! ===\n";
+      return 0;
+    }
+    std::cerr << "=== " << failures << " test(s) FAILED ===\n";
+    return 1;
+  } catch (const std::exception &e) {
+    std::cerr << "test crashed: " << e.what() << "\n";
+    return 1;
+  }
+}
@@ -0,0 +1,179 @@
+// test_usertype_dispatch.cpp - 测试 usertype 展平分派：字段/属性/方法/继承与注册后重建
+
+#include "sptxx.hpp"
+#include <iostream>
+#include <string>
+
+static int failures = 0;
+#define CHECK(cond, msg)                                                                           \
+  do {                                                                                             \
+    if (!(cond)) {                                                                                 \
+      std::cerr << "FAIL: " << msg << " (line " << __LINE__ << ")\n";                              \
+      ++failures;                                                                                  \
+    } else {                                                                                       \
+      std::cout << "PASS: " << msg << "\n";                                                        \
+    }                                                                                              \
+  } while (0)
+
+struct Shape {
+  int id = 1;
+  std::string tag = "shape";
+  int area() const { return 0; }
+  int sides() const { return 0; }
+};
+
+struct Vec3 : Shape {
+  double x = 0, y = 0, z = 0;
+  double len2() const { return x * x + y * y + z * z; }
+  double scale() const { return scale_; }
+  void set_scale(double s) { scale_ = s; }
+  int sides() const { return 3; } // 覆盖 Shape::sides
+
+private:
+  double scale_ = 1.0;
+};
+
+struct Counter {
+  int a = 1;
+  int geta() const { return a * 10; }
+};
+
+int main() {
+  try {
+    sptxx::state lua;
+    lua.open_libraries();
+
+    // 先声明派生类型与 base（基类尚未注册），验证按名延迟解析
+    auto uv = lua.new_usertype<Vec3>("Vec3");
+    uv.constructor<>();
+    uv.base<Shape>("Shape");
+    uv.set("x", &Vec3::x);
+    uv.set("y", &Vec3::y);
+    uv.set("z", &Vec3::z);
+    uv.set("len2", &Vec3::len2);
+    uv.set("scale", &Vec3::scale, &Vec3::set_scale);
+    uv.set("sides", &Vec3::sides);
+
+    // ---- 1. 数据成员与属性函数 ----
+    lua.do_string("v = Vec3(); v.x = 1; v.y = 2; v.z = 2; r1 = v.len2(); "
+                  "v.scale = 2.5; r2 = v.scale * v.x;");
+    CHECK(lua.get_global<double>("r1") == 9.0, "field writes visible to method");
+    CHECK(lua.get_global<double>("r2") == 2.5, "property getter/setter");
+
+    // ---- 2. 基类在派生类首次访问之后注册：下一次访问重建 ----
+    {
+      auto us = lua.new_usertype<Shape>("Shape");
+      us.constructor<>();
+      us.set("id", &Shape::id);
+      us.set("area", &Shape::area);
+      us.set("sides", &Shape::sides);
+    }
+    lua.do_string("v.id = 42; r3 = v.id + v.area(); r4 = v.sides();");
+    CHECK(lua.get_global<int>("r3") == 42, "late-registered base field and method");
+    CHECK(lua.get_global<int>("r4") == 3, "derived override wins over base method");
+
+    // ---- 3. 基类后续新增成员传播到派生类 ----
+    lua.get_usertype<Shape>("Shape").set("tag", &Shape::tag);
+    lua.do_string("v.tag = 'vec'; r5 = v.tag;");
+    CHECK(lua.get_global<std::string>("r5") == "vec", "member added to base after first access");
+
+    // ---- 4. 只读属性与未知字段 ----
+    uv.set_readonly("norm2", &Vec3::len2);
+    lua.do_string("r6 = v.norm2; r7 = v.nothing == null;");
+    CHECK(lua.get_global<double>("r6") == 9.0, "readonly property read");
+    CHECK(lua.get_global<bool>("r7"), "unknown key reads as null");
+    {
+      bool threw = false;
+      try {
+        lua.do_string("v.norm2 = 1;");
+      } catch (const sptxx::error &) {
+        threw = true;
+      }
+      CHECK(threw, "writing readonly property raises");
+      threw = false;
+      try {
+        lua.do_string("v.nothing = 1;");
+      } catch (const sptxx::error &) {
+        threw = true;
+      }
+      CHECK(threw, "writing unknown field raises");
+    }
+
+    // ---- 5. unowned 对象共享同一分派 ----
+    Vec3 host;
+    host.x = 3;
+    uv.push_unowned(&host);
+    lua_setglobal(lua.lua_state(), "h");
+    lua.do_string("h.y = 4; h.id = 7; r8 = h.len2(); r9 = h.id;");
+    CHECK(lua.get_global<double>("r8") == 25.0 && host.y == 4.0, "unowned object fields");
+    CHECK(lua.get_global<int>("r9") == 7 && host.id == 7, "unowned object inherited field");
+
+    // ---- 6. metatable 自身字段与运算符仍可经 __index 读到 ----
+    uv.set_operator<sptxx::operator_type::eq>(
+        [](const Vec3 &a, const Vec3 &b) { return a.len2() == b.len2(); });
+    lua.do_string("r10 = v.__name; r11 = v == h;");
+    CHECK(lua.get_global<std::string>("r10") == "Vec3", "metatable field via __index");
+    CHECK(!lua.get_global<bool>("r11"), "operator registered after access");
+
+    // ---- 7. 大量访问 ----
+    lua.do_string("for (int i = 1, 10000) { v.x = v.x + 1; } r12 = v.x;");
+    CHECK(lua.get_global<double>("r12") == 10001.0, "repeated field access");
+
+    // ---- 8. 数据成员改注册为只读属性：旧的 setter 不再残留 ----
+    {
+      auto uc = lua.new_usertype<Counter>("Counter");
+      uc.constructor<>();
+      uc.set("a", &Counter::a);
+      lua.do_string("c = Counter(); c.a = 2; r13 = c.a;");
+      CHECK(lua.get_global<int>("r13") == 2, "data member before re-registration");
+      uc.set_readonly("a", &Counter::geta);
+      lua.do_string("r14 = c.a;");
+      CHECK(lua.get_global<int>("r14") == 20, "re-registered field reads through the getter");
+      bool threw = false;
+      try {
+        lua.do_string("c.a = 7;");
+      } catch (const sptxx::error &) {
+        threw = true;
+      }
+      CHECK(threw, "member re-registered as a read-only property rejects writes");
+      uc.set("a", &Counter::a);
+      lua.do_string("c.a = 5; r15 = c.a;");
+      CHECK(lua.get_global<int>("r15") == 5, "re-registered back to a data member");
+    }
+
+    // ---- 9. 注册代数按状态区分：另一个状态的注册不让本状态重建 ----
+    {
+      lua_State *L = lua.lua_state();
+      unsigned before = sptxx::detail::push_usertype_epoch(L)->epoch;
+      lua_pop(L, 1);
+      sptxx::state other;
+      other.open_libraries();
+      auto ov = other.new_usertype<Vec3>("Vec3");
+      ov.constructor<>();
+      ov.set("x", &Vec3::x);
+      other.do_string("o = Vec3(); o.x = 4; r = o.x;");
+      unsigned after = sptxx::detail::push_usertype_epoch(L)->epoch;
+      lua_pop(L, 1);
+      CHECK(before == after, "registrations in another state leave this epoch alone");
+      CHECK(other.get_global<double>("r") == 4.0, "other state dispatches its own fields");
+      lua.do_string("r16 = v.len2() > 0 && v.id == 42;");
+      CHECK(lua.get_global<bool>("r16"), "this state keeps its dispatch");
+      uv.set("w", &Vec3::z);
+      unsigned bumped = sptxx::detail::push_usertype_epoch(L)->epoch;
+      lua_pop(L, 1);
+      CHECK(bumped != after, "registration in this state bumps its epoch");
+      lua.do_string("r17 = v.w == v.z;");
+      CHECK(lua.get_global<bool>("r17"), "member registered later is found");
+    }
+
+    if (failures == 0) {
+      std::cout << "=== All usertype dispatch tests passed! ===\n";
+      return 0;
+    }
+    std::cerr << "=== " << failures << " test(s) FAILED ===\n";
+    return 1;
+  } catch (const std::exception &e) {
+    std::cerr << "test crashed: " << e.what() << "\n";
+    return 1;
+  }
+}
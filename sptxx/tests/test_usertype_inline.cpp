@@ -0,0 +1,153 @@
+// test_usertype_inline.cpp - 测试小对象就地存放在 userdata 内（一次分配）
+
+#include "sptxx.hpp"
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+static int failures = 0;
+#define CHECK(cond, msg)                                                                           \
+  do {                                                                                             \
+    if (!(cond)) {                                                                                 \
+      std::cerr << "FAIL: " << msg << " (line " << __LINE__ << ")\n";                              \
+      ++failures;                                                                                  \
+    } else {                                                                                       \
+      std::cout << "PASS: " << msg << "\n";                                                        \
+    }                                                                                              \
+  } while (0)
+
+static int live = 0;
+
+struct Color {
+  int r, g, b;
+  Color(int r_, int g_, int b_) : r(r_), g(g_), b(b_) {
+    if (r_ < 0)
+      throw std::runtime_error("negative channel");
+    ++live;
+  }
+  Color(const Color &o) : r(o.r), g(o.g), b(o.b) { ++live; }
+  ~Color() { --live; }
+  int sum() const { return r + g + b; }
+};
+
+struct alignas(64) Wide {
+  double v[4] = {1, 2, 3, 4};
+  double first() const { return v[0]; }
+};
+
+struct Big {
+  char payload[4096] = {};
+  int tag = 9;
+};
+
+// 显式关闭就地存储
+struct Handle {
+  int id = 5;
+};
+namespace sptxx {
+template <> struct is_inline_usertype<Handle> : std::false_type {};
+} // namespace sptxx
+
+static void *ud_of(lua_State *L, const char *global, std::size_t *size) {
+  lua_getglobal(L, global);
+  void *ud = lua_touserdata(L, -1);
+  *size = lua_rawlen(L, -1);
+  lua_pop(L, 1);
+  return ud;
+}
+
+int main() {
+  try {
+    sptxx::state lua;
+    lua.open_libraries();
+    lua_State *L = lua.lua_state();
+
+    auto uc = lua.new_usertype<Color>("Color");
+    uc.constructor<int, int, int>();
+    uc.set("r", &Color::r);
+    uc.set("sum", &Color::sum);
+    auto uw = lua.new_usertype<Wide>("Wide");
+    uw.constructor<>();
+    uw.set("first", &Wide::first);
+    auto ub = lua.new_usertype<Big>("Big");
+    ub.constructor<>();
+    ub.set("tag", &Big::tag);
+    auto uh = lua.new_usertype<Handle>("Handle");
+    uh.constructor<>();
+    uh.set("id", &Handle::id);
+
+    // ---- 1. 脚本构造的小对象：T* 指向块内本体 ----
+    lua.do_string("c = Color(1, 2, 3); c.r = 10; s = c.sum();");
+    {
+      std::size_t size;
+      void *ud = ud_of(L, "c", &size);
+      Color *obj = *static_cast<Color **>(ud);
+      auto b = reinterpret_cast<std::uintptr_t>(ud), p = reinterpret_cast<std::uintptr_t>(obj);
+      CHECK(size >= sizeof(Color *) + sizeof(Color) && p > b && p + sizeof(Color) <= b + size,
+            "small object stored inline");
+      CHECK(lua.get_global<int>("s") == 15 && live == 1, "inline object fields and methods");
+    }
+
+    // ---- 2. GC 只析构一次 ----
+    lua.do_string("c = null;");
+    lua_gc(L, LUA_GCCOLLECT);
+    CHECK(live == 0, "inline object destroyed by __gc");
+
+    // ---- 3. 构造函数抛异常：不析构未构造的对象 ----
+    {
+      bool threw = false;
+      try {
+        lua.do_string("bad = Color(-1, 0, 0);");
+      } catch (const sptxx::error &) {
+        threw = true;
+      }
+      lua_gc(L, LUA_GCCOLLECT);
+      CHECK(threw && live == 0, "throwing constructor leaves nothing to destroy");
+    }
+
+    // ---- 4. 超对齐类型 ----
+    lua.do_string("w = Wide(); wf = w.first();");
+    {
+      std::size_t size;
+      Wide *obj = *static_cast<Wide **>(ud_of(L, "w", &size));
+      CHECK(reinterpret_cast<std::uintptr_t>(obj) % 64 == 0 && lua.get_global<double>("wf") == 1,
+            "over-aligned inline object");
+    }
+
+    // ---- 5. 大对象与显式关闭：仍存 T* ----
+    lua.do_string("big = Big(); h = Handle(); r5 = big.tag + h.id;");
+    {
+      std::size_t big_size, h_size;
+      ud_of(L, "big", &big_size);
+      ud_of(L, "h", &h_size);
+      CHECK(big_size == sizeof(Big *) && h_size == sizeof(Handle *), "pointer form kept");
+      CHECK(lua.get_global<int>("r5") == 14, "pointer-form objects accessible");
+    }
+
+    // ---- 6. C++ 侧 push_value ----
+    uc.push_value(Color(4, 5, 6));
+    lua_setglobal(L, "pv");
+    lua.do_string("r6 = pv.sum();");
+    CHECK(lua.get_global<int>("r6") == 15 && live == 1, "push_value copies into Lua");
+    lua.do_string("pv = null;");
+    lua_gc(L, LUA_GCCOLLECT);
+    CHECK(live == 0, "push_value object destroyed by __gc");
+
+    // ---- 7. 大量创建 ----
+    lua.do_string("int acc = 0; "
+                  "for (int i = 1, 20000) { auto t = Color(i, 0, 0); acc = acc + t.r; } r7 = acc;");
+    lua_gc(L, LUA_GCCOLLECT);
+    CHECK(lua.get_global<int>("r7") == 200010000 && live == 0, "bulk creation and collection");
+
+    if (failures == 0) {
+      std::cout << "=== All inline usertype tests passed! ===\n";
+      return 0;
+    }
+    std::cerr << "=== " << failures << " test(s) FAILED ===\n";
+    return 1;
+  } catch (const std::exception &e) {
+    std::cerr << "test crashed: " << e.what() << "\n";
+    return 1;
+  }
+}